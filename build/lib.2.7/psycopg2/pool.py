@@ -0,0 +1,465 @@
+"""Connection pooling for psycopg2
+
+This module implements thread-safe (and not) connection pools.
+"""
+# psycopg/pool.py - pooling code for psycopg
+#
+# Copyright (C) 2003-2010 Federico Di Gregorio  <fog@debian.org>
+#
+# psycopg2 is free software: you can redistribute it and/or modify it
+# under the terms of the GNU Lesser General Public License as published
+# by the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# In addition, as a special exception, the copyright holders give
+# permission to link this program with the OpenSSL library (or with
+# modified versions of OpenSSL that use the same license as OpenSSL),
+# and distribute linked combinations including the two.
+#
+# You must obey the GNU Lesser General Public License in all respects for
+# all of the code used other than OpenSSL.
+#
+# psycopg2 is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+# License for more details.
+
+import psycopg2
+
+try:
+    import logging
+    # create logger object for psycopg2 module and sub-modules
+    _logger = logging.getLogger("psycopg2")
+    def dbg(*args):
+        _logger.debug("psycopg2", ' '.join([str(x) for x in args]))
+    try:
+        import App # does this make sure that we're running in Zope?
+        _logger.info("installed. Logging using Python logging module")
+    except:
+        _logger.debug("installed. Logging using Python logging module")
+    
+except ImportError:
+    from zLOG import LOG, DEBUG, INFO
+    def dbg(*args):
+        LOG('ZPsycopgDA',  DEBUG, "",
+            ' '.join([str(x) for x in args])+'\n')
+    LOG('ZPsycopgDA', INFO, "Installed", "Logging using Zope's zLOG\n") 
+
+except:
+    import sys
+    def dbg(*args):
+        sys.stderr.write(' '.join(args)+'\n')
+
+
+class PoolError(psycopg2.Error):
+    pass
+
+
+class AbstractConnectionPool(object):
+    """Generic key-based pooling code."""
+
+    def __init__(self, minconn, maxconn, *args, **kwargs):
+        """Initialize the connection pool.
+
+        New 'minconn' connections are created immediately calling 'connfunc'
+        with given parameters. The connection pool will support a maximum of
+        about 'maxconn' connections.        
+        """
+        self.minconn = minconn
+        self.maxconn = maxconn
+        self.closed = False
+        self.result_cache = None
+        
+        self._args = args
+        self._kwargs = kwargs
+
+        self._pool = []
+        self._used = {}
+        self._rused = {} # id(conn) -> key map
+        self._keys = 0
+
+        for i in range(self.minconn):
+            self._connect()
+
+    def _connect(self, key=None):
+        """Create a new connection and assign it to 'key' if not None."""
+        conn = psycopg2.connect(*self._args, **self._kwargs)
+        if key is not None:
+            self._used[key] = conn
+            self._rused[id(conn)] = key
+        else:
+            self._pool.append(conn)
+        return conn
+
+    def _getkey(self):
+        """Return a new unique key."""
+        self._keys += 1
+        return self._keys
+            
+    def _getconn(self, key=None):
+        """Get a free connection and assign it to 'key' if not None."""
+        if self.closed: raise PoolError("connection pool is closed")
+        if key is None: key = self._getkey()
+	
+        if self._used.has_key(key):
+            return self._used[key]
+
+        if self._pool:
+            self._used[key] = conn = self._pool.pop()
+            self._rused[id(conn)] = key
+        else:
+            if len(self._used) == self.maxconn:
+                raise PoolError("connection pool exausted")
+            conn = self._connect(key)
+
+        # the cache of the pool is shared by all its connections
+        conn.result_cache = self.result_cache
+        return conn
+		 
+    def _putconn(self, conn, key=None, close=False):
+        """Put away a connection."""
+        if self.closed: raise PoolError("connection pool is closed")
+        if key is None: key = self._rused[id(conn)]
+
+        if not key:
+            raise PoolError("trying to put unkeyed connection")
+
+        if len(self._pool) < self.minconn and not close:
+            self._pool.append(conn)
+        else:
+            conn.close()
+
+        # here we check for the presence of key because it can happen that a
+        # thread tries to put back a connection after a call to close
+        if not self.closed or key in self._used:
+            del self._used[key]
+            del self._rused[id(conn)]
+
+    def _closeall(self):
+        """Close all connections.
+
+        Note that this can lead to some code fail badly when trying to use
+        an already closed connection. If you call .closeall() make sure
+        your code can deal with it.
+        """
+        if self.closed: raise PoolError("connection pool is closed")
+        for conn in self._pool + list(self._used.values()):
+            try:
+                conn.close()
+            except:
+                pass
+        self.closed = True
+        
+
+class SimpleConnectionPool(AbstractConnectionPool):
+    """A connection pool that can't be shared across different threads."""
+
+    getconn = AbstractConnectionPool._getconn
+    putconn = AbstractConnectionPool._putconn
+    closeall   = AbstractConnectionPool._closeall
+
+
+class ThreadedConnectionPool(AbstractConnectionPool):
+    """A connection pool that works with the threading module."""
+
+    def __init__(self, minconn, maxconn, *args, **kwargs):
+        """Initialize the threading lock."""
+        import threading
+        AbstractConnectionPool.__init__(
+            self, minconn, maxconn, *args, **kwargs)
+        self._lock = threading.Lock()
+
+    def getconn(self, key=None):
+        """Get a free connection and assign it to 'key' if not None."""
+        self._lock.acquire()
+        try:
+            return self._getconn(key)
+        finally:
+            self._lock.release()
+
+    def putconn(self, conn=None, key=None, close=False):
+        """Put away an unused connection."""
+        self._lock.acquire()
+        try:
+            self._putconn(conn, key, close)
+        finally:
+            self._lock.release()
+
+    def closeall(self):
+        """Close all connections (even the one currently in use.)"""
+        self._lock.acquire()
+        try:
+            self._closeall()
+        finally:
+            self._lock.release()
+
+
+class PersistentConnectionPool(AbstractConnectionPool):
+    """A pool that assigns persistent connections to different threads. 
+
+    Note that this connection pool generates by itself the required keys
+    using the current thread id.  This means that until a thread puts away
+    a connection it will always get the same connection object by successive
+    `!getconn()` calls. This also means that a thread can't use more than one
+    single connection from the pool.
+    """
+
+    def __init__(self, minconn, maxconn, *args, **kwargs):
+        """Initialize the threading lock."""
+        import threading
+        AbstractConnectionPool.__init__(
+            self, minconn, maxconn, *args, **kwargs)
+        self._lock = threading.Lock()
+
+        # we we'll need the thread module, to determine thread ids, so we
+        # import it here and copy it in an instance variable
+        import thread
+        self.__thread = thread
+
+    def getconn(self):
+        """Generate thread id and return a connection."""
+        key = self.__thread.get_ident()
+        self._lock.acquire()
+        try:
+            return self._getconn(key)
+        finally:
+            self._lock.release()
+
+    def putconn(self, conn=None, close=False):
+        """Put away an unused connection."""
+        key = self.__thread.get_ident()
+        self._lock.acquire()
+        try:
+            if not conn: conn = self._used[key]
+            self._putconn(conn, key, close)
+        finally:
+            self._lock.release()
+
+    def closeall(self):
+        """Close all connections (even the one currently in use.)"""
+        self._lock.acquire()
+        try:
+            self._closeall()
+        finally:
+            self._lock.release()
+
+
+# The C pool raises the PoolError defined above: import it only after that.
+from psycopg2._psycopg import NativeConnectionPool
+
+
+class PoolMaintenanceThread(object):
+    """Call `!maintain()` on a `NativeConnectionPool` in background.
+
+    The thread runs every 'interval' seconds until `stop()` is called or
+    the pool is closed.
+    """
+
+    def __init__(self, pool, interval=10.0):
+        import threading
+        self.pool = pool
+        self.interval = interval
+        self._stopped = threading.Event()
+        self._thread = threading.Thread(target=self._run)
+        self._thread.setDaemon(True)
+
+    def start(self):
+        self._thread.start()
+        return self
+
+    def stop(self):
+        self._stopped.set()
+        self._thread.join()
+
+    def _run(self):
+        while not self._stopped.isSet():
+            self._stopped.wait(self.interval)
+            if self._stopped.isSet() or self.pool.closed:
+                break
+            try:
+                self.pool.maintain()
+            except Exception, e:
+                # e.g. the database is restarting: retry at the next round
+                dbg("pool maintenance failed:", e)
+
+
+def execute_partitioned(pool, query, partitions, columns=False,
+                        workers=None, nogil_batch=2000):
+    """Run a query for each item of 'partitions' on many pool connections.
+
+    The query is executed with every item of 'partitions' as arguments,
+    using up to 'workers' connections of 'pool' at once (by default as many
+    as the partitions, up to the pool 'maxconn'), each one in a thread.
+    The GIL is released waiting for the results and parsing the values,
+    so the partitions are fetched in parallel.
+
+    Return an iterator on the records of all the partitions, in the order
+    of 'partitions'; if 'columns' is true return a list with the result of
+    `cursor.fetch_columns()` for each partition instead. The first error
+    is raised after all the workers have stopped. Each worker returns its
+    connection to the pool as soon as it has no more partitions to run.
+    """
+    partitions = list(partitions)
+    run = _PartitionedQuery(pool, query, partitions, columns, workers,
+                            nogil_batch)
+    if columns:
+        return list(run)
+    return run.records()
+
+
+class _PartitionedQuery(object):
+    """The state shared by the threads of `execute_partitioned()`."""
+
+    def __init__(self, pool, query, partitions, columns, workers,
+                 nogil_batch):
+        import threading
+        self.pool = pool
+        self.query = query
+        self.partitions = partitions
+        self.columns = columns
+        self.nogil_batch = nogil_batch
+        self.results = {}
+        self.error = None
+        self.next = 0
+        self.cond = threading.Condition()
+
+        # the workers return their connection to the pool when done
+        if isinstance(pool, SimpleConnectionPool):
+            raise PoolError("execute_partitioned() needs a pool "
+                            "that can be shared by threads")
+
+        if workers is None:
+            workers = getattr(pool, 'maxconn', len(partitions))
+        workers = max(1, min(workers, len(partitions)))
+
+        # the connections are taken here, as a PersistentConnectionPool
+        # binds them to the calling thread; don't wait for the busy ones
+        # after the first one. A pool giving back a connection already
+        # taken has no more to give.
+        self.conns = [pool.getconn()]
+        try:
+            while len(self.conns) < workers:
+                if isinstance(pool, NativeConnectionPool):
+                    conn = pool.getconn(timeout=0)
+                else:
+                    conn = pool.getconn()
+                if [c for c in self.conns if c is conn]:
+                    break
+                self.conns.append(conn)
+        except PoolError:
+            pass
+
+        self.threads = []
+        for conn in self.conns:
+            t = threading.Thread(target=self._work, args=(conn,))
+            t.setDaemon(True)
+            t.start()
+            self.threads.append(t)
+
+    def _work(self, conn):
+        try:
+            self._run(conn)
+        finally:
+            self._putconn(conn)
+
+    def _putconn(self, conn):
+        try:
+            if isinstance(self.pool, PersistentConnectionPool):
+                # putconn() would look for the connection of this thread
+                self.pool._lock.acquire()
+                try:
+                    self.pool._putconn(conn)
+                finally:
+                    self.pool._lock.release()
+            else:
+                self.pool.putconn(conn)
+        except Exception:
+            import sys
+            self._set_error(sys.exc_info())
+
+    def _set_error(self, error):
+        self.cond.acquire()
+        try:
+            if self.error is None: self.error = error
+            self.cond.notifyAll()
+        finally:
+            self.cond.release()
+
+    def _run(self, conn):
+        while 1:
+            self.cond.acquire()
+            try:
+                if self.error is not None \
+                        or self.next >= len(self.partitions):
+                    break
+                i = self.next
+                self.next += 1
+            finally:
+                self.cond.release()
+
+            try:
+                curs = conn.cursor()
+                curs.nogil_batch = self.nogil_batch
+                curs.execute(self.query, self.partitions[i])
+                if self.columns:
+                    rv = curs.fetch_columns()
+                else:
+                    rv = curs.fetchall()
+                curs.close()
+                conn.rollback()
+            except Exception:
+                import sys
+                rv = None
+                error = sys.exc_info()
+                try:
+                    conn.rollback()
+                except Exception:
+                    pass
+
+            if rv is None:
+                self._set_error(error)
+                break
+
+            self.cond.acquire()
+            try:
+                self.results[i] = rv
+                self.cond.notifyAll()
+            finally:
+                self.cond.release()
+
+    def _close(self):
+        self.cond.acquire()
+        try:
+            # stop the workers after their current partition
+            self.next = len(self.partitions)
+        finally:
+            self.cond.release()
+        # the workers return their connections before terminating
+        for t in self.threads:
+            t.join()
+        self.threads = self.conns = []
+
+    def __iter__(self):
+        """Return the result of each partition as soon as it is ready."""
+        try:
+            for i in range(len(self.partitions)):
+                self.cond.acquire()
+                try:
+                    while i not in self.results and self.error is None:
+                        self.cond.wait()
+                    if self.error is not None:
+                        break
+                    rv = self.results.pop(i)
+                finally:
+                    self.cond.release()
+                yield rv
+        finally:
+            self._close()
+
+        if self.error is not None:
+            raise self.error[0], self.error[1], self.error[2]
+
+    def records(self):
+        for rv in self:
+            for record in rv:
+                yield record
@@ -0,0 +1,372 @@
+#!/usr/bin/env python
+import os
+import string
+from testutils import unittest
+from cStringIO import StringIO
+from itertools import cycle, izip
+
+import psycopg2
+import psycopg2.extensions
+import tests
+
+
+class MinimalRead(object):
+    """A file wrapper exposing the minimal interface to copy from."""
+    def __init__(self, f):
+        self.f = f
+
+    def read(self, size):
+        return self.f.read(size)
+
+    def readline(self):
+        return self.f.readline()
+
+class BufferRead(MinimalRead):
+    """A file wrapper returning bytearrays from read()."""
+    def read(self, size):
+        return bytearray(self.f.read(size))
+
+class ReadIntoRead(MinimalRead):
+    """A file wrapper exposing readinto() to copy from."""
+    def __init__(self, f):
+        MinimalRead.__init__(self, f)
+        self.buffers = set()
+
+    def readinto(self, b):
+        self.buffers.add(id(b))
+        data = self.f.read(len(b))
+        b[:len(data)] = data
+        return len(data)
+
+class MinimalWrite(object):
+    """A file wrapper exposing the minimal interface to copy to."""
+    def __init__(self, f):
+        self.f = f
+
+    def write(self, data):
+        return self.f.write(data)
+
+
+class CopyTests(unittest.TestCase):
+
+    def setUp(self):
+        self.conn = psycopg2.connect(tests.dsn)
+        curs = self.conn.cursor()
+        curs.execute('''
+            CREATE TEMPORARY TABLE tcopy (
+              id int PRIMARY KEY,
+              data text
+            )''')
+
+    def tearDown(self):
+        self.conn.close()
+
+    def test_copy_from(self):
+        curs = self.conn.cursor()
+        try:
+            self._copy_from(curs, nrecs=1024, srec=10*1024, copykw={})
+        finally:
+            curs.close()
+
+    def test_copy_from_insane_size(self):
+        # Trying to trigger a "would block" error
+        curs = self.conn.cursor()
+        try:
+            self._copy_from(curs, nrecs=10*1024, srec=10*1024,
+                copykw={'size': 20*1024*1024})
+        finally:
+            curs.close()
+
+    def test_copy_from_buffer(self):
+        curs = self.conn.cursor()
+        try:
+            self._copy_from(curs, nrecs=1024, srec=10*1024, copykw={},
+                wrapper=BufferRead)
+        finally:
+            curs.close()
+
+    def test_copy_from_readinto(self):
+        curs = self.conn.cursor()
+        try:
+            f = self._copy_from(curs, nrecs=1024, srec=10*1024,
+                copykw={'size': 1000}, wrapper=ReadIntoRead)
+            self.assertEqual(1, len(f.buffers))
+        finally:
+            curs.close()
+
+    def test_copy_from_unicode_err(self):
+        class UnicodeRead(MinimalRead):
+            def read(self, size):
+                return unicode(self.f.read(size))
+
+        curs = self.conn.cursor()
+        f = StringIO("1\tfoo\n")
+        self.assertRaises(TypeError,
+            curs.copy_from, UnicodeRead(f), "tcopy")
+
+    def test_copy_from_cols(self):
+        curs = self.conn.cursor()
+        f = StringIO()
+        for i in xrange(10):
+            f.write("%s\n" % (i,))
+
+        f.seek(0)
+        curs.copy_from(MinimalRead(f), "tcopy", columns=['id'])
+
+        curs.execute("select * from tcopy order by id")
+        self.assertEqual([(i, None) for i in range(10)], curs.fetchall())
+
+    def test_copy_from_cols_err(self):
+        curs = self.conn.cursor()
+        f = StringIO()
+        for i in xrange(10):
+            f.write("%s\n" % (i,))
+
+        f.seek(0)
+        def cols():
+            raise ZeroDivisionError()
+            yield 'id'
+
+        self.assertRaises(ZeroDivisionError,
+            curs.copy_from, MinimalRead(f), "tcopy", columns=cols())
+
+    def test_copy_to(self):
+        curs = self.conn.cursor()
+        try:
+            self._copy_from(curs, nrecs=1024, srec=10*1024, copykw={})
+            self._copy_to(curs, srec=10*1024)
+        finally:
+            curs.close()
+
+    def test_copy_to_buffered(self):
+        class CountWrite(MinimalWrite):
+            writes = 0
+            def write(self, data):
+                self.writes += 1
+                return MinimalWrite.write(self, data)
+
+        curs = self.conn.cursor()
+        curs.execute("insert into tcopy select x, 'x' from generate_series(1, 1000) x")
+        f = CountWrite(StringIO())
+        curs.copy_to(f, "tcopy", size=1024)
+        lines = f.f.getvalue().splitlines()
+        self.assertEqual(1000, len(lines))
+        self.assertEqual("1\tx", lines[0])
+        self.assert_(f.writes < 100, f.writes)
+
+        f = CountWrite(StringIO())
+        curs.copy_to(f, "tcopy", size=0)
+        self.assertEqual(1000, f.writes)
+
+    def test_copy_records(self):
+        curs = self.conn.cursor()
+        curs.copy_records("tcopy", None,
+            ((i, i % 3 and "data %d" % i or None) for i in xrange(10000)),
+            size=1024)
+        self.assertEqual(10000, curs.rowcount)
+        curs.execute("select count(*), count(data), sum(id) from tcopy")
+        self.assertEqual((10000, 6666, sum(range(10000))), curs.fetchone())
+
+    def test_copy_records_types(self):
+        from datetime import date, datetime
+        from decimal import Decimal
+        from psycopg2.tz import FixedOffsetTimezone
+        curs = self.conn.cursor()
+        curs.execute("""create temp table tcopytypes (
+            b bool, i2 int2, i8 int8, f4 float4, f8 float8, n numeric,
+            t varchar, ba bytea, d date, ts timestamp, tstz timestamptz,
+            u uuid)""")
+        rec = (True, -2, 10000000000L, 0.5, 3.25, Decimal('-123.4500'),
+            u'\xe8', psycopg2.Binary('\x00\xff'), date(1999, 12, 31),
+            datetime(2010, 2, 3, 4, 5, 6, 789),
+            datetime(2010, 2, 3, 4, 5, 6,
+                tzinfo=FixedOffsetTimezone(offset=120)),
+            '12345678-9abc-def0-0102-030405060708')
+        self.conn.set_client_encoding('UTF8')
+        curs.copy_records("tcopytypes", None, [rec, (None,) * len(rec)])
+
+        curs.execute("set timezone to 'UTC'")
+        curs.execute("""select b, i2, i8, f4, f8, n, t, ba, d, ts,
+            tstz::timestamp, u::text from tcopytypes where b""")
+        r = curs.fetchone()
+        self.assertEqual(rec[:6], r[:6])
+        self.assertEqual('-123.4500', str(r[5]))
+        self.assertEqual(rec[6].encode('utf8'), r[6])
+        self.assertEqual('\x00\xff', str(r[7]))
+        self.assertEqual(rec[8:10], r[8:10])
+        self.assertEqual(datetime(2010, 2, 3, 2, 5, 6), r[10])
+        self.assertEqual(rec[11], r[11])
+
+        curs.execute("select count(*) from tcopytypes where b is null")
+        self.assertEqual(1, curs.fetchone()[0])
+
+    def test_copy_records_columns(self):
+        curs = self.conn.cursor()
+        curs.copy_records("tcopy", ['id'], [(1,), (2,)])
+        curs.execute("select id, data from tcopy order by id")
+        self.assertEqual([(1, None), (2, None)], curs.fetchall())
+
+    def test_copy_records_errors(self):
+        curs = self.conn.cursor()
+        self.assertRaises(psycopg2.ProgrammingError,
+            curs.copy_records, "tcopy", None, [(1,)])
+        self.conn.rollback()
+        self.assertRaises(TypeError,
+            curs.copy_records, "tcopy", None, [("x", "y")])
+        self.conn.rollback()
+        self.assertRaises(psycopg2.IntegrityError,
+            curs.copy_records, "tcopy", None, [(1, "a"), (1, "a")])
+        self.conn.rollback()
+        curs.execute("create temp table tcopypoint (p point)")
+        self.assertRaises(psycopg2.NotSupportedError,
+            curs.copy_records, "tcopypoint", None, [])
+        self.conn.rollback()
+        for size in (0, -1):
+            self.assertRaises(ValueError,
+                curs.copy_records, "tcopy", None, [(1, "a")], size)
+
+    def test_copy_out_iter(self):
+        curs = self.conn.cursor()
+        curs.execute("insert into tcopy select x, repeat('x', 100) from generate_series(1, 1000) x")
+        chunks = list(curs.copy_out_iter("copy tcopy to stdout", 4096))
+        self.assert_(len(chunks) > 1)
+        for c in chunks[:-1]:
+            self.assert_(len(c) >= 4096, len(c))
+        lines = "".join(chunks).splitlines()
+        self.assertEqual(1000, len(lines))
+        self.assertEqual("1\t" + "x" * 100, lines[0])
+
+        # the connection is usable again
+        curs.execute("select 1")
+        self.assertEqual(1, curs.fetchone()[0])
+
+    def test_copy_out_iter_close(self):
+        curs = self.conn.cursor()
+        curs.execute("insert into tcopy select x, repeat('x', 100) from generate_series(1, 1000) x")
+        it = curs.copy_out_iter("copy tcopy to stdout", 1024)
+        it.next()
+        it.close()
+        self.assert_(it.closed)
+        self.assertRaises(StopIteration, it.next)
+        curs.execute("select count(*) from tcopy")
+        self.assertEqual(1000, curs.fetchone()[0])
+
+    def test_copy_in_stream(self):
+        curs = self.conn.cursor()
+        f = curs.copy_in_stream("copy tcopy from stdin")
+        for i in xrange(100):
+            f.write("%d\tdata %d\n" % (i, i))
+        f.write(bytearray("100\tlast\n"))
+        f.close()
+        self.assert_(f.closed)
+        self.assertEqual(101, curs.rowcount)
+        self.assertRaises(psycopg2.InterfaceError, f.write, "x")
+        curs.execute("select data from tcopy where id = 100")
+        self.assertEqual("last", curs.fetchone()[0])
+
+    def test_copy_in_stream_context(self):
+        # the with statement is not available in all the supported pythons
+        curs = self.conn.cursor()
+        f = curs.copy_in_stream("copy tcopy from stdin")
+        self.assert_(f.__enter__() is f)
+        f.write("1\tfoo\n")
+        self.assertEqual(False, f.__exit__(None, None, None))
+        curs.execute("select data from tcopy")
+        self.assertEqual("foo", curs.fetchone()[0])
+
+        # an error aborts the copy
+        f = curs.copy_in_stream("copy tcopy from stdin")
+        f.write("2\tbar\n")
+        f.__exit__(ZeroDivisionError, ZeroDivisionError(), None)
+        self.assert_(f.closed)
+        self.assertRaises(psycopg2.InternalError, curs.execute, "select 1")
+        self.conn.rollback()
+
+    def test_copy_stream_busy(self):
+        # the connection can't be used until the stream is closed
+        curs = self.conn.cursor()
+        f = curs.copy_in_stream("copy tcopy from stdin")
+        f.write("1\tfoo\n")
+        self.assertRaises(psycopg2.ProgrammingError, self.conn.commit)
+        self.assertRaises(psycopg2.ProgrammingError,
+            self.conn.cursor().execute, "select 1")
+        f.close()
+        self.conn.commit()
+
+        it = curs.copy_out_iter("copy tcopy to stdout")
+        self.assertRaises(psycopg2.ProgrammingError, curs.execute, "select 1")
+        list(it)
+        curs.execute("select count(*) from tcopy")
+        self.assertEqual(1, curs.fetchone()[0])
+
+    def test_copy_stream_del(self):
+        # a stream deleted before the end aborts the copy
+        curs = self.conn.cursor()
+        curs.execute("insert into tcopy select x, repeat('x', 100) from generate_series(1, 100000) x")
+        self.conn.commit()
+        it = curs.copy_out_iter("copy tcopy to stdout", 1024)
+        it.next()
+        del it
+        self.conn.rollback()
+
+        f = curs.copy_in_stream("copy tcopy from stdin")
+        f.write("1\tfoo\n")
+        del f
+        self.assertEqual(psycopg2.extensions.TRANSACTION_STATUS_INERROR,
+            self.conn.get_transaction_status())
+        self.conn.rollback()
+        curs.execute("select count(*) from tcopy")
+        self.assertEqual(100000, curs.fetchone()[0])
+
+    def test_copy_stream_bad_query(self):
+        curs = self.conn.cursor()
+        self.assertRaises(psycopg2.ProgrammingError,
+            curs.copy_in_stream, "copy tcopy to stdout")
+        self.conn.rollback()
+        self.assertRaises(psycopg2.ProgrammingError,
+            curs.copy_out_iter, "copy tcopy from stdin")
+        self.conn.rollback()
+        self.assertRaises(psycopg2.ProgrammingError,
+            curs.copy_out_iter, "select 1")
+        self.conn.rollback()
+
+    def _copy_from(self, curs, nrecs, srec, copykw, wrapper=MinimalRead):
+        f = StringIO()
+        for i, c in izip(xrange(nrecs), cycle(string.letters)):
+            l = c * srec
+            f.write("%s\t%s\n" % (i,l))
+
+        f.seek(0)
+        f = wrapper(f)
+        curs.copy_from(f, "tcopy", **copykw)
+
+        curs.execute("select count(*) from tcopy")
+        self.assertEqual(nrecs, curs.fetchone()[0])
+
+        curs.execute("select data from tcopy where id < %s order by id",
+                (len(string.letters),))
+        for i, (l,) in enumerate(curs):
+            self.assertEqual(l, string.letters[i] * srec)
+
+        return f
+
+    def _copy_to(self, curs, srec):
+        f = StringIO()
+        curs.copy_to(MinimalWrite(f), "tcopy")
+
+        f.seek(0)
+        ntests = 0
+        for line in f:
+            n, s = line.split()
+            if int(n) < len(string.letters):
+                self.assertEqual(s, string.letters[int(n)] * srec)
+                ntests += 1
+
+        self.assertEqual(ntests, len(string.letters))
+
+
+def test_suite():
+    return unittest.TestLoader().loadTestsFromName(__name__)
+
+if __name__ == "__main__":
+    unittest.main()
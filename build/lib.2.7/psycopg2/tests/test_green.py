@@ -0,0 +1,189 @@
+#!/usr/bin/env python
+
+import unittest
+import psycopg2
+import psycopg2.extensions
+import psycopg2.extras
+import tests
+
+class ConnectionStub(object):
+    """A `connection` wrapper allowing analysis of the `poll()` calls."""
+    def __init__(self, conn):
+        self.conn = conn
+        self.polls = []
+
+    def fileno(self):
+        return self.conn.fileno()
+
+    def poll(self):
+        rv = self.conn.poll()
+        self.polls.append(rv)
+        return rv
+
+class GreenTests(unittest.TestCase):
+    def setUp(self):
+        self._cb = psycopg2.extensions.get_wait_callback()
+        psycopg2.extensions.set_wait_callback(psycopg2.extras.wait_select)
+        self.conn = psycopg2.connect(tests.dsn)
+
+    def tearDown(self):
+        self.conn.close()
+        psycopg2.extensions.set_wait_callback(self._cb)
+
+    def set_stub_wait_callback(self, conn):
+        stub = ConnectionStub(conn)
+        psycopg2.extensions.set_wait_callback(
+            lambda conn: psycopg2.extras.wait_select(stub))
+        return stub
+
+    def test_flush_on_write(self):
+        # a very large query requires a flush loop to be sent to the backend
+        conn = self.conn
+        stub = self.set_stub_wait_callback(conn)
+        curs = conn.cursor()
+        for mb in 1, 5, 10, 20, 50:
+            size = mb * 1024 * 1024
+            del stub.polls[:]
+            curs.execute("select %s;", ('x' * size,))
+            self.assertEqual(size, len(curs.fetchone()[0]))
+            if stub.polls.count(psycopg2.extensions.POLL_WRITE) > 1:
+                return
+
+        # This is more a testing glitch than an error: it happens
+        # on high load on linux: probably because the kernel has more
+        # buffers ready. A warning may be useful during development,
+        # but an error is bad during regression testing.
+        import warnings
+        warnings.warn("sending a large query didn't trigger block on write.")
+
+    def test_error_in_callback(self):
+        conn = self.conn
+        curs = conn.cursor()
+        curs.execute("select 1")  # have a BEGIN
+        curs.fetchone()
+
+        # now try to do something that will fail in the callback
+        psycopg2.extensions.set_wait_callback(lambda conn: 1/0)
+        self.assertRaises(ZeroDivisionError, curs.execute, "select 2")
+
+        # check that the connection is left in an usable state
+        psycopg2.extensions.set_wait_callback(psycopg2.extras.wait_select)
+        conn.rollback()
+        curs.execute("select 2")
+        self.assertEqual(2, curs.fetchone()[0])
+
+    def test_copy(self):
+        from cStringIO import StringIO
+        conn = self.conn
+        stub = self.set_stub_wait_callback(conn)
+        curs = conn.cursor()
+        curs.execute("create temp table tgreencopy (id int, data text)")
+
+        f = StringIO()
+        for i in xrange(10000):
+            f.write("%d\t%s\n" % (i, 'x' * 100))
+        f.seek(0)
+        del stub.polls[:]
+        curs.copy_from(f, "tgreencopy")
+        self.assert_(stub.polls)
+        curs.execute("select count(*) from tgreencopy")
+        self.assertEqual(10000, curs.fetchone()[0])
+
+        f = StringIO()
+        del stub.polls[:]
+        curs.copy_expert("copy tgreencopy to stdout", f)
+        self.assert_(stub.polls)
+        self.assertEqual(10000, len(f.getvalue().splitlines()))
+
+        # the connection is still usable
+        curs.execute("select 1")
+        self.assertEqual(1, curs.fetchone()[0])
+
+    def test_wait_poll(self):
+        psycopg2.extensions.set_wait_callback(psycopg2.extensions.wait_poll)
+        self.assert_(psycopg2.extensions.get_wait_callback()
+            is psycopg2.extensions.wait_poll)
+        conn = psycopg2.connect(tests.dsn)
+        curs = conn.cursor()
+        curs.execute("select %s", ('x' * 1024 * 1024,))
+        self.assertEqual(1024 * 1024, len(curs.fetchone()[0]))
+        conn.close()
+
+    def test_fd_callback(self):
+        import select
+        events = []
+        def wait(fd, ev):
+            events.append(ev)
+            if ev == psycopg2.extensions.POLL_READ:
+                select.select([fd], [], [])
+            else:
+                select.select([], [fd], [])
+
+        psycopg2.extensions.set_wait_callback(wait, fd=True)
+        curs = self.conn.cursor()
+        curs.execute("select 1")
+        self.assertEqual(1, curs.fetchone()[0])
+        self.assert_(psycopg2.extensions.POLL_READ in events)
+
+    def test_error_in_fd_callback(self):
+        curs = self.conn.cursor()
+        curs.execute("select 1")  # have a BEGIN
+        curs.fetchone()
+
+        psycopg2.extensions.set_wait_callback(lambda fd, ev: 1/0, fd=True)
+        self.assertRaises(ZeroDivisionError, curs.execute, "select 2")
+
+        psycopg2.extensions.set_wait_callback(psycopg2.extensions.wait_poll)
+        self.conn.rollback()
+        curs.execute("select 2")
+        self.assertEqual(2, curs.fetchone()[0])
+
+    def test_lobject(self):
+        conn = self.conn
+        if conn.server_version < 80100:
+            return self.skipTest("large objects only supported from PG 8.1")
+        stub = self.set_stub_wait_callback(conn)
+
+        del stub.polls[:]
+        lo = conn.lobject()
+        self.assert_(stub.polls)
+        oid = lo.oid
+        data = "".join(chr(i % 256) for i in xrange(100000))
+
+        del stub.polls[:]
+        self.assertEqual(len(data), lo.write(data))
+        self.assert_(stub.polls)
+        lo.seek(10)
+        self.assertEqual(10, lo.tell())
+        del stub.polls[:]
+        self.assertEqual(data[10:20], lo.read(10))
+        self.assert_(stub.polls)
+        lo.close()
+        conn.commit()
+
+        lo = conn.lobject(oid)
+        self.assertEqual(data, lo.read())
+        lo.unlink()
+        conn.commit()
+
+    def test_lobject_error(self):
+        conn = self.conn
+        if conn.server_version < 80100:
+            return self.skipTest("large objects only supported from PG 8.1")
+        lo = conn.lobject()
+        oid = lo.oid
+        lo.unlink()
+        conn.commit()
+
+        self.assertRaises(psycopg2.OperationalError, conn.lobject, oid)
+        conn.rollback()
+        curs = conn.cursor()
+        curs.execute("select 1")
+        self.assertEqual(1, curs.fetchone()[0])
+
+
+def test_suite():
+    return unittest.TestLoader().loadTestsFromName(__name__)
+
+if __name__ == "__main__":
+    unittest.main()
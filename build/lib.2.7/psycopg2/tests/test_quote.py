@@ -0,0 +1,132 @@
+#!/usr/bin/env python
+from testutils import unittest
+
+import psycopg2
+import psycopg2.extensions
+import tests
+
+class QuotingTestCase(unittest.TestCase):
+    r"""Checks the correct quoting of strings and binary objects.
+
+    Since ver. 8.1, PostgreSQL is moving towards SQL standard conforming
+    strings, where the backslash (\) is treated as literal character,
+    not as escape. To treat the backslash as a C-style escapes, PG supports
+    the E'' quotes.
+
+    This test case checks that the E'' quotes are used whenever they are
+    needed. The tests are expected to pass with all PostgreSQL server versions
+    (currently tested with 7.4 <= PG <= 8.3beta) and with any
+    'standard_conforming_strings' server parameter value.
+    The tests also check that no warning is raised ('escape_string_warning'
+    should be on).
+
+    http://www.postgresql.org/docs/8.1/static/sql-syntax.html#SQL-SYNTAX-STRINGS
+    http://www.postgresql.org/docs/8.1/static/runtime-config-compatible.html
+    """
+    def setUp(self):
+        self.conn = psycopg2.connect(tests.dsn)
+
+    def tearDown(self):
+        self.conn.close()
+
+    def test_string(self):
+        data = """some data with \t chars
+        to escape into, 'quotes' and \\ a backslash too.
+        """
+        data += "".join(map(chr, range(1,127)))
+
+        curs = self.conn.cursor()
+        curs.execute("SELECT %s;", (data,))
+        res = curs.fetchone()[0]
+
+        self.assertEqual(res, data)
+        self.assert_(not self.conn.notices)
+
+    def test_string_alignment(self):
+        # the strings are scanned a word at time, check the tails too
+        curs = self.conn.cursor()
+        for i in range(20):
+            data = "a" * i + "'" + "b" * (19 - i)
+            q = curs.mogrify("%s", (data,))
+            self.assert_(q.endswith("'%s''%s'" % ("a" * i, "b" * (19 - i))),
+                q)
+            curs.execute("SELECT %s, %s;", (data, "'" + data + "\\"))
+            self.assertEqual((data, "'" + data + "\\"), curs.fetchone())
+
+    def test_standard_conforming_strings_changed(self):
+        # the setting is followed when changed by a query
+        curs = self.conn.cursor()
+        data = "a'b\\c"
+        for scs in ('off', 'on', 'off'):
+            curs.execute("SET standard_conforming_strings TO " + scs)
+            q = curs.mogrify("%s", (data,))
+            if scs == 'on':
+                self.assertEqual("'a''b\\c'", q)
+            else:
+                self.assertEqual("E'a''b\\\\c'", q)
+            curs.execute("SELECT %s", (data,))
+            self.assertEqual(data, curs.fetchone()[0])
+
+    def test_binary(self):
+        data = """some data with \000\013 binary
+        stuff into, 'quotes' and \\ a backslash too.
+        """
+        data += "".join(map(chr, range(256)))
+
+        curs = self.conn.cursor()
+        curs.execute("SELECT %s::bytea;", (psycopg2.Binary(data),))
+        res = str(curs.fetchone()[0])
+
+        self.assertEqual(res, data)
+        self.assert_(not self.conn.notices)
+
+    def test_unicode(self):
+        curs = self.conn.cursor()
+        curs.execute("SHOW server_encoding")
+        server_encoding = curs.fetchone()[0]
+        if server_encoding != "UTF8":
+            return self.skipTest(
+                "Unicode test skipped since server encoding is %s"
+                    % server_encoding)
+
+        data = u"""some data with \t chars
+        to escape into, 'quotes', \u20ac euro sign and \\ a backslash too.
+        """
+        data += u"".join(map(unichr, [ u for u in range(1,65536)
+            if not 0xD800 <= u <= 0xDFFF ]))    # surrogate area
+        self.conn.set_client_encoding('UNICODE')
+
+        psycopg2.extensions.register_type(psycopg2.extensions.UNICODE)
+        curs.execute("SELECT %s::text;", (data,))
+        res = curs.fetchone()[0]
+
+        self.assertEqual(res, data)
+        self.assert_(not self.conn.notices)
+
+    def test_builtin_as_adapter(self):
+        # str, unicode and buffer are quoted without creating the adapter:
+        # the result must be the same
+        curs = self.conn.cursor()
+        ext = psycopg2.extensions
+        for obj in ["x'\\y", u"\xe0'", buffer("a\x00'b"), buffer("")]:
+            a = ext.adapt(obj)
+            a.prepare(self.conn)
+            self.assertEqual(a.getquoted(), curs.mogrify("%s", (obj,)))
+
+    def test_builtin_adapter_override(self):
+        curs = self.conn.cursor()
+        ext = psycopg2.extensions
+        orig = ext.adapters[(buffer, ext.ISQLQuote)]
+        ext.register_adapter(buffer, lambda b: ext.AsIs("'buf'"))
+        try:
+            self.assertEqual("'buf'", curs.mogrify("%s", (buffer("x"),)))
+        finally:
+            ext.register_adapter(buffer, orig)
+        self.assertNotEqual("'buf'", curs.mogrify("%s", (buffer("x"),)))
+
+def test_suite():
+    return unittest.TestLoader().loadTestsFromName(__name__)
+
+if __name__ == "__main__":
+    unittest.main()
+
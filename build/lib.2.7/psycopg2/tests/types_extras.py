@@ -0,0 +1,652 @@
+#!/usr/bin/env python
+#
+# types_extras.py - tests for extras types conversions
+#
+# Copyright (C) 2008-2010 Federico Di Gregorio  <fog@debian.org>
+#
+# psycopg2 is free software: you can redistribute it and/or modify it
+# under the terms of the GNU Lesser General Public License as published
+# by the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# psycopg2 is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+# License for more details.
+
+try:
+    import decimal
+except:
+    pass
+import re
+import sys
+from testutils import unittest
+
+import psycopg2
+import psycopg2.extras
+import tests
+
+
+def skip_if_no_uuid(f):
+    def skip_if_no_uuid_(self):
+        try:
+            import uuid
+        except ImportError:
+            return self.skipTest("uuid not available in this Python version")
+
+        try:
+            cur = self.conn.cursor()
+            cur.execute("select typname from pg_type where typname = 'uuid'")
+            has = cur.fetchone()
+        finally:
+            self.conn.rollback()
+
+        if has:
+            return f(self)
+        else:
+            return self.skipTest("uuid type not available on the server")
+
+    return skip_if_no_uuid_
+
+def filter_scs(conn, s):
+    if conn.get_parameter_status("standard_conforming_strings") == 'off':
+        return s
+    else:
+        return s.replace("E'", "'")
+
+class TypesExtrasTests(unittest.TestCase):
+    """Test that all type conversions are working."""
+
+    def setUp(self):
+        self.conn = psycopg2.connect(tests.dsn)
+
+    def tearDown(self):
+        self.conn.close()
+
+    def execute(self, *args):
+        curs = self.conn.cursor()
+        curs.execute(*args)
+        return curs.fetchone()[0]
+
+    @skip_if_no_uuid
+    def testUUID(self):
+        import uuid
+        psycopg2.extras.register_uuid()
+        u = uuid.UUID('9c6d5a77-7256-457e-9461-347b4358e350')
+        s = self.execute("SELECT %s AS foo", (u,))
+        self.failUnless(u == s)
+        # must survive NULL cast to a uuid
+        s = self.execute("SELECT NULL::uuid AS foo")
+        self.failUnless(s is None)
+
+    @skip_if_no_uuid
+    def testUUIDARRAY(self):
+        import uuid
+        psycopg2.extras.register_uuid()
+        u = [uuid.UUID('9c6d5a77-7256-457e-9461-347b4358e350'), uuid.UUID('9c6d5a77-7256-457e-9461-347b4358e352')]
+        s = self.execute("SELECT %s AS foo", (u,))
+        self.failUnless(u == s)
+        # array with a NULL element
+        u = [uuid.UUID('9c6d5a77-7256-457e-9461-347b4358e350'), None]
+        s = self.execute("SELECT %s AS foo", (u,))
+        self.failUnless(u == s)
+        # must survive NULL cast to a uuid[]
+        s = self.execute("SELECT NULL::uuid[] AS foo")
+        self.failUnless(s is None)
+        # what about empty arrays?
+        s = self.execute("SELECT '{}'::uuid[] AS foo")
+        self.failUnless(type(s) == list and len(s) == 0)
+
+    @skip_if_no_uuid
+    def testUUIDBinary(self):
+        import uuid
+        psycopg2.extras.register_uuid(conn_or_curs=self.conn)
+        curs = self.conn.cursor()
+        curs.binary = True
+        u = uuid.UUID('9c6d5a77-7256-457e-9461-347b4358e350')
+        curs.execute("SELECT %s, %s, NULL::uuid", (u, [u, None]))
+        self.assertEqual(curs.fetchone(), (u, [u, None], None))
+
+    def test_uuid_cast_c(self):
+        import uuid
+        from psycopg2._psycopg import UUID, UUIDARRAY
+        s = '9c6d5a77-7256-457e-9461-347b4358e350'
+        u = uuid.UUID(s)
+
+        self.assert_(UUID(None, None) is None)
+        for v in (s, s.upper(), '{%s}' % s, s.replace('-', ''), u.bytes):
+            r = UUID(v, None)
+            self.assert_(isinstance(r, uuid.UUID))
+            self.assertEqual(r, u)
+            self.assertEqual(str(r), s)
+
+        for v in ('', 'x', s[:-1], s + '0', s.replace('5', 'g')):
+            self.assertRaises(psycopg2.DataError, UUID, v, None)
+
+        self.assertEqual(UUIDARRAY('{%s,NULL}' % s, None), [u, None])
+        self.assertEqual(UUIDARRAY('{}', None), [])
+
+    def test_uuid_adapt_c(self):
+        import uuid
+        from psycopg2._psycopg import Uuid
+        s = '9c6d5a77-7256-457e-9461-347b4358e350'
+        self.assertEqual(Uuid(uuid.UUID(s)).getquoted(), "'%s'::uuid" % s)
+        self.assert_(Uuid(uuid.UUID(s)).adapted is not None)
+
+    def test_inet_cast_c(self):
+        from psycopg2._psycopg import INET, INETARRAY
+        from psycopg2.extras import Inet
+
+        self.assert_(INET(None, None) is None)
+        i = INET('192.168.1.0/24', None)
+        self.assert_(isinstance(i, Inet))
+        self.assertEqual(i.addr, '192.168.1.0/24')
+        self.assertEqual(str(i), '192.168.1.0/24')
+        self.assertEqual(repr(i), "Inet('192.168.1.0/24')")
+
+        a = INETARRAY('{10.0.0.1,NULL,::1/128}', None)
+        self.assertEqual([x and x.addr for x in a],
+            ['10.0.0.1', None, '::1/128'])
+
+    def test_inet_adapt_c(self):
+        from psycopg2.extras import Inet
+        i = Inet("192.168.1.0/24")
+        self.assertEqual(i.getquoted(), "'192.168.1.0/24'::inet")
+        i.addr = "10.0.0.1"
+        self.assertEqual(i.getquoted(), "'10.0.0.1'::inet")
+        self.assert_(psycopg2.extensions.adapt(i) is i)
+
+        class MyInet(Inet):
+            def __init__(self):
+                pass
+
+        self.assertRaises(psycopg2.InterfaceError, MyInet().getquoted)
+
+    def testCIDR(self):
+        psycopg2.extras.register_inet()
+        s = self.execute("SELECT '192.168.1.0/24'::cidr AS foo")
+        self.assertEqual(s.addr, '192.168.1.0/24')
+        s = self.execute("SELECT '{10.0.0.1,NULL}'::inet[] AS foo")
+        self.assertEqual(s[0].addr, '10.0.0.1')
+        self.assert_(s[1] is None)
+
+    def testINET(self):
+        psycopg2.extras.register_inet()
+        i = "192.168.1.0/24";
+        s = self.execute("SELECT %s AS foo", (i,))
+        self.failUnless(i == s)
+        # must survive NULL cast to inet
+        s = self.execute("SELECT NULL::inet AS foo")
+        self.failUnless(s is None)
+
+    def test_inet_conform(self):
+        from psycopg2.extras import Inet
+        i = Inet("192.168.1.0/24")
+        a = psycopg2.extensions.adapt(i)
+        a.prepare(self.conn)
+        self.assertEqual(
+            filter_scs(self.conn, "E'192.168.1.0/24'::inet"),
+            a.getquoted())
+
+        # adapts ok with unicode too
+        i = Inet(u"192.168.1.0/24")
+        a = psycopg2.extensions.adapt(i)
+        a.prepare(self.conn)
+        self.assertEqual(
+            filter_scs(self.conn, "E'192.168.1.0/24'::inet"),
+            a.getquoted())
+
+    def test_adapt_fail(self):
+        class Foo(object): pass
+        self.assertRaises(psycopg2.ProgrammingError,
+            psycopg2.extensions.adapt, Foo(), psycopg2.extensions.ISQLQuote, None)
+        try:
+            psycopg2.extensions.adapt(Foo(), psycopg2.extensions.ISQLQuote, None)
+        except psycopg2.ProgrammingError, err:
+            self.failUnless(str(err) == "can't adapt type 'Foo'")
+
+
+def skip_if_no_hstore(f):
+    def skip_if_no_hstore_(self):
+        from psycopg2.extras import HstoreAdapter
+        oids = HstoreAdapter.get_oids(self.conn)
+        if oids is None:
+            return self.skipTest("hstore not available in test database")
+        return f(self)
+
+    return skip_if_no_hstore_
+
+class HstoreTestCase(unittest.TestCase):
+    def setUp(self):
+        self.conn = psycopg2.connect(tests.dsn)
+
+    def tearDown(self):
+        self.conn.close()
+
+    def test_adapt_8(self):
+        if self.conn.server_version >= 90000:
+            return self.skipTest("skipping dict adaptation with PG pre-9 syntax")
+
+        from psycopg2.extras import HstoreAdapter
+
+        o = {'a': '1', 'b': "'", 'c': None}
+        if self.conn.encoding == 'UTF8':
+            o['d'] = u'\xe0'
+
+        a = HstoreAdapter(o)
+        a.prepare(self.conn)
+        q = a.getquoted()
+
+        self.assert_(q.startswith("(("), q)
+        self.assert_(q.endswith("))"), q)
+        ii = q[1:-1].split("||")
+        ii.sort()
+
+        self.assertEqual(len(ii), len(o))
+        self.assertEqual(ii[0], filter_scs(self.conn, "(E'a' => E'1')"))
+        self.assertEqual(ii[1], filter_scs(self.conn, "(E'b' => E'''')"))
+        self.assertEqual(ii[2], filter_scs(self.conn, "(E'c' => NULL)"))
+        if 'd' in o:
+            encc = u'\xe0'.encode(psycopg2.extensions.encodings[self.conn.encoding])
+            self.assertEqual(ii[3], filter_scs(self.conn, "(E'd' => E'%s')" % encc))
+
+    def test_adapt_9(self):
+        if self.conn.server_version < 90000:
+            return self.skipTest("skipping dict adaptation with PG 9 syntax")
+
+        from psycopg2.extras import HstoreAdapter
+
+        o = {'a': '1', 'b': "'", 'c': None}
+        if self.conn.encoding == 'UTF8':
+            o['d'] = u'\xe0'
+
+        a = HstoreAdapter(o)
+        a.prepare(self.conn)
+        q = a.getquoted()
+
+        m = re.match(r'hstore\(ARRAY\[([^\]]+)\], ARRAY\[([^\]]+)\]\)', q)
+        self.assert_(m, repr(q))
+
+        kk = m.group(1).split(", ")
+        vv = m.group(2).split(", ")
+        ii = zip(kk, vv)
+        ii.sort()
+
+        self.assertEqual(len(ii), len(o))
+        self.assertEqual(ii[0], ("E'a'", "E'1'"))
+        self.assertEqual(ii[1], ("E'b'", "E''''"))
+        self.assertEqual(ii[2], ("E'c'", "NULL"))
+        if 'd' in o:
+            encc = u'\xe0'.encode(psycopg2.extensions.encodings[self.conn.encoding])
+            self.assertEqual(ii[3], ("E'd'", "E'%s'" % encc))
+
+    def test_parse(self):
+        from psycopg2.extras import HstoreAdapter
+
+        def ok(s, d):
+            self.assertEqual(HstoreAdapter.parse(s, None), d)
+
+        ok(None, None)
+        ok('', {})
+        ok('"a"=>"1", "b"=>"2"', {'a': '1', 'b': '2'})
+        ok('"a"  => "1" ,"b"  =>  "2"', {'a': '1', 'b': '2'})
+        ok('"a"=>NULL, "b"=>"2"', {'a': None, 'b': '2'})
+        ok(r'"a"=>"\"", "\""=>"2"', {'a': '"', '"': '2'})
+        ok('"a"=>"\'", "\'"=>"2"', {'a': "'", "'": '2'})
+        ok('"a"=>"1", "b"=>NULL', {'a': '1', 'b': None})
+        ok(r'"a\\"=>"1"', {'a\\': '1'})
+        ok(r'"a\""=>"1"', {'a"': '1'})
+        ok(r'"a\\\""=>"1"', {r'a\"': '1'})
+        ok(r'"a\\\\\""=>"1"', {r'a\\"': '1'})
+
+        def ko(s):
+            self.assertRaises(psycopg2.InterfaceError,
+                HstoreAdapter.parse, s, None)
+
+        ko('a')
+        ko('"a"')
+        ko(r'"a\\""=>"1"')
+        ko(r'"a\\\\""=>"1"')
+        ko('"a=>"1"')
+        ko('"a"=>"1", "b"=>NUL')
+
+    def test_parse_c(self):
+        from psycopg2._psycopg import HSTORE
+
+        def ok(s, d):
+            self.assertEqual(HSTORE(s, None), d)
+
+        ok(None, None)
+        ok('', {})
+        ok('"a"=>"1", "b"=>"2"', {'a': '1', 'b': '2'})
+        ok('"a"  => "1" ,"b"  =>  "2"', {'a': '1', 'b': '2'})
+        ok('"a"=>NULL, "b"=>"2"', {'a': None, 'b': '2'})
+        ok(r'"a"=>"\"", "\""=>"2"', {'a': '"', '"': '2'})
+        ok('"a"=>"\'", "\'"=>"2"', {'a': "'", "'": '2'})
+        ok('"a"=>"1", "b"=>NULL', {'a': '1', 'b': None})
+        ok(r'"a\\"=>"1"', {'a\\': '1'})
+        ok(r'"a\""=>"1"', {'a"': '1'})
+        ok(r'"a\\\""=>"1"', {r'a\"': '1'})
+        ok(r'"a\\\\\""=>"1"', {r'a\\"': '1'})
+
+        def ko(s):
+            self.assertRaises(psycopg2.InterfaceError, HSTORE, s, None)
+
+        ko('a')
+        ko('"a"')
+        ko(r'"a\\""=>"1"')
+        ko(r'"a\\\\""=>"1"')
+        ko('"a=>"1"')
+        ko('"a"=>"1", "b"=>NUL')
+
+    def test_parse_c_unicode(self):
+        from psycopg2._psycopg import UNICODEHSTORE
+        d = UNICODEHSTORE('"a"=>"\xe2\x82\xac", "b"=>NULL', None)
+        self.assertEqual(d, {u'a': u'\u20ac', u'b': None})
+        self.assert_(isinstance(d.keys()[0], unicode))
+
+    def test_parse_binary(self):
+        from psycopg2._psycopg import HSTORE
+        import struct
+
+        def pack(d):
+            rv = [struct.pack('!i', len(d))]
+            for k, v in sorted(d.items()):
+                rv.append(struct.pack('!i', len(k)) + k)
+                if v is None:
+                    rv.append(struct.pack('!i', -1))
+                else:
+                    rv.append(struct.pack('!i', len(v)) + v)
+            return ''.join(rv)
+
+        for d in ({}, {'a': '1', 'b': None}, {'': '', '"\\': '\x00=>'}):
+            self.assertEqual(HSTORE(pack(d), None), d)
+
+        self.assertRaises(psycopg2.DataError,
+            HSTORE, pack({'a': '1'})[:-1], None)
+        self.assertRaises(psycopg2.DataError,
+            HSTORE, pack({'a': '1'}) + 'x', None)
+
+    def test_adapt_c(self):
+        from psycopg2._psycopg import Hstore, HSTORE
+
+        self.assertEqual(Hstore({}).getquoted(), "''::hstore")
+
+        o = {'a': '1', 'b': "'", 'c': None, 'd': '"'}
+        q = Hstore(o).getquoted()
+        self.assert_(q.endswith("::hstore"), q)
+        # unquote the sql string to parse it back
+        s = q[:-len("::hstore")]
+        s = s[s.index("'") + 1:-1].replace("''", "'").replace('\\\\', '\\')
+        self.assertEqual(HSTORE(s, None), o)
+
+        self.assertRaises(psycopg2.ProgrammingError,
+            Hstore({'a': 1}).getquoted)
+        self.assertRaises(psycopg2.DataError,
+            Hstore({'a': 'x\x00y'}).getquoted)
+        self.assertRaises(psycopg2.DataError,
+            Hstore({'a\x00"': None}).getquoted)
+
+    @skip_if_no_hstore
+    def test_register_conn(self):
+        from psycopg2.extras import register_hstore
+
+        register_hstore(self.conn)
+        cur = self.conn.cursor()
+        cur.execute("select null::hstore, ''::hstore, 'a => b'::hstore")
+        t = cur.fetchone()
+        self.assert_(t[0] is None)
+        self.assertEqual(t[1], {})
+        self.assertEqual(t[2], {'a': 'b'})
+
+    @skip_if_no_hstore
+    def test_register_curs(self):
+        from psycopg2.extras import register_hstore
+
+        cur = self.conn.cursor()
+        register_hstore(cur)
+        cur.execute("select null::hstore, ''::hstore, 'a => b'::hstore")
+        t = cur.fetchone()
+        self.assert_(t[0] is None)
+        self.assertEqual(t[1], {})
+        self.assertEqual(t[2], {'a': 'b'})
+
+    @skip_if_no_hstore
+    def test_register_unicode(self):
+        from psycopg2.extras import register_hstore
+
+        register_hstore(self.conn, unicode=True)
+        cur = self.conn.cursor()
+        cur.execute("select null::hstore, ''::hstore, 'a => b'::hstore")
+        t = cur.fetchone()
+        self.assert_(t[0] is None)
+        self.assertEqual(t[1], {})
+        self.assertEqual(t[2], {u'a': u'b'})
+        self.assert_(isinstance(t[2].keys()[0], unicode))
+        self.assert_(isinstance(t[2].values()[0], unicode))
+
+    @skip_if_no_hstore
+    def test_register_globally(self):
+        from psycopg2.extras import register_hstore, HstoreAdapter
+
+        oids = HstoreAdapter.get_oids(self.conn)
+        try:
+            register_hstore(self.conn, globally=True)
+            conn2 = psycopg2.connect(self.conn.dsn)
+            try:
+                cur2 = self.conn.cursor()
+                cur2.execute("select 'a => b'::hstore")
+                r = cur2.fetchone()
+                self.assert_(isinstance(r[0], dict))
+            finally:
+                conn2.close()
+        finally:
+            psycopg2.extensions.string_types.pop(oids[0])
+            psycopg2.extensions.binary_types.pop(oids[0])
+
+        # verify the caster is not around anymore
+        cur = self.conn.cursor()
+        cur.execute("select 'a => b'::hstore")
+        r = cur.fetchone()
+        self.assert_(isinstance(r[0], str))
+
+    @skip_if_no_hstore
+    def test_roundtrip(self):
+        from psycopg2.extras import register_hstore
+        register_hstore(self.conn)
+        cur = self.conn.cursor()
+
+        def ok(d):
+            cur.execute("select %s", (d,))
+            d1 = cur.fetchone()[0]
+            self.assertEqual(len(d), len(d1))
+            for k in d:
+                self.assert_(k in d1, k)
+                self.assertEqual(d[k], d1[k])
+
+        ok({})
+        ok({'a': 'b', 'c': None})
+
+        ab = map(chr, range(32, 128))
+        ok(dict(zip(ab, ab)))
+        ok({''.join(ab): ''.join(ab)})
+
+        self.conn.set_client_encoding('latin1')
+        ab = map(chr, range(1, 256))
+        ok({''.join(ab): ''.join(ab)})
+        ok(dict(zip(ab, ab)))
+
+    @skip_if_no_hstore
+    def test_roundtrip_unicode(self):
+        from psycopg2.extras import register_hstore
+        register_hstore(self.conn, unicode=True)
+        cur = self.conn.cursor()
+
+        def ok(d):
+            cur.execute("select %s", (d,))
+            d1 = cur.fetchone()[0]
+            self.assertEqual(len(d), len(d1))
+            for k, v in d1.iteritems():
+                self.assert_(k in d, k)
+                self.assertEqual(d[k], v)
+                self.assert_(isinstance(k, unicode))
+                self.assert_(v is None or isinstance(v, unicode))
+
+        ok({})
+        ok({'a': 'b', 'c': None, 'd': u'\u20ac', u'\u2603': 'e'})
+
+        ab = map(unichr, range(1, 1024))
+        ok({u''.join(ab): u''.join(ab)})
+        ok(dict(zip(ab, ab)))
+
+    @skip_if_no_hstore
+    def test_roundtrip_binary(self):
+        from psycopg2.extras import register_hstore
+        register_hstore(self.conn)
+        cur = self.conn.cursor()
+        cur.binary = True
+
+        for d in ({}, {'a': 'b', 'c': None}, {'"\\': "'=>,"}):
+            cur.execute("select %s", (d,))
+            self.assertEqual(cur.fetchone()[0], d)
+
+
+class CompositeTestCase(unittest.TestCase):
+    def setUp(self):
+        self.conn = psycopg2.connect(tests.dsn)
+
+    def tearDown(self):
+        self.conn.close()
+
+    def test_cast_c(self):
+        from psycopg2.extensions import new_composite_type
+        # int4, text, date, int4[]
+        c = new_composite_type((99999,), "TEST", (23, 25, 1082, 1007))
+
+        def ok(s, t):
+            self.assertEqual(c(s, None), t)
+
+        import datetime
+        ok(None, None)
+        ok('(1,abc,2010-01-02,"{1,2}")',
+            (1, 'abc', datetime.date(2010, 1, 2), [1, 2]))
+        ok('(,"",,)', (None, '', None, None))
+        ok(r'(1,"a ""b"" \\c, d",,)', (1, r'a "b" \c, d', None, None))
+        ok(r'(1,a\,b,,)', (1, 'a,b', None, None))
+
+        def ko(s):
+            self.assertRaises(psycopg2.DataError, c, s, None)
+
+        ko('')
+        ko('1,2,3,4')
+        ko('(1,2)')
+        ko('(1,a,,,)')
+        ko('(1,"a,,)')
+
+    def test_cast_c_factory(self):
+        from psycopg2.extensions import new_composite_type, new_array_type
+
+        class Point(object):
+            def __init__(self, x, y):
+                self.x = x
+                self.y = y
+
+        c = new_composite_type((99999,), "POINT", (23, 23), Point)
+        p = c('(10,20)', None)
+        self.assert_(isinstance(p, Point))
+        self.assertEqual((p.x, p.y), (10, 20))
+
+        a = new_array_type((99998,), "POINTARRAY", c)
+        ps = a(r'{"(1,2)",NULL,"(3,)"}', None)
+        self.assertEqual(len(ps), 3)
+        self.assertEqual((ps[0].x, ps[0].y), (1, 2))
+        self.assert_(ps[1] is None)
+        self.assertEqual((ps[2].x, ps[2].y), (3, None))
+
+        self.assertRaises(TypeError, new_composite_type,
+            (99999,), "BAD", ('int4',))
+        self.assertRaises(TypeError, new_composite_type,
+            (99999,), "BAD", (23,), 42)
+
+    def _create_type(self, name, fields):
+        curs = self.conn.cursor()
+        try:
+            curs.execute("drop type %s cascade;" % name)
+        except psycopg2.ProgrammingError:
+            self.conn.rollback()
+
+        curs.execute("create type %s as (%s);" % (name,
+            ", ".join(["%s %s" % p for p in fields])))
+        if '.' in name:
+            schema, name = name.split('.')
+        else:
+            schema = 'public'
+
+        curs.execute("""\
+            SELECT t.oid
+            FROM pg_type t JOIN pg_namespace ns ON typnamespace = ns.oid
+            WHERE typname = %s and nspname = %s;
+            """, (name, schema))
+        return curs.fetchone()[0]
+
+    def test_register_on_connection(self):
+        from psycopg2.extras import register_composite
+        oid = self._create_type("type_ii", [("a", "integer"), ("b", "integer")])
+
+        t = register_composite("type_ii", self.conn)
+        self.assertEqual(t.name, 'type_ii')
+        self.assertEqual(t.oid, oid)
+        self.assertEqual(t.attnames, ['a', 'b'])
+        self.assertEqual(t.atttypes, [23, 23])
+
+        curs = self.conn.cursor()
+        curs.execute("select (1,2)::type_ii, null::type_ii")
+        self.assertEqual(curs.fetchone(), ((1, 2), None))
+
+        # the array too
+        curs.execute("select array[(1,2),(3,4),null]::type_ii[]")
+        self.assertEqual(curs.fetchone()[0], [(1, 2), (3, 4), None])
+
+    def test_register_nested(self):
+        from psycopg2.extras import register_composite
+        self._create_type("type_is", [("anint", "integer"), ("astring", "text")])
+        self._create_type("type_r_ft",
+            [("afloat", "float8"), ("anotherpair", "type_is")])
+
+        register_composite("type_is", self.conn)
+        register_composite("type_r_ft", self.conn)
+
+        curs = self.conn.cursor()
+        r = (0.25, (42, 'hello "world"'))
+        curs.execute("select %s::type_r_ft;", (r,))
+        self.assertEqual(curs.fetchone()[0], r)
+
+    def test_register_factory(self):
+        from psycopg2.extras import register_composite
+        try:
+            from collections import namedtuple
+        except ImportError:
+            return self.skipTest("namedtuple not available")
+
+        self._create_type("type_ii", [("a", "integer"), ("b", "integer")])
+        Pair = namedtuple('Pair', 'a b')
+        register_composite("type_ii", self.conn, factory=Pair)
+
+        curs = self.conn.cursor()
+        curs.execute("select (1,2)::type_ii")
+        p = curs.fetchone()[0]
+        self.assert_(isinstance(p, Pair))
+        self.assertEqual((p.a, p.b), (1, 2))
+
+    def test_not_composite(self):
+        from psycopg2.extras import register_composite
+        self.assertRaises(psycopg2.ProgrammingError,
+            register_composite, 'int4', self.conn)
+
+
+def test_suite():
+    return unittest.TestLoader().loadTestsFromName(__name__)
+
+if __name__ == "__main__":
+    unittest.main()
+
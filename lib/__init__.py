@@ -78,10 +78,5 @@ from _psycopg import NotSupportedError, OperationalError
 from _psycopg import connect, apilevel, threadsafety, paramstyle
 from _psycopg import __version__
 
-# Register default adapters.
-
-import psycopg2.extensions as _ext
-_ext.register_adapter(tuple, _ext.SQL_IN)
-
 __all__ = filter(lambda k: not k.startswith('_'), locals().keys())
 
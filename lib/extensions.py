@@ -33,11 +33,11 @@ This module holds all the extensions to the DBAPI-2.0 provided by psycopg.
 # License for more details.
 
 from _psycopg import UNICODE, INTEGER, LONGINTEGER, BOOLEAN, FLOAT
-from _psycopg import TIME, DATE, INTERVAL, DECIMAL
+from _psycopg import TIME, DATE, INTERVAL, DECIMAL, NATIVENUMERIC
 from _psycopg import BINARYARRAY, BOOLEANARRAY, DATEARRAY, DATETIMEARRAY
 from _psycopg import DECIMALARRAY, FLOATARRAY, INTEGERARRAY, INTERVALARRAY
 from _psycopg import LONGINTEGERARRAY, ROWIDARRAY, STRINGARRAY, TIMEARRAY
-from _psycopg import UNICODEARRAY
+from _psycopg import UNICODEARRAY, INTEGERARRAYBUFFER, FLOATARRAYBUFFER
 
 from _psycopg import Binary, Boolean, Float, QuotedString, AsIs
 try:
@@ -58,12 +58,17 @@ except:
 
 from _psycopg import adapt, adapters, encodings, connection, cursor, lobject, Xid
 from _psycopg import string_types, binary_types, new_type, register_type
-from _psycopg import ISQLQuote, Notify
+from _psycopg import new_array_type, new_composite_type
+from _psycopg import register_adapter
+from _psycopg import List as _List
+from _psycopg import ISQLQuote, Notify, LazyRow, ResultCache
+from _psycopg import connect_fastest
+from _psycopg import tpc_prepare_all, tpc_commit_all, tpc_rollback_all
 
 from _psycopg import QueryCanceledError, TransactionRollbackError
 
 try:
-    from _psycopg import set_wait_callback, get_wait_callback
+    from _psycopg import set_wait_callback, get_wait_callback, wait_poll
 except ImportError:
     pass
 
@@ -100,30 +105,25 @@ TRANSACTION_STATUS_INTRANS = 2
 TRANSACTION_STATUS_INERROR = 3
 TRANSACTION_STATUS_UNKNOWN = 4
 
-def register_adapter(typ, callable):
-    """Register 'callable' as an ISQLQuote adapter for type 'typ'."""
-    adapters[(typ, ISQLQuote)] = callable
 
-
-# The SQL_IN class is the official adapter for tuples starting from 2.0.6.
+# The SQL_IN class was the official adapter for tuples from 2.0.6: the
+# tuples are now adapted by the List adapter, that SQL_IN wraps.
 class SQL_IN(object):
     """Adapt any iterable to an SQL quotable object."""
     
     def __init__(self, seq):
         self._seq = seq
+        self._conn = None
 
     def prepare(self, conn):
         self._conn = conn
     
     def getquoted(self):
-        # this is the important line: note how every object in the
-        # list is adapted and then how getquoted() is called on it
-        pobjs = [adapt(o) for o in self._seq]
-        for obj in pobjs:
-            if hasattr(obj, 'prepare'):
-                obj.prepare(self._conn)
-        qobjs = [str(o.getquoted()) for o in pobjs]
-        return '(' + ', '.join(qobjs) + ')'
+        # every object in the sequence is adapted and quoted by List
+        obj = _List(tuple(self._seq))
+        if self._conn is not None:
+            obj.prepare(self._conn)
+        return obj.getquoted()
 
     __str__ = getquoted
 
@@ -41,6 +41,8 @@ from psycopg2 import extensions as _ext
 from psycopg2.extensions import cursor as _cursor
 from psycopg2.extensions import connection as _connection
 from psycopg2.extensions import adapt as _A
+from psycopg2 import _psycopg
+from psycopg2._psycopg import DictRow, RealDictRow
 
 
 class DictCursorBase(_cursor):
@@ -112,79 +114,26 @@ class DictCursor(DictCursorBase):
     def __init__(self, *args, **kwargs):
         kwargs['row_factory'] = DictRow
         DictCursorBase.__init__(self, *args, **kwargs)
-        self._prefetch = 1
 
-    def execute(self, query, vars=None):
-        self.index = {}
-        self._query_executed = 1
-        return _cursor.execute(self, query, vars)
-
-    def callproc(self, procname, vars=None):
-        self.index = {}
-        self._query_executed = 1
-        return _cursor.callproc(self, procname, vars)
-
-    def _build_index(self):
-        if self._query_executed == 1 and self.description:
-            for i in range(len(self.description)):
-                self.index[self.description[i][0]] = i
-            self._query_executed = 0
-
-class DictRow(list):
-    """A row object that allow by-colmun-name access to data."""
-
-    __slots__ = ('_index',)
-
-    def __init__(self, cursor):
-        self._index = cursor.index
-        self[:] = [None] * len(cursor.description)
-
-    def __getitem__(self, x):
-        if type(x) != int:
-            x = self._index[x]
-        return list.__getitem__(self, x)
-
-    def __setitem__(self, x, v):
-        if type(x) != int:
-            x = self._index[x]
-        list.__setitem__(self, x, v)
-
-    def items(self):
-        res = []
-        for n, v in self._index.items():
-            res.append((n, list.__getitem__(self, v)))
-        return res
+    # the rows are built in C: no need to prepare anything before fetching
+    fetchone = _cursor.fetchone
+    fetchmany = _cursor.fetchmany
+    fetchall = _cursor.fetchall
+    next = _cursor.next
 
-    def keys(self):
-        return self._index.keys()
+    _index_desc = _index = None
 
-    def values(self):
-        return tuple(self[:])
+    def _get_index(self):
+        # rebuilt only when a new description is available
+        desc = self.description
+        if desc is not self._index_desc or self._index is None:
+            index = {}
+            for i, d in enumerate(desc or ()):
+                index[d[0]] = i
+            self._index_desc, self._index = desc, index
+        return self._index
 
-    def has_key(self, x):
-        return self._index.has_key(x)
-
-    def get(self, x, default=None):
-        try:
-            return self[x]
-        except:
-            return default
-
-    def iteritems(self):
-        for n, v in self._index.items():
-            yield n, list.__getitem__(self, v)
-
-    def iterkeys(self):
-        return self._index.iterkeys()
-
-    def itervalues(self):
-        return list.__iter__(self)
-
-    def copy(self):
-        return dict(self.items())
-
-    def __contains__(self, x):
-        return self._index.__contains__(x)
+    index = property(_get_index)
 
 class RealDictConnection(_connection):
     """A connection that uses `RealDictCursor` automatically."""
@@ -206,37 +155,16 @@ class RealDictCursor(DictCursorBase):
     def __init__(self, *args, **kwargs):
         kwargs['row_factory'] = RealDictRow
         DictCursorBase.__init__(self, *args, **kwargs)
-        self._prefetch = 0
-
-    def execute(self, query, vars=None):
-        self.column_mapping = []
-        self._query_executed = 1
-        return _cursor.execute(self, query, vars)
 
-    def callproc(self, procname, vars=None):
-        self.column_mapping = []
-        self._query_executed = 1
-        return _cursor.callproc(self, procname, vars)
+    fetchone = _cursor.fetchone
+    fetchmany = _cursor.fetchmany
+    fetchall = _cursor.fetchall
+    next = _cursor.next
 
-    def _build_index(self):
-        if self._query_executed == 1 and self.description:
-            for i in range(len(self.description)):
-                self.column_mapping.append(self.description[i][0])
-            self._query_executed = 0
+    def _get_column_mapping(self):
+        return [d[0] for d in self.description or ()]
 
-class RealDictRow(dict):
-    """A ``dict`` subclass representing a data record."""
-
-    __slots__ = ('_column_mapping')
-
-    def __init__(self, cursor):
-        dict.__init__(self)
-        self._column_mapping = cursor.column_mapping
-
-    def __setitem__(self, name, value):
-        if type(name) == int:
-            name = self._column_mapping[name]
-        return dict.__setitem__(self, name, value)
+    column_mapping = property(_get_column_mapping)
 
 
 class NamedTupleConnection(_connection):
@@ -267,42 +195,59 @@ class NamedTupleCursor(_cursor):
     Record = None
 
     def execute(self, query, vars=None):
-        self.Record = None
+        self._reset_record()
         return _cursor.execute(self, query, vars)
 
     def executemany(self, query, vars):
-        self.Record = None
-        return _cursor.executemany(self, vars)
+        self._reset_record()
+        return _cursor.executemany(self, query, vars)
 
     def callproc(self, procname, vars=None):
-        self.Record = None
+        self._reset_record()
         return _cursor.callproc(self, procname, vars)
 
+    # Once the Record class is known it is used as row_factory, so that the
+    # records are created in C. Named cursors have no description before the
+    # first fetch: the first rows are converted from tuples.
+
     def fetchone(self):
+        if self.Record is None and self.description is not None:
+            self._set_record()
         t = _cursor.fetchone(self)
-        if t is not None:
-            nt = self.Record
-            if nt is None:
-                nt = self.Record = self._make_nt()
-            return nt(*t)
+        if t is not None and self.Record is None:
+            t = self._set_record()._make(t)
+        return t
 
     def fetchmany(self, size=None):
-        nt = self.Record
-        if nt is None:
-            nt = self.Record = self._make_nt()
+        if self.Record is None and self.description is not None:
+            self._set_record()
         ts = _cursor.fetchmany(self, size)
-        return [nt(*t) for t in ts]
+        if ts and self.Record is None:
+            nt = self._set_record()
+            ts = [nt._make(t) for t in ts]
+        return ts
 
     def fetchall(self):
-        nt = self.Record
-        if nt is None:
-            nt = self.Record = self._make_nt()
+        if self.Record is None and self.description is not None:
+            self._set_record()
         ts = _cursor.fetchall(self)
-        return [nt(*t) for t in ts]
+        if ts and self.Record is None:
+            nt = self._set_record()
+            ts = [nt._make(t) for t in ts]
+        return ts
 
     def __iter__(self):
         return iter(self.fetchall())
 
+    def _reset_record(self):
+        self.Record = None
+        self.row_factory = None
+
+    def _set_record(self):
+        nt = self.Record = self._make_nt()
+        self.row_factory = nt
+        return nt
+
     try:
         from collections import namedtuple
     except ImportError, _exc:
@@ -313,6 +258,23 @@ class NamedTupleCursor(_cursor):
             return namedtuple("Record", [d[0] for d in self.description or ()])
 
 
+class LazyDictConnection(_connection):
+    """A connection that uses `LazyDictCursor` automatically."""
+    def cursor(self, *args, **kwargs):
+        kwargs['cursor_factory'] = LazyDictCursor
+        return _connection.cursor(self, *args, **kwargs)
+
+class LazyDictCursor(_cursor):
+    """A cursor returning `~psycopg2.extensions.LazyRow` objects.
+
+    The rows can be accessed by index or by column name, as `DictRow`, but
+    their values are only converted to Python when read.
+    """
+    def __init__(self, *args, **kwargs):
+        _cursor.__init__(self, *args, **kwargs)
+        self.row_factory = _ext.LazyRow
+
+
 class LoggingConnection(_connection):
     """A connection that logs all queries to a file or logger__ object.
 
@@ -415,6 +377,24 @@ class MinTimeLoggingCursor(LoggingCursor):
         return LoggingCursor.execute(self, procname, vars)
 
 
+def _register_binary_type(obj, conn_or_curs):
+    """Register a typecaster for the results in binary format.
+
+    *conn_or_curs* is a connection, a cursor or `!None` for the global scope,
+    as in `~psycopg2.extensions.register_type()`.
+    """
+    if conn_or_curs is None:
+        types = _ext.binary_types
+    else:
+        if conn_or_curs.binary_types is None:
+            # only the cursors may not have a dict yet
+            conn_or_curs.binary_types = {}
+        types = conn_or_curs.binary_types
+
+    for oid in obj.values:
+        types[oid] = obj
+
+
 # a dbtype and adapter for Python UUID type
 
 try:
@@ -425,6 +405,9 @@ try:
 
         .. __: http://docs.python.org/library/uuid.html
         .. __: http://www.postgresql.org/docs/8.4/static/datatype-uuid.html
+
+        `register_uuid()` uses the faster `!psycopg2._psycopg.Uuid` adapter:
+        this class is kept for compatibility.
         """
         
         def __init__(self, uuid):
@@ -439,7 +422,11 @@ try:
         __str__ = getquoted
 
     def register_uuid(oids=None, conn_or_curs=None):
-        """Create the UUID type and an uuid.UUID adapter."""
+        """Create the UUID type and an uuid.UUID adapter.
+
+        The typecaster is also registered for the binary format, used by the
+        cursors with `~cursor.binary` set.
+        """
         if not oids:
             oid1 = 2950
             oid2 = 2951
@@ -449,22 +436,13 @@ try:
             oid1 = oids
             oid2 = 2951
 
-        def parseUUIDARRAY(data, cursor):
-            if data is None:
-                return None
-            elif data == '{}':
-                return []
-            else:
-                return [((len(x) > 0 and x != 'NULL') and uuid.UUID(x) or None)
-                        for x in data[1:-1].split(',')]
-
-        _ext.UUID = _ext.new_type((oid1, ), "UUID",
-                lambda data, cursor: data and uuid.UUID(data) or None)
-        _ext.UUIDARRAY = _ext.new_type((oid2,), "UUID[]", parseUUIDARRAY)
+        _ext.UUID = _ext.new_type((oid1, ), "UUID", _psycopg.UUID)
+        _ext.UUIDARRAY = _ext.new_type((oid2,), "UUID[]", _psycopg.UUIDARRAY)
 
         _ext.register_type(_ext.UUID, conn_or_curs)
         _ext.register_type(_ext.UUIDARRAY, conn_or_curs)
-        _ext.register_adapter(uuid.UUID, UUID_adapter)
+        _register_binary_type(_ext.UUID, conn_or_curs)
+        _ext.register_adapter(uuid.UUID, _psycopg.Uuid)
 
         return _ext.UUID
 
@@ -480,41 +458,21 @@ except ImportError, e:
 
 # a type, dbtype and adapter for PostgreSQL inet type
 
-class Inet(object):
-    """Wrap a string to allow for correct SQL-quoting of inet values.
+from psycopg2._psycopg import Inet
 
-    Note that this adapter does NOT check the passed value to make
-    sure it really is an inet-compatible address but DOES call adapt()
-    on it to make sure it is impossible to execute an SQL-injection
-    by passing an evil value to the initializer.
-    """
-    def __init__(self, addr):
-        self.addr = addr
-    
-    def __repr__(self):
-        return "%s(%r)" % (self.__class__.__name__, self.addr)
-
-    def prepare(self, conn):
-        self._conn = conn
-    
-    def getquoted(self):
-        obj = _A(self.addr)
-        if hasattr(obj, 'prepare'):
-            obj.prepare(self._conn)
-        return obj.getquoted()+"::inet"
-
-    def __conform__(self, foo):
-        if foo is _ext.ISQLQuote:
-            return self
-
-    def __str__(self):
-        return str(self.addr)
-        
 def register_inet(oid=None, conn_or_curs=None):
-    """Create the INET type and an Inet adapter."""
-    if not oid: oid = 869
-    _ext.INET = _ext.new_type((oid, ), "INET",
-            lambda data, cursor: data and Inet(data) or None)
+    """Create the INET type and an Inet adapter.
+
+    By default the typecaster is registered for the :sql:`inet` and
+    :sql:`cidr` types and their arrays.
+    """
+    if not oid:
+        _ext.INET = _ext.new_type((869, 650), "INET", _psycopg.INET)
+        _ext.INETARRAY = _ext.new_type((1041, 651), "INETARRAY",
+            _psycopg.INETARRAY)
+        _ext.register_type(_ext.INETARRAY, conn_or_curs)
+    else:
+        _ext.INET = _ext.new_type((oid, ), "INET", _psycopg.INET)
     _ext.register_type(_ext.INET, conn_or_curs)
     return _ext.INET
 
@@ -554,7 +512,11 @@ def wait_select(conn):
 
 
 class HstoreAdapter(object):
-    """Adapt a Python dict to the hstore syntax."""
+    """Adapt a Python dict to the hstore syntax.
+
+    `register_hstore()` uses the faster `!psycopg2._psycopg.Hstore` adapter
+    and C typecasters: this class is kept for compatibility.
+    """
     def __init__(self, wrapped):
         self.wrapped = wrapped
 
@@ -708,7 +670,8 @@ def register_hstore(conn_or_curs, globally=False, unicode=False):
     use *unicode*\=True to return `unicode` objects instead.  When adapting a
     dictionary both `str` and `unicode` keys and values are handled (the
     `unicode` values will be converted according to the current
-    `~connection.encoding`).
+    `~connection.encoding`).  The typecaster is also registered for the
+    binary format, used by the cursors with `~cursor.binary` set.
 
     The |hstore| contrib module must be already installed in the database
     (executing the ``hstore.sql`` script in your ``contrib`` directory).
@@ -720,15 +683,116 @@ def register_hstore(conn_or_curs, globally=False, unicode=False):
             "hstore type not found in the database. "
             "please install it from your 'contrib/hstore.sql' file")
 
-    # create and register the typecaster
+    # create and register the typecaster: the C parsers handle both the
+    # text and the binary format, so the same object is used for both
     if unicode:
-        cast = HstoreAdapter.parse_unicode
+        cast = _psycopg.UNICODEHSTORE
     else:
-        cast = HstoreAdapter.parse
+        cast = _psycopg.HSTORE
 
     HSTORE = _ext.new_type((oids[0],), "HSTORE", cast)
     _ext.register_type(HSTORE, not globally and conn_or_curs or None)
-    _ext.register_adapter(dict, HstoreAdapter)
+    _register_binary_type(HSTORE, not globally and conn_or_curs or None)
+
+    _ext.register_adapter(dict, _psycopg.Hstore)
+
+
+class CompositeCaster(object):
+    """Information about a composite type and typecasters to parse it.
+
+    The attributes of the type are read from the catalog once: the values are
+    parsed by a C typecaster casting each attribute with the typecaster
+    registered for its type.
+    """
+    def __init__(self, name, oid, attrs, array_oid=None, factory=None):
+        self.name = name
+        self.oid = oid
+        self.array_oid = array_oid
+        self.attnames = [a[0] for a in attrs]
+        self.atttypes = [a[1] for a in attrs]
+        self.factory = factory
+
+        self.typecaster = _ext.new_composite_type((oid,), name.upper(),
+            tuple(self.atttypes), factory)
+        if array_oid:
+            self.array_typecaster = _ext.new_array_type(
+                (array_oid,), "%sARRAY" % name.upper(), self.typecaster)
+        else:
+            self.array_typecaster = None
+
+    @classmethod
+    def _from_db(self, name, conn_or_curs, factory=None):
+        """Return a `CompositeCaster` instance for the type *name*.
+
+        Raise `ProgrammingError` if the type is not found.
+        """
+        if hasattr(conn_or_curs, 'execute'):
+            conn = conn_or_curs.connection
+            curs = conn_or_curs
+        else:
+            conn = conn_or_curs
+            curs = conn_or_curs.cursor()
+
+        # Store the transaction status of the connection to revert it after use
+        conn_status = conn.status
+
+        # column typarray not available before PG 8.3
+        typarray = conn.server_version >= 80300 and "typarray" or "NULL"
+
+        # the type is looked up in the search_path unless schema-qualified
+        try:
+            curs.execute("""\
+SELECT t.oid, %s, attname, atttypid
+FROM pg_type t
+JOIN pg_attribute a ON attrelid = typrelid
+WHERE t.oid = %%s::regtype
+    AND attnum > 0 AND NOT attisdropped
+ORDER BY attnum;
+""" % typarray, (name, ))
+        except psycopg2.ProgrammingError:
+            # the cast to regtype fails if the type doesn't exist
+            recs = []
+        else:
+            recs = curs.fetchall()
+
+        # revert the status of the connection as before the command
+        if (conn_status != _ext.STATUS_IN_TRANSACTION
+        and conn.isolation_level != _ext.ISOLATION_LEVEL_AUTOCOMMIT):
+            conn.rollback()
+
+        if not recs:
+            raise psycopg2.ProgrammingError(
+                "PostgreSQL type '%s' not found or not composite" % name)
+
+        return CompositeCaster(name, recs[0][0], [r[2:] for r in recs],
+            array_oid=recs[0][1], factory=factory)
+
+def register_composite(name, conn_or_curs, globally=False, factory=None):
+    """Register a typecaster to convert a composite type into a tuple.
+
+    :param name: the name of a PostgreSQL composite type, e.g. created using
+        the |CREATE TYPE|_ command, optionally schema-qualified
+    :param conn_or_curs: a connection or cursor used to find the type oid and
+        components; the typecaster is registered in a scope limited to this
+        object, unless *globally* is set to `!True`
+    :param globally: if `!False` (default) register the typecaster only on
+        *conn_or_curs*, otherwise register it globally
+    :param factory: a callable receiving the attributes values as arguments
+        and returning the object to return, for instance a `namedtuple`
+        class. If `!None` the values are returned as a `!tuple`
+    :return: the registered `CompositeCaster` instance
+
+    The attributes are converted by the typecasters registered for their
+    types, so they can be composite types too. The array of the type is
+    registered too, if the server supports it.
+    """
+    caster = CompositeCaster._from_db(name, conn_or_curs, factory=factory)
+    scope = not globally and conn_or_curs or None
+    _ext.register_type(caster.typecaster, scope)
+    if caster.array_typecaster is not None:
+        _ext.register_type(caster.array_typecaster, scope)
+
+    return caster
 
 
 __all__ = filter(lambda k: not k.startswith('_'), locals().keys())
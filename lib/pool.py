@@ -68,6 +68,7 @@ class AbstractConnectionPool(object):
         self.minconn = minconn
         self.maxconn = maxconn
         self.closed = False
+        self.result_cache = None
         
         self._args = args
         self._kwargs = kwargs
@@ -106,11 +107,14 @@ class AbstractConnectionPool(object):
         if self._pool:
             self._used[key] = conn = self._pool.pop()
             self._rused[id(conn)] = key
-            return conn
         else:
             if len(self._used) == self.maxconn:
                 raise PoolError("connection pool exausted")
-            return self._connect(key)
+            conn = self._connect(key)
+
+        # the cache of the pool is shared by all its connections
+        conn.result_cache = self.result_cache
+        return conn
 		 
     def _putconn(self, conn, key=None, close=False):
         """Put away a connection."""
@@ -238,3 +242,224 @@ class PersistentConnectionPool(AbstractConnectionPool):
             self._closeall()
         finally:
             self._lock.release()
+
+
+# The C pool raises the PoolError defined above: import it only after that.
+from psycopg2._psycopg import NativeConnectionPool
+
+
+class PoolMaintenanceThread(object):
+    """Call `!maintain()` on a `NativeConnectionPool` in background.
+
+    The thread runs every 'interval' seconds until `stop()` is called or
+    the pool is closed.
+    """
+
+    def __init__(self, pool, interval=10.0):
+        import threading
+        self.pool = pool
+        self.interval = interval
+        self._stopped = threading.Event()
+        self._thread = threading.Thread(target=self._run)
+        self._thread.setDaemon(True)
+
+    def start(self):
+        self._thread.start()
+        return self
+
+    def stop(self):
+        self._stopped.set()
+        self._thread.join()
+
+    def _run(self):
+        while not self._stopped.isSet():
+            self._stopped.wait(self.interval)
+            if self._stopped.isSet() or self.pool.closed:
+                break
+            try:
+                self.pool.maintain()
+            except Exception, e:
+                # e.g. the database is restarting: retry at the next round
+                dbg("pool maintenance failed:", e)
+
+
+def execute_partitioned(pool, query, partitions, columns=False,
+                        workers=None, nogil_batch=2000):
+    """Run a query for each item of 'partitions' on many pool connections.
+
+    The query is executed with every item of 'partitions' as arguments,
+    using up to 'workers' connections of 'pool' at once (by default as many
+    as the partitions, up to the pool 'maxconn'), each one in a thread.
+    The GIL is released waiting for the results and parsing the values,
+    so the partitions are fetched in parallel.
+
+    Return an iterator on the records of all the partitions, in the order
+    of 'partitions'; if 'columns' is true return a list with the result of
+    `cursor.fetch_columns()` for each partition instead. The first error
+    is raised after all the workers have stopped. Each worker returns its
+    connection to the pool as soon as it has no more partitions to run.
+    """
+    partitions = list(partitions)
+    run = _PartitionedQuery(pool, query, partitions, columns, workers,
+                            nogil_batch)
+    if columns:
+        return list(run)
+    return run.records()
+
+
+class _PartitionedQuery(object):
+    """The state shared by the threads of `execute_partitioned()`."""
+
+    def __init__(self, pool, query, partitions, columns, workers,
+                 nogil_batch):
+        import threading
+        self.pool = pool
+        self.query = query
+        self.partitions = partitions
+        self.columns = columns
+        self.nogil_batch = nogil_batch
+        self.results = {}
+        self.error = None
+        self.next = 0
+        self.cond = threading.Condition()
+
+        # the workers return their connection to the pool when done
+        if isinstance(pool, SimpleConnectionPool):
+            raise PoolError("execute_partitioned() needs a pool "
+                            "that can be shared by threads")
+
+        if workers is None:
+            workers = getattr(pool, 'maxconn', len(partitions))
+        workers = max(1, min(workers, len(partitions)))
+
+        # the connections are taken here, as a PersistentConnectionPool
+        # binds them to the calling thread; don't wait for the busy ones
+        # after the first one. A pool giving back a connection already
+        # taken has no more to give.
+        self.conns = [pool.getconn()]
+        try:
+            while len(self.conns) < workers:
+                if isinstance(pool, NativeConnectionPool):
+                    conn = pool.getconn(timeout=0)
+                else:
+                    conn = pool.getconn()
+                if [c for c in self.conns if c is conn]:
+                    break
+                self.conns.append(conn)
+        except PoolError:
+            pass
+
+        self.threads = []
+        for conn in self.conns:
+            t = threading.Thread(target=self._work, args=(conn,))
+            t.setDaemon(True)
+            t.start()
+            self.threads.append(t)
+
+    def _work(self, conn):
+        try:
+            self._run(conn)
+        finally:
+            self._putconn(conn)
+
+    def _putconn(self, conn):
+        try:
+            if isinstance(self.pool, PersistentConnectionPool):
+                # putconn() would look for the connection of this thread
+                self.pool._lock.acquire()
+                try:
+                    self.pool._putconn(conn)
+                finally:
+                    self.pool._lock.release()
+            else:
+                self.pool.putconn(conn)
+        except Exception:
+            import sys
+            self._set_error(sys.exc_info())
+
+    def _set_error(self, error):
+        self.cond.acquire()
+        try:
+            if self.error is None: self.error = error
+            self.cond.notifyAll()
+        finally:
+            self.cond.release()
+
+    def _run(self, conn):
+        while 1:
+            self.cond.acquire()
+            try:
+                if self.error is not None \
+                        or self.next >= len(self.partitions):
+                    break
+                i = self.next
+                self.next += 1
+            finally:
+                self.cond.release()
+
+            try:
+                curs = conn.cursor()
+                curs.nogil_batch = self.nogil_batch
+                curs.execute(self.query, self.partitions[i])
+                if self.columns:
+                    rv = curs.fetch_columns()
+                else:
+                    rv = curs.fetchall()
+                curs.close()
+                conn.rollback()
+            except Exception:
+                import sys
+                rv = None
+                error = sys.exc_info()
+                try:
+                    conn.rollback()
+                except Exception:
+                    pass
+
+            if rv is None:
+                self._set_error(error)
+                break
+
+            self.cond.acquire()
+            try:
+                self.results[i] = rv
+                self.cond.notifyAll()
+            finally:
+                self.cond.release()
+
+    def _close(self):
+        self.cond.acquire()
+        try:
+            # stop the workers after their current partition
+            self.next = len(self.partitions)
+        finally:
+            self.cond.release()
+        # the workers return their connections before terminating
+        for t in self.threads:
+            t.join()
+        self.threads = self.conns = []
+
+    def __iter__(self):
+        """Return the result of each partition as soon as it is ready."""
+        try:
+            for i in range(len(self.partitions)):
+                self.cond.acquire()
+                try:
+                    while i not in self.results and self.error is None:
+                        self.cond.wait()
+                    if self.error is not None:
+                        break
+                    rv = self.results.pop(i)
+                finally:
+                    self.cond.release()
+                yield rv
+        finally:
+            self._close()
+
+        if self.error is not None:
+            raise self.error[0], self.error[1], self.error[2]
+
+    def records(self):
+        for rv in self:
+            for record in rv:
+                yield record
@@ -31,47 +31,6 @@ import time
 
 ZERO = datetime.timedelta(0)
 
-class FixedOffsetTimezone(datetime.tzinfo):
-    """Fixed offset in minutes east from UTC.
-
-    This is exactly the implementation__ found in Python 2.3.x documentation,
-    with a small change to the `!__init__()` method to allow for pickling
-    and a default name in the form ``sHH:MM`` (``s`` is the sign.).
-
-    .. __: http://docs.python.org/library/datetime.html#datetime-tzinfo
-    """
-    _name = None
-    _offset = ZERO
-    
-    def __init__(self, offset=None, name=None):
-        if offset is not None:
-            self._offset = datetime.timedelta(minutes = offset)
-        if name is not None:
-            self._name = name
-
-    def __repr__(self):
-        return "psycopg2.tz.FixedOffsetTimezone(offset=%r, name=%r)" \
-            % (self._offset.seconds // 60, self._name)
-
-    def utcoffset(self, dt):
-        return self._offset
-
-    def tzname(self, dt):
-        if self._name is not None:
-            return self._name
-        else:
-            seconds = self._offset.seconds + self._offset.days * 86400
-            hours, seconds = divmod(seconds, 3600)
-            minutes = seconds/60
-            if minutes:
-                return "%+03d:%d" % (hours, minutes)
-            else:
-                return "%+03d" % hours
-            
-    def dst(self, dt):
-        return ZERO
-
-
 STDOFFSET = datetime.timedelta(seconds = -time.timezone)
 if time.daylight:
     DSTOFFSET = datetime.timedelta(seconds = -time.altzone)
@@ -110,4 +69,8 @@ class LocalTimezone(datetime.tzinfo):
 
 LOCAL = LocalTimezone()
 
+# FixedOffsetTimezone is implemented in C, as it is the default
+# tzinfo_factory of the cursors. Imported last as _psycopg needs LOCAL.
+from psycopg2._psycopg import FixedOffsetTimezone
+
 # TODO: pre-generate some interesting time zones?
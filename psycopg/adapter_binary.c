@@ -53,6 +53,49 @@ binary_escape(unsigned char *from, size_t from_length,
         return PQescapeBytea(from, from_length, to_length);
 }
 
+/* quote a string in the hex format understood by the servers from 9.0,
+   writing the result straight into the returned string */
+
+static PyObject *
+binary_quote_hex(const unsigned char *from, Py_ssize_t from_length,
+                 int equote)
+{
+    static const char hexdigits[] = "0123456789abcdef";
+    static char hexpairs[512];
+    static int hexpairs_ready = 0;
+    const char *prefix = equote ? "E'\\\\x" : "'\\x";
+    const char *suffix = "'::bytea";
+    Py_ssize_t plen = strlen(prefix), slen = strlen(suffix), i;
+    PyObject *rv;
+    char *to;
+
+    if (!hexpairs_ready) {
+        for (i = 0; i < 256; i++) {
+            hexpairs[i * 2] = hexdigits[i >> 4];
+            hexpairs[i * 2 + 1] = hexdigits[i & 0x0F];
+        }
+        hexpairs_ready = 1;
+    }
+
+    if (from_length > (PY_SSIZE_T_MAX - plen - slen) / 2) {
+        return PyErr_NoMemory();
+    }
+    if (!(rv = PyString_FromStringAndSize(NULL,
+            plen + from_length * 2 + slen))) {
+        return NULL;
+    }
+
+    to = PyString_AS_STRING(rv);
+    memcpy(to, prefix, plen);
+    to += plen;
+    for (i = 0; i < from_length; i++, to += 2) {
+        memcpy(to, hexpairs + from[i] * 2, 2);
+    }
+    memcpy(to, suffix, slen);
+
+    return rv;
+}
+
 /* binary_quote - do the quote process on plain and unicode strings */
 
 static PyObject *
@@ -65,24 +108,43 @@ binary_quote(binaryObject *self)
 
     /* if we got a plain string or a buffer we escape it and save the buffer */
     if (PyString_Check(self->wrapped) || PyBuffer_Check(self->wrapped)) {
+        connectionObject *conn = (connectionObject *)self->conn;
+        int equote = (conn && conn->equote);
+
         /* escape and build quoted buffer */
         if (PyObject_AsReadBuffer(self->wrapped, (const void **)&buffer,
                                   &buffer_len) < 0)
             return NULL;
 
+        if (buffer_len == 0) {
+            self->buffer = PyString_FromString("''::bytea");
+            return self->buffer;
+        }
+
+        /* the hex format can be written without the libpq buffer */
+        if (conn && conn->server_version >= 90000) {
+            self->buffer = binary_quote_hex(
+                (const unsigned char *)buffer, buffer_len, equote);
+            return self->buffer;
+        }
+
         to = (char *)binary_escape((unsigned char*)buffer, (size_t) buffer_len,
-            &len, self->conn ? ((connectionObject*)self->conn)->pgconn : NULL);
+            &len, conn ? conn->pgconn : NULL);
         if (to == NULL) {
             PyErr_NoMemory();
             return NULL;
         }
 
-        if (len > 0)
-            self->buffer = PyString_FromFormat(
-                (self->conn && ((connectionObject*)self->conn)->equote)
-                    ? "E'%s'::bytea" : "'%s'::bytea" , to);
-        else
-            self->buffer = PyString_FromString("''::bytea");
+        /* len includes the trailing zero */
+        if (len > 0) len--;
+        if ((self->buffer = PyString_FromStringAndSize(NULL,
+                len + (equote ? 10 : 9)))) {
+            char *c = PyString_AS_STRING(self->buffer);
+            if (equote) *c++ = 'E';
+            *c++ = '\'';
+            memcpy(c, to, len);
+            memcpy(c + len, "'::bytea", 8);
+        }
 
         PQfreemem(to);
     }
@@ -96,6 +158,22 @@ binary_quote(binaryObject *self)
     return self->buffer;
 }
 
+/* psyco_binary_quote - return the SQL representation of a buffer
+
+   As psyco_qstring_quote(), quote the object without creating its adapter. */
+
+PyObject *
+psyco_binary_quote(PyObject *obj, PyObject *conn)
+{
+    binaryObject b;
+
+    b.wrapped = obj;
+    b.buffer = NULL;
+    b.conn = conn;
+
+    return binary_quote(&b);
+}
+
 /* binary_str, binary_getquoted - return result of quoting */
 
 static PyObject *
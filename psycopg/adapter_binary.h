@@ -46,6 +46,9 @@ typedef struct {
     PyObject *conn;
 } binaryObject;
 
+/* the quoted representation of a buffer, used by the microprotocols */
+HIDDEN PyObject *psyco_binary_quote(PyObject *obj, PyObject *conn);
+
 /* functions exported to psycopgmodule.c */
 
 HIDDEN PyObject *psyco_Binary(PyObject *module, PyObject *args);
@@ -0,0 +1,368 @@
+/* adapter_hstore.c - adapt dicts to hstore values
+ *
+ * Copyright (C) 2010 Federico Di Gregorio <fog@debian.org>
+ *
+ * This file is part of psycopg.
+ *
+ * psycopg2 is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link this program with the OpenSSL library (or with
+ * modified versions of OpenSSL that use the same license as OpenSSL),
+ * and distribute linked combinations including the two.
+ *
+ * You must obey the GNU Lesser General Public License in all respects for
+ * all of the code used other than OpenSSL.
+ *
+ * psycopg2 is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <structmember.h>
+#include <stringobject.h>
+#include <string.h>
+
+#define PSYCOPG_MODULE
+#include "psycopg/config.h"
+#include "psycopg/python.h"
+#include "psycopg/psycopg.h"
+#include "psycopg/connection.h"
+#include "psycopg/adapter_hstore.h"
+#include "psycopg/microprotocols.h"
+#include "psycopg/microprotocols_proto.h"
+
+
+/* append a chunk to the string being written, growing it if needed */
+
+static int
+hstore_write(PyObject **str, Py_ssize_t *len, const char *s, Py_ssize_t n)
+{
+    Py_ssize_t size = PyString_GET_SIZE(*str);
+
+    if (*len + n > size) {
+        size = size * 2 > *len + n ? size * 2 : *len + n;
+        if (0 > _PyString_Resize(str, size)) return -1;
+    }
+    memcpy(PyString_AS_STRING(*str) + *len, s, n);
+    *len += n;
+    return 0;
+}
+
+/* append a key or a value, double-quoted and backslash-escaped as in the
+   hstore input syntax */
+
+static int
+hstore_write_item(PyObject **str, Py_ssize_t *len, PyObject *item,
+                  connectionObject *conn)
+{
+    PyObject *enc = NULL;
+    const char *s, *c, *end, *codec = "utf8";
+    Py_ssize_t n;
+    int rv = -1;
+
+    if (PyUnicode_Check(item)) {
+        /* without a connection we don't know the encoding: assume utf8 */
+        if (conn && conn->encoding) {
+            PyObject *name = PyDict_GetItemString(
+                psycoEncodings, conn->encoding);
+            if (!name) {
+                PyErr_Format(InterfaceError,
+                    "can't encode unicode string to %s", conn->encoding);
+                return -1;
+            }
+            codec = PyString_AsString(name);
+        }
+        if (!(enc = PyUnicode_AsEncodedString(item, codec, NULL))) {
+            return -1;
+        }
+        item = enc;
+    }
+    else if (!PyString_Check(item)) {
+        PyErr_Format(ProgrammingError,
+            "hstore keys and values must be strings, not %s",
+            Py_TYPE(item)->tp_name);
+        return -1;
+    }
+
+    s = PyString_AS_STRING(item);
+    n = PyString_GET_SIZE(item);
+
+    if (0 > hstore_write(str, len, "\"", 1)) goto exit;
+    /* write the chunks between the chars to escape; the string is scanned
+       by length as it may contain a NUL, which the server can't store */
+    for (c = s, end = s + n; c < end; c++) {
+        if (*c == '\0') {
+            PyErr_SetString(DataError,
+                "hstore strings can't contain NUL characters");
+            goto exit;
+        }
+        if (*c != '"' && *c != '\\') continue;
+        if (0 > hstore_write(str, len, s, c - s)) goto exit;
+        if (0 > hstore_write(str, len, "\\", 1)) goto exit;
+        s = c;
+    }
+    if (0 > hstore_write(str, len, s, end - s)) goto exit;
+    if (0 > hstore_write(str, len, "\"", 1)) goto exit;
+    rv = 0;
+
+exit:
+    Py_XDECREF(enc);
+    return rv;
+}
+
+/* hstore_quote - write the dict as an hstore literal
+
+   The literal is quoted as a string, so it works with any server version
+   and doesn't need the hstore(text[], text[]) function of PostgreSQL 9.0 */
+
+static PyObject *
+hstore_quote(hstoreObject *self)
+{
+    connectionObject *conn = (connectionObject *)self->connection;
+    PyObject *str, *quoted, *key, *value, *rv;
+    Py_ssize_t pos = 0, len = 0, n;
+
+    n = PyDict_Size(self->wrapped);
+    if (n == 0) return PyString_FromString("''::hstore");
+
+    /* a guess good for short keys and values */
+    if (!(str = PyString_FromStringAndSize(NULL, n * 24))) return NULL;
+
+    while (PyDict_Next(self->wrapped, &pos, &key, &value)) {
+        if (len > 0 && 0 > hstore_write(&str, &len, ", ", 2)) goto error;
+        if (0 > hstore_write_item(&str, &len, key, conn)) goto error;
+        if (0 > hstore_write(&str, &len, "=>", 2)) goto error;
+        if (value == Py_None) {
+            if (0 > hstore_write(&str, &len, "NULL", 4)) goto error;
+        }
+        else if (0 > hstore_write_item(&str, &len, value, conn)) {
+            goto error;
+        }
+    }
+    if (0 > _PyString_Resize(&str, len)) return NULL;
+
+    /* the literal is already encoded: quote it as a plain string */
+    quoted = microprotocol_getquoted(str, conn);
+    Py_DECREF(str);
+    if (!quoted) return NULL;
+
+    rv = PyString_FromFormat("%s::hstore", PyString_AS_STRING(quoted));
+    Py_DECREF(quoted);
+    return rv;
+
+error:
+    Py_DECREF(str);
+    return NULL;
+}
+
+static PyObject *
+hstore_str(hstoreObject *self)
+{
+    return hstore_quote(self);
+}
+
+static PyObject *
+hstore_getquoted(hstoreObject *self, PyObject *args)
+{
+    return hstore_quote(self);
+}
+
+static PyObject *
+hstore_prepare(hstoreObject *self, PyObject *args)
+{
+    PyObject *conn;
+
+    if (!PyArg_ParseTuple(args, "O!", &connectionType, &conn))
+        return NULL;
+
+    Py_CLEAR(self->connection);
+    Py_INCREF(conn);
+    self->connection = conn;
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+static PyObject *
+hstore_conform(hstoreObject *self, PyObject *args)
+{
+    PyObject *res, *proto;
+
+    if (!PyArg_ParseTuple(args, "O", &proto)) return NULL;
+
+    if (proto == (PyObject*)&isqlquoteType)
+        res = (PyObject*)self;
+    else
+        res = Py_None;
+
+    Py_INCREF(res);
+    return res;
+}
+
+/** the Hstore object **/
+
+/* object member list */
+
+static struct PyMemberDef hstoreObject_members[] = {
+    {"adapted", T_OBJECT, offsetof(hstoreObject, wrapped), RO},
+    {NULL}
+};
+
+/* object method table */
+
+static PyMethodDef hstoreObject_methods[] = {
+    {"getquoted", (PyCFunction)hstore_getquoted, METH_NOARGS,
+     "getquoted() -> wrapped object value as SQL hstore"},
+    {"prepare", (PyCFunction)hstore_prepare, METH_VARARGS,
+     "prepare(conn) -> encode the strings as conn->encoding"},
+    {"__conform__", (PyCFunction)hstore_conform, METH_VARARGS, NULL},
+    {NULL}  /* Sentinel */
+};
+
+/* initialization and finalization methods */
+
+static int
+hstore_setup(hstoreObject *self, PyObject *obj)
+{
+    Dprintf("hstore_setup: init hstore object at %p, refcnt = "
+        FORMAT_CODE_PY_SSIZE_T,
+        self, ((PyObject *)self)->ob_refcnt
+      );
+
+    self->connection = NULL;
+    Py_INCREF(obj);
+    self->wrapped = obj;
+
+    Dprintf("hstore_setup: good hstore object at %p, refcnt = "
+        FORMAT_CODE_PY_SSIZE_T,
+        self, ((PyObject *)self)->ob_refcnt
+      );
+    return 0;
+}
+
+static int
+hstore_traverse(PyObject *obj, visitproc visit, void *arg)
+{
+    hstoreObject *self = (hstoreObject *)obj;
+
+    Py_VISIT(self->wrapped);
+    Py_VISIT(self->connection);
+    return 0;
+}
+
+static void
+hstore_dealloc(PyObject* obj)
+{
+    hstoreObject *self = (hstoreObject *)obj;
+
+    Py_CLEAR(self->wrapped);
+    Py_CLEAR(self->connection);
+
+    Dprintf("hstore_dealloc: deleted hstore object at %p, "
+            "refcnt = " FORMAT_CODE_PY_SSIZE_T, obj, obj->ob_refcnt);
+
+    obj->ob_type->tp_free(obj);
+}
+
+static int
+hstore_init(PyObject *obj, PyObject *args, PyObject *kwds)
+{
+    PyObject *d;
+
+    if (!PyArg_ParseTuple(args, "O!", &PyDict_Type, &d))
+        return -1;
+
+    return hstore_setup((hstoreObject *)obj, d);
+}
+
+static PyObject *
+hstore_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
+{
+    return type->tp_alloc(type, 0);
+}
+
+static void
+hstore_del(PyObject* self)
+{
+    PyObject_GC_Del(self);
+}
+
+static PyObject *
+hstore_repr(hstoreObject *self)
+{
+    return PyString_FromFormat("<psycopg2._psycopg.Hstore object at %p>",
+                               self);
+}
+
+/* object type */
+
+#define hstoreType_doc \
+"Hstore(dict) -> new hstore wrapper object"
+
+PyTypeObject hstoreType = {
+    PyObject_HEAD_INIT(NULL)
+    0,
+    "psycopg2._psycopg.Hstore",
+    sizeof(hstoreObject),
+    0,
+    hstore_dealloc, /*tp_dealloc*/
+    0,          /*tp_print*/
+    0,          /*tp_getattr*/
+    0,          /*tp_setattr*/
+
+    0,          /*tp_compare*/
+    (reprfunc)hstore_repr, /*tp_repr*/
+    0,          /*tp_as_number*/
+    0,          /*tp_as_sequence*/
+    0,          /*tp_as_mapping*/
+    0,          /*tp_hash */
+
+    0,          /*tp_call*/
+    (reprfunc)hstore_str, /*tp_str*/
+    0,          /*tp_getattro*/
+    0,          /*tp_setattro*/
+    0,          /*tp_as_buffer*/
+
+    Py_TPFLAGS_DEFAULT|Py_TPFLAGS_BASETYPE|Py_TPFLAGS_HAVE_GC, /*tp_flags*/
+
+    hstoreType_doc, /*tp_doc*/
+
+    hstore_traverse, /*tp_traverse*/
+    0,          /*tp_clear*/
+
+    0,          /*tp_richcompare*/
+    0,          /*tp_weaklistoffset*/
+
+    0,          /*tp_iter*/
+    0,          /*tp_iternext*/
+
+    /* Attribute descriptor and subclassing stuff */
+
+    hstoreObject_methods, /*tp_methods*/
+    hstoreObject_members, /*tp_members*/
+    0,          /*tp_getset*/
+    0,          /*tp_base*/
+    0,          /*tp_dict*/
+
+    0,          /*tp_descr_get*/
+    0,          /*tp_descr_set*/
+    0,          /*tp_dictoffset*/
+
+    hstore_init, /*tp_init*/
+    0, /*tp_alloc  will be set to PyType_GenericAlloc in module init*/
+    hstore_new, /*tp_new*/
+    (freefunc)hstore_del, /*tp_free  Low-level free-memory routine */
+    0,          /*tp_is_gc For PyObject_IS_GC */
+    0,          /*tp_bases*/
+    0,          /*tp_mro method resolution order */
+    0,          /*tp_cache*/
+    0,          /*tp_subclasses*/
+    0           /*tp_weaklist*/
+};
@@ -0,0 +1,272 @@
+/* adapter_inet.c - the Inet type, wrapping inet values
+ *
+ * Copyright (C) 2010 Federico Di Gregorio <fog@debian.org>
+ *
+ * This file is part of psycopg.
+ *
+ * psycopg2 is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link this program with the OpenSSL library (or with
+ * modified versions of OpenSSL that use the same license as OpenSSL),
+ * and distribute linked combinations including the two.
+ *
+ * You must obey the GNU Lesser General Public License in all respects for
+ * all of the code used other than OpenSSL.
+ *
+ * psycopg2 is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <structmember.h>
+#include <stringobject.h>
+#include <string.h>
+
+#define PSYCOPG_MODULE
+#include "psycopg/config.h"
+#include "psycopg/python.h"
+#include "psycopg/psycopg.h"
+#include "psycopg/connection.h"
+#include "psycopg/adapter_inet.h"
+#include "psycopg/microprotocols.h"
+#include "psycopg/microprotocols_proto.h"
+
+
+/* the address is adapted as a string (so that it can't be used for an SQL
+   injection) but it is not checked to be a valid inet value */
+
+static PyObject *
+inet_getquoted(inetObject *self, PyObject *args)
+{
+    PyObject *quoted, *rv;
+
+    if (!self->addr) {
+        PyErr_SetString(InterfaceError, "the Inet address is not set");
+        return NULL;
+    }
+
+    quoted = microprotocol_getquoted(self->addr,
+        (connectionObject *)self->connection);
+    if (!quoted) return NULL;
+
+    rv = PyString_FromFormat("%s::inet", PyString_AS_STRING(quoted));
+    Py_DECREF(quoted);
+    return rv;
+}
+
+static PyObject *
+inet_str(inetObject *self)
+{
+    return PyObject_Str(self->addr);
+}
+
+static PyObject *
+inet_prepare(inetObject *self, PyObject *args)
+{
+    PyObject *conn;
+
+    if (!PyArg_ParseTuple(args, "O!", &connectionType, &conn))
+        return NULL;
+
+    Py_CLEAR(self->connection);
+    Py_INCREF(conn);
+    self->connection = conn;
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+static PyObject *
+inet_conform(inetObject *self, PyObject *args)
+{
+    PyObject *res, *proto;
+
+    if (!PyArg_ParseTuple(args, "O", &proto)) return NULL;
+
+    if (proto == (PyObject*)&isqlquoteType)
+        res = (PyObject*)self;
+    else
+        res = Py_None;
+
+    Py_INCREF(res);
+    return res;
+}
+
+/** the Inet object **/
+
+/* object member list */
+
+static struct PyMemberDef inetObject_members[] = {
+    {"addr", T_OBJECT_EX, offsetof(inetObject, addr), 0},
+    {NULL}
+};
+
+/* object method table */
+
+static PyMethodDef inetObject_methods[] = {
+    {"getquoted", (PyCFunction)inet_getquoted, METH_NOARGS,
+     "getquoted() -> the address as SQL inet"},
+    {"prepare", (PyCFunction)inet_prepare, METH_VARARGS,
+     "prepare(conn) -> prepare the address for the connection"},
+    {"__conform__", (PyCFunction)inet_conform, METH_VARARGS, NULL},
+    {NULL}  /* Sentinel */
+};
+
+/* initialization and finalization methods */
+
+static int
+inet_setup(inetObject *self, PyObject *obj)
+{
+    Dprintf("inet_setup: init inet object at %p, refcnt = "
+        FORMAT_CODE_PY_SSIZE_T,
+        self, ((PyObject *)self)->ob_refcnt
+      );
+
+    self->connection = NULL;
+    Py_INCREF(obj);
+    self->addr = obj;
+
+    Dprintf("inet_setup: good inet object at %p, refcnt = "
+        FORMAT_CODE_PY_SSIZE_T,
+        self, ((PyObject *)self)->ob_refcnt
+      );
+    return 0;
+}
+
+static int
+inet_traverse(PyObject *obj, visitproc visit, void *arg)
+{
+    inetObject *self = (inetObject *)obj;
+
+    Py_VISIT(self->addr);
+    Py_VISIT(self->connection);
+    return 0;
+}
+
+static void
+inet_dealloc(PyObject* obj)
+{
+    inetObject *self = (inetObject *)obj;
+
+    Py_CLEAR(self->addr);
+    Py_CLEAR(self->connection);
+
+    Dprintf("inet_dealloc: deleted inet object at %p, "
+            "refcnt = " FORMAT_CODE_PY_SSIZE_T, obj, obj->ob_refcnt);
+
+    obj->ob_type->tp_free(obj);
+}
+
+static int
+inet_init(PyObject *obj, PyObject *args, PyObject *kwds)
+{
+    PyObject *addr;
+
+    if (!PyArg_ParseTuple(args, "O", &addr))
+        return -1;
+
+    return inet_setup((inetObject *)obj, addr);
+}
+
+static PyObject *
+inet_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
+{
+    return type->tp_alloc(type, 0);
+}
+
+static void
+inet_del(PyObject* self)
+{
+    PyObject_GC_Del(self);
+}
+
+static PyObject *
+inet_repr(inetObject *self)
+{
+    PyObject *addr, *rv;
+    const char *name, *dot;
+
+    /* the tp_name of the static type includes the module */
+    name = Py_TYPE(self)->tp_name;
+    if ((dot = strrchr(name, '.'))) name = dot + 1;
+
+    if (!(addr = PyObject_Repr(self->addr))) return NULL;
+    rv = PyString_FromFormat("%s(%s)", name, PyString_AS_STRING(addr));
+    Py_DECREF(addr);
+    return rv;
+}
+
+/* object type */
+
+#define inetType_doc \
+"Inet(addr) -> new wrapper for an inet value\n\n" \
+"The address is SQL-quoted as a string: it is not checked to be a valid\n" \
+"inet value."
+
+PyTypeObject inetType = {
+    PyObject_HEAD_INIT(NULL)
+    0,
+    "psycopg2._psycopg.Inet",
+    sizeof(inetObject),
+    0,
+    inet_dealloc, /*tp_dealloc*/
+    0,          /*tp_print*/
+    0,          /*tp_getattr*/
+    0,          /*tp_setattr*/
+
+    0,          /*tp_compare*/
+    (reprfunc)inet_repr, /*tp_repr*/
+    0,          /*tp_as_number*/
+    0,          /*tp_as_sequence*/
+    0,          /*tp_as_mapping*/
+    0,          /*tp_hash */
+
+    0,          /*tp_call*/
+    (reprfunc)inet_str, /*tp_str*/
+    0,          /*tp_getattro*/
+    0,          /*tp_setattro*/
+    0,          /*tp_as_buffer*/
+
+    Py_TPFLAGS_DEFAULT|Py_TPFLAGS_BASETYPE|Py_TPFLAGS_HAVE_GC, /*tp_flags*/
+
+    inetType_doc, /*tp_doc*/
+
+    inet_traverse, /*tp_traverse*/
+    0,          /*tp_clear*/
+
+    0,          /*tp_richcompare*/
+    0,          /*tp_weaklistoffset*/
+
+    0,          /*tp_iter*/
+    0,          /*tp_iternext*/
+
+    /* Attribute descriptor and subclassing stuff */
+
+    inetObject_methods, /*tp_methods*/
+    inetObject_members, /*tp_members*/
+    0,          /*tp_getset*/
+    0,          /*tp_base*/
+    0,          /*tp_dict*/
+
+    0,          /*tp_descr_get*/
+    0,          /*tp_descr_set*/
+    0,          /*tp_dictoffset*/
+
+    inet_init, /*tp_init*/
+    0, /*tp_alloc  will be set to PyType_GenericAlloc in module init*/
+    inet_new, /*tp_new*/
+    (freefunc)inet_del, /*tp_free  Low-level free-memory routine */
+    0,          /*tp_is_gc For PyObject_IS_GC */
+    0,          /*tp_bases*/
+    0,          /*tp_mro method resolution order */
+    0,          /*tp_cache*/
+    0,          /*tp_subclasses*/
+    0           /*tp_weaklist*/
+};
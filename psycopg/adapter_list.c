@@ -27,6 +27,8 @@
 #include <Python.h>
 #include <structmember.h>
 #include <stringobject.h>
+#include <string.h>
+#include <math.h>
 
 #define PSYCOPG_MODULE
 #include "psycopg/config.h"
@@ -37,53 +39,120 @@
 #include "psycopg/microprotocols_proto.h"
 
 
-/* list_str, list_getquoted - return result of quoting */
+/* append a chunk to the string being written, growing it if needed */
+
+static int
+list_write(PyObject **str, Py_ssize_t *len, const char *s, Py_ssize_t n)
+{
+    Py_ssize_t size = PyString_GET_SIZE(*str);
+
+    if (*len + n > size) {
+        size = size * 2 > *len + n ? size * 2 : *len + n;
+        if (0 > _PyString_Resize(str, size)) return -1;
+    }
+    memcpy(PyString_AS_STRING(*str) + *len, s, n);
+    *len += n;
+    return 0;
+}
+
+/* append the SQL representation of an item to the string being written */
+
+static int
+list_write_item(PyObject **str, Py_ssize_t *len, PyObject *item,
+                int fast, connectionObject *conn)
+{
+    PyObject *quoted;
+    char buffer[32], *repr;
+    double d;
+    int rv;
+
+    /* the builtin numbers are written without creating their literal */
+    if (item == Py_None) {
+        return list_write(str, len, "NULL", 4);
+    }
+    else if (PyInt_CheckExact(item) && (fast & ADAPTERS_FAST_INT)) {
+        PyOS_snprintf(buffer, sizeof(buffer), "%ld", PyInt_AS_LONG(item));
+        return list_write(str, len, buffer, strlen(buffer));
+    }
+    else if (PyFloat_CheckExact(item) && (fast & ADAPTERS_FAST_FLOAT)) {
+        d = PyFloat_AS_DOUBLE(item);
+        if (!isnan(d) && !isinf(d)) {
+            /* as repr() does */
+            if (!(repr = PyOS_double_to_string(
+                    d, 'r', 0, Py_DTSF_ADD_DOT_0, NULL))) {
+                return -1;
+            }
+            rv = list_write(str, len, repr, strlen(repr));
+            PyMem_Free(repr);
+            return rv;
+        }
+    }
+
+    if (!(quoted = microprotocol_getquoted(item, conn))) return -1;
+    rv = list_write(str, len,
+        PyString_AS_STRING(quoted), PyString_GET_SIZE(quoted));
+    Py_DECREF(quoted);
+    return rv;
+}
+
+/* list_quote - adapt the items and write them into "ARRAY[]"
+
+   The tuples are written into "()" instead, for "IN %s". */
 
 static PyObject *
 list_quote(listObject *self)
 {
-    /*  adapt the list by calling adapt() recursively and then wrapping
-        everything into "ARRAY[]" */
-    PyObject *tmp = NULL, *str = NULL, *joined = NULL, *res = NULL;
-    Py_ssize_t i, len;
-
-    len = PyList_GET_SIZE(self->wrapped);
+    PyObject *str, **items;
+    Py_ssize_t i, n, len = 0;
+    int tuple = PyTuple_Check(self->wrapped);
+    int fast = microprotocols_fast();
+
+    if (tuple) {
+        n = PyTuple_GET_SIZE(self->wrapped);
+        items = &PyTuple_GET_ITEM(self->wrapped, 0);
+    }
+    else {
+        n = PyList_GET_SIZE(self->wrapped);
+        items = PySequence_Fast_ITEMS(self->wrapped);
+    }
 
     /* empty arrays are converted to NULLs (still searching for a way to
        insert an empty array in postgresql */
-    if (len == 0) return PyString_FromString("'{}'");
+    if (n == 0) return PyString_FromString(tuple ? "()" : "'{}'");
 
-    tmp = PyTuple_New(len);
+    /* a guess good for a list of small numbers */
+    if (!(str = PyString_FromStringAndSize(NULL, 8 + n * 8))) return NULL;
 
-    for (i=0; i<len; i++) {
-        PyObject *quoted;
-    PyObject *wrapped = PyList_GET_ITEM(self->wrapped, i);
-    if (wrapped == Py_None)
-        quoted = PyString_FromString("NULL");
-    else
-        quoted = microprotocol_getquoted(wrapped,
-                                   (connectionObject*)self->connection);
-        if (quoted == NULL) goto error;
-
-        /* here we don't loose a refcnt: SET_ITEM does not change the
-           reference count and we are just transferring ownership of the tmp
-           object to the tuple */
-        PyTuple_SET_ITEM(tmp, i, quoted);
+    if (0 > list_write(&str, &len, tuple ? "(" : "ARRAY[", tuple ? 1 : 6)) {
+        goto error;
     }
 
-    /* now that we have a tuple of adapted objects we just need to join them
-       and put "ARRAY[] around the result */
-    str = PyString_FromString(", ");
-    joined = PyObject_CallMethod(str, "join", "(O)", tmp);
-    if (joined == NULL) goto error;
+    for (i = 0; i < n; i++) {
+        PyObject *item;
+        int rv;
+
+        /* an adapter can change the list: check its size again */
+        if (!tuple) {
+            if (i >= PyList_GET_SIZE(self->wrapped)) break;
+            items = PySequence_Fast_ITEMS(self->wrapped);
+        }
+        if (i > 0 && 0 > list_write(&str, &len, ", ", 2)) goto error;
+
+        item = items[i];
+        Py_INCREF(item);
+        rv = list_write_item(&str, &len, item, fast,
+                             (connectionObject*)self->connection);
+        Py_DECREF(item);
+        if (rv < 0) goto error;
+    }
 
-    res = PyString_FromFormat("ARRAY[%s]", PyString_AsString(joined));
+    if (0 > list_write(&str, &len, tuple ? ")" : "]", 1)) goto error;
+    if (0 > _PyString_Resize(&str, len)) return NULL;
+    return str;
 
- error:
-    Py_XDECREF(tmp);
+error:
     Py_XDECREF(str);
-    Py_XDECREF(joined);
-    return res;
+    return NULL;
 }
 
 static PyObject *
@@ -164,7 +233,7 @@ list_setup(listObject *self, PyObject *obj, const char *enc)
         self, ((PyObject *)self)->ob_refcnt
       );
 
-    if (!PyList_Check(obj))
+    if (!PyList_Check(obj) && !PyTuple_Check(obj))
         return -1;
 
     /* FIXME: remove this orrible strdup */
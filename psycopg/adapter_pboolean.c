@@ -39,18 +39,20 @@
 
 /** the Boolean object **/
 
-static PyObject *
-pboolean_str(pbooleanObject *self)
+/* psyco_pboolean_quote - return the SQL representation of a boolean */
+
+PyObject *
+psyco_pboolean_quote(PyObject *obj)
 {
 #ifdef PSYCOPG_NEW_BOOLEAN
-    if (PyObject_IsTrue(self->wrapped)) {
+    if (PyObject_IsTrue(obj)) {
         return PyString_FromString("true");
     }
     else {
         return PyString_FromString("false");
     }
 #else
-    if (PyObject_IsTrue(self->wrapped)) {
+    if (PyObject_IsTrue(obj)) {
         return PyString_FromString("'t'");
     }
     else {
@@ -59,6 +61,12 @@ pboolean_str(pbooleanObject *self)
 #endif
 }
 
+static PyObject *
+pboolean_str(pbooleanObject *self)
+{
+    return psyco_pboolean_quote(self->wrapped);
+}
+
 static PyObject *
 pboolean_getquoted(pbooleanObject *self, PyObject *args)
 {
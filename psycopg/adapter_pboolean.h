@@ -45,6 +45,9 @@ typedef struct {
 
 } pbooleanObject;
 
+/* the quoted representation of a boolean, used by the microprotocols */
+HIDDEN PyObject *psyco_pboolean_quote(PyObject *obj);
+
 /* functions exported to psycopgmodule.c */
 
 HIDDEN PyObject *psyco_Boolean(PyObject *module, PyObject *args);
@@ -39,16 +39,24 @@
 
 /** the Float object **/
 
-static PyObject *
-pfloat_str(pfloatObject *self)
+/* psyco_pfloat_quote - return the SQL representation of a float */
+
+PyObject *
+psyco_pfloat_quote(PyObject *obj)
 {
-    double n = PyFloat_AsDouble(self->wrapped);
+    double n = PyFloat_AsDouble(obj);
     if (isnan(n))
         return PyString_FromString("'NaN'::float");
     else if (isinf(n))
         return PyString_FromString("'Infinity'::float");
     else
-        return PyObject_Repr(self->wrapped);
+        return PyObject_Repr(obj);
+}
+
+static PyObject *
+pfloat_str(pfloatObject *self)
+{
+    return psyco_pfloat_quote(self->wrapped);
 }
 
 static PyObject *
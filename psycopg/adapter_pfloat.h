@@ -45,6 +45,9 @@ typedef struct {
 
 } pfloatObject;
 
+/* the quoted representation of a float, used by the microprotocols */
+HIDDEN PyObject *psyco_pfloat_quote(PyObject *obj);
+
 /* functions exported to psycopgmodule.c */
 
 HIDDEN PyObject *psyco_Float(PyObject *module, PyObject *args);
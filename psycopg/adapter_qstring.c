@@ -40,6 +40,147 @@
 #include "psycopg/microprotocols_proto.h"
 
 
+/* the client encodings where a byte of a multibyte character can look like
+   a quote or a backslash: their strings are always escaped by libpq */
+
+static const char *qstring_unsafe_encodings[] = {
+    "SJIS", "SHIFT_JIS_2004", "BIG5", "GBK", "UHC", "GB18030", "JOHAB", NULL
+};
+
+/* the strings larger than this are escaped with the GIL released */
+#define QSTRING_NOGIL_SIZE 65536
+
+/* the bytes of a 64 bit word, to scan the strings 8 bytes at time */
+#define QSTRING_ONES (~(unsigned PY_LONG_LONG)0 / 255)
+#define QSTRING_HIGHS (QSTRING_ONES * 0x80)
+
+/* nonzero if any byte of the word is zero */
+#define QSTRING_HASZERO(w) (((w) - QSTRING_ONES) & ~(w) & QSTRING_HIGHS)
+
+/* nonzero if the word may contain any byte the scan must look at */
+#define QSTRING_SPECIAL(w, bs, ascii) ( \
+    QSTRING_HASZERO(w) | QSTRING_HASZERO((w) ^ (QSTRING_ONES * '\'')) \
+    | ((bs) ? QSTRING_HASZERO((w) ^ (QSTRING_ONES * '\\')) : 0) \
+    | ((ascii) ? (w) & QSTRING_HIGHS : 0))
+
+/* return the number of characters to double in the string, or -1 if the
+   string must be escaped by libpq: it contains a NUL (which libpq stops
+   at) or, if ascii is set, a non-ascii byte */
+
+static Py_ssize_t
+qstring_scan(const unsigned char *s, Py_ssize_t len, int bs, int ascii)
+{
+    unsigned PY_LONG_LONG w;
+    Py_ssize_t i = 0, j, n = 0;
+
+    while (i < len) {
+        if (i + 8 <= len) {
+            memcpy(&w, s + i, 8);
+            if (!QSTRING_SPECIAL(w, bs, ascii)) {
+                i += 8;
+                continue;
+            }
+            j = i + 8;
+        }
+        else {
+            j = len;
+        }
+
+        for (; i < j; i++) {
+            if (s[i] == '\'' || (bs && s[i] == '\\')) {
+                n++;
+            }
+            else if (s[i] == '\0' || (ascii && s[i] >= 0x80)) {
+                return -1;
+            }
+        }
+    }
+
+    return n;
+}
+
+/* copy the string doubling the quotes and, if bs is set, the backslashes */
+
+static void
+qstring_escape(char *to, const char *from, Py_ssize_t len, int bs)
+{
+    unsigned PY_LONG_LONG w;
+    Py_ssize_t i = 0;
+
+    while (i < len) {
+        if (i + 8 <= len) {
+            memcpy(&w, from + i, 8);
+            if (!QSTRING_SPECIAL(w, bs, 0)) {
+                memcpy(to, from + i, 8);
+                to += 8;
+                i += 8;
+                continue;
+            }
+        }
+        if (from[i] == '\'' || (bs && from[i] == '\\')) {
+            *to++ = from[i];
+        }
+        *to++ = from[i++];
+    }
+}
+
+/* qstring_quote_fast - quote a string without calling libpq
+
+   The string is written straight into the result and is only scanned for
+   the quotes and the backslashes. Return NULL without an exception set if
+   libpq must escape it instead. */
+
+static PyObject *
+qstring_quote_fast(qstringObject *self, const char *s, Py_ssize_t len)
+{
+    connectionObject *conn = (connectionObject *)self->conn;
+    PyThreadState *_save = NULL;
+    PyObject *rv;
+    const char **enc;
+    char *to;
+    Py_ssize_t n;
+    int bs, ascii, eq;
+
+    /* the escaping rules depend on the connection: use the setting cached
+       from the last result, the PGconn may be in use by another thread */
+    if (!conn || conn->std_strings < 0) return NULL;
+    bs = !conn->std_strings;
+    eq = conn->equote ? 1 : 0;
+
+    /* only the strings we have encoded are surely well formed */
+    ascii = 1;
+    if (PyUnicode_Check(self->wrapped) && self->encoding) {
+        ascii = 0;
+        for (enc = qstring_unsafe_encodings; *enc; enc++) {
+            if (0 == strcmp(*enc, self->encoding)) { ascii = 1; break; }
+        }
+    }
+
+    if (len > QSTRING_NOGIL_SIZE) { _save = PyEval_SaveThread(); }
+    n = qstring_scan((const unsigned char *)s, len, bs, ascii);
+    if (_save) { PyEval_RestoreThread(_save); _save = NULL; }
+    if (n < 0) return NULL;
+
+    if (!(rv = PyString_FromStringAndSize(NULL, len + n + eq + 2))) {
+        return NULL;
+    }
+    to = PyString_AS_STRING(rv);
+    if (eq) { *to++ = 'E'; }
+    *to++ = '\'';
+
+    if (len > QSTRING_NOGIL_SIZE) { _save = PyEval_SaveThread(); }
+    if (n) {
+        qstring_escape(to, s, len, bs);
+    }
+    else {
+        memcpy(to, s, len);
+    }
+    if (_save) { PyEval_RestoreThread(_save); }
+    to[len + n] = '\'';
+
+    return rv;
+}
+
 /* qstring_quote - do the quote process on plain and unicode strings */
 
 static PyObject *
@@ -92,6 +233,12 @@ qstring_quote(qstringObject *self)
     /* encode the string into buffer */
     PyString_AsStringAndSize(str, &s, &len);
 
+    if ((self->buffer = qstring_quote_fast(self, s, len))
+            || PyErr_Occurred()) {
+        Py_DECREF(str);
+        return self->buffer;
+    }
+
     /* Call qstring_escape with the GIL released, then reacquire the GIL
        before verifying that the results can fit into a Python string; raise
        an exception if not. */        
@@ -121,6 +268,28 @@ qstring_quote(qstringObject *self)
     return self->buffer;
 }
 
+/* psyco_qstring_quote - return the SQL representation of a string
+
+   The same as adapting the string and calling prepare(conn) and getquoted()
+   on the adapter, but without creating it: qstring_quote() only reads the
+   fields of the object, so the adapter can live on the stack. */
+
+PyObject *
+psyco_qstring_quote(PyObject *str, PyObject *conn)
+{
+    qstringObject q;
+
+    q.wrapped = str;
+    q.buffer = NULL;
+    q.conn = conn;
+    q.encoding = "latin-1";     /* the default of QuotedString() */
+    if (conn && PyUnicode_Check(str)) {
+        q.encoding = ((connectionObject *)conn)->encoding;
+    }
+
+    return qstring_quote(&q);
+}
+
 /* qstring_str, qstring_getquoted - return result of quoting */
 
 static PyObject *
@@ -47,6 +47,9 @@ typedef struct {
     PyObject *conn;
 } qstringObject;
 
+/* the quoted representation of a string, used by the microprotocols */
+HIDDEN PyObject *psyco_qstring_quote(PyObject *str, PyObject *conn);
+
 /* functions exported to psycopgmodule.c */
 
 HIDDEN PyObject *psyco_QuotedString(PyObject *module, PyObject *args);
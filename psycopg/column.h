@@ -0,0 +1,74 @@
+/* column.h - definition for the typed column buffers
+ *
+ * Copyright (C) 2010 Federico Di Gregorio <fog@debian.org>
+ *
+ * This file is part of psycopg.
+ *
+ * psycopg2 is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link this program with the OpenSSL library (or with
+ * modified versions of OpenSSL that use the same license as OpenSSL),
+ * and distribute linked combinations including the two.
+ *
+ * You must obey the GNU Lesser General Public License in all respects for
+ * all of the code used other than OpenSSL.
+ *
+ * psycopg2 is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ */
+
+#ifndef PSYCOPG_COLUMN_H
+#define PSYCOPG_COLUMN_H 1
+
+#include <Python.h>
+#include <libpq-fe.h>
+
+#include "psycopg/config.h"
+#include "psycopg/cursor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern HIDDEN PyTypeObject columnType;
+
+/* the representation of the values in the buffer */
+#define COLUMN_OBJECT    -1     /* no typed buffer: a list of objects */
+#define COLUMN_INT64      0     /* integers */
+#define COLUMN_FLOAT64    1     /* floating point numbers */
+#define COLUMN_BOOL       2     /* one byte per value, 0 or 1 */
+#define COLUMN_DATE       3     /* days since 1970-01-01 */
+#define COLUMN_TIMESTAMP  4     /* microseconds since 1970-01-01 (UTC for
+                                   timestamps with time zone) */
+
+typedef struct {
+    PyObject_HEAD
+
+    PyObject *name;         /* the column name */
+    Oid type;               /* the PostgreSQL type of the column */
+    int kind;               /* one of the COLUMN_* representations */
+
+    char *data;             /* the values, NULLs are stored as 0 */
+    char *mask;             /* 1 for every NULL value, else 0 */
+    Py_ssize_t len;         /* number of values in the column */
+    Py_ssize_t alloc;       /* number of values allocated */
+    Py_ssize_t itemsize;    /* size of a value in the buffer */
+    Py_ssize_t nbytes;      /* size of the buffer */
+} columnObject;
+
+HIDDEN int column_kind(cursorObject *curs, int col);
+HIDDEN PyObject *column_new(cursorObject *curs, int col, int kind);
+HIDDEN int column_append(columnObject *self, cursorObject *curs, int col,
+                         int first, int last);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !defined(PSYCOPG_COLUMN_H) */
@@ -0,0 +1,708 @@
+/* column_type.c - python interface to the typed column buffers
+ *
+ * Copyright (C) 2010 Federico Di Gregorio <fog@debian.org>
+ *
+ * This file is part of psycopg.
+ *
+ * psycopg2 is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link this program with the OpenSSL library (or with
+ * modified versions of OpenSSL that use the same license as OpenSSL),
+ * and distribute linked combinations including the two.
+ *
+ * You must obey the GNU Lesser General Public License in all respects for
+ * all of the code used other than OpenSSL.
+ *
+ * psycopg2 is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <structmember.h>
+#include <string.h>
+
+#define PSYCOPG_MODULE
+#include "psycopg/config.h"
+#include "psycopg/python.h"
+#include "psycopg/psycopg.h"
+#include "psycopg/column.h"
+#include "psycopg/cursor.h"
+#include "psycopg/typecast.h"
+#include "psycopg/pgtypes.h"
+
+
+#ifdef PSYCOPG_EXTENSIONS
+
+#ifdef _MSC_VER
+#define PY_LONG_LONG_CONST(x) x##i64
+#else
+#define PY_LONG_LONG_CONST(x) x##LL
+#endif
+
+#define USECS_PER_SEC PY_LONG_LONG_CONST(1000000)
+#define USECS_PER_DAY PY_LONG_LONG_CONST(86400000000)
+
+/* offsets of the PostgreSQL epoch (2000-01-01) from the Unix one */
+#define POSTGRES_EPOCH_DAYS 10957
+#define POSTGRES_EPOCH_USECS PY_LONG_LONG_CONST(946684800000000)
+
+/* buffer format and numpy dtype of every kind of column */
+static const char *column_formats[] = { "q", "d", "?", "q", "q" };
+static const char *column_dtypes[] = {
+    "int64", "float64", "bool", "datetime64[D]", "datetime64[us]" };
+static const Py_ssize_t column_itemsizes[] = {
+    sizeof(PY_LONG_LONG), sizeof(double), 1,
+    sizeof(PY_LONG_LONG), sizeof(PY_LONG_LONG) };
+
+
+/** parsing of the values **/
+
+/* read unsigned big endian integers from the network buffer */
+
+static unsigned long
+column_uint32(const char *s)
+{
+    const unsigned char *u = (const unsigned char *)s;
+    return ((unsigned long)u[0] << 24) | ((unsigned long)u[1] << 16)
+        | ((unsigned long)u[2] << 8) | u[3];
+}
+
+static unsigned PY_LONG_LONG
+column_uint64(const char *s)
+{
+    return ((unsigned PY_LONG_LONG)column_uint32(s) << 32)
+        | column_uint32(s + 4);
+}
+
+/* days from 1970-01-01 of a date in the proleptic gregorian calendar */
+
+static long
+column_days_from_civil(long y, int m, int d)
+{
+    long era, yoe, doy, doe;
+
+    y -= m <= 2;
+    era = (y >= 0 ? y : y - 399) / 400;
+    yoe = y - era * 400;
+    doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+/* parse a run of digits; return the number of digits read */
+
+static int
+column_parse_digits(const char **ps, const char *end, long *v)
+{
+    const char *s = *ps;
+
+    *v = 0;
+    while (s < end && *s >= '0' && *s <= '9') {
+        *v = *v * 10 + (*s++ - '0');
+    }
+    end = *ps;
+    *ps = s;
+    return (int)(s - end);
+}
+
+/* parse an integer in text format; return 0 on success, else -1 */
+
+static int
+column_parse_int(const char *s, Py_ssize_t len, PY_LONG_LONG *v)
+{
+    const char *end = s + len;
+    unsigned PY_LONG_LONG u = 0;
+    int neg = 0;
+
+    if (s < end && (*s == '-' || *s == '+')) {
+        neg = (*s++ == '-');
+    }
+    if (s == end) return -1;
+
+    for (; s < end; s++) {
+        if (*s < '0' || *s > '9') return -1;
+        u = u * 10 + (*s - '0');
+    }
+
+    *v = neg ? (PY_LONG_LONG)(0 - u) : (PY_LONG_LONG)u;
+    return 0;
+}
+
+/* parse a float in text format ("NaN" and "Infinity" included)
+
+   strtod() doesn't need the GIL, but a locale using a different decimal
+   point makes it fail: the value is then parsed by column_parse_float_py()
+   holding the GIL. */
+
+static int
+column_parse_float(const char *s, Py_ssize_t len, double *v)
+{
+    char *end;
+
+    if (len == 0) return -1;
+    *v = strtod(s, &end);
+    return (end == s + len) ? 0 : -1;
+}
+
+static int
+column_parse_float_py(const char *s, Py_ssize_t len, double *v)
+{
+    char *end;
+
+#if PY_VERSION_HEX >= 0x02070000
+    *v = PyOS_string_to_double(s, &end, NULL);
+    if (*v == -1.0 && PyErr_Occurred()) {
+        PyErr_Clear();
+        return -1;
+    }
+#else
+    *v = PyOS_ascii_strtod(s, &end);
+#endif
+    return (end == s + len) ? 0 : -1;
+}
+
+/* parse the date part of a date or timestamp in ISO format */
+
+static int
+column_parse_ymd(const char **ps, const char *end, long *y, long *m, long *d)
+{
+    if (column_parse_digits(ps, end, y) < 1) return -1;
+    if (*ps >= end || *(*ps)++ != '-') return -1;
+    if (column_parse_digits(ps, end, m) != 2) return -1;
+    if (*ps >= end || *(*ps)++ != '-') return -1;
+    if (column_parse_digits(ps, end, d) != 2) return -1;
+    return 0;
+}
+
+/* consume the " BC" suffix, if present, and adjust the year */
+
+static int
+column_parse_era(const char **ps, const char *end, long *y)
+{
+    if (end - *ps == 3 && 0 == strncmp(*ps, " BC", 3)) {
+        *ps = end;
+        *y = 1 - *y;
+    }
+    return (*ps == end) ? 0 : -1;
+}
+
+/* parse a date in ISO format into days since 1970-01-01 */
+
+static int
+column_parse_date(const char *s, Py_ssize_t len, PY_LONG_LONG *v)
+{
+    const char *end = s + len;
+    long y, m, d;
+
+    if (column_parse_ymd(&s, end, &y, &m, &d)) return -1;
+    if (column_parse_era(&s, end, &y)) return -1;
+
+    *v = column_days_from_civil(y, (int)m, (int)d);
+    return 0;
+}
+
+/* parse a timestamp in ISO format into microseconds since 1970-01-01;
+   the time zone offset, if any, is used to convert the value to UTC */
+
+static int
+column_parse_timestamp(const char *s, Py_ssize_t len, PY_LONG_LONG *v)
+{
+    const char *end = s + len;
+    long y, m, d, hh, mm, ss, n, usecs = 0, offset = 0;
+    int ndigits, sign;
+
+    if (column_parse_ymd(&s, end, &y, &m, &d)) return -1;
+    if (s >= end || *s++ != ' ') return -1;
+    if (column_parse_digits(&s, end, &hh) != 2) return -1;
+    if (s >= end || *s++ != ':') return -1;
+    if (column_parse_digits(&s, end, &mm) != 2) return -1;
+    if (s >= end || *s++ != ':') return -1;
+    if (column_parse_digits(&s, end, &ss) != 2) return -1;
+
+    if (s < end && *s == '.') {
+        s++;
+        if ((ndigits = column_parse_digits(&s, end, &usecs)) < 1
+                || ndigits > 6) {
+            return -1;
+        }
+        while (ndigits++ < 6) usecs *= 10;
+    }
+
+    /* time zone: [+-]HH[:MM[:SS]] */
+    if (s < end && (*s == '+' || *s == '-')) {
+        sign = (*s++ == '-') ? -1 : 1;
+        if (column_parse_digits(&s, end, &n) != 2) return -1;
+        offset = n * 3600;
+        if (s < end && *s == ':') {
+            s++;
+            if (column_parse_digits(&s, end, &n) != 2) return -1;
+            offset += n * 60;
+        }
+        if (s < end && *s == ':') {
+            s++;
+            if (column_parse_digits(&s, end, &n) != 2) return -1;
+            offset += n;
+        }
+        offset *= sign;
+    }
+
+    if (column_parse_era(&s, end, &y)) return -1;
+
+    *v = (PY_LONG_LONG)column_days_from_civil(y, (int)m, (int)d)
+            * USECS_PER_DAY
+        + (PY_LONG_LONG)(hh * 3600 + mm * 60 + ss - offset) * USECS_PER_SEC
+        + usecs;
+    return 0;
+}
+
+/* parse a value in binary format */
+
+static int
+column_parse_binary(int kind, Oid type, const char *s, Py_ssize_t len,
+                    char *out)
+{
+    union { unsigned int i; float f; } v4;
+    union { unsigned PY_LONG_LONG i; double d; } v8;
+    PY_LONG_LONG ll;
+
+    switch (type) {
+    case INT2OID:
+        if (len != 2) return -1;
+        ll = (short)((((unsigned char)s[0]) << 8) | (unsigned char)s[1]);
+        break;
+    case INT4OID:
+        if (len != 4) return -1;
+        ll = (int)column_uint32(s);
+        break;
+    case OIDOID:
+        if (len != 4) return -1;
+        ll = (PY_LONG_LONG)column_uint32(s);
+        break;
+    case INT8OID:
+        if (len != 8) return -1;
+        ll = (PY_LONG_LONG)column_uint64(s);
+        break;
+    case FLOAT4OID:
+        if (len != 4) return -1;
+        v4.i = (unsigned int)column_uint32(s);
+        *(double *)out = v4.f;
+        return 0;
+    case FLOAT8OID:
+        if (len != 8) return -1;
+        v8.i = column_uint64(s);
+        *(double *)out = v8.d;
+        return 0;
+    case BOOLOID:
+        if (len != 1) return -1;
+        *out = s[0] ? 1 : 0;
+        return 0;
+    case DATEOID:
+        if (len != 4) return -1;
+        ll = (int)column_uint32(s);
+        /* infinite dates */
+        if (ll == 0x7FFFFFFF || ll == -0x7FFFFFFF - 1) return -1;
+        ll += POSTGRES_EPOCH_DAYS;
+        break;
+    case TIMESTAMPOID:
+    case TIMESTAMPTZOID:
+        if (len != 8) return -1;
+        ll = (PY_LONG_LONG)column_uint64(s);
+        /* infinite timestamps */
+        if (ll == PY_LLONG_MAX || ll == PY_LLONG_MIN) return -1;
+        ll += POSTGRES_EPOCH_USECS;
+        break;
+    default:
+        return -1;
+    }
+
+    *(PY_LONG_LONG *)out = ll;
+    return 0;
+}
+
+/* parse a value in text format */
+
+static int
+column_parse_text(int kind, const char *s, Py_ssize_t len, char *out)
+{
+    switch (kind) {
+    case COLUMN_INT64:
+        return column_parse_int(s, len, (PY_LONG_LONG *)out);
+    case COLUMN_FLOAT64:
+        return column_parse_float(s, len, (double *)out);
+    case COLUMN_BOOL:
+        if (len != 1 || (s[0] != 't' && s[0] != 'f')) return -1;
+        *out = (s[0] == 't');
+        return 0;
+    case COLUMN_DATE:
+        return column_parse_date(s, len, (PY_LONG_LONG *)out);
+    case COLUMN_TIMESTAMP:
+        return column_parse_timestamp(s, len, (PY_LONG_LONG *)out);
+    }
+    return -1;
+}
+
+
+/** C interface **/
+
+/* column_kind - return how a result column can be stored in a buffer
+
+   COLUMN_OBJECT is returned for the types without a typed representation
+   and for the columns whose typecaster is not a builtin one. */
+
+int
+column_kind(cursorObject *curs, int col)
+{
+    typecastObject *cast;
+
+    /* a Python typecaster wants to see the values */
+    if (curs->casts == NULL) { return COLUMN_OBJECT; }
+    cast = (typecastObject *)PyTuple_GET_ITEM(curs->casts, col);
+    if (cast->ccast == NULL) { return COLUMN_OBJECT; }
+
+    switch (PQftype(curs->pgres, col)) {
+    case INT2OID:
+    case INT4OID:
+    case INT8OID:
+    case OIDOID:
+        return COLUMN_INT64;
+    case FLOAT4OID:
+    case FLOAT8OID:
+        return COLUMN_FLOAT64;
+    case BOOLOID:
+        return COLUMN_BOOL;
+    case DATEOID:
+        return COLUMN_DATE;
+    case TIMESTAMPOID:
+    case TIMESTAMPTZOID:
+        return COLUMN_TIMESTAMP;
+    default:
+        return COLUMN_OBJECT;
+    }
+}
+
+/* column_new - create an empty column for a column of the cursor result */
+
+PyObject *
+column_new(cursorObject *curs, int col, int kind)
+{
+    columnObject *self;
+
+    if (!(self = PyObject_New(columnObject, &columnType))) {
+        return NULL;
+    }
+
+    self->type = PQftype(curs->pgres, col);
+    self->kind = kind;
+    self->data = NULL;
+    self->mask = NULL;
+    self->len = 0;
+    self->alloc = 0;
+    self->itemsize = column_itemsizes[kind];
+    self->nbytes = 0;
+
+    if (!(self->name = PyString_FromString(PQfname(curs->pgres, col)))) {
+        Py_DECREF(self);
+        return NULL;
+    }
+
+    Dprintf("column_new: new column at %p: kind %d", self, kind);
+    return (PyObject *)self;
+}
+
+/* column_append - decode the rows first..last-1 of a result column
+
+   The values are parsed with the GIL released: the column is not visible
+   to other threads yet and the cursor result is protected by its lock.
+
+   Return 0 on success, else -1 with an exception set. */
+
+int
+column_append(columnObject *self, cursorObject *curs, int col,
+              int first, int last)
+{
+    Py_ssize_t need = self->len + (last - first);
+    int binary = PQfformat(curs->pgres, col);
+    int row, rv = 0;
+    const char *s = NULL;
+    Py_ssize_t len = 0;
+    char *out = NULL;
+
+    if (last <= first) { return 0; }
+
+    if (need > self->alloc) {
+        Py_ssize_t alloc = self->alloc ? self->alloc : 1024;
+        char *data, *mask;
+
+        while (alloc < need) alloc *= 2;
+        if (!(data = PyMem_Realloc(self->data, alloc * self->itemsize))) {
+            PyErr_NoMemory();
+            return -1;
+        }
+        self->data = data;
+        if (!(mask = PyMem_Realloc(self->mask, alloc))) {
+            PyErr_NoMemory();
+            return -1;
+        }
+        self->mask = mask;
+        self->alloc = alloc;
+    }
+
+    row = first;
+    while (row < last) {
+        Py_BEGIN_ALLOW_THREADS;
+        for (; row < last; row++) {
+            s = PQgetvalue(curs->pgres, row, col);
+            len = PQgetlength(curs->pgres, row, col);
+
+            out = self->data + self->len * self->itemsize;
+            if (len == 0 && PQgetisnull(curs->pgres, row, col)) {
+                memset(out, 0, self->itemsize);
+                self->mask[self->len++] = 1;
+                continue;
+            }
+
+            if (binary) {
+                rv = column_parse_binary(self->kind, self->type, s, len, out);
+            }
+            else {
+                rv = column_parse_text(self->kind, s, len, out);
+            }
+            if (rv < 0) { break; }
+            self->mask[self->len++] = 0;
+        }
+        Py_END_ALLOW_THREADS;
+
+        if (row == last) { break; }
+
+        /* a float may still be parsed by Python */
+        if (binary || self->kind != COLUMN_FLOAT64
+                || 0 > column_parse_float_py(s, len, (double *)out)) {
+            self->nbytes = self->len * self->itemsize;
+            PyErr_Format(DataError, "can't store %s in a %s column",
+                binary ? "binary value" : s, column_dtypes[self->kind]);
+            return -1;
+        }
+        self->mask[self->len++] = 0;
+        row++;
+    }
+
+    self->nbytes = self->len * self->itemsize;
+    return 0;
+}
+
+
+/** buffer interface **/
+
+static int
+column_getbuffer(columnObject *self, Py_buffer *view, int flags)
+{
+    if (flags & PyBUF_WRITABLE) {
+        PyErr_SetString(PyExc_BufferError, "column buffers are read-only");
+        return -1;
+    }
+
+    view->obj = (PyObject *)self;
+    Py_INCREF(self);
+    view->buf = self->data;
+    view->len = self->nbytes;
+    view->readonly = 1;
+    view->ndim = 1;
+    view->suboffsets = NULL;
+    view->internal = NULL;
+
+    if ((flags & PyBUF_FORMAT) == PyBUF_FORMAT) {
+        view->format = (char *)column_formats[self->kind];
+        view->itemsize = self->itemsize;
+        view->shape = ((flags & PyBUF_ND) == PyBUF_ND) ? &self->len : NULL;
+        view->strides = ((flags & PyBUF_STRIDES) == PyBUF_STRIDES) ?
+            &self->itemsize : NULL;
+    }
+    else {
+        /* a plain sequence of bytes */
+        view->format = NULL;
+        view->itemsize = 1;
+        view->shape = ((flags & PyBUF_ND) == PyBUF_ND) ? &self->nbytes : NULL;
+        view->strides = NULL;
+    }
+
+    return 0;
+}
+
+static Py_ssize_t
+column_getreadbuffer(columnObject *self, Py_ssize_t segment, void **ptr)
+{
+    if (segment != 0) {
+        PyErr_SetString(PyExc_SystemError,
+            "accessing non-existent buffer segment");
+        return -1;
+    }
+    *ptr = self->data;
+    return self->nbytes;
+}
+
+static Py_ssize_t
+column_getsegcount(columnObject *self, Py_ssize_t *lenp)
+{
+    if (lenp) *lenp = self->nbytes;
+    return 1;
+}
+
+static PyBufferProcs column_as_buffer = {
+    (readbufferproc)column_getreadbuffer,   /* bf_getreadbuffer */
+    0,                                      /* bf_getwritebuffer */
+    (segcountproc)column_getsegcount,       /* bf_getsegcount */
+    0,                                      /* bf_getcharbuffer */
+    (getbufferproc)column_getbuffer,        /* bf_getbuffer */
+    0,                                      /* bf_releasebuffer */
+};
+
+
+/** sequence interface **/
+
+static Py_ssize_t
+column_len(columnObject *self)
+{
+    return self->len;
+}
+
+static PySequenceMethods column_sequence = {
+    (lenfunc)column_len,        /* sq_length */
+    0,                          /* sq_concat */
+    0,                          /* sq_repeat */
+    0,                          /* sq_item */
+    0,                          /* sq_slice */
+    0,                          /* sq_ass_item */
+    0,                          /* sq_ass_slice */
+    0,                          /* sq_contains */
+    0,                          /* sq_inplace_concat */
+    0,                          /* sq_inplace_repeat */
+};
+
+
+/** attributes **/
+
+#define psyco_column_dtype_doc \
+"The numpy dtype of the values in the buffer."
+
+static PyObject *
+psyco_column_get_dtype(columnObject *self)
+{
+    return PyString_FromString(column_dtypes[self->kind]);
+}
+
+#define psyco_column_mask_doc \
+"A string with a byte per value: 1 if the value is NULL, else 0."
+
+static PyObject *
+psyco_column_get_mask(columnObject *self)
+{
+    return PyString_FromStringAndSize(self->mask, self->len);
+}
+
+static struct PyMemberDef columnObject_members[] = {
+    {"name", T_OBJECT, offsetof(columnObject, name), READONLY,
+        "The name of the column."},
+    {"type_code", T_UINT, offsetof(columnObject, type), READONLY,
+        "The oid of the column type."},
+    {NULL}
+};
+
+static struct PyGetSetDef columnObject_getsets[] = {
+    { "dtype", (getter)psyco_column_get_dtype, NULL,
+      psyco_column_dtype_doc, NULL },
+    { "mask", (getter)psyco_column_get_mask, NULL,
+      psyco_column_mask_doc, NULL },
+    {NULL}
+};
+
+
+/** the Column object **/
+
+static void
+column_dealloc(PyObject* obj)
+{
+    columnObject *self = (columnObject *)obj;
+
+    Py_XDECREF(self->name);
+    PyMem_Free(self->data);
+    PyMem_Free(self->mask);
+
+    Dprintf("column_dealloc: deleted column at %p", obj);
+
+    PyObject_Del(obj);
+}
+
+static PyObject *
+column_repr(columnObject *self)
+{
+    return PyString_FromFormat("<Column '%s' of %s at %p; len "
+        FORMAT_CODE_PY_SSIZE_T ">", PyString_AS_STRING(self->name),
+        column_dtypes[self->kind], self, self->len);
+}
+
+
+/* object type */
+
+#define columnType_doc \
+"A result column stored in a typed buffer. Use fetch_columns() to create."
+
+PyTypeObject columnType = {
+    PyObject_HEAD_INIT(NULL)
+    0,
+    "psycopg2._psycopg.Column",
+    sizeof(columnObject),
+    0,
+    column_dealloc, /*tp_dealloc*/
+    0,          /*tp_print*/
+    0,          /*tp_getattr*/
+    0,          /*tp_setattr*/
+    0,          /*tp_compare*/
+    (reprfunc)column_repr, /*tp_repr*/
+    0,          /*tp_as_number*/
+    &column_sequence, /*tp_as_sequence*/
+    0,          /*tp_as_mapping*/
+    0,          /*tp_hash */
+
+    0,          /*tp_call*/
+    (reprfunc)column_repr, /*tp_str*/
+    0,          /*tp_getattro*/
+    0,          /*tp_setattro*/
+    &column_as_buffer, /*tp_as_buffer*/
+
+    Py_TPFLAGS_DEFAULT|Py_TPFLAGS_HAVE_NEWBUFFER, /*tp_flags*/
+    columnType_doc, /*tp_doc*/
+
+    0,          /*tp_traverse*/
+    0,          /*tp_clear*/
+
+    0,          /*tp_richcompare*/
+    0,          /*tp_weaklistoffset*/
+
+    0,          /*tp_iter*/
+    0,          /*tp_iternext*/
+
+    /* Attribute descriptor and subclassing stuff */
+
+    0,          /*tp_methods*/
+    columnObject_members, /*tp_members*/
+    columnObject_getsets, /*tp_getset*/
+    0,          /*tp_base*/
+    0,          /*tp_dict*/
+
+    0,          /*tp_descr_get*/
+    0,          /*tp_descr_set*/
+    0,          /*tp_dictoffset*/
+
+    0,          /*tp_init*/
+    0,          /*tp_alloc*/
+    0,          /*tp_new*/
+};
+
+#endif
@@ -87,6 +87,8 @@ static void Dprintf(const char *fmt, ...) {}
 #define pthread_mutex_t HANDLE
 #define pthread_condvar_t HANDLE
 #define pthread_mutex_lock(object) WaitForSingleObject(*(object), INFINITE)
+#define pthread_mutex_trylock(object) \
+    (WaitForSingleObject(*(object), 0) == WAIT_OBJECT_0 ? 0 : 1)
 #define pthread_mutex_unlock(object) ReleaseMutex(*(object))
 #define pthread_mutex_destroy(ref) (CloseHandle(*(ref)))
 /* convert pthread mutex to native mutex */
@@ -101,6 +103,8 @@ static int pthread_mutex_init(pthread_mutex_t *mutex, void* fake)
 #include <OS.h>
 #define pthread_mutex_t sem_id
 #define pthread_mutex_lock(object) acquire_sem(object)
+#define pthread_mutex_trylock(object) \
+    (acquire_sem_etc(object, 1, B_RELATIVE_TIMEOUT, 0) == B_NO_ERROR ? 0 : 1)
 #define pthread_mutex_unlock(object) release_sem(object)
 #define pthread_mutex_destroy(ref) delete_sem(*ref)
 static int pthread_mutex_init(pthread_mutex_t *mutex, void* fake)
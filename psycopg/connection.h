@@ -50,6 +50,9 @@ extern "C" {
 #define ASYNC_DONE  0
 #define ASYNC_READ  1
 #define ASYNC_WRITE 2
+/* green COPY waiting statuses */
+#define ASYNC_COPY_IN   3
+#define ASYNC_COPY_OUT  4
 
 /* polling result */
 #define PSYCO_POLL_OK    0
@@ -60,6 +63,9 @@ extern "C" {
 /* Hard limit on the notices stored by the Python connection */
 #define CONN_NOTICES_LIMIT 50
 
+/* Hard limit on the result shapes whose typecasters are cached */
+#define CONN_CASTS_CACHE_LIMIT 100
+
 /* we need the initial date style to be ISO, for typecasters; if the user
    later change it, she must know what she's doing... these are the queries we
    need to issue */
@@ -68,6 +74,7 @@ extern "C" {
 
 /* possible values for isolation_level */
 typedef enum {
+    ISOLATION_LEVEL_DEFAULT         = -1,   /* the server one, not read yet */
     ISOLATION_LEVEL_AUTOCOMMIT      = 0,
     ISOLATION_LEVEL_READ_COMMITTED  = 1,
     ISOLATION_LEVEL_SERIALIZABLE    = 2,
@@ -80,6 +87,31 @@ struct connectionObject_notice {
     const char *message;
 };
 
+/* an entry in the prepared statements cache */
+#define PREPARED_NAME_SIZE 32
+#define DEFAULT_PREPARED_MAX 100
+
+struct connectionObject_prepared {
+    struct connectionObject_prepared *prev;  /* more recently used entry */
+    struct connectionObject_prepared *next;  /* less recently used entry */
+    PyObject *key;            /* query text and parameters types */
+    long int count;           /* number of executions of the query */
+    int failed;               /* 1 if the statement can't be prepared */
+    char name[PREPARED_NAME_SIZE];  /* statement name, empty if unprepared */
+};
+
+/* counters of the connection activity, collected if collect_stats is set */
+typedef struct {
+    long int queries;           /* commands sent to the backend */
+    PY_LONG_LONG bytes_sent;    /* size of the queries and parameters */
+    PY_LONG_LONG bytes_received; /* size of the values received */
+    PY_LONG_LONG rows;          /* rows returned to Python */
+    PY_LONG_LONG copy_bytes;    /* data sent or received by COPY */
+    double wait_time;           /* seconds waiting for the backend */
+    double decode_time;         /* seconds building descriptions and rows */
+    double adapt_time;          /* seconds adapting the query arguments */
+} connectionStats;
+
 typedef struct {
     PyObject_HEAD
 
@@ -88,6 +120,10 @@ typedef struct {
     char *dsn;              /* data source name */
     char *critical;         /* critical error on this connection */
     char *encoding;         /* current backend encoding */
+    PyObject *pyencoding;   /* encoding as a Python string, to decode */
+    PyObject *codec;        /* the Python codec found for pyencoding */
+    PyObject *(*decoder)(const char *, Py_ssize_t, const char *);
+                            /* the C decoder of codec, NULL if none */
 
     long int closed;          /* 1 means connection has been closed;
                                  2 that something horrible happened */
@@ -104,6 +140,19 @@ typedef struct {
     PGcancel *cancel;         /* the cancellation structure */
 
     PyObject *async_cursor;   /* a cursor executing an asynchronous query */
+    PyObject *async_queue;    /* cursors waiting to send their query */
+    PyObject *async_sent;     /* cursors whose query was pipelined after
+                                 the one of async_cursor */
+    int async_pipeline;       /* 1 if the async queries are pipelined */
+    int async_sync;           /* 1 if the async_cursor got its result and
+                                 the pipeline Sync is still to be read */
+    PyObject *copy_stream;    /* the COPY stream open, if any (borrowed) */
+    PyObject *stream_cursor;  /* the cursor streaming rows (borrowed) */
+    struct cursorResults *nextsets; /* where the results read are kept for
+                                       nextset(), NULL to discard them */
+
+    struct lobjectObject *lobjects; /* the buffered lobjects, flushed before
+                                       the transaction is committed */
     int async_status;         /* asynchronous execution status */
 
     /* notice processing */
@@ -119,16 +168,54 @@ typedef struct {
     PyObject *binary_types;   /* a set of typecasters for binary types */
 
     int equote;               /* use E''-style quotes for escaped strings */
+    int std_strings;          /* standard_conforming_strings: 1 on, 0 off,
+                                 -1 unknown */
+    int server_params;        /* default for the cursors server_params */
+    Py_ssize_t result_limit;  /* default for the cursors result_limit */
+
+    /* prepared statements cache */
+    PyObject *prepared;       /* map key -> entry in the LRU list */
+    struct connectionObject_prepared *prepared_first; /* most recently used */
+    struct connectionObject_prepared *prepared_last;  /* least recently used */
+    struct connectionObject_prepared *prepared_stale; /* to be deallocated */
+    long int prepared_max;    /* max number of entries in the cache */
+    long int prepare_threshold; /* executions before preparing, 0 = never */
+    long int prepared_hits;   /* executions of a prepared statement */
+    long int prepared_misses; /* executions of a non-prepared statement */
+    long int prepared_serial; /* counter to generate statement names */
+
+    /* typecasters cache */
+    PyObject *casts_cache;    /* map result shape -> [casts, description] */
+    long int casts_generation; /* registry_generation when cache was filled */
+
+    PyObject *result_cache;   /* the ResultCache of the cursors, or NULL */
+
+    /* activity counters */
+    int collect_stats;        /* 1 to update stats */
+    connectionStats stats;
 
 } connectionObject;
 
+/* start a timing for the stats: return the current time if they are
+   collected, to be passed to CONN_STATS_ADD_TIME() */
+#define CONN_STATS_START(conn) ((conn)->collect_stats ? psycopg_now() : 0.0)
+
+#define CONN_STATS_ADD_TIME(conn, field, t0) \
+    if ((conn)->collect_stats) { \
+        (conn)->stats.field += psycopg_now() - (t0); }
+
+#define CONN_STATS_ADD(conn, field, n) \
+    if ((conn)->collect_stats) { (conn)->stats.field += (n); }
+
 /* C-callable functions in connection_int.c and connection_ext.c */
-HIDDEN int  conn_get_standard_conforming_strings(PGconn *pgconn);
+HIDDEN void conn_read_std_strings(connectionObject *self);
 HIDDEN int  conn_get_isolation_level(PGresult *pgres);
 HIDDEN int  conn_get_protocol_version(PGconn *pgconn);
 HIDDEN void conn_notice_process(connectionObject *self);
 HIDDEN void conn_notice_clean(connectionObject *self);
 HIDDEN void conn_notifies_process(connectionObject *self);
+HIDDEN PyObject *conn_notifies_wait(connectionObject *self, double timeout,
+                                    Py_ssize_t max_batch);
 HIDDEN int  conn_setup(connectionObject *self, PGconn *pgconn);
 HIDDEN int  conn_connect(connectionObject *self, long int async);
 HIDDEN void conn_close(connectionObject *self);
@@ -136,11 +223,25 @@ HIDDEN int  conn_commit(connectionObject *self);
 HIDDEN int  conn_rollback(connectionObject *self);
 HIDDEN int  conn_switch_isolation_level(connectionObject *self, int level);
 HIDDEN int  conn_set_client_encoding(connectionObject *self, const char *enc);
+HIDDEN PyObject *conn_decode(connectionObject *self,
+                             const char *str, Py_ssize_t len);
 HIDDEN int  conn_poll(connectionObject *self);
+HIDDEN int  conn_async_to_sync(connectionObject *self);
+HIDDEN int  conn_poll_wait(connectionObject **conns, const int *events,
+                           int n, double deadline);
+HIDDEN int  conn_read_isolation_level(connectionObject *self);
 HIDDEN int  conn_tpc_begin(connectionObject *self, XidObject *xid);
 HIDDEN int  conn_tpc_command(connectionObject *self,
                              const char *cmd, XidObject *xid);
+HIDDEN int  conn_tpc_prepare_many(connectionObject **conns, int n);
+HIDDEN int  conn_tpc_finish_many(connectionObject **conns, int n, int commit);
 HIDDEN PyObject *conn_tpc_recover(connectionObject *self);
+HIDDEN struct connectionObject_prepared *conn_prepared_get(
+    connectionObject *self, const char *query, int nparams, const Oid *types);
+HIDDEN void conn_prepared_clear(connectionObject *self);
+HIDDEN void conn_prepared_invalidate(connectionObject *self,
+                                     struct connectionObject_prepared *stmt);
+HIDDEN void conn_prepared_invalidate_all(connectionObject *self);
 
 /* exception-raising macros */
 #define EXC_IF_CONN_CLOSED(self) if ((self)->closed > 0) { \
@@ -152,6 +253,13 @@ HIDDEN PyObject *conn_tpc_recover(connectionObject *self);
     "in asynchronous mode");                                   \
     return NULL; }
 
+#define EXC_IF_CONN_BUSY(self, cmd)                                 \
+    if ((self)->copy_stream || (self)->stream_cursor) {             \
+        PyErr_SetString(ProgrammingError, (self)->copy_stream       \
+            ? #cmd " cannot be used while a COPY stream is open"    \
+            : #cmd " cannot be used while a query is streaming");   \
+        return NULL; }
+
 #define EXC_IF_TPC_NOT_SUPPORTED(self)              \
     if ((self)->server_version < 80100) {           \
         PyErr_Format(NotSupportedError,             \
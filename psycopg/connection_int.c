@@ -26,6 +26,12 @@
 #define PY_SSIZE_T_CLEAN
 #include <Python.h>
 #include <string.h>
+#include <errno.h>
+#ifndef _WIN32
+#include <poll.h>
+#else
+#define poll WSAPoll
+#endif
 
 #define PSYCOPG_MODULE
 #include "psycopg/config.h"
@@ -34,7 +40,9 @@
 #include "psycopg/cursor.h"
 #include "psycopg/pqpath.h"
 #include "psycopg/green.h"
+#include "psycopg/lobject.h"
 #include "psycopg/notify.h"
+#include "psycopg/resultcache.h"
 
 /* conn_notice_callback - process notices */
 
@@ -145,12 +153,16 @@ conn_notifies_process(connectionObject *self)
         Dprintf("conn_notifies_process: got NOTIFY from pid %d, msg = %s",
                 (int) pgn->be_pid, pgn->relname);
 
+        if (self->result_cache) {
+            resultcache_notify(
+                (resultcacheObject *)self->result_cache, pgn->relname);
+        }
+
         if (!(pid = PyInt_FromLong((long)pgn->be_pid))) { goto error; }
         if (!(channel = PyString_FromString(pgn->relname))) { goto error; }
         if (!(payload = PyString_FromString(pgn->extra))) { goto error; }
 
-        if (!(notify = PyObject_CallFunctionObjArgs((PyObject *)&NotifyType,
-                pid, channel, payload, NULL))) {
+        if (!(notify = notify_from_values(pid, channel, payload))) {
             goto error;
         }
 
@@ -183,11 +195,13 @@ error:
  * parameters from query results or by interrogating the connection itself
 */
 
-int
-conn_get_standard_conforming_strings(PGconn *pgconn)
+/* conn_read_std_strings - cache the standard_conforming_strings setting */
+
+void
+conn_read_std_strings(connectionObject *self)
 {
-    int equote;
     const char *scs;
+
     /*
      * The presence of the 'standard_conforming_strings' parameter
      * means that the server _accepts_ the E'' quote.
@@ -201,16 +215,19 @@ conn_get_standard_conforming_strings(PGconn *pgconn)
      * not escaped strings (e.g. '\001' -> "\001"), relying on the
      * fact that the '\' will pass untouched the string parser.
      * In this case the E'' quotes are NOT to be used.
+     *
+     * The value is read again after the results, as a query may change
+     * it, so that the adapters can use it without touching the PGconn,
+     * which may be in use by another thread. Call it on a locked
+     * connection.
      */
-    scs = PQparameterStatus(pgconn, "standard_conforming_strings");
-    Dprintf("conn_connect: server standard_conforming_strings parameter: %s",
+    if (!self->pgconn) { return; }
+    scs = PQparameterStatus(self->pgconn, "standard_conforming_strings");
+    Dprintf("conn_read_std_strings: standard_conforming_strings: %s",
         scs ? scs : "unavailable");
 
-    equote = (scs && (0 == strcmp("off", scs)));
-    Dprintf("conn_connect: server requires E'' quotes: %s",
-            equote ? "YES" : "NO");
-
-    return equote;
+    self->std_strings = scs ? (0 == strcmp("on", scs)) : -1;
+    self->equote = (self->std_strings == 0);
 }
 
 /* Return a string containing the client_encoding setting.
@@ -316,7 +333,7 @@ conn_setup(connectionObject *self, PGconn *pgconn)
     PGresult *pgres;
     int green;
 
-    self->equote = conn_get_standard_conforming_strings(pgconn);
+    conn_read_std_strings(self);
     self->server_version = conn_get_server_version(pgconn);
     self->protocol = conn_get_protocol_version(self->pgconn);
     if (3 != self->protocol) {
@@ -366,29 +383,65 @@ conn_setup(connectionObject *self, PGconn *pgconn)
         CLEARPGRES(pgres);
     }
 
-    if (!green) {
-        Py_UNBLOCK_THREADS;
-        pgres = PQexec(pgconn, psyco_transaction_isolation);
-        Py_BLOCK_THREADS;
+    /* don't ask for default_transaction_isolation, which the server doesn't
+       report: the transactions use it until a level is set */
+    self->isolation_level = ISOLATION_LEVEL_DEFAULT;
+
+    Py_UNBLOCK_THREADS;
+    pthread_mutex_unlock(&self->lock);
+    Py_END_ALLOW_THREADS;
+
+    return 0;
+}
+
+/* conn_read_isolation_level - replace ISOLATION_LEVEL_DEFAULT with the level
+   the server uses
+
+   The level is read only once and then kept: it can't be queried while
+   another command is in progress (an asynchronous query or a COPY) or in a
+   failed transaction, in which case an exception is raised. */
+
+int
+conn_read_isolation_level(connectionObject *self)
+{
+    PGresult *pgres;
+
+    if (self->isolation_level != ISOLATION_LEVEL_DEFAULT) {
+        return 0;
+    }
+
+    if (self->async_cursor != NULL
+            || PQtransactionStatus(self->pgconn) == PQTRANS_ACTIVE) {
+        PyErr_SetString(ProgrammingError, "can't read the isolation level "
+            "while a command is in progress");
+        return -1;
+    }
+    if (PQtransactionStatus(self->pgconn) == PQTRANS_INERROR) {
+        PyErr_SetString(InternalError, "can't read the isolation level "
+            "in a failed transaction: rollback first");
+        return -1;
+    }
+
+    Py_BEGIN_ALLOW_THREADS;
+    pthread_mutex_lock(&self->lock);
+    if (!psyco_green()) {
+        pgres = PQexec(self->pgconn, psyco_transaction_isolation);
     } else {
+        Py_BLOCK_THREADS;
         pgres = psyco_exec_green(self, psyco_transaction_isolation);
+        Py_UNBLOCK_THREADS;
     }
+    pthread_mutex_unlock(&self->lock);
+    Py_END_ALLOW_THREADS;
 
     if (pgres == NULL || PQresultStatus(pgres) != PGRES_TUPLES_OK) {
         PyErr_SetString(OperationalError,
                          "can't fetch default_isolation_level");
         IFCLEARPGRES(pgres);
-        Py_UNBLOCK_THREADS;
-        pthread_mutex_unlock(&self->lock);
-        Py_BLOCK_THREADS;
         return -1;
     }
+    /* this clears pgres too */
     self->isolation_level = conn_get_isolation_level(pgres);
-
-    Py_UNBLOCK_THREADS;
-    pthread_mutex_unlock(&self->lock);
-    Py_END_ALLOW_THREADS;
-
     return 0;
 }
 
@@ -613,6 +666,24 @@ _conn_poll_query(connectionObject *self)
         }
         break;
 
+    case ASYNC_COPY_IN:
+        /* sending COPY data: there is nothing to read, just flush */
+        Dprintf("conn_poll: async_status = ASYNC_COPY_IN");
+        res = _conn_poll_advance_write(self, PQflush(self->pgconn));
+        if (res == PSYCO_POLL_READ) {
+            self->async_status = ASYNC_DONE;
+            res = PSYCO_POLL_OK;
+        }
+        break;
+
+    case ASYNC_COPY_OUT:
+        /* waiting for COPY data: ask to wait for the socket to be readable,
+           the input will be consumed in ASYNC_READ status */
+        Dprintf("conn_poll: async_status = ASYNC_COPY_OUT");
+        self->async_status = ASYNC_READ;
+        res = PSYCO_POLL_READ;
+        break;
+
     case ASYNC_DONE:
         Dprintf("conn_poll: async_status = ASYNC_DONE");
         /* We haven't asked anything: just check for notifications. */
@@ -648,7 +719,7 @@ _conn_poll_setup_async(connectionObject *self)
             break;
         }
 
-        self->equote = conn_get_standard_conforming_strings(self->pgconn);
+        conn_read_std_strings(self);
         self->protocol = conn_get_protocol_version(self->pgconn);
         self->server_version = conn_get_server_version(self->pgconn);
         if (3 != self->protocol) {
@@ -713,6 +784,112 @@ _conn_poll_setup_async(connectionObject *self)
 }
 
 
+/* Send the next query in the async queue after one has finished
+
+   res is the result of polling the query finished: return it if the queue
+   is empty, else the status of the query just sent. */
+
+static int
+_conn_poll_next_queued(connectionObject *self, int res)
+{
+    PyObject *exc, *val, *tb;
+    int sent;
+
+    if (self->async_queue == NULL
+            || PyList_GET_SIZE(self->async_queue) == 0) {
+        return res;
+    }
+
+    PyErr_Fetch(&exc, &val, &tb);
+    sent = pq_execute_queued(self);
+    if (exc) {
+        /* the first error wins */
+        if (sent < 0) {
+            PyErr_Clear();
+        }
+        PyErr_Restore(exc, val, tb);
+        return PSYCO_POLL_ERROR;
+    }
+
+    if (sent < 0) {
+        return PSYCO_POLL_ERROR;
+    }
+    if (res == PSYCO_POLL_ERROR) {
+        return res;
+    }
+    return self->async_status == ASYNC_READ ?
+        PSYCO_POLL_READ : PSYCO_POLL_WRITE;
+}
+
+/* Pass the result of an async query to its cursor
+
+   in pipeline mode then pass to the query pipelined after it, whose result
+   may be already available too. Return the poll status. */
+
+static int
+_conn_poll_async_result(connectionObject *self)
+{
+    cursorObject *curs = (cursorObject *)self->async_cursor;
+    PyObject *exc, *val, *tb;
+    int res = PSYCO_POLL_OK;
+
+    if (self->async_sync) {
+        switch (pq_next_pipelined(self)) {
+        case 1:
+            return _conn_poll_advance_read(self, pq_is_busy(self));
+        case 0:
+            return _conn_poll_next_queued(self, PSYCO_POLL_OK);
+        default:
+            return PSYCO_POLL_ERROR;
+        }
+    }
+
+    curs_lock(curs);
+    IFCLEARCURSPGRES(curs);
+    curs_clear_results(curs);
+    if (curs->multiple_results && curs->name == NULL) {
+        self->nextsets = &curs->nextsets;
+    }
+    curs->pgres = pq_get_last_result(self);
+    self->nextsets = NULL;
+
+    /* fetch the tuples (if there are any) and build the result. We
+     * don't care if pq_fetch return 0 or 1, but if there was an error,
+     * we want to signal it to the caller. */
+    if (pq_fetch_sets(curs) == -1) {
+       res = PSYCO_POLL_ERROR;
+    }
+    curs_unlock(curs);
+
+    if (self->async_pipeline) {
+        /* the Sync following the result is still to be read */
+        self->async_sync = 1;
+        self->async_status = ASYNC_READ;
+        if (res != PSYCO_POLL_ERROR) {
+            return _conn_poll_advance_read(self, pq_is_busy(self));
+        }
+
+        /* An error in this query is reported now, the next poll()
+           continues: pass to the next query already if the Sync arrived
+           with the error, as usual. The first error wins. */
+        PyErr_Fetch(&exc, &val, &tb);
+        if (0 == pq_is_busy(self)) {
+            _conn_poll_async_result(self);
+        }
+        PyErr_Clear();
+        PyErr_Restore(exc, val, tb);
+        return res;
+    }
+
+    /* We have finished with our async_cursor */
+    Py_XDECREF(self->async_cursor);
+    self->async_cursor = NULL;
+
+    /* keep going with the next query queued, if any. An error in
+       this query is reported now, the next poll() continues. */
+    return _conn_poll_next_queued(self, res);
+}
+
 /* conn_poll - Main polling switch
  *
  * The function is called in all the states and connection types and invokes
@@ -748,23 +925,10 @@ conn_poll(connectionObject *self)
     case CONN_STATUS_PREPARED:
         res = _conn_poll_query(self);
 
-        if (res == PSYCO_POLL_OK && self->async_cursor) {
-            /* An async query has just finished: parse the tuple in the
-             * target cursor. */
-            cursorObject *curs = (cursorObject *)self->async_cursor;
-            IFCLEARPGRES(curs->pgres);
-            curs->pgres = pq_get_last_result(self);
-
-            /* fetch the tuples (if there are any) and build the result. We
-             * don't care if pq_fetch return 0 or 1, but if there was an error,
-             * we want to signal it to the caller. */
-            if (pq_fetch(curs) == -1) {
-               res = PSYCO_POLL_ERROR;
-            }
-
-            /* We have finished with our async_cursor */
-            Py_XDECREF(self->async_cursor);
-            self->async_cursor = NULL;
+        /* An async query has just finished: parse the tuple in the target
+         * cursor, and in the following ones if their results are ready. */
+        while (res == PSYCO_POLL_OK && self->async_cursor) {
+            res = _conn_poll_async_result(self);
         }
         break;
 
@@ -776,6 +940,225 @@ conn_poll(connectionObject *self)
     return res;
 }
 
+/* conn_async_to_sync - make usable as a sync connection one opened and set
+ * up in async mode
+ *
+ * This allows to open many connections in parallel.
+ */
+
+int
+conn_async_to_sync(connectionObject *self)
+{
+    if (pq_set_non_blocking(self, 0, 1) != 0) {
+        return -1;
+    }
+    self->isolation_level = ISOLATION_LEVEL_DEFAULT;
+    self->async = 0;
+    return 0;
+}
+
+/* read the notifications available on the connection
+
+   Append to list at most max (< 0 for no limit) Notify objects. Consecutive
+   notifications from the same backend and channel share the pid and channel
+   objects: the pending ones are read in a single locked section.
+
+   The function should be called holding the GIL but not the connection
+   lock. Return 0 on success, -1 with an exception on error. */
+
+static int
+_conn_notifies_read(connectionObject *self, PyObject *list, Py_ssize_t max)
+{
+    PGnotify **pgns = NULL, **tmp;
+    PGnotify *pgn;
+    Py_ssize_t i, n = 0, nalloc = 0;
+    PyObject *pid = NULL, *channel = NULL, *payload = NULL, *notify;
+    char *error = NULL;
+    int rv = -1, nomem = 0;
+
+    Py_BEGIN_ALLOW_THREADS;
+    pthread_mutex_lock(&self->lock);
+
+    if (!PQconsumeInput(self->pgconn)) {
+        error = strdup(PQerrorMessage(self->pgconn));
+    }
+    else {
+        while ((max < 0 || n < max)
+                && (pgn = PQnotifies(self->pgconn)) != NULL) {
+            if (n == nalloc) {
+                nalloc = nalloc ? nalloc * 2 : 64;
+                if (!(tmp = realloc(pgns, nalloc * sizeof(PGnotify *)))) {
+                    PQfreemem(pgn);
+                    nomem = 1;
+                    break;
+                }
+                pgns = tmp;
+            }
+            pgns[n++] = pgn;
+        }
+    }
+
+    pthread_mutex_unlock(&self->lock);
+    Py_END_ALLOW_THREADS;
+
+    if (error) {
+        PyErr_SetString(OperationalError, error);
+        free(error);
+        goto exit;
+    }
+    if (nomem) {
+        PyErr_NoMemory();
+        goto exit;
+    }
+
+    Dprintf("_conn_notifies_read: got " FORMAT_CODE_PY_SSIZE_T
+            " notifications", n);
+
+    for (i = 0; i < n; i++) {
+        pgn = pgns[i];
+        if (!pid || PyInt_AS_LONG(pid) != (long)pgn->be_pid) {
+            Py_CLEAR(pid);
+            if (!(pid = PyInt_FromLong((long)pgn->be_pid))) { goto exit; }
+        }
+        if (!channel || strcmp(PyString_AS_STRING(channel), pgn->relname)) {
+            Py_CLEAR(channel);
+            if (!(channel = PyString_FromString(pgn->relname))) { goto exit; }
+        }
+        if (!(payload = PyString_FromString(pgn->extra))) { goto exit; }
+
+        notify = notify_from_values(pid, channel, payload);
+        Py_CLEAR(payload);
+        if (!notify) { goto exit; }
+        if (0 != PyList_Append(list, notify)) {
+            Py_DECREF(notify);
+            goto exit;
+        }
+        Py_DECREF(notify);
+    }
+    rv = 0;
+
+exit:
+    for (i = 0; i < n; i++) {
+        PQfreemem(pgns[i]);
+    }
+    free(pgns);
+    Py_XDECREF(pid);
+    Py_XDECREF(channel);
+    return rv;
+}
+
+/* conn_notifies_wait - return a batch of notifications, waiting for them
+
+   Return a list of at most max_batch (<= 0 for no limit) Notify objects:
+   first the ones already in the notifies list, then the ones pending on the
+   connection. If there is none wait, with the GIL released, until some
+   arrive or timeout seconds pass (< 0 to wait forever): on timeout return
+   an empty list. Return NULL on error. */
+
+PyObject *
+conn_notifies_wait(connectionObject *self, double timeout,
+                   Py_ssize_t max_batch)
+{
+    PyObject *rv, *batch;
+    Py_ssize_t n;
+    double deadline = timeout < 0 ? -1 : psycopg_now() + timeout;
+    int event = PSYCO_POLL_READ;
+
+    if (!(rv = PyList_New(0))) {
+        return NULL;
+    }
+
+    for (;;) {
+        n = PyList_GET_SIZE(self->notifies);
+        if (max_batch > 0 && n > max_batch) {
+            n = max_batch;
+        }
+        if (n > 0) {
+            if (!(batch = PyList_GetSlice(self->notifies, 0, n))) {
+                goto error;
+            }
+            Py_DECREF(rv);
+            rv = batch;
+            if (0 != PyList_SetSlice(self->notifies, 0, n, NULL)) {
+                goto error;
+            }
+        }
+
+        if (max_batch <= 0 || n < max_batch) {
+            if (0 != _conn_notifies_read(self, rv,
+                    max_batch > 0 ? max_batch - n : -1)) {
+                goto error;
+            }
+        }
+
+        if (PyList_GET_SIZE(rv) > 0) {
+            break;
+        }
+
+        switch (conn_poll_wait(&self, &event, 1, deadline)) {
+        case 0:
+            continue;
+        case 1:
+            return rv;  /* timeout */
+        default:
+            goto error;
+        }
+    }
+
+    return rv;
+
+error:
+    Py_DECREF(rv);
+    return NULL;
+}
+
+/* conn_poll_wait - wait for many connections being polled
+
+   Wait, with the GIL released, until one of the conns is ready for the
+   operation in events (PSYCO_POLL_READ or PSYCO_POLL_WRITE; other values
+   skip the connection) or until deadline (psycopg_now() time, < 0 to wait
+   forever). Return 0 if ready, 1 on timeout, -1 on error. */
+
+int
+conn_poll_wait(connectionObject **conns, const int *events, int n,
+               double deadline)
+{
+    struct pollfd *fds;
+    int i, nfds = 0, ms = -1, res;
+
+    if (!(fds = PyMem_New(struct pollfd, n))) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    for (i = 0; i < n; i++) {
+        if (events[i] != PSYCO_POLL_READ && events[i] != PSYCO_POLL_WRITE)
+            continue;
+        fds[nfds].fd = PQsocket(conns[i]->pgconn);
+        fds[nfds].events = events[i] == PSYCO_POLL_READ ? POLLIN : POLLOUT;
+        fds[nfds].revents = 0;
+        nfds++;
+    }
+
+    if (deadline >= 0) {
+        ms = (int)((deadline - psycopg_now()) * 1000);
+        if (ms < 0) { ms = 0; }
+    }
+
+    Py_BEGIN_ALLOW_THREADS;
+    res = poll(fds, nfds, ms);
+    Py_END_ALLOW_THREADS;
+    PyMem_Free(fds);
+
+    if (res < 0 && errno != EINTR) {
+        PyErr_SetFromErrno(PyExc_OSError);
+        return -1;
+    }
+    if (PyErr_CheckSignals() < 0) {
+        return -1;
+    }
+    return (res == 0 && deadline >= 0) ? 1 : 0;
+}
+
 /* conn_close - do anything needed to shut down the connection */
 
 void
@@ -800,6 +1183,10 @@ conn_close(connectionObject *self)
     if (self->closed == 0)
         self->closed = 1;
 
+    Py_BLOCK_THREADS;
+    conn_prepared_clear(self);
+    Py_UNBLOCK_THREADS;
+
     if (self->pgconn) {
         PQfinish(self->pgconn);
         PQfreeCancel(self->cancel);
@@ -819,6 +1206,11 @@ conn_commit(connectionObject *self)
 {
     int res;
 
+#ifdef PSYCOPG_EXTENSIONS
+    if (lobject_flush_all(self) < 0) {
+        return -1;
+    }
+#endif
     res = pq_commit(self);
     return res;
 }
@@ -843,6 +1235,16 @@ conn_switch_isolation_level(connectionObject *self, int level)
     char *error = NULL;
     int res = 0;
 
+    /* in a transaction, find out if the requested level is the current one.
+       If the transaction is failed it would be rolled back anyway */
+    if (self->isolation_level == ISOLATION_LEVEL_DEFAULT
+            && self->status == CONN_STATUS_BEGIN
+            && PQtransactionStatus(self->pgconn) == PQTRANS_INTRANS) {
+        if (conn_read_isolation_level(self) < 0) {
+            return -1;
+        }
+    }
+
     Py_BEGIN_ALLOW_THREADS;
     pthread_mutex_lock(&self->lock);
 
@@ -868,6 +1270,86 @@ conn_switch_isolation_level(connectionObject *self, int level)
     return res;
 }
 
+/* return 1 if the string only contains ascii characters */
+
+static int
+_conn_is_ascii(const char *str, Py_ssize_t len)
+{
+    const char *end = str + len;
+    unsigned long w;
+
+    /* a word at time: the ascii bytes have the high bit clear */
+    for (; end - str >= (Py_ssize_t)sizeof(w); str += sizeof(w)) {
+        memcpy(&w, str, sizeof(w));
+        if (w & (~0UL / 0xFF * 0x80)) { return 0; }
+    }
+    for (; str < end; str++) {
+        if (*str & 0x80) { return 0; }
+    }
+    return 1;
+}
+
+/* conn_decode - decode a string received from the backend into unicode
+
+   The ascii strings are the same in all the encodings and are decoded
+   directly. Otherwise the codec is looked up in psycopg2.extensions.encodings
+   and, for utf8, latin1 and ascii, its decoding function is called without
+   going through the codecs registry. */
+
+PyObject *
+conn_decode(connectionObject *self, const char *str, Py_ssize_t len)
+{
+    PyObject *codec;
+    const char *name;
+
+    if (_conn_is_ascii(str, len)) {
+        return PyUnicode_DecodeASCII(str, len, NULL);
+    }
+
+    if (!self->pyencoding
+            || strcmp(PyString_AS_STRING(self->pyencoding), self->encoding)) {
+        Py_CLEAR(self->pyencoding);
+        if (!(self->pyencoding = PyString_FromString(self->encoding))) {
+            return NULL;
+        }
+    }
+
+    if (!(codec = PyDict_GetItem(psycoEncodings, self->pyencoding))) {
+        PyErr_Format(InterfaceError,
+                     "can't decode into unicode string from %s",
+                     self->encoding);
+        return NULL;
+    }
+
+    /* the encodings dict can be changed: check the codec is the same */
+    if (codec != self->codec) {
+        if (!(name = PyString_AsString(codec))) { return NULL; }
+        Py_INCREF(codec);
+        Py_XDECREF(self->codec);
+        self->codec = codec;
+
+        if (!strcmp(name, "utf_8") || !strcmp(name, "utf8")
+                || !strcmp(name, "utf-8")) {
+            self->decoder = PyUnicode_DecodeUTF8;
+        }
+        else if (!strcmp(name, "iso8859_1") || !strcmp(name, "latin_1")
+                || !strcmp(name, "latin1") || !strcmp(name, "latin-1")) {
+            self->decoder = PyUnicode_DecodeLatin1;
+        }
+        else if (!strcmp(name, "ascii")) {
+            self->decoder = PyUnicode_DecodeASCII;
+        }
+        else {
+            self->decoder = NULL;
+        }
+    }
+
+    if (self->decoder) {
+        return self->decoder(str, len, NULL);
+    }
+    return PyUnicode_Decode(str, len, PyString_AS_STRING(codec), NULL);
+}
+
 /* conn_set_client_encoding - switch client encoding on connection */
 
 int
@@ -990,6 +1472,126 @@ exit:
     return rv;
 }
 
+/* conn_tpc_finish_many -- commit or abort the TPC of many connections
+ *
+ * The prepared transactions are finished with COMMIT or ROLLBACK PREPARED,
+ * running the commands on all the connections at once. If not committing,
+ * the transactions not prepared yet are rolled back too. The connections
+ * succeeding go ready; the others keep their state and xid, and the first
+ * error is raised. */
+
+int
+conn_tpc_finish_many(connectionObject **conns, int n, int commit)
+{
+    const char **cmds = NULL;
+    XidObject **xids = NULL;
+    int *failed = NULL;
+    int i, rv = -1;
+
+    if (!(cmds = PyMem_New(const char *, n))
+            || !(xids = PyMem_New(XidObject *, n))
+            || !(failed = PyMem_New(int, n))) {
+        PyErr_NoMemory();
+        goto exit;
+    }
+
+    for (i = 0; i < n; i++) {
+        cmds[i] = NULL;
+        xids[i] = NULL;
+        failed[i] = 0;
+        if (conns[i]->status == CONN_STATUS_PREPARED) {
+            cmds[i] = commit ? "COMMIT PREPARED" : "ROLLBACK PREPARED";
+            xids[i] = conns[i]->tpc_xid;
+        }
+        else if (!commit && conns[i]->status == CONN_STATUS_BEGIN) {
+            cmds[i] = "ROLLBACK";
+            conns[i]->mark += 1;
+        }
+    }
+
+    rv = pq_tpc_command_many(conns, cmds, xids, n, failed);
+
+    for (i = 0; i < n; i++) {
+        if (cmds[i] && !failed[i]) {
+            conns[i]->status = CONN_STATUS_READY;
+            Py_CLEAR(conns[i]->tpc_xid);
+        }
+    }
+
+exit:
+    PyMem_Free(cmds);
+    PyMem_Free(xids);
+    PyMem_Free(failed);
+    return rv;
+}
+
+/* conn_tpc_prepare_many -- prepare the TPC of many connections at once
+ *
+ * PREPARE TRANSACTION is run on all the connections not prepared yet at
+ * once. If any of them fails, the transactions of all the connections are
+ * rolled back and the first error is raised. */
+
+int
+conn_tpc_prepare_many(connectionObject **conns, int n)
+{
+    PyObject *exc, *val, *tb;
+    const char **cmds = NULL;
+    XidObject **xids = NULL;
+    int *failed = NULL;
+    int i, rv = -1;
+
+    if (!(cmds = PyMem_New(const char *, n))
+            || !(xids = PyMem_New(XidObject *, n))
+            || !(failed = PyMem_New(int, n))) {
+        PyErr_NoMemory();
+        goto exit;
+    }
+
+    for (i = 0; i < n; i++) {
+        cmds[i] = NULL;
+        xids[i] = conns[i]->tpc_xid;
+        failed[i] = 0;
+        if (conns[i]->status == CONN_STATUS_BEGIN) {
+            cmds[i] = "PREPARE TRANSACTION";
+        }
+    }
+
+#ifdef PSYCOPG_EXTENSIONS
+    for (i = 0; i < n; i++) {
+        if (cmds[i] && 0 > lobject_flush_all(conns[i])) { goto abort; }
+    }
+#endif
+
+    if (0 > pq_tpc_command_many(conns, cmds, xids, n, failed)) {
+        goto abort;
+    }
+    for (i = 0; i < n; i++) {
+        if (cmds[i]) { conns[i]->status = CONN_STATUS_PREPARED; }
+    }
+    rv = 0;
+    goto exit;
+
+abort:
+    /* roll back the prepared transactions with ROLLBACK PREPARED and the
+       others with ROLLBACK: the backend has already aborted the ones which
+       failed to prepare, but the command is harmless */
+    for (i = 0; i < n; i++) {
+        if (cmds[i] && !failed[i] && PQtransactionStatus(conns[i]->pgconn)
+                == PQTRANS_IDLE) {
+            conns[i]->status = CONN_STATUS_PREPARED;
+        }
+    }
+    PyErr_Fetch(&exc, &val, &tb);
+    if (0 > conn_tpc_finish_many(conns, n, 0)) { PyErr_Clear(); }
+    PyErr_Restore(exc, val, tb);
+
+exit:
+    PyMem_Free(cmds);
+    PyMem_Free(xids);
+    PyMem_Free(failed);
+    return rv;
+}
+
 /* conn_tpc_recover -- return a list of pending TPC Xid */
 
 PyObject *
@@ -1023,3 +1625,236 @@ exit:
     return rv;
 
 }
+
+
+/* prepared statements cache */
+
+/* Return 1 if a query can be prepared by the cache.
+ *
+ * Only single DML statements are considered: trying to prepare anything
+ * else would fail and abort the current transaction.
+ */
+static int
+_conn_prepared_allowed(const char *query)
+{
+    static const char *keywords[] = {
+        "select", "insert", "update", "delete", "values", "with", NULL };
+    const char **kw;
+    const char *c;
+    size_t i;
+
+    while (isspace(*query) || *query == '(') query++;
+
+    for (kw = keywords; *kw; kw++) {
+        for (i = 0; (*kw)[i] && tolower(query[i]) == (*kw)[i]; i++);
+        if (!(*kw)[i] && !isalnum(query[i]) && query[i] != '_') break;
+    }
+    if (!*kw) return 0;
+
+    /* a semicolon is only allowed at the end of the query */
+    if ((c = strchr(query, ';'))) {
+        for (c++; *c; c++) {
+            if (!isspace(*c)) return 0;
+        }
+    }
+
+    return 1;
+}
+
+static void
+_conn_prepared_unlink(connectionObject *self,
+                      struct connectionObject_prepared *stmt)
+{
+    if (stmt->prev) stmt->prev->next = stmt->next;
+    else self->prepared_first = stmt->next;
+    if (stmt->next) stmt->next->prev = stmt->prev;
+    else self->prepared_last = stmt->prev;
+    stmt->prev = stmt->next = NULL;
+}
+
+static void
+_conn_prepared_link(connectionObject *self,
+                    struct connectionObject_prepared *stmt)
+{
+    stmt->prev = NULL;
+    stmt->next = self->prepared_first;
+    if (self->prepared_first) self->prepared_first->prev = stmt;
+    else self->prepared_last = stmt;
+    self->prepared_first = stmt;
+}
+
+/* Remove an entry from the cache.
+ *
+ * If the statement was prepared it is moved to the stale list, to be
+ * deallocated before the next statement is prepared.
+ */
+static void
+_conn_prepared_evict(connectionObject *self,
+                     struct connectionObject_prepared *stmt)
+{
+    Dprintf("conn_prepared: evicting statement '%s'", stmt->name);
+
+    _conn_prepared_unlink(self, stmt);
+    if (self->prepared && stmt->key) {
+        if (-1 == PyDict_DelItem(self->prepared, stmt->key)) {
+            PyErr_Clear();
+        }
+    }
+    Py_CLEAR(stmt->key);
+
+    if (stmt->name[0]) {
+        stmt->next = self->prepared_stale;
+        self->prepared_stale = stmt;
+    }
+    else {
+        free(stmt);
+    }
+}
+
+/* conn_prepared_get - return the cache entry for a query
+
+   Look up the query in the cache, adding it if not found and evicting the
+   least recently used entries if the cache is full. The execution count of
+   the entry is incremented.
+
+   Return NULL if the query is not to be cached. This function must be
+   called holding the GIL and the connection lock. */
+
+struct connectionObject_prepared *
+conn_prepared_get(connectionObject *self, const char *query,
+                  int nparams, const Oid *types)
+{
+    struct connectionObject_prepared *stmt = NULL;
+    PyObject *key = NULL, *item;
+    size_t len;
+
+    if (self->prepared_max <= 0) { goto exit; }
+
+    /* the key is the query, a NUL and the raw parameters types: the same
+       query with different types needs a different statement */
+    len = strlen(query);
+    if (!(key = PyString_FromStringAndSize(NULL,
+            len + 1 + nparams * sizeof(Oid)))) {
+        goto error;
+    }
+    memcpy(PyString_AS_STRING(key), query, len + 1);
+    if (nparams) {
+        memcpy(PyString_AS_STRING(key) + len + 1, types,
+               nparams * sizeof(Oid));
+    }
+
+    if (self->prepared && (item = PyDict_GetItem(self->prepared, key))) {
+        stmt = (struct connectionObject_prepared *)PyLong_AsVoidPtr(item);
+        _conn_prepared_unlink(self, stmt);
+        _conn_prepared_link(self, stmt);
+        stmt->count++;
+        goto exit;
+    }
+
+    if (!_conn_prepared_allowed(query)) { goto exit; }
+
+    if (!self->prepared && !(self->prepared = PyDict_New())) { goto error; }
+
+    while (self->prepared_last
+            && PyDict_Size(self->prepared) >= self->prepared_max) {
+        _conn_prepared_evict(self, self->prepared_last);
+    }
+
+    if (!(stmt = (struct connectionObject_prepared *)
+            calloc(1, sizeof(struct connectionObject_prepared)))) {
+        goto exit;
+    }
+    if (!(item = PyLong_FromVoidPtr((void *)stmt))) {
+        free(stmt);
+        stmt = NULL;
+        goto error;
+    }
+    if (0 != PyDict_SetItem(self->prepared, key, item)) {
+        Py_DECREF(item);
+        free(stmt);
+        stmt = NULL;
+        goto error;
+    }
+    Py_DECREF(item);
+
+    stmt->key = key;
+    key = NULL;
+    stmt->count = 1;
+    _conn_prepared_link(self, stmt);
+    goto exit;
+
+error:
+    /* the cache is just an optimization: don't fail the query */
+    PyErr_Clear();
+
+exit:
+    Py_XDECREF(key);
+    return stmt;
+}
+
+/* conn_prepared_clear - empty the cache without talking to the backend
+
+   To be used when the connection is closed. This function must be called
+   holding the GIL. */
+
+void
+conn_prepared_clear(connectionObject *self)
+{
+    struct connectionObject_prepared *stmt;
+
+    while ((stmt = self->prepared_first)) {
+        stmt->name[0] = '\0';
+        _conn_prepared_evict(self, stmt);
+    }
+    Py_CLEAR(self->prepared);
+
+    while ((stmt = self->prepared_stale)) {
+        self->prepared_stale = stmt->next;
+        free(stmt);
+    }
+}
+
+/* conn_prepared_invalidate - forget that a statement was prepared
+
+   The server-side statement is scheduled for deallocation and the query
+   will be prepared again. This function doesn't need the GIL. */
+
+void
+conn_prepared_invalidate(connectionObject *self,
+                         struct connectionObject_prepared *stmt)
+{
+    struct connectionObject_prepared *stale;
+
+    if (!stmt->name[0]) return;
+
+    if ((stale = (struct connectionObject_prepared *)
+            calloc(1, sizeof(struct connectionObject_prepared)))) {
+        strcpy(stale->name, stmt->name);
+        stale->next = self->prepared_stale;
+        self->prepared_stale = stale;
+    }
+
+    stmt->name[0] = '\0';
+    stmt->count = 0;
+}
+
+/* conn_prepared_invalidate_all - forget all the prepared statements
+
+   To be used when the server has dropped the statements (e.g. after a
+   DISCARD ALL). This function doesn't need the GIL. */
+
+void
+conn_prepared_invalidate_all(connectionObject *self)
+{
+    struct connectionObject_prepared *stmt;
+
+    for (stmt = self->prepared_first; stmt; stmt = stmt->next) {
+        stmt->name[0] = '\0';
+        stmt->count = 0;
+    }
+
+    while ((stmt = self->prepared_stale)) {
+        self->prepared_stale = stmt->next;
+        free(stmt);
+    }
+}
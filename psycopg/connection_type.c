@@ -41,6 +41,8 @@
 #include "psycopg/lobject.h"
 #include "psycopg/green.h"
 #include "psycopg/xid.h"
+#include "psycopg/resultcache.h"
+#include "psycopg/registry.h"
 
 /** DBAPI methods **/
 
@@ -136,6 +138,7 @@ psyco_conn_commit(connectionObject *self, PyObject *args)
 {
     EXC_IF_CONN_CLOSED(self);
     EXC_IF_CONN_ASYNC(self, commit);
+    EXC_IF_CONN_BUSY(self, commit);
     EXC_IF_TPC_BEGIN(self, commit);
 
     if (conn_commit(self) < 0)
@@ -156,6 +159,7 @@ psyco_conn_rollback(connectionObject *self, PyObject *args)
 {
     EXC_IF_CONN_CLOSED(self);
     EXC_IF_CONN_ASYNC(self, rollback);
+    EXC_IF_CONN_BUSY(self, rollback);
     EXC_IF_TPC_BEGIN(self, rollback);
 
     if (conn_rollback(self) < 0)
@@ -191,6 +195,7 @@ psyco_conn_tpc_begin(connectionObject *self, PyObject *args)
 
     EXC_IF_CONN_CLOSED(self);
     EXC_IF_CONN_ASYNC(self, tpc_begin);
+    EXC_IF_CONN_BUSY(self, tpc_begin);
     EXC_IF_TPC_NOT_SUPPORTED(self);
 
     if (!PyArg_ParseTuple(args, "O", &oxid)) {
@@ -236,6 +241,7 @@ psyco_conn_tpc_prepare(connectionObject *self, PyObject *args)
 {
     EXC_IF_CONN_CLOSED(self);
     EXC_IF_CONN_ASYNC(self, tpc_prepare);
+    EXC_IF_CONN_BUSY(self, tpc_prepare);
     EXC_IF_TPC_PREPARED(self, tpc_prepare);
 
     if (NULL == self->tpc_xid) {
@@ -244,6 +250,11 @@ psyco_conn_tpc_prepare(connectionObject *self, PyObject *args)
         return NULL;
     }
 
+#ifdef PSYCOPG_EXTENSIONS
+    if (0 > lobject_flush_all(self)) {
+        return NULL;
+    }
+#endif
     if (0 > conn_tpc_command(self, "PREPARE TRANSACTION", self->tpc_xid)) {
         return NULL;
     }
@@ -355,6 +366,7 @@ psyco_conn_tpc_commit(connectionObject *self, PyObject *args)
 {
     EXC_IF_CONN_CLOSED(self);
     EXC_IF_CONN_ASYNC(self, tpc_commit);
+    EXC_IF_CONN_BUSY(self, tpc_commit);
     EXC_IF_TPC_NOT_SUPPORTED(self);
 
     return _psyco_conn_tpc_finish(self, args,
@@ -369,6 +381,7 @@ psyco_conn_tpc_rollback(connectionObject *self, PyObject *args)
 {
     EXC_IF_CONN_CLOSED(self);
     EXC_IF_CONN_ASYNC(self, tpc_rollback);
+    EXC_IF_CONN_BUSY(self, tpc_rollback);
     EXC_IF_TPC_NOT_SUPPORTED(self);
 
     return _psyco_conn_tpc_finish(self, args,
@@ -383,6 +396,7 @@ psyco_conn_tpc_recover(connectionObject *self, PyObject *args)
 {
     EXC_IF_CONN_CLOSED(self);
     EXC_IF_CONN_ASYNC(self, tpc_recover);
+    EXC_IF_CONN_BUSY(self, tpc_recover);
     EXC_IF_TPC_PREPARED(self, tpc_recover);
     EXC_IF_TPC_NOT_SUPPORTED(self);
 
@@ -404,6 +418,7 @@ psyco_conn_set_isolation_level(connectionObject *self, PyObject *args)
 
     EXC_IF_CONN_CLOSED(self);
     EXC_IF_CONN_ASYNC(self, set_isolation_level);
+    EXC_IF_CONN_BUSY(self, set_isolation_level);
     EXC_IF_TPC_PREPARED(self, set_isolation_level);
 
     if (!PyArg_ParseTuple(args, "i", &level)) return NULL;
@@ -436,6 +451,7 @@ psyco_conn_set_client_encoding(connectionObject *self, PyObject *args)
 
     EXC_IF_CONN_CLOSED(self);
     EXC_IF_CONN_ASYNC(self, set_client_encoding);
+    EXC_IF_CONN_BUSY(self, set_client_encoding);
     EXC_IF_TPC_PREPARED(self, set_client_encoding);
 
     if (!PyArg_ParseTuple(args, "s", &enc)) return NULL;
@@ -534,7 +550,7 @@ psyco_conn_lobject(connectionObject *self, PyObject *args, PyObject *keywds)
 
     EXC_IF_CONN_CLOSED(self);
     EXC_IF_CONN_ASYNC(self, lobject);
-    EXC_IF_GREEN(lobject);
+    EXC_IF_CONN_BUSY(self, lobject);
     EXC_IF_TPC_PREPARED(self, lobject);
 
     Dprintf("psyco_conn_lobject: new lobject for connection at %p", self);
@@ -609,6 +625,7 @@ psyco_conn_reset(connectionObject *self)
 
     EXC_IF_CONN_CLOSED(self);
     EXC_IF_CONN_ASYNC(self, reset);
+    EXC_IF_CONN_BUSY(self, reset);
 
     if (pq_reset(self) < 0)
         return NULL;
@@ -725,10 +742,151 @@ psyco_conn_cancel(connectionObject *self)
         PyErr_SetString(OperationalError, errbuf);
         return NULL;
     }
+
+    /* the queries queued after the one canceled are not sent */
+    pq_clear_async_queue(self, 1);
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+/* notifies_wait - wait for a batch of notifications */
+
+#define psyco_conn_notifies_wait_doc \
+"notifies_wait(timeout=None, max_batch=None) -> list of Notify\n\n"        \
+"Return the notifications received by the connection, removing them from\n"  \
+"the `notifies` list. If there is none wait until some arrive, at most\n"   \
+"``timeout`` seconds if specified: on timeout return an empty list. At\n"   \
+"most ``max_batch`` notifications are returned, if specified."
+
+static PyObject *
+psyco_conn_notifies_wait(connectionObject *self, PyObject *args,
+                         PyObject *kwargs)
+{
+    PyObject *pytimeout = Py_None, *pymax = Py_None;
+    double timeout = -1;
+    Py_ssize_t max_batch = 0;
+
+    static char *kwlist[] = {"timeout", "max_batch", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|OO", kwlist,
+            &pytimeout, &pymax)) {
+        return NULL;
+    }
+
+    EXC_IF_CONN_CLOSED(self);
+    EXC_IF_GREEN(notifies_wait);
+
+    if (self->async_cursor != NULL) {
+        PyErr_SetString(ProgrammingError,
+            "notifies_wait cannot be used while an asynchronous query "
+            "is underway");
+        return NULL;
+    }
+
+    if (pytimeout != Py_None) {
+        timeout = PyFloat_AsDouble(pytimeout);
+        if (timeout == -1 && PyErr_Occurred()) { return NULL; }
+        if (timeout < 0) {
+            PyErr_SetString(PyExc_ValueError, "timeout must be positive");
+            return NULL;
+        }
+    }
+    if (pymax != Py_None) {
+        max_batch = PyInt_AsSsize_t(pymax);
+        if (max_batch == -1 && PyErr_Occurred()) { return NULL; }
+        if (max_batch <= 0) {
+            PyErr_SetString(PyExc_ValueError, "max_batch must be positive");
+            return NULL;
+        }
+    }
+
+    return conn_notifies_wait(self, timeout, max_batch);
+}
+
+/* stats - the counters of the connection activity */
+
+#define psyco_conn_stats_doc \
+"The counters of the connection activity, as a dict.\n\n"                 \
+"The counters are updated only if `collect_stats` is set."
+
+static PyObject *
+psyco_conn_get_stats(connectionObject *self)
+{
+    connectionStats *st = &self->stats;
+
+    return Py_BuildValue("{s:l,s:L,s:L,s:L,s:L,s:d,s:d,s:d}",
+        "queries", st->queries,
+        "bytes_sent", st->bytes_sent,
+        "bytes_received", st->bytes_received,
+        "rows", st->rows,
+        "copy_bytes", st->copy_bytes,
+        "wait_time", st->wait_time,
+        "decode_time", st->decode_time,
+        "adapt_time", st->adapt_time);
+}
+
+#define psyco_conn_reset_stats_doc \
+"reset_stats() -- Set all the `stats` counters to zero."
+
+static PyObject *
+psyco_conn_reset_stats(connectionObject *self)
+{
+    memset(&self->stats, 0, sizeof(self->stats));
+
     Py_INCREF(Py_None);
     return Py_None;
 }
 
+/* result_cache - the ResultCache used by the cursors with cache_results */
+
+#define psyco_conn_result_cache_doc \
+"The `ResultCache` used by the cursors with `cache_results` set, or None."
+
+static PyObject *
+psyco_conn_get_result_cache(connectionObject *self)
+{
+    PyObject *rv = self->result_cache ? self->result_cache : Py_None;
+    Py_INCREF(rv);
+    return rv;
+}
+
+static int
+psyco_conn_set_result_cache(connectionObject *self, PyObject *value)
+{
+    if (value == NULL) {
+        PyErr_SetString(PyExc_TypeError, "can't delete the attribute");
+        return -1;
+    }
+    if (value != Py_None && !resultcache_Check(value)) {
+        PyErr_SetString(PyExc_TypeError,
+            "result_cache must be a ResultCache or None");
+        return -1;
+    }
+
+    Py_CLEAR(self->result_cache);
+    if (value != Py_None) {
+        Py_INCREF(value);
+        self->result_cache = value;
+    }
+    return 0;
+}
+
+/* isolation_level - the level is read from the server only if asked, then
+   it is kept: see conn_read_isolation_level() */
+
+static PyObject *
+psyco_conn_get_isolation_level(connectionObject *self)
+{
+    if (self->isolation_level == ISOLATION_LEVEL_DEFAULT) {
+        EXC_IF_CONN_CLOSED(self);
+        if (conn_read_isolation_level(self) < 0) {
+            return NULL;
+        }
+    }
+    return PyInt_FromLong(self->isolation_level);
+}
+
 #endif  /* PSYCOPG_EXTENSIONS */
 
 
@@ -781,6 +939,10 @@ static struct PyMethodDef connectionObject_methods[] = {
      METH_NOARGS, psyco_conn_isexecuting_doc},
     {"cancel", (PyCFunction)psyco_conn_cancel,
      METH_NOARGS, psyco_conn_cancel_doc},
+    {"notifies_wait", (PyCFunction)psyco_conn_notifies_wait,
+     METH_VARARGS|METH_KEYWORDS, psyco_conn_notifies_wait_doc},
+    {"reset_stats", (PyCFunction)psyco_conn_reset_stats,
+     METH_NOARGS, psyco_conn_reset_stats_doc},
 #endif
     {NULL}
 };
@@ -791,9 +953,6 @@ static struct PyMemberDef connectionObject_members[] = {
 #ifdef PSYCOPG_EXTENSIONS
     {"closed", T_LONG, offsetof(connectionObject, closed), RO,
         "True if the connection is closed."},
-    {"isolation_level", T_LONG,
-        offsetof(connectionObject, isolation_level), RO,
-        "The current isolation level."},
     {"encoding", T_STRING, offsetof(connectionObject, encoding), RO,
         "The current client encoding."},
     {"notices", T_OBJECT, offsetof(connectionObject, notice_list), RO},
@@ -815,6 +974,27 @@ static struct PyMemberDef connectionObject_members[] = {
     {"server_version", T_INT,
         offsetof(connectionObject, server_version), RO,
         "Server version."},
+    {"server_params", T_INT,
+        offsetof(connectionObject, server_params), 0,
+        "Default `cursor.server_params` for the new cursors."},
+    {"result_limit", T_PYSSIZET,
+        offsetof(connectionObject, result_limit), 0,
+        "Default `cursor.result_limit` for the new cursors."},
+    {"prepare_threshold", T_LONG,
+        offsetof(connectionObject, prepare_threshold), 0,
+        "Number of executions after which a query is prepared (0: never)."},
+    {"prepared_max", T_LONG,
+        offsetof(connectionObject, prepared_max), 0,
+        "Maximum number of queries in the prepared statements cache."},
+    {"prepared_hits", T_LONG,
+        offsetof(connectionObject, prepared_hits), RO,
+        "Number of executions of cached prepared statements."},
+    {"prepared_misses", T_LONG,
+        offsetof(connectionObject, prepared_misses), RO,
+        "Number of cacheable executions not using a prepared statement."},
+    {"collect_stats", T_INT,
+        offsetof(connectionObject, collect_stats), 0,
+        "If true update the `stats` counters."},
 #endif
     {NULL}
 };
@@ -834,6 +1014,15 @@ static struct PyGetSetDef connectionObject_getsets[] = {
     EXCEPTION_GETTER(IntegrityError),
     EXCEPTION_GETTER(DataError),
     EXCEPTION_GETTER(NotSupportedError),
+#ifdef PSYCOPG_EXTENSIONS
+    { "isolation_level", (getter)psyco_conn_get_isolation_level, NULL,
+      "The current isolation level.", NULL },
+    { "stats", (getter)psyco_conn_get_stats, NULL,
+      psyco_conn_stats_doc, NULL },
+    { "result_cache", (getter)psyco_conn_get_result_cache,
+      (setter)psyco_conn_set_result_cache,
+      psyco_conn_result_cache_doc, NULL },
+#endif
     {NULL}
 };
 #undef EXCEPTION_GETTER
@@ -859,14 +1048,37 @@ connection_setup(connectionObject *self, const char *dsn, long int async)
     self->status = CONN_STATUS_SETUP;
     self->critical = NULL;
     self->async_cursor = NULL;
+    self->async_queue = NULL;
+    self->async_sent = NULL;
+    self->async_pipeline = 0;
+    self->async_sync = 0;
+    self->copy_stream = NULL;
+    self->stream_cursor = NULL;
+    self->nextsets = NULL;
+    self->std_strings = -1;
+    self->lobjects = NULL;
     self->async_status = ASYNC_DONE;
     self->pgconn = NULL;
     self->cancel = NULL;
     self->mark = 0;
-    self->string_types = PyDict_New();
-    self->binary_types = PyDict_New();
+    self->string_types = registry_new();
+    self->binary_types = registry_new();
     self->notice_pending = NULL;
     self->encoding = NULL;
+    self->server_params = 0;
+    self->result_limit = 0;
+    self->prepared = NULL;
+    self->casts_cache = NULL;
+    self->casts_generation = 0;
+    self->result_cache = NULL;
+    self->prepared_first = NULL;
+    self->prepared_last = NULL;
+    self->prepared_stale = NULL;
+    self->prepared_max = DEFAULT_PREPARED_MAX;
+    self->prepare_threshold = 0;
+    self->prepared_hits = 0;
+    self->prepared_misses = 0;
+    self->prepared_serial = 0;
 
     pthread_mutex_init(&(self->lock), NULL);
 
@@ -902,17 +1114,24 @@ connection_dealloc(PyObject* obj)
     if (self->closed == 0) conn_close(self);
     
     conn_notice_clean(self);
+    conn_prepared_clear(self);
 
     if (self->dsn) free(self->dsn);
     if (self->encoding) free(self->encoding);
     if (self->critical) free(self->critical);
 
     Py_CLEAR(self->async_cursor);
+    Py_CLEAR(self->async_queue);
+    Py_CLEAR(self->async_sent);
     Py_CLEAR(self->notice_list);
     Py_CLEAR(self->notice_filter);
     Py_CLEAR(self->notifies);
     Py_CLEAR(self->string_types);
     Py_CLEAR(self->binary_types);
+    Py_CLEAR(self->casts_cache);
+    Py_CLEAR(self->result_cache);
+    Py_CLEAR(self->pyencoding);
+    Py_CLEAR(self->codec);
 
     pthread_mutex_destroy(&(self->lock));
 
@@ -961,11 +1180,15 @@ static int
 connection_traverse(connectionObject *self, visitproc visit, void *arg)
 {
     Py_VISIT(self->async_cursor);
+    Py_VISIT(self->async_queue);
+    Py_VISIT(self->async_sent);
     Py_VISIT(self->notice_list);
     Py_VISIT(self->notice_filter);
     Py_VISIT(self->notifies);
     Py_VISIT(self->string_types);
     Py_VISIT(self->binary_types);
+    Py_VISIT(self->casts_cache);
+    Py_VISIT(self->result_cache);
     return 0;
 }
 
@@ -0,0 +1,667 @@
+/* copy_binary.c - encode python objects in the binary COPY format
+ *
+ * Copyright (C) 2003-2010 Federico Di Gregorio <fog@debian.org>
+ *
+ * This file is part of psycopg.
+ *
+ * psycopg2 is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link this program with the OpenSSL library (or with
+ * modified versions of OpenSSL that use the same license as OpenSSL),
+ * and distribute linked combinations including the two.
+ *
+ * You must obey the GNU Lesser General Public License in all respects for
+ * all of the code used other than OpenSSL.
+ *
+ * psycopg2 is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <datetime.h>
+
+#include <string.h>
+
+#define PSYCOPG_MODULE
+#include "psycopg/config.h"
+#include "psycopg/python.h"
+#include "psycopg/psycopg.h"
+#include "psycopg/copy_binary.h"
+#include "psycopg/adapter_binary.h"
+#include "psycopg/pgtypes.h"
+
+#ifndef UUIDOID
+#define UUIDOID 2950
+#endif
+#ifndef JSONOID
+#define JSONOID 114
+#endif
+#ifndef JSONBOID
+#define JSONBOID 3802
+#endif
+
+#ifdef _MSC_VER
+#define PY_LONG_LONG_CONST(x) x##i64
+#else
+#define PY_LONG_LONG_CONST(x) x##LL
+#endif
+
+#define POSTGRES_EPOCH_JDATE 2451545    /* julian day of 2000-01-01 */
+#define USECS_PER_DAY PY_LONG_LONG_CONST(86400000000)
+
+#define NUMERIC_POS     0x0000
+#define NUMERIC_NEG     0x4000
+#define NUMERIC_NAN     0xC000
+#define NUMERIC_PINF    0xD000
+#define NUMERIC_NINF    0xF000
+
+int
+psyco_copy_binary_init(void)
+{
+    Dprintf("psyco_copy_binary_init: datetime init");
+
+    PyDateTime_IMPORT;
+
+    if (!PyDateTimeAPI) {
+        PyErr_SetString(PyExc_ImportError, "datetime initialization failed");
+        return -1;
+    }
+    return 0;
+}
+
+
+/** the buffer **/
+
+static int
+copy_buffer_reserve(copyBuffer *buf, Py_ssize_t size)
+{
+    Py_ssize_t alloc;
+    char *data;
+
+    if (buf->len + size <= buf->alloc) return 0;
+
+    alloc = buf->alloc ? buf->alloc : 8192;
+    while (buf->len + size > alloc) { alloc *= 2; }
+    if (!(data = PyMem_Realloc(buf->data, alloc))) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    buf->data = data;
+    buf->alloc = alloc;
+    return 0;
+}
+
+static int
+copy_buffer_append(copyBuffer *buf, const char *data, Py_ssize_t size)
+{
+    if (0 != copy_buffer_reserve(buf, size)) return -1;
+    memcpy(buf->data + buf->len, data, size);
+    buf->len += size;
+    return 0;
+}
+
+/* write big endian integers: room must have been reserved */
+
+static void
+copy_put_uint16(copyBuffer *buf, unsigned int v)
+{
+    unsigned char *c = (unsigned char *)buf->data + buf->len;
+    c[0] = (v >> 8) & 0xFF;
+    c[1] = v & 0xFF;
+    buf->len += 2;
+}
+
+static void
+copy_put_uint32(copyBuffer *buf, unsigned long v)
+{
+    unsigned char *c = (unsigned char *)buf->data + buf->len;
+    c[0] = (v >> 24) & 0xFF;
+    c[1] = (v >> 16) & 0xFF;
+    c[2] = (v >> 8) & 0xFF;
+    c[3] = v & 0xFF;
+    buf->len += 4;
+}
+
+static void
+copy_put_uint64(copyBuffer *buf, unsigned PY_LONG_LONG v)
+{
+    copy_put_uint32(buf, (unsigned long)(v >> 32));
+    copy_put_uint32(buf, (unsigned long)(v & 0xFFFFFFFFUL));
+}
+
+void
+copy_buffer_free(copyBuffer *buf)
+{
+    PyMem_Free(buf->data);
+    buf->data = NULL;
+    buf->len = buf->alloc = 0;
+}
+
+
+/** the encoders **/
+
+static int
+copy_encode_bool(PyObject *obj, copyBuffer *buf, connectionObject *conn)
+{
+    int v;
+    char c;
+
+    if ((v = PyObject_IsTrue(obj)) < 0) return -1;
+    c = v ? 1 : 0;
+    return copy_buffer_append(buf, &c, 1);
+}
+
+static int
+copy_encode_integer(PyObject *obj, copyBuffer *buf, PY_LONG_LONG min,
+                    PY_LONG_LONG max, int size)
+{
+    PY_LONG_LONG v;
+
+    v = PyLong_AsLongLong(obj);
+    if (v == -1 && PyErr_Occurred()) return -1;
+    if (v < min || v > max) {
+        PyErr_SetString(DataError, "integer out of range");
+        return -1;
+    }
+
+    if (0 != copy_buffer_reserve(buf, size)) return -1;
+    switch (size) {
+    case 2:
+        copy_put_uint16(buf, (unsigned int)v);
+        break;
+    case 4:
+        copy_put_uint32(buf, (unsigned long)v);
+        break;
+    default:
+        copy_put_uint64(buf, (unsigned PY_LONG_LONG)v);
+        break;
+    }
+    return 0;
+}
+
+static int
+copy_encode_int2(PyObject *obj, copyBuffer *buf, connectionObject *conn)
+{
+    return copy_encode_integer(obj, buf, -32768, 32767, 2);
+}
+
+static int
+copy_encode_int4(PyObject *obj, copyBuffer *buf, connectionObject *conn)
+{
+    return copy_encode_integer(obj, buf,
+        -PY_LONG_LONG_CONST(2147483647) - 1, PY_LONG_LONG_CONST(2147483647),
+        4);
+}
+
+static int
+copy_encode_int8(PyObject *obj, copyBuffer *buf, connectionObject *conn)
+{
+    return copy_encode_integer(obj, buf, PY_LLONG_MIN, PY_LLONG_MAX, 8);
+}
+
+static int
+copy_encode_oid(PyObject *obj, copyBuffer *buf, connectionObject *conn)
+{
+    return copy_encode_integer(obj, buf, 0, PY_LONG_LONG_CONST(4294967295),
+        4);
+}
+
+static int
+copy_encode_float4(PyObject *obj, copyBuffer *buf, connectionObject *conn)
+{
+    union { unsigned int i; float f; } v;
+    double d;
+
+    d = PyFloat_AsDouble(obj);
+    if (d == -1.0 && PyErr_Occurred()) return -1;
+    v.f = (float)d;
+
+    if (0 != copy_buffer_reserve(buf, 4)) return -1;
+    copy_put_uint32(buf, v.i);
+    return 0;
+}
+
+static int
+copy_encode_float8(PyObject *obj, copyBuffer *buf, connectionObject *conn)
+{
+    union { unsigned PY_LONG_LONG i; double d; } v;
+
+    v.d = PyFloat_AsDouble(obj);
+    if (v.d == -1.0 && PyErr_Occurred()) return -1;
+
+    if (0 != copy_buffer_reserve(buf, 8)) return -1;
+    copy_put_uint64(buf, v.i);
+    return 0;
+}
+
+/* write a numeric header followed by no digit */
+
+static int
+copy_encode_numeric_special(copyBuffer *buf, unsigned int sign)
+{
+    if (0 != copy_buffer_reserve(buf, 8)) return -1;
+    copy_put_uint16(buf, 0);
+    copy_put_uint16(buf, 0);
+    copy_put_uint16(buf, sign);
+    copy_put_uint16(buf, 0);
+    return 0;
+}
+
+/* parse the text representation of a number (as returned by Decimal, int
+   or float) and write it in base 10000 digits */
+
+static int
+copy_encode_numeric(PyObject *obj, copyBuffer *buf, connectionObject *conn)
+{
+    PyObject *str;
+    const char *s, *digs;
+    char *end, *tmp = NULL, *c;
+    unsigned int sign = NUMERIC_POS;
+    long exp = 0, point, weight, dscale, offset, ngroups, g, k, idx, val;
+    long ndig = 0, nfrac = 0;
+    int rv = -1, seen_point = 0;
+
+    if (PyFloat_Check(obj)) {
+        str = PyObject_Repr(obj);
+    }
+    else {
+        str = PyObject_Str(obj);
+    }
+    if (!str) return -1;
+    s = PyString_AS_STRING(str);
+
+    if (*s == '-') { sign = NUMERIC_NEG; s++; }
+    else if (*s == '+') { s++; }
+
+    if (0 == PyOS_stricmp(s, "nan")) {
+        rv = copy_encode_numeric_special(buf, NUMERIC_NAN);
+        goto exit;
+    }
+    if (0 == PyOS_stricmp(s, "inf") || 0 == PyOS_stricmp(s, "infinity")) {
+        rv = copy_encode_numeric_special(buf,
+            sign == NUMERIC_NEG ? NUMERIC_NINF : NUMERIC_PINF);
+        goto exit;
+    }
+
+    /* the digits of the mantissa: the point is skipped */
+    digs = s;
+    for (; *s; s++) {
+        if (*s >= '0' && *s <= '9') {
+            ndig++;
+            if (seen_point) nfrac++;
+        }
+        else if (*s == '.' && !seen_point) {
+            seen_point = 1;
+        }
+        else {
+            break;
+        }
+    }
+    if (ndig == 0) { goto bad; }
+    if (*s == 'e' || *s == 'E') {
+        exp = strtol(s + 1, &end, 10);
+        if (end == s + 1 || *end) { goto bad; }
+    }
+    else if (*s) { goto bad; }
+
+    /* point is the position of the decimal point from the first digit */
+    point = ndig - nfrac + exp;
+    dscale = nfrac - exp > 0 ? nfrac - exp : 0;
+
+    /* use a copy of the digits without the point */
+    if (!(tmp = PyMem_Malloc(ndig + 1))) {
+        PyErr_NoMemory();
+        goto exit;
+    }
+    for (c = tmp; c - tmp < ndig; digs++) {
+        if (*digs != '.') *c++ = *digs;
+    }
+
+    /* strip leading and trailing zeros */
+    s = tmp;
+    while (ndig > 0 && *s == '0') { s++; ndig--; point--; }
+    while (ndig > 0 && s[ndig - 1] == '0') { ndig--; }
+
+    if (ndig == 0) {
+        weight = 0;
+        ngroups = 0;
+        offset = 0;
+        sign = NUMERIC_POS;
+    }
+    else {
+        weight = point > 0 ? (point - 1) / 4 : -((-point) / 4) - 1;
+        offset = (weight + 1) * 4 - point;
+        ngroups = (offset + ndig + 3) / 4;
+    }
+
+    if (weight < -32768 || weight > 32767 || dscale > 0x3FFF
+            || ngroups > 0xFFFF) {
+        PyErr_SetString(DataError, "numeric value out of range");
+        goto exit;
+    }
+
+    if (0 != copy_buffer_reserve(buf, 8 + ngroups * 2)) { goto exit; }
+    copy_put_uint16(buf, (unsigned int)ngroups);
+    copy_put_uint16(buf, (unsigned int)(weight & 0xFFFF));
+    copy_put_uint16(buf, sign);
+    copy_put_uint16(buf, (unsigned int)dscale);
+    for (g = 0; g < ngroups; g++) {
+        val = 0;
+        for (k = 0; k < 4; k++) {
+            idx = g * 4 + k - offset;
+            val = val * 10 + ((idx >= 0 && idx < ndig) ? s[idx] - '0' : 0);
+        }
+        copy_put_uint16(buf, (unsigned int)val);
+    }
+    rv = 0;
+    goto exit;
+
+bad:
+    PyErr_Format(DataError, "invalid numeric value: %s",
+        PyString_AS_STRING(str));
+
+exit:
+    PyMem_Free(tmp);
+    Py_DECREF(str);
+    return rv;
+}
+
+/* the binary representation of the text types is the string itself */
+
+static int
+copy_encode_text(PyObject *obj, copyBuffer *buf, connectionObject *conn)
+{
+    PyObject *str, *enc;
+    int rv;
+
+    if (PyString_Check(obj)) {
+        return copy_buffer_append(buf,
+            PyString_AS_STRING(obj), PyString_GET_SIZE(obj));
+    }
+
+    if (PyUnicode_Check(obj)) {
+        if (!(enc = PyDict_GetItemString(psycoEncodings, conn->encoding))) {
+            PyErr_Format(InterfaceError,
+                "can't encode unicode string to %s", conn->encoding);
+            return -1;
+        }
+        str = PyUnicode_AsEncodedString(obj, PyString_AsString(enc), NULL);
+    }
+    else {
+        str = PyObject_Str(obj);
+    }
+    if (!str) return -1;
+
+    rv = copy_buffer_append(buf, PyString_AS_STRING(str),
+        PyString_GET_SIZE(str));
+    Py_DECREF(str);
+    return rv;
+}
+
+static int
+copy_encode_jsonb(PyObject *obj, copyBuffer *buf, connectionObject *conn)
+{
+    /* jsonb version number */
+    if (0 != copy_buffer_append(buf, "\x01", 1)) return -1;
+    return copy_encode_text(obj, buf, conn);
+}
+
+static int
+copy_encode_bytea(PyObject *obj, copyBuffer *buf, connectionObject *conn)
+{
+    const void *data;
+    Py_ssize_t size;
+
+    /* unwrap the psycopg2.Binary objects */
+    if (Py_TYPE(obj) == &binaryType) {
+        obj = ((binaryObject *)obj)->wrapped;
+    }
+    if (0 != PyObject_AsReadBuffer(obj, &data, &size)) return -1;
+    return copy_buffer_append(buf, data, size);
+}
+
+/* convert a date into a julian day (algorithm from PostgreSQL date2j()) */
+
+static long
+copy_date2j(int y, int m, int d)
+{
+    long julian, century;
+
+    if (m > 2) {
+        m += 1;
+        y += 4800;
+    }
+    else {
+        m += 13;
+        y += 4799;
+    }
+
+    century = y / 100;
+    julian = y * 365 - 32167;
+    julian += y / 4 - century + century / 4;
+    julian += 7834 * m / 256 + d;
+
+    return julian;
+}
+
+static int
+copy_encode_date(PyObject *obj, copyBuffer *buf, connectionObject *conn)
+{
+    if (!PyDate_Check(obj)) {
+        PyErr_Format(PyExc_TypeError, "expected date, got %s",
+            Py_TYPE(obj)->tp_name);
+        return -1;
+    }
+
+    if (0 != copy_buffer_reserve(buf, 4)) return -1;
+    copy_put_uint32(buf, (unsigned long)(copy_date2j(
+        PyDateTime_GET_YEAR(obj), PyDateTime_GET_MONTH(obj),
+        PyDateTime_GET_DAY(obj)) - POSTGRES_EPOCH_JDATE));
+    return 0;
+}
+
+/* encode a datetime as microseconds from 2000-01-01, optionally converting
+   it to UTC if it has a timezone */
+
+static int
+copy_encode_datetime(PyObject *obj, copyBuffer *buf, int utc)
+{
+    PY_LONG_LONG ts;
+    PyObject *off;
+    PyDateTime_Delta *delta;
+
+    if (!PyDateTime_Check(obj)) {
+        PyErr_Format(PyExc_TypeError, "expected datetime, got %s",
+            Py_TYPE(obj)->tp_name);
+        return -1;
+    }
+
+    ts = (copy_date2j(PyDateTime_GET_YEAR(obj), PyDateTime_GET_MONTH(obj),
+                      PyDateTime_GET_DAY(obj)) - POSTGRES_EPOCH_JDATE)
+        * USECS_PER_DAY;
+    ts += ((PY_LONG_LONG)(PyDateTime_DATE_GET_HOUR(obj) * 60
+            + PyDateTime_DATE_GET_MINUTE(obj)) * 60
+            + PyDateTime_DATE_GET_SECOND(obj)) * 1000000
+        + PyDateTime_DATE_GET_MICROSECOND(obj);
+
+    if (utc) {
+        if (!(off = PyObject_CallMethod(obj, "utcoffset", NULL))) return -1;
+        if (off != Py_None) {
+            if (!PyDelta_Check(off)) {
+                Py_DECREF(off);
+                PyErr_SetString(PyExc_TypeError,
+                    "utcoffset() must return a timedelta");
+                return -1;
+            }
+            delta = (PyDateTime_Delta *)off;
+            ts -= delta->days * USECS_PER_DAY
+                + (PY_LONG_LONG)delta->seconds * 1000000
+                + delta->microseconds;
+        }
+        Py_DECREF(off);
+    }
+
+    if (0 != copy_buffer_reserve(buf, 8)) return -1;
+    copy_put_uint64(buf, (unsigned PY_LONG_LONG)ts);
+    return 0;
+}
+
+static int
+copy_encode_timestamp(PyObject *obj, copyBuffer *buf, connectionObject *conn)
+{
+    return copy_encode_datetime(obj, buf, 0);
+}
+
+/* naive datetime are taken as UTC */
+
+static int
+copy_encode_timestamptz(PyObject *obj, copyBuffer *buf,
+                        connectionObject *conn)
+{
+    return copy_encode_datetime(obj, buf, 1);
+}
+
+/* accept uuid.UUID objects or their string representation */
+
+static int
+copy_encode_uuid(PyObject *obj, copyBuffer *buf, connectionObject *conn)
+{
+    PyObject *str;
+    unsigned char data[16];
+    const char *s;
+    int n = 0, v, rv = -1;
+
+    if (!PyString_Check(obj) && PyObject_HasAttrString(obj, "bytes")) {
+        str = PyObject_GetAttrString(obj, "bytes");
+        if (str && PyString_Check(str) && PyString_GET_SIZE(str) == 16) {
+            rv = copy_buffer_append(buf, PyString_AS_STRING(str), 16);
+            Py_DECREF(str);
+            return rv;
+        }
+        Py_XDECREF(str);
+        if (PyErr_Occurred()) return -1;
+    }
+
+    if (!(str = PyObject_Str(obj))) return -1;
+    for (s = PyString_AS_STRING(str); *s; s++) {
+        if (*s == '-' || *s == '{' || *s == '}') continue;
+        if (*s >= '0' && *s <= '9') v = *s - '0';
+        else if (*s >= 'a' && *s <= 'f') v = *s - 'a' + 10;
+        else if (*s >= 'A' && *s <= 'F') v = *s - 'A' + 10;
+        else break;
+        if (n >= 32) break;
+        if (n % 2) data[n / 2] |= v; else data[n / 2] = v << 4;
+        n++;
+    }
+    if (*s || n != 32) {
+        PyErr_Format(DataError, "invalid uuid value: %s",
+            PyString_AS_STRING(str));
+    }
+    else {
+        rv = copy_buffer_append(buf, (char *)data, 16);
+    }
+    Py_DECREF(str);
+    return rv;
+}
+
+
+/** the record encoding **/
+
+/* return the encoder for a PostgreSQL type, or NULL if not available */
+
+copy_encoder
+copy_binary_encoder(Oid type)
+{
+    switch (type) {
+    case BOOLOID: return copy_encode_bool;
+    case INT2OID: return copy_encode_int2;
+    case INT4OID: return copy_encode_int4;
+    case INT8OID: return copy_encode_int8;
+    case OIDOID: return copy_encode_oid;
+    case FLOAT4OID: return copy_encode_float4;
+    case FLOAT8OID: return copy_encode_float8;
+    case NUMERICOID: return copy_encode_numeric;
+    case TEXTOID: case VARCHAROID: case BPCHAROID: case NAMEOID:
+    case CHAROID: case JSONOID:
+        return copy_encode_text;
+    case JSONBOID: return copy_encode_jsonb;
+    case BYTEAOID: return copy_encode_bytea;
+    case DATEOID: return copy_encode_date;
+    case TIMESTAMPOID: return copy_encode_timestamp;
+    case TIMESTAMPTZOID: return copy_encode_timestamptz;
+    case UUIDOID: return copy_encode_uuid;
+    default: return NULL;
+    }
+}
+
+int
+copy_binary_header(copyBuffer *buf)
+{
+    /* signature, flags and header extension length */
+    return copy_buffer_append(buf, "PGCOPY\n\377\r\n\0"
+        "\0\0\0\0" "\0\0\0\0", 19);
+}
+
+int
+copy_binary_trailer(copyBuffer *buf)
+{
+    return copy_buffer_append(buf, "\377\377", 2);
+}
+
+/* append a record to the buffer of the copy operation */
+
+int
+copy_binary_record(copyRecords *rec, PyObject *record,
+                   connectionObject *conn)
+{
+    PyObject *seq, *item;
+    Py_ssize_t start, size;
+    int i, rv = -1;
+
+    if (!(seq = PySequence_Fast(record, "records must be sequences"))) {
+        return -1;
+    }
+    if (PySequence_Fast_GET_SIZE(seq) != rec->ncols) {
+        PyErr_Format(ProgrammingError,
+            "record has " FORMAT_CODE_PY_SSIZE_T " items, %d expected",
+            PySequence_Fast_GET_SIZE(seq), rec->ncols);
+        goto exit;
+    }
+
+    if (0 != copy_buffer_reserve(&rec->buf, 2)) { goto exit; }
+    copy_put_uint16(&rec->buf, rec->ncols);
+
+    for (i = 0; i < rec->ncols; i++) {
+        item = PySequence_Fast_GET_ITEM(seq, i);
+        if (0 != copy_buffer_reserve(&rec->buf, 4)) { goto exit; }
+        if (item == Py_None) {
+            copy_put_uint32(&rec->buf, 0xFFFFFFFFUL);
+            continue;
+        }
+
+        /* write the length after the data */
+        start = rec->buf.len;
+        rec->buf.len += 4;
+        if (0 != rec->encoders[i](item, &rec->buf, conn)) { goto exit; }
+        size = rec->buf.len - start - 4;
+        if (size > 0x7FFFFFFF) {
+            PyErr_SetString(DataError, "field too large");
+            goto exit;
+        }
+        rec->buf.len = start;
+        copy_put_uint32(&rec->buf, (unsigned long)size);
+        rec->buf.len += size;
+    }
+    rv = 0;
+
+exit:
+    Py_DECREF(seq);
+    return rv;
+}
@@ -0,0 +1,74 @@
+/* copy_binary.h - definitions for the binary COPY encoders
+ *
+ * Copyright (C) 2003-2010 Federico Di Gregorio <fog@debian.org>
+ *
+ * This file is part of psycopg.
+ *
+ * psycopg2 is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link this program with the OpenSSL library (or with
+ * modified versions of OpenSSL that use the same license as OpenSSL),
+ * and distribute linked combinations including the two.
+ *
+ * You must obey the GNU Lesser General Public License in all respects for
+ * all of the code used other than OpenSSL.
+ *
+ * psycopg2 is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ */
+
+#ifndef PSYCOPG_COPY_BINARY_H
+#define PSYCOPG_COPY_BINARY_H 1
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <libpq-fe.h>
+
+#include "psycopg/config.h"
+#include "psycopg/connection.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* a growing buffer of COPY data */
+typedef struct {
+    char *data;
+    Py_ssize_t len;
+    Py_ssize_t alloc;
+} copyBuffer;
+
+/* append the binary representation of obj (not its length) to buf;
+   return 0 on success, -1 and set an exception on error */
+typedef int (*copy_encoder)(PyObject *obj, copyBuffer *buf,
+                            connectionObject *conn);
+
+/* the state of a copy_records() operation */
+typedef struct copyRecords {
+    PyObject *iter;           /* iterator on the records to send */
+    int ncols;                /* number of fields per record */
+    copy_encoder *encoders;   /* the encoder for each field */
+    Py_ssize_t size;          /* send the data when the buffer is this big */
+    copyBuffer buf;
+} copyRecords;
+
+/* exported functions */
+HIDDEN int psyco_copy_binary_init(void);
+HIDDEN copy_encoder copy_binary_encoder(Oid type);
+HIDDEN int copy_binary_header(copyBuffer *buf);
+HIDDEN int copy_binary_record(copyRecords *rec, PyObject *record,
+                              connectionObject *conn);
+HIDDEN int copy_binary_trailer(copyBuffer *buf);
+HIDDEN void copy_buffer_free(copyBuffer *buf);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !defined(PSYCOPG_COPY_BINARY_H) */
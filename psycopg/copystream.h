@@ -0,0 +1,68 @@
+/* copystream.h - definition for the COPY stream type
+ *
+ * Copyright (C) 2010 Federico Di Gregorio <fog@debian.org>
+ *
+ * This file is part of psycopg.
+ *
+ * psycopg2 is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link this program with the OpenSSL library (or with
+ * modified versions of OpenSSL that use the same license as OpenSSL),
+ * and distribute linked combinations including the two.
+ *
+ * You must obey the GNU Lesser General Public License in all respects for
+ * all of the code used other than OpenSSL.
+ *
+ * psycopg2 is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ */
+
+#ifndef PSYCOPG_COPYSTREAM_H
+#define PSYCOPG_COPYSTREAM_H 1
+
+#include <Python.h>
+
+#include "psycopg/config.h"
+#include "psycopg/cursor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern HIDDEN PyTypeObject copystreamType;
+
+#define COPYSTREAM_OUT 0        /* COPY TO: data read from the backend */
+#define COPYSTREAM_IN  1        /* COPY FROM: data written to the backend */
+
+typedef struct {
+    PyObject_HEAD
+
+    cursorObject *cursor;   /* the cursor the COPY was executed on */
+    int direction;          /* COPYSTREAM_OUT or COPYSTREAM_IN */
+    int closed;             /* 1 once the COPY is terminated */
+
+    Py_ssize_t size;        /* minimum size of the chunks read */
+    char *buf;              /* buffer reused to read the chunks */
+    Py_ssize_t balloc;      /* allocated size of buf */
+} copystreamObject;
+
+#ifdef PSYCOPG_EXTENSIONS
+#define copystream_Check(op) PyObject_TypeCheck(op, &copystreamType)
+#else
+#define copystream_Check(op) 0
+#endif
+
+HIDDEN PyObject *copystream_new(cursorObject *cursor, int direction,
+                                Py_ssize_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !defined(PSYCOPG_COPYSTREAM_H) */
@@ -0,0 +1,400 @@
+/* copystream_type.c - python interface to COPY streams
+ *
+ * Copyright (C) 2010 Federico Di Gregorio <fog@debian.org>
+ *
+ * This file is part of psycopg.
+ *
+ * psycopg2 is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link this program with the OpenSSL library (or with
+ * modified versions of OpenSSL that use the same license as OpenSSL),
+ * and distribute linked combinations including the two.
+ *
+ * You must obey the GNU Lesser General Public License in all respects for
+ * all of the code used other than OpenSSL.
+ *
+ * psycopg2 is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <structmember.h>
+
+#define PSYCOPG_MODULE
+#include "psycopg/config.h"
+#include "psycopg/python.h"
+#include "psycopg/psycopg.h"
+#include "psycopg/copystream.h"
+#include "psycopg/connection.h"
+#include "psycopg/cursor.h"
+#include "psycopg/pqpath.h"
+
+
+#ifdef PSYCOPG_EXTENSIONS
+
+#define EXC_IF_STREAM_CLOSED(self) \
+  if ((self)->closed || (self)->cursor->conn->closed) { \
+    PyErr_SetString(InterfaceError, "copy stream already closed"); \
+    return NULL; }
+
+/* mark the stream closed, letting the connection run other commands */
+
+static void
+copystream_set_closed(copystreamObject *self)
+{
+    self->closed = 1;
+    if (self->cursor->conn->copy_stream == (PyObject *)self) {
+        self->cursor->conn->copy_stream = NULL;
+    }
+}
+
+/* terminate the COPY operation
+
+   errormsg is the reason to abort a COPY FROM, NULL to complete it. The
+   data of a COPY TO still pending is discarded. */
+
+static int
+copystream_close(copystreamObject *self, const char *errormsg)
+{
+    PyObject *chunk;
+    int res;
+
+    if (self->closed || self->cursor->conn->closed) {
+        copystream_set_closed(self);
+        return 0;
+    }
+    copystream_set_closed(self);
+
+    if (self->direction == COPYSTREAM_IN) {
+        return pq_copy_in_end(self->cursor, errormsg);
+    }
+
+    while (1 == (res = pq_copy_out_chunk(self->cursor, self->size,
+                                         &self->buf, &self->balloc, &chunk))) {
+        Py_XDECREF(chunk);
+    }
+    Py_XDECREF(chunk);
+    return res;
+}
+
+/** public methods **/
+
+/* write method - send data to a COPY FROM */
+
+#define psyco_copystream_write_doc \
+"write(data) -- Send a chunk of data to the COPY FROM operation."
+
+static PyObject *
+psyco_copystream_write(copystreamObject *self, PyObject *args)
+{
+    Py_buffer data;
+    int res;
+
+    if (!PyArg_ParseTuple(args, "s*", &data)) return NULL;
+
+    if (self->direction != COPYSTREAM_IN) {
+        PyBuffer_Release(&data);
+        PyErr_SetString(ProgrammingError,
+            "write() can only be used in a COPY FROM stream");
+        return NULL;
+    }
+    if (self->closed || self->cursor->conn->closed) {
+        PyBuffer_Release(&data);
+        PyErr_SetString(InterfaceError, "copy stream already closed");
+        return NULL;
+    }
+
+    res = pq_copy_in_chunk(self->cursor, data.buf, data.len);
+    PyBuffer_Release(&data);
+    if (res < 0) return NULL;
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+/* close method - terminate the COPY */
+
+#define psyco_copystream_close_doc \
+"close() -- Terminate the COPY operation.\n\n" \
+"A COPY FROM is completed; the data of a COPY TO not read yet is discarded."
+
+static PyObject *
+psyco_copystream_close(copystreamObject *self, PyObject *args)
+{
+    if (copystream_close(self, NULL) < 0) return NULL;
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+/* __enter__ and __exit__ methods - context manager protocol */
+
+static PyObject *
+psyco_copystream_enter(copystreamObject *self, PyObject *args)
+{
+    EXC_IF_STREAM_CLOSED(self);
+
+    Py_INCREF(self);
+    return (PyObject *)self;
+}
+
+/* an exception in the with block aborts the COPY FROM */
+
+static PyObject *
+psyco_copystream_exit(copystreamObject *self, PyObject *args)
+{
+    PyObject *type, *value, *tb;
+
+    if (!PyArg_ParseTuple(args, "OOO", &type, &value, &tb)) return NULL;
+
+    if (type == Py_None) {
+        if (copystream_close(self, NULL) < 0) return NULL;
+    }
+    else {
+        /* don't replace the exception raised in the block */
+        if (copystream_close(self, "error in the copy stream") < 0)
+            PyErr_Clear();
+    }
+
+    Py_INCREF(Py_False);
+    return Py_False;
+}
+
+/* iterator protocol - read the chunks of a COPY TO */
+
+static PyObject *
+copystream_iter(PyObject *self)
+{
+    Py_INCREF(self);
+    return self;
+}
+
+static PyObject *
+copystream_next(PyObject *obj)
+{
+    copystreamObject *self = (copystreamObject *)obj;
+    PyObject *chunk;
+    int res;
+
+    if (self->direction != COPYSTREAM_OUT) {
+        PyErr_SetString(ProgrammingError,
+            "only a COPY TO stream can be iterated");
+        return NULL;
+    }
+    /* the stream is exhausted */
+    if (self->closed) return NULL;
+    if (self->cursor->conn->closed) {
+        PyErr_SetString(InterfaceError, "connection already closed");
+        return NULL;
+    }
+
+    res = pq_copy_out_chunk(self->cursor, self->size,
+                            &self->buf, &self->balloc, &chunk);
+    if (res <= 0) copystream_set_closed(self);
+
+    return chunk;
+}
+
+/* closed attribute */
+
+static PyObject *
+psyco_copystream_get_closed(copystreamObject *self, void *closure)
+{
+    PyObject *closed;
+
+    closed = (self->closed || self->cursor->conn->closed) ? Py_True : Py_False;
+    Py_INCREF(closed);
+    return closed;
+}
+
+
+/** the COPY stream object **/
+
+/* object method list */
+
+static struct PyMethodDef copystreamObject_methods[] = {
+    {"write", (PyCFunction)psyco_copystream_write,
+     METH_VARARGS, psyco_copystream_write_doc},
+    {"close", (PyCFunction)psyco_copystream_close,
+     METH_NOARGS, psyco_copystream_close_doc},
+    {"__enter__", (PyCFunction)psyco_copystream_enter,
+     METH_NOARGS, NULL},
+    {"__exit__", (PyCFunction)psyco_copystream_exit,
+     METH_VARARGS, NULL},
+    {NULL}
+};
+
+/* object member list */
+
+static struct PyMemberDef copystreamObject_members[] = {
+    {"cursor", T_OBJECT, offsetof(copystreamObject, cursor), RO,
+        "The cursor the COPY was executed on."},
+    {NULL}
+};
+
+/* object getset list */
+
+static struct PyGetSetDef copystreamObject_getsets[] = {
+    {"closed", (getter)psyco_copystream_get_closed, NULL,
+     "True if the COPY operation is terminated."},
+    {NULL}
+};
+
+/* initialization and finalization methods */
+
+PyObject *
+copystream_new(cursorObject *cursor, int direction, Py_ssize_t size)
+{
+    copystreamObject *self;
+
+    if (!(self = PyObject_New(copystreamObject, &copystreamType))) {
+        return NULL;
+    }
+
+    Py_INCREF(cursor);
+    self->cursor = cursor;
+    self->direction = direction;
+    self->closed = 0;
+    self->size = size;
+    self->buf = NULL;
+    self->balloc = 0;
+
+    Dprintf("copystream_new: new copy stream at %p: direction = %d",
+            self, direction);
+
+    return (PyObject *)self;
+}
+
+/* terminate a COPY not explicitly closed
+
+   a COPY FROM is aborted and a COPY TO is canceled, rather than reading
+   all its data, so the transaction is left in error in both cases. The
+   error is reported on the cursor: the stream is being deleted. */
+
+static void
+copystream_abort(copystreamObject *self)
+{
+    connectionObject *conn = self->cursor->conn;
+    PyObject *exc, *val, *tb;
+    char errbuf[256];
+    int res;
+
+    if (self->closed || conn->closed) {
+        copystream_set_closed(self);
+        return;
+    }
+
+    PyErr_Fetch(&exc, &val, &tb);
+
+    if (self->direction == COPYSTREAM_IN) {
+        res = copystream_close(self, "copy stream not closed");
+    }
+    else {
+        Py_BEGIN_ALLOW_THREADS;
+        res = PQcancel(conn->cancel, errbuf, sizeof(errbuf));
+        Py_END_ALLOW_THREADS;
+        if (res == 0) {
+            Dprintf("copystream_abort: cancelling failed: %s", errbuf);
+        }
+        /* only the data already sent before the cancel is read */
+        res = copystream_close(self, NULL);
+    }
+
+    /* the error of the COPY terminated is expected */
+    if (res < 0 && !PyErr_ExceptionMatches(QueryCanceledError)) {
+        PyErr_WriteUnraisable((PyObject *)self->cursor);
+    }
+    PyErr_Clear();
+    PyErr_Restore(exc, val, tb);
+}
+
+static void
+copystream_dealloc(PyObject* obj)
+{
+    copystreamObject *self = (copystreamObject *)obj;
+
+    copystream_abort(self);
+
+    if (self->buf) free(self->buf);
+    Py_XDECREF((PyObject *)self->cursor);
+
+    Dprintf("copystream_dealloc: deleted copy stream at %p, refcnt = "
+            FORMAT_CODE_PY_SSIZE_T, obj, obj->ob_refcnt);
+
+    PyObject_Del(obj);
+}
+
+static PyObject *
+copystream_repr(copystreamObject *self)
+{
+    return PyString_FromFormat(
+        "<copy stream object at %p; direction: %s, closed: %d>", self,
+        self->direction == COPYSTREAM_IN ? "in" : "out", self->closed);
+}
+
+
+/* object type */
+
+#define copystreamType_doc \
+"A stream of data exchanged with a COPY operation."
+
+PyTypeObject copystreamType = {
+    PyObject_HEAD_INIT(NULL)
+    0,
+    "psycopg2._psycopg.CopyStream",
+    sizeof(copystreamObject),
+    0,
+    copystream_dealloc, /*tp_dealloc*/
+    0,          /*tp_print*/
+    0,          /*tp_getattr*/
+    0,          /*tp_setattr*/
+    0,          /*tp_compare*/
+    (reprfunc)copystream_repr, /*tp_repr*/
+    0,          /*tp_as_number*/
+    0,          /*tp_as_sequence*/
+    0,          /*tp_as_mapping*/
+    0,          /*tp_hash */
+
+    0,          /*tp_call*/
+    (reprfunc)copystream_repr, /*tp_str*/
+    0,          /*tp_getattro*/
+    0,          /*tp_setattro*/
+    0,          /*tp_as_buffer*/
+
+    Py_TPFLAGS_DEFAULT|Py_TPFLAGS_HAVE_ITER, /*tp_flags*/
+    copystreamType_doc, /*tp_doc*/
+
+    0,          /*tp_traverse*/
+    0,          /*tp_clear*/
+
+    0,          /*tp_richcompare*/
+    0,          /*tp_weaklistoffset*/
+
+    copystream_iter, /*tp_iter*/
+    copystream_next, /*tp_iternext*/
+
+    /* Attribute descriptor and subclassing stuff */
+
+    copystreamObject_methods, /*tp_methods*/
+    copystreamObject_members, /*tp_members*/
+    copystreamObject_getsets, /*tp_getset*/
+    0,          /*tp_base*/
+    0,          /*tp_dict*/
+
+    0,          /*tp_descr_get*/
+    0,          /*tp_descr_set*/
+    0,          /*tp_dictoffset*/
+
+    0,          /*tp_init*/
+    0,          /*tp_alloc*/
+    0,          /*tp_new*/
+};
+
+#endif
@@ -32,6 +32,7 @@
 
 #include "psycopg/config.h"
 #include "psycopg/connection.h"
+#include "psycopg/typecast.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -39,6 +40,22 @@ extern "C" {
 
 extern HIDDEN PyTypeObject cursorType;
 
+/* number of tzinfo objects cached by the cursor */
+#define CURSOR_TZ_CACHE 4
+
+/* the parameters of a query, defined in pqpath.h */
+struct pqParams;
+
+/* the results of a query following the one being fetched, kept for
+   nextset(): allocated with malloc() as they are stored without the GIL */
+typedef struct cursorResults {
+    PGresult **results;
+    int len;              /* number of results stored */
+    int size;             /* number of results allocated */
+    int next;             /* the result moved to by nextset() */
+    int lost;             /* 1 if a result couldn't be stored */
+} cursorResults;
+
 typedef struct {
     PyObject_HEAD
 
@@ -46,33 +63,63 @@ typedef struct {
 
     int closed:1;            /* 1 if the cursor is closed */
     int notuples:1;          /* 1 if the command was not a SELECT query */
+    int async_queued:1;      /* 1 if waiting in the connection async_queue
+                                or for the result of its pipelined query */
+    int async_canceled:1;    /* 1 if dropped from the queue by cancel() */
 
     long int rowcount;       /* number of rows affected by last execute */
     long int columns;        /* number of columns fetched from the db */
     long int arraysize;      /* how many rows should fetchmany() return */
+    long int itersize;       /* how many rows should iter(cursor) fetch */
+    long int nogil_batch;    /* rows parsed at time without the GIL */
     long int row;            /* the row counter for fetch*() operations */
     long int mark;           /* transaction marker, copied from conn */
 
     PyObject *description;   /* read-only attribute: sequence of 7-item
-                                sequences.*/
+                                sequences, NULL until read from pgres.*/
 
     /* postgres connection stuff */
     PGresult   *pgres;     /* result of last query */
+    PGresult   *shared_pgres;   /* pgres, if owned by shared_result */
+    PyObject   *shared_result;  /* the owner of the result of lazy rows */
+    PyObject   *cast_owner;     /* the owner of the values being cast, set
+                                   by the caller: NULL or None to copy them */
     PyObject   *pgstatus;  /* last message from the server after an execute */
     Oid         lastoid;   /* last oid from an insert or InvalidOid */
 
     PyObject *casts;       /* an array (tuple) of typecast functions */
+    PyObject *casts_entry; /* the casts cache entry of the result shape */
     PyObject *caster;      /* the current typecaster object */
+    typecast_function *ccasts; /* the C functions of casts, NULL if any of
+                                  the typecasters is a Python one */
+    struct cursorBatch *batch; /* the values being parsed by fetch*() */
 
     PyObject  *copyfile;   /* file-like used during COPY TO/FROM ops */
     Py_ssize_t copysize;   /* size of the copy buffer during COPY TO/FROM ops */
+    struct copyRecords *copyrecords; /* records sent by copy_records() */
 #define DEFAULT_COPYSIZE 16384
 #define DEFAULT_COPYBUFF  8132
+#define DEFAULT_COPYOUTBUFF 65536
+#define DEFAULT_COPYRECORDSBUFF 65536
+#define DEFAULT_ITERSIZE 2000
 
     PyObject *tuple_factory;    /* factory for result tuples */
+    PyObject *row_desc;         /* the description of row_index */
+    PyObject *row_index;        /* column name -> position for dict rows */
+    PyObject *row_names;        /* the column names for dict rows */
     PyObject *tzinfo_factory;   /* factory for tzinfo objects */
+    PyObject *tz_factory;       /* the factory of the cached tzinfo */
+    PyObject *tz_cache[CURSOR_TZ_CACHE];    /* tzinfo built by tz_factory */
+    int tz_offset[CURSOR_TZ_CACHE];         /* their offset, in minutes */
+    int tz_next;                /* the next cache slot to replace */
+
+    PyObject *intern_columns;   /* the columns whose equal values are shared */
+    struct cursorIntern **interns;  /* per column, NULL if not interned */
+    int ninterns;               /* the number of columns in interns */
 
     PyObject *query;      /* last query executed */
+    struct pqParams *async_params; /* the parameters of the query queued */
+    struct cursorQuery *query_layout; /* the last query parsed */
 
     char *qattr;          /* quoting attr, used when quoting strings */
     char *notice;         /* a notice from the backend */
@@ -81,10 +128,56 @@ typedef struct {
     PyObject *string_types;   /* a set of typecasters for string types */
     PyObject *binary_types;   /* a set of typecasters for binary types */
 
+    int server_params;    /* pass query arguments out-of-line */
+    int binary;           /* ask for results in binary format */
+
+    long int streaming;   /* rows received at time by a streaming query */
+    long int rowoffset;   /* number of the first row in pgres */
+    int stream_pending;   /* 1 if the streaming query has more rows */
+
+    Py_ssize_t result_limit; /* max bytes of a result in memory, 0 = any */
+    int result_limit_stream; /* stream the results exceeding result_limit
+                                instead of raising an error */
+
+    int cache_results;    /* use the connection result_cache */
+
+    int multiple_results; /* keep all the results of a query for nextset() */
+    cursorResults nextsets;   /* the results following the current one */
+
+    /* The methods using the cursor state hold its lock: threads sharing a
+       cursor wait their turn, while the cursors of the same connection only
+       take the connection lock to talk to the backend. The lock can be taken
+       again by the thread holding it (e.g. from a typecaster).
+
+       The cursor lock is taken before the connection one and never while
+       holding it. conn_poll() also takes the lock of the async cursor whose
+       result it stores, so a typecaster holding the lock of its cursor must
+       not use other cursors nor poll the connection: two threads doing it
+       the other way round would deadlock. */
+    pthread_mutex_t lock;
+    long lock_owner;      /* thread ident of the lock holder */
+    int lock_depth;       /* 0 if the lock is free */
+
 } cursorObject;
 
 /* C-callable functions in cursor_int.c and cursor_ext.c */
 HIDDEN void curs_reset(cursorObject *self);
+HIDDEN PyObject *curs_tzinfo(cursorObject *self, int offset);
+HIDDEN void curs_clear_tzinfo(cursorObject *self);
+HIDDEN void curs_intern_setup(cursorObject *self);
+HIDDEN PyObject *curs_intern_cast(cursorObject *self, int col,
+                                  const char *str, Py_ssize_t len);
+HIDDEN void curs_intern_free(cursorObject *self);
+HIDDEN void curs_clear_results(cursorObject *self);
+HIDDEN void curs_lock(cursorObject *self);
+HIDDEN void curs_unlock(cursorObject *self);
+
+/* clear the cursor result, unless it is owned by its lazy rows */
+#define IFCLEARCURSPGRES(curs) \
+if ((curs)->pgres) {                                \
+    if ((curs)->pgres != (curs)->shared_pgres)      \
+        PQclear((curs)->pgres);                     \
+    (curs)->pgres = NULL; }
 
 /* exception-raising macros */
 #define EXC_IF_CURS_CLOSED(self) \
@@ -94,6 +187,10 @@ if ((self)->closed || ((self)->conn && (self)->conn->closed)) { \
 
 #define EXC_IF_NO_TUPLES(self) \
 if ((self)->notuples && (self)->name == NULL) {               \
+    if ((self)->async_canceled) {                             \
+        PyErr_SetString(QueryCanceledError,                   \
+            "the query was canceled before being sent");      \
+        return NULL; }                                        \
     PyErr_SetString(ProgrammingError, "no results to fetch"); \
     return NULL; }
 
@@ -107,8 +204,12 @@ if ((self)->mark != (self)->conn->mark) {                                  \
     "in asynchronous mode");                                         \
     return NULL; }
 
+/* while the connection is busy only the unnamed cursors not waiting for
+   their own result can be used: they don't need to talk to the backend */
 #define EXC_IF_ASYNC_IN_PROGRESS(self, cmd) \
-if ((self)->conn->async_cursor != NULL) {   \
+if ((self)->conn->async_cursor != NULL                                    \
+        && ((self)->name != NULL || (self)->async_queued                   \
+            || (self)->conn->async_cursor == (PyObject *)(self))) {        \
     PyErr_SetString(ProgrammingError, #cmd " cannot be used "        \
     "while an asynchronous query is underway");                      \
     return NULL; }
@@ -25,6 +25,7 @@
 
 #define PY_SSIZE_T_CLEAN
 #include <Python.h>
+#include <pythread.h>
 #include <string.h>
 
 #define PSYCOPG_MODULE
@@ -32,6 +33,7 @@
 #include "psycopg/psycopg.h"
 #include "psycopg/cursor.h"
 #include "psycopg/pqpath.h"
+#include "psycopg/typecast.h"
 
 /* curs_reset - reset the cursor to a clean state */
 
@@ -44,6 +46,7 @@ curs_reset(cursorObject *self)
     self->notuples = 1;
     self->rowcount = -1;
     self->row = 0;
+    self->rowoffset = 0;
 
     tmp = self->description;
     Py_INCREF(Py_None);
@@ -53,4 +56,354 @@ curs_reset(cursorObject *self)
     tmp = self->casts;
     self->casts = NULL;
     Py_XDECREF(tmp);
+    Py_CLEAR(self->casts_entry);
+
+    PyMem_Free(self->ccasts);
+    self->ccasts = NULL;
+
+    curs_intern_free(self);
+    curs_clear_results(self);
+
+    /* the lazy rows of a previous result keep it alive by themselves */
+    if (self->shared_result && self->pgres != self->shared_pgres) {
+        self->shared_pgres = NULL;
+        Py_CLEAR(self->shared_result);
+    }
+}
+
+/* curs_clear_results - drop the results kept for nextset() */
+
+void
+curs_clear_results(cursorObject *self)
+{
+    cursorResults *sets = &self->nextsets;
+    int i;
+
+    for (i = sets->next; i < sets->len; i++) {
+        PQclear(sets->results[i]);
+    }
+    free(sets->results);
+    memset(sets, 0, sizeof(cursorResults));
+}
+
+/* curs_lock - take the cursor lock, waiting without the GIL if needed
+
+   The function must be called holding the GIL: the owner and the depth
+   are only changed holding it. */
+
+void
+curs_lock(cursorObject *self)
+{
+    long me = PyThread_get_thread_ident();
+
+    if (self->lock_depth && self->lock_owner == me) {
+        self->lock_depth++;
+        return;
+    }
+
+    if (pthread_mutex_trylock(&(self->lock)) != 0) {
+        Dprintf("curs_lock: cursor %p busy, waiting", self);
+        Py_BEGIN_ALLOW_THREADS;
+        pthread_mutex_lock(&(self->lock));
+        Py_END_ALLOW_THREADS;
+    }
+    self->lock_owner = me;
+    self->lock_depth = 1;
+}
+
+void
+curs_unlock(cursorObject *self)
+{
+    if (--self->lock_depth == 0) {
+        self->lock_owner = 0;
+        pthread_mutex_unlock(&(self->lock));
+    }
+}
+
+/* curs_tzinfo - return a tzinfo object for a UTC offset in minutes
+
+   The objects returned by tzinfo_factory are cached by offset, so the
+   factory is called only once for all the values of a query with the same
+   time zone, and the same object is shared by those values. The cache is
+   dropped when a different tzinfo_factory is set on the cursor.
+*/
+
+PyObject *
+curs_tzinfo(cursorObject *self, int offset)
+{
+    PyObject *tzinfo;
+    int i;
+
+    if (self->tz_factory != self->tzinfo_factory) {
+        curs_clear_tzinfo(self);
+        Py_INCREF(self->tzinfo_factory);
+        self->tz_factory = self->tzinfo_factory;
+    }
+
+    for (i = 0; i < CURSOR_TZ_CACHE; i++) {
+        if (self->tz_cache[i] && self->tz_offset[i] == offset) {
+            Py_INCREF(self->tz_cache[i]);
+            return self->tz_cache[i];
+        }
+    }
+
+    if (!(tzinfo = PyObject_CallFunction(self->tzinfo_factory, "i", offset))) {
+        return NULL;
+    }
+
+    i = self->tz_next;
+    self->tz_next = (i + 1) % CURSOR_TZ_CACHE;
+    Py_XDECREF(self->tz_cache[i]);
+    Py_INCREF(tzinfo);
+    self->tz_cache[i] = tzinfo;
+    self->tz_offset[i] = offset;
+
+    return tzinfo;
+}
+
+/* curs_clear_tzinfo - drop the tzinfo objects cached */
+
+void
+curs_clear_tzinfo(cursorObject *self)
+{
+    int i;
+
+    for (i = 0; i < CURSOR_TZ_CACHE; i++) {
+        Py_CLEAR(self->tz_cache[i]);
+    }
+    Py_CLEAR(self->tz_factory);
+    self->tz_next = 0;
+}
+
+
+/* The interned columns
+
+   The values of a column with few distinct values are decoded only once per
+   result: a small hash table maps the bytes received to the object already
+   decoded for them. Only the columns cast to str or unicode are interned, as
+   the other objects returned by the typecasters may be mutable. The long
+   values and the ones exceeding the table capacity are decoded as usual.
+*/
+
+#define INTERN_MAXLEN  256      /* the longest value interned */
+#define INTERN_MAXUSED 1024     /* the most distinct values per column */
+#define INTERN_MINSIZE 16       /* the initial number of slots */
+
+struct cursorInternEntry {
+    unsigned long hash;
+    Py_ssize_t len;
+    char *bytes;            /* NULL if the slot is free */
+    PyObject *value;
+};
+
+struct cursorIntern {
+    typecast_function cast;
+    Py_ssize_t size;        /* number of slots, a power of 2 */
+    Py_ssize_t used;
+    struct cursorInternEntry *entries;
+};
+
+static unsigned long
+_curs_intern_hash(const char *str, Py_ssize_t len)
+{
+    /* FNV-1a */
+    unsigned long h = 2166136261UL;
+    const unsigned char *c = (const unsigned char *)str;
+
+    while (len--) {
+        h = (h ^ *c++) * 16777619UL;
+    }
+    return h;
+}
+
+static struct cursorInternEntry *
+_curs_intern_lookup(struct cursorIntern *table, unsigned long hash,
+                    const char *str, Py_ssize_t len)
+{
+    Py_ssize_t mask = table->size - 1, i = hash & mask;
+    struct cursorInternEntry *entry;
+
+    for (;;) {
+        entry = table->entries + i;
+        if (!entry->bytes) { return entry; }
+        if (entry->hash == hash && entry->len == len
+                && 0 == memcmp(entry->bytes, str, len)) {
+            return entry;
+        }
+        i = (i + 1) & mask;
+    }
+}
+
+/* double the table slots; return -1 on failure, without exception */
+static int
+_curs_intern_grow(struct cursorIntern *table)
+{
+    struct cursorInternEntry *old = table->entries, *entry;
+    Py_ssize_t i, size = table->size;
+
+    if (!(table->entries = PyMem_New(struct cursorInternEntry, size * 2))) {
+        table->entries = old;
+        return -1;
+    }
+    memset(table->entries, 0, size * 2 * sizeof(struct cursorInternEntry));
+    table->size = size * 2;
+
+    for (i = 0; i < size; i++) {
+        if (old[i].bytes) {
+            entry = _curs_intern_lookup(table, old[i].hash,
+                                        old[i].bytes, old[i].len);
+            *entry = old[i];
+        }
+    }
+    PyMem_Free(old);
+    return 0;
+}
+
+/* curs_intern_setup - prepare the tables of the interned columns
+
+   To be called when a new result is received, with the GIL. */
+
+void
+curs_intern_setup(cursorObject *self)
+{
+    PyObject *cols = NULL, *item;
+    Py_ssize_t i, j, n;
+    int selected = 0;
+    const char *name;
+    typecastObject *caster;
+
+    curs_intern_free(self);
+    if (self->intern_columns == Py_None || !self->casts || !self->pgres) {
+        return;
+    }
+
+    n = PyTuple_GET_SIZE(self->casts);
+    if (self->intern_columns != Py_True) {
+        if (!(cols = PySequence_Fast(self->intern_columns, ""))) {
+            goto error;
+        }
+    }
+    if (!(self->interns = PyMem_New(struct cursorIntern *, n > 0 ? n : 1))) {
+        goto error;
+    }
+    memset(self->interns, 0, (n > 0 ? n : 1) * sizeof(struct cursorIntern *));
+    self->ninterns = (int)n;
+
+    for (i = 0; i < n; i++) {
+        caster = (typecastObject *)PyTuple_GET_ITEM(self->casts, i);
+        if (!typecast_is_text((PyObject *)caster)) { continue; }
+
+        if (cols) {
+            name = PQfname(self->pgres, (int)i);
+            for (j = 0; j < PySequence_Fast_GET_SIZE(cols); j++) {
+                item = PySequence_Fast_GET_ITEM(cols, j);
+                if (PyInt_Check(item) && PyInt_AS_LONG(item) == i) { break; }
+                if (PyString_Check(item) && name
+                        && 0 == strcmp(PyString_AS_STRING(item), name)) {
+                    break;
+                }
+            }
+            if (j == PySequence_Fast_GET_SIZE(cols)) { continue; }
+        }
+
+        if (!(self->interns[i] = PyMem_New(struct cursorIntern, 1))) {
+            goto error;
+        }
+        self->interns[i]->cast = caster->ccast;
+        self->interns[i]->size = INTERN_MINSIZE;
+        self->interns[i]->used = 0;
+        if (!(self->interns[i]->entries = PyMem_New(
+                struct cursorInternEntry, INTERN_MINSIZE))) {
+            PyMem_Free(self->interns[i]);
+            self->interns[i] = NULL;
+            goto error;
+        }
+        memset(self->interns[i]->entries, 0,
+            INTERN_MINSIZE * sizeof(struct cursorInternEntry));
+        selected++;
+    }
+
+    Py_XDECREF(cols);
+    if (!selected) { curs_intern_free(self); }
+    Dprintf("curs_intern_setup: %d columns interned", selected);
+    return;
+
+error:
+    /* on failure the values are just not interned */
+    Dprintf("curs_intern_setup: interning disabled");
+    PyErr_Clear();
+    Py_XDECREF(cols);
+    curs_intern_free(self);
+}
+
+/* curs_intern_cast - return the value of an interned column
+
+   The column must have a table in self->interns. Return a new reference. */
+
+PyObject *
+curs_intern_cast(cursorObject *self, int col, const char *str, Py_ssize_t len)
+{
+    struct cursorIntern *table = self->interns[col];
+    struct cursorInternEntry *entry;
+    unsigned long hash;
+    PyObject *value;
+
+    if (str == NULL) {
+        Py_INCREF(Py_None);
+        return Py_None;
+    }
+    if (len > INTERN_MAXLEN) {
+        return table->cast(str, len, (PyObject *)self);
+    }
+
+    hash = _curs_intern_hash(str, len);
+    entry = _curs_intern_lookup(table, hash, str, len);
+    if (entry->bytes) {
+        Py_INCREF(entry->value);
+        return entry->value;
+    }
+
+    if (!(value = table->cast(str, len, (PyObject *)self))) { return NULL; }
+    if (table->used >= INTERN_MAXUSED) { return value; }
+
+    /* keep the load factor under 1/2 */
+    if ((table->used + 1) * 2 > table->size) {
+        if (0 > _curs_intern_grow(table)) { return value; }
+        entry = _curs_intern_lookup(table, hash, str, len);
+    }
+    if (!(entry->bytes = PyMem_Malloc(len > 0 ? len : 1))) { return value; }
+    memcpy(entry->bytes, str, len);
+    entry->hash = hash;
+    entry->len = len;
+    Py_INCREF(value);
+    entry->value = value;
+    table->used++;
+
+    return value;
+}
+
+/* curs_intern_free - drop the tables of the interned columns */
+
+void
+curs_intern_free(cursorObject *self)
+{
+    Py_ssize_t i, j;
+    struct cursorIntern *table;
+
+    if (!self->interns) { return; }
+
+    for (i = 0; i < self->ninterns; i++) {
+        if (!(table = self->interns[i])) { continue; }
+        for (j = 0; j < table->size; j++) {
+            if (table->entries[j].bytes) {
+                PyMem_Free(table->entries[j].bytes);
+                Py_DECREF(table->entries[j].value);
+            }
+        }
+        PyMem_Free(table->entries);
+        PyMem_Free(table);
+    }
+    PyMem_Free(self->interns);
+    self->interns = NULL;
+    self->ninterns = 0;
 }
@@ -39,6 +39,19 @@
 #include "psycopg/typecast.h"
 #include "psycopg/microprotocols.h"
 #include "psycopg/microprotocols_proto.h"
+#include "psycopg/adapter_qstring.h"
+#include "psycopg/adapter_binary.h"
+#include "psycopg/adapter_asis.h"
+#include "psycopg/adapter_pboolean.h"
+#include "psycopg/adapter_pfloat.h"
+#include "psycopg/adapter_list.h"
+#include "psycopg/pgtypes.h"
+#include "psycopg/copy_binary.h"
+#include "psycopg/copystream.h"
+#include "psycopg/column.h"
+#include "psycopg/lazyrow.h"
+#include "psycopg/dictrow.h"
+#include "psycopg/resultcache.h"
 #include "pgversion.h"
 #include <stdlib.h>
 
@@ -66,6 +79,10 @@ psyco_curs_close(cursorObject *self, PyObject *args)
         if (pq_execute(self, buffer, 0) == -1) return NULL;
     }
 
+    /* the backend may be still sending the rows of a streaming query */
+    if (pq_stream_discard(self) < 0) return NULL;
+    curs_clear_results(self);
+
     self->closed = 1;
     Dprintf("psyco_curs_close: cursor at %p closed", self);
 
@@ -369,371 +386,2105 @@ _psyco_curs_merge_query_args(cursorObject *self,
     return fquery;
 }
 
-#define psyco_curs_execute_doc \
-"execute(query, vars=None) -- Execute query with bound vars."
+/* a query parsed in its literal text and %s/%(name)s placeholders, reused
+   while the cursor executes the same query */
 
-static int
-_psyco_curs_execute(cursorObject *self,
-                    PyObject *operation, PyObject *vars, long int async)
-{
-    int res = 0;
-    PyObject *fquery, *cvt = NULL;
+#define QUERY_PLAIN     0   /* no placeholder: the query is used as it is */
+#define QUERY_TUPLE     1   /* %s placeholders, arguments in a sequence */
+#define QUERY_DICT      2   /* %(name)s placeholders, arguments in a mapping */
+#define QUERY_FORMAT    3   /* other formats: use _mogrify() */
 
-    operation = _psyco_curs_validate_sql_basic(self, operation);
+struct cursorQueryPart {
+    Py_ssize_t offset;      /* the literal text preceding the placeholder */
+    Py_ssize_t len;
+    Py_ssize_t arg;         /* the argument number or key number, -1 if none */
+};
 
-    /* Any failure from here forward should 'goto fail' rather than 'return 0'
-       directly. */
+struct cursorQuery {
+    PyObject *query;        /* the query parsed */
+    int kind;               /* QUERY_* */
+    Py_ssize_t nargs;       /* the placeholders or the distinct names */
+    PyObject *keys;         /* the distinct names of a QUERY_DICT */
+    Py_ssize_t nparts;
+    struct cursorQueryPart parts[1];
+};
 
-    if (operation == NULL) { goto fail; }
+static void
+_psyco_curs_query_free(struct cursorQuery *q)
+{
+    if (!q) return;
+    Py_XDECREF(q->query);
+    Py_XDECREF(q->keys);
+    PyMem_Free(q);
+}
 
-    IFCLEARPGRES(self->pgres);
+/* parse a query string. Return NULL and set an exception on error */
 
-    if (self->query) {
-        Py_DECREF(self->query);
-        self->query = NULL;
+static struct cursorQuery *
+_psyco_curs_query_parse(PyObject *query)
+{
+    struct cursorQuery *q;
+    struct cursorQueryPart *part;
+    PyObject *names = NULL, *key = NULL, *num;
+    const char *s, *end, *c, *d, *start;
+    Py_ssize_t size = 1;
+
+    s = PyString_AS_STRING(query);
+    end = s + PyString_GET_SIZE(query);
+    for (c = s; c < end; c++) {
+        if (*c == '%') size++;
     }
 
-    Dprintf("psyco_curs_execute: starting execution of new query");
-
-    /* here we are, and we have a sequence or a dictionary filled with
-       objects to be substituted (bound variables). we try to be smart and do
-       the right thing (i.e., what the user expects) */
-
-    if (vars && vars != Py_None)
-    {
-        if(_mogrify(vars, operation, self->conn, &cvt) == -1) { goto fail; }
+    if (!(q = PyMem_Malloc(sizeof(struct cursorQuery)
+            + (size - 1) * sizeof(struct cursorQueryPart)))) {
+        PyErr_NoMemory();
+        return NULL;
     }
-
-    if (vars && cvt) {
-        if (!(fquery = _psyco_curs_merge_query_args(self, operation, cvt))) {
-            goto fail;
+    Py_INCREF(query);
+    q->query = query;
+    q->kind = QUERY_PLAIN;
+    q->nargs = 0;
+    q->keys = NULL;
+    q->nparts = 0;
+
+    start = c = s;
+    while (c < end) {
+        if (*c != '%') {
+            c++;
+            continue;
         }
-
-        if (self->name != NULL) {
-            self->query = PyString_FromFormat(
-                "DECLARE %s CURSOR WITHOUT HOLD FOR %s",
-                self->name, PyString_AS_STRING(fquery));
-            Py_DECREF(fquery);
+        part = &q->parts[q->nparts++];
+        part->offset = start - s;
+
+        if (c[1] == '%') {
+            /* keep a single '%' in the literal */
+            part->len = c + 1 - start;
+            part->arg = -1;
+            c += 2;
         }
-        else {
-            self->query = fquery;
+        else if (c[1] == 's' && q->kind != QUERY_DICT) {
+            q->kind = QUERY_TUPLE;
+            part->len = c - start;
+            part->arg = q->nargs++;
+            c += 2;
         }
-    }
-    else {
-        if (self->name != NULL) {
-            self->query = PyString_FromFormat(
-                "DECLARE %s CURSOR WITHOUT HOLD FOR %s",
-                self->name, PyString_AS_STRING(operation));
+        else if (c[1] == '(' && q->kind != QUERY_TUPLE) {
+            for (d = c + 2; d < end && *d != ')'; d++);
+            if (d + 1 >= end || d[1] != 's') { goto format; }
+
+            q->kind = QUERY_DICT;
+            if (!names && !(names = PyDict_New())) { goto error; }
+            if (!q->keys && !(q->keys = PyList_New(0))) { goto error; }
+            if (!(key = PyString_FromStringAndSize(c + 2, d - c - 2))) {
+                goto error;
+            }
+
+            /* a name used more than once is quoted only once */
+            if ((num = PyDict_GetItem(names, key))) {
+                part->arg = PyInt_AS_LONG(num);
+            }
+            else {
+                if (!(num = PyInt_FromSsize_t(q->nargs))) { goto error; }
+                if (0 != PyDict_SetItem(names, key, num)) {
+                    Py_DECREF(num);
+                    goto error;
+                }
+                Py_DECREF(num);
+                if (0 != PyList_Append(q->keys, key)) { goto error; }
+                part->arg = q->nargs++;
+            }
+            Py_CLEAR(key);
+            part->len = c - start;
+            c = d + 2;
         }
         else {
-            /* Transfer reference ownership of the str in operation to
-               self->query, clearing the local variable to prevent cleanup from
-               DECREFing it */
-            self->query = operation;
-            operation = NULL;
+            goto format;
         }
+        start = c;
     }
 
-    /* At this point, the SQL statement must be str, not unicode */
-
-    res = pq_execute(self, PyString_AS_STRING(self->query), async);
-    Dprintf("psyco_curs_execute: res = %d, pgres = %p", res, self->pgres);
-    if (res == -1) { goto fail; }
-
-    res = 1; /* Success */
-    goto cleanup;
-
-    fail:
-        res = 0;
-        /* Fall through to cleanup */
-    cleanup:
-        /* Py_XDECREF(operation) is safe because the original reference passed
-           by the caller was overwritten with either NULL or a new
-           reference */
-        Py_XDECREF(operation);
-
-        Py_XDECREF(cvt);
-
-        return res;
+    /* the text after the last placeholder */
+    part = &q->parts[q->nparts++];
+    part->offset = start - s;
+    part->len = end - start;
+    part->arg = -1;
+
+    Py_XDECREF(names);
+    return q;
+
+format:
+    /* mixed or unknown formats: leave _mogrify() dealing with them */
+    q->kind = QUERY_FORMAT;
+    Py_XDECREF(names);
+    return q;
+
+error:
+    Py_XDECREF(names);
+    Py_XDECREF(key);
+    _psyco_curs_query_free(q);
+    return NULL;
 }
 
-static PyObject *
-psyco_curs_execute(cursorObject *self, PyObject *args, PyObject *kwargs)
-{
-    PyObject *vars = NULL, *operation = NULL;
-
-    static char *kwlist[] = {"query", "vars", NULL};
+/* return the parsed query, reusing the last one parsed by the cursor if it
+   is the same query. Return NULL and set an exception on error */
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|O", kwlist,
-                                     &operation, &vars)) {
-        return NULL;
-    }
+static struct cursorQuery *
+_psyco_curs_query_get(cursorObject *self, PyObject *query)
+{
+    struct cursorQuery *q = self->query_layout;
 
-    if (self->name != NULL) {
-        if (self->query != Py_None) {
-            psyco_set_error(ProgrammingError, (PyObject*)self,
-                "can't call .execute() on named cursors more than once",
-                NULL, NULL);
-            return NULL;
-        }
-        if (self->conn->isolation_level == ISOLATION_LEVEL_AUTOCOMMIT) {
-            psyco_set_error(ProgrammingError, (PyObject*)self,
-                "can't use a named cursor outside of transactions", NULL, NULL);
-            return NULL;
-        }
-        if (self->conn->mark != self->mark) {
-            psyco_set_error(ProgrammingError, (PyObject*)self,
-                "named cursor isn't valid anymore", NULL, NULL);
-            return NULL;
-        }
+    if (q && (q->query == query
+            || (PyString_GET_SIZE(q->query) == PyString_GET_SIZE(query)
+                && !memcmp(PyString_AS_STRING(q->query),
+                    PyString_AS_STRING(query), PyString_GET_SIZE(query))))) {
+        return q;
     }
 
-    EXC_IF_CURS_CLOSED(self);
-    EXC_IF_ASYNC_IN_PROGRESS(self, execute);
-    EXC_IF_TPC_PREPARED(self->conn, execute);
-
-    if (_psyco_curs_execute(self, operation, vars, self->conn->async)) {
-        Py_INCREF(Py_None);
-        return Py_None;
-    }
-    else {
-        return NULL;
-    }
+    if (!(q = _psyco_curs_query_parse(query))) { return NULL; }
+    _psyco_curs_query_free(self->query_layout);
+    self->query_layout = q;
+    return q;
 }
 
-#define psyco_curs_executemany_doc \
-"executemany(query, vars_list) -- Execute many queries with bound vars."
+/* merge the quoted arguments into the query, writing them in a single
+   buffer. Return a new reference, NULL and set an exception on error */
 
 static PyObject *
-psyco_curs_executemany(cursorObject *self, PyObject *args, PyObject *kwargs)
+_psyco_curs_query_build(cursorObject *self, struct cursorQuery *q,
+                        PyObject *vars)
 {
-    PyObject *operation = NULL, *vars = NULL;
-    PyObject *v, *iter = NULL;
-    int rowcount = 0;
-
-    static char *kwlist[] = {"query", "vars_list", NULL};
-
-    /* reset rowcount to -1 to avoid setting it when an exception is raised */
-    self->rowcount = -1;
-
-    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO", kwlist,
-                                     &operation, &vars)) {
-        return NULL;
-    }
-
-    EXC_IF_CURS_CLOSED(self);
-    EXC_IF_CURS_ASYNC(self, executemany);
-    EXC_IF_TPC_PREPARED(self->conn, executemany);
+    PyObject **quoted, *value, *t, *res = NULL;
+    Py_ssize_t i, n, size = 0;
+    char *p;
+    const char *s;
 
-    if (self->name != NULL) {
-        psyco_set_error(ProgrammingError, (PyObject*)self,
-                "can't call .executemany() on named cursors", NULL, NULL);
+    if (!(quoted = PyMem_New(PyObject *, q->nargs > 0 ? q->nargs : 1))) {
+        PyErr_NoMemory();
         return NULL;
     }
+    memset(quoted, 0, (q->nargs > 0 ? q->nargs : 1) * sizeof(PyObject *));
 
-    if (!PyIter_Check(vars)) {
-        vars = iter = PyObject_GetIter(vars);
-        if (iter == NULL) return NULL;
+    if (q->kind == QUERY_TUPLE) {
+        if ((n = PySequence_Size(vars)) < 0) { goto exit; }
+        if (n > q->nargs) {
+            psyco_set_error(ProgrammingError, (PyObject*)self,
+                "not all arguments converted", NULL, NULL);
+            goto exit;
+        }
     }
 
-    while ((v = PyIter_Next(vars)) != NULL) {
-        if (_psyco_curs_execute(self, operation, v, 0) == 0) {
-            Py_DECREF(v);
-            Py_XDECREF(iter);
-            return NULL;
+    for (i = 0; i < q->nargs; i++) {
+        if (q->kind == QUERY_TUPLE) {
+            value = PySequence_GetItem(vars, i);
         }
         else {
-            if (self->rowcount == -1)
-                rowcount = -1;
-            else if (rowcount >= 0)
-                rowcount += self->rowcount;
-            Py_DECREF(v);
+            value = PyObject_GetItem(vars, PyList_GET_ITEM(q->keys, i));
         }
+        if (!value) { goto exit; }
+
+        t = microprotocol_getquoted(value, self->conn);
+        Py_DECREF(value);
+        if (!t) { goto exit; }
+
+        /* as the %s format would do */
+        if (!PyString_Check(t)) {
+            value = t;
+            t = PyObject_Str(value);
+            Py_DECREF(value);
+            if (!t) { goto exit; }
+        }
+        quoted[i] = t;
     }
-    Py_XDECREF(iter);
-    self->rowcount = rowcount;
 
-    if (!PyErr_Occurred()) {
-        Py_INCREF(Py_None);
-        return Py_None;
+    for (i = 0; i < q->nparts; i++) {
+        size += q->parts[i].len;
+        if (q->parts[i].arg >= 0) {
+            size += PyString_GET_SIZE(quoted[q->parts[i].arg]);
+        }
     }
-    else {
-        return NULL;
+
+    if (!(res = PyString_FromStringAndSize(NULL, size))) { goto exit; }
+    p = PyString_AS_STRING(res);
+    s = PyString_AS_STRING(q->query);
+    for (i = 0; i < q->nparts; i++) {
+        struct cursorQueryPart *part = &q->parts[i];
+        memcpy(p, s + part->offset, part->len);
+        p += part->len;
+        if (part->arg >= 0) {
+            t = quoted[part->arg];
+            memcpy(p, PyString_AS_STRING(t), PyString_GET_SIZE(t));
+            p += PyString_GET_SIZE(t);
+        }
+    }
+
+exit:
+    for (i = 0; i < q->nargs; i++) {
+        Py_XDECREF(quoted[i]);
     }
+    PyMem_Free(quoted);
+    return res;
 }
 
+/* mogrify a query with its arguments (vars must not be None).
 
-#ifdef PSYCOPG_EXTENSIONS
-#define psyco_curs_mogrify_doc \
-"mogrify(query, vars=None) -> str -- Return query after vars binding."
+   Return a new reference to the query to execute, NULL and set an
+   exception on error. */
 
 static PyObject *
-_psyco_curs_mogrify(cursorObject *self,
-                   PyObject *operation, PyObject *vars)
+_psyco_curs_query_format(cursorObject *self,
+                         PyObject *operation, PyObject *vars)
 {
-    PyObject *fquery = NULL, *cvt = NULL;
-
-    operation = _psyco_curs_validate_sql_basic(self, operation);
-    if (operation == NULL) { goto cleanup; }
+    struct cursorQuery *q;
+    PyObject *cvt = NULL, *fquery = NULL;
 
-    Dprintf("psyco_curs_mogrify: starting mogrify");
+    if (!(q = _psyco_curs_query_get(self, operation))) { return NULL; }
 
-    /* here we are, and we have a sequence or a dictionary filled with
-       objects to be substituted (bound variables). we try to be smart and do
-       the right thing (i.e., what the user expects) */
+    switch (q->kind) {
+    case QUERY_PLAIN:
+        if (q->nparts > 1) {
+            /* only some %% to unescape */
+            return _psyco_curs_query_build(self, q, vars);
+        }
+        Py_INCREF(operation);
+        return operation;
 
-    if (vars && vars != Py_None)
-    {
+    case QUERY_FORMAT:
         if (_mogrify(vars, operation, self->conn, &cvt) == -1) {
-            goto cleanup;
+            return NULL;
         }
-    }
-
-    if (vars && cvt) {
-        if (!(fquery = _psyco_curs_merge_query_args(self, operation, cvt))) {
-            goto cleanup;
+        if (!cvt) {
+            Py_INCREF(operation);
+            return operation;
         }
+        fquery = _psyco_curs_merge_query_args(self, operation, cvt);
+        Py_DECREF(cvt);
+        return fquery;
 
-        Dprintf("psyco_curs_mogrify: cvt->refcnt = " FORMAT_CODE_PY_SSIZE_T
-            ", fquery->refcnt = " FORMAT_CODE_PY_SSIZE_T,
-            cvt->ob_refcnt, fquery->ob_refcnt);
-    }
-    else {
-        fquery = operation;
-        Py_INCREF(fquery);
+    default:
+        return _psyco_curs_query_build(self, q, vars);
     }
-
-cleanup:
-    Py_XDECREF(operation);
-    Py_XDECREF(cvt);
-
-    return fquery;
 }
 
-static PyObject *
-psyco_curs_mogrify(cursorObject *self, PyObject *args, PyObject *kwargs)
-{
-    PyObject *vars = NULL, *operation = NULL;
-
-    static char *kwlist[] = {"query", "vars", NULL};
-
-    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|O", kwlist,
-                                     &operation, &vars)) {
-        return NULL;
-    }
+/* server-side parameters binding */
 
-    EXC_IF_CURS_CLOSED(self);
+/* Release the arrays allocated by _psyco_curs_params_alloc() */
 
-    return _psyco_curs_mogrify(self, operation, vars);
+static void
+_psyco_curs_params_free(pqParams *params)
+{
+    PyMem_Free(params->types);
+    PyMem_Free(params->values);
+    PyMem_Free(params->lengths);
+    PyMem_Free(params->formats);
+    memset(params, 0, sizeof(pqParams));
 }
-#endif
-
 
-/* fetchone method - fetch one row of results */
-
-#define psyco_curs_fetchone_doc \
-"fetchone() -> tuple or None\n\n" \
-"Return the next row of a query result set in the form of a tuple (by\n" \
-"default) or using the sequence factory previously set in the\n" \
-"`row_factory` attribute. Return `None` when no more data is available.\n"
+/* Allocate room for at most size parameters */
 
 static int
-_psyco_curs_prefetch(cursorObject *self)
+_psyco_curs_params_alloc(pqParams *params, Py_ssize_t size)
 {
-    int i = 0;
-
-    if (self->pgres == NULL) {
-        Dprintf("_psyco_curs_prefetch: trying to fetch data");
-        do {
-            i = pq_fetch(self);
-            Dprintf("_psycopg_curs_prefetch: result = %d", i);
-        } while(i == 1);
+    params->nparams = 0;
+    params->types = PyMem_Malloc((size + 1) * sizeof(Oid));
+    params->values = PyMem_Malloc((size + 1) * sizeof(char *));
+    params->lengths = PyMem_Malloc((size + 1) * sizeof(int));
+    params->formats = PyMem_Malloc((size + 1) * sizeof(int));
+
+    if (!(params->types && params->values
+            && params->lengths && params->formats)) {
+        _psyco_curs_params_free(params);
+        PyErr_NoMemory();
+        return -1;
     }
 
-    Dprintf("_psyco_curs_prefetch: result = %d", i);
-    return i;
+    return 0;
 }
 
+/* Encode a list of integers as an int4[] or int8[] in binary format.
+ *
+ * Return a new string, NULL with no exception set if the list can't be
+ * encoded, NULL and set an exception on error.
+ */
 static PyObject *
-_psyco_curs_buildrow_fill(cursorObject *self, PyObject *res,
-                          int row, int n, int istuple)
+_psyco_curs_params_int_array(PyObject *list, Oid *type)
 {
-    int i, len, err;
-    const char *str;
-    PyObject *val;
-
-    for (i=0; i < n; i++) {
-        if (PQgetisnull(self->pgres, row, i)) {
-            str = NULL;
-            len = 0;
+    PyObject *str, *item;
+    Py_ssize_t i, n = PyList_GET_SIZE(list), nnulls = 0;
+    PY_LONG_LONG v;
+    int size = 4;
+    unsigned char *c;
+
+    for (i = 0; i < n; i++) {
+        item = PyList_GET_ITEM(list, i);
+        if (item == Py_None) {
+            nnulls++;
         }
-        else {
-            str = PQgetvalue(self->pgres, row, i);
-            len = PQgetlength(self->pgres, row, i);
+        else if (PyInt_CheckExact(item)) {
+            v = PyInt_AS_LONG(item);
+            if (v < -2147483647 - 1 || v > 2147483647) size = 8;
         }
-
-        Dprintf("_psyco_curs_buildrow: row %ld, element %d, len %d",
-                self->row, i, len);
-
-        val = typecast_cast(PyTuple_GET_ITEM(self->casts, i), str, len,
-                            (PyObject*)self);
-
-        if (val) {
-            Dprintf("_psyco_curs_buildrow: val->refcnt = "
-                FORMAT_CODE_PY_SSIZE_T,
-                val->ob_refcnt
-              );
-            if (istuple) {
-                PyTuple_SET_ITEM(res, i, val);
-            }
-            else {
-                err = PySequence_SetItem(res, i, val);
-                Py_DECREF(val);
-                if (err == -1) {
-                    Py_DECREF(res);
-                    res = NULL;
-                    break;
+        else if (PyLong_CheckExact(item)) {
+            v = PyLong_AsLongLong(item);
+            if (v == -1 && PyErr_Occurred()) {
+                /* too big: a numeric[] would do, quote it inline */
+                if (PyErr_ExceptionMatches(PyExc_OverflowError)) {
+                    PyErr_Clear();
                 }
+                return NULL;
             }
+            if (v < -2147483647 - 1 || v > 2147483647) size = 8;
         }
         else {
-            /* an error occurred in the type system, we return NULL to raise
-               an exception. the typecast code should already have set the
-               exception type and text */
-            Py_DECREF(res);
-            res = NULL;
-            break;
+            return NULL;
         }
     }
-    return res;
-}
-
-static PyObject *
-_psyco_curs_buildrow(cursorObject *self, int row)
-{
-    int n;
+    if (nnulls == n || n > INT_MAX / 12) return NULL;
+
+    /* header, one dimension, the items with their length */
+    if (!(str = PyString_FromStringAndSize(NULL,
+            20 + (n - nnulls) * (4 + size) + nnulls * 4))) {
+        return NULL;
+    }
+    c = (unsigned char *)PyString_AS_STRING(str);
+
+#define PUT32(x) do { unsigned long _x = (unsigned long)(x); \
+    *c++ = (_x >> 24) & 0xFF; *c++ = (_x >> 16) & 0xFF; \
+    *c++ = (_x >> 8) & 0xFF; *c++ = _x & 0xFF; } while (0)
+
+    *type = size == 4 ? INT4ARRAYOID : INT8ARRAYOID;
+    PUT32(1);
+    PUT32(nnulls ? 1 : 0);
+    PUT32(size == 4 ? INT4OID : INT8OID);
+    PUT32(n);
+    PUT32(1);
+
+    for (i = 0; i < n; i++) {
+        item = PyList_GET_ITEM(list, i);
+        if (item == Py_None) {
+            PUT32(-1);
+            continue;
+        }
+        v = PyInt_CheckExact(item) ?
+            PyInt_AS_LONG(item) : PyLong_AsLongLong(item);
+        PUT32(size);
+        if (size == 8) {
+            PUT32((unsigned PY_LONG_LONG)v >> 32);
+        }
+        PUT32(v & 0xFFFFFFFF);
+    }
+#undef PUT32
+
+    return str;
+}
+
+/* Encode a list of strings as a text[] literal.
+ *
+ * Return a new string, NULL with no exception set if the list can't be
+ * encoded, NULL and set an exception on error.
+ */
+static PyObject *
+_psyco_curs_params_text_array(cursorObject *self, PyObject *list)
+{
+    PyObject *items = NULL, *item, *str = NULL, *enc = NULL;
+    Py_ssize_t i, j, n = PyList_GET_SIZE(list), size = 2, nitems = 0;
+    const char *s;
+    char *c;
+
+    if (!(items = PyTuple_New(n))) { return NULL; }
+
+    /* encode the items and compute the size of the literal */
+    for (i = 0; i < n; i++) {
+        item = PyList_GET_ITEM(list, i);
+        if (item == Py_None) {
+            size += 5;
+            Py_INCREF(Py_None);
+        }
+        else if (PyString_CheckExact(item)) {
+            Py_INCREF(item);
+        }
+        else if (PyUnicode_CheckExact(item)) {
+            if (!enc && !(enc = PyDict_GetItemString(psycoEncodings,
+                                                     self->conn->encoding))) {
+                goto exit;
+            }
+            if (!(item = PyUnicode_AsEncodedString(item,
+                    PyString_AS_STRING(enc), NULL))) {
+                goto exit;
+            }
+        }
+        else {
+            goto exit;
+        }
+        PyTuple_SET_ITEM(items, i, item);
+
+        if (item != Py_None) {
+            /* the backend would stop at a NUL: leave it to the literal */
+            if (memchr(PyString_AS_STRING(item), '\0',
+                       PyString_GET_SIZE(item))) {
+                goto exit;
+            }
+            size += PyString_GET_SIZE(item) + 3;
+            for (s = PyString_AS_STRING(item); *s; s++) {
+                if (*s == '"' || *s == '\\') size++;
+            }
+            nitems++;
+        }
+    }
+    if (nitems == 0) { goto exit; }
+
+    if (!(str = PyString_FromStringAndSize(NULL, size))) { goto exit; }
+    c = PyString_AS_STRING(str);
+    *c++ = '{';
+    for (i = 0; i < n; i++) {
+        item = PyTuple_GET_ITEM(items, i);
+        if (i > 0) { *c++ = ','; }
+        if (item == Py_None) {
+            memcpy(c, "NULL", 4);
+            c += 4;
+            continue;
+        }
+        *c++ = '"';
+        s = PyString_AS_STRING(item);
+        for (j = 0; j < PyString_GET_SIZE(item); j++) {
+            if (s[j] == '"' || s[j] == '\\') { *c++ = '\\'; }
+            *c++ = s[j];
+        }
+        *c++ = '"';
+    }
+    *c++ = '}';
+    _PyString_Resize(&str, c - PyString_AS_STRING(str));
+
+exit:
+    Py_XDECREF(items);
+    return str;
+}
+
+/* Add value to the out-of-line parameters.
+ *
+ * Only values whose default adapter would render them as a plain literal
+ * (strings, numbers, booleans and binary data) are passed as parameters:
+ * they are sent with the same type PostgreSQL would give to the literal.
+ * The objects owning the parameters buffers are appended to refs.
+ *
+ * Return 1 if the value was added, 0 if it must be quoted inline by the
+ * adapters, -1 and set an exception on error.
+ */
+static int
+_psyco_curs_params_add(cursorObject *self, PyObject *value,
+                       pqParams *params, PyObject *refs)
+{
+    PyObject *key, *adapter, *str = NULL;
+    const char *buf = NULL;
+    Py_ssize_t len = 0;
+    Oid type = 0;
+    int format = 0;
+    int rv = -1;
+
+    /* a custom adapter may render the value in any way: only bypass the
+     * default ones */
+    key = PyTuple_Pack(2, (PyObject*)Py_TYPE(value),
+                          (PyObject*)&isqlquoteType);
+    if (!key) { return -1; }
+    adapter = PyDict_GetItem(psyco_adapters, key);
+    Py_DECREF(key);
+
+    if (adapter == NULL && Py_TYPE(value) == &binaryType) {
+        /* a Binary() wrapper: send the wrapped object */
+        value = ((binaryObject *)value)->wrapped;
+        adapter = (PyObject*)&binaryType;
+    }
+
+    if (adapter == (PyObject*)&qstringType) {
+        if (PyString_Check(value)) {
+            Py_INCREF(value);
+            str = value;
+        }
+        else if (PyUnicode_Check(value)) {
+            PyObject *enc = PyDict_GetItemString(psycoEncodings,
+                                                 self->conn->encoding);
+            if (!enc) {
+                PyErr_Format(InterfaceError,
+                    "can't encode unicode string to %s",
+                    self->conn->encoding);
+                goto exit;
+            }
+            str = PyUnicode_AsEncodedString(value,
+                                            PyString_AS_STRING(enc), NULL);
+            if (!str) { goto exit; }
+        }
+    }
+    else if (adapter == (PyObject*)&asisType) {
+        if (PyInt_Check(value) || PyLong_Check(value)) {
+            PY_LONG_LONG n = PyLong_AsLongLong(value);
+            if (n == -1 && PyErr_Occurred()) {
+                if (!PyErr_ExceptionMatches(PyExc_OverflowError)) {
+                    goto exit;
+                }
+                PyErr_Clear();
+                type = NUMERICOID;
+            }
+            else if (n >= -2147483647 - 1 && n <= 2147483647) {
+                type = INT4OID;
+            }
+            else {
+                type = INT8OID;
+            }
+            str = PyObject_Str(value);
+            if (!str) { goto exit; }
+        }
+    }
+    else if (adapter == (PyObject*)&pfloatType) {
+        double n = PyFloat_AsDouble(value);
+        if (n == -1.0 && PyErr_Occurred()) { goto exit; }
+        if (isnan(n)) {
+            str = PyString_FromString("NaN");
+            type = FLOAT8OID;
+        }
+        else if (isinf(n)) {
+            str = PyString_FromString(n > 0 ? "Infinity" : "-Infinity");
+            type = FLOAT8OID;
+        }
+        else {
+            str = PyObject_Repr(value);
+            type = NUMERICOID;
+        }
+        if (!str) { goto exit; }
+    }
+    else if (adapter == (PyObject*)&pbooleanType) {
+        if (PyBool_Check(value)) {
+            str = PyString_FromString(value == Py_True ? "t" : "f");
+            if (!str) { goto exit; }
+            type = BOOLOID;
+        }
+    }
+    else if (adapter == (PyObject*)&listType && PyList_CheckExact(value)) {
+        /* the lists of integers and strings are sent as arrays */
+        int fast = microprotocols_fast();
+        if ((fast & ADAPTERS_FAST_INT)
+                && (str = _psyco_curs_params_int_array(value, &type))) {
+            format = 1;
+        }
+        else if (PyErr_Occurred()) {
+            goto exit;
+        }
+        else if ((fast & ADAPTERS_FAST_STRING)
+                && (str = _psyco_curs_params_text_array(self, value))) {
+            type = TEXTARRAYOID;
+        }
+        else if (PyErr_Occurred()) {
+            goto exit;
+        }
+    }
+    else if (adapter == (PyObject*)&binaryType) {
+        if (PyObject_AsReadBuffer(value, (const void **)&buf, &len) < 0) {
+            PyErr_Clear();
+        }
+        else {
+            Py_INCREF(value);
+            str = value;
+            type = BYTEAOID;
+            format = 1;
+        }
+    }
+
+    if (str == NULL) {
+        /* not something we can pass out of line */
+        rv = 0;
+        goto exit;
+    }
+
+    if (buf == NULL) {
+        buf = PyString_AS_STRING(str);
+        len = PyString_GET_SIZE(str);
+    }
+    if (len > INT_MAX) {
+        PyErr_SetString(PyExc_ValueError, "query parameter too large");
+        goto exit;
+    }
+    if (0 != PyList_Append(refs, str)) { goto exit; }
+
+    params->types[params->nparams] = type;
+    params->values[params->nparams] = buf;
+    params->lengths[params->nparams] = (int)len;
+    params->formats[params->nparams] = format;
+    params->nparams++;
+    rv = 1;
+
+exit:
+    Py_XDECREF(str);
+    return rv;
+}
+
+/* Return the query text to use in place of a placeholder */
+
+static PyObject *
+_psyco_curs_params_chunk(cursorObject *self, PyObject *value,
+                         pqParams *params, PyObject *refs)
+{
+    int rv;
+
+    /* None is always converted to NULL, keeping "IS %s" working */
+    if (value == Py_None) {
+        return PyString_FromString("NULL");
+    }
+
+    if ((rv = _psyco_curs_params_add(self, value, params, refs)) < 0) {
+        return NULL;
+    }
+    else if (rv == 1) {
+        return PyString_FromFormat("$%d", params->nparams);
+    }
+    else {
+        return microprotocol_getquoted(value, self->conn);
+    }
+}
+
+/* Build a query to be executed with out-of-line parameters.
+ *
+ * The %s and %(name)s placeholders in operation are replaced with $n and
+ * their values are added to params: values that can't be passed as
+ * parameters are quoted inline, as _mogrify() would do. The objects
+ * owning the parameters buffers are stored in a new list in *refs.
+ *
+ * Return a new reference to the query, NULL and set an exception on error.
+ */
+static PyObject *
+_psyco_curs_params_query(cursorObject *self, PyObject *operation,
+                         PyObject *vars, pqParams *params, PyObject **refs)
+{
+    PyObject *chunks = NULL, *names = NULL, *key = NULL, *value = NULL;
+    PyObject *item = NULL, *empty = NULL, *query = NULL;
+    const char *c, *d, *start;
+    Py_ssize_t size = 0, index = 0;
+    int kind = 0;
+
+    /* the number of '%' is an upper bound for the number of parameters */
+    for (c = PyString_AS_STRING(operation); *c; c++) {
+        if (*c == '%') size++;
+    }
+    if (0 != _psyco_curs_params_alloc(params, size)) { goto exit; }
+    if (!(*refs = PyList_New(0))) { goto exit; }
+    if (!(chunks = PyList_New(0))) { goto exit; }
+
+    start = c = PyString_AS_STRING(operation);
+    while (*c) {
+        if (*c != '%') {
+            c++;
+            continue;
+        }
+
+        /* copy the text preceding the placeholder */
+        if (c > start) {
+            if (!(item = PyString_FromStringAndSize(start, c - start))) {
+                goto exit;
+            }
+            if (0 != PyList_Append(chunks, item)) { goto exit; }
+            Py_CLEAR(item);
+        }
+
+        if (c[1] == '%') {
+            if (!(item = PyString_FromString("%"))) { goto exit; }
+            c += 2;
+        }
+        else if (c[1] == '(') {
+            if (kind == 2) { goto mixed; }
+            kind = 1;
+
+            for (d = c + 2; *d && *d != ')'; d++);
+            if (d[0] != ')' || d[1] != 's') { goto badformat; }
+
+            if (!names && !(names = PyDict_New())) { goto exit; }
+            if (!(key = PyString_FromStringAndSize(c + 2, d - c - 2))) {
+                goto exit;
+            }
+
+            /* a name used more than once is bound only once */
+            if ((item = PyDict_GetItem(names, key))) {
+                Py_INCREF(item);
+            }
+            else {
+                if (!(value = PyObject_GetItem(vars, key))) { goto exit; }
+                if (!(item = _psyco_curs_params_chunk(
+                        self, value, params, *refs))) {
+                    goto exit;
+                }
+                if (0 != PyDict_SetItem(names, key, item)) { goto exit; }
+                Py_CLEAR(value);
+            }
+            Py_CLEAR(key);
+            c = d + 2;
+        }
+        else if (c[1] == 's') {
+            if (kind == 1) { goto mixed; }
+            kind = 2;
+
+            if (!(value = PySequence_GetItem(vars, index++))) { goto exit; }
+            if (!(item = _psyco_curs_params_chunk(
+                    self, value, params, *refs))) {
+                goto exit;
+            }
+            Py_CLEAR(value);
+            c += 2;
+        }
+        else {
+            goto badformat;
+        }
+
+        if (0 != PyList_Append(chunks, item)) { goto exit; }
+        Py_CLEAR(item);
+        start = c;
+    }
+
+    if (kind == 2 && index < PySequence_Size(vars)) {
+        psyco_set_error(ProgrammingError, (PyObject*)self,
+            "not all arguments converted", NULL, NULL);
+        goto exit;
+    }
+
+    if (c > start) {
+        if (!(item = PyString_FromStringAndSize(start, c - start))) {
+            goto exit;
+        }
+        if (0 != PyList_Append(chunks, item)) { goto exit; }
+        Py_CLEAR(item);
+    }
+
+    if (!(empty = PyString_FromString(""))) { goto exit; }
+    query = _PyString_Join(empty, chunks);
+    goto exit;
+
+mixed:
+    psyco_set_error(ProgrammingError, (PyObject*)self,
+        "argument formats can't be mixed", NULL, NULL);
+    goto exit;
+
+badformat:
+    psyco_set_error(ProgrammingError, (PyObject*)self,
+        "only %s and %(name)s placeholders can be used "
+        "with server_params", NULL, NULL);
+
+exit:
+    Py_XDECREF(chunks);
+    Py_XDECREF(names);
+    Py_XDECREF(key);
+    Py_XDECREF(value);
+    Py_XDECREF(item);
+    Py_XDECREF(empty);
+
+    return query;
+}
+
+#define psyco_curs_execute_doc \
+"execute(query, vars=None) -- Execute query with bound vars."
+
+/* return the ResultCache to look the cursor query up, NULL if the query is
+   not cacheable: only the plain queries of client-side cursors returning
+   the whole result at once can be served from the cache. */
+
+static resultcacheObject *
+_psyco_curs_result_cache(cursorObject *self, pqParams *params, long int async)
+{
+    resultcacheObject *cache;
+
+    if (!self->cache_results || !self->conn->result_cache
+            || self->name != NULL || async || self->binary
+            || self->multiple_results
+            || params->nparams > 0
+            || self->streaming > 0 || self->result_limit > 0) {
+        return NULL;
+    }
+    cache = (resultcacheObject *)self->conn->result_cache;
+
+    /* read the notifications already received, maybe clearing the cache */
+    if (cache->channels && PyTuple_GET_SIZE(cache->channels) > 0
+            && 0 > pq_is_busy(self->conn)) {
+        PyErr_Clear();
+        return NULL;
+    }
+    return cache;
+}
+
+static int
+_psyco_curs_execute(cursorObject *self,
+                    PyObject *operation, PyObject *vars, long int async)
+{
+    int res = 0;
+    PyObject *fquery = NULL, *refs = NULL, *owner;
+    pqParams params = {0, NULL, NULL, NULL, NULL, NULL, 0, 0};
+    resultcacheObject *cache;
+
+    operation = _psyco_curs_validate_sql_basic(self, operation);
+
+    /* Any failure from here forward should 'goto fail' rather than 'return 0'
+       directly. */
+
+    if (operation == NULL) { goto fail; }
+
+    IFCLEARCURSPGRES(self);
+    self->async_canceled = 0;
+
+    if (self->query) {
+        Py_DECREF(self->query);
+        self->query = NULL;
+    }
+
+    Dprintf("psyco_curs_execute: starting execution of new query");
+
+    /* here we are, and we have a sequence or a dictionary filled with
+       objects to be substituted (bound variables). we try to be smart and do
+       the right thing (i.e., what the user expects) */
+
+    if (vars && vars != Py_None)
+    {
+        double t0 = CONN_STATS_START(self->conn);
+
+        if (self->server_params) {
+            if (!(fquery = _psyco_curs_params_query(
+                    self, operation, vars, &params, &refs))) {
+                goto fail;
+            }
+        }
+        else if (!(fquery = _psyco_curs_query_format(
+                self, operation, vars))) {
+            goto fail;
+        }
+        CONN_STATS_ADD_TIME(self->conn, adapt_time, t0);
+    }
+
+    if (fquery) {
+        if (self->name != NULL) {
+            self->query = PyString_FromFormat(
+                "DECLARE %s %sCURSOR WITHOUT HOLD FOR %s",
+                self->name, self->binary ? "BINARY " : "",
+                PyString_AS_STRING(fquery));
+            Py_DECREF(fquery);
+        }
+        else {
+            self->query = fquery;
+        }
+    }
+    else {
+        if (self->name != NULL) {
+            self->query = PyString_FromFormat(
+                "DECLARE %s %sCURSOR WITHOUT HOLD FOR %s",
+                self->name, self->binary ? "BINARY " : "",
+                PyString_AS_STRING(operation));
+        }
+        else {
+            /* Transfer reference ownership of the str in operation to
+               self->query, clearing the local variable to prevent cleanup from
+               DECREFing it */
+            self->query = operation;
+            operation = NULL;
+        }
+    }
+
+    /* At this point, the SQL statement must be str, not unicode */
+
+    /* DECLARE can't be prepared: only cache unnamed cursors queries */
+    params.prepare = (self->name == NULL);
+    /* named cursors are declared BINARY instead */
+    params.result_format = (self->binary && self->name == NULL);
+
+    cache = _psyco_curs_result_cache(self, &params, async);
+    if (cache && (owner = resultcache_get(cache, self->query))) {
+        Dprintf("psyco_curs_execute: result found in the cache");
+        if (-1 == pq_fetch_shared(self, owner)) { goto fail; }
+        res = 1;
+        goto cleanup;
+    }
+
+    res = pq_execute_params(self, PyString_AS_STRING(self->query),
+                            &params, async);
+    Dprintf("psyco_curs_execute: res = %d, pgres = %p", res, self->pgres);
+    if (res == -1) { goto fail; }
+    if (cache) { resultcache_store(cache, self); }
+
+    res = 1; /* Success */
+    goto cleanup;
+
+    fail:
+        res = 0;
+        /* Fall through to cleanup */
+    cleanup:
+        /* Py_XDECREF(operation) is safe because the original reference passed
+           by the caller was overwritten with either NULL or a new
+           reference */
+        Py_XDECREF(operation);
+
+        Py_XDECREF(refs);
+        _psyco_curs_params_free(&params);
+
+        return res;
+}
+
+static PyObject *
+psyco_curs_execute(cursorObject *self, PyObject *args, PyObject *kwargs)
+{
+    PyObject *vars = NULL, *operation = NULL;
+
+    static char *kwlist[] = {"query", "vars", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|O", kwlist,
+                                     &operation, &vars)) {
+        return NULL;
+    }
+
+    if (self->name != NULL) {
+        if (self->query != Py_None) {
+            psyco_set_error(ProgrammingError, (PyObject*)self,
+                "can't call .execute() on named cursors more than once",
+                NULL, NULL);
+            return NULL;
+        }
+        if (self->conn->isolation_level == ISOLATION_LEVEL_AUTOCOMMIT) {
+            psyco_set_error(ProgrammingError, (PyObject*)self,
+                "can't use a named cursor outside of transactions", NULL, NULL);
+            return NULL;
+        }
+        if (self->conn->mark != self->mark) {
+            psyco_set_error(ProgrammingError, (PyObject*)self,
+                "named cursor isn't valid anymore", NULL, NULL);
+            return NULL;
+        }
+    }
+
+    EXC_IF_CURS_CLOSED(self);
+    EXC_IF_ASYNC_IN_PROGRESS(self, execute);
+    EXC_IF_TPC_PREPARED(self->conn, execute);
+
+    if (_psyco_curs_execute(self, operation, vars, self->conn->async)) {
+        Py_INCREF(Py_None);
+        return Py_None;
+    }
+    else {
+        return NULL;
+    }
+}
+
+/* mogrify a query with its arguments: used by mogrify() and executemany() */
+
+static PyObject *
+_psyco_curs_mogrify(cursorObject *self,
+                   PyObject *operation, PyObject *vars)
+{
+    PyObject *fquery = NULL;
+
+    operation = _psyco_curs_validate_sql_basic(self, operation);
+    if (operation == NULL) { goto cleanup; }
+
+    Dprintf("psyco_curs_mogrify: starting mogrify");
+
+    /* here we are, and we have a sequence or a dictionary filled with
+       objects to be substituted (bound variables). we try to be smart and do
+       the right thing (i.e., what the user expects) */
+
+    if (vars && vars != Py_None) {
+        double t0 = CONN_STATS_START(self->conn);
+
+        fquery = _psyco_curs_query_format(self, operation, vars);
+        CONN_STATS_ADD_TIME(self->conn, adapt_time, t0);
+    }
+    else {
+        fquery = operation;
+        Py_INCREF(fquery);
+    }
+
+cleanup:
+    Py_XDECREF(operation);
+
+    return fquery;
+}
+
+#define psyco_curs_executemany_doc \
+"executemany(query, vars_list, page_size=1) -- Execute many queries with bound vars.\n\n" \
+"If `page_size` is greater than 1 the queries are sent to the backend in\n" \
+"groups of `page_size`, waiting for the results once per group."
+
+/* Execute operation with all the vars in iter, sending page_size queries
+ * at time: as a single multi-statement query or, using server_params, in
+ * pipeline mode.
+ *
+ * Return 1 on success, 0 and set an exception on error.
+ */
+static int
+_psyco_curs_executemany_paged(cursorObject *self, PyObject *operation,
+                              PyObject *iter, long int page_size)
+{
+    PyObject *queries = NULL, *refs = NULL, *sep = NULL;
+    PyObject *v = NULL, *q, *ref;
+    pqParams *params = NULL;
+    const char **qstrings = NULL;
+    long int rowcount = 0;
+    int n = 0, i, rv, done = 0, res = 0;
+
+    if (!(operation = _psyco_curs_validate_sql_basic(self, operation))) {
+        goto exit;
+    }
+    if (!(queries = PyList_New(0))) { goto exit; }
+
+    if (self->server_params) {
+        if (!(refs = PyList_New(0))) { goto exit; }
+        params = PyMem_Malloc(page_size * sizeof(pqParams));
+        qstrings = PyMem_Malloc(page_size * sizeof(char *));
+        if (!(params && qstrings)) {
+            PyErr_NoMemory();
+            goto exit;
+        }
+        memset(params, 0, page_size * sizeof(pqParams));
+    }
+
+    while (!done) {
+        if ((v = PyIter_Next(iter))) {
+            if (self->server_params) {
+                ref = NULL;
+                q = _psyco_curs_params_query(
+                    self, operation, v, &params[n], &ref);
+                if (ref) {
+                    rv = PyList_Append(refs, ref);
+                    Py_DECREF(ref);
+                    if (0 != rv) {
+                        Py_XDECREF(q);
+                        goto exit;
+                    }
+                }
+            }
+            else {
+                q = _psyco_curs_mogrify(self, operation, v);
+            }
+            if (!q) { goto exit; }
+            Py_CLEAR(v);
+
+            rv = PyList_Append(queries, q);
+            Py_DECREF(q);
+            if (0 != rv) { goto exit; }
+            n++;
+        }
+        else if (PyErr_Occurred()) {
+            goto exit;
+        }
+        else {
+            done = 1;
+        }
+
+        if (n < page_size && !(done && n > 0)) {
+            continue;
+        }
+
+        Py_CLEAR(self->query);
+        if (self->server_params) {
+            for (i = 0; i < n; i++) {
+                qstrings[i] = PyString_AS_STRING(PyList_GET_ITEM(queries, i));
+            }
+            self->query = PyList_GET_ITEM(queries, n - 1);
+            Py_INCREF(self->query);
+
+            rv = pq_execute_pipeline(self, qstrings, params, n);
+
+            for (i = 0; i < n; i++) {
+                _psyco_curs_params_free(&params[i]);
+            }
+            if (0 != PyList_SetSlice(refs, 0, PyList_GET_SIZE(refs), NULL)) {
+                goto exit;
+            }
+        }
+        else {
+            /* a newline ends a trailing -- comment in the operation */
+            if (!sep && !(sep = PyString_FromString(";\n"))) { goto exit; }
+            if (!(self->query = _PyString_Join(sep, queries))) { goto exit; }
+
+            rv = pq_execute_multi(self, PyString_AS_STRING(self->query));
+        }
+        if (rv == -1) { goto exit; }
+
+        if (self->rowcount == -1)
+            rowcount = -1;
+        else if (rowcount >= 0)
+            rowcount += self->rowcount;
+
+        if (0 != PyList_SetSlice(queries, 0, n, NULL)) { goto exit; }
+        n = 0;
+    }
+
+    if (self->nextsets.len == 0) {
+        self->rowcount = rowcount;
+    }
+    res = 1;
+
+exit:
+    if (params) {
+        for (i = 0; i < page_size; i++) {
+            _psyco_curs_params_free(&params[i]);
+        }
+        PyMem_Free(params);
+    }
+    PyMem_Free(qstrings);
+    Py_XDECREF(operation);
+    Py_XDECREF(queries);
+    Py_XDECREF(refs);
+    Py_XDECREF(sep);
+    Py_XDECREF(v);
+
+    return res;
+}
+
+static PyObject *
+psyco_curs_executemany(cursorObject *self, PyObject *args, PyObject *kwargs)
+{
+    PyObject *operation = NULL, *vars = NULL;
+    PyObject *v, *iter = NULL;
+    long int page_size = 1;
+    int rowcount = 0;
+
+    static char *kwlist[] = {"query", "vars_list", "page_size", NULL};
+
+    /* reset rowcount to -1 to avoid setting it when an exception is raised */
+    self->rowcount = -1;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|l", kwlist,
+                                     &operation, &vars, &page_size)) {
+        return NULL;
+    }
+
+    if (page_size < 1) {
+        PyErr_SetString(PyExc_ValueError, "page_size must be positive");
+        return NULL;
+    }
+
+    EXC_IF_CURS_CLOSED(self);
+    EXC_IF_CURS_ASYNC(self, executemany);
+    EXC_IF_TPC_PREPARED(self->conn, executemany);
+
+    if (self->name != NULL) {
+        psyco_set_error(ProgrammingError, (PyObject*)self,
+                "can't call .executemany() on named cursors", NULL, NULL);
+        return NULL;
+    }
+
+    if (!PyIter_Check(vars)) {
+        vars = iter = PyObject_GetIter(vars);
+        if (iter == NULL) return NULL;
+    }
+
+#ifndef HAVE_PQPIPELINE
+    /* without pipeline mode the queries can only be grouped if the
+       arguments are merged into them */
+    if (self->server_params) page_size = 1;
+#endif
+    /* the wait callback can't be used in pipeline mode */
+    if (self->server_params && psyco_green()) page_size = 1;
+
+    if (page_size > 1) {
+        int res = _psyco_curs_executemany_paged(self, operation, vars,
+                                                page_size);
+        Py_XDECREF(iter);
+        if (!res) return NULL;
+        Py_INCREF(Py_None);
+        return Py_None;
+    }
+
+    while ((v = PyIter_Next(vars)) != NULL) {
+        if (_psyco_curs_execute(self, operation, v, 0) == 0) {
+            Py_DECREF(v);
+            Py_XDECREF(iter);
+            return NULL;
+        }
+        else {
+            if (self->rowcount == -1)
+                rowcount = -1;
+            else if (rowcount >= 0)
+                rowcount += self->rowcount;
+            Py_DECREF(v);
+        }
+    }
+    Py_XDECREF(iter);
+    self->rowcount = rowcount;
+
+    if (!PyErr_Occurred()) {
+        Py_INCREF(Py_None);
+        return Py_None;
+    }
+    else {
+        return NULL;
+    }
+}
+
+
+#ifdef PSYCOPG_EXTENSIONS
+#define psyco_curs_execute_values_doc \
+"execute_values(query, argslist, page_size=100) -- Execute a query with\n" \
+"many rows of values.\n\n" \
+"`query` must contain a single ``%s`` placeholder, replaced by a\n" \
+"``VALUES`` list of up to `page_size` rows taken from `argslist`."
+
+/* append a chunk to a string buffer, growing it if needed */
+
+static int
+_psyco_curs_buf_append(PyObject **buf, Py_ssize_t *len,
+                       const char *data, Py_ssize_t size)
+{
+    Py_ssize_t alloc = PyString_GET_SIZE(*buf);
+
+    if (*len + size > alloc) {
+        while (*len + size > alloc) { alloc *= 2; }
+        if (0 != _PyString_Resize(buf, alloc)) { return -1; }
+    }
+    memcpy(PyString_AS_STRING(*buf) + *len, data, size);
+    *len += size;
+    return 0;
+}
+
+/* append a row of values, quoted and wrapped in parens, to the buffer
+ *
+ * types and adapters cache the adapter used for each column of the previous
+ * row: they are grown together as needed.
+ */
+static int
+_psyco_curs_values_row(cursorObject *self, PyObject *row,
+                       PyObject **buf, Py_ssize_t *len,
+                       PyTypeObject ***types, PyObject ***adapters,
+                       Py_ssize_t *ncols)
+{
+    PyObject *seq = NULL, *t;
+    Py_ssize_t i, size;
+    int rv = -1;
+
+    if (!(seq = PySequence_Fast(row, "argslist items must be sequences"))) {
+        goto exit;
+    }
+    size = PySequence_Fast_GET_SIZE(seq);
+
+    if (size > *ncols) {
+        PyTypeObject **nt;
+        PyObject **na;
+
+        if (!(nt = PyMem_Realloc(*types, size * sizeof(PyTypeObject *)))) {
+            PyErr_NoMemory();
+            goto exit;
+        }
+        *types = nt;
+        if (!(na = PyMem_Realloc(*adapters, size * sizeof(PyObject *)))) {
+            PyErr_NoMemory();
+            goto exit;
+        }
+        *adapters = na;
+        for (i = *ncols; i < size; i++) {
+            (*types)[i] = NULL;
+            (*adapters)[i] = NULL;
+        }
+        *ncols = size;
+    }
+
+    if (0 != _psyco_curs_buf_append(buf, len, "(", 1)) { goto exit; }
+    for (i = 0; i < size; i++) {
+        if (i > 0 && 0 != _psyco_curs_buf_append(buf, len, ",", 1)) {
+            goto exit;
+        }
+        t = microprotocol_getquoted_cached(
+            PySequence_Fast_GET_ITEM(seq, i), self->conn,
+            &(*types)[i], &(*adapters)[i]);
+        if (!t) { goto exit; }
+        if (!PyString_Check(t)) {
+            PyErr_SetString(PyExc_TypeError,
+                "getquoted() must return a string");
+            Py_DECREF(t);
+            goto exit;
+        }
+        if (0 != _psyco_curs_buf_append(buf, len,
+                PyString_AS_STRING(t), PyString_GET_SIZE(t))) {
+            Py_DECREF(t);
+            goto exit;
+        }
+        Py_DECREF(t);
+    }
+    if (0 != _psyco_curs_buf_append(buf, len, ")", 1)) { goto exit; }
+
+    rv = 0;
+
+exit:
+    Py_XDECREF(seq);
+    return rv;
+}
+
+static PyObject *
+psyco_curs_execute_values(cursorObject *self, PyObject *args, PyObject *kwargs)
+{
+    PyObject *operation = NULL, *argslist = NULL;
+    PyObject *iter = NULL, *v = NULL, *buf = NULL, *rv = NULL;
+    PyObject *prefix = NULL, *suffix = NULL;
+    PyTypeObject **types = NULL;
+    PyObject **adapters = NULL;
+    Py_ssize_t ncols = 0, len = 0, i;
+    long int page_size = 100, rowcount = 0;
+    int n = 0, done = 0, found = 0;
+    char *c, *d, *q;
+
+    static char *kwlist[] = {"query", "argslist", "page_size", NULL};
+
+    /* reset rowcount to -1 to avoid setting it when an exception is raised */
+    self->rowcount = -1;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|l", kwlist,
+                                     &operation, &argslist, &page_size)) {
+        return NULL;
+    }
+
+    if (page_size < 1) {
+        PyErr_SetString(PyExc_ValueError, "page_size must be positive");
+        return NULL;
+    }
+
+    EXC_IF_CURS_CLOSED(self);
+    EXC_IF_CURS_ASYNC(self, execute_values);
+    EXC_IF_TPC_PREPARED(self->conn, execute_values);
+
+    if (self->name != NULL) {
+        psyco_set_error(ProgrammingError, (PyObject*)self,
+                "can't call .execute_values() on named cursors", NULL, NULL);
+        return NULL;
+    }
+
+    if (!(operation = _psyco_curs_validate_sql_basic(self, operation))) {
+        return NULL;
+    }
+
+    /* split the query around its only placeholder, unescaping '%%' */
+    if (!(prefix = PyString_FromStringAndSize(
+            NULL, PyString_GET_SIZE(operation)))) {
+        goto exit;
+    }
+    q = d = PyString_AS_STRING(prefix);
+    for (c = PyString_AS_STRING(operation); *c; c++) {
+        if (c[0] != '%') {
+            *d++ = *c;
+        }
+        else if (c[1] == '%') {
+            *d++ = '%'; c++;
+        }
+        else if (c[1] == 's' && !found) {
+            if (0 != _PyString_Resize(&prefix, d - q)) { goto exit; }
+            found = 1; c++;
+            if (!(suffix = PyString_FromStringAndSize(
+                    NULL, strlen(c + 1)))) {
+                goto exit;
+            }
+            q = d = PyString_AS_STRING(suffix);
+        }
+        else {
+            psyco_set_error(ProgrammingError, (PyObject*)self,
+                "the query must contain a single %s placeholder", NULL, NULL);
+            goto exit;
+        }
+    }
+    if (!found) {
+        psyco_set_error(ProgrammingError, (PyObject*)self,
+            "the query must contain a single %s placeholder", NULL, NULL);
+        goto exit;
+    }
+    if (0 != _PyString_Resize(&suffix, d - q)) { goto exit; }
+
+    if (!(iter = PyObject_GetIter(argslist))) { goto exit; }
+
+    while (!done) {
+        if (!(v = PyIter_Next(iter))) {
+            if (PyErr_Occurred()) { goto exit; }
+            done = 1;
+            if (n == 0) { break; }
+        }
+        else {
+            if (n == 0) {
+                /* start a new page with room for a few rows */
+                Py_CLEAR(buf);
+                len = PyString_GET_SIZE(prefix);
+                if (!(buf = PyString_FromStringAndSize(NULL,
+                        len + PyString_GET_SIZE(suffix) + 256))) {
+                    goto exit;
+                }
+                memcpy(PyString_AS_STRING(buf),
+                    PyString_AS_STRING(prefix), len);
+            }
+            else if (0 != _psyco_curs_buf_append(&buf, &len, ",", 1)) {
+                goto exit;
+            }
+            if (0 != _psyco_curs_values_row(self, v, &buf, &len,
+                    &types, &adapters, &ncols)) {
+                goto exit;
+            }
+            Py_CLEAR(v);
+            if (++n < page_size) { continue; }
+        }
+
+        if (0 != _psyco_curs_buf_append(&buf, &len,
+                PyString_AS_STRING(suffix), PyString_GET_SIZE(suffix))) {
+            goto exit;
+        }
+        if (0 != _PyString_Resize(&buf, len)) { goto exit; }
+
+        IFCLEARCURSPGRES(self);
+        Py_CLEAR(self->query);
+        self->query = buf;
+        buf = NULL;
+
+        if (-1 == pq_execute(self, PyString_AS_STRING(self->query), 0)) {
+            goto exit;
+        }
+
+        if (self->rowcount == -1)
+            rowcount = -1;
+        else if (rowcount >= 0)
+            rowcount += self->rowcount;
+        n = 0;
+    }
+
+    self->rowcount = rowcount;
+    Py_INCREF(Py_None);
+    rv = Py_None;
+
+exit:
+    for (i = 0; i < ncols; i++) {
+        Py_XDECREF(adapters[i]);
+    }
+    PyMem_Free(adapters);
+    PyMem_Free(types);
+    Py_XDECREF(operation);
+    Py_XDECREF(prefix);
+    Py_XDECREF(suffix);
+    Py_XDECREF(iter);
+    Py_XDECREF(buf);
+    Py_XDECREF(v);
+
+    return rv;
+}
+#endif
+
+
+#ifdef PSYCOPG_EXTENSIONS
+#define psyco_curs_mogrify_doc \
+"mogrify(query, vars=None) -> str -- Return query after vars binding."
+
+static PyObject *
+psyco_curs_mogrify(cursorObject *self, PyObject *args, PyObject *kwargs)
+{
+    PyObject *vars = NULL, *operation = NULL;
+
+    static char *kwlist[] = {"query", "vars", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|O", kwlist,
+                                     &operation, &vars)) {
+        return NULL;
+    }
+
+    EXC_IF_CURS_CLOSED(self);
+
+    return _psyco_curs_mogrify(self, operation, vars);
+}
+#endif
+
+
+/* fetchone method - fetch one row of results */
+
+#define psyco_curs_fetchone_doc \
+"fetchone() -> tuple or None\n\n" \
+"Return the next row of a query result set in the form of a tuple (by\n" \
+"default) or using the sequence factory previously set in the\n" \
+"`row_factory` attribute. Return `None` when no more data is available.\n"
+
+static int
+_psyco_curs_prefetch(cursorObject *self)
+{
+    int i = 0;
+
+    if (self->pgres == NULL) {
+        Dprintf("_psyco_curs_prefetch: trying to fetch data");
+        do {
+            i = pq_fetch(self);
+            Dprintf("_psycopg_curs_prefetch: result = %d", i);
+        } while(i == 1);
+    }
+
+    Dprintf("_psyco_curs_prefetch: result = %d", i);
+    return i;
+}
+
+/* make the cursor result the owner of the values being cast
+
+   The binary typecasters may then return objects referring to the result
+   instead of copying the values. The previous owner is stored in old, to
+   be restored by the caller. Return -1 on error. */
+
+static int
+_psyco_curs_cast_owner(cursorObject *self, PyObject **old)
+{
+    *old = self->cast_owner;
+    if (*old == NULL && PQbinaryTuples(self->pgres)) {
+        if (!(self->cast_owner = lazyresult_share(self))) {
+            self->cast_owner = *old;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* return the value of a cell calling its typecaster object */
+
+static PyObject *
+_psyco_curs_buildrow_cast(cursorObject *self, int row, int i)
+{
+    int len;
+    const char *str;
+    PyObject *val;
+
+    if (PQgetisnull(self->pgres, row, i)) {
+        str = NULL;
+        len = 0;
+    }
+    else {
+        str = PQgetvalue(self->pgres, row, i);
+        len = PQgetlength(self->pgres, row, i);
+    }
+
+    Dprintf("_psyco_curs_buildrow: row %ld, element %d, len %d",
+            self->row, i, len);
+
+    /* on error the typecast code should already have set the exception
+       type and text */
+    if (self->interns && self->interns[i]) {
+        val = curs_intern_cast(self, i, str, len);
+    }
+    else {
+        val = typecast_cast(PyTuple_GET_ITEM(self->casts, i), str, len,
+                            (PyObject*)self);
+    }
+
+    if (val) {
+        Dprintf("_psyco_curs_buildrow: val->refcnt = "
+            FORMAT_CODE_PY_SSIZE_T,
+            val->ob_refcnt
+          );
+    }
+    return val;
+}
+
+/* fill the items of a sequence calling the C typecasters directly */
+
+static int
+_psyco_curs_buildrow_ccast(cursorObject *self, PyObject **items,
+                           int row, int n)
+{
+    int i, len, rv = 0;
+    const char *str;
+    PyObject *old = self->caster;
+
+    for (i = 0; i < n; i++) {
+        /* only an empty value can be a NULL */
+        len = PQgetlength(self->pgres, row, i);
+        if (len == 0 && PQgetisnull(self->pgres, row, i)) {
+            str = NULL;
+        }
+        else {
+            str = PQgetvalue(self->pgres, row, i);
+        }
+
+        if (self->interns && self->interns[i]) {
+            items[i] = curs_intern_cast(self, i, str, len);
+        }
+        else {
+            /* the array typecasters look for their base typecaster here */
+            self->caster = PyTuple_GET_ITEM(self->casts, i);
+            items[i] = self->ccasts[i](str, len, (PyObject*)self);
+        }
+        if (!items[i]) {
+            rv = -1;
+            break;
+        }
+    }
+
+    self->caster = old;
+    return rv;
+}
+
+/* the values of a batch of rows parsed with the GIL released */
+
+#define BATCH_CAST  0       /* to be passed to the typecaster */
+#define BATCH_NULL  1       /* a NULL */
+#define BATCH_VALUE 2       /* parsed in values */
+
+struct cursorBatch {
+    int first;              /* the first row of the batch in pgres */
+    int nrows;              /* the number of rows parsed */
+    int ncols;
+    const typecast_nogil **nogil;   /* the parsers of the columns */
+    typecast_value *values; /* nrows * ncols values */
+    char *status;           /* nrows * ncols BATCH_* */
+};
+
+/* prepare to parse the rows of the result in batches
+
+   Return 1 if the batch was set up, 0 if no column can be parsed without
+   the GIL, -1 on error. */
+
+static int
+_psyco_curs_batch_init(cursorObject *self, struct cursorBatch *batch,
+                       long int size)
+{
+    int i, parsed = 0;
+    long int nrows = self->nogil_batch;
+
+    memset(batch, 0, sizeof(struct cursorBatch));
+    if (nrows <= 0 || size <= 1 || self->casts == NULL) { return 0; }
+    if (self->tuple_factory != Py_None) {
+        /* the generic factory and the lazy rows call the typecasters */
+        if (lazyrow_CheckFactory(self->tuple_factory)
+                || dictrow_kind(self->tuple_factory) == ROW_KIND_CALL) {
+            return 0;
+        }
+    }
+    if (nrows > size) { nrows = size; }
+
+    batch->ncols = PQnfields(self->pgres);
+    if (!(batch->nogil = PyMem_New(const typecast_nogil *,
+            batch->ncols > 0 ? batch->ncols : 1))) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    for (i = 0; i < batch->ncols; i++) {
+        /* the binary format parsers are different typecasters anyway */
+        batch->nogil[i] = typecast_get_nogil(
+            PyTuple_GET_ITEM(self->casts, i));
+        if (batch->nogil[i]) { parsed++; }
+    }
+    if (!parsed) {
+        PyMem_Free(batch->nogil);
+        batch->nogil = NULL;
+        return 0;
+    }
+
+    batch->values = PyMem_New(typecast_value, nrows * batch->ncols);
+    batch->status = PyMem_Malloc(nrows * batch->ncols);
+    if (!batch->values || !batch->status) {
+        PyErr_NoMemory();
+        return -1;
+    }
+
+    Dprintf("_psyco_curs_batch_init: %d of %d columns parsed without GIL",
+        parsed, batch->ncols);
+    return 1;
+}
+
+static void
+_psyco_curs_batch_free(struct cursorBatch *batch)
+{
+    PyMem_Free(batch->nogil);
+    PyMem_Free(batch->values);
+    PyMem_Free(batch->status);
+}
+
+/* parse nrows rows from first without the GIL */
+
+static void
+_psyco_curs_batch_parse(cursorObject *self, struct cursorBatch *batch,
+                        int first, int nrows)
+{
+    PGresult *pgres = self->pgres;
+    int row, col, len, ncols = batch->ncols;
+    const typecast_nogil *nogil;
+    char *status;
+
+    batch->first = first;
+    batch->nrows = nrows;
+
+    Py_BEGIN_ALLOW_THREADS;
+    for (row = 0; row < nrows; row++) {
+        status = batch->status + row * ncols;
+        for (col = 0; col < ncols; col++) {
+            if (!(nogil = batch->nogil[col])) {
+                status[col] = BATCH_CAST;
+                continue;
+            }
+            len = PQgetlength(pgres, first + row, col);
+            if (len == 0 && PQgetisnull(pgres, first + row, col)) {
+                status[col] = BATCH_NULL;
+            }
+            else if (0 == nogil->parse(PQgetvalue(pgres, first + row, col),
+                    len, batch->values + row * ncols + col)) {
+                status[col] = BATCH_VALUE;
+            }
+            else {
+                status[col] = BATCH_CAST;
+            }
+        }
+    }
+    Py_END_ALLOW_THREADS;
+}
+
+/* fill the items of a row of the batch creating the objects parsed */
+
+static int
+_psyco_curs_buildrow_batch(cursorObject *self, PyObject **items,
+                           int row, int n)
+{
+    struct cursorBatch *batch = self->batch;
+    int i, rv = 0, len;
+    const char *str;
+    char *status = batch->status + (row - batch->first) * batch->ncols;
+    typecast_value *values =
+        batch->values + (row - batch->first) * batch->ncols;
+    PyObject *old = self->caster;
+
+    for (i = 0; i < n; i++) {
+        switch (status[i]) {
+        case BATCH_VALUE:
+            items[i] = batch->nogil[i]->build(values + i, (PyObject *)self);
+            break;
+
+        case BATCH_NULL:
+            Py_INCREF(Py_None);
+            items[i] = Py_None;
+            break;
+
+        default:
+            if (self->ccasts && !(self->interns && self->interns[i])) {
+                len = PQgetlength(self->pgres, row, i);
+                if (len == 0 && PQgetisnull(self->pgres, row, i)) {
+                    str = NULL;
+                }
+                else {
+                    str = PQgetvalue(self->pgres, row, i);
+                }
+                self->caster = PyTuple_GET_ITEM(self->casts, i);
+                items[i] = self->ccasts[i](str, len, (PyObject*)self);
+            }
+            else {
+                items[i] = _psyco_curs_buildrow_cast(self, row, i);
+            }
+        }
+
+        if (!items[i]) {
+            rv = -1;
+            break;
+        }
+    }
+
+    self->caster = old;
+    return rv;
+}
+
+/* fill the n items, initially NULL, of a tuple or a list */
+
+static int
+_psyco_curs_buildrow_items(cursorObject *self, PyObject **items,
+                           int row, int n)
+{
+    int i, rv = 0;
+    PyObject *owner;
+
+    if (0 > _psyco_curs_cast_owner(self, &owner)) { return -1; }
+
+    if (self->batch && row >= self->batch->first
+            && row < self->batch->first + self->batch->nrows) {
+        rv = _psyco_curs_buildrow_batch(self, items, row, n);
+    }
+    else if (self->ccasts) {
+        rv = _psyco_curs_buildrow_ccast(self, items, row, n);
+    }
+    else {
+        for (i = 0; i < n; i++) {
+            if (!(items[i] = _psyco_curs_buildrow_cast(self, row, i))) {
+                rv = -1;
+                break;
+            }
+        }
+    }
+
+    self->cast_owner = owner;
+    return rv;
+}
+
+/* fill a sequence returned by a generic row factory */
+
+static PyObject *
+_psyco_curs_buildrow_fill(cursorObject *self, PyObject *res, int row, int n)
+{
+    int i, err;
+    PyObject *val, *owner;
+
+    if (0 > _psyco_curs_cast_owner(self, &owner)) { goto error; }
+
+    for (i = 0; i < n; i++) {
+        if (!(val = _psyco_curs_buildrow_cast(self, row, i))) {
+            goto error;
+        }
+        err = PySequence_SetItem(res, i, val);
+        Py_DECREF(val);
+        if (err == -1) { goto error; }
+    }
+    self->cast_owner = owner;
+    return res;
+
+error:
+    self->cast_owner = owner;
+    Py_DECREF(res);
+    return NULL;
+}
+
+static PyObject *
+_psyco_curs_buildrow(cursorObject *self, int row)
+{
+    int n;
+    PyObject *res;
 
     n = PQnfields(self->pgres);
-    return _psyco_curs_buildrow_fill(self, PyTuple_New(n), row, n, 1);
+    if (!(res = PyTuple_New(n))) { return NULL; }
+
+    if (0 > _psyco_curs_buildrow_items(self,
+            ((PyTupleObject *)res)->ob_item, row - self->rowoffset, n)) {
+        Py_DECREF(res);
+        return NULL;
+    }
+    return res;
 }
 
 static PyObject *
 _psyco_curs_buildrow_with_factory(cursorObject *self, int row)
 {
     int n;
-    PyObject *res;
+    PyObject *res, *tmp;
+    PyObject **items;
 
+    row -= self->rowoffset;
     n = PQnfields(self->pgres);
-    if (!(res = PyObject_CallFunctionObjArgs(self->tuple_factory, self, NULL)))
+
+    /* the row types we know how to build without calling them */
+    if (lazyrow_CheckFactory(self->tuple_factory)) {
+        return lazyrow_new(self, row);
+    }
+
+    switch (dictrow_kind(self->tuple_factory)) {
+    case ROW_KIND_DICT:
+        if (!(res = dictrow_new(self, n))) { return NULL; }
+        items = ((PyListObject *)res)->ob_item;
+        break;
+
+    case ROW_KIND_RECORD:
+        if (!(res = ((PyTypeObject *)self->tuple_factory)->tp_alloc(
+                (PyTypeObject *)self->tuple_factory, n))) {
+            return NULL;
+        }
+        items = ((PyTupleObject *)res)->ob_item;
+        break;
+
+    case ROW_KIND_REALDICT:
+        if (!(tmp = _psyco_curs_buildrow(self, row + self->rowoffset))) {
+            return NULL;
+        }
+        res = realdictrow_new(self, tmp);
+        Py_DECREF(tmp);
+        return res;
+
+    case ROW_KIND_RECORD_NEW:
+        if (!(tmp = _psyco_curs_buildrow(self, row + self->rowoffset))) {
+            return NULL;
+        }
+        res = PyObject_Call(self->tuple_factory, tmp, NULL);
+        Py_DECREF(tmp);
+        return res;
+
+    default:
+        if (!(res = PyObject_CallFunctionObjArgs(
+                self->tuple_factory, self, NULL))) {
+            return NULL;
+        }
+        return _psyco_curs_buildrow_fill(self, res, row, n);
+    }
+
+    if (0 > _psyco_curs_buildrow_items(self, items, row, n)) {
+        Py_DECREF(res);
+        return NULL;
+    }
+    return res;
+}
+
+/* make sure the next row of a streaming query is in pgres, if any */
+
+static int
+_psyco_curs_stream_next(cursorObject *self)
+{
+    if (self->stream_pending && self->row >= self->rowcount) {
+        return pq_fetch_stream(self);
+    }
+    return 0;
+}
+
+/* fetch up to size rows (all if size < 0) from a streaming query */
+
+static PyObject *
+_psyco_curs_fetch_stream(cursorObject *self, long int size)
+{
+    PyObject *list, *res;
+    double t0 = CONN_STATS_START(self->conn);
+
+    if (!(list = PyList_New(0))) return NULL;
+
+    while (size < 0 || PyList_GET_SIZE(list) < size) {
+        if (_psyco_curs_stream_next(self) < 0) goto error;
+        if (self->row >= self->rowcount) break;
+
+        if (self->tuple_factory == Py_None)
+            res = _psyco_curs_buildrow(self, self->row);
+        else
+            res = _psyco_curs_buildrow_with_factory(self, self->row);
+
+        self->row++;
+
+        if (res == NULL) goto error;
+        if (PyList_Append(list, res) == -1) {
+            Py_DECREF(res);
+            goto error;
+        }
+        Py_DECREF(res);
+    }
+
+    CONN_STATS_ADD_TIME(self->conn, decode_time, t0);
+    CONN_STATS_ADD(self->conn, rows, PyList_GET_SIZE(list));
+    return list;
+
+error:
+    Py_DECREF(list);
+    return NULL;
+}
+
+/* number of rows received by a named cursor and not returned yet
+
+   iter(cursor) fetches itersize rows at time: the other fetch*() methods
+   must return the rows left in the buffer before asking for more. */
+
+static long int
+_psyco_curs_buffered(cursorObject *self)
+{
+    if (self->pgres == NULL
+        || PQresultStatus(self->pgres) != PGRES_TUPLES_OK) {
+        return 0;
+    }
+    return self->rowcount > self->row ? self->rowcount - self->row : 0;
+}
+
+/* return a list with the next size rows of the current result */
+
+static PyObject *
+_psyco_curs_buildrows(cursorObject *self, long int size)
+{
+    long int i, nrows = 0, parsed = 0;
+    PyObject *list, *res;
+    struct cursorBatch batch;
+    int batching;
+    double t0 = CONN_STATS_START(self->conn);
+
+    if (!(list = PyList_New(size))) { return NULL; }
+
+    /* with nogil_batch set, the values that don't need Python to be parsed
+       are decoded a batch of rows at time without holding the GIL */
+    if (0 > (batching = _psyco_curs_batch_init(self, &batch, size))) {
+        goto error;
+    }
+    if (batching) {
+        nrows = self->nogil_batch;
+        self->batch = &batch;
+    }
+
+    for (i = 0; i < size; i++) {
+        if (batching && i == parsed) {
+            _psyco_curs_batch_parse(self, &batch,
+                (int)(self->row - self->rowoffset),
+                (int)(size - i < nrows ? size - i : nrows));
+            parsed += batch.nrows;
+        }
+
+        if (self->tuple_factory == Py_None)
+            res = _psyco_curs_buildrow(self, self->row);
+        else
+            res = _psyco_curs_buildrow_with_factory(self, self->row);
+
+        self->row++;
+
+        if (res == NULL) { goto error; }
+
+        PyList_SET_ITEM(list, i, res);
+    }
+
+    CONN_STATS_ADD_TIME(self->conn, decode_time, t0);
+    CONN_STATS_ADD(self->conn, rows, size);
+    goto exit;
+
+error:
+    Py_CLEAR(list);
+exit:
+    self->batch = NULL;
+    _psyco_curs_batch_free(&batch);
+    return list;
+}
+
+/* return the rows buffered by a named cursor followed by the next ones
+
+   the rows fetched from the backend are enough to return size rows in
+   total or all the remaining ones if size < 0. */
+
+static PyObject *
+_psyco_curs_fetch_named(cursorObject *self, long int size)
+{
+    char buffer[128];
+    Py_ssize_t len;
+    PyObject *left, *right = NULL, *rv = NULL;
+
+    if (!(left = _psyco_curs_buildrows(self, _psyco_curs_buffered(self)))) {
         return NULL;
+    }
+    len = PyList_GET_SIZE(left);
+
+    if (size < 0) {
+        PyOS_snprintf(buffer, 127, "FETCH FORWARD ALL FROM %s", self->name);
+    }
+    else {
+        PyOS_snprintf(buffer, 127, "FETCH FORWARD %ld FROM %s",
+            size - (long int)len, self->name);
+    }
+    if (pq_execute(self, buffer, 0) == -1) goto exit;
+    if (_psyco_curs_prefetch(self) < 0) goto exit;
+
+    if (!(right = _psyco_curs_buildrows(self, self->rowcount - self->row))) {
+        goto exit;
+    }
+    if (0 > PyList_SetSlice(left, len, len, right)) goto exit;
+
+    rv = left;
+    left = NULL;
+
+exit:
+    Py_XDECREF(left);
+    Py_XDECREF(right);
+    return rv;
+}
+
+/* if the query was async aggresively free pgres after the last row, to
+   allow successive requests to reallocate it. The description is built
+   first, as it can't be read from pgres anymore. */
 
-    return _psyco_curs_buildrow_fill(self, res, row, n, 0);
+static int
+_psyco_curs_async_release(cursorObject *self)
+{
+    if (self->row < self->rowcount
+        || self->conn->async_cursor != (PyObject*)self) {
+        return 0;
+    }
+    if (0 > pq_fetch_description(self)) { return -1; }
+    IFCLEARCURSPGRES(self);
+    return 0;
 }
 
 static PyObject *
 psyco_curs_fetchone(cursorObject *self, PyObject *args)
 {
     PyObject *res;
+    double t0;
 
     EXC_IF_CURS_CLOSED(self);
     EXC_IF_ASYNC_IN_PROGRESS(self, fetchone);
@@ -745,11 +2496,15 @@ psyco_curs_fetchone(cursorObject *self, PyObject *args)
 
         EXC_IF_NO_MARK(self);
         EXC_IF_TPC_PREPARED(self->conn, fetchone);
-        PyOS_snprintf(buffer, 127, "FETCH FORWARD 1 FROM %s", self->name);
-        if (pq_execute(self, buffer, 0) == -1) return NULL;
-        if (_psyco_curs_prefetch(self) < 0) return NULL;
+        if (_psyco_curs_buffered(self) == 0) {
+            PyOS_snprintf(buffer, 127, "FETCH FORWARD 1 FROM %s", self->name);
+            if (pq_execute(self, buffer, 0) == -1) return NULL;
+            if (_psyco_curs_prefetch(self) < 0) return NULL;
+        }
     }
 
+    if (_psyco_curs_stream_next(self) < 0) return NULL;
+
     Dprintf("psyco_curs_fetchone: fetching row %ld", self->row);
     Dprintf("psyco_curs_fetchone: rowcount = %ld", self->rowcount);
 
@@ -759,18 +2514,19 @@ psyco_curs_fetchone(cursorObject *self, PyObject *args)
         return Py_None;
     }
 
+    t0 = CONN_STATS_START(self->conn);
     if (self->tuple_factory == Py_None)
         res = _psyco_curs_buildrow(self, self->row);
     else
         res = _psyco_curs_buildrow_with_factory(self, self->row);
+    CONN_STATS_ADD_TIME(self->conn, decode_time, t0);
+    CONN_STATS_ADD(self->conn, rows, 1);
 
     self->row++; /* move the counter to next line */
 
-    /* if the query was async aggresively free pgres, to allow
-       successive requests to reallocate it */
-    if (self->row >= self->rowcount
-        && self->conn->async_cursor == (PyObject*)self)
-        IFCLEARPGRES(self->pgres);
+    if (res && 0 > _psyco_curs_async_release(self)) {
+        Py_CLEAR(res);
+    }
 
     return res;
 }
@@ -787,8 +2543,7 @@ psyco_curs_fetchone(cursorObject *self, PyObject *args)
 static PyObject *
 psyco_curs_fetchmany(cursorObject *self, PyObject *args, PyObject *kwords)
 {
-    int i;
-    PyObject *list, *res;
+    PyObject *list;
 
     long int size = self->arraysize;
     static char *kwlist[] = {"size", NULL};
@@ -804,13 +2559,24 @@ psyco_curs_fetchmany(cursorObject *self, PyObject *args, PyObject *kwords)
 
     if (self->name != NULL) {
         char buffer[128];
+        long int buffered;
 
         EXC_IF_NO_MARK(self);
         EXC_IF_TPC_PREPARED(self->conn, fetchone);
-        PyOS_snprintf(buffer, 127, "FETCH FORWARD %d FROM %s",
-            (int)size, self->name);
-        if (pq_execute(self, buffer, 0) == -1) return NULL;
-        if (_psyco_curs_prefetch(self) < 0) return NULL;
+        buffered = _psyco_curs_buffered(self);
+        if (buffered > 0 && buffered < size) {
+            return _psyco_curs_fetch_named(self, size);
+        }
+        else if (buffered == 0) {
+            PyOS_snprintf(buffer, 127, "FETCH FORWARD %d FROM %s",
+                (int)size, self->name);
+            if (pq_execute(self, buffer, 0) == -1) return NULL;
+            if (_psyco_curs_prefetch(self) < 0) return NULL;
+        }
+    }
+
+    if (self->stream_pending) {
+        return _psyco_curs_fetch_stream(self, size);
     }
 
     /* make sure size is not > than the available number of rows */
@@ -824,29 +2590,14 @@ psyco_curs_fetchmany(cursorObject *self, PyObject *args, PyObject *kwords)
         return PyList_New(0);
     }
 
-    list = PyList_New(size);
-
-    for (i = 0; i < size; i++) {
-        if (self->tuple_factory == Py_None)
-            res = _psyco_curs_buildrow(self, self->row);
-        else
-            res = _psyco_curs_buildrow_with_factory(self, self->row);
-
-        self->row++;
-
-        if (res == NULL) {
-            Py_DECREF(list);
-            return NULL;
-        }
-
-        PyList_SET_ITEM(list, i, res);
+    if (!(list = _psyco_curs_buildrows(self, size))) {
+        return NULL;
     }
 
-    /* if the query was async aggresively free pgres, to allow
-       successive requests to reallocate it */
-    if (self->row >= self->rowcount
-        && self->conn->async_cursor == (PyObject*)self)
-        IFCLEARPGRES(self->pgres);
+    if (0 > _psyco_curs_async_release(self)) {
+        Py_DECREF(list);
+        return NULL;
+    }
 
     return list;
 }
@@ -864,8 +2615,8 @@ psyco_curs_fetchmany(cursorObject *self, PyObject *args, PyObject *kwords)
 static PyObject *
 psyco_curs_fetchall(cursorObject *self, PyObject *args)
 {
-    int i, size;
-    PyObject *list, *res;
+    int size;
+    PyObject *list;
 
     EXC_IF_CURS_CLOSED(self);
     EXC_IF_ASYNC_IN_PROGRESS(self, fetchall);
@@ -877,40 +2628,32 @@ psyco_curs_fetchall(cursorObject *self, PyObject *args)
 
         EXC_IF_NO_MARK(self);
         EXC_IF_TPC_PREPARED(self->conn, fetchall);
+        if (_psyco_curs_buffered(self) > 0) {
+            return _psyco_curs_fetch_named(self, -1);
+        }
         PyOS_snprintf(buffer, 127, "FETCH FORWARD ALL FROM %s", self->name);
         if (pq_execute(self, buffer, 0) == -1) return NULL;
         if (_psyco_curs_prefetch(self) < 0) return NULL;
     }
 
+    if (self->stream_pending) {
+        return _psyco_curs_fetch_stream(self, -1);
+    }
+
     size = self->rowcount - self->row;
 
     if (size <= 0) {
         return PyList_New(0);
     }
 
-    list = PyList_New(size);
-
-    for (i = 0; i < size; i++) {
-        if (self->tuple_factory == Py_None)
-            res = _psyco_curs_buildrow(self, self->row);
-        else
-            res = _psyco_curs_buildrow_with_factory(self, self->row);
-
-        self->row++;
-
-        if (res == NULL) {
-            Py_DECREF(list);
-            return NULL;
-        }
-
-        PyList_SET_ITEM(list, i, res);
+    if (!(list = _psyco_curs_buildrows(self, size))) {
+        return NULL;
     }
 
-    /* if the query was async aggresively free pgres, to allow
-       successive requests to reallocate it */
-    if (self->row >= self->rowcount
-        && self->conn->async_cursor == (PyObject*)self)
-        IFCLEARPGRES(self->pgres);
+    if (0 > _psyco_curs_async_release(self)) {
+        Py_DECREF(list);
+        return NULL;
+    }
 
     return list;
 }
@@ -976,20 +2719,31 @@ psyco_curs_callproc(cursorObject *self, PyObject *args, PyObject *kwargs)
 }
 
 
-/* nextset method - return the next set of data (not supported) */
+/* nextset method - return the next set of data */
 
 #define psyco_curs_nextset_doc \
 "nextset() -- Skip to next set of data.\n\n" \
-"This method is not supported (PostgreSQL does not have multiple data \n" \
-"sets) and will raise a NotSupportedError exception."
+"Move to the result of the next statement executed by the last query, if\n" \
+"the cursor has `multiple_results` set, discarding the current one.\n" \
+"Return True, or None if there are no more sets."
 
 static PyObject *
 psyco_curs_nextset(cursorObject *self, PyObject *args)
 {
+    int rv;
+
     EXC_IF_CURS_CLOSED(self);
+    EXC_IF_ASYNC_IN_PROGRESS(self, nextset);
 
-    PyErr_SetString(NotSupportedError, "not supported by PostgreSQL");
-    return NULL;
+    if (-1 == (rv = pq_nextset(self))) {
+        return NULL;
+    }
+    if (rv == 0) {
+        Py_INCREF(Py_None);
+        return Py_None;
+    }
+    Py_INCREF(Py_True);
+    return Py_True;
 }
 
 
@@ -1069,7 +2823,8 @@ psyco_curs_scroll(cursorObject *self, PyObject *args, PyObject *kwargs)
             return NULL;
         }
 
-        if (newpos < 0 || newpos >= self->rowcount ) {
+        /* a streaming cursor can only move in the rows received */
+        if (newpos < self->rowoffset || newpos >= self->rowcount ) {
             psyco_set_error(ProgrammingError, (PyObject*)self,
                              "scroll destination out of bounds", NULL, NULL);
             return NULL;
@@ -1089,6 +2844,8 @@ psyco_curs_scroll(cursorObject *self, PyObject *args, PyObject *kwargs)
                 value, self->name);
         }
         else {
+            /* the backend is past the rows buffered by iter(cursor) */
+            value -= (int)_psyco_curs_buffered(self);
             PyOS_snprintf(buffer, 127, "MOVE %d FROM %s", value, self->name);
         }
         if (pq_execute(self, buffer, 0) == -1) return NULL;
@@ -1205,7 +2962,6 @@ psyco_curs_copy_from(cursorObject *self, PyObject *args, PyObject *kwargs)
 
     EXC_IF_CURS_CLOSED(self);
     EXC_IF_CURS_ASYNC(self, copy_from);
-    EXC_IF_GREEN(copy_from);
     EXC_IF_TPC_PREPARED(self->conn, copy_from);
 
 
@@ -1270,7 +3026,8 @@ psyco_curs_copy_from(cursorObject *self, PyObject *args, PyObject *kwargs)
 /* extension: copy_to - implements COPY TO */
 
 #define psyco_curs_copy_to_doc \
-"copy_to(file, table, sep='\\t', null='\\N', columns=None) -- Copy table to file."
+"copy_to(file, table, sep='\\t', null='\\N', columns=None, size=65536) --\n" \
+"Copy table to file, calling file.write() with about `size` bytes at time."
 
 static int
 _psyco_curs_has_write_check(PyObject* o, void* var)
@@ -1299,12 +3056,16 @@ psyco_curs_copy_to(cursorObject *self, PyObject *args, PyObject *kwargs)
     const char *sep = "\t", *null = NULL;
     PyObject *file, *columns = NULL, *res = NULL;
     char *quoted_delimiter;
+    Py_ssize_t bufsize = DEFAULT_COPYOUTBUFF;
 
-    static char *kwlist[] = {"file", "table", "sep", "null", "columns", NULL};
+    static char *kwlist[] = {"file", "table", "sep", "null", "columns",
+                             "size", NULL};
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O&s|ssO", kwlist,
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs,
+                                     "O&s|ssO" CONV_CODE_PY_SSIZE_T, kwlist,
                                      _psyco_curs_has_write_check, &file,
-                                     &table_name, &sep, &null, &columns)) {
+                                     &table_name, &sep, &null, &columns,
+                                     &bufsize)) {
         return NULL;
     }
 
@@ -1313,7 +3074,6 @@ psyco_curs_copy_to(cursorObject *self, PyObject *args, PyObject *kwargs)
 
     EXC_IF_CURS_CLOSED(self);
     EXC_IF_CURS_ASYNC(self, copy_to);
-    EXC_IF_GREEN(copy_to);
     EXC_IF_TPC_PREPARED(self->conn, copy_to);
 
     quoted_delimiter = psycopg_escape_string((PyObject*)self->conn, sep, 0, NULL, NULL);
@@ -1358,7 +3118,7 @@ psyco_curs_copy_to(cursorObject *self, PyObject *args, PyObject *kwargs)
     
     Dprintf("psyco_curs_copy_to: query = %s", query);
 
-    self->copysize = 0;
+    self->copysize = bufsize;
     self->copyfile = file;
 
     if (pq_execute(self, query, 0) == 1) {
@@ -1384,7 +3144,7 @@ psyco_curs_copy_to(cursorObject *self, PyObject *args, PyObject *kwargs)
 "`file` must be an open, readable file for COPY FROM or an open, writeable\n"   \
 "file for COPY TO. The optional `size` argument, when specified for a COPY\n"   \
 "FROM statement, will be passed to file's read method to control the read\n"    \
-"buffer size."
+"buffer size; for a COPY TO it is the amount of data passed to each write."
 
 static PyObject *
 psyco_curs_copy_expert(cursorObject *self, PyObject *args, PyObject *kwargs)
@@ -1400,7 +3160,6 @@ psyco_curs_copy_expert(cursorObject *self, PyObject *args, PyObject *kwargs)
 
     EXC_IF_CURS_CLOSED(self);
     EXC_IF_CURS_ASYNC(self, copy_expert);
-    EXC_IF_GREEN(copy_expert);
     EXC_IF_TPC_PREPARED(self->conn, copy_expert);
 
     sql = _psyco_curs_validate_sql_basic(self, sql);
@@ -1448,6 +3207,360 @@ psyco_curs_copy_expert(cursorObject *self, PyObject *args, PyObject *kwargs)
     return res;
 }
 
+/* extension: copy_records - implements binary COPY FROM of python records */
+
+#define psyco_curs_copy_records_doc \
+"copy_records(table, columns, records, size=65536) -- Copy records into table.\n\n" \
+"`records` is an iterable of sequences with a value for each of `columns`\n" \
+"(all the table columns if None). The values are sent in binary format\n" \
+"`size` bytes at time."
+
+static PyObject *
+psyco_curs_copy_records(cursorObject *self, PyObject *args, PyObject *kwargs)
+{
+    const char *table_name;
+    char columnlist[DEFAULT_COPYBUFF];
+    char *query = NULL;
+    size_t query_size;
+    Py_ssize_t bufsize = DEFAULT_COPYRECORDSBUFF;
+    PyObject *columns, *records, *res = NULL;
+    copyRecords rec;
+    Oid ftype;
+    int i;
+
+    static char *kwlist[] = {"table", "columns", "records", "size", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs,
+        "sOO|" CONV_CODE_PY_SSIZE_T, kwlist,
+        &table_name, &columns, &records, &bufsize))
+    {
+        return NULL;
+    }
+
+    if (bufsize <= 0) {
+        PyErr_SetString(PyExc_ValueError, "size must be positive");
+        return NULL;
+    }
+
+    if (_psyco_curs_copy_columns(columns, columnlist) == -1)
+        return NULL;
+
+    EXC_IF_CURS_CLOSED(self);
+    EXC_IF_CURS_ASYNC(self, copy_records);
+    EXC_IF_TPC_PREPARED(self->conn, copy_records);
+
+    memset(&rec, 0, sizeof(rec));
+    rec.size = bufsize;
+    if (!(rec.iter = PyObject_GetIter(records))) { goto exit; }
+
+    query_size = strlen(table_name) + strlen(columnlist) + 64;
+    if (!(query = PyMem_Malloc(query_size))) {
+        PyErr_NoMemory();
+        goto exit;
+    }
+
+    /* find out the types of the columns to choose the encoders */
+    if (columnlist[0]) {
+        PyOS_snprintf(query, query_size, "SELECT %.*s FROM %s LIMIT 0",
+            (int)strlen(columnlist) - 2, columnlist + 1, table_name);
+    }
+    else {
+        PyOS_snprintf(query, query_size, "SELECT * FROM %s LIMIT 0",
+            table_name);
+    }
+    Dprintf("psyco_curs_copy_records: query = %s", query);
+
+    if (pq_execute(self, query, 0) == -1) { goto exit; }
+    if (!self->pgres) {
+        PyErr_SetString(InterfaceError, "can't read the columns types");
+        goto exit;
+    }
+
+    rec.ncols = PQnfields(self->pgres);
+    if (!(rec.encoders = PyMem_Malloc(
+            (rec.ncols ? rec.ncols : 1) * sizeof(copy_encoder)))) {
+        PyErr_NoMemory();
+        goto exit;
+    }
+    for (i = 0; i < rec.ncols; i++) {
+        ftype = PQftype(self->pgres, i);
+        if (!(rec.encoders[i] = copy_binary_encoder(ftype))) {
+            PyErr_Format(NotSupportedError,
+                "can't copy column \"%s\" of type %u in binary format",
+                PQfname(self->pgres, i), (unsigned int)ftype);
+            goto exit;
+        }
+    }
+
+    PyOS_snprintf(query, query_size, "COPY %s%s FROM stdin WITH BINARY",
+        table_name, columnlist);
+    Dprintf("psyco_curs_copy_records: query = %s", query);
+
+    self->copyrecords = &rec;
+    if (pq_execute(self, query, 0) == 1) {
+        res = Py_None;
+        Py_INCREF(Py_None);
+    }
+    self->copyrecords = NULL;
+
+exit:
+    PyMem_Free(query);
+    PyMem_Free(rec.encoders);
+    copy_buffer_free(&rec.buf);
+    Py_XDECREF(rec.iter);
+
+    return res;
+}
+
+/* extension: copy_out_iter, copy_in_stream - COPY operations as streams */
+
+static PyObject *
+_psyco_curs_copy_stream(cursorObject *self, PyObject *sql, int direction,
+                        Py_ssize_t size)
+{
+    PyObject *stream = NULL;
+
+    if (!(sql = _psyco_curs_validate_sql_basic(self, sql))) { return NULL; }
+
+    if (!(stream = copystream_new(self, direction, size))) { goto exit; }
+    /* the stream is opened by pq_fetch() if the query is the right COPY */
+    ((copystreamObject *)stream)->closed = 1;
+
+    self->copysize = size;
+    self->copyfile = stream;
+
+    /* At this point, the SQL statement must be str, not unicode */
+    if (pq_execute(self, PyString_AS_STRING(sql), 0) != 1) {
+        Py_CLEAR(stream);
+    }
+    else if (((copystreamObject *)stream)->closed) {
+        PyErr_SetString(ProgrammingError, direction == COPYSTREAM_IN
+            ? "the query is not a COPY FROM STDIN"
+            : "the query is not a COPY TO STDOUT");
+        Py_CLEAR(stream);
+    }
+
+exit:
+    self->copyfile = NULL;
+    Py_DECREF(sql);
+    return stream;
+}
+
+#define psyco_curs_copy_out_iter_doc \
+"copy_out_iter(sql, chunk_size=65536) -- Iterate on the data of a COPY TO.\n\n" \
+"`sql` must be a COPY TO STDOUT statement. Return an iterator yielding\n" \
+"strings of about `chunk_size` bytes."
+
+static PyObject *
+psyco_curs_copy_out_iter(cursorObject *self, PyObject *args, PyObject *kwargs)
+{
+    Py_ssize_t size = DEFAULT_COPYOUTBUFF;
+    PyObject *sql;
+
+    static char *kwlist[] = {"sql", "chunk_size", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs,
+        "O|" CONV_CODE_PY_SSIZE_T, kwlist, &sql, &size))
+    { return NULL; }
+
+    EXC_IF_CURS_CLOSED(self);
+    EXC_IF_CURS_ASYNC(self, copy_out_iter);
+    EXC_IF_TPC_PREPARED(self->conn, copy_out_iter);
+
+    if (size <= 0) {
+        PyErr_SetString(PyExc_ValueError, "chunk_size must be positive");
+        return NULL;
+    }
+
+    return _psyco_curs_copy_stream(self, sql, COPYSTREAM_OUT, size);
+}
+
+#define psyco_curs_copy_in_stream_doc \
+"copy_in_stream(sql) -- Return a file-like object to write a COPY FROM.\n\n" \
+"`sql` must be a COPY FROM STDIN statement. The data passed to the\n" \
+"stream write() is sent to the backend; close() completes the COPY."
+
+static PyObject *
+psyco_curs_copy_in_stream(cursorObject *self, PyObject *args)
+{
+    PyObject *sql;
+
+    if (!PyArg_ParseTuple(args, "O", &sql)) { return NULL; }
+
+    EXC_IF_CURS_CLOSED(self);
+    EXC_IF_CURS_ASYNC(self, copy_in_stream);
+    EXC_IF_TPC_PREPARED(self->conn, copy_in_stream);
+
+    return _psyco_curs_copy_stream(self, sql, COPYSTREAM_IN, 0);
+}
+
+/* extension: fetch_columns - fetch the remaining rows one column at time */
+
+#define psyco_curs_fetch_columns_doc \
+"fetch_columns() -> list of columns\n\n" \
+"Return the remaining rows of a query result set one column at time.\n\n" \
+"Integer, float, boolean, date and timestamp columns are returned as\n" \
+"`Column` objects exposing the values as a typed buffer, the other ones\n" \
+"as lists of Python objects."
+
+/* append the rows first..last-1 of the current result to the columns */
+
+static int
+_psyco_curs_columns_fill(cursorObject *self, PyObject *cols,
+                         int first, int last)
+{
+    Py_ssize_t i;
+    int row;
+    const char *str;
+    Py_ssize_t len;
+    PyObject *col, *val;
+
+    for (i = 0; i < PyList_GET_SIZE(cols); i++) {
+        col = PyList_GET_ITEM(cols, i);
+        if (!PyList_Check(col)) {
+            if (0 > column_append((columnObject *)col, self, (int)i,
+                                  first, last)) {
+                return -1;
+            }
+            continue;
+        }
+
+        for (row = first; row < last; row++) {
+            if (PQgetisnull(self->pgres, row, (int)i)) {
+                str = NULL;
+                len = 0;
+            }
+            else {
+                str = PQgetvalue(self->pgres, row, (int)i);
+                len = PQgetlength(self->pgres, row, (int)i);
+            }
+            if (self->interns && self->interns[i]) {
+                val = curs_intern_cast(self, (int)i, str, len);
+            }
+            else {
+                val = typecast_cast(PyTuple_GET_ITEM(self->casts, i),
+                                    str, len, (PyObject*)self);
+            }
+            if (!val) { return -1; }
+            if (0 > PyList_Append(col, val)) {
+                Py_DECREF(val);
+                return -1;
+            }
+            Py_DECREF(val);
+        }
+    }
+
+    return 0;
+}
+
+static int
+_psyco_curs_columns_append(cursorObject *self, PyObject *cols,
+                           int first, int last)
+{
+    int rv;
+    PyObject *owner;
+
+    if (0 > _psyco_curs_cast_owner(self, &owner)) { return -1; }
+    rv = _psyco_curs_columns_fill(self, cols, first, last);
+    self->cast_owner = owner;
+    return rv;
+}
+
+static PyObject *
+psyco_curs_fetch_columns(cursorObject *self, PyObject *args)
+{
+    PyObject *cols = NULL, *col;
+    int i, kind, fetched = 1;
+
+    EXC_IF_CURS_CLOSED(self);
+    EXC_IF_ASYNC_IN_PROGRESS(self, fetch_columns);
+    if (_psyco_curs_prefetch(self) < 0) return NULL;
+    EXC_IF_NO_TUPLES(self);
+
+    if (self->name != NULL) {
+        char buffer[128];
+
+        EXC_IF_NO_MARK(self);
+        EXC_IF_TPC_PREPARED(self->conn, fetch_columns);
+        /* the rows left by an iteration are returned first */
+        if (_psyco_curs_buffered(self) > 0) {
+            fetched = 0;
+        }
+        else {
+            PyOS_snprintf(buffer, 127, "FETCH FORWARD ALL FROM %s",
+                self->name);
+            if (pq_execute(self, buffer, 0) == -1) return NULL;
+            if (_psyco_curs_prefetch(self) < 0) return NULL;
+        }
+    }
+
+    if (_psyco_curs_stream_next(self) < 0) return NULL;
+
+    if (self->pgres == NULL) {
+        return PyList_New(0);
+    }
+
+    if (!(cols = PyList_New(self->columns))) return NULL;
+    for (i = 0; i < self->columns; i++) {
+        kind = column_kind(self, i);
+        if (kind == COLUMN_OBJECT) {
+            col = PyList_New(0);
+        }
+        else {
+            col = column_new(self, i, kind);
+        }
+        if (!col) goto error;
+        PyList_SET_ITEM(cols, i, col);
+    }
+
+    while (1) {
+        if (self->row < self->rowcount) {
+            if (0 > _psyco_curs_columns_append(self, cols,
+                    (int)(self->row - self->rowoffset),
+                    (int)(self->rowcount - self->rowoffset))) {
+                goto error;
+            }
+            self->row = self->rowcount;
+        }
+
+        if (!fetched) {
+            char buffer[128];
+
+            fetched = 1;
+            PyOS_snprintf(buffer, 127, "FETCH FORWARD ALL FROM %s",
+                self->name);
+            if (pq_execute(self, buffer, 0) == -1) goto error;
+            if (_psyco_curs_prefetch(self) < 0) goto error;
+        }
+        else if (self->stream_pending) {
+            if (_psyco_curs_stream_next(self) < 0) goto error;
+        }
+        else {
+            break;
+        }
+    }
+
+    return cols;
+
+error:
+    Py_XDECREF(cols);
+    return NULL;
+}
+
+
+/* description - built from the result the first time it is read */
+
+#define psyco_curs_description_doc \
+"Cursor description as defined in DBAPI-2.0."
+
+static PyObject *
+psyco_curs_get_description(cursorObject *self, void *closure)
+{
+    if (0 > pq_fetch_description(self)) { return NULL; }
+    Py_INCREF(self->description);
+    return self->description;
+}
+
 /* extension: closed - return true if cursor is closed*/
 
 #define psyco_curs_closed_doc \
@@ -1464,6 +3577,71 @@ psyco_curs_get_closed(cursorObject *self, void *closure)
     return closed;
 }
 
+/* extension: result_memory - the memory taken by the current result */
+
+#define psyco_curs_result_memory_doc \
+"The bytes of memory taken by the result of the last query.\n\n" \
+"Only the part of a streaming result currently received is counted."
+
+static PyObject *
+psyco_curs_get_result_memory(cursorObject *self, void *closure)
+{
+    return PyInt_FromSsize_t((Py_ssize_t)pq_result_memory(self->pgres));
+}
+
+/* extension: intern_columns - the columns whose equal values are shared */
+
+#define psyco_curs_intern_columns_doc \
+"The text columns whose values are decoded once per distinct value.\n\n" \
+"None (default), True for all the text columns, or a sequence of\n" \
+"column names and positions."
+
+static PyObject *
+psyco_curs_get_intern_columns(cursorObject *self, void *closure)
+{
+    Py_INCREF(self->intern_columns);
+    return self->intern_columns;
+}
+
+static int
+psyco_curs_set_intern_columns(cursorObject *self, PyObject *value,
+                              void *closure)
+{
+    PyObject *tmp;
+
+    if (value == NULL) {
+        PyErr_SetString(PyExc_AttributeError,
+            "can't delete intern_columns");
+        return -1;
+    }
+    if (value == Py_False) { value = Py_None; }
+    if (value != Py_None && value != Py_True) {
+        Py_ssize_t i;
+        if (!(value = PySequence_Tuple(value))) {
+            PyErr_SetString(PyExc_TypeError, "intern_columns must be None, "
+                "True or a sequence of column names and positions");
+            return -1;
+        }
+        for (i = 0; i < PyTuple_GET_SIZE(value); i++) {
+            tmp = PyTuple_GET_ITEM(value, i);
+            if (!PyString_Check(tmp) && !PyInt_Check(tmp)) {
+                PyErr_SetString(PyExc_TypeError,
+                    "intern_columns items must be names or positions");
+                Py_DECREF(value);
+                return -1;
+            }
+        }
+    }
+    else {
+        Py_INCREF(value);
+    }
+
+    tmp = self->intern_columns;
+    self->intern_columns = value;
+    Py_DECREF(tmp);
+    return 0;
+}
+
 #endif
 
 
@@ -1479,11 +3657,59 @@ cursor_iter(PyObject *self)
     return self;
 }
 
+/* iterate over a named cursor fetching itersize rows at time */
+
+static PyObject *
+_psyco_curs_next_named(cursorObject *self)
+{
+    PyObject *res;
+    double t0;
+
+    EXC_IF_CURS_CLOSED(self);
+    EXC_IF_ASYNC_IN_PROGRESS(self, next);
+    if (_psyco_curs_prefetch(self) < 0) return NULL;
+    EXC_IF_NO_MARK(self);
+    EXC_IF_TPC_PREPARED(self->conn, next);
+
+    if (_psyco_curs_buffered(self) == 0) {
+        char buffer[128];
+
+        PyOS_snprintf(buffer, 127, "FETCH FORWARD %ld FROM %s",
+            self->itersize > 0 ? self->itersize : 1, self->name);
+        if (pq_execute(self, buffer, 0) == -1) return NULL;
+        if (_psyco_curs_prefetch(self) < 0) return NULL;
+    }
+
+    Dprintf("_psyco_curs_next_named: fetching row %ld", self->row);
+    Dprintf("_psyco_curs_next_named: rowcount = %ld", self->rowcount);
+
+    /* we exausted available data: stop the iteration */
+    if (self->row >= self->rowcount) {
+        return NULL;
+    }
+
+    t0 = CONN_STATS_START(self->conn);
+    if (self->tuple_factory == Py_None)
+        res = _psyco_curs_buildrow(self, self->row);
+    else
+        res = _psyco_curs_buildrow_with_factory(self, self->row);
+    CONN_STATS_ADD_TIME(self->conn, decode_time, t0);
+    CONN_STATS_ADD(self->conn, rows, 1);
+
+    self->row++;
+
+    return res;
+}
+
 static PyObject *
 cursor_next(PyObject *self)
 {
     PyObject *res;
 
+    if (NULL != ((cursorObject*)self)->name) {
+        return _psyco_curs_next_named((cursorObject*)self);
+    }
+
     /* we don't parse arguments: psyco_curs_fetchone will do that for us */
     res = psyco_curs_fetchone((cursorObject*)self, NULL);
 
@@ -1495,43 +3721,108 @@ cursor_next(PyObject *self)
     return res;
 }
 
+/* the methods using the cursor state, called holding the cursor lock */
+
+#define CURS_LOCKED_ARGS(name) \
+static PyObject * \
+name ## _locked(cursorObject *self, PyObject *args) \
+{ \
+    PyObject *rv; \
+    curs_lock(self); \
+    rv = name(self, args); \
+    curs_unlock(self); \
+    return rv; \
+}
+
+#define CURS_LOCKED_KWARGS(name) \
+static PyObject * \
+name ## _locked(cursorObject *self, PyObject *args, PyObject *kwargs) \
+{ \
+    PyObject *rv; \
+    curs_lock(self); \
+    rv = name(self, args, kwargs); \
+    curs_unlock(self); \
+    return rv; \
+}
+
+CURS_LOCKED_ARGS(psyco_curs_close)
+CURS_LOCKED_KWARGS(psyco_curs_execute)
+CURS_LOCKED_KWARGS(psyco_curs_executemany)
+CURS_LOCKED_ARGS(psyco_curs_fetchone)
+CURS_LOCKED_KWARGS(psyco_curs_fetchmany)
+CURS_LOCKED_ARGS(psyco_curs_fetchall)
+CURS_LOCKED_KWARGS(psyco_curs_callproc)
+CURS_LOCKED_ARGS(psyco_curs_nextset)
+CURS_LOCKED_KWARGS(psyco_curs_scroll)
+#ifdef PSYCOPG_EXTENSIONS
+CURS_LOCKED_KWARGS(psyco_curs_execute_values)
+CURS_LOCKED_KWARGS(psyco_curs_mogrify)
+CURS_LOCKED_KWARGS(psyco_curs_copy_from)
+CURS_LOCKED_KWARGS(psyco_curs_copy_to)
+CURS_LOCKED_KWARGS(psyco_curs_copy_expert)
+CURS_LOCKED_KWARGS(psyco_curs_copy_records)
+CURS_LOCKED_KWARGS(psyco_curs_copy_out_iter)
+CURS_LOCKED_ARGS(psyco_curs_copy_in_stream)
+CURS_LOCKED_ARGS(psyco_curs_fetch_columns)
+#endif
+
+static PyObject *
+cursor_next_locked(PyObject *self)
+{
+    PyObject *rv;
+    curs_lock((cursorObject *)self);
+    rv = cursor_next(self);
+    curs_unlock((cursorObject *)self);
+    return rv;
+}
+
 /* object method list */
 
 static struct PyMethodDef cursorObject_methods[] = {
     /* DBAPI-2.0 core */
-    {"close", (PyCFunction)psyco_curs_close,
+    {"close", (PyCFunction)psyco_curs_close_locked,
      METH_NOARGS, psyco_curs_close_doc},
-    {"execute", (PyCFunction)psyco_curs_execute,
+    {"execute", (PyCFunction)psyco_curs_execute_locked,
      METH_VARARGS|METH_KEYWORDS, psyco_curs_execute_doc},
-    {"executemany", (PyCFunction)psyco_curs_executemany,
+    {"executemany", (PyCFunction)psyco_curs_executemany_locked,
      METH_VARARGS|METH_KEYWORDS, psyco_curs_executemany_doc},
-    {"fetchone", (PyCFunction)psyco_curs_fetchone,
+    {"fetchone", (PyCFunction)psyco_curs_fetchone_locked,
      METH_NOARGS, psyco_curs_fetchone_doc},
-    {"fetchmany", (PyCFunction)psyco_curs_fetchmany,
+    {"fetchmany", (PyCFunction)psyco_curs_fetchmany_locked,
      METH_VARARGS|METH_KEYWORDS, psyco_curs_fetchmany_doc},
-    {"fetchall", (PyCFunction)psyco_curs_fetchall,
+    {"fetchall", (PyCFunction)psyco_curs_fetchall_locked,
      METH_NOARGS, psyco_curs_fetchall_doc},
-    {"callproc", (PyCFunction)psyco_curs_callproc,
+    {"callproc", (PyCFunction)psyco_curs_callproc_locked,
      METH_VARARGS, psyco_curs_callproc_doc},
-    {"nextset", (PyCFunction)psyco_curs_nextset,
+    {"nextset", (PyCFunction)psyco_curs_nextset_locked,
      METH_NOARGS, psyco_curs_nextset_doc},
     {"setinputsizes", (PyCFunction)psyco_curs_setinputsizes,
      METH_VARARGS, psyco_curs_setinputsizes_doc},
     {"setoutputsize", (PyCFunction)psyco_curs_setoutputsize,
      METH_VARARGS, psyco_curs_setoutputsize_doc},
     /* DBAPI-2.0 extensions */
-    {"scroll", (PyCFunction)psyco_curs_scroll,
+    {"scroll", (PyCFunction)psyco_curs_scroll_locked,
      METH_VARARGS|METH_KEYWORDS, psyco_curs_scroll_doc},
     /* psycopg extensions */
 #ifdef PSYCOPG_EXTENSIONS
-    {"mogrify", (PyCFunction)psyco_curs_mogrify,
+    {"execute_values", (PyCFunction)psyco_curs_execute_values_locked,
+     METH_VARARGS|METH_KEYWORDS, psyco_curs_execute_values_doc},
+    {"mogrify", (PyCFunction)psyco_curs_mogrify_locked,
      METH_VARARGS|METH_KEYWORDS, psyco_curs_mogrify_doc},
-    {"copy_from", (PyCFunction)psyco_curs_copy_from,
+    {"copy_from", (PyCFunction)psyco_curs_copy_from_locked,
      METH_VARARGS|METH_KEYWORDS, psyco_curs_copy_from_doc},
-    {"copy_to", (PyCFunction)psyco_curs_copy_to,
+    {"copy_to", (PyCFunction)psyco_curs_copy_to_locked,
      METH_VARARGS|METH_KEYWORDS, psyco_curs_copy_to_doc},
-    {"copy_expert", (PyCFunction)psyco_curs_copy_expert,
+    {"copy_expert", (PyCFunction)psyco_curs_copy_expert_locked,
      METH_VARARGS|METH_KEYWORDS, psyco_curs_copy_expert_doc},
+    {"copy_records", (PyCFunction)psyco_curs_copy_records_locked,
+     METH_VARARGS|METH_KEYWORDS, psyco_curs_copy_records_doc},
+    {"copy_out_iter", (PyCFunction)psyco_curs_copy_out_iter_locked,
+     METH_VARARGS|METH_KEYWORDS, psyco_curs_copy_out_iter_doc},
+    {"copy_in_stream", (PyCFunction)psyco_curs_copy_in_stream_locked,
+     METH_VARARGS, psyco_curs_copy_in_stream_doc},
+    {"fetch_columns", (PyCFunction)psyco_curs_fetch_columns_locked,
+     METH_NOARGS, psyco_curs_fetch_columns_doc},
 #endif
     {NULL}
 };
@@ -1547,8 +3838,6 @@ static struct PyMemberDef cursorObject_members[] = {
     {"arraysize", T_LONG, OFFSETOF(arraysize), 0,
         "Number of records `fetchmany()` must fetch if not explicitly " \
         "specified."},
-    {"description", T_OBJECT, OFFSETOF(description), RO,
-        "Cursor description as defined in DBAPI-2.0."},
     {"lastrowid", T_LONG, OFFSETOF(lastoid), RO,
         "The ``oid`` of the last row inserted by the cursor."},
     /* DBAPI-2.0 extensions */
@@ -1567,15 +3856,41 @@ static struct PyMemberDef cursorObject_members[] = {
     {"typecaster", T_OBJECT, OFFSETOF(caster), RO},
     {"string_types", T_OBJECT, OFFSETOF(string_types), 0},
     {"binary_types", T_OBJECT, OFFSETOF(binary_types), 0},
+    {"server_params", T_INT, OFFSETOF(server_params), 0,
+        "If true, pass the query arguments to the backend out-of-line."},
+    {"binary", T_INT, OFFSETOF(binary), 0,
+        "If true, ask the backend for results in binary format."},
+    {"streaming", T_LONG, OFFSETOF(streaming), 0,
+        "If > 0, receive the rows of a query this many at time."},
+    {"result_limit", T_PYSSIZET, OFFSETOF(result_limit), 0,
+        "If > 0, maximum size in bytes of a query result."},
+    {"result_limit_stream", T_INT, OFFSETOF(result_limit_stream), 0,
+        "If true, stream the results exceeding `result_limit`."},
+    {"cache_results", T_INT, OFFSETOF(cache_results), 0,
+        "If true, read the results from the connection `result_cache`."},
+    {"multiple_results", T_INT, OFFSETOF(multiple_results), 0,
+        "If true, keep the results of all the statements for nextset()."},
+    {"itersize", T_LONG, OFFSETOF(itersize), 0,
+        "Number of records ``iter(cur)`` must fetch per network roundtrip."},
+    {"nogil_batch", T_LONG, OFFSETOF(nogil_batch), 0,
+        "If > 0, fetchmany() and fetchall() parse this many rows at time "
+        "releasing the GIL."},
 #endif
     {NULL}
 };
 
 /* object calculated member list */
 static struct PyGetSetDef cursorObject_getsets[] = {
+    { "description", (getter)psyco_curs_get_description, NULL,
+      psyco_curs_description_doc, NULL },
 #ifdef PSYCOPG_EXTENSIONS
     { "closed", (getter)psyco_curs_get_closed, NULL,
       psyco_curs_closed_doc, NULL },
+    { "result_memory", (getter)psyco_curs_get_result_memory, NULL,
+      psyco_curs_result_memory_doc, NULL },
+    { "intern_columns", (getter)psyco_curs_get_intern_columns,
+      (setter)psyco_curs_set_intern_columns,
+      psyco_curs_intern_columns_doc, NULL },
 #endif
     {NULL}
 };
@@ -1605,19 +3920,42 @@ cursor_setup(cursorObject *self, connectionObject *conn, const char *name)
     self->conn = conn;
 
     self->closed = 0;
+    self->async_queued = 0;
+    self->async_canceled = 0;
+    self->async_params = NULL;
     self->mark = conn->mark;
     self->pgres = NULL;
+    self->shared_pgres = NULL;
+    self->shared_result = NULL;
+    self->cast_owner = NULL;
     self->notuples = 1;
     self->arraysize = 1;
+    self->itersize = DEFAULT_ITERSIZE;
+    self->nogil_batch = 0;
     self->rowcount = -1;
     self->lastoid = InvalidOid;
 
     self->casts = NULL;
+    self->casts_entry = NULL;
+    self->ccasts = NULL;
+    self->batch = NULL;
+    self->query_layout = NULL;
     self->notice = NULL;
 
     self->string_types = NULL;
     self->binary_types = NULL;
 
+    self->server_params = conn->server_params;
+    self->binary = 0;
+    self->streaming = 0;
+    self->rowoffset = 0;
+    self->stream_pending = 0;
+    self->result_limit = conn->result_limit;
+    self->result_limit_stream = 0;
+    self->cache_results = 0;
+    self->multiple_results = 0;
+    memset(&self->nextsets, 0, sizeof(cursorResults));
+
     Py_INCREF(Py_None);
     self->description = Py_None;
     Py_INCREF(Py_None);
@@ -1626,6 +3964,12 @@ cursor_setup(cursorObject *self, connectionObject *conn, const char *name)
     self->tuple_factory = Py_None;
     Py_INCREF(Py_None);
     self->query = Py_None;
+    self->row_desc = NULL;
+    self->row_index = NULL;
+    self->row_names = NULL;
+
+    Py_INCREF(Py_None);
+    self->intern_columns = Py_None;
 
     /* default tzinfo factory */
     Py_INCREF(pyPsycopgTzFixedOffsetTimezone);
@@ -1647,17 +3991,38 @@ cursor_dealloc(PyObject* obj)
 
     if (self->name) PyMem_Free(self->name);
 
+    if (self->stream_pending && self->conn && !self->conn->closed) {
+        if (pq_stream_discard(self) < 0) PyErr_Clear();
+    }
+    if (self->conn && self->conn->stream_cursor == (PyObject *)self) {
+        self->conn->stream_cursor = NULL;
+    }
+
     Py_CLEAR(self->conn);
     Py_CLEAR(self->casts);
+    Py_CLEAR(self->casts_entry);
+    PyMem_Free(self->ccasts);
     Py_CLEAR(self->description);
     Py_CLEAR(self->pgstatus);
     Py_CLEAR(self->tuple_factory);
+    Py_CLEAR(self->row_desc);
+    Py_CLEAR(self->row_index);
+    Py_CLEAR(self->row_names);
     Py_CLEAR(self->tzinfo_factory);
+    curs_clear_tzinfo(self);
+    curs_intern_free(self);
+    Py_CLEAR(self->intern_columns);
     Py_CLEAR(self->query);
+    PyMem_Free(self->async_params);
     Py_CLEAR(self->string_types);
     Py_CLEAR(self->binary_types);
+    _psyco_curs_query_free(self->query_layout);
 
-    IFCLEARPGRES(self->pgres);
+    IFCLEARCURSPGRES(self);
+    Py_CLEAR(self->shared_result);
+    curs_clear_results(self);
+
+    pthread_mutex_destroy(&(self->lock));
 
     Dprintf("cursor_dealloc: deleted cursor object at %p, refcnt = "
         FORMAT_CODE_PY_SSIZE_T,
@@ -1681,7 +4046,12 @@ cursor_init(PyObject *obj, PyObject *args, PyObject *kwds)
 static PyObject *
 cursor_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
 {
-    return type->tp_alloc(type, 0);
+    cursorObject *self;
+
+    if (!(self = (cursorObject *)type->tp_alloc(type, 0))) { return NULL; }
+
+    pthread_mutex_init(&(self->lock), NULL);
+    return (PyObject *)self;
 }
 
 static void
@@ -1700,14 +4070,26 @@ cursor_repr(cursorObject *self)
 static int
 cursor_traverse(cursorObject *self, visitproc visit, void *arg)
 {
+    int i;
+
     Py_VISIT((PyObject *)self->conn);
     Py_VISIT(self->description);
     Py_VISIT(self->pgstatus);
     Py_VISIT(self->casts);
+    Py_VISIT(self->casts_entry);
+    Py_VISIT(self->shared_result);
     Py_VISIT(self->caster);
     Py_VISIT(self->copyfile);
     Py_VISIT(self->tuple_factory);
+    Py_VISIT(self->row_desc);
+    Py_VISIT(self->row_index);
+    Py_VISIT(self->row_names);
     Py_VISIT(self->tzinfo_factory);
+    Py_VISIT(self->tz_factory);
+    Py_VISIT(self->intern_columns);
+    for (i = 0; i < CURSOR_TZ_CACHE; i++) {
+        Py_VISIT(self->tz_cache[i]);
+    }
     Py_VISIT(self->query);
     Py_VISIT(self->string_types);
     Py_VISIT(self->binary_types);
@@ -1754,7 +4136,7 @@ PyTypeObject cursorType = {
     0,          /*tp_weaklistoffset*/
 
     cursor_iter, /*tp_iter*/
-    cursor_next, /*tp_iternext*/
+    cursor_next_locked, /*tp_iternext*/
 
     /* Attribute descriptor and subclassing stuff */
 
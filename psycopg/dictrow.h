@@ -0,0 +1,70 @@
+/* dictrow.h - definition for the dictionary-like row objects
+ *
+ * Copyright (C) 2010 Federico Di Gregorio <fog@debian.org>
+ *
+ * This file is part of psycopg.
+ *
+ * psycopg2 is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link this program with the OpenSSL library (or with
+ * modified versions of OpenSSL that use the same license as OpenSSL),
+ * and distribute linked combinations including the two.
+ *
+ * You must obey the GNU Lesser General Public License in all respects for
+ * all of the code used other than OpenSSL.
+ *
+ * psycopg2 is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ */
+
+#ifndef PSYCOPG_DICTROW_H
+#define PSYCOPG_DICTROW_H 1
+
+#include <Python.h>
+
+#include "psycopg/config.h"
+#include "psycopg/cursor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern HIDDEN PyTypeObject dictrowType;
+extern HIDDEN PyTypeObject realdictrowType;
+
+/* a list whose items can be accessed by column name too */
+typedef struct {
+    PyListObject list;
+
+    PyObject *index;        /* column name -> position, shared */
+} dictrowObject;
+
+/* a dict of the row values, keyed by column name */
+typedef struct {
+    PyDictObject dict;
+
+    PyObject *names;        /* the column names, shared */
+} realdictrowObject;
+
+/* how the rows of a row_factory can be built by the fetch methods */
+#define ROW_KIND_CALL      0    /* call the factory and fill the sequence */
+#define ROW_KIND_DICT      1    /* a DictRow */
+#define ROW_KIND_REALDICT  2    /* a RealDictRow */
+#define ROW_KIND_RECORD    3    /* a namedtuple class */
+#define ROW_KIND_RECORD_NEW 4   /* a namedtuple class to call with values */
+
+HIDDEN int dictrow_kind(PyObject *factory);
+HIDDEN PyObject *dictrow_new(cursorObject *curs, Py_ssize_t n);
+HIDDEN PyObject *realdictrow_new(cursorObject *curs, PyObject *values);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !defined(PSYCOPG_DICTROW_H) */
@@ -0,0 +1,726 @@
+/* dictrow_type.c - python interface to the dictionary-like row objects
+ *
+ * Copyright (C) 2010 Federico Di Gregorio <fog@debian.org>
+ *
+ * This file is part of psycopg.
+ *
+ * psycopg2 is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link this program with the OpenSSL library (or with
+ * modified versions of OpenSSL that use the same license as OpenSSL),
+ * and distribute linked combinations including the two.
+ *
+ * You must obey the GNU Lesser General Public License in all respects for
+ * all of the code used other than OpenSSL.
+ *
+ * psycopg2 is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <structmember.h>
+#include <string.h>
+
+#define PSYCOPG_MODULE
+#include "psycopg/config.h"
+#include "psycopg/python.h"
+#include "psycopg/psycopg.h"
+#include "psycopg/dictrow.h"
+#include "psycopg/cursor.h"
+#include "psycopg/pqpath.h"
+
+
+#ifdef PSYCOPG_EXTENSIONS
+
+/** the column maps shared by the rows **/
+
+/* make sure the cursor has the column maps of its current description
+
+   The maps are rebuilt only when the description changes: the results
+   with the same shape found in the connection cache share them too. */
+
+static int
+_dictrow_index(cursorObject *curs)
+{
+    PyObject *index = NULL, *names = NULL, *name, *pos;
+    Py_ssize_t i, n;
+
+    if (0 > pq_fetch_description(curs)) { return -1; }
+    if (curs->row_index && curs->row_desc == curs->description) {
+        return 0;
+    }
+
+    n = PyTuple_Check(curs->description) ?
+        PyTuple_GET_SIZE(curs->description) : 0;
+    if (!(index = PyDict_New())) goto error;
+    if (!(names = PyTuple_New(n))) goto error;
+
+    for (i = 0; i < n; i++) {
+        name = PyTuple_GET_ITEM(PyTuple_GET_ITEM(curs->description, i), 0);
+        Py_INCREF(name);
+        PyTuple_SET_ITEM(names, i, name);
+
+        if (!(pos = PyInt_FromSsize_t(i))) goto error;
+        if (0 > PyDict_SetItem(index, name, pos)) {
+            Py_DECREF(pos);
+            goto error;
+        }
+        Py_DECREF(pos);
+    }
+
+    Dprintf("_dictrow_index: built index of %d columns", (int)n);
+    Py_XDECREF(curs->row_index);
+    curs->row_index = index;
+    Py_XDECREF(curs->row_names);
+    curs->row_names = names;
+    Py_INCREF(curs->description);
+    Py_XDECREF(curs->row_desc);
+    curs->row_desc = curs->description;
+    return 0;
+
+error:
+    Py_XDECREF(index);
+    Py_XDECREF(names);
+    return -1;
+}
+
+/* return the class in the mro of type defining the attribute name */
+
+static PyObject *
+_dictrow_lookup_owner(PyTypeObject *type, PyObject *name)
+{
+    Py_ssize_t i;
+    PyObject *base, *dict;
+
+    if (!type->tp_mro) { return NULL; }
+    for (i = 0; i < PyTuple_GET_SIZE(type->tp_mro); i++) {
+        base = PyTuple_GET_ITEM(type->tp_mro, i);
+        if (PyType_Check(base)
+                && (dict = ((PyTypeObject *)base)->tp_dict)
+                && PyDict_GetItem(dict, name)) {
+            return base;
+        }
+    }
+    return NULL;
+}
+
+/* dictrow_kind - return how the rows of a row_factory can be built */
+
+int
+dictrow_kind(PyObject *factory)
+{
+    static PyObject *fields = NULL, *new = NULL;
+    PyTypeObject *type;
+    PyObject *owner;
+
+    if (factory == (PyObject *)&dictrowType) { return ROW_KIND_DICT; }
+    if (factory == (PyObject *)&realdictrowType) { return ROW_KIND_REALDICT; }
+
+    /* a namedtuple class can be filled as a plain tuple: it doesn't add
+       any storage to it and its __new__ only packs its arguments */
+    if (!PyType_Check(factory)) { return ROW_KIND_CALL; }
+    type = (PyTypeObject *)factory;
+    if (!PyType_IsSubtype(type, &PyTuple_Type)) { return ROW_KIND_CALL; }
+
+    if (!fields && !(fields = PyString_InternFromString("_fields"))) {
+        PyErr_Clear();
+        return ROW_KIND_CALL;
+    }
+    if (!new && !(new = PyString_InternFromString("__new__"))) {
+        PyErr_Clear();
+        return ROW_KIND_CALL;
+    }
+    if (!(owner = _dictrow_lookup_owner(type, fields))) {
+        return ROW_KIND_CALL;
+    }
+
+    /* a subclass adding storage or overriding __new__ or __init__ must be
+       called with the values */
+    if (type->tp_basicsize != PyTuple_Type.tp_basicsize
+            || type->tp_dictoffset != 0
+            || type->tp_init != PyBaseObject_Type.tp_init) {
+        return ROW_KIND_RECORD_NEW;
+    }
+    return (owner == _dictrow_lookup_owner(type, new))
+        ? ROW_KIND_RECORD : ROW_KIND_RECORD_NEW;
+}
+
+
+/** DictRow **/
+
+static int
+dictrow_setup(dictrowObject *self, cursorObject *curs, Py_ssize_t n)
+{
+    if (0 > _dictrow_index(curs)) { return -1; }
+    Py_INCREF(curs->row_index);
+    self->index = curs->row_index;
+
+    if (n > 0) {
+        if (!(self->list.ob_item = PyMem_New(PyObject *, n))) {
+            PyErr_NoMemory();
+            return -1;
+        }
+        memset(self->list.ob_item, 0, n * sizeof(PyObject *));
+        Py_SIZE(self) = n;
+        self->list.allocated = n;
+    }
+    return 0;
+}
+
+/* dictrow_new - return a DictRow of n items, all NULL */
+
+PyObject *
+dictrow_new(cursorObject *curs, Py_ssize_t n)
+{
+    dictrowObject *self;
+
+    if (!(self = (dictrowObject *)dictrowType.tp_alloc(&dictrowType, 0))) {
+        return NULL;
+    }
+    if (0 > dictrow_setup(self, curs, n)) {
+        Py_DECREF(self);
+        return NULL;
+    }
+    return (PyObject *)self;
+}
+
+/* return a borrowed reference to the position of a column name */
+
+static PyObject *
+dictrow_position(dictrowObject *self, PyObject *key)
+{
+    PyObject *pos;
+
+    if (!(pos = PyDict_GetItem(self->index, key))) {
+        PyErr_SetObject(PyExc_KeyError, key);
+    }
+    return pos;
+}
+
+static PyObject *
+dictrow_subscript(dictrowObject *self, PyObject *key)
+{
+    PyObject *pos;
+
+    if (PyIndex_Check(key) || PySlice_Check(key)) {
+        return PyList_Type.tp_as_mapping->mp_subscript((PyObject *)self, key);
+    }
+    if (!(pos = dictrow_position(self, key))) { return NULL; }
+    return PyList_Type.tp_as_mapping->mp_subscript((PyObject *)self, pos);
+}
+
+static int
+dictrow_ass_subscript(dictrowObject *self, PyObject *key, PyObject *value)
+{
+    PyObject *pos;
+
+    if (PyIndex_Check(key) || PySlice_Check(key)) {
+        return PyList_Type.tp_as_mapping->mp_ass_subscript(
+            (PyObject *)self, key, value);
+    }
+    if (!(pos = dictrow_position(self, key))) { return -1; }
+    return PyList_Type.tp_as_mapping->mp_ass_subscript(
+        (PyObject *)self, pos, value);
+}
+
+static int
+dictrow_contains(dictrowObject *self, PyObject *key)
+{
+    return PyDict_Contains(self->index, key);
+}
+
+static PySequenceMethods dictrow_sequence = {
+    0,          /* sq_length */
+    0,          /* sq_concat */
+    0,          /* sq_repeat */
+    0,          /* sq_item */
+    0,          /* sq_slice */
+    0,          /* sq_ass_item */
+    0,          /* sq_ass_slice */
+    (objobjproc)dictrow_contains, /* sq_contains */
+};
+
+static PyMappingMethods dictrow_mapping = {
+    0,                                      /* mp_length */
+    (binaryfunc)dictrow_subscript,          /* mp_subscript */
+    (objobjargproc)dictrow_ass_subscript,   /* mp_ass_subscript */
+};
+
+
+/* DictRow methods */
+
+#define psyco_dictrow_keys_doc \
+"keys() -> list of the column names"
+
+static PyObject *
+psyco_dictrow_keys(dictrowObject *self, PyObject *args)
+{
+    return PyDict_Keys(self->index);
+}
+
+#define psyco_dictrow_values_doc \
+"values() -> tuple of the values of the row"
+
+static PyObject *
+psyco_dictrow_values(dictrowObject *self, PyObject *args)
+{
+    return PyList_AsTuple((PyObject *)self);
+}
+
+#define psyco_dictrow_items_doc \
+"items() -> list of (column name, value) pairs"
+
+static PyObject *
+psyco_dictrow_items(dictrowObject *self, PyObject *args)
+{
+    PyObject *rv, *key, *pos, *val, *item;
+    Py_ssize_t i = 0, n;
+
+    if (!(rv = PyList_New(0))) { return NULL; }
+
+    while (PyDict_Next(self->index, &i, &key, &pos)) {
+        n = PyInt_AsSsize_t(pos);
+        if (!(val = PyList_GetItem((PyObject *)self, n))) { goto error; }
+        if (!(item = PyTuple_Pack(2, key, val))) { goto error; }
+        if (0 > PyList_Append(rv, item)) {
+            Py_DECREF(item);
+            goto error;
+        }
+        Py_DECREF(item);
+    }
+    return rv;
+
+error:
+    Py_DECREF(rv);
+    return NULL;
+}
+
+#define psyco_dictrow_has_key_doc \
+"has_key(name) -> True if the row has a column called `name`"
+
+static PyObject *
+psyco_dictrow_has_key(dictrowObject *self, PyObject *key)
+{
+    int rv;
+
+    if (-1 == (rv = PyDict_Contains(self->index, key))) { return NULL; }
+    return PyBool_FromLong(rv);
+}
+
+#define psyco_dictrow_get_doc \
+"get(key, default=None) -> the value of a column by name or position"
+
+static PyObject *
+psyco_dictrow_get(dictrowObject *self, PyObject *args)
+{
+    PyObject *key, *dflt = Py_None, *rv;
+
+    if (!PyArg_ParseTuple(args, "O|O", &key, &dflt)) { return NULL; }
+
+    if (!(rv = PyObject_GetItem((PyObject *)self, key))) {
+        if (!PyErr_ExceptionMatches(PyExc_LookupError)
+                && !PyErr_ExceptionMatches(PyExc_TypeError)) {
+            return NULL;
+        }
+        PyErr_Clear();
+        Py_INCREF(dflt);
+        rv = dflt;
+    }
+    return rv;
+}
+
+#define psyco_dictrow_iteritems_doc \
+"iteritems() -> an iterator over the (column name, value) pairs"
+
+static PyObject *
+psyco_dictrow_iteritems(dictrowObject *self, PyObject *args)
+{
+    PyObject *items, *rv;
+
+    if (!(items = psyco_dictrow_items(self, NULL))) { return NULL; }
+    rv = PyObject_GetIter(items);
+    Py_DECREF(items);
+    return rv;
+}
+
+#define psyco_dictrow_iterkeys_doc \
+"iterkeys() -> an iterator over the column names"
+
+static PyObject *
+psyco_dictrow_iterkeys(dictrowObject *self, PyObject *args)
+{
+    return PyObject_GetIter(self->index);
+}
+
+#define psyco_dictrow_itervalues_doc \
+"itervalues() -> an iterator over the values of the row"
+
+static PyObject *
+psyco_dictrow_itervalues(dictrowObject *self, PyObject *args)
+{
+    return PyList_Type.tp_iter((PyObject *)self);
+}
+
+#define psyco_dictrow_copy_doc \
+"copy() -> dict mapping the column names to the values"
+
+static PyObject *
+psyco_dictrow_copy(dictrowObject *self, PyObject *args)
+{
+    PyObject *items, *rv = NULL;
+
+    if (!(items = psyco_dictrow_items(self, NULL))) { return NULL; }
+    if ((rv = PyDict_New())) {
+        if (0 > PyDict_MergeFromSeq2(rv, items, 1)) {
+            Py_CLEAR(rv);
+        }
+    }
+    Py_DECREF(items);
+    return rv;
+}
+
+static struct PyMethodDef dictrowObject_methods[] = {
+    {"keys", (PyCFunction)psyco_dictrow_keys,
+     METH_NOARGS, psyco_dictrow_keys_doc},
+    {"values", (PyCFunction)psyco_dictrow_values,
+     METH_NOARGS, psyco_dictrow_values_doc},
+    {"items", (PyCFunction)psyco_dictrow_items,
+     METH_NOARGS, psyco_dictrow_items_doc},
+    {"has_key", (PyCFunction)psyco_dictrow_has_key,
+     METH_O, psyco_dictrow_has_key_doc},
+    {"get", (PyCFunction)psyco_dictrow_get,
+     METH_VARARGS, psyco_dictrow_get_doc},
+    {"iteritems", (PyCFunction)psyco_dictrow_iteritems,
+     METH_NOARGS, psyco_dictrow_iteritems_doc},
+    {"iterkeys", (PyCFunction)psyco_dictrow_iterkeys,
+     METH_NOARGS, psyco_dictrow_iterkeys_doc},
+    {"itervalues", (PyCFunction)psyco_dictrow_itervalues,
+     METH_NOARGS, psyco_dictrow_itervalues_doc},
+    {"copy", (PyCFunction)psyco_dictrow_copy,
+     METH_NOARGS, psyco_dictrow_copy_doc},
+    {NULL}
+};
+
+static struct PyMemberDef dictrowObject_members[] = {
+    {"_index", T_OBJECT, offsetof(dictrowObject, index), READONLY},
+    {NULL}
+};
+
+/* initialization and finalization methods */
+
+static PyObject *
+dictrow_new_py(PyTypeObject *type, PyObject *args, PyObject *kwargs)
+{
+    cursorObject *curs;
+    PyObject *self;
+    Py_ssize_t i;
+
+    if (!PyArg_ParseTuple(args, "O!", &cursorType, &curs)) { return NULL; }
+    if (0 > pq_fetch_description(curs)) { return NULL; }
+
+    if (!(self = type->tp_alloc(type, 0))) { return NULL; }
+    if (0 > dictrow_setup((dictrowObject *)self, curs,
+            PyTuple_Check(curs->description) ?
+                PyTuple_GET_SIZE(curs->description) : 0)) {
+        Py_DECREF(self);
+        return NULL;
+    }
+    for (i = 0; i < Py_SIZE(self); i++) {
+        Py_INCREF(Py_None);
+        PyList_SET_ITEM(self, i, Py_None);
+    }
+    return self;
+}
+
+/* the cursor is consumed by __new__: list.__init__ would iterate on it */
+
+static int
+dictrow_init(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    return 0;
+}
+
+static int
+dictrow_traverse(dictrowObject *self, visitproc visit, void *arg)
+{
+    Py_VISIT(self->index);
+    return PyList_Type.tp_traverse((PyObject *)self, visit, arg);
+}
+
+static int
+dictrow_clear(dictrowObject *self)
+{
+    Py_CLEAR(self->index);
+    return PyList_Type.tp_clear((PyObject *)self);
+}
+
+static void
+dictrow_dealloc(PyObject* obj)
+{
+    Py_CLEAR(((dictrowObject *)obj)->index);
+    PyList_Type.tp_dealloc(obj);
+}
+
+
+#define dictrowType_doc \
+"A row object that allow by-column-name access to data."
+
+PyTypeObject dictrowType = {
+    PyObject_HEAD_INIT(NULL)
+    0,
+    "psycopg2.extras.DictRow",
+    sizeof(dictrowObject),
+    0,
+    dictrow_dealloc, /*tp_dealloc*/
+    0,          /*tp_print*/
+    0,          /*tp_getattr*/
+    0,          /*tp_setattr*/
+    0,          /*tp_compare*/
+    0,          /*tp_repr*/
+    0,          /*tp_as_number*/
+    &dictrow_sequence, /*tp_as_sequence*/
+    &dictrow_mapping, /*tp_as_mapping*/
+    0,          /*tp_hash */
+
+    0,          /*tp_call*/
+    0,          /*tp_str*/
+    0,          /*tp_getattro*/
+    0,          /*tp_setattro*/
+    0,          /*tp_as_buffer*/
+
+    Py_TPFLAGS_DEFAULT|Py_TPFLAGS_BASETYPE|Py_TPFLAGS_HAVE_GC,
+                /*tp_flags*/
+    dictrowType_doc, /*tp_doc*/
+
+    (traverseproc)dictrow_traverse, /*tp_traverse*/
+    (inquiry)dictrow_clear, /*tp_clear*/
+
+    0,          /*tp_richcompare*/
+    0,          /*tp_weaklistoffset*/
+
+    0,          /*tp_iter*/
+    0,          /*tp_iternext*/
+
+    /* Attribute descriptor and subclassing stuff */
+
+    dictrowObject_methods, /*tp_methods*/
+    dictrowObject_members, /*tp_members*/
+    0,          /*tp_getset*/
+    0,          /*tp_base: PyList_Type, set at module init*/
+    0,          /*tp_dict*/
+
+    0,          /*tp_descr_get*/
+    0,          /*tp_descr_set*/
+    0,          /*tp_dictoffset*/
+
+    dictrow_init, /*tp_init*/
+    0,          /*tp_alloc*/
+    dictrow_new_py, /*tp_new*/
+};
+
+
+/** RealDictRow **/
+
+static int
+realdictrow_setup(realdictrowObject *self, cursorObject *curs)
+{
+    if (0 > _dictrow_index(curs)) { return -1; }
+    Py_INCREF(curs->row_names);
+    self->names = curs->row_names;
+    return 0;
+}
+
+/* realdictrow_new - return a RealDictRow with the values of a tuple */
+
+PyObject *
+realdictrow_new(cursorObject *curs, PyObject *values)
+{
+    realdictrowObject *self;
+    Py_ssize_t i, n;
+
+    /* dict_new sets up the hash table; it doesn't use its arguments */
+    if (!(self = (realdictrowObject *)PyDict_Type.tp_new(
+            &realdictrowType, NULL, NULL))) {
+        return NULL;
+    }
+    if (0 > realdictrow_setup(self, curs)) { goto error; }
+
+    n = PyTuple_GET_SIZE(values);
+    if (n > PyTuple_GET_SIZE(self->names)) {
+        n = PyTuple_GET_SIZE(self->names);
+    }
+    for (i = 0; i < n; i++) {
+        if (0 > PyDict_SetItem((PyObject *)self,
+                PyTuple_GET_ITEM(self->names, i),
+                PyTuple_GET_ITEM(values, i))) {
+            goto error;
+        }
+    }
+    return (PyObject *)self;
+
+error:
+    Py_DECREF(self);
+    return NULL;
+}
+
+/* set an item by column name or, if an int, by column position */
+
+static int
+realdictrow_ass_item(realdictrowObject *self, Py_ssize_t i, PyObject *value)
+{
+    if (i < 0 || i >= PyTuple_GET_SIZE(self->names)) {
+        PyErr_SetString(PyExc_IndexError, "column index out of range");
+        return -1;
+    }
+    return PyDict_Type.tp_as_mapping->mp_ass_subscript((PyObject *)self,
+        PyTuple_GET_ITEM(self->names, i), value);
+}
+
+static int
+realdictrow_ass_subscript(realdictrowObject *self, PyObject *key,
+                          PyObject *value)
+{
+    Py_ssize_t i;
+
+    if (PyInt_CheckExact(key)) {
+        i = PyInt_AS_LONG(key);
+        if (i < 0) { i += PyTuple_GET_SIZE(self->names); }
+        return realdictrow_ass_item(self, i, value);
+    }
+    return PyDict_Type.tp_as_mapping->mp_ass_subscript(
+        (PyObject *)self, key, value);
+}
+
+static PySequenceMethods realdictrow_sequence = {
+    0,          /* sq_length */
+    0,          /* sq_concat */
+    0,          /* sq_repeat */
+    0,          /* sq_item */
+    0,          /* sq_slice */
+    (ssizeobjargproc)realdictrow_ass_item, /* sq_ass_item */
+};
+
+static PyMappingMethods realdictrow_mapping = {
+    0,                                          /* mp_length */
+    0,                                          /* mp_subscript */
+    (objobjargproc)realdictrow_ass_subscript,   /* mp_ass_subscript */
+};
+
+static struct PyMemberDef realdictrowObject_members[] = {
+    {"_column_mapping", T_OBJECT, offsetof(realdictrowObject, names),
+        READONLY},
+    {NULL}
+};
+
+/* initialization and finalization methods */
+
+static PyObject *
+realdictrow_new_py(PyTypeObject *type, PyObject *args, PyObject *kwargs)
+{
+    cursorObject *curs;
+    PyObject *self;
+
+    if (!PyArg_ParseTuple(args, "O!", &cursorType, &curs)) { return NULL; }
+
+    if (!(self = PyDict_Type.tp_new(type, args, kwargs))) { return NULL; }
+    if (0 > realdictrow_setup((realdictrowObject *)self, curs)) {
+        Py_DECREF(self);
+        return NULL;
+    }
+    return self;
+}
+
+/* the cursor is consumed by __new__: dict.__init__ would iterate on it */
+
+static int
+realdictrow_init(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    return 0;
+}
+
+static int
+realdictrow_traverse(realdictrowObject *self, visitproc visit, void *arg)
+{
+    Py_VISIT(self->names);
+    return PyDict_Type.tp_traverse((PyObject *)self, visit, arg);
+}
+
+static int
+realdictrow_clear(realdictrowObject *self)
+{
+    Py_CLEAR(self->names);
+    return PyDict_Type.tp_clear((PyObject *)self);
+}
+
+static void
+realdictrow_dealloc(PyObject* obj)
+{
+    Py_CLEAR(((realdictrowObject *)obj)->names);
+    PyDict_Type.tp_dealloc(obj);
+}
+
+
+#define realdictrowType_doc \
+"A ``dict`` subclass representing a data record."
+
+PyTypeObject realdictrowType = {
+    PyObject_HEAD_INIT(NULL)
+    0,
+    "psycopg2.extras.RealDictRow",
+    sizeof(realdictrowObject),
+    0,
+    realdictrow_dealloc, /*tp_dealloc*/
+    0,          /*tp_print*/
+    0,          /*tp_getattr*/
+    0,          /*tp_setattr*/
+    0,          /*tp_compare*/
+    0,          /*tp_repr*/
+    0,          /*tp_as_number*/
+    &realdictrow_sequence, /*tp_as_sequence*/
+    &realdictrow_mapping, /*tp_as_mapping*/
+    0,          /*tp_hash */
+
+    0,          /*tp_call*/
+    0,          /*tp_str*/
+    0,          /*tp_getattro*/
+    0,          /*tp_setattro*/
+    0,          /*tp_as_buffer*/
+
+    Py_TPFLAGS_DEFAULT|Py_TPFLAGS_BASETYPE|Py_TPFLAGS_HAVE_GC,
+                /*tp_flags*/
+    realdictrowType_doc, /*tp_doc*/
+
+    (traverseproc)realdictrow_traverse, /*tp_traverse*/
+    (inquiry)realdictrow_clear, /*tp_clear*/
+
+    0,          /*tp_richcompare*/
+    0,          /*tp_weaklistoffset*/
+
+    0,          /*tp_iter*/
+    0,          /*tp_iternext*/
+
+    /* Attribute descriptor and subclassing stuff */
+
+    0,          /*tp_methods*/
+    realdictrowObject_members, /*tp_members*/
+    0,          /*tp_getset*/
+    0,          /*tp_base: PyDict_Type, set at module init*/
+    0,          /*tp_dict*/
+
+    0,          /*tp_descr_get*/
+    0,          /*tp_descr_set*/
+    0,          /*tp_dictoffset*/
+
+    realdictrow_init, /*tp_init*/
+    0,          /*tp_alloc*/
+    realdictrow_new_py, /*tp_new*/
+};
+
+#endif
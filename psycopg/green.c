@@ -33,16 +33,36 @@
 
 HIDDEN PyObject *wait_callback = NULL;
 
+/* how the wait callback is called */
+#define WAIT_CALL_CONN  0   /* f(conn) */
+#define WAIT_CALL_FD    1   /* f(fd, events), polling in C */
+#define WAIT_NATIVE     2   /* wait_poll(): no Python call at all */
+static int wait_mode = WAIT_CALL_CONN;
+
 static PyObject *have_wait_callback(void);
 static void psyco_clear_result_blocking(connectionObject *conn);
+static PGresult *psyco_wait_last_result(connectionObject *conn);
 
 /* Register a callback function to block waiting for data.
  *
  * The function is exported by the _psycopg module.
  */
 PyObject *
-psyco_set_wait_callback(PyObject *self, PyObject *obj)
+psyco_set_wait_callback(PyObject *self, PyObject *args, PyObject *kwargs)
 {
+    PyObject *obj, *pyfd = Py_False;
+    int fd;
+
+    static char *kwlist[] = {"f", "fd", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|O", kwlist,
+            &obj, &pyfd)) {
+        return NULL;
+    }
+    if ((fd = PyObject_IsTrue(pyfd)) < 0) {
+        return NULL;
+    }
+
     Py_XDECREF(wait_callback);
 
     if (obj != Py_None) {
@@ -53,6 +73,14 @@ psyco_set_wait_callback(PyObject *self, PyObject *obj)
         wait_callback = NULL;
     }
 
+    if (PyCFunction_Check(obj)
+            && PyCFunction_GET_FUNCTION(obj) == (PyCFunction)psyco_wait_poll) {
+        wait_mode = WAIT_NATIVE;
+    }
+    else {
+        wait_mode = fd ? WAIT_CALL_FD : WAIT_CALL_CONN;
+    }
+
     Py_INCREF(Py_None);
     return Py_None;
 }
@@ -108,6 +136,75 @@ have_wait_callback()
     return cb;
 }
 
+/* Run the poll loop of a connection in C.
+ *
+ * If cb is NULL block in poll() with the GIL released, else call
+ * cb(fd, events) every time the connection would block.
+ *
+ * Return 0 on success, else -1 and set a Python exception.
+ */
+static int
+psyco_wait_loop(connectionObject *conn, PyObject *cb)
+{
+    PyObject *rv;
+    int res;
+
+    for (;;) {
+        switch (res = conn_poll(conn)) {
+        case PSYCO_POLL_OK:
+            return 0;
+
+        case PSYCO_POLL_READ:
+        case PSYCO_POLL_WRITE:
+            if (cb) {
+                rv = PyObject_CallFunction(cb, "ii",
+                    (int)PQsocket(conn->pgconn), res);
+                if (!rv) { return -1; }
+                Py_DECREF(rv);
+            }
+            else if (0 > conn_poll_wait(&conn, &res, 1, -1)) {
+                /* interrupted: don't wait for the query in the cleanup */
+                if (conn->cancel) {
+                    char errbuf[256];
+                    PQcancel(conn->cancel, errbuf, sizeof(errbuf));
+                }
+                return -1;
+            }
+            break;
+
+        default:
+            if (!PyErr_Occurred()) {
+                PyErr_SetString(OperationalError,
+                    PQerrorMessage(conn->pgconn));
+            }
+            return -1;
+        }
+    }
+}
+
+/* Wait until a connection has data available, polling in C.
+ *
+ * The function is exported by the _psycopg module.
+ */
+PyObject *
+psyco_wait_poll(PyObject *self, PyObject *obj)
+{
+    if (!PyObject_TypeCheck(obj, &connectionType)) {
+        PyErr_SetString(PyExc_TypeError, "argument must be a connection");
+        return NULL;
+    }
+    if (((connectionObject *)obj)->closed) {
+        PyErr_SetString(InterfaceError, "connection already closed");
+        return NULL;
+    }
+    if (0 > psyco_wait_loop((connectionObject *)obj, NULL)) {
+        return NULL;
+    }
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
 /* Block waiting for data available in an async connection.
  *
  * This function assumes `wait_callback` to be available:
@@ -121,22 +218,33 @@ psyco_wait(connectionObject *conn)
 {
     PyObject *rv;
     PyObject *cb;
+    int ret;
 
     Dprintf("psyco_wait");
     if (!(cb = have_wait_callback())) {
         return -1;
     }
 
-    rv = PyObject_CallFunctionObjArgs(cb, conn, NULL);
+    switch (wait_mode) {
+    case WAIT_NATIVE:
+        ret = psyco_wait_loop(conn, NULL);
+        break;
+
+    case WAIT_CALL_FD:
+        ret = psyco_wait_loop(conn, cb);
+        break;
+
+    default:
+        rv = PyObject_CallFunctionObjArgs(cb, conn, NULL);
+        ret = rv ? 0 : -1;
+        Py_XDECREF(rv);
+    }
     Py_DECREF(cb);
 
-    if (NULL != rv) {
-        Py_DECREF(rv);
-        return 0;
-    } else {
+    if (ret < 0) {
         Dprintf("psyco_wait: error in wait callback");
-        return -1;
     }
+    return ret;
 }
 
 /* Replacement for PQexec using the user-provided wait function.
@@ -150,13 +258,73 @@ psyco_wait(connectionObject *conn)
 PGresult *
 psyco_exec_green(connectionObject *conn, const char *command)
 {
-    PGresult *result = NULL;
+    return psyco_exec_green_params(conn, command, NULL);
+}
 
+/* Replacement for PQexecParams using the user-provided wait function.
+ *
+ * Same as psyco_exec_green() but passing out-of-line parameters, if any. */
+PGresult *
+psyco_exec_green_params(connectionObject *conn, const char *command,
+                        const pqParams *params)
+{
     /* Send the query asynchronously */
-    if (0 == pq_send_query(conn, command)) {
-        goto end;
+    if (0 == pq_send_query_params(conn, command, params)) {
+        conn->async_status = ASYNC_DONE;
+        return NULL;
     }
 
+    return psyco_wait_last_result(conn);
+}
+
+/* Replacement for PQprepare using the user-provided wait function.
+ *
+ * Same as psyco_exec_green() but preparing a statement. */
+PGresult *
+psyco_prepare_green(connectionObject *conn, const char *name,
+                    const char *command, const pqParams *params)
+{
+    if (0 == pq_send_prepare(conn, name, command, params)) {
+        conn->async_status = ASYNC_DONE;
+        return NULL;
+    }
+
+    return psyco_wait_last_result(conn);
+}
+
+/* Replacement for PQgetResult using the user-provided wait function.
+ *
+ * Return the next result of the command being executed or NULL if there
+ * are no more: in this case check `PyErr_Occurred()` to know if the wait
+ * callback failed. After sending the command the caller should set the
+ * connection async_status to ASYNC_WRITE.
+ *
+ * The function should be called helding the connection lock and the GIL.
+ */
+PGresult *
+psyco_get_result_green(connectionObject *conn)
+{
+    if (conn->async_status == ASYNC_WRITE || PQisBusy(conn->pgconn)) {
+        if (conn->async_status != ASYNC_WRITE) {
+            conn->async_status = ASYNC_READ;
+        }
+        if (0 != psyco_wait(conn)) {
+            psyco_clear_result_blocking(conn);
+            conn->async_status = ASYNC_DONE;
+            return NULL;
+        }
+    }
+
+    conn->async_status = ASYNC_DONE;
+    return PQgetResult(conn->pgconn);
+}
+
+/* Wait for the result of the command just sent and return it. */
+static PGresult *
+psyco_wait_last_result(connectionObject *conn)
+{
+    PGresult *result = NULL;
+
     /* Enter the poll loop with a write. When writing is finished the poll
        implementation will set the status to ASYNC_READ without exiting the
        loop. If read is finished the status is finally set to ASYNC_DONE.
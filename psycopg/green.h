@@ -28,6 +28,7 @@
 
 #include <libpq-fe.h>
 #include "psycopg/connection.h"
+#include "psycopg/pqpath.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -41,6 +42,12 @@ extern "C" {
 "libpq is called.  Use `!set_wait_callback(None)` to revert to the\n" \
 "original behaviour (i.e. using blocking libpq functions).\n" \
 "\n" \
+"If *fd* is True the callback should have signature\n" \
+":samp:`fun({fd}, {events})` instead: Psycopg polls the connection and\n" \
+"calls it only to wait for the file descriptor *fd* to be ready for\n" \
+"`POLL_READ` or `POLL_WRITE`, as specified by *events*.  Register\n" \
+"`wait_poll()` to wait without calling Python code at all.\n" \
+"\n" \
 "The function is an hook to allow coroutine-based libraries (such as\n" \
 "Eventlet_ or gevent_) to switch when Psycopg is blocked, allowing\n" \
 "other coroutines to run concurrently.\n" \
@@ -50,7 +57,8 @@ extern "C" {
 "\n" \
 ".. _Eventlet: http://eventlet.net/\n" \
 ".. _gevent: http://www.gevent.org/\n"
-HIDDEN PyObject *psyco_set_wait_callback(PyObject *self, PyObject *obj);
+HIDDEN PyObject *psyco_set_wait_callback(PyObject *self, PyObject *args,
+                                         PyObject *kwargs);
 
 #define psyco_get_wait_callback_doc \
 "Return the currently registered wait callback.\n" \
@@ -58,9 +66,23 @@ HIDDEN PyObject *psyco_set_wait_callback(PyObject *self, PyObject *obj);
 "Return `None` if no callback is currently registered.\n"
 HIDDEN PyObject *psyco_get_wait_callback(PyObject *self, PyObject *obj);
 
+#define psyco_wait_poll_doc \
+"wait_poll(conn) -- Wait until a connection has data available.\n" \
+"\n" \
+"A wait callback blocking in ``poll()``, implemented in C.  When it is\n" \
+"registered with `set_wait_callback()` no Python code is called to wait.\n"
+HIDDEN PyObject *psyco_wait_poll(PyObject *self, PyObject *obj);
+
 HIDDEN int psyco_green(void);
 HIDDEN int psyco_wait(connectionObject *conn);
 HIDDEN PGresult *psyco_exec_green(connectionObject *conn, const char *command);
+HIDDEN PGresult *psyco_exec_green_params(connectionObject *conn,
+                                         const char *command,
+                                         const pqParams *params);
+HIDDEN PGresult *psyco_get_result_green(connectionObject *conn);
+HIDDEN PGresult *psyco_prepare_green(connectionObject *conn, const char *name,
+                                     const char *command,
+                                     const pqParams *params);
 
 #define EXC_IF_GREEN(cmd) \
 if (psyco_green()) {   \
@@ -0,0 +1,76 @@
+/* lazyrow.h - definition for the lazy row objects
+ *
+ * Copyright (C) 2010 Federico Di Gregorio <fog@debian.org>
+ *
+ * This file is part of psycopg.
+ *
+ * psycopg2 is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link this program with the OpenSSL library (or with
+ * modified versions of OpenSSL that use the same license as OpenSSL),
+ * and distribute linked combinations including the two.
+ *
+ * You must obey the GNU Lesser General Public License in all respects for
+ * all of the code used other than OpenSSL.
+ *
+ * psycopg2 is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ */
+
+#ifndef PSYCOPG_LAZYROW_H
+#define PSYCOPG_LAZYROW_H 1
+
+#include <Python.h>
+#include <libpq-fe.h>
+
+#include "psycopg/config.h"
+#include "psycopg/cursor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern HIDDEN PyTypeObject lazyresultType;
+extern HIDDEN PyTypeObject lazyrowType;
+
+/* a query result shared by its lazy rows */
+typedef struct {
+    PyObject_HEAD
+
+    PGresult *pgres;        /* the result, cleared on dealloc */
+    PyObject *casts;        /* the typecasters of the columns */
+    PyObject *index;        /* column name -> position, built on demand */
+    PyObject *owner;        /* if set, the result owning pgres instead */
+} lazyresultObject;
+
+/* a row decoding its values on first access */
+typedef struct {
+    PyObject_VAR_HEAD
+
+    lazyresultObject *result;   /* the result the row belongs to */
+    PyObject *cursor;           /* the cursor passed to the typecasters */
+    int row;                    /* the row number in the result */
+
+    PyObject *values[1];        /* the values decoded, NULL if not yet */
+} lazyrowObject;
+
+#ifdef PSYCOPG_EXTENSIONS
+#define lazyrow_CheckFactory(f) ((f) == (PyObject *)&lazyrowType)
+#else
+#define lazyrow_CheckFactory(f) 0
+#endif
+
+HIDDEN PyObject *lazyresult_share(cursorObject *curs);
+HIDDEN PyObject *lazyrow_new(cursorObject *curs, int row);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !defined(PSYCOPG_LAZYROW_H) */
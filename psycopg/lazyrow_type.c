@@ -0,0 +1,603 @@
+/* lazyrow_type.c - python interface to the lazy row objects
+ *
+ * Copyright (C) 2010 Federico Di Gregorio <fog@debian.org>
+ *
+ * This file is part of psycopg.
+ *
+ * psycopg2 is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link this program with the OpenSSL library (or with
+ * modified versions of OpenSSL that use the same license as OpenSSL),
+ * and distribute linked combinations including the two.
+ *
+ * You must obey the GNU Lesser General Public License in all respects for
+ * all of the code used other than OpenSSL.
+ *
+ * psycopg2 is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <structmember.h>
+#include <string.h>
+
+#define PSYCOPG_MODULE
+#include "psycopg/config.h"
+#include "psycopg/python.h"
+#include "psycopg/psycopg.h"
+#include "psycopg/lazyrow.h"
+#include "psycopg/cursor.h"
+#include "psycopg/typecast.h"
+
+
+#ifdef PSYCOPG_EXTENSIONS
+
+/** the shared result **/
+
+static void
+lazyresult_dealloc(PyObject* obj)
+{
+    lazyresultObject *self = (lazyresultObject *)obj;
+
+    if (self->owner) {
+        Py_DECREF(self->owner);
+    }
+    else if (self->pgres) {
+        PQclear(self->pgres);
+    }
+    Py_XDECREF(self->casts);
+    Py_XDECREF(self->index);
+
+    Dprintf("lazyresult_dealloc: deleted result at %p", obj);
+
+    PyObject_Del(obj);
+}
+
+/* return the map from the column names to their position */
+
+static PyObject *
+lazyresult_index(lazyresultObject *self)
+{
+    PyObject *index, *pos;
+    int i, n;
+
+    if (self->index) return self->index;
+
+    if (!(index = PyDict_New())) return NULL;
+
+    n = PQnfields(self->pgres);
+    for (i = 0; i < n; i++) {
+        if (!(pos = PyInt_FromLong(i))) goto error;
+        if (0 > PyDict_SetItemString(index, PQfname(self->pgres, i), pos)) {
+            Py_DECREF(pos);
+            goto error;
+        }
+        Py_DECREF(pos);
+    }
+
+    self->index = index;
+    return index;
+
+error:
+    Py_DECREF(index);
+    return NULL;
+}
+
+#define lazyresultType_doc \
+"A query result shared by its lazy rows."
+
+PyTypeObject lazyresultType = {
+    PyObject_HEAD_INIT(NULL)
+    0,
+    "psycopg2._psycopg.LazyResult",
+    sizeof(lazyresultObject),
+    0,
+    lazyresult_dealloc, /*tp_dealloc*/
+    0,          /*tp_print*/
+    0,          /*tp_getattr*/
+    0,          /*tp_setattr*/
+    0,          /*tp_compare*/
+    0,          /*tp_repr*/
+    0,          /*tp_as_number*/
+    0,          /*tp_as_sequence*/
+    0,          /*tp_as_mapping*/
+    0,          /*tp_hash */
+
+    0,          /*tp_call*/
+    0,          /*tp_str*/
+    0,          /*tp_getattro*/
+    0,          /*tp_setattro*/
+    0,          /*tp_as_buffer*/
+
+    Py_TPFLAGS_DEFAULT, /*tp_flags*/
+    lazyresultType_doc, /*tp_doc*/
+};
+
+
+/** C interface **/
+
+/* lazyresult_share - return the owner of the cursor result
+
+   The owner is created on first call and takes the ownership of the
+   PGresult, that will be cleared when both the cursor and all the objects
+   referencing the owner are done with it. Return a borrowed reference.
+
+   A result fetched from a ResultCache is already shared, but maybe with
+   the typecasters of another cursor: in this case the new owner only keeps
+   a reference to the original one. */
+
+PyObject *
+lazyresult_share(cursorObject *curs)
+{
+    lazyresultObject *result;
+    PyObject *owner = NULL;
+
+    if (curs->shared_result && curs->shared_pgres == curs->pgres
+            && ((lazyresultObject *)curs->shared_result)->casts
+                != curs->casts) {
+        owner = curs->shared_result;
+    }
+
+    if (curs->shared_result == NULL || curs->shared_pgres != curs->pgres
+            || owner) {
+        if (!(result = PyObject_New(lazyresultObject, &lazyresultType))) {
+            return NULL;
+        }
+        result->pgres = curs->pgres;
+        result->casts = curs->casts;
+        Py_XINCREF(result->casts);
+        result->index = NULL;
+        result->owner = owner;
+        Py_XINCREF(owner);
+
+        Py_XDECREF(curs->shared_result);
+        curs->shared_result = (PyObject *)result;
+        curs->shared_pgres = curs->pgres;
+        Dprintf("lazyresult_share: result %p shared by %p",
+            curs->pgres, result);
+    }
+    return curs->shared_result;
+}
+
+/* lazyrow_new - create a lazy row for a row of the cursor result */
+
+PyObject *
+lazyrow_new(cursorObject *curs, int row)
+{
+    lazyrowObject *self;
+    lazyresultObject *result;
+    int i, n;
+
+    if (!(result = (lazyresultObject *)lazyresult_share(curs))) {
+        return NULL;
+    }
+
+    n = PQnfields(curs->pgres);
+    if (!(self = PyObject_GC_NewVar(lazyrowObject, &lazyrowType, n))) {
+        return NULL;
+    }
+
+    Py_INCREF(result);
+    self->result = result;
+    Py_INCREF(curs);
+    self->cursor = (PyObject *)curs;
+    self->row = row;
+    for (i = 0; i < n; i++) {
+        self->values[i] = NULL;
+    }
+
+    PyObject_GC_Track(self);
+    return (PyObject *)self;
+}
+
+
+/** value access **/
+
+/* return a new reference to the i-th value, decoding it if needed */
+
+static PyObject *
+lazyrow_value(lazyrowObject *self, Py_ssize_t i)
+{
+    PGresult *pgres = self->result->pgres;
+    cursorObject *curs = (cursorObject *)self->cursor;
+    PyObject *owner;
+    const char *str;
+    Py_ssize_t len;
+
+    if (self->values[i] == NULL) {
+        if (PQgetisnull(pgres, self->row, (int)i)) {
+            str = NULL;
+            len = 0;
+        }
+        else {
+            str = PQgetvalue(pgres, self->row, (int)i);
+            len = PQgetlength(pgres, self->row, (int)i);
+        }
+
+        Dprintf("lazyrow_value: decoding row %d, column %d", self->row, (int)i);
+        /* the cursor may have moved to another result meanwhile */
+        owner = curs->cast_owner;
+        curs->cast_owner = (PyObject *)self->result;
+        self->values[i] = typecast_cast(
+            PyTuple_GET_ITEM(self->result->casts, i), str, len, self->cursor);
+        curs->cast_owner = owner;
+        if (self->values[i] == NULL) return NULL;
+    }
+
+    Py_INCREF(self->values[i]);
+    return self->values[i];
+}
+
+/* return a tuple with all the values of the row */
+
+static PyObject *
+lazyrow_tuple(lazyrowObject *self)
+{
+    PyObject *rv, *val;
+    Py_ssize_t i;
+
+    if (!(rv = PyTuple_New(Py_SIZE(self)))) return NULL;
+
+    for (i = 0; i < Py_SIZE(self); i++) {
+        if (!(val = lazyrow_value(self, i))) {
+            Py_DECREF(rv);
+            return NULL;
+        }
+        PyTuple_SET_ITEM(rv, i, val);
+    }
+
+    return rv;
+}
+
+static Py_ssize_t
+lazyrow_len(lazyrowObject *self)
+{
+    return Py_SIZE(self);
+}
+
+static PyObject *
+lazyrow_item(lazyrowObject *self, Py_ssize_t i)
+{
+    if (i < 0 || i >= Py_SIZE(self)) {
+        PyErr_SetString(PyExc_IndexError, "index out of range");
+        return NULL;
+    }
+    return lazyrow_value(self, i);
+}
+
+static PyObject *
+lazyrow_subscript(lazyrowObject *self, PyObject *key)
+{
+    PyObject *index, *pos, *tmp, *rv;
+    Py_ssize_t i;
+
+    if (PyIndex_Check(key)) {
+        if (-1 == (i = PyNumber_AsSsize_t(key, PyExc_IndexError))
+                && PyErr_Occurred()) {
+            return NULL;
+        }
+        if (i < 0) i += Py_SIZE(self);
+        return lazyrow_item(self, i);
+    }
+
+    if (PySlice_Check(key)) {
+        if (!(tmp = lazyrow_tuple(self))) return NULL;
+        rv = PyObject_GetItem(tmp, key);
+        Py_DECREF(tmp);
+        return rv;
+    }
+
+    if (!(index = lazyresult_index(self->result))) return NULL;
+    if (!(pos = PyDict_GetItem(index, key))) {
+        PyErr_SetObject(PyExc_KeyError, key);
+        return NULL;
+    }
+    return lazyrow_value(self, PyInt_AS_LONG(pos));
+}
+
+static int
+lazyrow_contains(lazyrowObject *self, PyObject *key)
+{
+    PyObject *index;
+
+    if (!(index = lazyresult_index(self->result))) return -1;
+    return PyDict_Contains(index, key);
+}
+
+static PySequenceMethods lazyrow_sequence = {
+    (lenfunc)lazyrow_len,       /* sq_length */
+    0,                          /* sq_concat */
+    0,                          /* sq_repeat */
+    (ssizeargfunc)lazyrow_item, /* sq_item */
+    0,                          /* sq_slice */
+    0,                          /* sq_ass_item */
+    0,                          /* sq_ass_slice */
+    (objobjproc)lazyrow_contains, /* sq_contains */
+    0,                          /* sq_inplace_concat */
+    0,                          /* sq_inplace_repeat */
+};
+
+static PyMappingMethods lazyrow_mapping = {
+    (lenfunc)lazyrow_len,           /* mp_length */
+    (binaryfunc)lazyrow_subscript,  /* mp_subscript */
+    0,                              /* mp_ass_subscript */
+};
+
+
+/** public methods **/
+
+#define psyco_lazyrow_keys_doc \
+"keys() -> list of the column names"
+
+static PyObject *
+psyco_lazyrow_keys(lazyrowObject *self, PyObject *args)
+{
+    PyObject *rv, *name;
+    Py_ssize_t i;
+
+    if (!(rv = PyList_New(Py_SIZE(self)))) return NULL;
+
+    for (i = 0; i < Py_SIZE(self); i++) {
+        if (!(name = PyString_FromString(
+                PQfname(self->result->pgres, (int)i)))) {
+            Py_DECREF(rv);
+            return NULL;
+        }
+        PyList_SET_ITEM(rv, i, name);
+    }
+
+    return rv;
+}
+
+#define psyco_lazyrow_values_doc \
+"values() -> tuple of the values of the row"
+
+static PyObject *
+psyco_lazyrow_values(lazyrowObject *self, PyObject *args)
+{
+    return lazyrow_tuple(self);
+}
+
+#define psyco_lazyrow_items_doc \
+"items() -> list of (column name, value) pairs"
+
+static PyObject *
+psyco_lazyrow_items(lazyrowObject *self, PyObject *args)
+{
+    PyObject *rv = NULL, *keys, *val, *item;
+    Py_ssize_t i;
+
+    if (!(keys = psyco_lazyrow_keys(self, NULL))) return NULL;
+    if (!(rv = PyList_New(Py_SIZE(self)))) goto exit;
+
+    for (i = 0; i < Py_SIZE(self); i++) {
+        if (!(val = lazyrow_value(self, i))) goto error;
+        item = PyTuple_Pack(2, PyList_GET_ITEM(keys, i), val);
+        Py_DECREF(val);
+        if (!item) goto error;
+        PyList_SET_ITEM(rv, i, item);
+    }
+    goto exit;
+
+error:
+    Py_CLEAR(rv);
+exit:
+    Py_DECREF(keys);
+    return rv;
+}
+
+#define psyco_lazyrow_has_key_doc \
+"has_key(name) -> True if the row has a column called `name`"
+
+static PyObject *
+psyco_lazyrow_has_key(lazyrowObject *self, PyObject *key)
+{
+    int rv;
+
+    if (-1 == (rv = lazyrow_contains(self, key))) return NULL;
+    return PyBool_FromLong(rv);
+}
+
+#define psyco_lazyrow_get_doc \
+"get(key, default=None) -> the value of a column by name or position"
+
+static PyObject *
+psyco_lazyrow_get(lazyrowObject *self, PyObject *args)
+{
+    PyObject *key, *dflt = Py_None, *rv;
+
+    if (!PyArg_ParseTuple(args, "O|O", &key, &dflt)) return NULL;
+
+    if (!(rv = lazyrow_subscript(self, key))) {
+        if (!PyErr_ExceptionMatches(PyExc_KeyError)
+                && !PyErr_ExceptionMatches(PyExc_IndexError)) {
+            return NULL;
+        }
+        PyErr_Clear();
+        Py_INCREF(dflt);
+        rv = dflt;
+    }
+    return rv;
+}
+
+#define psyco_lazyrow_copy_doc \
+"copy() -> dict mapping the column names to the values"
+
+static PyObject *
+psyco_lazyrow_copy(lazyrowObject *self, PyObject *args)
+{
+    PyObject *items, *rv = NULL;
+
+    if (!(items = psyco_lazyrow_items(self, NULL))) return NULL;
+    if ((rv = PyDict_New())) {
+        if (0 > PyDict_MergeFromSeq2(rv, items, 1)) {
+            Py_CLEAR(rv);
+        }
+    }
+    Py_DECREF(items);
+    return rv;
+}
+
+static struct PyMethodDef lazyrowObject_methods[] = {
+    {"keys", (PyCFunction)psyco_lazyrow_keys,
+     METH_NOARGS, psyco_lazyrow_keys_doc},
+    {"values", (PyCFunction)psyco_lazyrow_values,
+     METH_NOARGS, psyco_lazyrow_values_doc},
+    {"items", (PyCFunction)psyco_lazyrow_items,
+     METH_NOARGS, psyco_lazyrow_items_doc},
+    {"has_key", (PyCFunction)psyco_lazyrow_has_key,
+     METH_O, psyco_lazyrow_has_key_doc},
+    {"get", (PyCFunction)psyco_lazyrow_get,
+     METH_VARARGS, psyco_lazyrow_get_doc},
+    {"copy", (PyCFunction)psyco_lazyrow_copy,
+     METH_NOARGS, psyco_lazyrow_copy_doc},
+    {NULL}
+};
+
+
+/** the LazyRow object **/
+
+static int
+lazyrow_traverse(lazyrowObject *self, visitproc visit, void *arg)
+{
+    Py_ssize_t i;
+
+    Py_VISIT(self->cursor);
+    for (i = 0; i < Py_SIZE(self); i++) {
+        Py_VISIT(self->values[i]);
+    }
+    return 0;
+}
+
+static int
+lazyrow_clear(lazyrowObject *self)
+{
+    Py_ssize_t i;
+
+    Py_CLEAR(self->cursor);
+    for (i = 0; i < Py_SIZE(self); i++) {
+        Py_CLEAR(self->values[i]);
+    }
+    return 0;
+}
+
+static void
+lazyrow_dealloc(PyObject* obj)
+{
+    lazyrowObject *self = (lazyrowObject *)obj;
+
+    PyObject_GC_UnTrack(self);
+    lazyrow_clear(self);
+    Py_CLEAR(self->result);
+
+    PyObject_GC_Del(obj);
+}
+
+static PyObject *
+lazyrow_repr(lazyrowObject *self)
+{
+    PyObject *tmp, *rv;
+
+    if (!(tmp = lazyrow_tuple(self))) return NULL;
+    rv = PyObject_Repr(tmp);
+    Py_DECREF(tmp);
+    return rv;
+}
+
+static PyObject *
+lazyrow_richcompare(PyObject *self, PyObject *other, int op)
+{
+    PyObject *a = NULL, *b = NULL, *rv = NULL;
+
+    if (PyObject_TypeCheck(self, &lazyrowType)) {
+        if (!(a = lazyrow_tuple((lazyrowObject *)self))) goto exit;
+    }
+    else {
+        Py_INCREF(self);
+        a = self;
+    }
+    if (PyObject_TypeCheck(other, &lazyrowType)) {
+        if (!(b = lazyrow_tuple((lazyrowObject *)other))) goto exit;
+    }
+    else {
+        Py_INCREF(other);
+        b = other;
+    }
+
+    rv = PyObject_RichCompare(a, b, op);
+
+exit:
+    Py_XDECREF(a);
+    Py_XDECREF(b);
+    return rv;
+}
+
+
+/* object type */
+
+#define lazyrowType_doc \
+"A row decoding its values on first access.\n\n" \
+"Use it as a cursor `row_factory`. Values can be read by position or\n" \
+"by column name."
+
+PyTypeObject lazyrowType = {
+    PyObject_HEAD_INIT(NULL)
+    0,
+    "psycopg2._psycopg.LazyRow",
+    offsetof(lazyrowObject, values),
+    sizeof(PyObject *),
+    lazyrow_dealloc, /*tp_dealloc*/
+    0,          /*tp_print*/
+    0,          /*tp_getattr*/
+    0,          /*tp_setattr*/
+    0,          /*tp_compare*/
+    (reprfunc)lazyrow_repr, /*tp_repr*/
+    0,          /*tp_as_number*/
+    &lazyrow_sequence, /*tp_as_sequence*/
+    &lazyrow_mapping, /*tp_as_mapping*/
+    0,          /*tp_hash */
+
+    0,          /*tp_call*/
+    0,          /*tp_str*/
+    0,          /*tp_getattro*/
+    0,          /*tp_setattro*/
+    0,          /*tp_as_buffer*/
+
+    Py_TPFLAGS_DEFAULT|Py_TPFLAGS_HAVE_GC|Py_TPFLAGS_HAVE_RICHCOMPARE,
+                /*tp_flags*/
+    lazyrowType_doc, /*tp_doc*/
+
+    (traverseproc)lazyrow_traverse, /*tp_traverse*/
+    (inquiry)lazyrow_clear, /*tp_clear*/
+
+    lazyrow_richcompare, /*tp_richcompare*/
+    0,          /*tp_weaklistoffset*/
+
+    0,          /*tp_iter*/
+    0,          /*tp_iternext*/
+
+    /* Attribute descriptor and subclassing stuff */
+
+    lazyrowObject_methods, /*tp_methods*/
+    0,          /*tp_members*/
+    0,          /*tp_getset*/
+    0,          /*tp_base*/
+    0,          /*tp_dict*/
+
+    0,          /*tp_descr_get*/
+    0,          /*tp_descr_set*/
+    0,          /*tp_dictoffset*/
+
+    0,          /*tp_init*/
+    0,          /*tp_alloc*/
+    0,          /*tp_new*/
+};
+
+#endif
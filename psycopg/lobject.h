@@ -39,7 +39,7 @@ extern "C" {
 
 extern HIDDEN PyTypeObject lobjectType;
 
-typedef struct {
+typedef struct lobjectObject {
     PyObject HEAD;
 
     connectionObject *conn;  /* connection owning the lobject */
@@ -49,8 +49,23 @@ typedef struct {
 
     int fd;                  /* the file descriptor for file-like ops */
     Oid oid;                 /* the oid for this lobject */
+
+    /* read-ahead or write-behind buffer, only if buffer_size is set */
+    char *buffer;
+    Py_ssize_t bufsize;      /* size of buffer, 0 if unbuffered */
+    Py_ssize_t buflen;       /* bytes of data in the buffer */
+    Py_ssize_t bufpos;       /* bytes of read-ahead data already consumed */
+    int bufmode;             /* what the buffer contains: LOBJ_BUF_* */
+    struct lobjectObject *next; /* next buffered lobject of the connection */
 } lobjectObject;
 
+#define LOBJ_BUF_EMPTY  0
+#define LOBJ_BUF_READ   1   /* data read from the server ahead */
+#define LOBJ_BUF_WRITE  2   /* data still to be written to the server */
+
+/* the chunk returned by the iterator on an unbuffered lobject */
+#define LOBJ_DEFAULT_CHUNK 65536
+
 /* functions exported from lobject_int.c */
 
 HIDDEN int lobject_open(lobjectObject *self, connectionObject *conn,
@@ -66,6 +81,10 @@ HIDDEN int lobject_seek(lobjectObject *self, int pos, int whence);
 HIDDEN int lobject_tell(lobjectObject *self);
 HIDDEN int lobject_truncate(lobjectObject *self, size_t len);
 HIDDEN int lobject_close(lobjectObject *self);
+HIDDEN int lobject_flush(lobjectObject *self);
+HIDDEN int lobject_set_buffer_size(lobjectObject *self, Py_ssize_t size);
+HIDDEN void lobject_clear_buffer(lobjectObject *self);
+HIDDEN int lobject_flush_all(connectionObject *conn);
 
 #define lobject_is_closed(self) \
     ((self)->fd < 0 || !(self)->conn || (self)->conn->closed)
@@ -26,6 +26,8 @@
 #define PY_SSIZE_T_CLEAN
 #include <Python.h>
 #include <string.h>
+#include <stdio.h>
+#include <errno.h>
 
 #define PSYCOPG_MODULE
 #include "psycopg/config.h"
@@ -33,6 +35,7 @@
 #include "psycopg/connection.h"
 #include "psycopg/lobject.h"
 #include "psycopg/pqpath.h"
+#include "psycopg/green.h"
 
 #ifdef PSYCOPG_EXTENSIONS
 
@@ -41,10 +44,395 @@ collect_error(connectionObject *conn, char **error)
 {
     const char *msg = PQerrorMessage(conn->pgconn);
 
-    if (msg)
+    if (msg && !*error)
         *error = strdup(msg);
 }
 
+/* call a large object server function in green mode
+
+   the libpq lo_* functions use the fast-path interface, which blocks and
+   can't be used with a wait callback: in green mode the same server
+   functions are called with a query. On error return NULL: the message
+   is available in PQerrorMessage() as with the libpq functions.
+
+   Called with the connection lock held, without the GIL. */
+
+static PGresult *
+lobject_exec_green(lobjectObject *self, const char *query,
+                   int nparams, const char **values, int *lengths,
+                   int *formats, int result_format,
+                   PyThreadState **tstate)
+{
+    pqParams params;
+    PGresult *res;
+
+    params.nparams = nparams;
+    params.types = NULL;
+    params.values = values;
+    params.lengths = lengths;
+    params.formats = formats;
+    params.name = NULL;
+    params.prepare = 0;
+    params.result_format = result_format;
+
+    Dprintf("lobject_exec_green: %s", query);
+
+    PyEval_RestoreThread(*tstate);
+    res = psyco_exec_green_params(self->conn, query, &params);
+    *tstate = PyEval_SaveThread();
+
+    if (res != NULL && (PQresultStatus(res) != PGRES_TUPLES_OK
+                        || PQntuples(res) != 1)) {
+        PQclear(res);
+        res = NULL;
+    }
+    return res;
+}
+
+static int
+lobject_exec_green_int(lobjectObject *self, const char *query,
+                       int nparams, const char **values,
+                       PyThreadState **tstate)
+{
+    PGresult *res;
+    int rv;
+
+    res = lobject_exec_green(self, query, nparams, values, NULL, NULL, 0,
+                             tstate);
+    if (res == NULL)
+        return -1;
+    rv = atoi(PQgetvalue(res, 0, 0));
+    PQclear(res);
+    return rv;
+}
+
+/* wrappers to the libpq large object functions
+
+   they call the libpq function or, if a wait callback is set, the server
+   one through the asynchronous query path. */
+
+static Oid
+_lo_create(lobjectObject *self, Oid oid,
+           PyThreadState **tstate)
+{
+    char soid[16];
+    const char *values[1] = {soid};
+    PGresult *res;
+
+    if (!psyco_green())
+        return lo_create(self->conn->pgconn, oid);
+
+    sprintf(soid, "%u", oid);
+    res = lobject_exec_green(self, "SELECT lo_create($1::oid)",
+                             1, values, NULL, NULL, 0, tstate);
+    if (res == NULL)
+        return InvalidOid;
+    oid = (Oid)strtoul(PQgetvalue(res, 0, 0), NULL, 10);
+    PQclear(res);
+    return oid;
+}
+
+static int
+_lo_open(lobjectObject *self, Oid oid, int mode,
+         PyThreadState **tstate)
+{
+    char soid[16], smode[16];
+    const char *values[2] = {soid, smode};
+
+    if (!psyco_green())
+        return lo_open(self->conn->pgconn, oid, mode);
+
+    sprintf(soid, "%u", oid);
+    sprintf(smode, "%d", mode);
+    return lobject_exec_green_int(self,
+        "SELECT lo_open($1::oid, $2::int4)", 2, values, tstate);
+}
+
+static int
+_lo_close(lobjectObject *self, int fd,
+          PyThreadState **tstate)
+{
+    char sfd[16];
+    const char *values[1] = {sfd};
+
+    if (!psyco_green())
+        return lo_close(self->conn->pgconn, fd);
+
+    sprintf(sfd, "%d", fd);
+    return lobject_exec_green_int(self,
+        "SELECT lo_close($1::int4)", 1, values, tstate);
+}
+
+static int
+_lo_unlink(lobjectObject *self, Oid oid,
+           PyThreadState **tstate)
+{
+    char soid[16];
+    const char *values[1] = {soid};
+
+    if (!psyco_green())
+        return lo_unlink(self->conn->pgconn, oid);
+
+    sprintf(soid, "%u", oid);
+    return lobject_exec_green_int(self,
+        "SELECT lo_unlink($1::oid)", 1, values, tstate);
+}
+
+static int
+_lo_write(lobjectObject *self, int fd, const char *buf, size_t len,
+          PyThreadState **tstate)
+{
+    char sfd[16];
+    const char *values[2] = {sfd, buf};
+    int lengths[2] = {0, (int)len};
+    int formats[2] = {0, 1};
+    PGresult *res;
+    int rv;
+
+    if (!psyco_green())
+        return lo_write(self->conn->pgconn, fd, buf, len);
+
+    sprintf(sfd, "%d", fd);
+    res = lobject_exec_green(self, "SELECT lowrite($1::int4, $2::bytea)",
+                             2, values, lengths, formats, 0, tstate);
+    if (res == NULL)
+        return -1;
+    rv = atoi(PQgetvalue(res, 0, 0));
+    PQclear(res);
+    return rv;
+}
+
+static int
+_lo_read(lobjectObject *self, int fd, char *buf, size_t len,
+         PyThreadState **tstate)
+{
+    char sfd[16], slen[16];
+    const char *values[2] = {sfd, slen};
+    PGresult *res;
+    int n;
+
+    if (!psyco_green())
+        return lo_read(self->conn->pgconn, fd, buf, len);
+
+    sprintf(sfd, "%d", fd);
+    sprintf(slen, "%d", (int)len);
+    res = lobject_exec_green(self, "SELECT loread($1::int4, $2::int4)",
+                             2, values, NULL, NULL, 1, tstate);
+    if (res == NULL)
+        return -1;
+    n = PQgetlength(res, 0, 0);
+    if ((size_t)n > len)
+        n = (int)len;
+    memcpy(buf, PQgetvalue(res, 0, 0), n);
+    PQclear(res);
+    return n;
+}
+
+static int
+_lo_lseek(lobjectObject *self, int fd, int offset, int whence,
+          PyThreadState **tstate)
+{
+    char sfd[16], soff[16], swhence[16];
+    const char *values[3] = {sfd, soff, swhence};
+
+    if (!psyco_green())
+        return lo_lseek(self->conn->pgconn, fd, offset, whence);
+
+    sprintf(sfd, "%d", fd);
+    sprintf(soff, "%d", offset);
+    sprintf(swhence, "%d", whence);
+    return lobject_exec_green_int(self,
+        "SELECT lo_lseek($1::int4, $2::int4, $3::int4)",
+        3, values, tstate);
+}
+
+static int
+_lo_tell(lobjectObject *self, int fd,
+         PyThreadState **tstate)
+{
+    char sfd[16];
+    const char *values[1] = {sfd};
+
+    if (!psyco_green())
+        return lo_tell(self->conn->pgconn, fd);
+
+    sprintf(sfd, "%d", fd);
+    return lobject_exec_green_int(self,
+        "SELECT lo_tell($1::int4)", 1, values, tstate);
+}
+
+#if PG_VERSION_HEX >= 0x080300
+
+static int
+_lo_truncate(lobjectObject *self, int fd, size_t len,
+             PyThreadState **tstate)
+{
+    char sfd[16], slen[16];
+    const char *values[2] = {sfd, slen};
+
+    if (!psyco_green())
+        return lo_truncate(self->conn->pgconn, fd, len);
+
+    sprintf(sfd, "%d", fd);
+    sprintf(slen, "%d", (int)len);
+    return lobject_exec_green_int(self,
+        "SELECT lo_truncate($1::int4, $2::int4)", 2, values, tstate);
+}
+
+#endif /* PG_VERSION_HEX >= 0x080300 */
+
+/* lo_import/lo_export in green mode: the file is copied a chunk at time
+   with the functions above, as libpq does with the blocking ones. */
+
+static void
+file_error(const char *what, const char *filename, char **error)
+{
+    char buf[1024];
+
+    PyOS_snprintf(buf, sizeof(buf), "could not %s file \"%s\": %s",
+                  what, filename, strerror(errno));
+    *error = strdup(buf);
+}
+
+static Oid
+_lo_import(lobjectObject *self, const char *filename,
+           char **error, PyThreadState **tstate)
+{
+    FILE *f;
+    char *buf = NULL;
+    size_t n;
+    Oid oid = InvalidOid;
+    int fd = -1;
+
+    if (!psyco_green())
+        return lo_import(self->conn->pgconn, filename);
+
+    if (!(f = fopen(filename, "rb"))) {
+        file_error("open", filename, error);
+        return InvalidOid;
+    }
+    if (!(buf = malloc(LOBJ_DEFAULT_CHUNK))) {
+        *error = strdup("out of memory");
+        goto exit;
+    }
+
+    if ((oid = _lo_create(self, InvalidOid, tstate)) == InvalidOid)
+        goto exit;
+    if ((fd = _lo_open(self, oid, INV_WRITE, tstate)) < 0)
+        goto error;
+
+    while ((n = fread(buf, 1, LOBJ_DEFAULT_CHUNK, f)) > 0) {
+        if (_lo_write(self, fd, buf, n, tstate) != (int)n)
+            goto error;
+    }
+    if (ferror(f)) {
+        file_error("read", filename, error);
+        goto error;
+    }
+    if (_lo_close(self, fd, tstate) < 0)
+        goto error;
+    goto exit;
+
+error:
+    oid = InvalidOid;
+
+exit:
+    free(buf);
+    fclose(f);
+    return oid;
+}
+
+static int
+_lo_export(lobjectObject *self, Oid oid, const char *filename,
+           char **error, PyThreadState **tstate)
+{
+    FILE *f = NULL;
+    char *buf = NULL;
+    int fd, n, rv = -1;
+
+    if (!psyco_green())
+        return lo_export(self->conn->pgconn, oid, filename);
+
+    if ((fd = _lo_open(self, oid, INV_READ, tstate)) < 0)
+        return -1;
+    if (!(f = fopen(filename, "wb"))) {
+        file_error("create", filename, error);
+        goto exit;
+    }
+    if (!(buf = malloc(LOBJ_DEFAULT_CHUNK))) {
+        *error = strdup("out of memory");
+        goto exit;
+    }
+
+    while ((n = _lo_read(self, fd, buf, LOBJ_DEFAULT_CHUNK,
+                         tstate)) > 0) {
+        if (fwrite(buf, 1, n, f) != (size_t)n) {
+            file_error("write", filename, error);
+            goto exit;
+        }
+    }
+    if (n < 0)
+        goto exit;
+    if (fclose(f) != 0) {
+        f = NULL;
+        file_error("write", filename, error);
+        goto exit;
+    }
+    f = NULL;
+    rv = _lo_close(self, fd, tstate);
+
+exit:
+    free(buf);
+    if (f)
+        fclose(f);
+    return rv;
+}
+
+/* bring the server position back to the lobject one
+
+   write the pending data or move back before the read-ahead one, then empty
+   the buffer. If the large object can't be used anymore the buffer is just
+   dropped.
+
+   Called with the connection lock held, without the GIL. */
+
+static int
+lobject_sync_locked(lobjectObject *self, char **error,
+                    PyThreadState **tstate)
+{
+    int rv = 0;
+
+    if (self->conn->isolation_level == ISOLATION_LEVEL_AUTOCOMMIT ||
+        self->conn->mark != self->mark ||
+        self->fd == -1) {
+        goto exit;
+    }
+
+    if (self->bufmode == LOBJ_BUF_WRITE && self->buflen > 0) {
+        Dprintf("lobject_sync: writing " FORMAT_CODE_PY_SSIZE_T " bytes",
+                self->buflen);
+        if (_lo_write(self, self->fd, self->buffer, self->buflen,
+                      tstate) != self->buflen) {
+            collect_error(self->conn, error);
+            rv = -1;
+        }
+    }
+    else if (self->bufmode == LOBJ_BUF_READ && self->bufpos < self->buflen) {
+        Dprintf("lobject_sync: dropping " FORMAT_CODE_PY_SSIZE_T " bytes",
+                self->buflen - self->bufpos);
+        if (_lo_lseek(self, self->fd, (int)(self->bufpos - self->buflen),
+                      SEEK_CUR, tstate) < 0) {
+            collect_error(self->conn, error);
+            rv = -1;
+        }
+    }
+
+exit:
+    self->bufmode = LOBJ_BUF_EMPTY;
+    self->buflen = self->bufpos = 0;
+    return rv;
+}
+
 /* lobject_open - create a new/open an existing lo */
 
 int
@@ -67,9 +455,9 @@ lobject_open(lobjectObject *self, connectionObject *conn,
        new_name */
     if (oid == InvalidOid) {
         if (new_file)
-            self->oid = lo_import(self->conn->pgconn, new_file);
+            self->oid = _lo_import(self, new_file, &error, &_save);
         else
-            self->oid = lo_create(self->conn->pgconn, new_oid);
+            self->oid = _lo_create(self, new_oid, &_save);
 
         Dprintf("lobject_open: large object created with oid = %d",
                 self->oid);
@@ -90,7 +478,7 @@ lobject_open(lobjectObject *self, connectionObject *conn,
     /* if the oid is a real one we try to open with the given mode,
        unless the mode is -1, meaning "don't open!" */
     if (mode != -1) {
-        self->fd = lo_open(self->conn->pgconn, self->oid, mode);
+        self->fd = _lo_open(self, self->oid, mode, &_save);
         Dprintf("lobject_open: large object opened with fd = %d",
             self->fd);
 
@@ -125,7 +513,8 @@ lobject_open(lobjectObject *self, connectionObject *conn,
 /* lobject_close - close an existing lo */
 
 static int
-lobject_close_locked(lobjectObject *self, char **error)
+lobject_close_locked(lobjectObject *self, char **error,
+                     PyThreadState **tstate)
 {
     int retvalue;
 
@@ -134,7 +523,7 @@ lobject_close_locked(lobjectObject *self, char **error)
         self->fd == -1)
         return 0;
 
-    retvalue = lo_close(self->conn->pgconn, self->fd);
+    retvalue = _lo_close(self, self->fd, tstate);
     self->fd = -1;
     if (retvalue < 0)
         collect_error(self->conn, error);
@@ -152,7 +541,9 @@ lobject_close(lobjectObject *self)
     Py_BEGIN_ALLOW_THREADS;
     pthread_mutex_lock(&(self->conn->lock));
 
-    retvalue = lobject_close_locked(self, &error);
+    retvalue = lobject_sync_locked(self, &error, &_save);
+    if (retvalue == 0)
+        retvalue = lobject_close_locked(self, &error, &_save);
 
     pthread_mutex_unlock(&(self->conn->lock));
     Py_END_ALLOW_THREADS;
@@ -178,12 +569,15 @@ lobject_unlink(lobjectObject *self)
     if (retvalue < 0)
         goto end;
 
-    /* first we make sure the lobject is closed and then we unlink */
-    retvalue = lobject_close_locked(self, &error);
+    /* first we make sure the lobject is closed and then we unlink: the
+       data still buffered would be destroyed anyway */
+    self->bufmode = LOBJ_BUF_EMPTY;
+    self->buflen = self->bufpos = 0;
+    retvalue = lobject_close_locked(self, &error, &_save);
     if (retvalue < 0)
         goto end;
 
-    retvalue = lo_unlink(self->conn->pgconn, self->oid);
+    retvalue = _lo_unlink(self, self->oid, &_save);
     if (retvalue < 0)
         collect_error(self->conn, &error);
 
@@ -196,7 +590,10 @@ lobject_unlink(lobjectObject *self)
     return retvalue;
 }
 
-/* lobject_write - write bytes to a lo */
+/* lobject_write - write bytes to a lo
+
+   if the lobject is buffered the data is kept in the buffer until it is
+   full (or flushed): large writes are sent directly. */
 
 Py_ssize_t
 lobject_write(lobjectObject *self, const char *buf, size_t len)
@@ -211,10 +608,28 @@ lobject_write(lobjectObject *self, const char *buf, size_t len)
     Py_BEGIN_ALLOW_THREADS;
     pthread_mutex_lock(&(self->conn->lock));
 
-    written = lo_write(self->conn->pgconn, self->fd, buf, len);
+    written = len;
+    if (self->bufsize > 0) {
+        if (self->bufmode == LOBJ_BUF_READ
+                || self->buflen + (Py_ssize_t)len > self->bufsize) {
+            if (lobject_sync_locked(self, &error, &_save) < 0) {
+                written = -1;
+                goto end;
+            }
+        }
+        if ((Py_ssize_t)len < self->bufsize) {
+            memcpy(self->buffer + self->buflen, buf, len);
+            self->buflen += len;
+            self->bufmode = LOBJ_BUF_WRITE;
+            goto end;
+        }
+    }
+
+    written = _lo_write(self, self->fd, buf, len, &_save);
     if (written < 0)
         collect_error(self->conn, &error);
 
+ end:
     pthread_mutex_unlock(&(self->conn->lock));
     Py_END_ALLOW_THREADS;
 
@@ -223,22 +638,76 @@ lobject_write(lobjectObject *self, const char *buf, size_t len)
     return written;
 }
 
-/* lobject_read - read bytes from a lo */
+/* lobject_read - read bytes from a lo
+
+   if the lobject is buffered the data is read from the server a buffer at
+   time: reads larger than the buffer go directly in buf. */
 
 Py_ssize_t
 lobject_read(lobjectObject *self, char *buf, size_t len)
 {
-    Py_ssize_t n_read;
+    Py_ssize_t n_read = 0, n, want;
     PGresult *pgres = NULL;
     char *error = NULL;
 
     Py_BEGIN_ALLOW_THREADS;
     pthread_mutex_lock(&(self->conn->lock));
 
-    n_read = lo_read(self->conn->pgconn, self->fd, buf, len);
-    if (n_read < 0)
-        collect_error(self->conn, &error);
+    if (self->bufsize == 0) {
+        n_read = _lo_read(self, self->fd, buf, len, &_save);
+        if (n_read < 0)
+            collect_error(self->conn, &error);
+        goto end;
+    }
+
+    if (self->bufmode == LOBJ_BUF_WRITE) {
+        if (lobject_sync_locked(self, &error, &_save) < 0) {
+            n_read = -1;
+            goto end;
+        }
+    }
+
+    while (n_read < (Py_ssize_t)len) {
+        want = len - n_read;
+
+        /* data already in the buffer */
+        if (self->bufmode == LOBJ_BUF_READ && self->bufpos < self->buflen) {
+            n = self->buflen - self->bufpos;
+            if (n > want) n = want;
+            memcpy(buf + n_read, self->buffer + self->bufpos, n);
+            self->bufpos += n;
+            n_read += n;
+            continue;
+        }
 
+        self->bufmode = LOBJ_BUF_EMPTY;
+        self->buflen = self->bufpos = 0;
+
+        if (want >= self->bufsize) {
+            n = _lo_read(self, self->fd, buf + n_read, want, &_save);
+            if (n < 0) {
+                collect_error(self->conn, &error);
+                n_read = -1;
+            }
+            else {
+                n_read += n;
+            }
+            break;
+        }
+
+        n = _lo_read(self, self->fd, self->buffer, self->bufsize,
+                     &_save);
+        if (n < 0) {
+            collect_error(self->conn, &error);
+            n_read = -1;
+            break;
+        }
+        if (n == 0) { break; }      /* end of data */
+        self->buflen = n;
+        self->bufmode = LOBJ_BUF_READ;
+    }
+
+ end:
     pthread_mutex_unlock(&(self->conn->lock));
     Py_END_ALLOW_THREADS;
 
@@ -247,6 +716,116 @@ lobject_read(lobjectObject *self, char *buf, size_t len)
     return n_read;
 }
 
+/* lobject_flush - write the buffered data to the server */
+
+int
+lobject_flush(lobjectObject *self)
+{
+    PGresult *pgres = NULL;
+    char *error = NULL;
+    int retvalue;
+
+    if (self->bufmode != LOBJ_BUF_WRITE) {
+        return 0;
+    }
+
+    Py_BEGIN_ALLOW_THREADS;
+    pthread_mutex_lock(&(self->conn->lock));
+
+    retvalue = lobject_sync_locked(self, &error, &_save);
+
+    pthread_mutex_unlock(&(self->conn->lock));
+    Py_END_ALLOW_THREADS;
+
+    if (retvalue < 0)
+        pq_complete_error(self->conn, &pgres, &error);
+    return retvalue;
+}
+
+/* lobject_flush_all - flush all the buffered lobjects of a connection
+
+   to be called before the transaction is committed. */
+
+int
+lobject_flush_all(connectionObject *conn)
+{
+    lobjectObject *lobj;
+
+    for (lobj = conn->lobjects; lobj; lobj = lobj->next) {
+        if (lobject_flush(lobj) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* lobject_set_buffer_size - change the size of the lobject buffer
+
+   a size of 0 makes the lobject unbuffered. The data buffered is flushed. */
+
+int
+lobject_set_buffer_size(lobjectObject *self, Py_ssize_t size)
+{
+    PGresult *pgres = NULL;
+    char *error = NULL;
+    char *buffer = NULL;
+    lobjectObject **p;
+    int retvalue;
+
+    if (size > 0 && !(buffer = PyMem_Malloc(size))) {
+        PyErr_NoMemory();
+        return -1;
+    }
+
+    Py_BEGIN_ALLOW_THREADS;
+    pthread_mutex_lock(&(self->conn->lock));
+
+    retvalue = lobject_sync_locked(self, &error, &_save);
+
+    pthread_mutex_unlock(&(self->conn->lock));
+    Py_END_ALLOW_THREADS;
+
+    if (retvalue < 0) {
+        PyMem_Free(buffer);
+        pq_complete_error(self->conn, &pgres, &error);
+        return -1;
+    }
+
+    /* keep the connection list of the buffered lobjects up to date */
+    if (self->bufsize == 0 && size > 0) {
+        self->next = self->conn->lobjects;
+        self->conn->lobjects = self;
+    }
+    else if (self->bufsize > 0 && size == 0) {
+        for (p = &self->conn->lobjects; *p; p = &(*p)->next) {
+            if (*p == self) {
+                *p = self->next;
+                break;
+            }
+        }
+        self->next = NULL;
+    }
+
+    PyMem_Free(self->buffer);
+    self->buffer = buffer;
+    self->bufsize = size;
+    return 0;
+}
+
+/* lobject_clear_buffer - release the buffer without writing it */
+
+void
+lobject_clear_buffer(lobjectObject *self)
+{
+    if (self->bufsize == 0) {
+        return;
+    }
+    self->bufmode = LOBJ_BUF_EMPTY;
+    self->buflen = self->bufpos = 0;
+    /* can't fail without data to flush */
+    lobject_set_buffer_size(self, 0);
+}
+
 /* lobject_seek - move the current position in the lo */
 
 int
@@ -262,11 +841,16 @@ lobject_seek(lobjectObject *self, int pos, int whence)
     Py_BEGIN_ALLOW_THREADS;
     pthread_mutex_lock(&(self->conn->lock));
 
-    where = lo_lseek(self->conn->pgconn, self->fd, pos, whence);
+    if (lobject_sync_locked(self, &error, &_save) < 0) {
+        where = -1;
+        goto end;
+    }
+    where = _lo_lseek(self, self->fd, pos, whence, &_save);
     Dprintf("lobject_seek: where = %d", where);
     if (where < 0)
         collect_error(self->conn, &error);
 
+ end:
     pthread_mutex_unlock(&(self->conn->lock));
     Py_END_ALLOW_THREADS;
 
@@ -289,10 +873,14 @@ lobject_tell(lobjectObject *self)
     Py_BEGIN_ALLOW_THREADS;
     pthread_mutex_lock(&(self->conn->lock));
 
-    where = lo_tell(self->conn->pgconn, self->fd);
+    where = _lo_tell(self, self->fd, &_save);
     Dprintf("lobject_tell: where = %d", where);
     if (where < 0)
         collect_error(self->conn, &error);
+    else if (self->bufmode == LOBJ_BUF_READ)
+        where -= (int)(self->buflen - self->bufpos);
+    else if (self->bufmode == LOBJ_BUF_WRITE)
+        where += (int)self->buflen;
 
     pthread_mutex_unlock(&(self->conn->lock));
     Py_END_ALLOW_THREADS;
@@ -318,7 +906,11 @@ lobject_export(lobjectObject *self, const char *filename)
     if (retvalue < 0)
         goto end;
 
-    retvalue = lo_export(self->conn->pgconn, self->oid, filename);
+    retvalue = lobject_sync_locked(self, &error, &_save);
+    if (retvalue < 0)
+        goto end;
+
+    retvalue = _lo_export(self, self->oid, filename, &error, &_save);
     if (retvalue < 0)
         collect_error(self->conn, &error);
 
@@ -346,7 +938,9 @@ lobject_truncate(lobjectObject *self, size_t len)
     Py_BEGIN_ALLOW_THREADS;
     pthread_mutex_lock(&(self->conn->lock));
 
-    retvalue = lo_truncate(self->conn->pgconn, self->fd, len);
+    retvalue = lobject_sync_locked(self, &error, &_save);
+    if (retvalue == 0)
+        retvalue = _lo_truncate(self, self->fd, len, &_save);
     Dprintf("lobject_truncate: result = %d", retvalue);
     if (retvalue < 0)
         collect_error(self->conn, &error);
@@ -129,6 +129,60 @@ psyco_lobj_read(lobjectObject *self, PyObject *args)
     return res;
 }
 
+/* readinto method - read data from the lobject into a buffer */
+
+#define psyco_lobj_readinto_doc \
+"readinto(b) -> int -- Read up to len(b) bytes into the writable buffer b.\n\n" \
+"Return the number of bytes read, 0 at the end of the large object."
+
+static PyObject *
+psyco_lobj_readinto(lobjectObject *self, PyObject *args)
+{
+    Py_buffer view;
+    Py_ssize_t size;
+
+    if (!PyArg_ParseTuple(args, "w*", &view)) return NULL;
+
+    if (lobject_is_closed(self)) {
+        PyBuffer_Release(&view);
+        PyErr_SetString(InterfaceError, "lobject already closed");
+        return NULL;
+    }
+    if (self->conn->isolation_level == 0
+            || self->conn->mark != self->mark) {
+        PyBuffer_Release(&view);
+        psyco_set_error(ProgrammingError, (PyObject*)self,
+            self->conn->isolation_level == 0 ?
+                "can't use a lobject outside of transactions" :
+                "lobject isn't valid anymore", NULL, NULL);
+        return NULL;
+    }
+
+    size = lobject_read(self, view.buf, view.len);
+    PyBuffer_Release(&view);
+    if (size < 0) return NULL;
+
+    return PyInt_FromSsize_t(size);
+}
+
+/* flush method - write the buffered data to the lobject */
+
+#define psyco_lobj_flush_doc \
+"flush() -- Write the data buffered to the large object."
+
+static PyObject *
+psyco_lobj_flush(lobjectObject *self, PyObject *args)
+{
+    EXC_IF_LOBJ_CLOSED(self);
+    EXC_IF_LOBJ_LEVEL0(self);
+    EXC_IF_LOBJ_UNMARKED(self);
+
+    if (lobject_flush(self) < 0) return NULL;
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
 /* seek method - seek in the lobject */
 
 #define psyco_lobj_seek_doc \
@@ -211,6 +265,83 @@ psyco_lobj_export(lobjectObject *self, PyObject *args)
 }
 
 
+/* buffer_size attribute - the size of the read-ahead/write-behind buffer */
+
+static PyObject *
+psyco_lobj_get_buffer_size(lobjectObject *self, void *closure)
+{
+    return PyInt_FromSsize_t(self->bufsize);
+}
+
+static int
+psyco_lobj_set_buffer_size(lobjectObject *self, PyObject *value,
+                           void *closure)
+{
+    Py_ssize_t size;
+
+    if (value == NULL) {
+        PyErr_SetString(PyExc_TypeError, "can't delete buffer_size");
+        return -1;
+    }
+    if (value == Py_None) {
+        size = 0;
+    }
+    else {
+        size = PyInt_AsSsize_t(value);
+        if (size == -1 && PyErr_Occurred()) return -1;
+        if (size < 0) {
+            PyErr_SetString(PyExc_ValueError,
+                "buffer_size must be a positive number or None");
+            return -1;
+        }
+    }
+    if (size == self->bufsize) return 0;
+
+    if (size > 0 && lobject_is_closed(self)) {
+        PyErr_SetString(InterfaceError, "lobject already closed");
+        return -1;
+    }
+
+    return lobject_set_buffer_size(self, size);
+}
+
+/* iterator protocol: return the data a buffer at time */
+
+static PyObject *
+lobject_iter(PyObject *self)
+{
+    Py_INCREF(self);
+    return self;
+}
+
+static PyObject *
+lobject_iternext(lobjectObject *self)
+{
+    PyObject *res;
+    Py_ssize_t size;
+
+    EXC_IF_LOBJ_CLOSED(self);
+    EXC_IF_LOBJ_LEVEL0(self);
+    EXC_IF_LOBJ_UNMARKED(self);
+
+    size = self->bufsize > 0 ? self->bufsize : LOBJ_DEFAULT_CHUNK;
+    if (!(res = PyString_FromStringAndSize(NULL, size))) return NULL;
+
+    if ((size = lobject_read(self, PyString_AS_STRING(res), size)) < 0) {
+        Py_DECREF(res);
+        return NULL;
+    }
+    if (size == 0) {
+        /* end of the data: StopIteration */
+        Py_DECREF(res);
+        return NULL;
+    }
+    if (size < PyString_GET_SIZE(res)) {
+        _PyString_Resize(&res, size);
+    }
+    return res;
+}
+
 static PyObject *
 psyco_lobj_get_closed(lobjectObject *self, void *closure)
 {
@@ -255,6 +386,10 @@ psyco_lobj_truncate(lobjectObject *self, PyObject *args)
 static struct PyMethodDef lobjectObject_methods[] = {
     {"read", (PyCFunction)psyco_lobj_read,
      METH_VARARGS, psyco_lobj_read_doc},
+    {"readinto", (PyCFunction)psyco_lobj_readinto,
+     METH_VARARGS, psyco_lobj_readinto_doc},
+    {"flush", (PyCFunction)psyco_lobj_flush,
+     METH_NOARGS, psyco_lobj_flush_doc},
     {"write", (PyCFunction)psyco_lobj_write,
      METH_VARARGS, psyco_lobj_write_doc},
     {"seek", (PyCFunction)psyco_lobj_seek,
@@ -289,6 +424,9 @@ static struct PyMemberDef lobjectObject_members[] = {
 static struct PyGetSetDef lobjectObject_getsets[] = {
     {"closed", (getter)psyco_lobj_get_closed, NULL,
      "The if the large object is closed (no file-like methods)."},
+    {"buffer_size", (getter)psyco_lobj_get_buffer_size,
+     (setter)psyco_lobj_set_buffer_size,
+     "The size of the read-ahead/write-behind buffer, 0 if unbuffered."},
     {NULL}
 };
 
@@ -314,6 +452,11 @@ lobject_setup(lobjectObject *self, connectionObject *conn,
     self->fd = -1;
     self->oid = InvalidOid;
 
+    self->buffer = NULL;
+    self->bufsize = self->buflen = self->bufpos = 0;
+    self->bufmode = LOBJ_BUF_EMPTY;
+    self->next = NULL;
+
     if (lobject_open(self, conn, oid, mode, new_oid, new_file) == -1)
         return -1;
 
@@ -330,6 +473,7 @@ lobject_dealloc(PyObject* obj)
 
     if (lobject_close(self) < 0)
         PyErr_Print();
+    lobject_clear_buffer(self);
     Py_XDECREF((PyObject*)self->conn);
 
     Dprintf("lobject_dealloc: deleted lobject object at %p, refcnt = "
@@ -411,8 +555,8 @@ PyTypeObject lobjectType = {
     0,          /*tp_richcompare*/
     0,          /*tp_weaklistoffset*/
 
-    0,          /*tp_iter*/
-    0,          /*tp_iternext*/
+    lobject_iter, /*tp_iter*/
+    (iternextfunc)lobject_iternext, /*tp_iternext*/
 
     /* Attribute descriptor and subclassing stuff */
 
@@ -35,19 +35,41 @@
 #include "psycopg/connection.h"
 #include "psycopg/microprotocols.h"
 #include "psycopg/microprotocols_proto.h"
+#include "psycopg/adapter_asis.h"
+#include "psycopg/adapter_pboolean.h"
+#include "psycopg/adapter_pfloat.h"
+#include "psycopg/adapter_qstring.h"
+#include "psycopg/adapter_binary.h"
+#include "psycopg/registry.h"
 
 
 /** the adapters registry **/
 
 PyObject *psyco_adapters;
 
+/* the adapters to ISQLQuote resolved for the types, including the ones
+   found in a superclass, or None if the registry has none. The cache is
+   emptied when the registry changes and when it grows too much, so that it
+   doesn't keep alive the classes created dynamically */
+static PyObject *psyco_adapters_cache;
+static long int psyco_adapters_generation = -1;
+
+#define ADAPTERS_CACHE_MAX 1024
+
+/* the ADAPTERS_FAST_* flags of the builtin types that can be quoted
+   without going through the registry */
+static int psyco_adapters_fast = 0;
+
 /* microprotocols_init - initialize the adapters dictionary */
 
 int
 microprotocols_init(PyObject *dict)
 {
     /* create adapters dictionary and put it in module namespace */
-    if ((psyco_adapters = PyDict_New()) == NULL) {
+    if ((psyco_adapters = registry_new()) == NULL) {
+        return -1;
+    }
+    if ((psyco_adapters_cache = PyDict_New()) == NULL) {
         return -1;
     }
 
@@ -63,16 +85,83 @@ int
 microprotocols_add(PyTypeObject *type, PyObject *proto, PyObject *cast)
 {
     PyObject *key;
+    int rv;
 
     if (proto == NULL) proto = (PyObject*)&isqlquoteType;
 
     Dprintf("microprotocols_add: cast %p for (%s, ?)", cast, type->tp_name);
 
-    key = PyTuple_Pack(2, (PyObject*)type, proto);
-    PyDict_SetItem(psyco_adapters, key, cast);
+    if (!(key = PyTuple_Pack(2, (PyObject*)type, proto))) { return -1; }
+    rv = PyDict_SetItem(psyco_adapters, key, cast);
     Py_DECREF(key);
 
-    return 0;
+    /* the resolved adapters are stale */
+    registry_generation++;
+
+    return rv;
+}
+
+/* check if the default adapter of a builtin type is still registered */
+
+static int
+_microprotocols_is_default(PyTypeObject *type, PyTypeObject *adapter)
+{
+    PyObject *key, *cast;
+
+    if (!(key = PyTuple_Pack(2, (PyObject*)type, (PyObject*)&isqlquoteType))) {
+        PyErr_Clear();
+        return 0;
+    }
+    cast = PyDict_GetItem(psyco_adapters, key);
+    Py_DECREF(key);
+
+    return cast == (PyObject *)adapter;
+}
+
+/* empty the cache of the resolved adapters if the registry has changed.
+
+   The registry generation is bumped by microprotocols_add() and by any
+   change made to the 'adapters' dictionary from Python. */
+
+static void
+_microprotocols_check_cache(void)
+{
+    if (psyco_adapters_generation == registry_generation) {
+        return;
+    }
+
+    Dprintf("microprotocols: adapters registry changed");
+    PyDict_Clear(psyco_adapters_cache);
+
+    psyco_adapters_fast = 0;
+    if (_microprotocols_is_default(&PyInt_Type, &asisType)
+            && _microprotocols_is_default(&PyLong_Type, &asisType)) {
+        psyco_adapters_fast |= ADAPTERS_FAST_INT;
+    }
+    if (_microprotocols_is_default(&PyFloat_Type, &pfloatType)) {
+        psyco_adapters_fast |= ADAPTERS_FAST_FLOAT;
+    }
+    if (_microprotocols_is_default(&PyBool_Type, &pbooleanType)) {
+        psyco_adapters_fast |= ADAPTERS_FAST_BOOL;
+    }
+    if (_microprotocols_is_default(&PyString_Type, &qstringType)
+            && _microprotocols_is_default(&PyUnicode_Type, &qstringType)) {
+        psyco_adapters_fast |= ADAPTERS_FAST_STRING;
+    }
+    if (_microprotocols_is_default(&PyBuffer_Type, &binaryType)) {
+        psyco_adapters_fast |= ADAPTERS_FAST_BINARY;
+    }
+
+    psyco_adapters_generation = registry_generation;
+}
+
+/* microprotocols_fast - return the builtin types adapted by default */
+
+int
+microprotocols_fast(void)
+{
+    _microprotocols_check_cache();
+    return psyco_adapters_fast;
 }
 
 /* Check if one of `obj` superclasses has an adapter for `proto`.
@@ -124,6 +213,42 @@ _get_superclass_adapter(PyObject *obj, PyObject *proto)
 }
 
 
+/* Return a *borrowed reference* to the adapter of `obj` to ISQLQuote, from
+ * its type or one of its superclasses, or Py_None if there is none.
+ */
+static PyObject *
+_microprotocols_lookup(PyObject *obj)
+{
+    PyObject *type = (PyObject *)Py_TYPE(obj);
+    PyObject *key, *adapter;
+
+    _microprotocols_check_cache();
+    if ((adapter = PyDict_GetItem(psyco_adapters_cache, type))) {
+        return adapter;
+    }
+
+    if (!(key = PyTuple_Pack(2, type, (PyObject*)&isqlquoteType))) {
+        return NULL;
+    }
+    adapter = PyDict_GetItem(psyco_adapters, key);
+    Py_DECREF(key);
+
+    if (!adapter) {
+        adapter = _get_superclass_adapter(obj, (PyObject*)&isqlquoteType);
+    }
+    if (!adapter) {
+        adapter = Py_None;
+    }
+
+    if (PyDict_Size(psyco_adapters_cache) >= ADAPTERS_CACHE_MAX) {
+        PyDict_Clear(psyco_adapters_cache);
+    }
+    if (PyDict_SetItem(psyco_adapters_cache, type, adapter) < 0) {
+        return NULL;
+    }
+    return adapter;
+}
+
 /* microprotocols_adapt - adapt an object to the built-in protocol */
 
 PyObject *
@@ -144,18 +269,28 @@ microprotocols_adapt(PyObject *obj, PyObject *proto, PyObject *alt)
     Dprintf("microprotocols_adapt: trying to adapt %s", obj->ob_type->tp_name);
 
     /* look for an adapter in the registry */
-    key = PyTuple_Pack(2, Py_TYPE(obj), proto);
-    adapter = PyDict_GetItem(psyco_adapters, key);
-    Py_DECREF(key);
-    if (adapter) {
-        adapted = PyObject_CallFunctionObjArgs(adapter, obj, NULL);
-        return adapted;
+    if (proto == (PyObject*)&isqlquoteType) {
+        /* the adapter of the type is cached, even if missing */
+        if (!(adapter = _microprotocols_lookup(obj))) { return NULL; }
+        if (adapter != Py_None) {
+            adapted = PyObject_CallFunctionObjArgs(adapter, obj, NULL);
+            return adapted;
+        }
     }
+    else {
+        if (!(key = PyTuple_Pack(2, Py_TYPE(obj), proto))) { return NULL; }
+        adapter = PyDict_GetItem(psyco_adapters, key);
+        Py_DECREF(key);
+        if (adapter) {
+            adapted = PyObject_CallFunctionObjArgs(adapter, obj, NULL);
+            return adapted;
+        }
 
-    /* Check if a superclass can be adapted and use the same adapter. */
-    if (NULL != (adapter = _get_superclass_adapter(obj, proto))) {
-        adapted = PyObject_CallFunctionObjArgs(adapter, obj, NULL);
-        return adapted;
+        /* Check if a superclass can be adapted and use the same adapter. */
+        if (NULL != (adapter = _get_superclass_adapter(obj, proto))) {
+            adapted = PyObject_CallFunctionObjArgs(adapter, obj, NULL);
+            return adapted;
+        }
     }
 
     /* try to have the protocol adapt this object*/
@@ -202,18 +337,14 @@ microprotocols_adapt(PyObject *obj, PyObject *proto, PyObject *alt)
     return NULL;
 }
 
-/* microprotocol_getquoted - utility function that adapt and call getquoted */
+/* prepare an adapted object passing it the connection and call its
+   getquoted method */
 
-PyObject *
-microprotocol_getquoted(PyObject *obj, connectionObject *conn)
+static PyObject *
+_microprotocol_quote_adapted(PyObject *adapted, connectionObject *conn)
 {
     PyObject *res = NULL;
     PyObject *prepare = NULL;
-    PyObject *adapted;
-
-    if (!(adapted = microprotocols_adapt(obj, (PyObject*)&isqlquoteType, NULL))) {
-       goto exit;
-    }
 
     Dprintf("microprotocol_getquoted: adapted to %s",
             adapted->ob_type->tp_name);
@@ -223,11 +354,12 @@ microprotocol_getquoted(PyObject *obj, connectionObject *conn)
         if ((prepare = PyObject_GetAttrString(adapted, "prepare"))) {
             res = PyObject_CallFunctionObjArgs(
                 prepare, (PyObject *)conn, NULL);
+            Py_DECREF(prepare);
             if (res) {
                 Py_DECREF(res);
                 res = NULL;
             } else {
-                goto exit;
+                return NULL;
             }
         }
         else {
@@ -238,16 +370,109 @@ microprotocol_getquoted(PyObject *obj, connectionObject *conn)
 
     /* call the getquoted method on adapted (that should exist because we
        adapted to the right protocol) */
-    res = PyObject_CallMethod(adapted, "getquoted", NULL);
+    return PyObject_CallMethod(adapted, "getquoted", NULL);
+}
+
+/* quote the builtin types adapted by the default adapters without
+   creating the adapter, which would be allocated, tracked by the GC and
+   prepared only to be thrown away. Return NULL without an exception set if
+   obj is not one of them */
+
+static PyObject *
+_microprotocol_quote_builtin(PyObject *obj, connectionObject *conn)
+{
+    if (obj == Py_None)
+        return PyString_FromString("NULL");
+
+    _microprotocols_check_cache();
+
+    if (PyInt_CheckExact(obj) || PyLong_CheckExact(obj)) {
+        if (psyco_adapters_fast & ADAPTERS_FAST_INT)
+            return PyObject_Str(obj);
+    }
+    else if (PyFloat_CheckExact(obj)) {
+        if (psyco_adapters_fast & ADAPTERS_FAST_FLOAT)
+            return psyco_pfloat_quote(obj);
+    }
+    else if (PyBool_Check(obj)) {
+        if (psyco_adapters_fast & ADAPTERS_FAST_BOOL)
+            return psyco_pboolean_quote(obj);
+    }
+    else if (PyString_CheckExact(obj) || PyUnicode_CheckExact(obj)) {
+        if (psyco_adapters_fast & ADAPTERS_FAST_STRING)
+            return psyco_qstring_quote(obj, (PyObject *)conn);
+    }
+    else if (PyBuffer_Check(obj)) {
+        if (psyco_adapters_fast & ADAPTERS_FAST_BINARY)
+            return psyco_binary_quote(obj, (PyObject *)conn);
+    }
+
+    return NULL;
+}
+
+/* microprotocol_getquoted - utility function that adapt and call getquoted */
+
+PyObject *
+microprotocol_getquoted(PyObject *obj, connectionObject *conn)
+{
+    PyObject *res = NULL;
+    PyObject *adapted;
+
+    if ((res = _microprotocol_quote_builtin(obj, conn)) || PyErr_Occurred()) {
+        return res;
+    }
+
+    if (!(adapted = microprotocols_adapt(obj, (PyObject*)&isqlquoteType, NULL))) {
+       return NULL;
+    }
 
-exit:
-    Py_XDECREF(adapted);
-    Py_XDECREF(prepare);
+    res = _microprotocol_quote_adapted(adapted, conn);
+    Py_DECREF(adapted);
 
     /* we return res with one extra reference, the caller shall free it */
     return res;
 }
 
+/* microprotocol_getquoted_cached - as above, reusing the adapter found in
+   the registry for the previous object, if it has the same type
+
+   *cache is a new reference to the last adapter used (or NULL) and must be
+   released by the caller.
+*/
+
+PyObject *
+microprotocol_getquoted_cached(PyObject *obj, connectionObject *conn,
+                               PyTypeObject **type, PyObject **cache)
+{
+    PyObject *res, *adapter, *adapted;
+
+    if ((res = _microprotocol_quote_builtin(obj, conn)) || PyErr_Occurred()) {
+        return res;
+    }
+
+    if (*cache == NULL || *type != Py_TYPE(obj)) {
+        Py_CLEAR(*cache);
+        *type = Py_TYPE(obj);
+
+        if (!(adapter = _microprotocols_lookup(obj))) { return NULL; }
+
+        /* not registered: go the long way */
+        if (adapter == Py_None) {
+            return microprotocol_getquoted(obj, conn);
+        }
+        Py_INCREF(adapter);
+        *cache = adapter;
+    }
+
+    if (!(adapted = PyObject_CallFunctionObjArgs(*cache, obj, NULL))) {
+        return NULL;
+    }
+    res = _microprotocol_quote_adapted(adapted, conn);
+    Py_DECREF(adapted);
+
+    return res;
+}
+
 
 /** module-level functions **/
 
@@ -260,3 +485,17 @@ psyco_microprotocols_adapt(cursorObject *self, PyObject *args)
     if (!PyArg_ParseTuple(args, "O|OO", &obj, &proto, &alt)) return NULL;
     return microprotocols_adapt(obj, proto, alt);
 }
+
+PyObject *
+psyco_microprotocols_register(cursorObject *self, PyObject *args)
+{
+    PyObject *type, *adapter;
+
+    if (!PyArg_ParseTuple(args, "OO", &type, &adapter)) return NULL;
+    if (microprotocols_add((PyTypeObject *)type, NULL, adapter) < 0) {
+        return NULL;
+    }
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
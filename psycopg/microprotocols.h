@@ -46,6 +46,14 @@ extern HIDDEN PyObject *psyco_adapters;
 #define MICROPROTOCOLS_GETSTRING_NAME "getstring"
 #define MICROPROTOCOLS_GETBINARY_NAME "getbinary"
 
+/* the builtin types still adapted by the default adapters, that can be
+   quoted without going through the registry */
+#define ADAPTERS_FAST_INT      0x01
+#define ADAPTERS_FAST_FLOAT    0x02
+#define ADAPTERS_FAST_BOOL     0x04
+#define ADAPTERS_FAST_STRING   0x08
+#define ADAPTERS_FAST_BINARY   0x10
+
 /** exported functions **/
 
 /* used by module.c to init the microprotocols system */
@@ -53,14 +61,24 @@ HIDDEN int microprotocols_init(PyObject *dict);
 HIDDEN int microprotocols_add(
     PyTypeObject *type, PyObject *proto, PyObject *cast);
 
+HIDDEN int microprotocols_fast(void);
+
 HIDDEN PyObject *microprotocols_adapt(
     PyObject *obj, PyObject *proto, PyObject *alt);
 HIDDEN PyObject *microprotocol_getquoted(
     PyObject *obj, connectionObject *conn);
+HIDDEN PyObject *microprotocol_getquoted_cached(
+    PyObject *obj, connectionObject *conn,
+    PyTypeObject **type, PyObject **cache);
 
 HIDDEN PyObject *
     psyco_microprotocols_adapt(cursorObject *self, PyObject *args);
 #define psyco_microprotocols_adapt_doc \
     "adapt(obj, protocol, alternate) -> object -- adapt obj to given protocol"
+HIDDEN PyObject *
+    psyco_microprotocols_register(cursorObject *self, PyObject *args);
+#define psyco_microprotocols_register_doc \
+    "register_adapter(type, adapter) -> None -- " \
+    "register adapter as the ISQLQuote adapter for type"
 
 #endif /* !defined(PSYCOPG_MICROPROTOCOLS_H) */
@@ -41,4 +41,7 @@ typedef struct {
 
 } NotifyObject;
 
+HIDDEN PyObject *notify_from_values(PyObject *pid, PyObject *channel,
+                                    PyObject *payload);
+
 #endif /* PSYCOPG_NOTIFY_H */
@@ -100,6 +100,29 @@ notify_init(NotifyObject *self, PyObject *args, PyObject *kwargs)
     return 0;
 }
 
+/* Create a Notify object without parsing the constructor arguments.
+
+   Used to build the notifications received by the connection: the references
+   to the arguments are borrowed. */
+PyObject *
+notify_from_values(PyObject *pid, PyObject *channel, PyObject *payload)
+{
+    NotifyObject *self;
+
+    if (!(self = (NotifyObject *)NotifyType.tp_alloc(&NotifyType, 0))) {
+        return NULL;
+    }
+
+    Py_INCREF(pid);
+    self->pid = pid;
+    Py_INCREF(channel);
+    self->channel = channel;
+    Py_INCREF(payload);
+    self->payload = payload;
+
+    return (PyObject *)self;
+}
+
 static int
 notify_traverse(NotifyObject *self, visitproc visit, void *arg)
 {
@@ -34,7 +34,9 @@
 #define MACADDROID 829
 #define INETOID 869
 #define CIDROID 650
+#define TEXTARRAYOID 1009
 #define INT4ARRAYOID 1007
+#define INT8ARRAYOID 1016
 #define ACLITEMOID 1033
 #define BPCHAROID 1042
 #define VARCHAROID 1043
@@ -0,0 +1,85 @@
+/* pool.h - definition for the native connection pool
+ *
+ * Copyright (C) 2010 Federico Di Gregorio <fog@debian.org>
+ *
+ * This file is part of psycopg.
+ *
+ * psycopg2 is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link this program with the OpenSSL library (or with
+ * modified versions of OpenSSL that use the same license as OpenSSL),
+ * and distribute linked combinations including the two.
+ *
+ * You must obey the GNU Lesser General Public License in all respects for
+ * all of the code used other than OpenSSL.
+ *
+ * psycopg2 is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ */
+
+
+#ifndef PSYCOPG_POOL_H
+#define PSYCOPG_POOL_H 1
+
+#include <Python.h>
+
+#include "psycopg/config.h"
+#include "psycopg/connection.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern HIDDEN PyTypeObject poolType;
+
+/* the state of a pool slot */
+#define POOL_SLOT_EMPTY       0
+#define POOL_SLOT_CONNECTING  1
+#define POOL_SLOT_IDLE        2
+#define POOL_SLOT_USED        3
+
+/* The free list and the slots are only changed holding the GIL and without
+   calling back into Python, so checkout and return need no other lock. The
+   mutex and the condition are only used by the threads waiting for a slot,
+   which wait with the GIL released. */
+typedef struct {
+    PyObject_HEAD
+
+    int minconn;
+    int maxconn;
+    int closed;
+
+    PyObject *args;             /* the arguments passed to connect() */
+    PyObject *kwargs;
+
+    connectionObject **conns;   /* maxconn slots */
+    char *state;                /* POOL_SLOT_* for each slot */
+    double *created;            /* when the connection was opened */
+    double *lastuse;            /* when the connection was returned */
+    int *free;                  /* stack of the idle slots */
+    int nfree;
+    int size;                   /* slots not empty */
+
+    double max_lifetime;        /* close connections older than this */
+    double max_idle;            /* close connections idle longer than this */
+    PyObject *result_cache;     /* set on the connections checked out */
+
+    long generation;            /* bumped every time a slot is released */
+    int waiting;                /* number of threads waiting for a slot */
+    pthread_mutex_t lock;
+#ifndef _WIN32
+    pthread_cond_t cond;
+#endif
+} poolObject;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !defined(PSYCOPG_POOL_H) */
@@ -0,0 +1,936 @@
+/* pool_type.c - the native connection pool
+ *
+ * Copyright (C) 2010 Federico Di Gregorio <fog@debian.org>
+ *
+ * This file is part of psycopg.
+ *
+ * psycopg2 is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link this program with the OpenSSL library (or with
+ * modified versions of OpenSSL that use the same license as OpenSSL),
+ * and distribute linked combinations including the two.
+ *
+ * You must obey the GNU Lesser General Public License in all respects for
+ * all of the code used other than OpenSSL.
+ *
+ * psycopg2 is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <structmember.h>
+#include <errno.h>
+#ifndef _WIN32
+#include <sys/time.h>
+#endif
+
+#define PSYCOPG_MODULE
+#include "psycopg/config.h"
+#include "psycopg/python.h"
+#include "psycopg/psycopg.h"
+#include "psycopg/pqpath.h"
+#include "psycopg/green.h"
+#include "psycopg/pool.h"
+#include "psycopg/resultcache.h"
+
+
+/* pool.PoolError, looked up the first time a pool is created */
+static PyObject *PoolError = NULL;
+
+static void
+pool_set_error(const char *msg)
+{
+    PyErr_SetString(PoolError ? PoolError : OperationalError, msg);
+}
+
+/* wake up the threads waiting for a slot */
+static void
+pool_notify(poolObject *self)
+{
+    pthread_mutex_lock(&self->lock);
+    self->generation++;
+#ifndef _WIN32
+    if (self->waiting) pthread_cond_broadcast(&self->cond);
+#endif
+    pthread_mutex_unlock(&self->lock);
+}
+
+/* wait with the GIL released until a slot is released
+
+   deadline < 0 waits forever. Return 0 if woken up, -1 on timeout. */
+static int
+pool_wait(poolObject *self, long generation, double deadline)
+{
+    int timedout = 0;
+#ifndef _WIN32
+    struct timespec ts;
+    struct timeval tv;
+    double abstime;
+
+    /* the condition waits until a time of the system clock, while the
+       deadline is on the monotonic clock of psycopg_now() */
+    if (deadline >= 0) {
+        gettimeofday(&tv, NULL);
+        abstime = tv.tv_sec + tv.tv_usec / 1e6 + (deadline - psycopg_now());
+        ts.tv_sec = (time_t)abstime;
+        ts.tv_nsec = (long)((abstime - ts.tv_sec) * 1e9);
+    }
+#endif
+
+    Py_BEGIN_ALLOW_THREADS;
+    pthread_mutex_lock(&self->lock);
+    while (self->generation == generation) {
+#ifndef _WIN32
+        if (deadline < 0) {
+            pthread_cond_wait(&self->cond, &self->lock);
+        }
+        else if (pthread_cond_timedwait(&self->cond, &self->lock, &ts)
+                == ETIMEDOUT) {
+            timedout = 1;
+            break;
+        }
+#else
+        pthread_mutex_unlock(&self->lock);
+        if (deadline >= 0 && psycopg_now() >= deadline) {
+            timedout = 1;
+            pthread_mutex_lock(&self->lock);
+            break;
+        }
+        Sleep(5);
+        pthread_mutex_lock(&self->lock);
+#endif
+    }
+    pthread_mutex_unlock(&self->lock);
+    Py_END_ALLOW_THREADS;
+
+    return timedout ? -1 : 0;
+}
+
+/* empty a slot and return the reference to its connection */
+static connectionObject *
+pool_release(poolObject *self, int i)
+{
+    connectionObject *conn = self->conns[i];
+
+    Dprintf("pool_release: dropping connection %p from slot %d", conn, i);
+
+    self->conns[i] = NULL;
+    self->state[i] = POOL_SLOT_EMPTY;
+    self->size--;
+    return conn;
+}
+
+/* close a connection released by the pool: this may release the GIL */
+static void
+pool_close(connectionObject *conn)
+{
+    if (conn) {
+        if (!conn->closed) conn_close(conn);
+        Py_DECREF(conn);
+    }
+}
+
+/* empty a slot, closing its connection */
+static void
+pool_discard(poolObject *self, int i)
+{
+    pool_close(pool_release(self, i));
+    pool_notify(self);
+}
+
+/* a connection can be used only if libpq says it is still good */
+static int
+pool_conn_ok(connectionObject *conn)
+{
+    return !conn->closed && conn->pgconn
+        && PQstatus(conn->pgconn) == CONNECTION_OK;
+}
+
+/* check an idle connection: reading what the server sent without waiting
+   finds the sockets closed by the server */
+static int
+pool_conn_alive(connectionObject *conn)
+{
+    return pool_conn_ok(conn)
+        && PQconsumeInput(conn->pgconn)
+        && PQstatus(conn->pgconn) == CONNECTION_OK
+        && PQtransactionStatus(conn->pgconn) == PQTRANS_IDLE;
+}
+
+static int
+pool_expired(poolObject *self, int i, double now)
+{
+    return self->max_lifetime > 0
+        && now - self->created[i] >= self->max_lifetime;
+}
+
+/* reserve an empty slot: the caller must have checked there is one */
+static int
+pool_reserve(poolObject *self)
+{
+    int i;
+
+    for (i = 0; i < self->maxconn; i++) {
+        if (self->state[i] == POOL_SLOT_EMPTY) break;
+    }
+    self->state[i] = POOL_SLOT_CONNECTING;
+    self->size++;
+    return i;
+}
+
+/* call connect() with the pool arguments */
+static connectionObject *
+pool_new_conn(poolObject *self, PyObject *kwargs)
+{
+    PyObject *conn;
+
+    conn = psyco_connect(NULL, self->args, kwargs);
+    if (conn && !PyObject_TypeCheck(conn, &connectionType)) {
+        PyErr_SetString(PyExc_TypeError,
+            "connection_factory must return a connection");
+        Py_CLEAR(conn);
+    }
+    return (connectionObject *)conn;
+}
+
+/* create a connection in an empty slot and leave it checked out
+
+   Return the slot, -1 on error. */
+static int
+pool_connect(poolObject *self)
+{
+    connectionObject *conn;
+    int i;
+
+    /* reserve the slot: connect() releases the GIL */
+    i = pool_reserve(self);
+
+    conn = pool_new_conn(self, self->kwargs);
+    if (conn && self->closed) {
+        pool_close(conn);
+        conn = NULL;
+        pool_set_error("connection pool is closed");
+    }
+    if (conn == NULL) {
+        pool_release(self, i);
+        pool_notify(self);
+        return -1;
+    }
+
+    Dprintf("pool_connect: new connection %p in slot %d", conn, i);
+    self->conns[i] = conn;
+    self->state[i] = POOL_SLOT_USED;
+    self->created[i] = psycopg_now();
+    return i;
+}
+
+/* return a new reference to a connection checked out */
+static connectionObject *
+pool_lend(poolObject *self, connectionObject *conn)
+{
+    Py_XINCREF(self->result_cache);
+    Py_XDECREF(conn->result_cache);
+    conn->result_cache = self->result_cache;
+
+    Py_INCREF(conn);
+    return conn;
+}
+
+/* get a connection from the free list, a new one or wait for one */
+static connectionObject *
+pool_checkout(poolObject *self, double timeout)
+{
+    double deadline = timeout > 0 ? psycopg_now() + timeout : timeout;
+    connectionObject *conn;
+    long generation;
+    int i, res;
+
+    for (;;) {
+        if (self->closed) {
+            pool_set_error("connection pool is closed");
+            return NULL;
+        }
+
+        while (self->nfree > 0) {
+            i = self->free[--self->nfree];
+            conn = self->conns[i];
+            if (!pool_conn_ok(conn) || pool_expired(self, i, psycopg_now())) {
+                pool_discard(self, i);
+                continue;
+            }
+            self->state[i] = POOL_SLOT_USED;
+            return pool_lend(self, conn);
+        }
+
+        if (self->size < self->maxconn) {
+            if ((i = pool_connect(self)) < 0) { return NULL; }
+            return pool_lend(self, self->conns[i]);
+        }
+
+        if (timeout == 0) {
+            pool_set_error("connection pool exhausted");
+            return NULL;
+        }
+
+        generation = self->generation;
+        self->waiting++;
+        res = pool_wait(self, generation, deadline);
+        self->waiting--;
+        if (res < 0) {
+            pool_set_error("timeout waiting for a connection");
+            return NULL;
+        }
+    }
+}
+
+/* put a checked out connection back in the free list */
+static void
+pool_checkin(poolObject *self, int i)
+{
+    self->state[i] = POOL_SLOT_IDLE;
+    self->lastuse[i] = psycopg_now();
+    self->free[self->nfree++] = i;
+    pool_notify(self);
+}
+
+/* if the connections can be opened by pool_prewarm() in parallel */
+static int
+pool_can_prewarm(poolObject *self)
+{
+    /* a green connection is opened in async mode anyway; a factory may
+       need a sync connection in __init__() */
+    if (psyco_green()) { return 0; }
+    if (self->kwargs && (PyDict_GetItemString(self->kwargs, "async")
+            || PyDict_GetItemString(self->kwargs, "connection_factory"))) {
+        return 0;
+    }
+    return 1;
+}
+
+/* the states of a connection opened by pool_prewarm(), besides the
+   PSYCO_POLL_* values returned by conn_poll() while connecting */
+#define PREWARM_CONNECTING  PSYCO_POLL_WRITE
+#define PREWARM_READY       -1  /* ready to be put in the free list */
+#define PREWARM_DONE        -2  /* in the free list */
+
+/* open n connections and put them in the free list
+
+   The connections are opened in async mode, polling all the sockets at
+   once, and are turned into sync connections once set up. */
+static int
+pool_prewarm(poolObject *self, int n)
+{
+    PyObject *kwargs = NULL;
+    connectionObject **conns = NULL;
+    int *slots = NULL, *events = NULL;
+    int i, k, nslots = 0, npoll, rv = -1;
+
+    if (n > self->maxconn - self->size) { n = self->maxconn - self->size; }
+    if (n <= 0) { return 0; }
+
+    if (n == 1 || !pool_can_prewarm(self)) {
+        for (k = 0; k < n; k++) {
+            if ((i = pool_connect(self)) < 0) { return -1; }
+            pool_checkin(self, i);
+        }
+        return 0;
+    }
+
+    Dprintf("pool_prewarm: opening %d connections", n);
+
+    if (!(kwargs = self->kwargs ? PyDict_Copy(self->kwargs) : PyDict_New()))
+        goto exit;
+    if (0 != PyDict_SetItemString(kwargs, "async", Py_True)) { goto exit; }
+
+    if (!(slots = PyMem_New(int, n)) || !(events = PyMem_New(int, n))
+            || !(conns = PyMem_New(connectionObject *, n))) {
+        PyErr_NoMemory();
+        goto exit;
+    }
+
+    for (nslots = 0; nslots < n; nslots++) {
+        slots[nslots] = i = pool_reserve(self);
+        events[nslots] = PREWARM_CONNECTING;
+        if (!(conns[nslots] = self->conns[i] = pool_new_conn(self, kwargs))) {
+            nslots++;
+            goto exit;
+        }
+    }
+
+    for (;;) {
+        for (npoll = 0, k = 0; k < nslots; k++) {
+            if (events[k] == PREWARM_READY) { continue; }
+
+            if ((events[k] = conn_poll(conns[k])) == PSYCO_POLL_OK) {
+                if (conn_async_to_sync(conns[k]) < 0) { goto exit; }
+                events[k] = PREWARM_READY;
+                continue;
+            }
+            if (events[k] == PSYCO_POLL_ERROR) { goto exit; }
+            npoll++;
+        }
+        if (npoll == 0) { break; }
+
+        if (conn_poll_wait(conns, events, nslots, -1) < 0) { goto exit; }
+    }
+
+    /* closeall() may have been called while polling */
+    if (self->closed) {
+        pool_set_error("connection pool is closed");
+        goto exit;
+    }
+
+    for (k = 0; k < nslots; k++) {
+        i = slots[k];
+        self->created[i] = psycopg_now();
+        pool_checkin(self, i);
+        events[k] = PREWARM_DONE;
+    }
+    rv = 0;
+
+exit:
+    for (k = 0; k < nslots; k++) {
+        if (events[k] != PREWARM_DONE) {
+            pool_close(pool_release(self, slots[k]));
+        }
+    }
+    if (rv < 0) { pool_notify(self); }
+
+    PyMem_Free(slots);
+    PyMem_Free(events);
+    PyMem_Free(conns);
+    Py_XDECREF(kwargs);
+    return rv;
+}
+
+
+/** public methods **/
+
+#define psyco_pool_getconn_doc \
+"getconn(timeout=None) -> connection -- Get a free connection.\n\n" \
+"Wait at most `timeout` seconds if `maxconn` connections are in use."
+
+static PyObject *
+psyco_pool_getconn(poolObject *self, PyObject *args, PyObject *kwargs)
+{
+    PyObject *pytimeout = Py_None;
+    double timeout = -1;
+    static char *kwlist[] = {"timeout", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|O", kwlist, &pytimeout))
+        return NULL;
+
+    if (pytimeout != Py_None) {
+        timeout = PyFloat_AsDouble(pytimeout);
+        if (timeout == -1 && PyErr_Occurred()) return NULL;
+        if (timeout < 0) {
+            PyErr_SetString(PyExc_ValueError, "timeout must be positive");
+            return NULL;
+        }
+    }
+
+    return (PyObject *)pool_checkout(self, timeout);
+}
+
+#define psyco_pool_putconn_doc \
+"putconn(conn, close=False) -- Put away a connection.\n\n" \
+"Connections broken or not idle, if a rollback cannot fix them, are closed."
+
+static PyObject *
+psyco_pool_putconn(poolObject *self, PyObject *args, PyObject *kwargs)
+{
+    PyObject *pyconn, *pyclose = Py_False;
+    connectionObject *conn;
+    int i, close;
+    static char *kwlist[] = {"conn", "close", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|O", kwlist,
+            &pyconn, &pyclose))
+        return NULL;
+    if ((close = PyObject_IsTrue(pyclose)) < 0) return NULL;
+
+    if (self->closed) {
+        pool_set_error("connection pool is closed");
+        return NULL;
+    }
+
+    for (i = 0; i < self->maxconn; i++) {
+        if ((PyObject *)self->conns[i] == pyconn
+                && self->state[i] == POOL_SLOT_USED)
+            break;
+    }
+    if (i == self->maxconn) {
+        pool_set_error("trying to put unkeyed connection");
+        return NULL;
+    }
+    conn = (connectionObject *)pyconn;
+
+    if (close || !pool_conn_ok(conn) || pool_expired(self, i, psycopg_now())) {
+        pool_discard(self, i);
+        Py_RETURN_NONE;
+    }
+
+    switch (PQtransactionStatus(conn->pgconn)) {
+    case PQTRANS_IDLE:
+        break;
+
+    case PQTRANS_INTRANS:
+    case PQTRANS_INERROR:
+        if (conn->async) {
+            pool_discard(self, i);
+            Py_RETURN_NONE;
+        }
+        /* the rollback releases the GIL: the pool may be closed meanwhile */
+        if (conn_rollback(conn) < 0) PyErr_Clear();
+        if (self->conns[i] != conn || self->state[i] != POOL_SLOT_USED)
+            Py_RETURN_NONE;
+        if (!pool_conn_ok(conn)
+                || PQtransactionStatus(conn->pgconn) != PQTRANS_IDLE) {
+            pool_discard(self, i);
+            Py_RETURN_NONE;
+        }
+        break;
+
+    default:
+        pool_discard(self, i);
+        Py_RETURN_NONE;
+    }
+
+    pool_checkin(self, i);
+    Py_RETURN_NONE;
+}
+
+#define psyco_pool_closeall_doc \
+"closeall() -- Close all the connections, the ones in use too."
+
+static PyObject *
+psyco_pool_closeall(poolObject *self)
+{
+    int i;
+
+    if (self->closed) {
+        pool_set_error("connection pool is closed");
+        return NULL;
+    }
+
+    self->closed = 1;
+    self->nfree = 0;
+    for (i = 0; i < self->maxconn; i++) {
+        if (self->state[i] == POOL_SLOT_IDLE
+                || self->state[i] == POOL_SLOT_USED)
+            pool_discard(self, i);
+    }
+    pool_notify(self);
+
+    Py_RETURN_NONE;
+}
+
+#define psyco_pool_maintain_doc \
+"maintain() -- Check the idle connections and open the missing ones.\n\n" \
+"Close the idle connections broken, older than `max_lifetime` or, above\n" \
+"`minconn`, idle for longer than `max_idle`. Then open up to `minconn`\n" \
+"connections, in parallel."
+
+static PyObject *
+psyco_pool_maintain(poolObject *self)
+{
+    connectionObject **drop;
+    double now = psycopg_now();
+    int i, k, ndrop = 0, nfree = 0;
+
+    if (self->closed) {
+        pool_set_error("connection pool is closed");
+        return NULL;
+    }
+
+    if (!(drop = PyMem_New(connectionObject *, self->maxconn))) {
+        PyErr_NoMemory();
+        return NULL;
+    }
+
+    /* the free list bottom holds the connections unused for longest.
+       Release all the slots before closing: closing releases the GIL */
+    for (k = 0; k < self->nfree; k++) {
+        i = self->free[k];
+        if (!pool_conn_alive(self->conns[i]) || pool_expired(self, i, now)
+                || (self->max_idle > 0 && self->size > self->minconn
+                    && now - self->lastuse[i] >= self->max_idle)) {
+            drop[ndrop++] = pool_release(self, i);
+        }
+        else {
+            self->free[nfree++] = i;
+        }
+    }
+    self->nfree = nfree;
+
+    Dprintf("pool_maintain: dropping %d connections", ndrop);
+    for (k = 0; k < ndrop; k++) {
+        pool_close(drop[k]);
+    }
+    PyMem_Free(drop);
+    if (ndrop) { pool_notify(self); }
+
+    if (!self->closed && pool_prewarm(self, self->minconn - self->size) < 0)
+        return NULL;
+
+    Py_RETURN_NONE;
+}
+
+
+/** the pool object **/
+
+/* the time limits: None or 0 to disable them */
+
+static int
+pool_set_limit(double *limit, PyObject *value)
+{
+    double v = 0;
+
+    if (value == NULL) {
+        PyErr_SetString(PyExc_TypeError, "can't delete the attribute");
+        return -1;
+    }
+    if (value != Py_None) {
+        v = PyFloat_AsDouble(value);
+        if (v == -1 && PyErr_Occurred()) { return -1; }
+        if (v < 0) {
+            PyErr_SetString(PyExc_ValueError, "the value must be positive");
+            return -1;
+        }
+    }
+    *limit = v;
+    return 0;
+}
+
+static PyObject *
+pool_get_limit(double limit)
+{
+    if (limit > 0) { return PyFloat_FromDouble(limit); }
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+static PyObject *
+psyco_pool_get_max_lifetime(poolObject *self)
+{
+    return pool_get_limit(self->max_lifetime);
+}
+
+static int
+psyco_pool_set_max_lifetime(poolObject *self, PyObject *value)
+{
+    return pool_set_limit(&self->max_lifetime, value);
+}
+
+static PyObject *
+psyco_pool_get_max_idle(poolObject *self)
+{
+    return pool_get_limit(self->max_idle);
+}
+
+static int
+psyco_pool_set_max_idle(poolObject *self, PyObject *value)
+{
+    return pool_set_limit(&self->max_idle, value);
+}
+
+static PyObject *
+psyco_pool_get_result_cache(poolObject *self)
+{
+    PyObject *rv = self->result_cache ? self->result_cache : Py_None;
+    Py_INCREF(rv);
+    return rv;
+}
+
+static int
+psyco_pool_set_result_cache(poolObject *self, PyObject *value)
+{
+    if (value == NULL) {
+        PyErr_SetString(PyExc_TypeError, "can't delete the attribute");
+        return -1;
+    }
+    if (value != Py_None && !resultcache_Check(value)) {
+        PyErr_SetString(PyExc_TypeError,
+            "result_cache must be a ResultCache or None");
+        return -1;
+    }
+
+    Py_CLEAR(self->result_cache);
+    if (value != Py_None) {
+        Py_INCREF(value);
+        self->result_cache = value;
+    }
+    return 0;
+}
+
+static PyObject *
+psyco_pool_get_closed(poolObject *self)
+{
+    PyObject *rv = self->closed ? Py_True : Py_False;
+    Py_INCREF(rv);
+    return rv;
+}
+
+static PyObject *
+psyco_pool_get_size(poolObject *self)
+{
+    return PyInt_FromLong(self->size);
+}
+
+static PyObject *
+psyco_pool_get_idle(poolObject *self)
+{
+    return PyInt_FromLong(self->nfree);
+}
+
+static struct PyMethodDef poolObject_methods[] = {
+    {"getconn", (PyCFunction)psyco_pool_getconn,
+     METH_VARARGS|METH_KEYWORDS, psyco_pool_getconn_doc},
+    {"putconn", (PyCFunction)psyco_pool_putconn,
+     METH_VARARGS|METH_KEYWORDS, psyco_pool_putconn_doc},
+    {"closeall", (PyCFunction)psyco_pool_closeall,
+     METH_NOARGS, psyco_pool_closeall_doc},
+    {"maintain", (PyCFunction)psyco_pool_maintain,
+     METH_NOARGS, psyco_pool_maintain_doc},
+    {NULL}
+};
+
+static struct PyMemberDef poolObject_members[] = {
+    {"minconn", T_INT, offsetof(poolObject, minconn), RO,
+        "The number of connections opened by the pool in advance."},
+    {"maxconn", T_INT, offsetof(poolObject, maxconn), RO,
+        "The maximum number of connections of the pool."},
+    {NULL}
+};
+
+static struct PyGetSetDef poolObject_getsets[] = {
+    { "closed", (getter)psyco_pool_get_closed, NULL,
+      "True if `closeall()` was called.", NULL },
+    { "size", (getter)psyco_pool_get_size, NULL,
+      "The number of connections currently open by the pool.", NULL },
+    { "idle", (getter)psyco_pool_get_idle, NULL,
+      "The number of connections ready to be checked out.", NULL },
+    { "max_lifetime", (getter)psyco_pool_get_max_lifetime,
+      (setter)psyco_pool_set_max_lifetime,
+      "Seconds after which a connection is closed, None to keep it.", NULL },
+    { "max_idle", (getter)psyco_pool_get_max_idle,
+      (setter)psyco_pool_set_max_idle,
+      "Seconds after which an idle connection above `minconn` is closed\n"
+      "by `maintain()`, None to keep it.", NULL },
+    { "result_cache", (getter)psyco_pool_get_result_cache,
+      (setter)psyco_pool_set_result_cache,
+      "The `ResultCache` set on the connections checked out, or None.",
+      NULL },
+    {NULL}
+};
+
+static int
+pool_setup(poolObject *self, int minconn, int maxconn,
+           PyObject *args, PyObject *kwargs)
+{
+    Dprintf("pool_setup: init pool object at %p, minconn %d, maxconn %d",
+            self, minconn, maxconn);
+
+    if (maxconn < 1 || minconn < 0 || minconn > maxconn) {
+        PyErr_SetString(PyExc_ValueError,
+            "expected 0 <= minconn <= maxconn and maxconn > 0");
+        return -1;
+    }
+
+    if (!PoolError) {
+        PyObject *m;
+        if (!(m = PyImport_ImportModule("psycopg2.pool"))) { return -1; }
+        PoolError = PyObject_GetAttrString(m, "PoolError");
+        Py_DECREF(m);
+        if (!PoolError) { return -1; }
+    }
+
+    if (!(self->conns = PyMem_New(connectionObject *, maxconn))
+            || !(self->state = PyMem_New(char, maxconn))
+            || !(self->created = PyMem_New(double, maxconn))
+            || !(self->lastuse = PyMem_New(double, maxconn))
+            || !(self->free = PyMem_New(int, maxconn))) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    memset(self->conns, 0, maxconn * sizeof(connectionObject *));
+    memset(self->state, POOL_SLOT_EMPTY, maxconn);
+
+    self->minconn = minconn;
+    self->maxconn = maxconn;
+    Py_INCREF(args);
+    self->args = args;
+    Py_XINCREF(kwargs);
+    self->kwargs = kwargs;
+
+    return pool_prewarm(self, minconn);
+}
+
+static int
+pool_init(PyObject *obj, PyObject *args, PyObject *kwargs)
+{
+    poolObject *self = (poolObject *)obj;
+    PyObject *connargs;
+    int minconn, maxconn, rv;
+
+    if (self->conns) {
+        PyErr_SetString(InterfaceError, "the pool is already initialized");
+        return -1;
+    }
+
+    if (PyTuple_GET_SIZE(args) < 2) {
+        PyErr_SetString(PyExc_TypeError,
+            "NativeConnectionPool() requires minconn and maxconn");
+        return -1;
+    }
+    minconn = (int)PyInt_AsLong(PyTuple_GET_ITEM(args, 0));
+    if (minconn == -1 && PyErr_Occurred()) { return -1; }
+    maxconn = (int)PyInt_AsLong(PyTuple_GET_ITEM(args, 1));
+    if (maxconn == -1 && PyErr_Occurred()) { return -1; }
+
+    if (!(connargs = PyTuple_GetSlice(args, 2, PyTuple_GET_SIZE(args))))
+        return -1;
+    rv = pool_setup(self, minconn, maxconn, connargs, kwargs);
+    Py_DECREF(connargs);
+    return rv;
+}
+
+static PyObject *
+pool_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
+{
+    poolObject *self;
+
+    if (!(self = (poolObject *)type->tp_alloc(type, 0))) { return NULL; }
+
+    pthread_mutex_init(&self->lock, NULL);
+#ifndef _WIN32
+    pthread_cond_init(&self->cond, NULL);
+#endif
+    return (PyObject *)self;
+}
+
+static int
+pool_traverse(poolObject *self, visitproc visit, void *arg)
+{
+    int i;
+
+    Py_VISIT(self->args);
+    Py_VISIT(self->kwargs);
+    Py_VISIT(self->result_cache);
+    if (self->conns) {
+        for (i = 0; i < self->maxconn; i++) {
+            Py_VISIT((PyObject *)self->conns[i]);
+        }
+    }
+    return 0;
+}
+
+static void
+pool_dealloc(PyObject* obj)
+{
+    poolObject *self = (poolObject *)obj;
+    int i;
+
+    PyObject_GC_UnTrack(self);
+
+    /* as the Python pools, don't close the connections: they close when
+       they are no more used */
+    if (self->conns) {
+        for (i = 0; i < self->maxconn; i++) {
+            Py_CLEAR(self->conns[i]);
+        }
+    }
+    PyMem_Free(self->conns);
+    PyMem_Free(self->state);
+    PyMem_Free(self->created);
+    PyMem_Free(self->lastuse);
+    PyMem_Free(self->free);
+    Py_CLEAR(self->args);
+    Py_CLEAR(self->kwargs);
+    Py_CLEAR(self->result_cache);
+
+    pthread_mutex_destroy(&self->lock);
+#ifndef _WIN32
+    pthread_cond_destroy(&self->cond);
+#endif
+
+    Dprintf("pool_dealloc: deleted pool object at %p", obj);
+
+    obj->ob_type->tp_free(obj);
+}
+
+static PyObject *
+pool_repr(poolObject *self)
+{
+    return PyString_FromFormat(
+        "<NativeConnectionPool object at %p; size: %d, idle: %d, closed: %d>",
+        self, self->size, self->nfree, self->closed);
+}
+
+
+/* object type */
+
+#define poolType_doc \
+"NativeConnectionPool(minconn, maxconn, *args, **kwargs) -> new pool\n\n" \
+"A thread-safe connection pool. The connections are created calling\n" \
+"`psycopg2.connect()` with `args` and `kwargs`."
+
+PyTypeObject poolType = {
+    PyObject_HEAD_INIT(NULL)
+    0,
+    "psycopg2.pool.NativeConnectionPool",
+    sizeof(poolObject),
+    0,
+    pool_dealloc, /*tp_dealloc*/
+    0,          /*tp_print*/
+    0,          /*tp_getattr*/
+    0,          /*tp_setattr*/
+    0,          /*tp_compare*/
+    (reprfunc)pool_repr, /*tp_repr*/
+    0,          /*tp_as_number*/
+    0,          /*tp_as_sequence*/
+    0,          /*tp_as_mapping*/
+    0,          /*tp_hash */
+
+    0,          /*tp_call*/
+    (reprfunc)pool_repr, /*tp_str*/
+    0,          /*tp_getattro*/
+    0,          /*tp_setattro*/
+    0,          /*tp_as_buffer*/
+
+    Py_TPFLAGS_DEFAULT|Py_TPFLAGS_BASETYPE|Py_TPFLAGS_HAVE_GC, /*tp_flags*/
+    poolType_doc, /*tp_doc*/
+
+    (traverseproc)pool_traverse, /*tp_traverse*/
+    0,          /*tp_clear*/
+
+    0,          /*tp_richcompare*/
+    0,          /*tp_weaklistoffset*/
+
+    0,          /*tp_iter*/
+    0,          /*tp_iternext*/
+
+    /* Attribute descriptor and subclassing stuff */
+
+    poolObject_methods, /*tp_methods*/
+    poolObject_members, /*tp_members*/
+    poolObject_getsets, /*tp_getset*/
+    0,          /*tp_base*/
+    0,          /*tp_dict*/
+
+    0,          /*tp_descr_get*/
+    0,          /*tp_descr_set*/
+    0,          /*tp_dictoffset*/
+
+    pool_init,  /*tp_init*/
+    0,          /*tp_alloc*/
+    pool_new,   /*tp_new*/
+    0,          /*tp_free*/
+};
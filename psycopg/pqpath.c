@@ -32,6 +32,13 @@
 #define PY_SSIZE_T_CLEAN
 #include <Python.h>
 #include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#ifndef _WIN32
+#include <poll.h>
+#else
+#define poll WSAPoll
+#endif
 
 #define PSYCOPG_MODULE
 #include "psycopg/config.h"
@@ -40,10 +47,14 @@
 #include "psycopg/pqpath.h"
 #include "psycopg/connection.h"
 #include "psycopg/cursor.h"
+#include "psycopg/lazyrow.h"
 #include "psycopg/green.h"
 #include "psycopg/typecast.h"
 #include "psycopg/pgtypes.h"
+#include "psycopg/copy_binary.h"
+#include "psycopg/copystream.h"
 #include "psycopg/pgversion.h"
+#include "psycopg/registry.h"
 
 
 /* Strip off the severity from a Postgres error message. */
@@ -281,6 +292,106 @@ pq_clear_async(connectionObject *conn)
     }
     Py_XDECREF(conn->async_cursor);
     conn->async_cursor = NULL;
+    pq_clear_async_queue(conn, 0);
+}
+
+/* pq_clear_async_queue - drop the cursors waiting to send their query
+
+   If canceled is set the cursors are marked so that fetching from them
+   raises QueryCanceledError. */
+
+void
+pq_clear_async_queue(connectionObject *conn, int canceled)
+{
+    Py_ssize_t i;
+    cursorObject *curs;
+
+    if (conn->async_queue == NULL) {
+        return;
+    }
+    for (i = 0; i < PyList_GET_SIZE(conn->async_queue); i++) {
+        curs = (cursorObject *)PyList_GET_ITEM(conn->async_queue, i);
+        curs->async_queued = 0;
+        PyMem_Free(curs->async_params);
+        curs->async_params = NULL;
+        if (canceled) { curs->async_canceled = 1; }
+    }
+    Py_CLEAR(conn->async_queue);
+}
+
+/* pq_next_pipelined - pass to the next async query sent in pipeline mode
+
+   read the Sync following the results of the query of conn->async_cursor,
+   which is released, and make the first of the queries pipelined after it
+   the one running. After the last one pipeline mode is exited.
+
+   Return 1 if there is a query running, 0 if the pipeline is finished, -1
+   on error: in this case the queries pipelined and queued are dropped.
+
+   this fucntion locks the connection object
+   this function call Py_*_ALLOW_THREADS macros */
+
+int
+pq_next_pipelined(connectionObject *conn)
+{
+#ifdef HAVE_PQPIPELINE
+    PGresult *res;
+    cursorObject *curs;
+    Py_ssize_t i;
+    int last, ok;
+
+    Py_CLEAR(conn->async_cursor);
+    conn->async_sync = 0;
+    last = (conn->async_sent == NULL
+            || PyList_GET_SIZE(conn->async_sent) == 0);
+
+    Py_BEGIN_ALLOW_THREADS;
+    pthread_mutex_lock(&(conn->lock));
+    res = PQgetResult(conn->pgconn);
+    ok = (res && PQresultStatus(res) == PGRES_PIPELINE_SYNC);
+    IFCLEARPGRES(res);
+    if (ok && last) {
+        Dprintf("pq_next_pipelined: exiting pipeline mode");
+        ok = PQexitPipelineMode(conn->pgconn);
+    }
+    pthread_mutex_unlock(&(conn->lock));
+    Py_END_ALLOW_THREADS;
+
+    if (ok && last) {
+        conn->async_pipeline = 0;
+        return 0;
+    }
+    if (ok) {
+        curs = (cursorObject *)PyList_GET_ITEM(conn->async_sent, 0);
+        Py_INCREF(curs);
+        if (0 == PySequence_DelItem(conn->async_sent, 0)) {
+            curs->async_queued = 0;
+            conn->async_cursor = (PyObject *)curs;
+            conn->async_status = ASYNC_READ;
+            return 1;
+        }
+        Py_DECREF(curs);
+    }
+    else {
+        PyErr_SetString(OperationalError, *PQerrorMessage(conn->pgconn) ?
+            PQerrorMessage(conn->pgconn) : "pipeline synchronization lost");
+    }
+
+    /* the results can't be matched to the cursors anymore */
+    if (conn->async_sent) {
+        for (i = 0; i < PyList_GET_SIZE(conn->async_sent); i++) {
+            curs = (cursorObject *)PyList_GET_ITEM(conn->async_sent, i);
+            curs->async_queued = 0;
+        }
+        Py_CLEAR(conn->async_sent);
+    }
+    pq_clear_async_queue(conn, 0);
+    conn->async_pipeline = 0;
+    return -1;
+#else
+    Py_CLEAR(conn->async_cursor);
+    return 0;
+#endif
 }
 
 
@@ -306,6 +417,52 @@ pq_set_non_blocking(connectionObject *conn, int arg, int pyerr)
 }
 
 
+/* update the stats for a command sent to the backend
+
+   The function should be called holding the connection lock. */
+
+static void
+_pq_stats_sent(connectionObject *conn, const char *query,
+               const pqParams *params)
+{
+    PY_LONG_LONG n = 0;
+    int i;
+
+    if (!conn->collect_stats) { return; }
+
+    conn->stats.queries++;
+    if (query) { n += strlen(query); }
+    if (params) {
+        for (i = 0; i < params->nparams; i++) {
+            if (!params->values[i]) { continue; }
+            n += (params->formats && params->formats[i]) ?
+                params->lengths[i] : strlen(params->values[i]);
+        }
+    }
+    conn->stats.bytes_sent += n;
+}
+
+/* update the stats with the size of the values in a result */
+
+static void
+_pq_stats_received(connectionObject *conn, PGresult *pgres)
+{
+    PY_LONG_LONG n = 0;
+    int i, j, nrows, nfields;
+
+    if (!conn->collect_stats || !pgres) { return; }
+
+    nrows = PQntuples(pgres);
+    nfields = PQnfields(pgres);
+    for (i = 0; i < nrows; i++) {
+        for (j = 0; j < nfields; j++) {
+            n += PQgetlength(pgres, i, j);
+        }
+    }
+    conn->stats.bytes_received += n;
+}
+
+
 /* pg_execute_command_locked - execute a no-result query on a locked connection.
 
    This function should only be called on a locked connection without
@@ -324,11 +481,13 @@ pq_execute_command_locked(connectionObject *conn, const char *query,
                           PyThreadState **tstate)
 {
     int pgstatus, retvalue = -1;
+    double t0 = CONN_STATS_START(conn);
 
     Dprintf("pq_execute_command_locked: pgconn = %p, query = %s",
             conn->pgconn, query);
     *error = NULL;
 
+    _pq_stats_sent(conn, query, NULL);
     if (!psyco_green()) {
         *pgres = PQexec(conn->pgconn, query);
     } else {
@@ -336,6 +495,8 @@ pq_execute_command_locked(connectionObject *conn, const char *query,
         *pgres = psyco_exec_green(conn, query);
         *tstate = PyEval_SaveThread();
     }
+    CONN_STATS_ADD_TIME(conn, wait_time, t0);
+    conn_read_std_strings(conn);
     if (*pgres == NULL) {
         const char *msg;
 
@@ -388,6 +549,30 @@ pq_complete_error(connectionObject *conn, PGresult **pgres, char **error)
 }
 
 
+/* Return the command to start a transaction before the next query.
+ *
+ * Return NULL if a transaction is already in progress or if the connection
+ * is in autocommit mode. The command is a single statement, so that it can
+ * be pipelined too. */
+
+static const char *
+_pq_begin_command(connectionObject *conn)
+{
+    if (conn->isolation_level == ISOLATION_LEVEL_AUTOCOMMIT
+            || conn->status != CONN_STATUS_READY) {
+        return NULL;
+    }
+
+    switch (conn->isolation_level) {
+    case ISOLATION_LEVEL_READ_COMMITTED:
+        return "BEGIN ISOLATION LEVEL READ COMMITTED";
+    case ISOLATION_LEVEL_SERIALIZABLE:
+        return "BEGIN ISOLATION LEVEL SERIALIZABLE";
+    default:
+        return "BEGIN";
+    }
+}
+
 /* pq_begin_locked - begin a transaction, if necessary
 
    This function should only be called on a locked connection without
@@ -400,29 +585,69 @@ int
 pq_begin_locked(connectionObject *conn, PGresult **pgres, char **error,
                 PyThreadState **tstate)
 {
-    const char *query[] = {
-        NULL,
-        "BEGIN; SET TRANSACTION ISOLATION LEVEL READ COMMITTED",
-        "BEGIN; SET TRANSACTION ISOLATION LEVEL SERIALIZABLE"};
+    const char *begin;
     int result;
 
     Dprintf("pq_begin_locked: pgconn = %p, isolevel = %ld, status = %d",
             conn->pgconn, conn->isolation_level, conn->status);
 
-    if (conn->isolation_level == ISOLATION_LEVEL_AUTOCOMMIT
-            || conn->status != CONN_STATUS_READY) {
+    if (!(begin = _pq_begin_command(conn))) {
         Dprintf("pq_begin_locked: transaction in progress");
         return 0;
     }
 
-    result = pq_execute_command_locked(conn, query[conn->isolation_level],
-                                       pgres, error, tstate);
+    result = pq_execute_command_locked(conn, begin, pgres, error, tstate);
     if (result == 0)
         conn->status = CONN_STATUS_BEGIN;
 
     return result;
 }
 
+/* Deallocate the statements evicted from the prepared statements cache.
+ *
+ * The statements are only deallocated outside of a transaction, so that an
+ * error can't abort the one of the user: it's done before preparing a new
+ * statement and after a commit or a rollback. All the statements are
+ * deallocated in a single round trip. Errors are ignored: in the worst case
+ * a statement is left on the server until the end of the session.
+ *
+ * This function should only be called on a locked connection without
+ * holding the global interpreter lock. */
+
+static void
+_pq_prepared_flush_locked(connectionObject *conn, PyThreadState **tstate)
+{
+    struct connectionObject_prepared *stmt;
+    PGresult *pgres = NULL;
+    char *error = NULL;
+    char *query, *p;
+    size_t size = 1;
+
+    if (!conn->prepared_stale
+            || PQtransactionStatus(conn->pgconn) != PQTRANS_IDLE) {
+        return;
+    }
+
+    for (stmt = conn->prepared_stale; stmt; stmt = stmt->next) {
+        size += PREPARED_NAME_SIZE + sizeof("DEALLOCATE ; ");
+    }
+    if (!(query = malloc(size))) { return; }
+
+    p = query;
+    while ((stmt = conn->prepared_stale)) {
+        conn->prepared_stale = stmt->next;
+        p += sprintf(p, "DEALLOCATE %s; ", stmt->name);
+        free(stmt);
+    }
+
+    Dprintf("_pq_prepared_flush_locked: %s", query);
+    if (0 != pq_execute_command_locked(conn, query, &pgres, &error, tstate)) {
+        IFCLEARPGRES(pgres);
+        if (error) { free(error); }
+    }
+    free(query);
+}
+
 /* pq_commit - send an END, if necessary
 
    This function should be called while holding the global interpreter
@@ -450,6 +675,9 @@ pq_commit(connectionObject *conn)
     conn->mark += 1;
 
     retvalue = pq_execute_command_locked(conn, "COMMIT", &pgres, &error, &_save);
+    if (retvalue == 0) {
+        _pq_prepared_flush_locked(conn, &_save);
+    }
 
     pthread_mutex_unlock(&conn->lock);
     Py_END_ALLOW_THREADS;
@@ -483,8 +711,10 @@ pq_abort_locked(connectionObject *conn, PGresult **pgres, char **error,
 
     conn->mark += 1;
     retvalue = pq_execute_command_locked(conn, "ROLLBACK", pgres, error, tstate);
-    if (retvalue == 0)
+    if (retvalue == 0) {
         conn->status = CONN_STATUS_READY;
+        _pq_prepared_flush_locked(conn, tstate);
+    }
 
     return retvalue;
 }
@@ -555,6 +785,13 @@ pq_reset_locked(connectionObject *conn, PGresult **pgres, char **error,
     retvalue = pq_execute_command_locked(conn, "RESET ALL", pgres, error, tstate);
     if (retvalue != 0) return retvalue;
 
+    if (conn->prepared_first || conn->prepared_stale) {
+        retvalue = pq_execute_command_locked(conn, "DEALLOCATE ALL",
+                                             pgres, error, tstate);
+        if (retvalue != 0) return retvalue;
+        conn_prepared_invalidate_all(conn);
+    }
+
     retvalue = pq_execute_command_locked(conn,
         "SET SESSION AUTHORIZATION DEFAULT", pgres, error, tstate);
     if (retvalue != 0) return retvalue;
@@ -595,22 +832,16 @@ pq_reset(connectionObject *conn)
 }
 
 
-/* Call one of the PostgreSQL tpc-related commands.
+/* Build a tpc-related command followed by the quoted transaction id tid.
  *
- * This function should only be called on a locked connection without
- * holding the global interpreter lock. */
+ * Return a buffer to be freed with PyMem_Free(), NULL on error. */
 
-int
-pq_tpc_command_locked(connectionObject *conn, const char *cmd, const char *tid,
-                  PGresult **pgres, char **error, PyThreadState **tstate)
+static char *
+_pq_tpc_query(connectionObject *conn, const char *cmd, const char *tid)
 {
-    int rv = -1;
     char *etid = NULL, *buf = NULL;
     Py_ssize_t buflen;
 
-    Dprintf("_pq_tpc_command: pgconn = %p, command = %s",
-            conn->pgconn, cmd);
-
     /* convert the xid into the postgres transaction_id and quote it. */
     if (!(etid = psycopg_escape_string((PyObject *)conn, tid, 0, NULL, NULL)))
     { goto exit; }
@@ -621,18 +852,250 @@ pq_tpc_command_locked(connectionObject *conn, const char *cmd, const char *tid,
         PyErr_NoMemory();
         goto exit;
     }
-    if (0 > PyOS_snprintf(buf, buflen, "%s %s;", cmd, etid)) { goto exit; }
+    if (0 > PyOS_snprintf(buf, buflen, "%s %s;", cmd, etid)) {
+        PyMem_Free(buf);
+        buf = NULL;
+    }
+
+exit:
+    PyMem_Free(etid);
+    return buf;
+}
+
+/* Call one of the PostgreSQL tpc-related commands.
+ *
+ * This function should only be called on a locked connection without
+ * holding the global interpreter lock. */
+
+int
+pq_tpc_command_locked(connectionObject *conn, const char *cmd, const char *tid,
+                  PGresult **pgres, char **error, PyThreadState **tstate)
+{
+    int rv = -1;
+    char *buf;
+
+    Dprintf("_pq_tpc_command: pgconn = %p, command = %s",
+            conn->pgconn, cmd);
+
+    if (!(buf = _pq_tpc_query(conn, cmd, tid))) { return -1; }
 
     /* run the command and let it handle the error cases */
     rv = pq_execute_command_locked(conn, buf, pgres, error, tstate);
 
-exit:
     PyMem_Free(buf);
-    PyMem_Free(etid);
-
     return rv;
 }
 
+/* keep the first error raised by the commands of pq_tpc_command_many() */
+#define TPC_MANY_KEEP_ERROR(exc, val, tb)       \
+    if (exc) { PyErr_Clear(); }                 \
+    else { PyErr_Fetch(&(exc), &(val), &(tb)); }
+
+/* Read the result of the command sent by pq_tpc_command_many() to conn.
+ *
+ * Block if the result is not ready. Return 0 if the command succeeded, -1
+ * with an exception set otherwise. */
+
+static int
+_pq_tpc_many_result(connectionObject *conn)
+{
+    PGresult *pgres;
+
+    /* the connection is locked since the command was sent */
+    Py_BEGIN_ALLOW_THREADS;
+    pgres = pq_get_last_result(conn);
+    pthread_mutex_unlock(&(conn->lock));
+    Py_END_ALLOW_THREADS;
+
+    conn_notice_process(conn);
+
+    if (pgres == NULL) {
+        PyErr_SetString(OperationalError, PQerrorMessage(conn->pgconn));
+        return -1;
+    }
+    if (PQresultStatus(pgres) != PGRES_COMMAND_OK) {
+        pq_raise(conn, NULL, pgres);
+        PQclear(pgres);
+        return -1;
+    }
+    PQclear(pgres);
+    return 0;
+}
+
+/* like pq_is_busy() on a connection already locked; unlock it on error */
+
+static int
+_pq_tpc_many_busy(connectionObject *conn)
+{
+    int res;
+
+    Py_BEGIN_ALLOW_THREADS;
+    if (PQconsumeInput(conn->pgconn) == 0) {
+        pthread_mutex_unlock(&(conn->lock));
+        Py_BLOCK_THREADS;
+        PyErr_SetString(OperationalError, PQerrorMessage(conn->pgconn));
+        return -1;
+    }
+    res = PQisBusy(conn->pgconn);
+    Py_END_ALLOW_THREADS;
+
+    return res;
+}
+
+/* pq_tpc_command_many - run tpc-related commands on many connections at once
+
+   cmds[i] is sent to conns[i], followed by the quoted transaction id of
+   xids[i] if not NULL; the connections with a NULL cmds[i] are skipped.
+   All the commands are sent before waiting for any result, then the
+   results are read as they arrive, waiting for all the connections with a
+   single poll(): the time taken is the one of the slowest connection, not
+   the sum of them. With a wait callback the commands are run one at time.
+
+   Each connection stays locked from the command sent until its result is
+   read, so other threads can't use it in the meantime. The connections
+   are locked in order of address, so that calls sharing some of them
+   can't deadlock.
+
+   failed[i] is set to 1 if the command of conns[i] failed, else to 0.
+   Return 0 if all the commands succeeded, else -1 with the first error
+   set as exception.
+
+   This function should be called while holding the global interpreter
+   lock: it is released while waiting. */
+
+int
+pq_tpc_command_many(connectionObject **conns, const char **cmds,
+                    XidObject **xids, int n, int *failed)
+{
+    PyObject *exc = NULL, *val = NULL, *tb = NULL, *tid;
+    PGresult *pgres = NULL;
+    char **queries = NULL, *error = NULL;
+    int *events = NULL, *order = NULL;
+    int i, j, k, sent, busy, pending, blocking = 0;
+
+    for (i = 0; i < n; i++) { failed[i] = 0; }
+
+    if (!(queries = PyMem_New(char *, n)) || !(events = PyMem_New(int, n))
+            || !(order = PyMem_New(int, n))) {
+        PyErr_NoMemory();
+        goto exit;
+    }
+    for (i = 0; i < n; i++) {
+        queries[i] = NULL;
+        events[i] = PSYCO_POLL_OK;
+    }
+
+    /* sort the connections by address: an insertion sort is enough for the
+       few connections of a distributed transaction */
+    for (i = 0; i < n; i++) {
+        for (j = i; j > 0 && (Py_uintptr_t)conns[order[j - 1]]
+                > (Py_uintptr_t)conns[i]; j--) {
+            order[j] = order[j - 1];
+        }
+        order[j] = i;
+    }
+
+    /* build all the commands before sending any */
+    for (i = 0; i < n; i++) {
+        if (!cmds[i]) { continue; }
+        if (xids[i]) {
+            if (!(tid = xid_get_tid(xids[i]))) { goto exit; }
+            queries[i] = PyString_Check(tid) ?
+                _pq_tpc_query(conns[i], cmds[i], PyString_AS_STRING(tid))
+                : NULL;
+            Py_DECREF(tid);
+        }
+        else if ((queries[i] = PyMem_Malloc(strlen(cmds[i]) + 1))) {
+            strcpy(queries[i], cmds[i]);
+        }
+        if (!queries[i]) {
+            if (!PyErr_Occurred()) { PyErr_NoMemory(); }
+            goto exit;
+        }
+    }
+
+    for (k = 0; k < n; k++) {
+        i = order[k];
+        if (!queries[i]) { continue; }
+        Dprintf("pq_tpc_command_many: pgconn = %p, command = %s",
+                conns[i]->pgconn, queries[i]);
+
+        if (psyco_green()) {
+            Py_BEGIN_ALLOW_THREADS;
+            pthread_mutex_lock(&(conns[i]->lock));
+            sent = pq_execute_command_locked(
+                conns[i], queries[i], &pgres, &error, &_save);
+            pthread_mutex_unlock(&(conns[i]->lock));
+            Py_END_ALLOW_THREADS;
+            if (sent < 0) {
+                pq_complete_error(conns[i], &pgres, &error);
+                TPC_MANY_KEEP_ERROR(exc, val, tb);
+                failed[i] = 1;
+            }
+            continue;
+        }
+
+        /* the lock is released once the result is read */
+        Py_BEGIN_ALLOW_THREADS;
+        pthread_mutex_lock(&(conns[i]->lock));
+        _pq_stats_sent(conns[i], queries[i], NULL);
+        if (!(sent = PQsendQuery(conns[i]->pgconn, queries[i]))) {
+            pthread_mutex_unlock(&(conns[i]->lock));
+        }
+        Py_END_ALLOW_THREADS;
+
+        if (!sent) {
+            PyErr_SetString(OperationalError,
+                            PQerrorMessage(conns[i]->pgconn));
+            TPC_MANY_KEEP_ERROR(exc, val, tb);
+            failed[i] = 1;
+            continue;
+        }
+        events[i] = PSYCO_POLL_READ;
+    }
+
+    for (;;) {
+        for (pending = 0, i = 0; i < n; i++) {
+            if (events[i] != PSYCO_POLL_READ) { continue; }
+
+            if (!blocking && (busy = _pq_tpc_many_busy(conns[i])) == 1) {
+                pending++;
+                continue;
+            }
+            if (blocking || busy == 0) {
+                busy = _pq_tpc_many_result(conns[i]);
+            }
+            if (busy < 0) {
+                TPC_MANY_KEEP_ERROR(exc, val, tb);
+                failed[i] = 1;
+            }
+            events[i] = PSYCO_POLL_OK;
+        }
+        if (pending == 0) { break; }
+
+        if (conn_poll_wait(conns, events, n, -1) < 0) {
+            /* interrupted: the results must be read anyway to leave the
+               connections usable, and the interruption raised */
+            Py_XDECREF(exc); Py_XDECREF(val); Py_XDECREF(tb);
+            PyErr_Fetch(&exc, &val, &tb);
+            blocking = 1;
+        }
+    }
+
+exit:
+    if (queries) {
+        for (i = 0; i < n; i++) { PyMem_Free(queries[i]); }
+        PyMem_Free(queries);
+    }
+    PyMem_Free(events);
+    PyMem_Free(order);
+
+    if (exc) {
+        PyErr_Restore(exc, val, tb);
+    }
+    return PyErr_Occurred() ? -1 : 0;
+}
+
 
 /* pq_is_busy - consume input and return connection status
 
@@ -718,60 +1181,758 @@ pq_flush(connectionObject *conn)
     return res;
 }
 
-/* pq_execute - execute a query, possibly asynchronously
-
-   this fucntion locks the connection object
-   this function call Py_*_ALLOW_THREADS macros */
+/* Execute a query after the command starting a transaction.
+ *
+ * The BEGIN is sent in the same network write of the query, saving a round
+ * trip: a simple query, which may contain several statements, is appended
+ * to it; a query with out-of-line parameters is pipelined after it. If the
+ * BEGIN fails its error is returned and the query is not executed, else
+ * the result is the one of the query, as for _pq_exec_params_locked().
+ *
+ * In the simple query case the backend parses the whole string before
+ * running any statement: a syntax error in the query is returned as the
+ * first result and the BEGIN is never executed. The connection status is
+ * then taken from the backend transaction status.
+ *
+ * This function should only be called on a locked connection without
+ * holding the global interpreter lock, and without a wait callback. */
 
-int
-pq_execute(cursorObject *curs, const char *query, int async)
+static PGresult *
+_pq_exec_begin_locked(connectionObject *conn, const char *begin,
+                      const char *query, const pqParams *params)
 {
-    PGresult *pgres = NULL;
-    char *error = NULL;
-    int async_status = ASYNC_WRITE;
+    PGresult *pgres = NULL, *res;
+    char *buf;
+    int sent;
 
-    /* if the status of the connection is critical raise an exception and
-       definitely close the connection */
-    if (curs->conn->critical) {
-        pq_resolve_critical(curs->conn, 1);
-        return -1;
+    Dprintf("_pq_exec_begin_locked: sending '%s' with the query", begin);
+    _pq_stats_sent(conn, begin, NULL);
+
+    if (!(params && (params->name
+            || params->nparams > 0 || params->result_format))) {
+        if (!(buf = malloc(strlen(begin) + strlen(query) + 3))) {
+            goto sequential;
+        }
+        sprintf(buf, "%s; %s", begin, query);
+        sent = PQsendQuery(conn->pgconn, buf);
+        free(buf);
+        if (!sent) { return NULL; }
+
+        /* the first result is the one of the BEGIN, or the error of a
+           string the backend couldn't parse, in which case the BEGIN was
+           not run either: after an error the rest of the query is skipped */
+        if (!(res = PQgetResult(conn->pgconn))) { return NULL; }
+        if (PQresultStatus(res) != PGRES_COMMAND_OK) {
+            while ((pgres = PQgetResult(conn->pgconn))) { PQclear(pgres); }
+            if (PQtransactionStatus(conn->pgconn) != PQTRANS_IDLE
+                    && PQstatus(conn->pgconn) == CONNECTION_OK) {
+                conn->status = CONN_STATUS_BEGIN;
+            }
+            return res;
+        }
+        PQclear(res);
+        conn->status = CONN_STATUS_BEGIN;
+
+        if (!(pgres = pq_get_last_result(conn))
+                && PQstatus(conn->pgconn) == CONNECTION_OK) {
+            /* the query was empty: return what PQexec() would have */
+            pgres = PQmakeEmptyPGresult(conn->pgconn, PGRES_EMPTY_QUERY);
+        }
+        return pgres;
     }
 
-    /* check status of connection, raise error if not OK */
-    if (PQstatus(curs->conn->pgconn) != CONNECTION_OK) {
-        Dprintf("pq_execute: connection NOT OK");
-        PyErr_SetString(OperationalError, PQerrorMessage(curs->conn->pgconn));
-        return -1;
+#ifdef HAVE_PQPIPELINE
+    if (PQenterPipelineMode(conn->pgconn)) {
+        int nulls = 0, first = 1;
+
+        sent = PQsendQueryParams(conn->pgconn, begin,
+                                 0, NULL, NULL, NULL, NULL, 0)
+            && pq_send_query_params(conn, query, params);
+
+        /* read the results of what was sent in any case, to leave the
+           connection in a clean state: each one is followed by a NULL */
+        if (PQpipelineSync(conn->pgconn)) {
+            while (nulls < 2) {
+                if (!(res = PQgetResult(conn->pgconn))) {
+                    nulls++;
+                    continue;
+                }
+                nulls = 0;
+                if (PQresultStatus(res) == PGRES_PIPELINE_SYNC) {
+                    PQclear(res);
+                    break;
+                }
+                if (first) {
+                    first = 0;
+                    if (PQresultStatus(res) == PGRES_COMMAND_OK) {
+                        conn->status = CONN_STATUS_BEGIN;
+                        PQclear(res);
+                        continue;
+                    }
+                }
+                /* keep the error of the BEGIN, else the query result */
+                if (pgres || PQresultStatus(res) == PGRES_PIPELINE_ABORTED) {
+                    PQclear(res);
+                }
+                else {
+                    pgres = res;
+                }
+            }
+        }
+        PQexitPipelineMode(conn->pgconn);
+
+        if (!sent && pgres && PQresultStatus(pgres) != PGRES_FATAL_ERROR) {
+            CLEARPGRES(pgres);
+        }
+        return pgres;
     }
-    Dprintf("curs_execute: pg connection at %p OK", curs->conn->pgconn);
+#endif
 
-    Py_BEGIN_ALLOW_THREADS;
-    pthread_mutex_lock(&(curs->conn->lock));
+sequential:
+    /* send the BEGIN on its own */
+    res = PQexec(conn->pgconn, begin);
+    if (!res || PQresultStatus(res) != PGRES_COMMAND_OK) {
+        return res;
+    }
+    PQclear(res);
+    conn->status = CONN_STATUS_BEGIN;
 
-    if (pq_begin_locked(curs->conn, &pgres, &error, &_save) < 0) {
+    if (!pq_send_query_params(conn, query, params)) { return NULL; }
+    return pq_get_last_result(conn);
+}
+
+/* Execute a query, possibly with out-of-line parameters or as a prepared
+ * statement, and return its result.
+ *
+ * If begin is not NULL the command is sent before the query to start a
+ * transaction: see _pq_exec_begin_locked(). It can't be used together
+ * with a wait callback.
+ *
+ * If the result is NULL there may have been either a libpq error or an
+ * exception raised by the wait callback: see psyco_exec_green().
+ *
+ * This function should only be called on a locked connection without
+ * holding the global interpreter lock. */
+
+static PGresult *
+_pq_exec_params_locked(connectionObject *conn, const char *begin,
+                       const char *query, const pqParams *params,
+                       PyThreadState **tstate)
+{
+    PGresult *pgres;
+
+    if (begin) {
+        pgres = _pq_exec_begin_locked(conn, begin, query, params);
+    }
+    else if (!psyco_green()) {
+        if (params && params->name) {
+            pgres = PQexecPrepared(conn->pgconn, params->name,
+                params->nparams, params->values, params->lengths,
+                params->formats, params->result_format);
+        }
+        else if (params && (params->nparams > 0 || params->result_format)) {
+            pgres = PQexecParams(conn->pgconn, query,
+                params->nparams, params->types, params->values,
+                params->lengths, params->formats, params->result_format);
+        }
+        else if (conn->nextsets) {
+            /* PQexec() would discard all the results but the last */
+            if (!PQsendQuery(conn->pgconn, query)) { return NULL; }
+            if (!(pgres = pq_get_last_result(conn))
+                    && PQstatus(conn->pgconn) == CONNECTION_OK) {
+                pgres = PQmakeEmptyPGresult(conn->pgconn, PGRES_EMPTY_QUERY);
+            }
+        }
+        else {
+            pgres = PQexec(conn->pgconn, query);
+        }
+    }
+    else {
+        PyEval_RestoreThread(*tstate);
+        pgres = psyco_exec_green_params(conn, query, params);
+        *tstate = PyEval_SaveThread();
+    }
+
+    conn_read_std_strings(conn);
+    return pgres;
+}
+
+#ifdef HAVE_SINGLE_ROW_MODE
+
+/* Send a query in single-row mode and return its first result.
+ *
+ * If the first result is not a row the other results are read and the last
+ * one is returned, as _pq_exec_params_locked() does.
+ *
+ * This function should only be called on a locked connection without
+ * holding the global interpreter lock. */
+
+static PGresult *
+_pq_exec_stream_locked(connectionObject *conn, const char *query,
+                       const pqParams *params, PyThreadState **tstate)
+{
+    PGresult *pgres, *res;
+    int green = psyco_green();
+
+    if (0 == pq_send_query_params(conn, query, params)) {
+        return NULL;
+    }
+    if (!PQsetSingleRowMode(conn->pgconn)) {
+        Dprintf("_pq_exec_stream_locked: can't set single-row mode");
+    }
+
+    if (!green) {
+        pgres = PQgetResult(conn->pgconn);
+        if (pgres && PQresultStatus(pgres) != PGRES_SINGLE_TUPLE) {
+            while (NULL != (res = PQgetResult(conn->pgconn))) {
+                PQclear(pgres);
+                pgres = res;
+            }
+        }
+        return pgres;
+    }
+
+    PyEval_RestoreThread(*tstate);
+    conn->async_status = ASYNC_WRITE;
+    pgres = psyco_get_result_green(conn);
+    if (pgres && PQresultStatus(pgres) != PGRES_SINGLE_TUPLE) {
+        while (NULL != (res = psyco_get_result_green(conn))) {
+            PQclear(pgres);
+            pgres = res;
+        }
+    }
+    if (PyErr_Occurred()) {
+        IFCLEARPGRES(pgres);
+    }
+    *tstate = PyEval_SaveThread();
+
+    return pgres;
+}
+
+#endif
+
+/* Prepare a statement and return the result of the operation.
+ *
+ * This function should only be called on a locked connection without
+ * holding the global interpreter lock. */
+
+static PGresult *
+_pq_prepare_locked(connectionObject *conn, const char *name,
+                   const char *query, const pqParams *params,
+                   PyThreadState **tstate)
+{
+    PGresult *pgres;
+
+    Dprintf("_pq_prepare_locked: preparing '%s' as:", name);
+    Dprintf("    %-.200s", query);
+
+    if (!psyco_green()) {
+        pgres = PQprepare(conn->pgconn, name, query,
+            params ? params->nparams : 0, params ? params->types : NULL);
+    }
+    else {
+        PyEval_RestoreThread(*tstate);
+        pgres = psyco_prepare_green(conn, name, query, params);
+        *tstate = PyEval_SaveThread();
+    }
+
+    return pgres;
+}
+
+/* Execute a query through the prepared statements cache of the connection.
+ *
+ * The query is prepared once it has been executed prepare_threshold times;
+ * from then on it's executed as a prepared statement. The statement is
+ * prepared before sending begin, if not NULL, together with the query.
+ *
+ * This function should only be called on a locked connection without
+ * holding the global interpreter lock. */
+
+static PGresult *
+_pq_exec_cached_locked(connectionObject *conn, const char *begin,
+                       const char *query, const pqParams *params,
+                       PyThreadState **tstate)
+{
+    struct connectionObject_prepared *stmt;
+    pqParams pparams;
+    PGresult *pgres;
+    const char *sqlstate;
+
+    PyEval_RestoreThread(*tstate);
+    stmt = conn_prepared_get(conn, query, params->nparams, params->types);
+    *tstate = PyEval_SaveThread();
+
+    if (stmt && !stmt->name[0] && !stmt->failed
+            && stmt->count >= conn->prepare_threshold) {
+        _pq_prepared_flush_locked(conn, tstate);
+
+        PyOS_snprintf(stmt->name, PREPARED_NAME_SIZE, "_psyco_prep_%ld",
+                      ++conn->prepared_serial);
+        pgres = _pq_prepare_locked(conn, stmt->name, query, params, tstate);
+        if (pgres == NULL || PQresultStatus(pgres) != PGRES_COMMAND_OK) {
+            /* return the error as the query result: it would have been
+               the same executing the query */
+            stmt->name[0] = '\0';
+            stmt->failed = 1;
+            return pgres;
+        }
+        PQclear(pgres);
+    }
+
+    if (!(stmt && stmt->name[0])) {
+        /* only the queries that could have been prepared count */
+        if (stmt) { conn->prepared_misses++; }
+        return _pq_exec_params_locked(conn, begin, query, params, tstate);
+    }
+
+    conn->prepared_hits++;
+    pparams = *params;
+    pparams.name = stmt->name;
+    pgres = _pq_exec_params_locked(conn, begin, query, &pparams, tstate);
+
+    if (pgres && PQresultStatus(pgres) == PGRES_FATAL_ERROR
+            && (sqlstate = PQresultErrorField(pgres, PG_DIAG_SQLSTATE))) {
+        if (0 == strcmp(sqlstate, "26000")) {
+            /* invalid_sql_statement_name: the statements were dropped */
+            conn_prepared_invalidate_all(conn);
+        }
+        else if (0 == strcmp(sqlstate, "0A000")) {
+            /* feature_not_supported, e.g. "cached plan must not change
+               result type" after a schema change */
+            conn_prepared_invalidate(conn, stmt);
+        }
+    }
+
+    return pgres;
+}
+
+/* Check that the connection is usable to execute a query.
+ *
+ * Return 0 if it is, else -1 and set an exception.
+ *
+ * This function should be called holding the GIL. */
+
+static int
+_pq_check_connection(connectionObject *conn)
+{
+    /* if the status of the connection is critical raise an exception and
+       definitely close the connection */
+    if (conn->critical) {
+        pq_resolve_critical(conn, 1);
+        return -1;
+    }
+
+    /* check status of connection, raise error if not OK */
+    if (PQstatus(conn->pgconn) != CONNECTION_OK) {
+        Dprintf("pq_execute: connection NOT OK");
+        PyErr_SetString(OperationalError, PQerrorMessage(conn->pgconn));
+        return -1;
+    }
+    Dprintf("curs_execute: pg connection at %p OK", conn->pgconn);
+
+    return 0;
+}
+
+/* Check that the connection of a cursor is free to execute a query.
+ *
+ * The connection is busy while a COPY stream is open or while another
+ * cursor is streaming the rows of a query: the rows pending of the cursor
+ * itself are discarded by its next query.
+ *
+ * Return 0 if it is free, else -1 and set ProgrammingError. */
+
+static int
+_pq_check_busy(cursorObject *curs)
+{
+    connectionObject *conn = curs->conn;
+
+    if (conn->copy_stream) {
+        PyErr_SetString(ProgrammingError,
+            "can't execute a query while a COPY stream is open");
+        return -1;
+    }
+    if (conn->stream_cursor && conn->stream_cursor != (PyObject *)curs) {
+        PyErr_SetString(ProgrammingError,
+            "can't execute a query while another cursor is streaming");
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Return 1 if a query can be sent in pipeline mode, else 0
+
+   the extended protocol used in pipeline mode refuses a query with more
+   than one statement, and COPY would stop the pipeline. The check is
+   conservative: an unterminated string or comment, or anything other than
+   blanks and comments after a semicolon, make the query not pipelined. */
+
+static int
+_pq_query_pipelinable(connectionObject *conn, const char *query)
+{
+    const char *p = query, *tag;
+    size_t len;
+    int depth, escapes, words = 0, semi = 0;
+
+    while (*p) {
+        if (isspace((unsigned char)*p)) {
+            p++;
+            continue;
+        }
+        if (p[0] == '-' && p[1] == '-') {
+            while (*p && *p != '\n') { p++; }
+            continue;
+        }
+        if (p[0] == '/' && p[1] == '*') {
+            for (depth = 1, p += 2; *p && depth; p++) {
+                if (p[0] == '/' && p[1] == '*') { depth++; p++; }
+                else if (p[0] == '*' && p[1] == '/') { depth--; p++; }
+            }
+            if (depth) { return 0; }
+            continue;
+        }
+
+        /* a second statement */
+        if (semi) { return 0; }
+
+        switch (*p) {
+        case ';':
+            semi = 1;
+            p++;
+            break;
+
+        case '\'':
+            escapes = conn->std_strings != 1
+                || (p > query && (p[-1] == 'E' || p[-1] == 'e'));
+            for (p++; *p; p++) {
+                if (*p == '\\' && escapes && p[1]) {
+                    p++;
+                }
+                else if (*p == '\'') {
+                    if (p[1] != '\'') { break; }
+                    p++;
+                }
+            }
+            if (!*p) { return 0; }
+            p++;
+            break;
+
+        case '"':
+            if (!(p = strchr(p + 1, '"'))) { return 0; }
+            p++;
+            break;
+
+        case '$':
+            /* a $tag$ quote, else a $1 placeholder */
+            tag = p++;
+            if (isdigit((unsigned char)*p)) { break; }
+            while (isalnum((unsigned char)*p) || *p == '_'
+                    || (unsigned char)*p >= 0x80) {
+                p++;
+            }
+            if (*p != '$') { break; }
+            len = p + 1 - tag;
+            for (p++; *p && strncmp(p, tag, len); p++) {}
+            if (!*p) { return 0; }
+            p += len;
+            break;
+
+        default:
+            if (isalpha((unsigned char)*p) || *p == '_'
+                    || (unsigned char)*p >= 0x80) {
+                for (tag = p; isalnum((unsigned char)*p) || *p == '_'
+                        || *p == '$' || (unsigned char)*p >= 0x80; p++) {}
+                if (words++ == 0 && p - tag == 4
+                        && tolower(tag[0]) == 'c' && tolower(tag[1]) == 'o'
+                        && tolower(tag[2]) == 'p' && tolower(tag[3]) == 'y') {
+                    return 0;
+                }
+            }
+            else {
+                p++;
+            }
+            break;
+        }
+    }
+
+    return 1;
+}
+
+/* copy the parameters of a query to be sent later, in a single block
+
+   the values are copied (the text ones up to their terminator) as the
+   original ones are released after execute() returns. The block must be
+   released with PyMem_Free(). */
+
+static pqParams *
+_pq_params_copy(const pqParams *params)
+{
+    pqParams *rv;
+    size_t size, len;
+    int i, n = params->nparams;
+    char *p;
+
+    size = sizeof(pqParams)
+        + n * (sizeof(char *) + sizeof(Oid) + 2 * sizeof(int));
+    for (i = 0; i < n; i++) {
+        if (!params->values || !params->values[i]) { continue; }
+        size += (params->formats && params->formats[i]) ?
+            params->lengths[i] : strlen(params->values[i]) + 1;
+    }
+
+    if (!(rv = PyMem_Malloc(size))) {
+        PyErr_NoMemory();
+        return NULL;
+    }
+    *rv = *params;
+    rv->name = NULL;
+    rv->prepare = 0;
+    rv->values = (const char **)(rv + 1);
+    rv->types = (Oid *)(rv->values + n);
+    rv->lengths = (int *)(rv->types + n);
+    rv->formats = rv->lengths + n;
+    p = (char *)(rv->formats + n);
+
+    for (i = 0; i < n; i++) {
+        rv->types[i] = params->types ? params->types[i] : 0;
+        rv->lengths[i] = params->lengths ? params->lengths[i] : 0;
+        rv->formats[i] = params->formats ? params->formats[i] : 0;
+        if (!params->values || !params->values[i]) {
+            rv->values[i] = NULL;
+            continue;
+        }
+        len = rv->formats[i] ?
+            rv->lengths[i] : strlen(params->values[i]) + 1;
+        memcpy(p, params->values[i], len);
+        rv->values[i] = p;
+        p += len;
+    }
+
+    return rv;
+}
+
+/* queue an async query to be sent after the ones running
+
+   the query sent is the one in curs->query, with a copy of its parameters,
+   if any. */
+
+static int
+_pq_execute_enqueue(cursorObject *curs, const pqParams *params)
+{
+    connectionObject *conn = curs->conn;
+    pqParams *qparams = NULL;
+
+    if (params && (params->nparams > 0 || params->result_format)
+            && !(qparams = _pq_params_copy(params))) {
+        return -1;
+    }
+
+    if (conn->async_queue == NULL
+            && !(conn->async_queue = PyList_New(0))) {
+        PyMem_Free(qparams);
+        return -1;
+    }
+    if (0 > PyList_Append(conn->async_queue, (PyObject *)curs)) {
+        PyMem_Free(qparams);
+        return -1;
+    }
+    PyMem_Free(curs->async_params);
+    curs->async_params = qparams;
+    curs->async_queued = 1;
+    Dprintf("pq_execute: async query queued, %d waiting",
+            (int)PyList_GET_SIZE(conn->async_queue));
+
+    return 0;
+}
+
+/* Store a result to be returned by nextset(), or clear it if the
+ * connection is not keeping the results.
+ *
+ * The function can be called without holding the global interpreter lock:
+ * if the result can't be stored it is cleared and the loss reported by
+ * pq_fetch_sets(). */
+
+static void
+_pq_keep_result(cursorResults *sets, PGresult *res)
+{
+    PGresult **results;
+
+    if (sets == NULL || sets->lost) {
+        PQclear(res);
+        return;
+    }
+    if (sets->len == sets->size) {
+        int size = sets->size ? sets->size * 2 : 8;
+        if (!(results = realloc(sets->results, size * sizeof(PGresult *)))) {
+            sets->lost = 1;
+            PQclear(res);
+            return;
+        }
+        sets->results = results;
+        sets->size = size;
+    }
+    sets->results[sets->len++] = res;
+}
+
+/* the results of the query of curs to be kept for nextset(), if any */
+#define CURS_NEXTSETS(curs) \
+    ((curs)->multiple_results && (curs)->name == NULL \
+        ? &(curs)->nextsets : NULL)
+
+/* pq_execute - execute a query, possibly asynchronously
+
+   this fucntion locks the connection object
+   this function call Py_*_ALLOW_THREADS macros */
+
+int
+pq_execute(cursorObject *curs, const char *query, int async)
+{
+    return pq_execute_params(curs, query, NULL, async);
+}
+
+/* drop the last cursor from the ones pipelined, if its query wasn't sent */
+
+static void
+_pq_async_unsend(connectionObject *conn)
+{
+    PySequence_DelItem(conn->async_sent,
+                       PyList_GET_SIZE(conn->async_sent) - 1);
+}
+
+/* Send an async query, in pipeline mode if possible
+
+   in pipeline mode each query is followed by a Sync, so that an error
+   doesn't abort the queries pipelined after it. Return 1 if the query was
+   sent, else 0.
+
+   The function should be called helding the connection lock. */
+
+static int
+_pq_send_async_locked(connectionObject *conn, const char *query,
+                      const pqParams *params)
+{
+#ifdef HAVE_PQPIPELINE
+    if (!conn->async_pipeline && _pq_query_pipelinable(conn, query)
+            && PQenterPipelineMode(conn->pgconn)) {
+        Dprintf("pq_execute: entering pipeline mode");
+        conn->async_pipeline = 1;
+        if (!pq_send_query_params(conn, query, params)) {
+            PQexitPipelineMode(conn->pgconn);
+            conn->async_pipeline = 0;
+            return 0;
+        }
+        return PQpipelineSync(conn->pgconn);
+    }
+    if (conn->async_pipeline) {
+        return pq_send_query_params(conn, query, params)
+            && PQpipelineSync(conn->pgconn);
+    }
+#endif
+    return pq_send_query_params(conn, query, params);
+}
+
+/* execute a query, the worker of pq_execute_params()
+
+   an async query executed while another one runs is sent at once if both
+   are pipelined, else it is queued. queued is 1 when sending the queries
+   out of the queue: the ones following the first can only be sent after
+   it, in pipeline mode. */
+
+static int
+_pq_execute_params(cursorObject *curs, const char *query,
+                   const pqParams *params, int async, int queued)
+{
+    PGresult *pgres = NULL;
+    char *error = NULL;
+    const char *begin = NULL;
+    int async_status = ASYNC_WRITE;
+    int stream = 0, behind = 0;
+    double t0;
+
+    if (_pq_check_connection(curs->conn) < 0 || _pq_check_busy(curs) < 0) {
+        return -1;
+    }
+
+    /* another async query is running: pipeline this one after it, unless
+       there are queued queries to send first, or send it when it's done */
+    if (async && curs->conn->async_cursor != NULL) {
+#ifdef HAVE_PQPIPELINE
+        behind = curs->conn->async_pipeline
+            && (queued || curs->conn->async_queue == NULL
+                || PyList_GET_SIZE(curs->conn->async_queue) == 0)
+            && _pq_query_pipelinable(curs->conn, query);
+#endif
+        if (!behind) {
+            return _pq_execute_enqueue(curs, params);
+        }
+
+        /* its result will follow the ones of the queries sent before */
+        if (curs->conn->async_sent == NULL
+                && !(curs->conn->async_sent = PyList_New(0))) {
+            return -1;
+        }
+        if (0 > PyList_Append(curs->conn->async_sent, (PyObject *)curs)) {
+            return -1;
+        }
+    }
+
+    /* the rows of a previous streaming query are dropped */
+    if (pq_stream_discard(curs) < 0) {
+        return -1;
+    }
+
+#ifdef HAVE_SINGLE_ROW_MODE
+    stream = (curs->streaming > 0 || curs->result_limit > 0)
+        && curs->name == NULL;
+#endif
+
+    Py_BEGIN_ALLOW_THREADS;
+    pthread_mutex_lock(&(curs->conn->lock));
+
+    /* a sync query carries the BEGIN along: see _pq_exec_begin_locked() */
+    if (async == 0 && !stream && !psyco_green()) {
+        begin = _pq_begin_command(curs->conn);
+    }
+    else if (pq_begin_locked(curs->conn, &pgres, &error, &_save) < 0) {
         pthread_mutex_unlock(&(curs->conn->lock));
         Py_BLOCK_THREADS;
+        if (behind) { _pq_async_unsend(curs->conn); }
         pq_complete_error(curs->conn, &pgres, &error);
         return -1;
     }
 
+    _pq_stats_sent(curs->conn, query, params);
+
     if (async == 0) {
-        IFCLEARPGRES(curs->pgres);
+        IFCLEARCURSPGRES(curs);
+        curs_clear_results(curs);
         Dprintf("pq_execute: executing SYNC query: pgconn = %p", curs->conn->pgconn);
         Dprintf("    %-.200s", query);
-        if (!psyco_green()) {
-            curs->pgres = PQexec(curs->conn->pgconn, query);
+        t0 = CONN_STATS_START(curs->conn);
+#ifdef HAVE_SINGLE_ROW_MODE
+        if (stream) {
+            curs->pgres = _pq_exec_stream_locked(curs->conn, query, params,
+                                                 &_save);
+        }
+        else
+#endif
+        if (params && params->prepare && curs->conn->prepare_threshold > 0) {
+            curs->pgres = _pq_exec_cached_locked(curs->conn, begin, query,
+                                                 params, &_save);
         }
         else {
-            Py_BLOCK_THREADS;
-            curs->pgres = psyco_exec_green(curs->conn, query);
-            Py_UNBLOCK_THREADS;
+            curs->conn->nextsets = CURS_NEXTSETS(curs);
+            curs->pgres = _pq_exec_params_locked(curs->conn, begin, query,
+                                                 params, &_save);
+            curs->conn->nextsets = NULL;
         }
+        CONN_STATS_ADD_TIME(curs->conn, wait_time, t0);
 
         /* dont let pgres = NULL go to pq_fetch() */
         if (curs->pgres == NULL) {
             pthread_mutex_unlock(&(curs->conn->lock));
             Py_BLOCK_THREADS;
+            curs_clear_results(curs);
             if (!PyErr_Occurred()) {
                 PyErr_SetString(OperationalError,
                                 PQerrorMessage(curs->conn->pgconn));
@@ -786,10 +1947,11 @@ pq_execute(cursorObject *curs, const char *query, int async)
         Dprintf("pq_execute: executing ASYNC query: pgconn = %p", curs->conn->pgconn);
         Dprintf("    %-.200s", query);
 
-        IFCLEARPGRES(curs->pgres);
-        if (PQsendQuery(curs->conn->pgconn, query) == 0) {
+        IFCLEARCURSPGRES(curs);
+        if (_pq_send_async_locked(curs->conn, query, params) == 0) {
             pthread_mutex_unlock(&(curs->conn->lock));
             Py_BLOCK_THREADS;
+            if (behind) { _pq_async_unsend(curs->conn); }
             PyErr_SetString(OperationalError,
                             PQerrorMessage(curs->conn->pgconn));
             return -1;
@@ -809,6 +1971,11 @@ pq_execute(cursorObject *curs, const char *query, int async)
         }
         else {
             /* there was an error */
+            pthread_mutex_unlock(&(curs->conn->lock));
+            Py_BLOCK_THREADS;
+            if (behind) { _pq_async_unsend(curs->conn); }
+            PyErr_SetString(OperationalError,
+                            PQerrorMessage(curs->conn->pgconn));
             return -1;
         }
     }
@@ -820,7 +1987,14 @@ pq_execute(cursorObject *curs, const char *query, int async)
        to respect the old DBAPI-2.0 compatible behaviour */
     if (async == 0) {
         Dprintf("pq_execute: entering syncronous DBAPI compatibility mode");
-        if (pq_fetch(curs) == -1) return -1;
+        if (pq_fetch_sets(curs) == -1) return -1;
+    }
+    else if (behind) {
+        /* the cursor can't be used until its result is received */
+        curs->async_queued = 1;
+        if (async_status == ASYNC_WRITE) {
+            curs->conn->async_status = ASYNC_WRITE;
+        }
     }
     else {
         curs->conn->async_status = async_status;
@@ -831,27 +2005,475 @@ pq_execute(cursorObject *curs, const char *query, int async)
     return 1-async;
 }
 
-/* send an async query to the backend.
- *
- * Return 1 if command succeeded, else 0.
- *
- * The function should be called helding the connection lock and the GIL.
- */
-int
-pq_send_query(connectionObject *conn, const char *query)
-{
+/* pq_execute_params - execute a query with out-of-line parameters
+
+   if params is NULL or empty the query is sent as a simple query (and may
+   contain more than one statement), else it is sent using PQexecParams(),
+   which is also used to ask for binary results
+
+   this fucntion locks the connection object
+   this function call Py_*_ALLOW_THREADS macros */
+
+int
+pq_execute_params(cursorObject *curs, const char *query,
+                  const pqParams *params, int async)
+{
+    return _pq_execute_params(curs, query, params, async, 0);
+}
+
+/* pq_execute_queued - send the queries of the cursors in the async queue
+
+   the first query in the queue is sent; in pipeline mode the following
+   ones are sent too, up to the first one that can't be pipelined.
+
+   Return 1 if a query was sent, 0 if the queue is empty, -1 on error: in
+   this case the queue is dropped, as the connection is likely broken.
+
+   this fucntion locks the cursor and the connection object
+   this function call Py_*_ALLOW_THREADS macros */
+
+int
+pq_execute_queued(connectionObject *conn)
+{
+    cursorObject *curs;
+    pqParams *params;
+    int rv, sent = 0;
+
+    while (conn->async_queue != NULL
+            && PyList_GET_SIZE(conn->async_queue) > 0) {
+        curs = (cursorObject *)PyList_GET_ITEM(conn->async_queue, 0);
+        if (sent && !(conn->async_pipeline && _pq_query_pipelinable(
+                    conn, PyString_AS_STRING(curs->query)))) {
+            break;
+        }
+
+        Py_INCREF(curs);
+        if (0 > PyList_SetSlice(conn->async_queue, 0, 1, NULL)) {
+            Py_DECREF(curs);
+            return -1;
+        }
+        curs_lock(curs);
+        curs->async_queued = 0;
+        params = curs->async_params;
+        curs->async_params = NULL;
+        rv = _pq_execute_params(curs, PyString_AS_STRING(curs->query),
+                                params, 1, 1);
+        curs_unlock(curs);
+        PyMem_Free(params);
+        Py_DECREF(curs);
+
+        if (rv < 0) {
+            pq_clear_async_queue(conn, 0);
+            return -1;
+        }
+        sent = 1;
+    }
+
+    return sent;
+}
+
+/* Read all the results of the commands sent to the backend.
+ *
+ * The number of rows affected by the commands is summed in *rowcount (-1
+ * if any of them doesn't report it). In pipeline mode read until the
+ * synchronization point.
+ *
+ * Return the result to be fetched: the first error received, if any, else
+ * the last result. If NULL there may have been either a libpq error or an
+ * exception raised by the wait callback.
+ *
+ * This function should only be called on a locked connection without
+ * holding the global interpreter lock. */
+
+static PGresult *
+_pq_get_results_locked(connectionObject *conn, int pipeline,
+                       long int *rowcount, PyThreadState **tstate)
+{
+    PGresult *res, *rv = NULL;
+    const char *tuples;
+    int green = psyco_green();
+    int error = 0, nulls = 0;
+
+    *rowcount = 0;
+
+    for (;;) {
+        if (green) {
+            PyEval_RestoreThread(*tstate);
+            res = psyco_get_result_green(conn);
+            if (res == NULL && PyErr_Occurred()) {
+                *tstate = PyEval_SaveThread();
+                IFCLEARPGRES(rv);
+                return NULL;
+            }
+            *tstate = PyEval_SaveThread();
+        }
+        else {
+            res = PQgetResult(conn->pgconn);
+        }
+
+        if (res == NULL) {
+            /* in pipeline mode a NULL separates the results of each
+               command: two in a row mean there is nothing left */
+            if (pipeline && ++nulls < 2) continue;
+            break;
+        }
+        nulls = 0;
+
+        switch (PQresultStatus(res)) {
+#ifdef HAVE_PQPIPELINE
+        case PGRES_PIPELINE_SYNC:
+            PQclear(res);
+            return rv;
+
+        case PGRES_PIPELINE_ABORTED:
+            PQclear(res);
+            break;
+#endif
+
+        case PGRES_COMMAND_OK:
+        case PGRES_TUPLES_OK:
+            if (error) {
+                PQclear(res);
+                break;
+            }
+            if (*rowcount >= 0) {
+                tuples = PQcmdTuples(res);
+                if (tuples[0] != '\0')
+                    *rowcount += atol(tuples);
+                else
+                    *rowcount = -1;
+            }
+            /* the results preceding the last are kept if asked */
+            if (rv) { _pq_keep_result(conn->nextsets, rv); }
+            rv = res;
+            break;
+
+        default:
+            if (error) {
+                PQclear(res);
+                break;
+            }
+            error = 1;
+            IFCLEARPGRES(rv);
+            rv = res;
+            break;
+        }
+    }
+
+    return rv;
+}
+
+/* Fetch the result of a group of commands in the cursor.
+ *
+ * Called after _pq_get_results_locked() without any lock held. */
+
+static int
+_pq_fetch_multi(cursorObject *curs, long int rowcount)
+{
+    if (curs->pgres == NULL) {
+        curs_clear_results(curs);
+        if (!PyErr_Occurred()) {
+            PyErr_SetString(OperationalError,
+                            PQerrorMessage(curs->conn->pgconn));
+        }
+        return -1;
+    }
+
+    if (pq_fetch_sets(curs) == -1) return -1;
+
+    /* report the rows affected by all the commands, unless they can be
+       fetched one set at time: then rowcount is the one of the set */
+    if (curs->nextsets.len == 0) {
+        curs->rowcount = rowcount;
+    }
+    return 1;
+}
+
+/* pq_execute_multi - execute a group of statements in a single round trip
+
+   query contains several statements separated by semicolons: it is sent
+   as a single query, all the results are read and the rows affected summed
+   into the cursor rowcount. The first error is raised.
+
+   this fucntion locks the connection object
+   this function call Py_*_ALLOW_THREADS macros */
+
+int
+pq_execute_multi(cursorObject *curs, const char *query)
+{
+    PGresult *pgres = NULL;
+    char *error = NULL;
+    long int rowcount = -1;
+    int sent;
+    double t0;
+
+    if (_pq_check_connection(curs->conn) < 0 || _pq_check_busy(curs) < 0) {
+        return -1;
+    }
+    if (pq_stream_discard(curs) < 0) {
+        return -1;
+    }
+
+    Py_BEGIN_ALLOW_THREADS;
+    pthread_mutex_lock(&(curs->conn->lock));
+
+    if (pq_begin_locked(curs->conn, &pgres, &error, &_save) < 0) {
+        pthread_mutex_unlock(&(curs->conn->lock));
+        Py_BLOCK_THREADS;
+        pq_complete_error(curs->conn, &pgres, &error);
+        return -1;
+    }
+
+    IFCLEARCURSPGRES(curs);
+    curs_clear_results(curs);
+    Dprintf("pq_execute_multi: executing query: pgconn = %p",
+            curs->conn->pgconn);
+    Dprintf("    %-.200s", query);
+
+    _pq_stats_sent(curs->conn, query, NULL);
+    t0 = CONN_STATS_START(curs->conn);
+    if (!psyco_green()) {
+        sent = PQsendQuery(curs->conn->pgconn, query);
+    }
+    else {
+        Py_BLOCK_THREADS;
+        sent = pq_send_query(curs->conn, query);
+        curs->conn->async_status = ASYNC_WRITE;
+        Py_UNBLOCK_THREADS;
+    }
+
+    if (sent) {
+        curs->conn->nextsets = CURS_NEXTSETS(curs);
+        curs->pgres = _pq_get_results_locked(curs->conn, 0,
+                                             &rowcount, &_save);
+        curs->conn->nextsets = NULL;
+    }
+    CONN_STATS_ADD_TIME(curs->conn, wait_time, t0);
+
+    pthread_mutex_unlock(&(curs->conn->lock));
+    Py_END_ALLOW_THREADS;
+
+    return _pq_fetch_multi(curs, rowcount);
+}
+
+#ifdef HAVE_PQPIPELINE
+/* Flush the queries sent in pipeline mode on a nonblocking connection.
+ *
+ * The backend may stop reading the queries until its results are read:
+ * while waiting to send, the input is consumed into the libpq buffer so
+ * that neither side blocks.
+ *
+ * Return 0 if all the data was sent, -1 on error.
+ *
+ * This function should only be called on a locked connection without
+ * holding the global interpreter lock. */
+
+static int
+_pq_pipeline_flush_locked(connectionObject *conn)
+{
+    struct pollfd fd;
+    int res;
+
+    while ((res = PQflush(conn->pgconn)) == 1) {
+        fd.fd = PQsocket(conn->pgconn);
+        fd.events = POLLIN | POLLOUT;
+        fd.revents = 0;
+        if (poll(&fd, 1, -1) < 0) {
+            if (errno == EINTR) { continue; }
+            return -1;
+        }
+        if ((fd.revents & (POLLIN | POLLERR | POLLHUP))
+                && !PQconsumeInput(conn->pgconn)) {
+            return -1;
+        }
+    }
+    return res;
+}
+#endif
+
+/* pq_execute_pipeline - execute queries without waiting for each result
+
+   the n queries are sent with their parameters in pipeline mode and the
+   results are read after all of them have been sent, summing the rows
+   affected into the cursor rowcount. After the first error the following
+   queries are skipped by the backend and the error is raised.
+
+   the queries are sent in nonblocking mode, reading the results arrived
+   meanwhile, so a page of any size can't deadlock with the backend.
+
+   requires libpq 14: with older versions NotSupportedError is raised.
+   can't be used with a wait callback.
+
+   this fucntion locks the connection object
+   this function call Py_*_ALLOW_THREADS macros */
+
+int
+pq_execute_pipeline(cursorObject *curs, const char **queries,
+                    const pqParams *params, int n)
+{
+#ifdef HAVE_PQPIPELINE
+    PGresult *pgres = NULL;
+    char *error = NULL;
+    long int rowcount = -1;
+    int i, sent = 0, blocking;
+    double t0;
+
+    if (_pq_check_connection(curs->conn) < 0 || _pq_check_busy(curs) < 0) {
+        return -1;
+    }
+    if (pq_stream_discard(curs) < 0) {
+        return -1;
+    }
+
+    Py_BEGIN_ALLOW_THREADS;
+    pthread_mutex_lock(&(curs->conn->lock));
+
+    if (pq_begin_locked(curs->conn, &pgres, &error, &_save) < 0) {
+        pthread_mutex_unlock(&(curs->conn->lock));
+        Py_BLOCK_THREADS;
+        pq_complete_error(curs->conn, &pgres, &error);
+        return -1;
+    }
+
+    IFCLEARCURSPGRES(curs);
+    curs_clear_results(curs);
+    Dprintf("pq_execute_pipeline: sending %d queries: pgconn = %p",
+            n, curs->conn->pgconn);
+
+    t0 = CONN_STATS_START(curs->conn);
+    blocking = !PQisnonblocking(curs->conn->pgconn);
+    if (blocking && 0 != PQsetnonblocking(curs->conn->pgconn, 1)) {
+        Dprintf("pq_execute_pipeline: PQsetnonblocking() failed");
+    }
+    else if (PQenterPipelineMode(curs->conn->pgconn)) {
+        for (i = 0; i < n; i++) {
+            if (!pq_send_query_params(curs->conn, queries[i], &params[i])) {
+                break;
+            }
+            _pq_stats_sent(curs->conn, queries[i], &params[i]);
+            sent++;
+        }
+
+        /* read the results of what was sent in any case, to leave the
+           connection in a clean state */
+        if (PQpipelineSync(curs->conn->pgconn)
+                && 0 == _pq_pipeline_flush_locked(curs->conn)) {
+            if (blocking) {
+                PQsetnonblocking(curs->conn->pgconn, 0);
+                blocking = 0;
+            }
+            curs->conn->nextsets = CURS_NEXTSETS(curs);
+            curs->pgres = _pq_get_results_locked(curs->conn, 1,
+                                                 &rowcount, &_save);
+            curs->conn->nextsets = NULL;
+        }
+        PQexitPipelineMode(curs->conn->pgconn);
+        CONN_STATS_ADD_TIME(curs->conn, wait_time, t0);
+
+        if (sent < n && curs->pgres
+                && PQresultStatus(curs->pgres) != PGRES_FATAL_ERROR) {
+            CLEARPGRES(curs->pgres);
+        }
+    }
+    if (blocking) {
+        PQsetnonblocking(curs->conn->pgconn, 0);
+    }
+
+    pthread_mutex_unlock(&(curs->conn->lock));
+    Py_END_ALLOW_THREADS;
+
+    return _pq_fetch_multi(curs, rowcount);
+
+#else
+    PyErr_SetString(NotSupportedError,
+        "pipeline mode requires libpq 14 or later");
+    return -1;
+#endif
+}
+
+/* send an async query to the backend.
+ *
+ * Return 1 if command succeeded, else 0.
+ *
+ * The function should be called helding the connection lock and the GIL.
+ */
+int
+pq_send_query(connectionObject *conn, const char *query)
+{
+    return pq_send_query_params(conn, query, NULL);
+}
+
+/* send an async query with out-of-line parameters to the backend.
+ *
+ * If params is NULL or empty, the query is sent with PQsendQuery(), or
+ * with no parameters in pipeline mode.
+ *
+ * Return 1 if command succeeded, else 0.
+ *
+ * The function should be called helding the connection lock.
+ */
+int
+pq_send_query_params(connectionObject *conn, const char *query,
+                     const pqParams *params)
+{
     int rv;
 
     Dprintf("pq_send_query: sending ASYNC query:");
     Dprintf("    %-.200s", query);
 
-    if (0 == (rv = PQsendQuery(conn->pgconn, query))) {
+    if (params && params->name) {
+        Dprintf("pq_send_query: executing prepared statement '%s'",
+                params->name);
+        rv = PQsendQueryPrepared(conn->pgconn, params->name,
+            params->nparams, params->values, params->lengths,
+            params->formats, params->result_format);
+    }
+    else if (params && (params->nparams > 0 || params->result_format)) {
+        Dprintf("pq_send_query: with %d parameters", params->nparams);
+        rv = PQsendQueryParams(conn->pgconn, query, params->nparams,
+            params->types, params->values, params->lengths,
+            params->formats, params->result_format);
+    }
+#ifdef HAVE_PQPIPELINE
+    else if (PQpipelineStatus(conn->pgconn) != PQ_PIPELINE_OFF) {
+        /* the simple query protocol is not allowed in pipeline mode */
+        rv = PQsendQueryParams(conn->pgconn, query,
+                               0, NULL, NULL, NULL, NULL, 0);
+    }
+#endif
+    else {
+        rv = PQsendQuery(conn->pgconn, query);
+    }
+
+    if (0 == rv) {
         Dprintf("pq_send_query: error: %s", PQerrorMessage(conn->pgconn));
     }
 
     return rv;
 }
 
+/* send an async statement preparation request to the backend.
+ *
+ * Return 1 if command succeeded, else 0.
+ *
+ * The function should be called helding the connection lock.
+ */
+int
+pq_send_prepare(connectionObject *conn, const char *name,
+                const char *query, const pqParams *params)
+{
+    int rv;
+
+    Dprintf("pq_send_prepare: preparing ASYNC statement '%s'", name);
+
+    if (0 == (rv = PQsendPrepare(conn->pgconn, name, query,
+            params ? params->nparams : 0, params ? params->types : NULL))) {
+        Dprintf("pq_send_prepare: error: %s", PQerrorMessage(conn->pgconn));
+    }
+
+    return rv;
+}
+
 /* Return the last result available on the connection.
  *
  * The function will block will block only if a command is active and the
@@ -864,19 +2486,24 @@ pq_get_last_result(connectionObject *conn)
 {
     PGresult *result = NULL, *res;
 
-    /* Read until PQgetResult gives a NULL */
+    /* Read until PQgetResult gives a NULL or the connection enters COPY
+       state: in this case PQgetResult would return the same status forever */
     while (NULL != (res = PQgetResult(conn->pgconn))) {
         if (result) {
-            /* TODO too bad: we are discarding results from all the queries
-             * except the last. We could have populated `nextset()` with it
-             * but it would be an incompatible change (apps currently issue
-             * groups of queries expecting to receive the last result: they
-             * would start receiving the first instead). */
-            PQclear(result);
+            /* the results of all the queries but the last are discarded,
+             * unless the cursor keeps them for nextset(): apps issue groups
+             * of queries expecting to receive the last result. */
+            _pq_keep_result(conn->nextsets, result);
         }
         result = res;
+        if (PQresultStatus(res) == PGRES_COPY_IN
+                || PQresultStatus(res) == PGRES_COPY_OUT) {
+            break;
+        }
     }
 
+    /* the query may have changed the setting */
+    conn_read_std_strings(conn);
     return result;
 }
 
@@ -891,305 +2518,1330 @@ pq_get_last_result(connectionObject *conn)
       1 - result from backend (possibly data is ready)
 */
 
+/* Return 1 if the binary format of the type is the same of the text one */
+
+static int
+_pq_is_text_type(Oid ftype)
+{
+    switch (ftype) {
+    case TEXTOID: case VARCHAROID: case BPCHAROID: case NAMEOID: case CHAROID:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/* pq_lookup_cast - return the typecaster of a type, NULL if not found
+
+   fill the right cast function by accessing three different dictionaries:
+   - the per-cursor dictionary, if available (can be NULL or None)
+   - the per-connection dictionary (always exists but can be null)
+   - the global dictionary (at module level)
+   if binary is set look for the typecasters of the binary format. Return a
+   borrowed reference, without an exception set if there is no typecaster.
+   This function should be called holding the GIL. */
+
+PyObject *
+pq_lookup_cast(cursorObject *curs, PyObject *type, Oid ftype, int binary)
+{
+    PyObject *cast = NULL;
+
+    Dprintf("pq_lookup_cast: looking for cast %d:", ftype);
+    if (binary) {
+        /* binary results use the binary typecasters */
+        if (curs->binary_types != NULL && curs->binary_types != Py_None) {
+            cast = PyDict_GetItem(curs->binary_types, type);
+            Dprintf("pq_lookup_cast:     per-cursor binary dict: %p", cast);
+        }
+        if (cast == NULL) {
+            cast = PyDict_GetItem(curs->conn->binary_types, type);
+            Dprintf("pq_lookup_cast:     per-connection binary dict: %p",
+                    cast);
+        }
+        if (cast == NULL) {
+            cast = PyDict_GetItem(psyco_binary_types, type);
+            Dprintf("pq_lookup_cast:     global binary dict: %p", cast);
+        }
+    }
+
+    /* the binary representation of the text types is the same of the
+       text one: other fields without a binary typecaster are returned
+       as raw strings by the default cast */
+    if (cast == NULL && (!binary || _pq_is_text_type(ftype))) {
+        if (curs->string_types != NULL && curs->string_types != Py_None) {
+            cast = PyDict_GetItem(curs->string_types, type);
+            Dprintf("pq_lookup_cast:     per-cursor dict: %p", cast);
+        }
+        if (cast == NULL) {
+            cast = PyDict_GetItem(curs->conn->string_types, type);
+            Dprintf("pq_lookup_cast:     per-connection dict: %p", cast);
+        }
+        if (cast == NULL) {
+            cast = PyDict_GetItem(psyco_types, type);
+            Dprintf("pq_lookup_cast:     global dict: %p", cast);
+        }
+    }
+    return cast;
+}
+
+/* The metadata of a result column, read from the PGresult in one pass. */
+typedef struct {
+    Oid type;
+    int size;
+    int mod;
+    int dsize;              /* display size, -1 if not computed */
+    const char *name;
+    size_t namelen;
+} pqField;
+
+/* the columns metadata of most results fits on the stack */
+#define PQ_FIELDS_STACK 32
+
+/* Read the metadata of the result columns.
+ *
+ * The function only reads the PGresult: it doesn't need the GIL. */
+
 static void
-_pq_fetch_tuples(cursorObject *curs)
+_pq_read_fields(PGresult *pgres, pqField *fields, int nfields)
 {
-    int i, *dsize = NULL;
-    int pgnfields;
-    int pgbintuples;
+    int i;
+
+    for (i = 0; i < nfields; i++) {
+        fields[i].type = PQftype(pgres, i);
+        fields[i].size = PQfsize(pgres, i);
+        fields[i].mod = PQfmod(pgres, i);
+        fields[i].dsize = -1;
+        fields[i].name = PQfname(pgres, i);
+        fields[i].namelen = strlen(fields[i].name);
+    }
+}
 
-    Py_BEGIN_ALLOW_THREADS;
-    pthread_mutex_lock(&(curs->conn->lock));
+/* Return the key of the current result shape in the typecasters cache.
+ *
+ * The key is made of the format, type, modifier, size and name of every
+ * column. Return NULL if the cache can't be used for the cursor.
+ *
+ * This function should be called holding the GIL. */
+
+static PyObject *
+_pq_casts_key(cursorObject *curs, const pqField *fields, int pgnfields,
+              int pgbintuples)
+{
+#ifdef PSYCOPG_DISPLAY_SIZE
+    /* the description depends on the data */
+    return NULL;
+#else
+    connectionObject *conn = curs->conn;
+    PyObject *key;
+    Py_ssize_t len;
+    char *p;
+    int i;
+
+    /* the per-cursor typecasters may change at any time */
+    if ((curs->string_types != NULL && curs->string_types != Py_None)
+        || (curs->binary_types != NULL && curs->binary_types != Py_None)) {
+        return NULL;
+    }
+
+    if (conn->casts_cache == NULL) {
+        if (!(conn->casts_cache = PyDict_New())) { goto error; }
+        conn->casts_generation = registry_generation;
+    }
+    else if (conn->casts_generation != registry_generation) {
+        Dprintf("_pq_casts_key: typecasters changed: clearing the cache");
+        PyDict_Clear(conn->casts_cache);
+        conn->casts_generation = registry_generation;
+    }
+
+    len = 1;
+    for (i = 0; i < pgnfields; i++) {
+        len += sizeof(Oid) + 2 * sizeof(int) + fields[i].namelen + 1;
+    }
+
+    if (!(key = PyString_FromStringAndSize(NULL, len))) { goto error; }
+
+    p = PyString_AS_STRING(key);
+    *p++ = pgbintuples ? 'b' : 't';
+    for (i = 0; i < pgnfields; i++) {
+        memcpy(p, &fields[i].type, sizeof(Oid)); p += sizeof(Oid);
+        memcpy(p, &fields[i].mod, sizeof(int)); p += sizeof(int);
+        memcpy(p, &fields[i].size, sizeof(int)); p += sizeof(int);
+        memcpy(p, fields[i].name, fields[i].namelen + 1);
+        p += fields[i].namelen + 1;
+    }
+
+    return key;
+
+error:
+    /* the cache is just an optimization */
+    PyErr_Clear();
+    return NULL;
+#endif
+}
+
+/* Store the typecasters of a result shape in the cache.
+ *
+ * The entry is a list [casts, description]: the description is added by
+ * pq_fetch_description() the first time it is requested for the shape.
+ *
+ * This function should be called holding the GIL. */
+
+static void
+_pq_casts_cache_put(cursorObject *curs, PyObject *key)
+{
+    PyObject *cache = curs->conn->casts_cache;
+    PyObject *entry;
+
+    if (!curs->casts) { return; }
+
+    if (PyDict_Size(cache) >= CONN_CASTS_CACHE_LIMIT) {
+        PyDict_Clear(cache);
+    }
+
+    if ((entry = Py_BuildValue("[OO]", curs->casts, Py_None))) {
+        if (0 > PyDict_SetItem(cache, key, entry)) {
+            PyErr_Clear();
+            Py_DECREF(entry);
+            return;
+        }
+        curs->casts_entry = entry;
+    }
+    else {
+        PyErr_Clear();
+    }
+}
+
+/* Resolve the C functions of the cursor typecasters.
+ *
+ * Leave curs->ccasts NULL if any typecaster is implemented in Python: the
+ * rows will be built through typecast_cast().
+ *
+ * This function should be called holding the GIL. */
+
+static void
+_pq_resolve_ccasts(cursorObject *curs)
+{
+    Py_ssize_t i, n;
+    typecast_function *ccasts;
+
+    PyMem_Free(curs->ccasts);
+    curs->ccasts = NULL;
+
+    if (curs->casts == NULL) { return; }
+
+    n = PyTuple_GET_SIZE(curs->casts);
+    for (i = 0; i < n; i++) {
+        if (!((typecastObject *)PyTuple_GET_ITEM(curs->casts, i))->ccast) {
+            Dprintf("_pq_resolve_ccasts: column %d has a Python cast", (int)i);
+            return;
+        }
+    }
+
+    /* on allocation failure we just use the slow path */
+    if (!(ccasts = PyMem_New(typecast_function, n > 0 ? n : 1))) { return; }
+    for (i = 0; i < n; i++) {
+        ccasts[i] = ((typecastObject *)PyTuple_GET_ITEM(curs->casts, i))->ccast;
+    }
+    curs->ccasts = ccasts;
+}
+
+static int
+_pq_fetch_tuples(cursorObject *curs)
+{
+    pqField stack_fields[PQ_FIELDS_STACK], *fields = stack_fields;
+    int i;
+    int pgnfields;
+    int pgbintuples;
+    PyObject *key, *entry;
+
+    /* the result belongs to the cursor: reading it doesn't need the
+       connection lock. All the metadata is read in a single pass and the
+       Python objects are built afterwards, without switching the GIL. */
+    pgnfields = PQnfields(curs->pgres);
+    pgbintuples = PQbinaryTuples(curs->pgres);
+
+    curs->notuples = 0;
+
+    if (pgnfields > PQ_FIELDS_STACK
+            && !(fields = PyMem_New(pqField, pgnfields))) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    _pq_read_fields(curs->pgres, fields, pgnfields);
+
+    /* the description is built from pgres only if requested */
+    Py_CLEAR(curs->description);
+    Py_CLEAR(curs->casts);
+    Py_CLEAR(curs->casts_entry);
+
+    /* a result with the same shape may have been already seen */
+    key = _pq_casts_key(curs, fields, pgnfields, pgbintuples);
+    if (key && (entry = PyDict_GetItem(curs->conn->casts_cache, key))) {
+        Dprintf("_pq_fetch_tuples: typecasters found in the cache");
+        curs->casts = PyList_GET_ITEM(entry, 0);
+        Py_INCREF(curs->casts);
+        if (PyList_GET_ITEM(entry, 1) != Py_None) {
+            curs->description = PyList_GET_ITEM(entry, 1);
+            Py_INCREF(curs->description);
+        }
+        curs->casts_entry = entry;
+        Py_INCREF(entry);
+        curs->columns = pgnfields;
+        Py_DECREF(key);
+        _pq_resolve_ccasts(curs);
+        curs_intern_setup(curs);
+        goto exit;
+    }
+
+    curs->casts = PyTuple_New(pgnfields);
+    curs->columns = pgnfields;
+
+    /* find the typecasters of the columns */
+    for (i = 0; i < pgnfields; i++) {
+        Oid ftype = fields[i].type;
+        PyObject *type;
+        PyObject *cast = NULL;
+
+        type = PyInt_FromLong(ftype);
+        cast = pq_lookup_cast(curs, type, ftype, pgbintuples);
+        Py_DECREF(type);
+        if (cast == NULL) cast = psyco_default_cast;
+        cast = typecast_numeric_for_column(cast, fields[i].mod);
+
+        Dprintf("_pq_fetch_tuples: using cast at %p (%s) for type %d",
+                cast, PyString_AS_STRING(((typecastObject*)cast)->name),
+                ftype);
+        Py_INCREF(cast);
+        PyTuple_SET_ITEM(curs->casts, i, cast);
+    }
+
+    if (key) {
+        _pq_casts_cache_put(curs, key);
+        Py_DECREF(key);
+    }
+    _pq_resolve_ccasts(curs);
+    curs_intern_setup(curs);
+
+exit:
+    if (fields != stack_fields) {
+        PyMem_Free(fields);
+    }
+    return 0;
+}
+
+/* Build the DBAPI description of the columns of a result.
+ *
+ * This function should be called holding the GIL. */
+
+static PyObject *
+_pq_build_description(PGresult *pgres, pqField *fields, int pgnfields)
+{
+    PyObject *description, *dtitem;
+    int i;
+
+    /* calculate the display size for each column (cpu intensive, can be
+       switched off at configuration time) */
+#ifdef PSYCOPG_DISPLAY_SIZE
+    Py_BEGIN_ALLOW_THREADS;
+    {
+        int j, len, ntuples = PQntuples(pgres);
+        for (j = 0; j < ntuples; j++) {
+            for (i = 0; i < pgnfields; i++) {
+                len = PQgetlength(pgres, j, i);
+                if (len > fields[i].dsize) fields[i].dsize = len;
+            }
+        }
+    }
+    Py_END_ALLOW_THREADS;
+#endif
+
+    if (!(description = PyTuple_New(pgnfields))) { return NULL; }
+
+    for (i = 0; i < pgnfields; i++) {
+        Oid ftype = fields[i].type;
+        int fsize = fields[i].size;
+        int fmod = fields[i].mod;
+
+        if (!(dtitem = PyTuple_New(7))) {
+            Py_DECREF(description);
+            return NULL;
+        }
+        PyTuple_SET_ITEM(description, i, dtitem);
+
+        /* 1/ fill the other fields */
+        PyTuple_SET_ITEM(dtitem, 0, PyString_FromStringAndSize(
+            fields[i].name, fields[i].namelen));
+        PyTuple_SET_ITEM(dtitem, 1, PyInt_FromLong(ftype));
+
+        /* 2/ display size is the maximum size of this field result tuples. */
+        if (fields[i].dsize >= 0) {
+            PyTuple_SET_ITEM(dtitem, 2, PyInt_FromLong(fields[i].dsize));
+        }
+        else {
+            Py_INCREF(Py_None);
+            PyTuple_SET_ITEM(dtitem, 2, Py_None);
+        }
+
+        /* 3/ size on the backend */
+        if (fmod > 0) fmod = fmod - sizeof(int);
+        if (fsize == -1) {
+            if (ftype == NUMERICOID) {
+                PyTuple_SET_ITEM(dtitem, 3,
+                                 PyInt_FromLong((fmod >> 16) & 0xFFFF));
+            }
+            else { /* If variable length record, return maximum size */
+                PyTuple_SET_ITEM(dtitem, 3, PyInt_FromLong(fmod));
+            }
+        }
+        else {
+            PyTuple_SET_ITEM(dtitem, 3, PyInt_FromLong(fsize));
+        }
+
+        /* 4,5/ scale and precision */
+        if (ftype == NUMERICOID) {
+            PyTuple_SET_ITEM(dtitem, 4, PyInt_FromLong((fmod >> 16) & 0xFFFF));
+            PyTuple_SET_ITEM(dtitem, 5, PyInt_FromLong(fmod & 0xFFFF));
+        }
+        else {
+            Py_INCREF(Py_None);
+            PyTuple_SET_ITEM(dtitem, 4, Py_None);
+            Py_INCREF(Py_None);
+            PyTuple_SET_ITEM(dtitem, 5, Py_None);
+        }
+
+        /* 6/ FIXME: null_ok??? */
+        Py_INCREF(Py_None);
+        PyTuple_SET_ITEM(dtitem, 6, Py_None);
+    }
+
+    return description;
+}
+
+/* pq_fetch_description - build the description of the cursor result
+
+   _pq_fetch_tuples() leaves curs->description NULL: it is built here from
+   pgres the first time it is requested, and stored in the casts cache for
+   the following results with the same shape. Without a result to read it
+   from the description is None.
+
+   return 0 on success, -1 with an exception set on error */
+
+int
+pq_fetch_description(cursorObject *curs)
+{
+    pqField stack_fields[PQ_FIELDS_STACK], *fields = stack_fields;
+    PyObject *description;
+    int pgnfields;
+
+    if (curs->description) { return 0; }
+
+    if (!curs->pgres) {
+        Py_INCREF(Py_None);
+        curs->description = Py_None;
+        return 0;
+    }
+
+    pgnfields = PQnfields(curs->pgres);
+    if (pgnfields > PQ_FIELDS_STACK
+            && !(fields = PyMem_New(pqField, pgnfields))) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    _pq_read_fields(curs->pgres, fields, pgnfields);
+
+    description = _pq_build_description(curs->pgres, fields, pgnfields);
+    if (fields != stack_fields) {
+        PyMem_Free(fields);
+    }
+    if (!description) { return -1; }
+
+    Dprintf("pq_fetch_description: built description of %d columns",
+            pgnfields);
+    curs->description = description;
+    if (curs->casts_entry) {
+        Py_INCREF(description);
+        PyList_SetItem(curs->casts_entry, 1, description);
+    }
+    return 0;
+}
+
+/* Wait for the socket during a COPY on a green connection.
+
+   status is ASYNC_COPY_IN to wait for the output to be flushed or
+   ASYNC_COPY_OUT to wait for more data to read. Return 0 on success, else
+   -1 with an exception set by the wait callback.
+
+   The connection is locked while the wait callback polls it. */
+
+static int
+_pq_copy_wait_green(connectionObject *conn, int status)
+{
+    int rv;
+
+    Py_BEGIN_ALLOW_THREADS;
+    pthread_mutex_lock(&(conn->lock));
+    Py_BLOCK_THREADS;
+    conn->async_status = status;
+    rv = psyco_wait(conn);
+    conn->async_status = ASYNC_DONE;
+    Py_UNBLOCK_THREADS;
+    pthread_mutex_unlock(&(conn->lock));
+    Py_END_ALLOW_THREADS;
+    return rv;
+}
+
+/* flush the output of a green connection during COPY FROM
+
+   return 0 on success, -1 on libpq error, -2 on wait callback error */
+
+static int
+_pq_copy_flush(connectionObject *conn)
+{
+    int res;
+
+    if (!psyco_green()) { return 0; }
+
+    Py_BEGIN_ALLOW_THREADS;
+    pthread_mutex_lock(&(conn->lock));
+    res = PQflush(conn->pgconn);
+    pthread_mutex_unlock(&(conn->lock));
+    Py_END_ALLOW_THREADS;
+    if (res == 1) {
+        /* the poll flushes until all the data is sent */
+        if (0 != _pq_copy_wait_green(conn, ASYNC_COPY_IN)) { return -2; }
+        res = 0;
+    }
+    return res;
+}
+
+/* send a chunk of COPY data
+
+   return 0 on success, -1 on libpq error, -2 on wait callback error */
+
+static int
+_pq_put_copy_data(cursorObject *curs, const char *data, Py_ssize_t len)
+{
+    int res;
+
+    while (1) {
+        Py_BEGIN_ALLOW_THREADS;
+        pthread_mutex_lock(&(curs->conn->lock));
+        res = PQputCopyData(curs->conn->pgconn, data, (int) len);
+        pthread_mutex_unlock(&(curs->conn->lock));
+        Py_END_ALLOW_THREADS;
+        Dprintf("_pq_put_copy_data: sent %d bytes of data; res = %d",
+            (int) len, res);
+
+        /* 0 means that the data couldn't be queued: only happens in
+           nonblocking mode, so there is a wait callback */
+        if (res != 0) { break; }
+        if (0 != _pq_copy_wait_green(curs->conn, ASYNC_COPY_IN)) {
+            return -2;
+        }
+    }
+
+    if (res == -1) {
+        Dprintf("_pq_put_copy_data: PQerrorMessage = %s",
+            PQerrorMessage(curs->conn->pgconn));
+        return -1;
+    }
+    CONN_STATS_ADD(curs->conn, copy_bytes, len);
+
+    /* don't let the data pile up in the libpq buffer */
+    return _pq_copy_flush(curs->conn);
+}
+
+/* read a COPY result from the backend, waiting if the connection is green */
+
+static PGresult *
+_pq_copy_get_result(connectionObject *conn)
+{
+    PGresult *res;
+
+    Py_BEGIN_ALLOW_THREADS;
+    pthread_mutex_lock(&(conn->lock));
+    if (psyco_green()) {
+        Py_BLOCK_THREADS;
+        res = psyco_get_result_green(conn);
+        Py_UNBLOCK_THREADS;
+    }
+    else {
+        res = PQgetResult(conn->pgconn);
+    }
+    pthread_mutex_unlock(&(conn->lock));
+    Py_END_ALLOW_THREADS;
+    return res;
+}
+
+/* terminate a COPY FROM and read its result
+
+   errormsg is NULL if the copy went well, else the reason to abort it
+   passed to the backend. Set the cursor rowcount on success. Return 0 on
+   success, -1 with an exception set on error (an exception already set by
+   the caller is not replaced). */
+
+static int
+_pq_copy_end(cursorObject *curs, const char *errormsg)
+{
+    int res;
+
+    while (1) {
+        Py_BEGIN_ALLOW_THREADS;
+        pthread_mutex_lock(&(curs->conn->lock));
+        res = PQputCopyEnd(curs->conn->pgconn, errormsg);
+        pthread_mutex_unlock(&(curs->conn->lock));
+        Py_END_ALLOW_THREADS;
+        if (res != 0) { break; }
+        if (0 != _pq_copy_wait_green(curs->conn, ASYNC_COPY_IN)) {
+            return -1;
+        }
+    }
+    if (res == 1) {
+        res = _pq_copy_flush(curs->conn);
+        if (res == -2) { return -1; }
+    }
+
+    IFCLEARCURSPGRES(curs);
+
+    Dprintf("_pq_copy_end: copy ended; res = %d", res);
+
+    /* if the result is -1 we should not even try to get a result from the
+       bacause that will lock the current thread forever */
+    if (res == -1) {
+        if (!PyErr_Occurred()) {
+            pq_raise(curs->conn, curs, NULL);
+        }
+        /* FIXME: pq_raise check the connection but for some reason even
+           if the error message says "server closed the connection unexpectedly"
+           the status returned by PQstatus is CONNECTION_OK! */
+        curs->conn->closed = 2;
+        return -1;
+    }
+
+    /* and finally we grab the operation result from the backend */
+    while ((curs->pgres = _pq_copy_get_result(curs->conn)) != NULL) {
+        if (PQresultStatus(curs->pgres) == PGRES_FATAL_ERROR) {
+            if (!PyErr_Occurred()) {
+                pq_raise(curs->conn, curs, NULL);
+            }
+        }
+        else if (PQresultStatus(curs->pgres) == PGRES_COMMAND_OK) {
+            const char *rowcount = PQcmdTuples(curs->pgres);
+            if (rowcount && rowcount[0])
+                curs->rowcount = atol(rowcount);
+        }
+        IFCLEARCURSPGRES(curs);
+    }
+
+    /* the copy was aborted but the backend didn't report anything */
+    if (errormsg && !PyErr_Occurred()) {
+        PyErr_SetString(OperationalError, PQerrorMessage(curs->conn->pgconn));
+    }
+
+    return PyErr_Occurred() ? -1 : 0;
+}
+
+static int
+_pq_copy_in_v3(cursorObject *curs)
+{
+    /* COPY FROM implementation when protocol 3 is available: this function
+       uses the new PQputCopyData() and can detect errors and set the correct
+       exception */
+    PyObject *o = NULL, *func = NULL, *size = NULL, *buf = NULL;
+    Py_buffer view;
+    const void *data;
+    Py_ssize_t length = 0;
+    int res, error = 0, release;
+
+    /* if the file has readinto() read all the data into the same buffer,
+       else accept from read() any object exposing a buffer */
+    if (PyObject_HasAttrString(curs->copyfile, "readinto")) {
+        if (!(func = PyObject_GetAttrString(curs->copyfile, "readinto"))) {
+            Dprintf("_pq_copy_in_v3: can't get o.readinto");
+            error = 1;
+            goto exit;
+        }
+        if (!(buf = PyByteArray_FromStringAndSize(NULL, curs->copysize))) {
+            error = 1;
+            goto exit;
+        }
+    }
+    else {
+        if (!(func = PyObject_GetAttrString(curs->copyfile, "read"))) {
+            Dprintf("_pq_copy_in_v3: can't get o.read");
+            error = 1;
+            goto exit;
+        }
+        if (!(size = PyInt_FromSsize_t(curs->copysize))) {
+            Dprintf("_pq_copy_in_v3: can't get int from copysize");
+            error = 1;
+            goto exit;
+        }
+    }
+
+    while (1) {
+        release = 0;
+        if (buf) {
+            if (!(o = PyObject_CallFunctionObjArgs(func, buf, NULL))) {
+                error = 1;
+                break;
+            }
+            length = PyInt_AsSsize_t(o);
+            if (length == -1 && PyErr_Occurred()) {
+                error = 1;
+                break;
+            }
+            if (length < 0 || length > PyByteArray_GET_SIZE(buf)) {
+                PyErr_SetString(PyExc_ValueError,
+                    "readinto() returned a bad value");
+                error = 1;
+                break;
+            }
+            data = PyByteArray_AS_STRING(buf);
+        }
+        else {
+            if (!(o = PyObject_CallFunctionObjArgs(func, size, NULL))) {
+                error = 1;
+                break;
+            }
+            if (PyUnicode_Check(o)) {
+                PyErr_SetString(PyExc_TypeError,
+                    "read() must return a string or a buffer, not unicode");
+                error = 1;
+                break;
+            }
+            if (PyObject_CheckBuffer(o)) {
+                if (0 != PyObject_GetBuffer(o, &view, PyBUF_SIMPLE)) {
+                    error = 1;
+                    break;
+                }
+                release = 1;
+                data = view.buf;
+                length = view.len;
+            }
+            else if (0 != PyObject_AsReadBuffer(o, &data, &length)) {
+                error = 1;
+                break;
+            }
+        }
+
+        if (length == 0 || length > INT_MAX) {
+            if (release) PyBuffer_Release(&view);
+            break;
+        }
+
+        res = _pq_put_copy_data(curs, data, length);
+        if (release) PyBuffer_Release(&view);
+        if (res != 0) {
+            error = (res == -1 ? 2 : 1);
+            break;
+        }
+
+        Py_CLEAR(o);
+    }
+
+    Py_XDECREF(o);
+
+    Dprintf("_pq_copy_in_v3: error = %d", error);
+
+    /* 0 means that the copy went well, 2 that there was an error on the
+       backend: in both cases we'll get the error message from the PQresult */
+    if (error == 0)
+        res = _pq_copy_end(curs, NULL);
+    else if (error == 2)
+        res = _pq_copy_end(curs, "error in PQputCopyData() call");
+    else
+        res = _pq_copy_end(curs, "error in .read() call");
+    if (res != 0) { error = 1; }
+
+exit:
+    Py_XDECREF(func);
+    Py_XDECREF(size);
+    Py_XDECREF(buf);
+    return (error == 0 ? 1 : -1);
+}
+
+static int
+_pq_copy_in_records(cursorObject *curs)
+{
+    /* COPY FROM implementation for copy_records(): the records are encoded
+       in binary format and sent when the buffer is full */
+    copyRecords *rec = curs->copyrecords;
+    PyObject *record;
+    int res, error = 0;
+
+    if (0 != copy_binary_header(&rec->buf)) { error = 1; }
+
+    while (!error) {
+        if (!(record = PyIter_Next(rec->iter))) {
+            if (PyErr_Occurred()) { error = 1; }
+            break;
+        }
+        res = copy_binary_record(rec, record, curs->conn);
+        Py_DECREF(record);
+        if (res != 0) { error = 1; break; }
+
+        if (rec->buf.len >= rec->size) {
+            if (rec->buf.len > INT_MAX) {
+                PyErr_SetString(DataError, "record too large");
+                error = 1;
+                break;
+            }
+            if (0 != _pq_put_copy_data(curs, rec->buf.data, rec->buf.len)) {
+                error = 2;
+                break;
+            }
+            rec->buf.len = 0;
+        }
+    }
+
+    if (!error) {
+        if (0 != copy_binary_trailer(&rec->buf)) {
+            error = 1;
+        }
+        else if (rec->buf.len > INT_MAX) {
+            PyErr_SetString(DataError, "record too large");
+            error = 1;
+        }
+        else if (0 != _pq_put_copy_data(
+                curs, rec->buf.data, rec->buf.len)) {
+            error = 2;
+        }
+    }
+    copy_buffer_free(&rec->buf);
+
+    Dprintf("_pq_copy_in_records: error = %d", error);
+
+    if (error == 0)
+        res = _pq_copy_end(curs, NULL);
+    else if (error == 2)
+        res = _pq_copy_end(curs, "error in PQputCopyData() call");
+    else
+        res = _pq_copy_end(curs, "error encoding the records");
+    if (res != 0) { error = 1; }
+
+    return (error == 0 ? 1 : -1);
+}
+
+/* read COPY TO data until at least size bytes are available
+
+   the rows are appended to the malloc'd buffer *buf (*blen bytes used,
+   *balloc allocated) unless the buffer is empty and a row is at least size
+   bytes long: in this case the row is returned in *row, to be released with
+   PQfreemem(). Return the result of the last PQgetCopyData(): > 0 if there
+   may be more data, -1 if the copy is finished, -2 on libpq error; return -3
+   with an exception set on Python error. */
+
+static Py_ssize_t
+_pq_copy_out_fill(cursorObject *curs, Py_ssize_t size,
+                  char **buf, Py_ssize_t *blen, Py_ssize_t *balloc,
+                  char **row)
+{
+    int nomem, green = psyco_green();
+    Py_ssize_t len, copied;
+
+    while (1) {
+        *row = NULL;
+        nomem = 0;
+        copied = 0;
+
+        Py_BEGIN_ALLOW_THREADS;
+        pthread_mutex_lock(&(curs->conn->lock));
+        while (1) {
+            /* on green connections read without blocking: 0 means that
+               the data is not available yet */
+            len = PQgetCopyData(curs->conn->pgconn, row, green);
+            if (len <= 0 || !*row) { *row = NULL; break; }
+            copied += len;
+            if (*blen == 0 && len >= size) break;
+
+            if (*blen + len > *balloc) {
+                char *tmpbuf;
+                Py_ssize_t tmpalloc = *balloc ? *balloc : size;
+                while (tmpalloc < *blen + len) tmpalloc *= 2;
+                if (!(tmpbuf = (char *)realloc(*buf, tmpalloc))) {
+                    nomem = 1;
+                    break;
+                }
+                *buf = tmpbuf;
+                *balloc = tmpalloc;
+            }
+            memcpy(*buf + *blen, *row, len);
+            *blen += len;
+            PQfreemem(*row);
+            *row = NULL;
+            if (*blen >= size) break;
+        }
+        pthread_mutex_unlock(&(curs->conn->lock));
+        Py_END_ALLOW_THREADS;
+        CONN_STATS_ADD(curs->conn, copy_bytes, copied);
+
+        if (nomem) {
+            PQfreemem(*row);
+            *row = NULL;
+            PyErr_NoMemory();
+            return -3;
+        }
+
+        if (len == 0 && green) {
+            if (0 != _pq_copy_wait_green(curs->conn, ASYNC_COPY_OUT)) {
+                return -3;
+            }
+            continue;
+        }
+
+        return len;
+    }
+}
+
+/* read the result of a COPY TO once the data is finished
+
+   len is the last value returned by PQgetCopyData(). Return 0 on success,
+   else -1 with an exception set. */
+
+static int
+_pq_copy_out_end(cursorObject *curs, Py_ssize_t len)
+{
+    if (len == -2) {
+        pq_raise(curs->conn, curs, NULL);
+        return -1;
+    }
+
+    /* and finally we grab the operation result from the backend */
+    IFCLEARCURSPGRES(curs);
+    while ((curs->pgres = _pq_copy_get_result(curs->conn)) != NULL) {
+        if (PQresultStatus(curs->pgres) == PGRES_FATAL_ERROR)
+            pq_raise(curs->conn, curs, NULL);
+        IFCLEARCURSPGRES(curs);
+    }
+
+    return PyErr_Occurred() ? -1 : 0;
+}
+
+static int
+_pq_copy_out_v3(cursorObject *curs)
+{
+    PyObject *tmp = NULL, *func;
+    int ret = -1;
+
+    char *buffer = NULL, *row;
+    Py_ssize_t len, blen = 0, balloc = 0;
+
+    if (!(func = PyObject_GetAttrString(curs->copyfile, "write"))) {
+        Dprintf("_pq_copy_out_v3: can't get o.write");
+        goto exit;
+    }
+
+    /* gather the rows into a buffer at least copysize big before calling
+       write(): rows bigger than that are written without copying them */
+    while (1) {
+        len = _pq_copy_out_fill(curs, curs->copysize,
+                                &buffer, &blen, &balloc, &row);
+        if (len == -3) goto exit;
+
+        if (row) {
+            tmp = PyObject_CallFunction(func, "s#", row, len);
+            PQfreemem(row);
+        }
+        else if (blen) {
+            tmp = PyObject_CallFunction(func, "s#", buffer, blen);
+            blen = 0;
+        }
+        else {
+            break;
+        }
+        if (tmp == NULL) {
+            goto exit;
+        } else {
+            Py_DECREF(tmp);
+        }
+        /* we break on len == 0 but note that that should *not* happen,
+           because we are not doing an async call (if it happens blame
+           postgresql authors :/) */
+        if (len <= 0) break;
+    }
+
+    if (0 == _pq_copy_out_end(curs, len)) {
+        ret = 1;
+    }
+
+exit:
+    Py_XDECREF(func);
+    if (buffer) free(buffer);
+    return ret;
+}
+
+/* pq_copy_out_chunk - read a chunk of data from a COPY TO stream
+
+   *chunk is set to a string of at least size bytes, unless the data is
+   finished, or to NULL if there is no more data. *buf and *balloc are a
+   buffer to be reused across calls and released with free() at the end.
+
+   return value:
+     -1 - an error occurred: an exception is set
+      0 - the copy is finished: no need to call the function again
+      1 - there may be more data to read
+*/
+
+int
+pq_copy_out_chunk(cursorObject *curs, Py_ssize_t size,
+                  char **buf, Py_ssize_t *balloc, PyObject **chunk)
+{
+    char *row;
+    Py_ssize_t len, blen = 0;
+
+    *chunk = NULL;
+
+    len = _pq_copy_out_fill(curs, size, buf, &blen, balloc, &row);
+    if (len == -3) return -1;
+
+    if (row) {
+        *chunk = PyString_FromStringAndSize(row, len);
+        PQfreemem(row);
+        if (!*chunk) return -1;
+    }
+    else if (blen) {
+        if (!(*chunk = PyString_FromStringAndSize(*buf, blen))) return -1;
+    }
+
+    if (len > 0) return 1;
+
+    if (0 != _pq_copy_out_end(curs, len)) {
+        Py_CLEAR(*chunk);
+        return -1;
+    }
+    return 0;
+}
+
+/* pq_copy_in_chunk - send a chunk of data to a COPY FROM stream
+
+   return 0 on success, else -1 with an exception set */
+
+int
+pq_copy_in_chunk(cursorObject *curs, const char *data, Py_ssize_t len)
+{
+    int res;
+
+    if (len > INT_MAX) {
+        PyErr_SetString(DataError, "data too large");
+        return -1;
+    }
+    if (len == 0) return 0;
+
+    res = _pq_put_copy_data(curs, data, len);
+    if (res == -1) {
+        PyErr_SetString(OperationalError, PQerrorMessage(curs->conn->pgconn));
+    }
+    return res == 0 ? 0 : -1;
+}
+
+/* pq_copy_in_end - terminate a COPY FROM stream
+
+   errormsg is NULL to complete the copy, else the reason to abort it.
+   return 0 on success, else -1 with an exception set */
+
+int
+pq_copy_in_end(cursorObject *curs, const char *errormsg)
+{
+    return _pq_copy_end(curs, errormsg);
+}
+
+/* Estimate the memory taken by a row of a result: the values, their
+ * terminators and the per-value descriptor libpq keeps for each of them. */
+
+static size_t
+_pq_row_memory(const PGresult *res, int row)
+{
+    int i, nf = PQnfields(res);
+    size_t size = nf * (sizeof(int) + sizeof(char *) + 1);
+
+    for (i = 0; i < nf; i++) {
+        size += PQgetlength(res, row, i);
+    }
+    return size;
+}
 
-    pgnfields = PQnfields(curs->pgres);
-    pgbintuples = PQbinaryTuples(curs->pgres);
+/* pq_result_memory - return the bytes of memory taken by a result
 
-    curs->notuples = 0;
+   the size is exact from libpq 12, else estimated from the size of the
+   values received */
 
-    /* create the tuple for description and typecasting */
-    Py_BLOCK_THREADS;
-    Py_XDECREF(curs->description);
-    Py_XDECREF(curs->casts);    
-    curs->description = PyTuple_New(pgnfields);
-    curs->casts = PyTuple_New(pgnfields);
-    curs->columns = pgnfields;
-    Py_UNBLOCK_THREADS;
+size_t
+pq_result_memory(const PGresult *res)
+{
+#if PG_VERSION_HEX >= 0x0C0000
+    return res ? PQresultMemorySize(res) : 0;
+#else
+    int i, nt;
+    size_t size;
 
-    /* calculate the display size for each column (cpu intensive, can be
-       switched off at configuration time) */
-#ifdef PSYCOPG_DISPLAY_SIZE
-    Py_BLOCK_THREADS;
-    dsize = (int *)PyMem_Malloc(pgnfields * sizeof(int));
-    Py_UNBLOCK_THREADS;
-    if (dsize != NULL) {
-        int j, len;
-        for (i=0; i < pgnfields; i++) {
-            dsize[i] = -1;
-        }
-        for (j = 0; j < curs->rowcount; j++) {
-            for (i = 0; i < pgnfields; i++) {
-                len = PQgetlength(curs->pgres, j, i);
-                if (len > dsize[i]) dsize[i] = len;
-            }
-        }
+    if (res == NULL) return 0;
+
+    nt = PQntuples(res);
+    size = PQnfields(res) * sizeof(PGresAttDesc);
+    for (i = 0; i < nt; i++) {
+        size += _pq_row_memory(res, i);
     }
+    return size;
 #endif
+}
 
-    /* calculate various parameters and typecasters */
-    for (i = 0; i < pgnfields; i++) {
-        Oid ftype = PQftype(curs->pgres, i);
-        int fsize = PQfsize(curs->pgres, i);
-        int fmod =  PQfmod(curs->pgres, i);
+/* return the result size limit to respect for the cursor, 0 if none */
+#define CURS_RESULT_LIMIT(curs) \
+    ((curs)->result_limit > 0 ? (curs)->result_limit : 0)
 
-        PyObject *dtitem;
-        PyObject *type;
-        PyObject *cast = NULL;
+static void
+_pq_raise_result_limit(cursorObject *curs)
+{
+    PyErr_Format(OperationalError,
+        "the query result exceeds the result_limit of "
+        FORMAT_CODE_PY_SSIZE_T " bytes", curs->result_limit);
+}
 
-        Py_BLOCK_THREADS;
+#ifdef HAVE_SINGLE_ROW_MODE
 
-        dtitem = PyTuple_New(7);
-        PyTuple_SET_ITEM(curs->description, i, dtitem);
+/* Discard the results of a streaming query still pending.
+ *
+ * If raise is true an error received is raised. Return -1 with an exception
+ * set on error (of the wait callback or, if raise, the backend), else 0.
+ * The connection is free for the other cursors afterwards.
+ *
+ * The function should be called with the GIL, without the connection lock. */
 
-        /* fill the right cast function by accessing three different dictionaries:
-           - the per-cursor dictionary, if available (can be NULL or None)
-           - the per-connection dictionary (always exists but can be null)
-           - the global dictionary (at module level)
-           if we get no defined cast use the default one */
+static int
+_pq_stream_drain(cursorObject *curs, int raise)
+{
+    PGresult *res;
+    int green = psyco_green();
 
-        type = PyInt_FromLong(ftype);
-        Dprintf("_pq_fetch_tuples: looking for cast %d:", ftype);
-        if (curs->string_types != NULL && curs->string_types != Py_None) {
-            cast = PyDict_GetItem(curs->string_types, type);
-            Dprintf("_pq_fetch_tuples:     per-cursor dict: %p", cast);
-        }
-        if (cast == NULL) {
-            cast = PyDict_GetItem(curs->conn->string_types, type);
-            Dprintf("_pq_fetch_tuples:     per-connection dict: %p", cast);
+    Dprintf("_pq_stream_drain: discarding the pending results");
+
+    curs->stream_pending = 0;
+    if (curs->conn->stream_cursor == (PyObject *)curs) {
+        curs->conn->stream_cursor = NULL;
+    }
+    while (1) {
+        Py_BEGIN_ALLOW_THREADS;
+        pthread_mutex_lock(&(curs->conn->lock));
+        if (green) {
+            Py_BLOCK_THREADS;
+            res = psyco_get_result_green(curs->conn);
+            Py_UNBLOCK_THREADS;
         }
-        if (cast == NULL) {
-            cast = PyDict_GetItem(psyco_types, type);
-            Dprintf("_pq_fetch_tuples:     global dict: %p", cast);
+        else {
+            res = PQgetResult(curs->conn->pgconn);
         }
-        if (cast == NULL) cast = psyco_default_cast;
+        pthread_mutex_unlock(&(curs->conn->lock));
+        Py_END_ALLOW_THREADS;
+        if (res == NULL && PyErr_Occurred()) return -1;
+        if (res == NULL) break;
 
-        /* else if we got binary tuples and if we got a field that
-           is binary use the default cast
-           FIXME: what the hell am I trying to do here? This just can't work..
-        */
-        if (pgbintuples && cast == psyco_default_binary_cast) {
-            Dprintf("_pq_fetch_tuples: Binary cursor and "
-                    "binary field: %i using default cast",
-                    PQftype(curs->pgres,i));
-            cast = psyco_default_cast;
+        if (raise && PQresultStatus(res) == PGRES_FATAL_ERROR
+                && !PyErr_Occurred()) {
+            pq_raise(curs->conn, curs, res);
         }
+        PQclear(res);
+    }
 
-        Dprintf("_pq_fetch_tuples: using cast at %p (%s) for type %d",
-                cast, PyString_AS_STRING(((typecastObject*)cast)->name),
-                PQftype(curs->pgres,i));
-        Py_INCREF(cast);
-        PyTuple_SET_ITEM(curs->casts, i, cast);
+    return (raise && PyErr_Occurred()) ? -1 : 0;
+}
 
-        /* 1/ fill the other fields */
-        PyTuple_SET_ITEM(dtitem, 0,
-                         PyString_FromString(PQfname(curs->pgres, i)));
-        PyTuple_SET_ITEM(dtitem, 1, type);
+/* Append the rows of a query in single-row mode to a chunk.
+ *
+ * Read the results until *chunk holds size rows, takes more than limit bytes
+ * (if limit > 0) or the rows are finished. If *chunk is NULL the first row
+ * read becomes the chunk. Return 1 if there may be more rows, 0 if the query
+ * is finished, -1 with an exception set on error.
+ *
+ * The function should be called with the GIL, without the connection lock. */
 
-        /* 2/ display size is the maximum size of this field result tuples. */
-        if (dsize && dsize[i] >= 0) {
-            PyTuple_SET_ITEM(dtitem, 2, PyInt_FromLong(dsize[i]));
-        }
-        else {
-            Py_INCREF(Py_None);
-            PyTuple_SET_ITEM(dtitem, 2, Py_None);
-        }
+static int
+_pq_stream_fill(cursorObject *curs, PGresult **chunk, long int size,
+                size_t limit)
+{
+    PGconn *pgconn = curs->conn->pgconn;
+    PGresult *res;
+    long int n = *chunk ? PQntuples(*chunk) : 0;
+    size_t mem = pq_result_memory(*chunk);
+    int i, nf, wait, nomem, green = psyco_green();
 
-        /* 3/ size on the backend */
-        if (fmod > 0) fmod = fmod - sizeof(int);
-        if (fsize == -1) {
-            if (ftype == NUMERICOID) {
-                PyTuple_SET_ITEM(dtitem, 3,
-                                 PyInt_FromLong((fmod >> 16) & 0xFFFF));
+    while (1) {
+        res = NULL;
+        wait = nomem = 0;
+
+        Py_BEGIN_ALLOW_THREADS;
+        pthread_mutex_lock(&(curs->conn->lock));
+        while (n < size && !(limit > 0 && mem > limit)) {
+            /* on green connections read only what is already received */
+            if (green && PQisBusy(pgconn)) { wait = 1; break; }
+            res = PQgetResult(pgconn);
+            if (res == NULL || PQresultStatus(res) != PGRES_SINGLE_TUPLE)
+                break;
+
+            if (*chunk == NULL) {
+                *chunk = res;
+                mem = pq_result_memory(res);
             }
-            else { /* If variable length record, return maximum size */
-                PyTuple_SET_ITEM(dtitem, 3, PyInt_FromLong(fmod));
+            else {
+                mem += _pq_row_memory(res, 0);
+                nf = PQnfields(res);
+                for (i = 0; i < nf; i++) {
+                    if (!PQsetvalue(*chunk, n, i,
+                            PQgetisnull(res, 0, i) ? NULL
+                                : PQgetvalue(res, 0, i),
+                            PQgetlength(res, 0, i))) {
+                        nomem = 1;
+                        break;
+                    }
+                }
+                PQclear(res);
             }
+            res = NULL;
+            if (nomem) break;
+            n++;
         }
-        else {
-            PyTuple_SET_ITEM(dtitem, 3, PyInt_FromLong(fsize));
-        }
+        pthread_mutex_unlock(&(curs->conn->lock));
+        Py_END_ALLOW_THREADS;
 
-        /* 4,5/ scale and precision */
-        if (ftype == NUMERICOID) {
-            PyTuple_SET_ITEM(dtitem, 4, PyInt_FromLong((fmod >> 16) & 0xFFFF));
-            PyTuple_SET_ITEM(dtitem, 5, PyInt_FromLong(fmod & 0xFFFF));
+        if (nomem) {
+            PyErr_NoMemory();
+            _pq_stream_drain(curs, 0);
+            return -1;
         }
-        else {
-            Py_INCREF(Py_None);
-            PyTuple_SET_ITEM(dtitem, 4, Py_None);
-            Py_INCREF(Py_None);
-            PyTuple_SET_ITEM(dtitem, 5, Py_None);
+
+        if (wait) {
+            /* the wait callback polls the connection locked */
+            Py_BEGIN_ALLOW_THREADS;
+            pthread_mutex_lock(&(curs->conn->lock));
+            Py_BLOCK_THREADS;
+            curs->conn->async_status = ASYNC_READ;
+            wait = psyco_wait(curs->conn);
+            curs->conn->async_status = ASYNC_DONE;
+            Py_UNBLOCK_THREADS;
+            pthread_mutex_unlock(&(curs->conn->lock));
+            Py_END_ALLOW_THREADS;
+            if (0 != wait) {
+                _pq_stream_drain(curs, 0);
+                return -1;
+            }
+            continue;
         }
 
-        /* 6/ FIXME: null_ok??? */
-        Py_INCREF(Py_None);
-        PyTuple_SET_ITEM(dtitem, 6, Py_None);
-    
-        Py_UNBLOCK_THREADS;    
+        break;
     }
 
-    if (dsize) {
-        Py_BLOCK_THREADS;
-        PyMem_Free(dsize);
-        Py_UNBLOCK_THREADS;
-   }
-   
-    pthread_mutex_unlock(&(curs->conn->lock));
-    Py_END_ALLOW_THREADS;
-}
-
-static int
-_pq_copy_in_v3(cursorObject *curs)
-{
-    /* COPY FROM implementation when protocol 3 is available: this function
-       uses the new PQputCopyData() and can detect errors and set the correct
-       exception */
-    PyObject *o, *func = NULL, *size = NULL;
-    Py_ssize_t length = 0;
-    int res, error = 0;
+    if ((n >= size || (limit > 0 && mem > limit)) && res == NULL) {
+        return 1;
+    }
 
-    if (!(func = PyObject_GetAttrString(curs->copyfile, "read"))) {
-        Dprintf("_pq_copy_in_v3: can't get o.read");
-        error = 1;
-        goto exit;
+    /* the rows are finished: res is the last result of the query */
+    if (res && PQresultStatus(res) != PGRES_TUPLES_OK) {
+        pq_raise(curs->conn, curs, res);
     }
-    if (!(size = PyInt_FromSsize_t(curs->copysize))) {
-        Dprintf("_pq_copy_in_v3: can't get int from copysize");
-        error = 1;
-        goto exit;
+    IFCLEARPGRES(res);
+
+    /* read the results of the other statements in the query, if any */
+    if (_pq_stream_drain(curs, 1) < 0 || PyErr_Occurred()) {
+        return -1;
     }
 
-    while (1) {
-        o = PyObject_CallFunctionObjArgs(func, size, NULL);
-        if (!(o && PyString_Check(o) && (length = PyString_GET_SIZE(o)) != -1)) {
-            error = 1;
-        }
-        if (length == 0 || length > INT_MAX || error == 1) break;
+    return 0;
+}
 
-        Py_BEGIN_ALLOW_THREADS;
-        res = PQputCopyData(curs->conn->pgconn, PyString_AS_STRING(o),
-            /* Py_ssize_t->int cast was validated above */
-            (int) length);
-        Dprintf("_pq_copy_in_v3: sent %d bytes of data; res = %d",
-            (int) length, res);
-            
-        if (res == 0) {
-            /* FIXME: in theory this should not happen but adding a check
-               here would be a nice idea */
-        }
-        else if (res == -1) {
-            Dprintf("_pq_copy_in_v3: PQerrorMessage = %s",
-                PQerrorMessage(curs->conn->pgconn));
-            error = 2;
-        }
-        Py_END_ALLOW_THREADS;
+#endif /* HAVE_SINGLE_ROW_MODE */
 
-        if (error == 2) break;
+/* pq_fetch_stream - read the next chunk of rows of a streaming query
 
-        Py_DECREF(o);
-    }
+   the chunk replaces the cursor pgres; rowoffset is set to the number of
+   the first row in the chunk and rowcount to the rows received so far.
 
-    Py_XDECREF(o);
+   return 0 on success, -1 with an exception set on error */
 
-    Dprintf("_pq_copy_in_v3: error = %d", error);
+int
+pq_fetch_stream(cursorObject *curs)
+{
+#ifdef HAVE_SINGLE_ROW_MODE
+    PGresult *chunk = NULL;
+    size_t limit = CURS_RESULT_LIMIT(curs);
+    long int size;
 
-    /* 0 means that the copy went well, 2 that there was an error on the
-       backend: in both cases we'll get the error message from the PQresult */
-    if (error == 0)
-        res = PQputCopyEnd(curs->conn->pgconn, NULL);
-    else if (error == 2)
-        res = PQputCopyEnd(curs->conn->pgconn, "error in PQputCopyData() call");
-    else
-        res = PQputCopyEnd(curs->conn->pgconn, "error in .read() call");
+    if (!curs->stream_pending) return 0;
 
-    IFCLEARPGRES(curs->pgres);
-    
-    Dprintf("_pq_copy_in_v3: copy ended; res = %d", res);
-    
-    /* if the result is -1 we should not even try to get a result from the
-       bacause that will lock the current thread forever */
-    if (res == -1) {
-        pq_raise(curs->conn, curs, NULL);
-        /* FIXME: pq_raise check the connection but for some reason even
-           if the error message says "server closed the connection unexpectedly"
-           the status returned by PQstatus is CONNECTION_OK! */
-        curs->conn->closed = 2;
+    /* a result exceeding result_limit is streamed in chunks of that size */
+    if (curs->streaming > 0) {
+        size = curs->streaming;
     }
     else {
-        /* and finally we grab the operation result from the backend */
-        while ((curs->pgres = PQgetResult(curs->conn->pgconn)) != NULL) {
-            if (PQresultStatus(curs->pgres) == PGRES_FATAL_ERROR)
-                pq_raise(curs->conn, curs, NULL);
-            IFCLEARPGRES(curs->pgres);
-        }
+        size = limit > 0 ? LONG_MAX : 1;
     }
 
-exit:
-    Py_XDECREF(func);
-    Py_XDECREF(size);
-    return (error == 0 ? 1 : -1);
+    if (_pq_stream_fill(curs, &chunk, size, limit) < 0) {
+        IFCLEARPGRES(chunk);
+        return -1;
+    }
+
+    Dprintf("pq_fetch_stream: got %d rows", chunk ? PQntuples(chunk) : 0);
+
+    if (chunk) {
+        _pq_stats_received(curs->conn, chunk);
+        IFCLEARCURSPGRES(curs);
+        curs->pgres = chunk;
+        curs->rowoffset = curs->rowcount;
+        curs->rowcount += PQntuples(chunk);
+    }
+#endif
+
+    return 0;
 }
 
-static int
-_pq_copy_out_v3(cursorObject *curs)
-{
-    PyObject *tmp = NULL, *func;
-    int ret = -1;
+/* pq_stream_discard - drop the rows of a streaming query not read yet
 
-    char *buffer;
-    Py_ssize_t len;
+   return 0 on success, -1 with an exception set on error */
 
-    if (!(func = PyObject_GetAttrString(curs->copyfile, "write"))) {
-        Dprintf("_pq_copy_out_v3: can't get o.write");
-        goto exit;
+int
+pq_stream_discard(cursorObject *curs)
+{
+#ifdef HAVE_SINGLE_ROW_MODE
+    if (curs->stream_pending) {
+        return _pq_stream_drain(curs, 0);
     }
+#endif
+    return 0;
+}
 
-    while (1) {
-        Py_BEGIN_ALLOW_THREADS;
-        len = PQgetCopyData(curs->conn->pgconn, &buffer, 0);
-        Py_END_ALLOW_THREADS;
+/* start a COPY stream in the direction the backend entered
 
-        if (len > 0 && buffer) {
-            tmp = PyObject_CallFunction(func, "s#", buffer, len);
-            PQfreemem(buffer);
-            if (tmp == NULL) {
-                goto exit;
-            } else {
-                Py_DECREF(tmp);
-            }
-        }
-        /* we break on len == 0 but note that that should *not* happen,
-           because we are not doing an async call (if it happens blame
-           postgresql authors :/) */
-        else if (len <= 0) break;
-    }
+   leave the connection in COPY state if it is the direction the stream
+   expects, else terminate the COPY and raise ProgrammingError */
 
-    if (len == -2) {
-        pq_raise(curs->conn, curs, NULL);
-        goto exit;
+static int
+_pq_copy_stream_start(cursorObject *curs, int direction)
+{
+    copystreamObject *stream = (copystreamObject *)curs->copyfile;
+    PyObject *chunk;
+
+    if (stream->direction == direction) {
+        /* the connection is busy until the stream is closed */
+        stream->closed = 0;
+        curs->conn->copy_stream = (PyObject *)stream;
+        return 1;
     }
 
-    /* and finally we grab the operation result from the backend */
-    IFCLEARPGRES(curs->pgres);
-    while ((curs->pgres = PQgetResult(curs->conn->pgconn)) != NULL) {
-        if (PQresultStatus(curs->pgres) == PGRES_FATAL_ERROR)
-            pq_raise(curs->conn, curs, NULL);
-        IFCLEARPGRES(curs->pgres);
+    /* terminate the COPY: the error is replaced below */
+    if (direction == COPYSTREAM_IN) {
+        _pq_copy_end(curs, "COPY TO expected");
     }
-    ret = 1;
-
-exit:
-    Py_XDECREF(func);
-    return ret;
+    else {
+        while (1 == pq_copy_out_chunk(curs, stream->size,
+                &stream->buf, &stream->balloc, &chunk)) {
+            Py_XDECREF(chunk);
+        }
+        Py_XDECREF(chunk);
+    }
+    PyErr_SetString(ProgrammingError, stream->direction == COPYSTREAM_IN
+        ? "the query is not a COPY FROM STDIN"
+        : "the query is not a COPY TO STDOUT");
+    return -1;
 }
 
 int
@@ -1197,6 +3849,7 @@ pq_fetch(cursorObject *curs)
 {
     int pgstatus, ex = -1;
     const char *rowcount;
+    double t0;
 
     /* even if we fail, we remove any information about the previous query */
     curs_reset(curs);
@@ -1241,33 +3894,82 @@ pq_fetch(cursorObject *curs)
 
     case PGRES_COPY_OUT:
         Dprintf("pq_fetch: data from a COPY TO (no tuples)");
-        ex = _pq_copy_out_v3(curs);
+        /* a stream reads the data itself after the execute */
+        if (curs->copyfile && copystream_Check(curs->copyfile))
+            ex = _pq_copy_stream_start(curs, COPYSTREAM_OUT);
+        else
+            ex = _pq_copy_out_v3(curs);
         curs->rowcount = -1;
         /* error caught by out glorious notice handler */
         if (PyErr_Occurred()) ex = -1;
-        IFCLEARPGRES(curs->pgres);
+        IFCLEARCURSPGRES(curs);
         break;
 
     case PGRES_COPY_IN:
         Dprintf("pq_fetch: data from a COPY FROM (no tuples)");
-        ex = _pq_copy_in_v3(curs);
         curs->rowcount = -1;
+        if (curs->copyfile && copystream_Check(curs->copyfile))
+            ex = _pq_copy_stream_start(curs, COPYSTREAM_IN);
+        else if (curs->copyrecords)
+            ex = _pq_copy_in_records(curs);
+        else
+            ex = _pq_copy_in_v3(curs);
         /* error caught by out glorious notice handler */
         if (PyErr_Occurred()) ex = -1;
-        IFCLEARPGRES(curs->pgres);
+        IFCLEARCURSPGRES(curs);
+        break;
+
+#ifdef HAVE_SINGLE_ROW_MODE
+    case PGRES_SINGLE_TUPLE:
+        Dprintf("pq_fetch: data from a SELECT (streaming)");
+        /* the connection is busy until the rows are finished */
+        curs->stream_pending = 1;
+        curs->conn->stream_cursor = (PyObject *)curs;
+        if (_pq_fetch_tuples(curs) < 0
+                || _pq_stream_fill(curs, &curs->pgres,
+                    curs->streaming > 0 ? curs->streaming : LONG_MAX,
+                    CURS_RESULT_LIMIT(curs)) < 0) {
+            IFCLEARCURSPGRES(curs);
+            ex = -1;
+        }
+        else if (curs->stream_pending && curs->streaming <= 0
+                && !curs->result_limit_stream) {
+            /* streamed only to respect result_limit, which was exceeded */
+            _pq_raise_result_limit(curs);
+            _pq_stream_drain(curs, 0);
+            IFCLEARCURSPGRES(curs);
+            ex = -1;
+        }
+        else {
+            curs->rowcount = PQntuples(curs->pgres);
+            _pq_stats_received(curs->conn, curs->pgres);
+            ex = 0;
+        }
         break;
+#endif
 
     case PGRES_TUPLES_OK:
         Dprintf("pq_fetch: data from a SELECT (got tuples)");
+        /* results not streamed (async, named cursors) are only checked */
+        if (curs->result_limit > 0
+                && pq_result_memory(curs->pgres) > curs->result_limit) {
+            _pq_raise_result_limit(curs);
+            IFCLEARCURSPGRES(curs);
+            ex = -1;
+            break;
+        }
         curs->rowcount = PQntuples(curs->pgres);
-        _pq_fetch_tuples(curs); ex = 0;
+        t0 = CONN_STATS_START(curs->conn);
+        ex = _pq_fetch_tuples(curs);
+        CONN_STATS_ADD_TIME(curs->conn, decode_time, t0);
+        _pq_stats_received(curs->conn, curs->pgres);
         /* don't clear curs->pgres, because it contains the results! */
         break;
 
     default:
         Dprintf("pq_fetch: uh-oh, something FAILED: pgconn = %p", curs->conn);
         pq_raise(curs->conn, curs, NULL);
-        IFCLEARPGRES(curs->pgres);
+        IFCLEARCURSPGRES(curs);
         ex = -1;
         break;
     }
@@ -1291,3 +3993,120 @@ pq_fetch(cursorObject *curs)
 
     return ex;
 }
+
+/* pq_fetch_sets - fetch the first result of a query kept for nextset()
+
+   After a query executed by a cursor with multiple_results the results
+   preceding the last one are in curs->nextsets and the last one in
+   curs->pgres: the first result is fetched and the others queued after it.
+   If the query failed, or entered COPY, only its last result is fetched,
+   as pq_fetch() does.
+
+   return the same values of pq_fetch() */
+
+int
+pq_fetch_sets(cursorObject *curs)
+{
+    cursorResults sets = curs->nextsets;
+    ExecStatusType status;
+    int ex;
+
+    if (sets.len == 0 && !sets.lost) {
+        return pq_fetch(curs);
+    }
+
+    /* pq_fetch() resets the cursor and would drop the results */
+    memset(&curs->nextsets, 0, sizeof(cursorResults));
+
+    status = curs->pgres ? PQresultStatus(curs->pgres) : PGRES_FATAL_ERROR;
+    if (status != PGRES_TUPLES_OK && status != PGRES_COMMAND_OK
+            && status != PGRES_EMPTY_QUERY) {
+        curs->nextsets = sets;
+        curs_clear_results(curs);
+        return pq_fetch(curs);
+    }
+
+    _pq_keep_result(&sets, curs->pgres);
+    curs->pgres = NULL;
+    if (sets.lost) {
+        curs->nextsets = sets;
+        curs_clear_results(curs);
+        PyErr_NoMemory();
+        return -1;
+    }
+    curs->pgres = sets.results[0];
+    sets.results[0] = NULL;
+    sets.next = 1;
+
+    ex = pq_fetch(curs);
+    curs->nextsets = sets;
+    if (ex == -1) {
+        curs_clear_results(curs);
+    }
+    return ex;
+}
+
+/* pq_nextset - fetch the next result kept for nextset()
+
+   return value:
+     -1 - error fetching the result
+      0 - no more results: the cursor is left untouched
+      1 - the cursor moved to the next result */
+
+int
+pq_nextset(cursorObject *curs)
+{
+    cursorResults sets = curs->nextsets;
+    int ex;
+
+    if (sets.next >= sets.len) {
+        curs_clear_results(curs);
+        return 0;
+    }
+
+    memset(&curs->nextsets, 0, sizeof(cursorResults));
+    IFCLEARCURSPGRES(curs);
+    curs->pgres = sets.results[sets.next];
+    sets.results[sets.next++] = NULL;
+
+    ex = pq_fetch(curs);
+    curs->nextsets = sets;
+    if (ex == -1) {
+        curs_clear_results(curs);
+        return -1;
+    }
+    return 1;
+}
+
+/* pq_fetch_shared - make a result owned by a lazy result the cursor one
+
+   Used by the cursors fetching a result from a ResultCache: the result is
+   read as if just received from the backend, but the cursor doesn't clear
+   it as it is still owned by the cache.
+
+   return the same values of pq_fetch() */
+
+int
+pq_fetch_shared(cursorObject *curs, PyObject *owner)
+{
+    lazyresultObject *result = (lazyresultObject *)owner;
+    int ex;
+    double t0;
+
+    IFCLEARCURSPGRES(curs);
+    curs_reset(curs);
+
+    Py_INCREF(owner);
+    Py_XDECREF(curs->shared_result);
+    curs->shared_result = owner;
+    curs->shared_pgres = curs->pgres = result->pgres;
+
+    Py_XDECREF(curs->pgstatus);
+    curs->pgstatus = PyString_FromString(PQcmdStatus(curs->pgres));
+    curs->rowcount = PQntuples(curs->pgres);
+
+    t0 = CONN_STATS_START(curs->conn);
+    ex = _pq_fetch_tuples(curs);
+    CONN_STATS_ADD_TIME(curs->conn, decode_time, t0);
+    return ex;
+}
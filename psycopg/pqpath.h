@@ -34,11 +34,58 @@
 #define IFCLEARPGRES(pgres)  if (pgres) {PQclear(pgres); pgres = NULL;}
 #define CLEARPGRES(pgres)    PQclear(pgres); pgres = NULL
 
+/* pipeline mode is available from libpq 14 */
+#if PG_VERSION_HEX >= 0x0E0000
+#define HAVE_PQPIPELINE 1
+#endif
+
+/* single-row mode is available from libpq 9.2 */
+#if PG_VERSION_HEX >= 0x090200
+#define HAVE_SINGLE_ROW_MODE 1
+#endif
+
+/* query parameters passed out-of-line to the backend (see PQexecParams) */
+typedef struct pqParams {
+    int nparams;
+    Oid *types;
+    const char **values;
+    int *lengths;
+    int *formats;
+    const char *name;   /* prepared statement to execute, if not NULL */
+    int prepare;        /* 1 if the query can use the prepared statements
+                           cache of the connection */
+    int result_format;  /* 1 to ask for the results in binary format */
+} pqParams;
+
 /* exported functions */
 HIDDEN PGresult *pq_get_last_result(connectionObject *conn);
 HIDDEN int pq_fetch(cursorObject *curs);
+HIDDEN int pq_fetch_description(cursorObject *curs);
+HIDDEN int pq_fetch_sets(cursorObject *curs);
+HIDDEN int pq_nextset(cursorObject *curs);
+HIDDEN int pq_fetch_shared(cursorObject *curs, PyObject *owner);
+HIDDEN PyObject *pq_lookup_cast(cursorObject *curs, PyObject *type,
+                                Oid ftype, int binary);
 HIDDEN int pq_execute(cursorObject *curs, const char *query, int async);
+HIDDEN int pq_execute_params(cursorObject *curs, const char *query,
+                             const pqParams *params, int async);
+HIDDEN int pq_execute_multi(cursorObject *curs, const char *query);
+HIDDEN int pq_execute_pipeline(cursorObject *curs, const char **queries,
+                               const pqParams *params, int n);
+HIDDEN int pq_fetch_stream(cursorObject *curs);
+HIDDEN int pq_stream_discard(cursorObject *curs);
+HIDDEN size_t pq_result_memory(const PGresult *res);
+HIDDEN int pq_copy_out_chunk(cursorObject *curs, Py_ssize_t size,
+                             char **buf, Py_ssize_t *balloc,
+                             PyObject **chunk);
+HIDDEN int pq_copy_in_chunk(cursorObject *curs, const char *data,
+                            Py_ssize_t len);
+HIDDEN int pq_copy_in_end(cursorObject *curs, const char *errormsg);
 HIDDEN int pq_send_query(connectionObject *conn, const char *query);
+HIDDEN int pq_send_query_params(connectionObject *conn, const char *query,
+                                const pqParams *params);
+HIDDEN int pq_send_prepare(connectionObject *conn, const char *name,
+                           const char *query, const pqParams *params);
 HIDDEN int pq_begin_locked(connectionObject *conn, PGresult **pgres,
                            char **error, PyThreadState **tstate);
 HIDDEN int pq_commit(connectionObject *conn);
@@ -50,10 +97,15 @@ HIDDEN int pq_tpc_command_locked(connectionObject *conn,
                                  const char *cmd, const char *tid,
                                  PGresult **pgres, char **error,
                                  PyThreadState **tstate);
+HIDDEN int pq_tpc_command_many(connectionObject **conns, const char **cmds,
+                               XidObject **xids, int n, int *failed);
 HIDDEN int pq_is_busy(connectionObject *conn);
 HIDDEN int pq_is_busy_locked(connectionObject *conn);
 HIDDEN int pq_flush(connectionObject *conn);
 HIDDEN void pq_clear_async(connectionObject *conn);
+HIDDEN void pq_clear_async_queue(connectionObject *conn, int canceled);
+HIDDEN int pq_execute_queued(connectionObject *conn);
+HIDDEN int pq_next_pipelined(connectionObject *conn);
 HIDDEN int pq_set_non_blocking(connectionObject *conn, int arg, int pyerr);
 
 HIDDEN void pq_set_critical(connectionObject *conn, const char *msg);
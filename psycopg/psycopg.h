@@ -113,12 +113,17 @@ typedef struct {
 /* the Decimal type, used by the DECIMAL typecaster */
 HIDDEN PyObject *psyco_GetDecimalType(void);
 
+/* the module-level connect(), used by the connection pool too */
+HIDDEN PyObject *psyco_connect(PyObject *self, PyObject *args,
+                               PyObject *keywds);
+
 /* some utility functions */
 HIDDEN void psyco_set_error(PyObject *exc, PyObject *curs,  const char *msg,
                             const char *pgerror, const char *pgcode);
 
 HIDDEN char *psycopg_escape_string(PyObject *conn,
               const char *from, Py_ssize_t len, char *to, Py_ssize_t *tolen);
+HIDDEN double psycopg_now(void);
 
 /* Exceptions docstrings */
 #define Error_doc \
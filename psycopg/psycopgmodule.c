@@ -33,6 +33,7 @@
 #include "psycopg/connection.h"
 #include "psycopg/cursor.h"
 #include "psycopg/green.h"
+#include "psycopg/pqpath.h"
 #include "psycopg/lobject.h"
 #include "psycopg/notify.h"
 #include "psycopg/xid.h"
@@ -47,7 +48,19 @@
 #include "psycopg/adapter_pdecimal.h"
 #include "psycopg/adapter_asis.h"
 #include "psycopg/adapter_list.h"
+#include "psycopg/adapter_hstore.h"
+#include "psycopg/adapter_uuid.h"
+#include "psycopg/adapter_inet.h"
 #include "psycopg/typecast_binary.h"
+#include "psycopg/copy_binary.h"
+#include "psycopg/copystream.h"
+#include "psycopg/column.h"
+#include "psycopg/lazyrow.h"
+#include "psycopg/dictrow.h"
+#include "psycopg/tz.h"
+#include "psycopg/pool.h"
+#include "psycopg/resultcache.h"
+#include "psycopg/registry.h"
 
 #ifdef HAVE_MXDATETIME
 #include <mxDateTime.h>
@@ -104,7 +117,7 @@ _psyco_connect_fill_dsn(char *dsn, const char *kw, const char *v, size_t i)
     return i;
 }
 
-static PyObject *
+PyObject *
 psyco_connect(PyObject *self, PyObject *args, PyObject *keywds)
 {
     PyObject *conn = NULL, *factory = NULL;
@@ -225,6 +238,351 @@ psyco_connect(PyObject *self, PyObject *args, PyObject *keywds)
     return conn;
 }
 
+/** connect_fastest module-level function **/
+#define psyco_connect_fastest_doc \
+"connect_fastest(dsns, standby=None, timeout=None, connection_factory=None)\n" \
+"-- Connect to many servers at once and return the first one ready.\n\n"    \
+"If ``standby`` is True or False, return only a server in recovery or not\n" \
+"respectively. The other connection attempts are aborted. ``timeout`` is\n"  \
+"the number of seconds to wait for a server, None to wait forever.\n\n"      \
+":rtype: `extensions.connection`"
+
+/* the steps of the connection attempts */
+#define FASTEST_CONNECTING  0
+#define FASTEST_CHECKING    1   /* asked for pg_is_in_recovery() */
+#define FASTEST_FAILED      2
+
+/* ask a server just connected if it is a standby
+
+   Return 1 if it is ready to use, 0 if it is still checking, -1 on error. */
+static int
+_psyco_connect_fastest_check(connectionObject *conn, int standby, int *step)
+{
+    PGresult *pgres;
+    int recovery;
+
+    if (*step == FASTEST_CONNECTING) {
+        if (standby < 0) { return 1; }
+        if (0 == pq_send_query(conn, "SELECT pg_is_in_recovery()")) {
+            PyErr_SetString(OperationalError, PQerrorMessage(conn->pgconn));
+            return -1;
+        }
+        conn->async_status = ASYNC_WRITE;
+        *step = FASTEST_CHECKING;
+        return 0;
+    }
+
+    pgres = pq_get_last_result(conn);
+    if (pgres == NULL || PQresultStatus(pgres) != PGRES_TUPLES_OK
+            || PQntuples(pgres) != 1) {
+        PyErr_SetString(OperationalError, "can't check pg_is_in_recovery()");
+        IFCLEARPGRES(pgres);
+        return -1;
+    }
+    recovery = PQgetvalue(pgres, 0, 0)[0] == 't';
+    CLEARPGRES(pgres);
+
+    if (recovery != standby) {
+        PyErr_SetString(OperationalError, recovery ?
+            "the server is in recovery" : "the server is not in recovery");
+        return -1;
+    }
+    return 1;
+}
+
+static PyObject *
+psyco_connect_fastest(PyObject *self, PyObject *args, PyObject *keywds)
+{
+    PyObject *pydsns, *dsns = NULL, *factory = NULL;
+    PyObject *pystandby = Py_None, *pytimeout = Py_None;
+    PyObject *exc = NULL, *val = NULL, *tb = NULL;
+    connectionObject **conns = NULL, *winner = NULL;
+    int *steps = NULL, *events = NULL;
+    Py_ssize_t n = 0, i;
+    int standby = -1, pending, res;
+    double deadline = -1;
+
+    static char *kwlist[] = {"dsns", "standby", "timeout",
+                             "connection_factory", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "O|OOO", kwlist,
+            &pydsns, &pystandby, &pytimeout, &factory)) {
+        return NULL;
+    }
+    if (factory == NULL || factory == Py_None) {
+        factory = (PyObject *)&connectionType;
+    }
+    if (pystandby != Py_None && (standby = PyObject_IsTrue(pystandby)) < 0) {
+        return NULL;
+    }
+    if (pytimeout != Py_None) {
+        deadline = PyFloat_AsDouble(pytimeout);
+        if (deadline == -1 && PyErr_Occurred()) { return NULL; }
+        if (deadline < 0) {
+            PyErr_SetString(PyExc_ValueError, "timeout must be positive");
+            return NULL;
+        }
+        deadline += psycopg_now();
+    }
+
+    if (!(dsns = PySequence_Fast(pydsns, "dsns must be a sequence"))) {
+        return NULL;
+    }
+    if ((n = PySequence_Fast_GET_SIZE(dsns)) == 0) {
+        PyErr_SetString(PyExc_ValueError, "no dsn specified");
+        goto exit;
+    }
+    if (!(conns = PyMem_New(connectionObject *, n))
+            || !(steps = PyMem_New(int, n))
+            || !(events = PyMem_New(int, n))) {
+        PyErr_NoMemory();
+        goto exit;
+    }
+    memset(conns, 0, n * sizeof(connectionObject *));
+
+    /* start all the connections: the ones failing to start don't count */
+    for (i = 0; i < n; i++) {
+        steps[i] = FASTEST_CONNECTING;
+        events[i] = PSYCO_POLL_OK;
+        conns[i] = (connectionObject *)PyObject_CallFunction(
+            factory, "Oi", PySequence_Fast_GET_ITEM(dsns, i), 1);
+        if (conns[i] && !PyObject_TypeCheck(conns[i], &connectionType)) {
+            PyErr_SetString(PyExc_TypeError,
+                "connection_factory must return a connection");
+            goto exit;
+        }
+        if (conns[i] == NULL) {
+            if (!PyErr_ExceptionMatches(OperationalError)) { goto exit; }
+            Py_XDECREF(exc); Py_XDECREF(val); Py_XDECREF(tb);
+            PyErr_Fetch(&exc, &val, &tb);
+            steps[i] = FASTEST_FAILED;
+        }
+    }
+
+    for (;;) {
+        for (pending = 0, i = 0; i < n; i++) {
+            if (steps[i] == FASTEST_FAILED) { continue; }
+
+            if ((res = conn_poll(conns[i])) == PSYCO_POLL_OK) {
+                res = _psyco_connect_fastest_check(
+                    conns[i], standby, &steps[i]);
+                if (res == 1) { break; }
+                res = res == 0 ? PSYCO_POLL_WRITE : PSYCO_POLL_ERROR;
+            }
+
+            if (res == PSYCO_POLL_ERROR) {
+                Py_XDECREF(exc); Py_XDECREF(val); Py_XDECREF(tb);
+                PyErr_Fetch(&exc, &val, &tb);
+                conn_close(conns[i]);
+                steps[i] = FASTEST_FAILED;
+                events[i] = PSYCO_POLL_OK;
+                continue;
+            }
+            events[i] = res;
+            pending++;
+        }
+
+        if (i < n) {
+            /* we have a winner: the others are closed on exit */
+            winner = conns[i];
+            conns[i] = NULL;
+            break;
+        }
+
+        if (pending == 0) {
+            if (exc) {
+                PyErr_Restore(exc, val, tb);
+                exc = val = tb = NULL;
+            }
+            else {
+                PyErr_SetString(OperationalError, "no server available");
+            }
+            goto exit;
+        }
+
+        res = conn_poll_wait(conns, events, (int)n, deadline);
+        if (res < 0) { goto exit; }
+        if (res > 0) {
+            PyErr_SetString(OperationalError, "timeout expired");
+            goto exit;
+        }
+    }
+
+    Dprintf("psyco_connect_fastest: connected to '%s'", winner->dsn);
+    if (conn_async_to_sync(winner) < 0) {
+        Py_CLEAR(winner);
+    }
+
+exit:
+    if (conns) {
+        for (i = 0; i < n; i++) {
+            if (conns[i]) {
+                if (!conns[i]->closed) { conn_close(conns[i]); }
+                Py_DECREF(conns[i]);
+            }
+        }
+    }
+    PyMem_Free(conns);
+    PyMem_Free(steps);
+    PyMem_Free(events);
+    Py_XDECREF(dsns);
+    Py_XDECREF(exc);
+    Py_XDECREF(val);
+    Py_XDECREF(tb);
+    return (PyObject *)winner;
+}
+
+/** two-phase commit of many connections module-level functions **/
+
+/* return the connections in the sequence pyconns, checking they are in a
+   two-phase transaction (prepared if prepared is 1, not prepared if 0)
+
+   the array must be freed with PyMem_Free(); the sequence returned in
+   *seq owns the connections and must be released too. */
+static connectionObject **
+_psyco_tpc_conns(PyObject *pyconns, int prepared, const char *cmd,
+                 PyObject **seq, int *n)
+{
+    connectionObject **conns = NULL, *conn;
+    Py_ssize_t size;
+    int i, j;
+
+    if (!(*seq = PySequence_Fast(pyconns, "conns must be a sequence"))) {
+        return NULL;
+    }
+    if ((size = PySequence_Fast_GET_SIZE(*seq)) > INT_MAX) {
+        PyErr_SetString(PyExc_ValueError, "too many connections");
+        goto error;
+    }
+    *n = (int)size;
+    if (!(conns = PyMem_New(connectionObject *, *n + 1))) {
+        PyErr_NoMemory();
+        goto error;
+    }
+
+    for (i = 0; i < *n; i++) {
+        conn = (connectionObject *)PySequence_Fast_GET_ITEM(*seq, i);
+        if (!PyObject_TypeCheck(conn, &connectionType)) {
+            PyErr_SetString(PyExc_TypeError,
+                "conns must contain connection objects");
+            goto error;
+        }
+        if (conn->closed) {
+            PyErr_SetString(InterfaceError, "connection already closed");
+            goto error;
+        }
+        if (conn->async) {
+            PyErr_Format(ProgrammingError,
+                "%s cannot be used in asynchronous mode", cmd);
+            goto error;
+        }
+        if (!conn->tpc_xid || (conn->status != CONN_STATUS_BEGIN
+                && conn->status != CONN_STATUS_PREPARED)) {
+            PyErr_Format(ProgrammingError,
+                "%s must be called on connections in a two-phase "
+                "transaction", cmd);
+            goto error;
+        }
+        if (prepared == 0 && conn->status == CONN_STATUS_PREPARED) {
+            PyErr_Format(ProgrammingError, "%s cannot be used "
+                "with a prepared two-phase transaction", cmd);
+            goto error;
+        }
+        for (j = 0; j < i; j++) {
+            if (conns[j] == conn) {
+                PyErr_Format(ProgrammingError,
+                    "%s received the same connection twice", cmd);
+                goto error;
+            }
+        }
+        conns[i] = conn;
+    }
+    return conns;
+
+error:
+    PyMem_Free(conns);
+    Py_CLEAR(*seq);
+    return NULL;
+}
+
+#define psyco_tpc_prepare_all_doc \
+"tpc_prepare_all(conns) -- Prepare the two-phase transactions of many\n" \
+"connections at once.\n\n" \
+"If any of them fails to prepare all the transactions are rolled back."
+
+static PyObject *
+psyco_tpc_prepare_all(PyObject *self, PyObject *pyconns)
+{
+    PyObject *seq = NULL;
+    connectionObject **conns;
+    int n, rv;
+
+    if (!(conns = _psyco_tpc_conns(
+            pyconns, 0, "tpc_prepare_all", &seq, &n))) {
+        return NULL;
+    }
+    rv = conn_tpc_prepare_many(conns, n);
+    PyMem_Free(conns);
+    Py_DECREF(seq);
+
+    if (rv < 0) { return NULL; }
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+#define psyco_tpc_commit_all_doc \
+"tpc_commit_all(conns) -- Commit the two-phase transactions of many\n" \
+"connections at once.\n\n" \
+"The transactions not prepared yet are prepared first, as in\n" \
+"`tpc_prepare_all()`, then all of them are committed."
+
+static PyObject *
+psyco_tpc_commit_all(PyObject *self, PyObject *pyconns)
+{
+    PyObject *seq = NULL;
+    connectionObject **conns;
+    int n, rv;
+
+    if (!(conns = _psyco_tpc_conns(
+            pyconns, 1, "tpc_commit_all", &seq, &n))) {
+        return NULL;
+    }
+    rv = conn_tpc_prepare_many(conns, n);
+    if (rv == 0) {
+        rv = conn_tpc_finish_many(conns, n, 1);
+    }
+    PyMem_Free(conns);
+    Py_DECREF(seq);
+
+    if (rv < 0) { return NULL; }
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+#define psyco_tpc_rollback_all_doc \
+"tpc_rollback_all(conns) -- Roll back the two-phase transactions of many\n" \
+"connections at once, prepared or not."
+
+static PyObject *
+psyco_tpc_rollback_all(PyObject *self, PyObject *pyconns)
+{
+    PyObject *seq = NULL;
+    connectionObject **conns;
+    int n, rv;
+
+    if (!(conns = _psyco_tpc_conns(
+            pyconns, 1, "tpc_rollback_all", &seq, &n))) {
+        return NULL;
+    }
+    rv = conn_tpc_finish_many(conns, n, 0);
+    PyMem_Free(conns);
+    Py_DECREF(seq);
+
+    if (rv < 0) { return NULL; }
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
 /** type registration **/
 #define psyco_register_type_doc \
 "register_type(obj, conn_or_curs) -> None -- register obj with psycopg type system\n\n" \
@@ -244,6 +602,27 @@ psyco_connect(PyObject *self, PyObject *args, PyObject *keywds)
 "    the string representation returned by PostgreSQL (`None` if ``NULL``)\n" \
 "    and ``cur`` is the cursor from which data are read."
 
+#define typecast_array_from_python_doc \
+"new_array_type(oids, name, baseobj) -> new type object\n\n" \
+"Create a new binding object to parse an array.\n\n" \
+"The object can be used with `register_type()`.\n\n" \
+":Parameters:\n" \
+"  * `oids`: Tuple of ``oid`` of the PostgreSQL types to convert.\n" \
+"  * `name`: Name for the new type\n" \
+"  * `baseobj`: Adapter to perform type conversion of a single array item."
+
+#define typecast_composite_from_python_doc \
+"new_composite_type(oids, name, atttypes, factory=None) -> new type object\n\n" \
+"Create a new binding object to parse a composite type.\n\n" \
+"The object can be used with `register_type()`.\n\n" \
+":Parameters:\n" \
+"  * `oids`: Tuple of ``oid`` of the PostgreSQL types to convert.\n" \
+"  * `name`: Name for the new type\n" \
+"  * `atttypes`: Tuple of the ``oid`` of the type attributes, each one\n" \
+"    converted by the typecaster registered for it.\n" \
+"  * `factory`: Callable receiving the converted attributes as\n" \
+"    arguments. If `None` a tuple is returned."
+
 static void
 _psyco_register_type_set(PyObject **dict, PyObject *type)
 {
@@ -300,6 +679,7 @@ psyco_adapters_init(PyObject *mod)
     microprotocols_add(&PyUnicode_Type, NULL, (PyObject*)&qstringType);
     microprotocols_add(&PyBuffer_Type, NULL, (PyObject*)&binaryType);
     microprotocols_add(&PyList_Type, NULL, (PyObject*)&listType);
+    microprotocols_add(&PyTuple_Type, NULL, (PyObject*)&listType);
 
     if ((type = (PyTypeObject*)psyco_GetDecimalType()) != NULL)
         microprotocols_add(type, NULL, (PyObject*)&pdecimalType);
@@ -636,13 +1016,27 @@ psyco_GetDecimalType(void)
 static PyMethodDef psycopgMethods[] = {
     {"connect",  (PyCFunction)psyco_connect,
      METH_VARARGS|METH_KEYWORDS, psyco_connect_doc},
+    {"connect_fastest",  (PyCFunction)psyco_connect_fastest,
+     METH_VARARGS|METH_KEYWORDS, psyco_connect_fastest_doc},
+    {"tpc_prepare_all",  (PyCFunction)psyco_tpc_prepare_all,
+     METH_O, psyco_tpc_prepare_all_doc},
+    {"tpc_commit_all",  (PyCFunction)psyco_tpc_commit_all,
+     METH_O, psyco_tpc_commit_all_doc},
+    {"tpc_rollback_all",  (PyCFunction)psyco_tpc_rollback_all,
+     METH_O, psyco_tpc_rollback_all_doc},
     {"adapt",  (PyCFunction)psyco_microprotocols_adapt,
      METH_VARARGS, psyco_microprotocols_adapt_doc},
+    {"register_adapter",  (PyCFunction)psyco_microprotocols_register,
+     METH_VARARGS, psyco_microprotocols_register_doc},
 
     {"register_type", (PyCFunction)psyco_register_type,
      METH_VARARGS, psyco_register_type_doc},
     {"new_type", (PyCFunction)typecast_from_python,
      METH_VARARGS|METH_KEYWORDS, typecast_from_python_doc},
+    {"new_array_type", (PyCFunction)typecast_array_from_python,
+     METH_VARARGS|METH_KEYWORDS, typecast_array_from_python_doc},
+    {"new_composite_type", (PyCFunction)typecast_composite_from_python,
+     METH_VARARGS|METH_KEYWORDS, typecast_composite_from_python_doc},
 
     {"AsIs",  (PyCFunction)psyco_AsIs,
      METH_VARARGS, psyco_AsIs_doc},
@@ -693,9 +1087,11 @@ static PyMethodDef psycopgMethods[] = {
 
 #ifdef PSYCOPG_EXTENSIONS
     {"set_wait_callback",  (PyCFunction)psyco_set_wait_callback,
-     METH_O, psyco_set_wait_callback_doc},
+     METH_VARARGS|METH_KEYWORDS, psyco_set_wait_callback_doc},
     {"get_wait_callback",  (PyCFunction)psyco_get_wait_callback,
      METH_NOARGS, psyco_get_wait_callback_doc},
+    {"wait_poll",  (PyCFunction)psyco_wait_poll,
+     METH_O, psyco_wait_poll_doc},
 #endif
 
     {NULL, NULL, 0, NULL}        /* Sentinel */
@@ -728,6 +1124,9 @@ init_psycopg(void)
     pdecimalType.ob_type   = &PyType_Type;
     asisType.ob_type       = &PyType_Type;
     listType.ob_type       = &PyType_Type;
+    hstoreType.ob_type     = &PyType_Type;
+    uuidType.ob_type       = &PyType_Type;
+    inetType.ob_type       = &PyType_Type;
     chunkType.ob_type      = &PyType_Type;
     NotifyType.ob_type     = &PyType_Type;
     XidType.ob_type        = &PyType_Type;
@@ -743,13 +1142,37 @@ init_psycopg(void)
     if (PyType_Ready(&pdecimalType) == -1) return;
     if (PyType_Ready(&asisType) == -1) return;
     if (PyType_Ready(&listType) == -1) return;
+    if (PyType_Ready(&hstoreType) == -1) return;
+    if (PyType_Ready(&uuidType) == -1) return;
+    if (PyType_Ready(&inetType) == -1) return;
     if (PyType_Ready(&chunkType) == -1) return;
     if (PyType_Ready(&NotifyType) == -1) return;
     if (PyType_Ready(&XidType) == -1) return;
+    registryType.ob_type = &PyType_Type;
+    registryType.tp_base = &PyDict_Type;
+    if (PyType_Ready(&registryType) == -1) return;
 
 #ifdef PSYCOPG_EXTENSIONS
     lobjectType.ob_type    = &PyType_Type;
     if (PyType_Ready(&lobjectType) == -1) return;
+    copystreamType.ob_type = &PyType_Type;
+    if (PyType_Ready(&copystreamType) == -1) return;
+    columnType.ob_type = &PyType_Type;
+    if (PyType_Ready(&columnType) == -1) return;
+    lazyresultType.ob_type = &PyType_Type;
+    if (PyType_Ready(&lazyresultType) == -1) return;
+    lazyrowType.ob_type = &PyType_Type;
+    if (PyType_Ready(&lazyrowType) == -1) return;
+    dictrowType.ob_type = &PyType_Type;
+    dictrowType.tp_base = &PyList_Type;
+    if (PyType_Ready(&dictrowType) == -1) return;
+    realdictrowType.ob_type = &PyType_Type;
+    realdictrowType.tp_base = &PyDict_Type;
+    if (PyType_Ready(&realdictrowType) == -1) return;
+    poolType.ob_type = &PyType_Type;
+    if (PyType_Ready(&poolType) == -1) return;
+    resultcacheType.ob_type = &PyType_Type;
+    if (PyType_Ready(&resultcacheType) == -1) return;
 #endif
 
     /* import mx.DateTime module, if necessary */
@@ -775,21 +1198,14 @@ init_psycopg(void)
     /* Initialize the PyDateTimeAPI everywhere is used */
     PyDateTime_IMPORT;
     if (psyco_adapter_datetime_init()) { return; }
+    if (psyco_copy_binary_init()) { return; }
 
     pydatetimeType.ob_type = &PyType_Type;
     if (PyType_Ready(&pydatetimeType) == -1) return;
 
-    /* import psycopg2.tz anyway (TODO: replace with C-level module?) */
-    pyPsycopgTzModule = PyImport_ImportModule("psycopg2.tz");
-    if (pyPsycopgTzModule == NULL) {
-        Dprintf("initpsycopg: can't import psycopg2.tz module");
-        PyErr_SetString(PyExc_ImportError, "can't import psycopg2.tz module");
-        return;
-    }
-    pyPsycopgTzLOCAL =
-        PyObject_GetAttrString(pyPsycopgTzModule, "LOCAL");
-    pyPsycopgTzFixedOffsetTimezone =
-        PyObject_GetAttrString(pyPsycopgTzModule, "FixedOffsetTimezone");
+    if (psyco_tz_init()) { return; }
+    tzType.ob_type = &PyType_Type;
+    if (PyType_Ready(&tzType) == -1) return;
 
     /* initialize the module and grab module's dictionary */
     module = Py_InitModule("_psycopg", psycopgMethods);
@@ -822,7 +1238,28 @@ init_psycopg(void)
     PyModule_AddObject(module, "Xid", (PyObject*)&XidType);
 #ifdef PSYCOPG_EXTENSIONS
     PyModule_AddObject(module, "lobject", (PyObject*)&lobjectType);
+    PyModule_AddObject(module, "LazyRow", (PyObject*)&lazyrowType);
+    PyModule_AddObject(module, "DictRow", (PyObject*)&dictrowType);
+    PyModule_AddObject(module, "RealDictRow", (PyObject*)&realdictrowType);
+    PyModule_AddObject(module, "NativeConnectionPool", (PyObject*)&poolType);
+    PyModule_AddObject(module, "ResultCache", (PyObject*)&resultcacheType);
+    PyModule_AddObject(module, "Hstore", (PyObject*)&hstoreType);
+    PyModule_AddObject(module, "Uuid", (PyObject*)&uuidType);
+    PyModule_AddObject(module, "Inet", (PyObject*)&inetType);
 #endif
+    PyModule_AddObject(module, "FixedOffsetTimezone", (PyObject*)&tzType);
+
+    /* import psycopg2.tz, which exports FixedOffsetTimezone from here */
+    pyPsycopgTzModule = PyImport_ImportModule("psycopg2.tz");
+    if (pyPsycopgTzModule == NULL) {
+        Dprintf("initpsycopg: can't import psycopg2.tz module");
+        PyErr_SetString(PyExc_ImportError, "can't import psycopg2.tz module");
+        return;
+    }
+    pyPsycopgTzLOCAL =
+        PyObject_GetAttrString(pyPsycopgTzModule, "LOCAL");
+    Py_INCREF(&tzType);
+    pyPsycopgTzFixedOffsetTimezone = (PyObject*)&tzType;
 
     /* encodings dictionary in module dictionary */
     PyModule_AddObject(module, "encodings", psycoEncodings);
@@ -849,8 +1286,12 @@ init_psycopg(void)
     asisType.tp_alloc = PyType_GenericAlloc;
     qstringType.tp_alloc = PyType_GenericAlloc;
     listType.tp_alloc = PyType_GenericAlloc;
+    hstoreType.tp_alloc = PyType_GenericAlloc;
+    uuidType.tp_alloc = PyType_GenericAlloc;
+    inetType.tp_alloc = PyType_GenericAlloc;
     chunkType.tp_alloc = PyType_GenericAlloc;
     pydatetimeType.tp_alloc = PyType_GenericAlloc;
+    tzType.tp_alloc = PyType_GenericAlloc;
     NotifyType.tp_alloc = PyType_GenericAlloc;
     XidType.tp_alloc = PyType_GenericAlloc;
 
@@ -0,0 +1,183 @@
+/* registry_type.c - the dictionaries of the typecasters and adapters
+ *
+ * Copyright (C) 2010 Federico Di Gregorio <fog@debian.org>
+ *
+ * This file is part of psycopg.
+ *
+ * psycopg2 is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link this program with the OpenSSL library (or with
+ * modified versions of OpenSSL that use the same license as OpenSSL),
+ * and distribute linked combinations including the two.
+ *
+ * You must obey the GNU Lesser General Public License in all respects for
+ * all of the code used other than OpenSSL.
+ *
+ * psycopg2 is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#define PSYCOPG_MODULE
+#include "psycopg/config.h"
+#include "psycopg/python.h"
+#include "psycopg/psycopg.h"
+#include "psycopg/registry.h"
+
+
+/* The registries are the dictionaries exposed as string_types,
+   binary_types and adapters: the typecasters and adapters resolved from
+   them are cached, so every change made from Python, not only the ones
+   made by register_type() and register_adapter(), bumps the generation. */
+
+long int registry_generation = 0;
+
+/* call the dict method name and mark the registries as changed */
+
+static PyObject *
+_registry_call(PyObject *self, const char *name,
+               PyObject *args, PyObject *kwargs)
+{
+    PyObject *meth, *margs, *rv = NULL;
+    Py_ssize_t i, n;
+
+    if (!(meth = PyObject_GetAttrString((PyObject *)&PyDict_Type, name))) {
+        return NULL;
+    }
+
+    n = args ? PyTuple_GET_SIZE(args) : 0;
+    if (!(margs = PyTuple_New(n + 1))) { goto exit; }
+    Py_INCREF(self);
+    PyTuple_SET_ITEM(margs, 0, self);
+    for (i = 0; i < n; i++) {
+        PyObject *arg = PyTuple_GET_ITEM(args, i);
+        Py_INCREF(arg);
+        PyTuple_SET_ITEM(margs, i + 1, arg);
+    }
+
+    rv = PyObject_Call(meth, margs, kwargs);
+    registry_generation++;
+
+exit:
+    Py_XDECREF(margs);
+    Py_DECREF(meth);
+    return rv;
+}
+
+#define REGISTRY_METHOD(name) \
+static PyObject * \
+registry_ ## name(PyObject *self, PyObject *args, PyObject *kwargs) \
+{ \
+    return _registry_call(self, #name, args, kwargs); \
+}
+
+REGISTRY_METHOD(clear)
+REGISTRY_METHOD(pop)
+REGISTRY_METHOD(popitem)
+REGISTRY_METHOD(setdefault)
+REGISTRY_METHOD(update)
+
+static int
+registry_ass_subscript(PyObject *self, PyObject *key, PyObject *value)
+{
+    registry_generation++;
+    return PyDict_Type.tp_as_mapping->mp_ass_subscript(self, key, value);
+}
+
+
+/** the registry object **/
+
+static struct PyMethodDef registryObject_methods[] = {
+    {"clear", (PyCFunction)registry_clear,
+     METH_VARARGS|METH_KEYWORDS, NULL},
+    {"pop", (PyCFunction)registry_pop,
+     METH_VARARGS|METH_KEYWORDS, NULL},
+    {"popitem", (PyCFunction)registry_popitem,
+     METH_VARARGS|METH_KEYWORDS, NULL},
+    {"setdefault", (PyCFunction)registry_setdefault,
+     METH_VARARGS|METH_KEYWORDS, NULL},
+    {"update", (PyCFunction)registry_update,
+     METH_VARARGS|METH_KEYWORDS, NULL},
+    {NULL}
+};
+
+/* the other slots are inherited from dict */
+static PyMappingMethods registry_mapping = {
+    0,          /*mp_length*/
+    0,          /*mp_subscript*/
+    registry_ass_subscript /*mp_ass_subscript*/
+};
+
+#define registryType_doc \
+"A dictionary of typecasters or adapters."
+
+PyTypeObject registryType = {
+    PyObject_HEAD_INIT(NULL)
+    0,
+    "psycopg2._psycopg.Registry",
+    0,
+    0,
+    0,          /*tp_dealloc*/
+    0,          /*tp_print*/
+    0,          /*tp_getattr*/
+    0,          /*tp_setattr*/
+    0,          /*tp_compare*/
+    0,          /*tp_repr*/
+    0,          /*tp_as_number*/
+    0,          /*tp_as_sequence*/
+    &registry_mapping, /*tp_as_mapping*/
+    0,          /*tp_hash */
+
+    0,          /*tp_call*/
+    0,          /*tp_str*/
+    0,          /*tp_getattro*/
+    0,          /*tp_setattro*/
+    0,          /*tp_as_buffer*/
+
+    Py_TPFLAGS_DEFAULT|Py_TPFLAGS_BASETYPE, /*tp_flags: GC from dict*/
+    registryType_doc, /*tp_doc*/
+
+    0,          /*tp_traverse*/
+    0,          /*tp_clear*/
+
+    0,          /*tp_richcompare*/
+    0,          /*tp_weaklistoffset*/
+
+    0,          /*tp_iter*/
+    0,          /*tp_iternext*/
+
+    /* Attribute descriptor and subclassing stuff */
+
+    registryObject_methods, /*tp_methods*/
+    0,          /*tp_members*/
+    0,          /*tp_getset*/
+    0,          /*tp_base: PyDict_Type, set at module init*/
+    0,          /*tp_dict*/
+
+    0,          /*tp_descr_get*/
+    0,          /*tp_descr_set*/
+    0,          /*tp_dictoffset*/
+
+    0,          /*tp_init*/
+    0,          /*tp_alloc*/
+    0,          /*tp_new*/
+};
+
+
+/** C interface **/
+
+/* registry_new - return a new empty registry */
+
+PyObject *
+registry_new(void)
+{
+    return PyDict_Type.tp_new(&registryType, NULL, NULL);
+}
@@ -0,0 +1,71 @@
+/* resultcache.h - definition for the client-side result cache
+ *
+ * Copyright (C) 2010 Federico Di Gregorio <fog@debian.org>
+ *
+ * This file is part of psycopg.
+ *
+ * psycopg2 is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link this program with the OpenSSL library (or with
+ * modified versions of OpenSSL that use the same license as OpenSSL),
+ * and distribute linked combinations including the two.
+ *
+ * You must obey the GNU Lesser General Public License in all respects for
+ * all of the code used other than OpenSSL.
+ *
+ * psycopg2 is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ */
+
+#ifndef PSYCOPG_RESULTCACHE_H
+#define PSYCOPG_RESULTCACHE_H 1
+
+#include <Python.h>
+
+#include "psycopg/config.h"
+#include "psycopg/cursor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern HIDDEN PyTypeObject resultcacheType;
+
+/* The cache maps the query sent to the backend to the lazyresultObject
+   owning its PGresult: the values are decoded again by every cursor
+   fetching them, so they are never shared between the callers. */
+typedef struct {
+    PyObject_HEAD
+
+    PyObject *entries;      /* query -> (owner, expiry time, size, seq) */
+    PyObject *order;        /* (query, seq) in insertion order, to evict */
+    Py_ssize_t head;        /* the first pair of order not evicted yet */
+    long int seq;           /* the seq of the next entry */
+    PyObject *channels;     /* NOTIFY channels clearing the cache */
+
+    long int maxsize;       /* max number of entries, 0 = unlimited */
+    Py_ssize_t maxbytes;    /* max results memory, 0 = unlimited */
+    double ttl;             /* seconds an entry is valid, 0 = forever */
+
+    Py_ssize_t memory;      /* memory used by the results cached */
+    long int hits;
+    long int misses;
+} resultcacheObject;
+
+#define resultcache_Check(op) PyObject_TypeCheck(op, &resultcacheType)
+
+HIDDEN PyObject *resultcache_get(resultcacheObject *self, PyObject *query);
+HIDDEN void resultcache_store(resultcacheObject *self, cursorObject *curs);
+HIDDEN void resultcache_notify(resultcacheObject *self, const char *channel);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !defined(PSYCOPG_RESULTCACHE_H) */
@@ -0,0 +1,529 @@
+/* resultcache_type.c - client-side cache of the query results
+ *
+ * Copyright (C) 2010 Federico Di Gregorio <fog@debian.org>
+ *
+ * This file is part of psycopg.
+ *
+ * psycopg2 is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link this program with the OpenSSL library (or with
+ * modified versions of OpenSSL that use the same license as OpenSSL),
+ * and distribute linked combinations including the two.
+ *
+ * You must obey the GNU Lesser General Public License in all respects for
+ * all of the code used other than OpenSSL.
+ *
+ * psycopg2 is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <structmember.h>
+#include <string.h>
+#include <ctype.h>
+
+#define PSYCOPG_MODULE
+#include "psycopg/config.h"
+#include "psycopg/python.h"
+#include "psycopg/psycopg.h"
+#include "psycopg/resultcache.h"
+#include "psycopg/lazyrow.h"
+#include "psycopg/pqpath.h"
+
+
+/** entries management **/
+
+/* The entries are evicted in insertion order: order is a list of
+   (query, seq) pairs, starting at the index head, and the entry of a query
+   stores the seq of its pair. Removing an entry only deletes it from the
+   dict: its pair becomes stale and is skipped when its turn to be evicted
+   comes, so that no operation has to scan the list. */
+
+/* remove the entry of a query, updating the memory used */
+
+static int
+resultcache_remove(resultcacheObject *self, PyObject *query)
+{
+    PyObject *entry;
+
+    if (!self->entries) { return 0; }
+    if (!(entry = PyDict_GetItem(self->entries, query))) { return 0; }
+
+    self->memory -= PyInt_AsSsize_t(PyTuple_GET_ITEM(entry, 2));
+    return PyDict_DelItem(self->entries, query);
+}
+
+/* return 1 if the order pair refers to the current entry of its query */
+
+static int
+resultcache_pair_live(resultcacheObject *self, PyObject *pair)
+{
+    PyObject *entry;
+
+    if (!(entry = PyDict_GetItem(self->entries, PyTuple_GET_ITEM(pair, 0)))) {
+        return 0;
+    }
+    return PyInt_AS_LONG(PyTuple_GET_ITEM(entry, 3))
+        == PyInt_AS_LONG(PyTuple_GET_ITEM(pair, 1));
+}
+
+/* drop the stale pairs from the order list once they are the majority */
+
+static int
+resultcache_compact(resultcacheObject *self)
+{
+    PyObject *order, *pair;
+    Py_ssize_t i, len = PyList_GET_SIZE(self->order);
+
+    if (len - self->head <= 2 * PyDict_Size(self->entries) + 16) {
+        return 0;
+    }
+    if (!(order = PyList_New(0))) { return -1; }
+    for (i = self->head; i < len; i++) {
+        pair = PyList_GET_ITEM(self->order, i);
+        if (resultcache_pair_live(self, pair)
+                && 0 > PyList_Append(order, pair)) {
+            Py_DECREF(order);
+            return -1;
+        }
+    }
+    Py_DECREF(self->order);
+    self->order = order;
+    self->head = 0;
+    return 0;
+}
+
+/* remove the oldest entries until the cache is within its limits */
+
+static int
+resultcache_evict(resultcacheObject *self)
+{
+    PyObject *pair;
+    int rv;
+
+    while (self->head < PyList_GET_SIZE(self->order)
+            && ((self->maxsize > 0
+                    && PyDict_Size(self->entries) > self->maxsize)
+                || (self->maxbytes > 0 && self->memory > self->maxbytes))) {
+        pair = PyList_GET_ITEM(self->order, self->head++);
+        if (!resultcache_pair_live(self, pair)) { continue; }
+        Dprintf("resultcache_evict: evicting %s",
+            PyString_AS_STRING(PyTuple_GET_ITEM(pair, 0)));
+        Py_INCREF(pair);
+        rv = resultcache_remove(self, PyTuple_GET_ITEM(pair, 0));
+        Py_DECREF(pair);
+        if (rv < 0) { return -1; }
+    }
+    return resultcache_compact(self);
+}
+
+static void
+resultcache_clear_entries(resultcacheObject *self)
+{
+    if (!self->entries) { return; }
+    PyDict_Clear(self->entries);
+    PyList_SetSlice(self->order, 0, PyList_GET_SIZE(self->order), NULL);
+    self->head = 0;
+    self->memory = 0;
+}
+
+/* return 1 if the result of the cursor query can be cached
+
+   Only the results of SELECT are: a command returning tuples may have
+   side effects, such as an INSERT ... RETURNING, which would be skipped by
+   the next cursors. The SELECT locking rows (FOR UPDATE, FOR SHARE...) are
+   recognised looking for FOR followed by UPDATE, SHARE, NO or KEY: a false
+   positive only means the result is not cached. */
+
+static int
+resultcache_word_is(const char *s, size_t len, const char *word)
+{
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        if (!word[i] || tolower((unsigned char)s[i]) != word[i]) { return 0; }
+    }
+    return word[len] == '\0';
+}
+
+static int
+resultcache_cacheable(cursorObject *curs)
+{
+    const char *s, *w;
+    int locking = 0;
+
+    if (!curs->pgres || PQresultStatus(curs->pgres) != PGRES_TUPLES_OK
+            || 0 != strncmp(PQcmdStatus(curs->pgres), "SELECT", 6)) {
+        return 0;
+    }
+
+    s = PyString_AS_STRING(curs->query);
+    for (;;) {
+        /* the next word, and whether it follows a FOR */
+        while (*s && !isalnum((unsigned char)*s) && *s != '_') { s++; }
+        if (!*s) { break; }
+        for (w = s; isalnum((unsigned char)*s) || *s == '_'; s++) { }
+        if (locking && (resultcache_word_is(w, s - w, "update")
+                || resultcache_word_is(w, s - w, "share")
+                || resultcache_word_is(w, s - w, "no")
+                || resultcache_word_is(w, s - w, "key"))) {
+            return 0;
+        }
+        locking = resultcache_word_is(w, s - w, "for");
+    }
+    return 1;
+}
+
+/* resultcache_get - return the result owner cached for a query
+
+   Return a borrowed reference or NULL, without an exception set, if the
+   query is not in the cache or its entry is expired. */
+
+PyObject *
+resultcache_get(resultcacheObject *self, PyObject *query)
+{
+    PyObject *entry;
+    double expiry;
+
+    if (!self->entries) { return NULL; }
+    if (!(entry = PyDict_GetItem(self->entries, query))) {
+        self->misses++;
+        return NULL;
+    }
+
+    expiry = PyFloat_AS_DOUBLE(PyTuple_GET_ITEM(entry, 1));
+    if (expiry > 0 && psycopg_now() >= expiry) {
+        Dprintf("resultcache_get: entry expired");
+        if (0 > resultcache_remove(self, query)) { PyErr_Clear(); }
+        self->misses++;
+        return NULL;
+    }
+
+    self->hits++;
+    return PyTuple_GET_ITEM(entry, 0);
+}
+
+/* resultcache_store - add the result of the cursor query to the cache
+
+   Only the results of SELECT queries are cached: see
+   resultcache_cacheable(). A failure only means the result is not cached:
+   no exception is left set. */
+
+void
+resultcache_store(resultcacheObject *self, cursorObject *curs)
+{
+    PyObject *owner, *entry, *pair;
+    size_t size;
+    long seq;
+
+    if (!self->entries || !resultcache_cacheable(curs)) { return; }
+    size = pq_result_memory(curs->pgres);
+    if (self->maxbytes > 0 && size > (size_t)self->maxbytes) { return; }
+
+    seq = self->seq++;
+    if (!(owner = lazyresult_share(curs))) { goto error; }
+    if (!(entry = Py_BuildValue("(Odnl)", owner,
+            self->ttl > 0 ? psycopg_now() + self->ttl : 0.0,
+            (Py_ssize_t)size, seq))) {
+        goto error;
+    }
+    if (!(pair = Py_BuildValue("(Ol)", curs->query, seq))) {
+        Py_DECREF(entry);
+        goto error;
+    }
+
+    if (0 > resultcache_remove(self, curs->query)
+            || 0 > PyDict_SetItem(self->entries, curs->query, entry)) {
+        Py_DECREF(entry);
+        Py_DECREF(pair);
+        goto error;
+    }
+    Py_DECREF(entry);
+    if (0 > PyList_Append(self->order, pair)) {
+        Py_DECREF(pair);
+        PyDict_DelItem(self->entries, curs->query);
+        goto error;
+    }
+    Py_DECREF(pair);
+    self->memory += size;
+
+    if (0 > resultcache_evict(self)) { goto error; }
+    return;
+
+error:
+    PyErr_Clear();
+}
+
+/* resultcache_notify - clear the cache if it is invalidated by a channel */
+
+void
+resultcache_notify(resultcacheObject *self, const char *channel)
+{
+    Py_ssize_t i;
+
+    if (!self->channels) { return; }
+    for (i = 0; i < PyTuple_GET_SIZE(self->channels); i++) {
+        if (0 == strcmp(channel,
+                PyString_AS_STRING(PyTuple_GET_ITEM(self->channels, i)))) {
+            Dprintf("resultcache_notify: cleared by channel %s", channel);
+            resultcache_clear_entries(self);
+            return;
+        }
+    }
+}
+
+
+/** public methods **/
+
+#define psyco_resultcache_clear_doc \
+"clear() -- Remove all the results from the cache."
+
+static PyObject *
+psyco_resultcache_clear(resultcacheObject *self)
+{
+    resultcache_clear_entries(self);
+    Py_RETURN_NONE;
+}
+
+#define psyco_resultcache_discard_doc \
+"discard(query) -- Remove the result of a query from the cache.\n\n" \
+"`query` is the query as sent to the backend, e.g. `cursor.query`."
+
+static PyObject *
+psyco_resultcache_discard(resultcacheObject *self, PyObject *query)
+{
+    if (!PyString_Check(query)) {
+        PyErr_SetString(PyExc_TypeError, "the query must be a string");
+        return NULL;
+    }
+    if (0 > resultcache_remove(self, query)) { return NULL; }
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+psyco_resultcache_get_ttl(resultcacheObject *self)
+{
+    if (self->ttl > 0) { return PyFloat_FromDouble(self->ttl); }
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+static int
+psyco_resultcache_set_ttl(resultcacheObject *self, PyObject *value)
+{
+    double v = 0;
+
+    if (value == NULL) {
+        PyErr_SetString(PyExc_TypeError, "can't delete the attribute");
+        return -1;
+    }
+    if (value != Py_None) {
+        v = PyFloat_AsDouble(value);
+        if (v == -1 && PyErr_Occurred()) { return -1; }
+        if (v < 0) {
+            PyErr_SetString(PyExc_ValueError, "the value must be positive");
+            return -1;
+        }
+    }
+    self->ttl = v;
+    return 0;
+}
+
+static Py_ssize_t
+resultcache_len(resultcacheObject *self)
+{
+    return self->entries ? PyDict_Size(self->entries) : 0;
+}
+
+
+/** the ResultCache object **/
+
+static struct PyMethodDef resultcacheObject_methods[] = {
+    {"clear", (PyCFunction)psyco_resultcache_clear,
+     METH_NOARGS, psyco_resultcache_clear_doc},
+    {"discard", (PyCFunction)psyco_resultcache_discard,
+     METH_O, psyco_resultcache_discard_doc},
+    {NULL}
+};
+
+static struct PyMemberDef resultcacheObject_members[] = {
+    {"maxsize", T_LONG, offsetof(resultcacheObject, maxsize), 0,
+        "Maximum number of results cached, 0 for no limit."},
+    {"maxbytes", T_PYSSIZET, offsetof(resultcacheObject, maxbytes), 0,
+        "Maximum memory used by the results cached, 0 for no limit."},
+    {"channels", T_OBJECT, offsetof(resultcacheObject, channels), RO,
+        "The notification channels clearing the cache."},
+    {"memory", T_PYSSIZET, offsetof(resultcacheObject, memory), RO,
+        "The memory used by the results cached."},
+    {"hits", T_LONG, offsetof(resultcacheObject, hits), RO,
+        "Number of queries whose result was found in the cache."},
+    {"misses", T_LONG, offsetof(resultcacheObject, misses), RO,
+        "Number of cacheable queries sent to the backend."},
+    {NULL}
+};
+
+static struct PyGetSetDef resultcacheObject_getsets[] = {
+    { "ttl", (getter)psyco_resultcache_get_ttl,
+      (setter)psyco_resultcache_set_ttl,
+      "Seconds after which a result is not used anymore, None to keep it.",
+      NULL },
+    {NULL}
+};
+
+static PySequenceMethods resultcacheObject_sequence = {
+    (lenfunc)resultcache_len, /*sq_length*/
+    0,          /*sq_concat*/
+    0,          /*sq_repeat*/
+    0,          /*sq_item*/
+    0,          /*sq_slice*/
+    0,          /*sq_ass_item*/
+    0,          /*sq_ass_slice*/
+    0,          /*sq_contains*/
+    0,          /*sq_inplace_concat*/
+    0,          /*sq_inplace_repeat*/
+};
+
+static int
+resultcache_init(PyObject *obj, PyObject *args, PyObject *kwargs)
+{
+    resultcacheObject *self = (resultcacheObject *)obj;
+    PyObject *ttl = Py_None, *channels = NULL;
+    long int maxsize = 128;
+    Py_ssize_t maxbytes = 0, i;
+
+    static char *kwlist[] = {"maxsize", "maxbytes", "ttl", "channels", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|lnOO", kwlist,
+            &maxsize, &maxbytes, &ttl, &channels))
+        return -1;
+
+    if (maxsize < 0 || maxbytes < 0) {
+        PyErr_SetString(PyExc_ValueError, "the limits must be positive");
+        return -1;
+    }
+    if (0 > psyco_resultcache_set_ttl(self, ttl)) { return -1; }
+
+    Py_CLEAR(self->channels);
+    if (channels) {
+        if (!(self->channels = PySequence_Tuple(channels))) { return -1; }
+        for (i = 0; i < PyTuple_GET_SIZE(self->channels); i++) {
+            if (!PyString_Check(PyTuple_GET_ITEM(self->channels, i))) {
+                PyErr_SetString(PyExc_TypeError,
+                    "the channels must be strings");
+                return -1;
+            }
+        }
+    }
+    else if (!(self->channels = PyTuple_New(0))) { return -1; }
+
+    if (!self->entries && !(self->entries = PyDict_New())) { return -1; }
+    if (!self->order && !(self->order = PyList_New(0))) { return -1; }
+    resultcache_clear_entries(self);
+
+    self->maxsize = maxsize;
+    self->maxbytes = maxbytes;
+    return 0;
+}
+
+static int
+resultcache_traverse(resultcacheObject *self, visitproc visit, void *arg)
+{
+    Py_VISIT(self->entries);
+    Py_VISIT(self->order);
+    Py_VISIT(self->channels);
+    return 0;
+}
+
+static void
+resultcache_dealloc(PyObject* obj)
+{
+    resultcacheObject *self = (resultcacheObject *)obj;
+
+    PyObject_GC_UnTrack(self);
+
+    Py_CLEAR(self->entries);
+    Py_CLEAR(self->order);
+    Py_CLEAR(self->channels);
+
+    Dprintf("resultcache_dealloc: deleted cache object at %p", obj);
+
+    obj->ob_type->tp_free(obj);
+}
+
+static PyObject *
+resultcache_repr(resultcacheObject *self)
+{
+    return PyString_FromFormat(
+        "<ResultCache object at %p; size: %d, hits: %ld, misses: %ld>",
+        self, self->entries ? (int)PyDict_Size(self->entries) : 0,
+        self->hits, self->misses);
+}
+
+
+/* object type */
+
+#define resultcacheType_doc \
+"ResultCache(maxsize=128, maxbytes=0, ttl=None, channels=()) -> new cache\n\n" \
+"A cache of the results of the queries, shared by the connections whose\n" \
+"`result_cache` is set to it and used by the cursors with\n" \
+"`cache_results` set. A notification on one of `channels` clears it."
+
+PyTypeObject resultcacheType = {
+    PyObject_HEAD_INIT(NULL)
+    0,
+    "psycopg2.extensions.ResultCache",
+    sizeof(resultcacheObject),
+    0,
+    resultcache_dealloc, /*tp_dealloc*/
+    0,          /*tp_print*/
+    0,          /*tp_getattr*/
+    0,          /*tp_setattr*/
+    0,          /*tp_compare*/
+    (reprfunc)resultcache_repr, /*tp_repr*/
+    0,          /*tp_as_number*/
+    &resultcacheObject_sequence, /*tp_as_sequence*/
+    0,          /*tp_as_mapping*/
+    0,          /*tp_hash */
+
+    0,          /*tp_call*/
+    (reprfunc)resultcache_repr, /*tp_str*/
+    0,          /*tp_getattro*/
+    0,          /*tp_setattro*/
+    0,          /*tp_as_buffer*/
+
+    Py_TPFLAGS_DEFAULT|Py_TPFLAGS_BASETYPE|Py_TPFLAGS_HAVE_GC, /*tp_flags*/
+    resultcacheType_doc, /*tp_doc*/
+
+    (traverseproc)resultcache_traverse, /*tp_traverse*/
+    0,          /*tp_clear*/
+
+    0,          /*tp_richcompare*/
+    0,          /*tp_weaklistoffset*/
+
+    0,          /*tp_iter*/
+    0,          /*tp_iternext*/
+
+    /* Attribute descriptor and subclassing stuff */
+
+    resultcacheObject_methods, /*tp_methods*/
+    resultcacheObject_members, /*tp_members*/
+    resultcacheObject_getsets, /*tp_getset*/
+    0,          /*tp_base*/
+    0,          /*tp_dict*/
+
+    0,          /*tp_descr_get*/
+    0,          /*tp_descr_set*/
+    0,          /*tp_dictoffset*/
+
+    resultcache_init, /*tp_init*/
+    0,          /*tp_alloc*/
+    PyType_GenericNew, /*tp_new*/
+    0,          /*tp_free*/
+};
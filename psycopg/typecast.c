@@ -33,6 +33,11 @@
 #include "psycopg/python.h"
 #include "psycopg/typecast.h"
 #include "psycopg/cursor.h"
+#include "psycopg/lazyrow.h"
+#include "psycopg/pqpath.h"
+#include "psycopg/pgtypes.h"
+#include "psycopg/adapter_inet.h"
+#include "psycopg/registry.h"
 
 /* useful function used by some typecasters */
 
@@ -172,16 +177,166 @@ typecast_parse_time(const char* s, const char** t, Py_ssize_t* len,
     return cz;
 }
 
+/* check 8 characters against a pattern: the digit positions of the mask
+   are 0xF0 (and '0' in the template), the others 0xFF and the expected
+   character. All the characters are checked at once as a 64 bits word */
+
+static int
+typecast_match8(const char *s, const unsigned char *mask,
+                const unsigned char *templ)
+{
+    unsigned PY_LONG_LONG x, m, t, dm, ones = ~(unsigned PY_LONG_LONG)0 / 255;
+
+    memcpy(&x, s, 8);
+    memcpy(&m, mask, 8);
+    memcpy(&t, templ, 8);
+
+    /* the literals match and the digits are in 0x30-0x3F */
+    if ((x & m) != t) return 0;
+
+    /* adding 6 to the digits doesn't carry, it leaves them in 0x30-0x3F
+       only if they are in '0'-'9' */
+    dm = (~m & (0x0F * ones)) << 4;
+    return ((x + (~m & (0x06 * ones))) & dm) == (t & dm);
+}
+
+#define ISDIGIT(c) ((c) >= '0' && (c) <= '9')
+#define DIGIT(c) ((int)(c) - (int)'0')
+#define DIGITS2(p) (DIGIT((p)[0]) * 10 + DIGIT((p)[1]))
+
+/* parse a timestamp in the fixed format used by the ISO DateStyle:
+   "YYYY-MM-DD[ HH:MM:SS[.US][+TZ]]". Return the number of time fields
+   as typecast_parse_time() (0 for a date), -1 if the string has a
+   different format, for instance a BC date, and the generic parser should
+   be used */
+
+static int
+typecast_parse_iso(const char *s, Py_ssize_t len, typecast_value *v)
+{
+    static const unsigned char dmask[8] =
+        {0xF0, 0xF0, 0xF0, 0xF0, 0xFF, 0xF0, 0xF0, 0xFF};
+    static const unsigned char dtempl[8] =
+        {'0', '0', '0', '0', '-', '0', '0', '-'};
+    static const unsigned char tmask[8] =
+        {0xF0, 0xF0, 0xFF, 0xF0, 0xF0, 0xFF, 0xF0, 0xF0};
+    static const unsigned char ttempl[8] =
+        {'0', '0', ':', '0', '0', ':', '0', '0'};
+
+    const char *p, *end = s + len;
+    int n, usd, sign, tz;
+
+    if (len < 10 || !typecast_match8(s, dmask, dtempl)
+            || !ISDIGIT(s[8]) || !ISDIGIT(s[9])) {
+        return -1;
+    }
+    v->dt.y = DIGITS2(s) * 100 + DIGITS2(s + 2);
+    v->dt.m = DIGITS2(s + 5);
+    v->dt.d = DIGITS2(s + 8);
+    v->dt.hh = v->dt.mm = v->dt.ss = v->dt.us = v->dt.tz = 0;
+    if (len == 10) return 0;
+
+    if (len < 19 || (s[10] != ' ' && s[10] != 'T')
+            || !typecast_match8(s + 11, tmask, ttempl)) {
+        return -1;
+    }
+    v->dt.hh = DIGITS2(s + 11);
+    v->dt.mm = DIGITS2(s + 14);
+    v->dt.ss = DIGITS2(s + 17);
+    n = 3;
+    p = s + 19;
+
+    if (p < end && *p == '.') {
+        for (p++, usd = 0; p < end && ISDIGIT(*p); p++, usd++) {
+            if (usd == 6) return -1;
+            v->dt.us = v->dt.us * 10 + DIGIT(*p);
+        }
+        if (usd == 0) return -1;
+        while (usd++ < 6) v->dt.us *= 10;
+        n = 4;
+    }
+
+    if (p < end && (*p == '+' || *p == '-')) {
+        sign = (*p++ == '-') ? -1 : 1;
+        if (end - p < 2 || !ISDIGIT(p[0]) || !ISDIGIT(p[1])) return -1;
+        tz = 3600 * DIGITS2(p);
+        p += 2; n = 5;
+        if (end - p >= 3 && p[0] == ':' && ISDIGIT(p[1]) && ISDIGIT(p[2])) {
+            tz += 60 * DIGITS2(p + 1);
+            p += 3; n = 6;
+            if (end - p >= 3 && p[0] == ':'
+                    && ISDIGIT(p[1]) && ISDIGIT(p[2])) {
+                tz += DIGITS2(p + 1);
+                p += 3;
+            }
+        }
+        v->dt.tz = sign * tz;
+    }
+
+    return p == end ? n : -1;
+}
+
+#undef ISDIGIT
+#undef DIGIT
+#undef DIGITS2
+
+/* The casters can be called from Python with any object (usually None) as
+ * cursor, for instance to test or benchmark them: in this case the values
+ * are parsed without taking the state of a cursor into account. */
+
+#define typecast_is_cursor(curs) \
+    ((curs) && PyObject_TypeCheck((curs), &cursorType))
+
+/* the typecaster being run when there is no cursor to store it */
+static PyObject *typecast_nocursor_caster = NULL;
+
+/* return the typecaster being run (borrowed reference) */
+static PyObject *
+typecast_current(PyObject *curs)
+{
+    if (typecast_is_cursor(curs)) {
+        return ((cursorObject *)curs)->caster;
+    }
+    return typecast_nocursor_caster;
+}
+
+static void
+typecast_set_current(PyObject *curs, PyObject *caster)
+{
+    if (typecast_is_cursor(curs)) {
+        ((cursorObject *)curs)->caster = caster;
+    }
+    else {
+        typecast_nocursor_caster = caster;
+    }
+}
+
+/* return the tzinfo_factory to use for a cast (borrowed reference)
+ *
+ * Without a cursor the values are returned naive. */
+static PyObject *
+typecast_tzinfo_factory(PyObject *curs)
+{
+    if (typecast_is_cursor(curs)) {
+        return ((cursorObject *)curs)->tzinfo_factory;
+    }
+    return Py_None;
+}
+
 /** include casting objects **/
 #include "psycopg/typecast_basic.c"
 #include "psycopg/typecast_binary.c"
 #include "psycopg/typecast_datetime.c"
+#include "psycopg/typecast_binformat.c"
+#include "psycopg/typecast_hstore.c"
+#include "psycopg/typecast_uuid.c"
+#include "psycopg/typecast_inet.c"
 
 #ifdef HAVE_MXDATETIME
 #include "psycopg/typecast_mxdatetime.c"
 #endif
 
 #include "psycopg/typecast_array.c"
+#include "psycopg/typecast_composite.c"
 #include "psycopg/typecast_builtins.c"
 
 #define typecast_PYDATETIMEARRAY_cast typecast_GENERIC_ARRAY_cast
@@ -202,6 +357,50 @@ static typecastObject_initlist typecast_pydatetime[] = {
     {NULL, NULL, NULL}
 };
 
+/* the opt-in numeric typecaster and the ones it picks for the columns */
+static typecastObject_initlist typecast_numeric[] = {
+    {"NATIVENUMERIC", typecast_DECIMAL_types, typecast_NATIVENUMERIC_cast},
+    {"NATIVENUMERIC_INT", typecast_DECIMAL_types, typecast_NUMERICINT_cast},
+    {"NATIVENUMERIC_FIXED", typecast_DECIMAL_types, typecast_NUMERICFIXED_cast},
+    {NULL, NULL, NULL}
+};
+
+static PyObject *typecast_numeric_casts[2];
+
+/* the opt-in typecasters returning the arrays of numbers as array.array */
+static long int typecast_INTEGERARRAYBUFFER_types[] = {1005, 1007, 1016, 0};
+static long int typecast_FLOATARRAYBUFFER_types[] = {1021, 1022, 0};
+
+static typecastObject_initlist typecast_arraybuffer[] = {
+    {"INTEGERARRAYBUFFER", typecast_INTEGERARRAYBUFFER_types,
+        typecast_INTEGERARRAYBUFFER_cast, "INTEGER"},
+    {"FLOATARRAYBUFFER", typecast_FLOATARRAYBUFFER_types,
+        typecast_FLOATARRAYBUFFER_cast, "FLOAT"},
+    {NULL, NULL, NULL}
+};
+
+/* the typecasters of the types not converted by default: they are
+   registered by the functions in psycopg2.extras. The hstore oid is different
+   in every database and is bound by new_type() */
+static long int typecast_HSTORE_types[] = {0};
+static long int typecast_UUID_types[] = {2950, 0};
+static long int typecast_UUIDARRAY_types[] = {2951, 0};
+static long int typecast_INET_types[] = {869, 650, 0};
+static long int typecast_INETARRAY_types[] = {1041, 651, 0};
+
+#define typecast_UUIDARRAY_cast typecast_GENERIC_ARRAY_cast
+#define typecast_INETARRAY_cast typecast_GENERIC_ARRAY_cast
+
+static typecastObject_initlist typecast_extras[] = {
+    {"HSTORE", typecast_HSTORE_types, typecast_HSTORE_cast},
+    {"UNICODEHSTORE", typecast_HSTORE_types, typecast_UNICODEHSTORE_cast},
+    {"UUID", typecast_UUID_types, typecast_UUID_cast},
+    {"UUIDARRAY", typecast_UUIDARRAY_types, typecast_UUIDARRAY_cast, "UUID"},
+    {"INET", typecast_INET_types, typecast_INET_cast},
+    {"INETARRAY", typecast_INETARRAY_types, typecast_INETARRAY_cast, "INET"},
+    {NULL, NULL, NULL}
+};
+
 #ifdef HAVE_MXDATETIME
 #define typecast_MXDATETIMEARRAY_cast typecast_GENERIC_ARRAY_cast
 #define typecast_MXDATEARRAY_cast typecast_GENERIC_ARRAY_cast
@@ -222,6 +421,73 @@ static typecastObject_initlist typecast_mxdatetime[] = {
 };
 #endif
 
+/* the casting functions that can parse their values without the GIL */
+static typecast_nogil typecast_nogil_list[] = {
+    {typecast_INTEGER_cast, typecast_INTEGER_parse, typecast_INTEGER_build},
+    {typecast_LONGINTEGER_cast,
+        typecast_LONGINTEGER_parse, typecast_LONGINTEGER_build},
+    {typecast_FLOAT_cast, typecast_FLOAT_parse, typecast_FLOAT_build},
+    {typecast_BOOLEAN_cast, typecast_BOOLEAN_parse, typecast_BOOLEAN_build},
+    {typecast_NATIVENUMERIC_cast, typecast_FLOAT_parse, typecast_FLOAT_build},
+    {typecast_NUMERICINT_cast, typecast_INTEGER_parse, typecast_INTEGER_build},
+    {typecast_NUMERICFIXED_cast,
+        typecast_NUMERICFIXED_parse, typecast_NUMERICFIXED_build},
+    {typecast_PYDATE_cast, typecast_PYDATE_parse, typecast_PYDATE_build},
+    {typecast_PYDATETIME_cast,
+        typecast_PYDATETIME_parse, typecast_PYDATETIME_build},
+    {NULL, NULL, NULL}
+};
+
+/* typecast_get_nogil - return the parse functions of a typecaster */
+
+const typecast_nogil *
+typecast_get_nogil(PyObject *obj)
+{
+    typecast_function ccast = ((typecastObject *)obj)->ccast;
+    typecast_nogil *i;
+
+    if (ccast == NULL) return NULL;
+    for (i = typecast_nogil_list; i->cast; i++) {
+        if (i->cast == ccast) return i;
+    }
+    return NULL;
+}
+
+/* typecast_is_text - check if a typecaster returns immutable strings */
+
+int
+typecast_is_text(PyObject *obj)
+{
+    typecast_function ccast = ((typecastObject *)obj)->ccast;
+
+    return ccast == typecast_STRING_cast || ccast == typecast_UNICODE_cast;
+}
+
+/* typecast_numeric_for_column - the caster of a NATIVENUMERIC column
+
+   Return a borrowed reference to the typecaster the column values are
+   decoded with: numeric(p,0) as int, numeric(p,s) with p <= 18 as the int
+   value * 10**s, else float. Other typecasters are returned unchanged. */
+
+PyObject *
+typecast_numeric_for_column(PyObject *cast, int fmod)
+{
+    int precision, scale;
+
+    if (((typecastObject *)cast)->ccast != typecast_NATIVENUMERIC_cast
+            || fmod < (int)sizeof(int)) {
+        return cast;
+    }
+
+    fmod -= sizeof(int);
+    precision = (fmod >> 16) & 0xFFFF;
+    scale = fmod & 0xFFFF;
+
+    if (scale == 0) return typecast_numeric_casts[0];
+    if (precision <= 18) return typecast_numeric_casts[1];
+    return cast;
+}
+
 
 /** the type dictionary and associated functions **/
 
@@ -243,8 +509,8 @@ typecast_init(PyObject *dict)
     int i;
 
     /* create type dictionary and put it in module namespace */
-    psyco_types = PyDict_New();
-    psyco_binary_types = PyDict_New();
+    psyco_types = registry_new();
+    psyco_binary_types = registry_new();
 
     if (!psyco_types || !psyco_binary_types) {
         Py_XDECREF(psyco_types);
@@ -298,6 +564,50 @@ typecast_init(PyObject *dict)
         PyDict_SetItem(dict, t->name, (PyObject *)t);
     }
 
+    /* the numeric typecasters are not registered: only NATIVENUMERIC is
+       exposed, the others are picked by it */
+    for (i = 0; typecast_numeric[i].name != NULL; i++) {
+        typecastObject *t;
+        Dprintf("typecast_init: initializing %s", typecast_numeric[i].name);
+        t = (typecastObject *)typecast_from_c(&(typecast_numeric[i]), dict);
+        if (t == NULL) return -1;
+        if (i == 0) {
+            PyDict_SetItem(dict, t->name, (PyObject *)t);
+            Py_DECREF(t);
+        }
+        else {
+            typecast_numeric_casts[i - 1] = (PyObject *)t;
+        }
+    }
+
+    for (i = 0; typecast_arraybuffer[i].name != NULL; i++) {
+        typecastObject *t;
+        Dprintf("typecast_init: initializing %s", typecast_arraybuffer[i].name);
+        t = (typecastObject *)typecast_from_c(&(typecast_arraybuffer[i]), dict);
+        if (t == NULL) return -1;
+        PyDict_SetItem(dict, t->name, (PyObject *)t);
+        Py_DECREF(t);
+    }
+
+    for (i = 0; typecast_extras[i].name != NULL; i++) {
+        typecastObject *t;
+        Dprintf("typecast_init: initializing %s", typecast_extras[i].name);
+        t = (typecastObject *)typecast_from_c(&(typecast_extras[i]), dict);
+        if (t == NULL) return -1;
+        PyDict_SetItem(dict, t->name, (PyObject *)t);
+        Py_DECREF(t);
+    }
+
+    /* register the decoders used for results in binary format */
+    for (i = 0; typecast_binformat[i].name != NULL; i++) {
+        typecastObject *t;
+        Dprintf("typecast_init: initializing %s", typecast_binformat[i].name);
+        t = (typecastObject *)typecast_from_c(&(typecast_binformat[i]), dict);
+        if (t == NULL) return -1;
+        if (typecast_add((PyObject *)t, NULL, 1) != 0) return -1;
+        Py_DECREF(t);
+    }
+
     return 0;
 }
 
@@ -318,6 +628,9 @@ typecast_add(PyObject *obj, PyObject *dict, int binary)
     if (dict == NULL)
         dict = (binary ? psyco_binary_types : psyco_types);
 
+    /* the typecasters resolved by the connections are stale */
+    registry_generation++;
+
     len = PyTuple_Size(type->values);
     for (i = 0; i < len; i++) {
         val = PyTuple_GetItem(type->values, i);
@@ -409,6 +722,8 @@ typecast_dealloc(PyObject *obj)
     Py_CLEAR(self->name);
     Py_CLEAR(self->pcast);
     Py_CLEAR(self->bcast);
+    Py_CLEAR(self->atttypes);
+    Py_CLEAR(self->factory);
 
     obj->ob_type->tp_free(obj);
 }
@@ -422,6 +737,8 @@ typecast_traverse(PyObject *obj, visitproc visit, void *arg)
     Py_VISIT(self->name);
     Py_VISIT(self->pcast);
     Py_VISIT(self->bcast);
+    Py_VISIT(self->atttypes);
+    Py_VISIT(self->factory);
     return 0;
 }
 
@@ -449,6 +766,19 @@ typecast_call(PyObject *obj, PyObject *args, PyObject *kwargs)
         return string;
     }
 
+    /* the string is not in a result the cast values can refer to */
+    if (PyObject_TypeCheck(cursor, &cursorType)) {
+        cursorObject *curs = (cursorObject *)cursor;
+        PyObject *owner = curs->cast_owner, *rv;
+
+        curs->cast_owner = Py_None;
+        rv = typecast_cast(obj,
+                           PyString_AsString(string), PyString_Size(string),
+                           cursor);
+        curs->cast_owner = owner;
+        return rv;
+    }
+
     return typecast_cast(obj,
                          PyString_AsString(string), PyString_Size(string),
                          cursor);
@@ -541,6 +871,8 @@ typecast_new(PyObject *name, PyObject *values, PyObject *cast, PyObject *base)
     obj->pcast = NULL;
     obj->ccast = NULL;
     obj->bcast = base;
+    obj->atttypes = NULL;
+    obj->factory = NULL;
 
     if (obj->bcast) Py_INCREF(obj->bcast);
 
@@ -571,9 +903,91 @@ typecast_from_python(PyObject *self, PyObject *args, PyObject *keywds)
         return NULL;
     }
 
+    /* a C typecaster is bound to the new oids without wrapping it */
+    if (cast && PyObject_TypeCheck(cast, &typecastType)
+            && ((typecastObject *)cast)->ccast) {
+        typecastObject *obj;
+
+        if (!base) base = ((typecastObject *)cast)->bcast;
+        if (!(obj = (typecastObject *)typecast_new(name, v, NULL, base))) {
+            return NULL;
+        }
+        obj->ccast = ((typecastObject *)cast)->ccast;
+        Py_XINCREF(((typecastObject *)cast)->atttypes);
+        obj->atttypes = ((typecastObject *)cast)->atttypes;
+        Py_XINCREF(((typecastObject *)cast)->factory);
+        obj->factory = ((typecastObject *)cast)->factory;
+        return (PyObject *)obj;
+    }
+
     return typecast_new(name, v, cast, base);
 }
 
+PyObject *
+typecast_array_from_python(PyObject *self, PyObject *args, PyObject *keywds)
+{
+    PyObject *values, *name = NULL, *base = NULL;
+    typecastObject *obj;
+
+    static char *kwlist[] = {"values", "name", "baseobj", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "O!O!O!", kwlist,
+                                     &PyTuple_Type, &values,
+                                     &PyString_Type, &name,
+                                     &typecastType, &base)) {
+        return NULL;
+    }
+
+    if ((obj = (typecastObject *)typecast_new(name, values, NULL, base))) {
+        obj->ccast = typecast_GENERIC_ARRAY_cast;
+    }
+    return (PyObject *)obj;
+}
+
+PyObject *
+typecast_composite_from_python(
+    PyObject *self, PyObject *args, PyObject *keywds)
+{
+    PyObject *values, *name = NULL, *atttypes, *factory = NULL;
+    typecastObject *obj;
+    Py_ssize_t i;
+
+    static char *kwlist[] = {"values", "name", "atttypes", "factory", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "O!O!O!|O", kwlist,
+                                     &PyTuple_Type, &values,
+                                     &PyString_Type, &name,
+                                     &PyTuple_Type, &atttypes,
+                                     &factory)) {
+        return NULL;
+    }
+
+    /* the oids are used as keys of the typecasters dicts */
+    for (i = 0; i < PyTuple_GET_SIZE(atttypes); i++) {
+        if (!PyInt_Check(PyTuple_GET_ITEM(atttypes, i))) {
+            PyErr_SetString(PyExc_TypeError,
+                "the attributes types must be int oids");
+            return NULL;
+        }
+    }
+    if (factory == Py_None) {
+        factory = NULL;
+    }
+    else if (factory && !PyCallable_Check(factory)) {
+        PyErr_SetString(PyExc_TypeError, "factory must be a callable");
+        return NULL;
+    }
+
+    if ((obj = (typecastObject *)typecast_new(name, values, NULL, NULL))) {
+        obj->ccast = typecast_COMPOSITE_cast;
+        Py_INCREF(atttypes);
+        obj->atttypes = atttypes;
+        Py_XINCREF(factory);
+        obj->factory = factory;
+    }
+    return (PyObject *)obj;
+}
+
 PyObject *
 typecast_from_c(typecastObject_initlist *type, PyObject *dict)
 {
@@ -623,8 +1037,8 @@ typecast_cast(PyObject *obj, const char *str, Py_ssize_t len, PyObject *curs)
     typecastObject *self = (typecastObject *)obj;
 
     Py_INCREF(obj);
-    old = ((cursorObject*)curs)->caster;
-    ((cursorObject*)curs)->caster = obj;
+    old = typecast_current(curs);
+    typecast_set_current(curs, obj);
 
     if (self->ccast) {
         res = self->ccast(str, len, curs);
@@ -636,7 +1050,7 @@ typecast_cast(PyObject *obj, const char *str, Py_ssize_t len, PyObject *curs)
         PyErr_SetString(Error, "internal error: no casting function found");
     }
 
-    ((cursorObject*)curs)->caster = old;
+    typecast_set_current(curs, old);
     Py_DECREF(obj);
 
     return res;
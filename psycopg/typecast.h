@@ -39,6 +39,30 @@ extern "C" {
 typedef PyObject *(*typecast_function)(const char *str, Py_ssize_t len,
                                        PyObject *cursor);
 
+/* a value parsed by a typecaster without using the Python API */
+typedef union {
+    long i;
+    PY_LONG_LONG ll;
+    double d;
+    struct { int y, m, d, hh, mm, ss, us, tz, n; } dt;
+} typecast_value;
+
+/* parse a value: return 0 on success, < 0 to use the casting function */
+typedef int (*typecast_parse_function)(const char *str, Py_ssize_t len,
+                                       typecast_value *v);
+
+/* create the Python object of a parsed value */
+typedef PyObject *(*typecast_build_function)(typecast_value *v,
+                                             PyObject *cursor);
+
+/* a casting function split in a part that can run without the GIL and a
+   part creating the Python object */
+typedef struct {
+    typecast_function cast;
+    typecast_parse_function parse;
+    typecast_build_function build;
+} typecast_nogil;
+
 /** typecast type **/
 
 extern HIDDEN PyTypeObject typecastType;
@@ -52,6 +76,10 @@ typedef struct {
     typecast_function  ccast;  /* the C casting function */
     PyObject          *pcast;  /* the python casting function */
     PyObject          *bcast;  /* base cast, used by array typecasters */
+
+    /* used by the composite typecasters */
+    PyObject *atttypes;  /* the oids of the attributes */
+    PyObject *factory;   /* called with the attributes, NULL for tuples */
 } typecastObject;
 
 /* the initialization values are stored here */
@@ -86,6 +114,21 @@ HIDDEN PyObject *typecast_from_c(typecastObject_initlist *type, PyObject *d);
 HIDDEN PyObject *typecast_from_python(
     PyObject *self, PyObject *args, PyObject *keywds);
 
+/* the python callable creators of array and composite typecasters */
+HIDDEN PyObject *typecast_array_from_python(
+    PyObject *self, PyObject *args, PyObject *keywds);
+HIDDEN PyObject *typecast_composite_from_python(
+    PyObject *self, PyObject *args, PyObject *keywds);
+
+/* return the parse functions of a typecaster, NULL if it has none */
+HIDDEN const typecast_nogil *typecast_get_nogil(PyObject *obj);
+
+/* return 1 if the typecaster returns the values as str or unicode */
+HIDDEN int typecast_is_text(PyObject *obj);
+
+/* the typecaster picked by NATIVENUMERIC for a column */
+HIDDEN PyObject *typecast_numeric_for_column(PyObject *cast, int fmod);
+
 /* the function used to dispatch typecasting calls */
 HIDDEN PyObject *typecast_cast(
     PyObject *self, const char *str, Py_ssize_t len, PyObject *curs);
@@ -85,6 +85,38 @@ typecast_array_tokenize(const char *str, Py_ssize_t strlength,
         return ASCAN_END;
     }
 
+    /* fast path for the tokens without escaped chars, the only ones the
+       backend returns unless there are quotes or backslashes in the data */
+    if (str[*pos] == '"') {
+        for (i = *pos + 1; i < strlength; i++) {
+            if (str[i] == '"' || str[i] == '\\') break;
+        }
+        if (i < strlength && str[i] == '"'
+                && (i + 1 == strlength
+                    || str[i + 1] == ',' || str[i + 1] == '}')) {
+            *token = (char *)&str[*pos + 1];
+            *length = i - *pos - 1;
+            *quotes = 1;
+            *pos = i + 1;
+            if (*pos < strlength && str[*pos] == ',') *pos += 1;
+            return ASCAN_TOKEN;
+        }
+    }
+    else {
+        for (i = *pos; i < strlength; i++) {
+            if (str[i] == ',' || str[i] == '}'
+                    || str[i] == '"' || str[i] == '\\') break;
+        }
+        if (i == strlength || str[i] == ',' || str[i] == '}') {
+            *token = (char *)&str[*pos];
+            *length = i - *pos;
+            *quotes = 0;
+            *pos = i;
+            if (i < strlength && str[i] == ',') *pos += 1;
+            return ASCAN_TOKEN;
+        }
+    }
+
     /* now we start looking for the first unquoted ',' or '}', the only two
        tokens that can limit an array element */
     q = 0; /* if q is odd we're inside quotes */
@@ -164,17 +196,46 @@ typecast_array_tokenize(const char *str, Py_ssize_t strlength,
     return res;
 }
 
+/* the short tokens of the typecasters parsing numbers and dates are copied
+   to be terminated, as the fast paths of their typecasters require */
+#define ARRAY_TOKEN_SIZE 64
+
+/* cast an array item calling the C function of the base typecaster */
+
+static PyObject *
+typecast_array_item(const char *token, Py_ssize_t length, PyObject *curs,
+                    PyObject *base, int copy)
+{
+    typecast_function ccast = ((typecastObject *)base)->ccast;
+    char buffer[ARRAY_TOKEN_SIZE];
+
+    if (ccast == NULL) {
+        return typecast_cast(base, token, length, curs);
+    }
+    if (token && copy && length < ARRAY_TOKEN_SIZE) {
+        memcpy(buffer, token, length);
+        buffer[length] = '\0';
+        token = buffer;
+    }
+    return ccast(token, length, curs);
+}
+
 static int
 typecast_array_scan(const char *str, Py_ssize_t strlength,
                     PyObject *curs, PyObject *base, PyObject *array)
 {
-    int state, quotes = 0;
+    int state, quotes = 0, rv = 1;
     Py_ssize_t length = 0, pos = 0;
     char *token;
+    PyObject *old = typecast_current(curs);
+    int copy = typecast_get_nogil(base) != NULL;
 
     PyObject *stack[MAX_DIMENSIONS];
     size_t stack_index = 0;
 
+    /* the base typecaster is the current one while casting the items */
+    typecast_set_current(curs, base);
+
     while (1) {
         token = NULL;
         state = typecast_array_tokenize(str, strlength,
@@ -190,14 +251,14 @@ typecast_array_scan(const char *str, Py_ssize_t strlength,
                 && (token[2] == 'l' || token[2] == 'L')
                 && (token[3] == 'l' || token[3] == 'L'))
             {
-                obj = typecast_cast(base, NULL, 0, curs);
+                obj = typecast_array_item(NULL, 0, curs, base, copy);
             } else {
-                obj = typecast_cast(base, token, length, curs);
+                obj = typecast_array_item(token, length, curs, base, copy);
             }
 
             /* before anything else we free the memory */
             if (state == ASCAN_QUOTED) PyMem_Free(token);
-            if (obj == NULL) return 0;
+            if (obj == NULL) { rv = 0; break; }
 
             PyList_Append(array, obj);
             Py_DECREF(obj);
@@ -205,25 +266,24 @@ typecast_array_scan(const char *str, Py_ssize_t strlength,
 
         else if (state == ASCAN_BEGIN) {
             PyObject *sub = PyList_New(0);
-            if (sub == NULL) return 0;
+            if (sub == NULL) { rv = 0; break; }
 
             PyList_Append(array, sub);
             Py_DECREF(sub);
 
-            if (stack_index == MAX_DIMENSIONS)
-                return 0;
+            if (stack_index == MAX_DIMENSIONS) { rv = 0; break; }
 
             stack[stack_index++] = array;
             array = sub;
         }
 
         else if (state == ASCAN_ERROR) {
-            return 0;
+            rv = 0;
+            break;
         }
 
         else if (state == ASCAN_END) {
-            if (--stack_index < 0)
-                return 0;
+            if (--stack_index < 0) { rv = 0; break; }
             array = stack[stack_index];
         }
 
@@ -231,7 +291,8 @@ typecast_array_scan(const char *str, Py_ssize_t strlength,
             break;
     }
 
-    return 1;
+    typecast_set_current(curs, old);
+    return rv;
 }
 
 
@@ -242,7 +303,7 @@ static PyObject *
 typecast_GENERIC_ARRAY_cast(const char *str, Py_ssize_t len, PyObject *curs)
 {
     PyObject *obj = NULL;
-    PyObject *base = ((typecastObject*)((cursorObject*)curs)->caster)->bcast;
+    PyObject *base = ((typecastObject*)typecast_current(curs))->bcast;
 
     Dprintf("typecast_GENERIC_ARRAY_cast: str = '%s',"
             " len = " FORMAT_CODE_PY_SSIZE_T, str, len);
@@ -284,3 +345,212 @@ typecast_GENERIC_ARRAY_cast(const char *str, Py_ssize_t len, PyObject *curs)
 #define typecast_INTERVALARRAY_cast typecast_GENERIC_ARRAY_cast
 #define typecast_BINARYARRAY_cast typecast_GENERIC_ARRAY_cast
 #define typecast_ROWIDARRAY_cast typecast_GENERIC_ARRAY_cast
+
+
+/** INTEGERARRAYBUFFER, FLOATARRAYBUFFER - cast one-dimensional arrays of
+    numbers without NULLs into array.array objects, in text or binary format,
+    and the other arrays into lists **/
+
+static PyObject *typecast_array_type = NULL;
+
+/* return a new array.array of the typecode with the items in data */
+
+static PyObject *
+typecast_array_buffer_new(char typecode, PyObject *data)
+{
+    PyObject *m;
+
+    if (typecast_array_type == NULL) {
+        if (!(m = PyImport_ImportModule("array"))) return NULL;
+        typecast_array_type = PyObject_GetAttrString(m, "array");
+        Py_DECREF(m);
+        if (typecast_array_type == NULL) return NULL;
+    }
+    return PyObject_CallFunction(typecast_array_type, "cO", typecode, data);
+}
+
+/* parse a number into the buffer, return -1 if it can't be represented */
+
+static int
+typecast_array_buffer_number(const char *s, Py_ssize_t len, char typecode,
+                             char *out)
+{
+    char buffer[ARRAY_TOKEN_SIZE], *end;
+    PY_LONG_LONG ll;
+    double d;
+
+    if (typecode == 'l') {
+        if (typecast_parse_integer(s, len, &ll) < 0
+                || ll > LONG_MAX || ll < LONG_MIN) {
+            return -1;
+        }
+        *(long *)out = (long)ll;
+        return 0;
+    }
+
+    if (len == 0 || len >= ARRAY_TOKEN_SIZE) return -1;
+    memcpy(buffer, s, len);
+    buffer[len] = '\0';
+    d = PyOS_string_to_double(buffer, &end, NULL);
+    if (end != buffer + len) {
+        PyErr_Clear();
+        return -1;
+    }
+    *(double *)out = d;
+    return 0;
+}
+
+/* return the items of an array in text format, NULL without an exception
+   set if the array can't be represented */
+
+static PyObject *
+typecast_array_buffer_text(const char *s, Py_ssize_t len, char typecode,
+                           Py_ssize_t size)
+{
+    PyObject *data, *rv;
+    Py_ssize_t i, start, n = 1;
+    char *out;
+
+    if (s[0] == '[' && typecast_array_cleanup(&s, &len) < 0) return NULL;
+    if (len < 2 || s[0] != '{' || s[len - 1] != '}') return NULL;
+    s++;
+    len -= 2;
+
+    for (i = 0; i < len; i++) {
+        if (s[i] == ',') n++;
+    }
+    if (len == 0) n = 0;
+
+    if (!(data = PyString_FromStringAndSize(NULL, n * size))) return NULL;
+    out = PyString_AS_STRING(data);
+
+    for (i = 0, start = 0; i <= len; i++) {
+        if (i < len && s[i] != ',') continue;
+        if (n && typecast_array_buffer_number(
+                s + start, i - start, typecode, out) < 0) {
+            Py_DECREF(data);
+            return NULL;
+        }
+        out += size;
+        start = i + 1;
+    }
+
+    rv = typecast_array_buffer_new(typecode, data);
+    Py_DECREF(data);
+    return rv;
+}
+
+/* return the items of an array in binary format, NULL without an exception
+   set if the array can't be represented */
+
+static PyObject *
+typecast_array_buffer_binary(const char *s, Py_ssize_t len, char typecode,
+                             Py_ssize_t size)
+{
+    PyObject *data, *rv;
+    const char *end = s + len;
+    int dims[BIN_ARRAY_MAXDIM], ndim, hasnull, i, itemlen;
+    Oid elemtype;
+    char *out;
+
+    ndim = typecast_binformat_array_header(&s, end, dims, &hasnull,
+                                           &elemtype);
+    if (ndim < 0) {
+        PyErr_Clear();
+        return NULL;
+    }
+    if (ndim > 1 || hasnull) return NULL;
+    if (ndim == 0) dims[0] = 0;
+
+    switch (elemtype) {
+    case INT2OID: itemlen = 2; break;
+    case INT4OID: itemlen = 4; break;
+    case INT8OID: itemlen = 8; break;
+    case FLOAT4OID: itemlen = 4; break;
+    case FLOAT8OID: itemlen = 8; break;
+    default: return NULL;
+    }
+    if ((typecode == 'l') != (elemtype == INT2OID || elemtype == INT4OID
+            || elemtype == INT8OID)) {
+        return NULL;
+    }
+    if (end - s < (Py_ssize_t)dims[0] * (4 + itemlen)) return NULL;
+
+    if (!(data = PyString_FromStringAndSize(NULL, dims[0] * size))) {
+        return NULL;
+    }
+    out = PyString_AS_STRING(data);
+
+    for (i = 0; i < dims[0]; i++, s += 4 + itemlen, out += size) {
+        union { unsigned int i; float f; } v4;
+        union { unsigned PY_LONG_LONG i; double d; } v8;
+        PY_LONG_LONG ll;
+
+        if ((int)typecast_binformat_uint32(s) != itemlen) {
+            Py_DECREF(data);
+            return NULL;
+        }
+        switch (elemtype) {
+        case INT2OID:
+            *(long *)out = (short)typecast_binformat_uint16(s + 4);
+            break;
+        case INT4OID:
+            *(long *)out = (int)typecast_binformat_uint32(s + 4);
+            break;
+        case INT8OID:
+            ll = (PY_LONG_LONG)typecast_binformat_uint64(s + 4);
+            if (ll > LONG_MAX || ll < LONG_MIN) {
+                Py_DECREF(data);
+                return NULL;
+            }
+            *(long *)out = (long)ll;
+            break;
+        case FLOAT4OID:
+            v4.i = (unsigned int)typecast_binformat_uint32(s + 4);
+            *(double *)out = v4.f;
+            break;
+        default:
+            v8.i = typecast_binformat_uint64(s + 4);
+            *(double *)out = v8.d;
+            break;
+        }
+    }
+
+    rv = typecast_array_buffer_new(typecode, data);
+    Py_DECREF(data);
+    return rv;
+}
+
+static PyObject *
+typecast_array_buffer_cast(const char *s, Py_ssize_t len, PyObject *curs,
+                           char typecode, Py_ssize_t size)
+{
+    PyObject *rv;
+
+    if (s == NULL) {Py_INCREF(Py_None); return Py_None;}
+
+    /* a text array can't be mistaken for the number of dimensions */
+    if (len > 0 && (s[0] == '{' || s[0] == '[')) {
+        rv = typecast_array_buffer_text(s, len, typecode, size);
+        if (rv || PyErr_Occurred()) return rv;
+        return typecast_GENERIC_ARRAY_cast(s, len, curs);
+    }
+    else {
+        rv = typecast_array_buffer_binary(s, len, typecode, size);
+        if (rv || PyErr_Occurred()) return rv;
+        return typecast_BIN_ARRAY_cast(s, len, curs);
+    }
+}
+
+static PyObject *
+typecast_INTEGERARRAYBUFFER_cast(const char *s, Py_ssize_t len,
+                                 PyObject *curs)
+{
+    return typecast_array_buffer_cast(s, len, curs, 'l', sizeof(long));
+}
+
+static PyObject *
+typecast_FLOATARRAYBUFFER_cast(const char *s, Py_ssize_t len, PyObject *curs)
+{
+    return typecast_array_buffer_cast(s, len, curs, 'd', sizeof(double));
+}
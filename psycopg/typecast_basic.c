@@ -23,14 +23,42 @@
  * License for more details.
  */
 
+/* parse a decimal integer of up to 18 digits, without the Python API */
+
+static int
+typecast_parse_integer(const char *s, Py_ssize_t len, PY_LONG_LONG *v)
+{
+    const char *end = s + len;
+    PY_LONG_LONG acc = 0;
+    int neg = 0;
+
+    if (s < end && (*s == '-' || *s == '+')) {
+        neg = (*s++ == '-');
+    }
+    if (s >= end || end - s > 18) return -1;
+
+    for (; s < end; s++) {
+        if (*s < '0' || *s > '9') return -1;
+        acc = acc * 10 + (*s - '0');
+    }
+
+    *v = neg ? -acc : acc;
+    return 0;
+}
+
 /** INTEGER - cast normal integers (4 bytes) to python int **/
 
 static PyObject *
 typecast_INTEGER_cast(const char *s, Py_ssize_t len, PyObject *curs)
 {
     char buffer[12];
+    PY_LONG_LONG v;
 
     if (s == NULL) {Py_INCREF(Py_None); return Py_None;}
+    if (typecast_parse_integer(s, len, &v) == 0
+            && v <= LONG_MAX && v >= LONG_MIN) {
+        return PyInt_FromLong((long)v);
+    }
     if (s[len] != '\0') {
         strncpy(buffer, s, (size_t) len); buffer[len] = '\0';
         s = buffer;
@@ -38,14 +66,35 @@ typecast_INTEGER_cast(const char *s, Py_ssize_t len, PyObject *curs)
     return PyInt_FromString((char *)s, NULL, 0);
 }
 
+static int
+typecast_INTEGER_parse(const char *s, Py_ssize_t len, typecast_value *v)
+{
+    PY_LONG_LONG ll;
+
+    if (typecast_parse_integer(s, len, &ll) < 0) return -1;
+    if (ll > LONG_MAX || ll < LONG_MIN) return -1;
+    v->i = (long)ll;
+    return 0;
+}
+
+static PyObject *
+typecast_INTEGER_build(typecast_value *v, PyObject *curs)
+{
+    return PyInt_FromLong(v->i);
+}
+
 /** LONGINTEGER - cast long integers (8 bytes) to python long **/
 
 static PyObject *
 typecast_LONGINTEGER_cast(const char *s, Py_ssize_t len, PyObject *curs)
 {
     char buffer[24];
+    PY_LONG_LONG v;
 
     if (s == NULL) {Py_INCREF(Py_None); return Py_None;}
+    if (typecast_parse_integer(s, len, &v) == 0) {
+        return PyLong_FromLongLong(v);
+    }
     if (s[len] != '\0') {
         strncpy(buffer, s, (size_t) len); buffer[len] = '\0';
         s = buffer;
@@ -53,6 +102,18 @@ typecast_LONGINTEGER_cast(const char *s, Py_ssize_t len, PyObject *curs)
     return PyLong_FromString((char *)s, NULL, 0);
 }
 
+static int
+typecast_LONGINTEGER_parse(const char *s, Py_ssize_t len, typecast_value *v)
+{
+    return typecast_parse_integer(s, len, &v->ll);
+}
+
+static PyObject *
+typecast_LONGINTEGER_build(typecast_value *v, PyObject *curs)
+{
+    return PyLong_FromLongLong(v->ll);
+}
+
 /** FLOAT - cast floating point numbers to python float **/
 
 static PyObject *
@@ -60,14 +121,42 @@ typecast_FLOAT_cast(const char *s, Py_ssize_t len, PyObject *curs)
 {
     PyObject *str = NULL, *flo = NULL;
     char *pend;
+    double d;
 
     if (s == NULL) {Py_INCREF(Py_None); return Py_None;}
+
+    /* parse straight from the result if the value is terminated */
+    if (len > 0 && s[len] == '\0') {
+        d = PyOS_string_to_double(s, &pend, NULL);
+        if (pend == s + len) return PyFloat_FromDouble(d);
+        PyErr_Clear();
+    }
+
     str = PyString_FromStringAndSize(s, len);
     flo = PyFloat_FromString(str, &pend);
     Py_DECREF(str);
     return flo;
 }
 
+/* strtod() is correctly rounded as the Python parser; a locale using a
+   different decimal point makes the parsing fail and the caster is used */
+
+static int
+typecast_FLOAT_parse(const char *s, Py_ssize_t len, typecast_value *v)
+{
+    char *end;
+
+    if (len == 0 || s[len] != '\0') return -1;
+    v->d = strtod(s, &end);
+    return end == s + len ? 0 : -1;
+}
+
+static PyObject *
+typecast_FLOAT_build(typecast_value *v, PyObject *curs)
+{
+    return PyFloat_FromDouble(v->d);
+}
+
 /** STRING - cast strings of any type to python string **/
 
 static PyObject *
@@ -82,21 +171,13 @@ typecast_STRING_cast(const char *s, Py_ssize_t len, PyObject *curs)
 static PyObject *
 typecast_UNICODE_cast(const char *s, Py_ssize_t len, PyObject *curs)
 {
-    PyObject *enc;
-
     if (s == NULL) {Py_INCREF(Py_None); return Py_None;}
 
-    enc = PyDict_GetItemString(psycoEncodings,
-                               ((cursorObject*)curs)->conn->encoding);
-    if (enc) {
-        return PyUnicode_Decode(s, len, PyString_AsString(enc), NULL);
-    }
-    else {
-       PyErr_Format(InterfaceError,
-                    "can't decode into unicode string from %s",
-                    ((cursorObject*)curs)->conn->encoding);
-       return NULL;
+    /* without a connection we don't know the encoding: assume utf8 */
+    if (!typecast_is_cursor(curs)) {
+        return PyUnicode_DecodeUTF8(s, len, NULL);
     }
+    return conn_decode(((cursorObject*)curs)->conn, s, len);
 }
 
 /** BOOLEAN - cast boolean value into right python object **/
@@ -117,34 +198,257 @@ typecast_BOOLEAN_cast(const char *s, Py_ssize_t len, PyObject *curs)
     return res;
 }
 
+static int
+typecast_BOOLEAN_parse(const char *s, Py_ssize_t len, typecast_value *v)
+{
+    v->i = (s[0] == 't');
+    return 0;
+}
+
+static PyObject *
+typecast_BOOLEAN_build(typecast_value *v, PyObject *curs)
+{
+    return PyBool_FromLong(v->i);
+}
+
 /** DECIMAL - cast any kind of number into a Python Decimal object **/
 
+/* the Python decimal module builds its objects parsing the string with a
+   regular expression: if Decimal is that implementation the objects are
+   created setting their slots instead. Other implementations (such as
+   cdecimal) don't have these slots, or may give them another meaning, and
+   are created from the string. typecast_decimal_slots is 1 if the slots of
+   typecast_decimal_type can be set, -1 to use the constructor */
+static PyObject *typecast_decimal_type = NULL;
+static int typecast_decimal_slots = 0;
+static PyObject *typecast_decimal_names[4];
+static PyObject *typecast_decimal_noargs;
+
+static PyObject *typecast_decimal_from_parts(PyObject *decimalType,
+                                             const char *s, Py_ssize_t len);
+
+/* return 1 if the slots of decimalType can be set, -1 if not, 0 on error */
+
+static int
+typecast_decimal_check(PyObject *decimalType)
+{
+    static const char *names[] = {"_sign", "_int", "_exp", "_is_special"};
+    static const char sample[] = "-120.0340";
+    PyObject *slots, *dec = NULL, *str = NULL;
+    int i, rv = 1;
+
+    /* only a Python class can be the pure Python implementation */
+    if (!PyType_Check(decimalType)
+            || !PyType_HasFeature((PyTypeObject *)decimalType,
+                                  Py_TPFLAGS_HEAPTYPE)) {
+        return -1;
+    }
+    if (!(slots = PyObject_GetAttrString(decimalType, "__slots__"))) {
+        PyErr_Clear();
+        return -1;
+    }
+    if (!typecast_decimal_noargs
+            && !(typecast_decimal_noargs = PyTuple_New(0))) {
+        rv = 0; goto exit;
+    }
+    for (i = 0; i < 4; i++) {
+        if (!typecast_decimal_names[i] && !(typecast_decimal_names[i] =
+                PyString_InternFromString(names[i]))) {
+            rv = 0; goto exit;
+        }
+        if (PySequence_Contains(slots, typecast_decimal_names[i]) != 1) {
+            PyErr_Clear();
+            rv = -1; goto exit;
+        }
+    }
+
+    /* make sure the slots mean what we think */
+    if (!(dec = typecast_decimal_from_parts(
+            decimalType, sample, sizeof(sample) - 1))
+            || !(str = PyObject_Str(dec))
+            || !PyString_Check(str)
+            || 0 != strcmp(PyString_AS_STRING(str), sample)) {
+        Dprintf("typecast_decimal_check: can't set the Decimal slots");
+        PyErr_Clear();
+        rv = -1;
+    }
+
+exit:
+    Py_XDECREF(str);
+    Py_XDECREF(dec);
+    Py_DECREF(slots);
+    return rv;
+}
+
+/* build a Decimal from the digits of a number. Return NULL without an
+   exception set if the string is not a plain number (e.g. NaN) */
+
+static PyObject *
+typecast_decimal_from_parts(PyObject *decimalType,
+                            const char *s, Py_ssize_t len)
+{
+    const char *end = s + len, *dot = NULL, *start;
+    Py_ssize_t ndigits, nfrac = 0;
+    PyObject *dec = NULL, *digits = NULL, *sign = NULL, *exp = NULL;
+    char *p;
+    int neg = 0;
+
+    if (s < end && (*s == '-' || *s == '+')) {
+        neg = (*s++ == '-');
+    }
+    for (start = s; s < end; s++) {
+        if (*s == '.' && !dot) dot = s;
+        else if (*s < '0' || *s > '9') return NULL;
+    }
+    ndigits = (end - start) - (dot ? 1 : 0);
+    if (ndigits == 0) return NULL;
+    if (dot) nfrac = end - dot - 1;
+
+    /* the digits are stored without leading zeros, as Decimal does */
+    for (s = start; ndigits > 1 && (*s == '0' || *s == '.'); s++) {
+        if (*s == '0') ndigits--;
+    }
+    if (!(digits = PyString_FromStringAndSize(NULL, ndigits))) goto exit;
+    for (p = PyString_AS_STRING(digits); s < end; s++) {
+        if (*s != '.') *p++ = *s;
+    }
+
+    if (!(sign = PyInt_FromLong(neg))) goto exit;
+    if (!(exp = PyInt_FromSsize_t(-nfrac))) goto exit;
+    if (!(dec = PyBaseObject_Type.tp_new((PyTypeObject *)decimalType,
+            typecast_decimal_noargs, NULL))) goto exit;
+
+    if (PyObject_SetAttr(dec, typecast_decimal_names[0], sign) < 0
+        || PyObject_SetAttr(dec, typecast_decimal_names[1], digits) < 0
+        || PyObject_SetAttr(dec, typecast_decimal_names[2], exp) < 0
+        || PyObject_SetAttr(dec, typecast_decimal_names[3], Py_False) < 0) {
+        Py_CLEAR(dec);
+    }
+
+exit:
+    Py_XDECREF(digits);
+    Py_XDECREF(sign);
+    Py_XDECREF(exp);
+    return dec;
+}
+
 static PyObject *
 typecast_DECIMAL_cast(const char *s, Py_ssize_t len, PyObject *curs)
 {
     PyObject *res = NULL;
     PyObject *decimalType;
-    char *buffer;
+    PyObject *str;
 
     if (s == NULL) {Py_INCREF(Py_None); return Py_None;}
 
-    if ((buffer = PyMem_Malloc(len+1)) == NULL)
-        return PyErr_NoMemory();
-    strncpy(buffer, s, (size_t) len); buffer[len] = '\0';
     decimalType = psyco_GetDecimalType();
     /* Fall back on float if decimal is not available */
-    if (decimalType != NULL) {
-        res = PyObject_CallFunction(decimalType, "s", buffer);
-        Py_DECREF(decimalType);
+    if (decimalType == NULL) {
+        if (!(str = PyString_FromStringAndSize(s, len))) return NULL;
+        res = PyFloat_FromString(str, NULL);
+        Py_DECREF(str);
+        return res;
+    }
+
+    /* the type may change, e.g. in a different interpreter */
+    if (decimalType != typecast_decimal_type) {
+        if (!(typecast_decimal_slots = typecast_decimal_check(decimalType))) {
+            goto exit;
+        }
+        Py_INCREF(decimalType);
+        Py_XDECREF(typecast_decimal_type);
+        typecast_decimal_type = decimalType;
     }
-    else {
-        res = PyObject_CallFunction((PyObject*)&PyFloat_Type, "s", buffer);
+    if (typecast_decimal_slots > 0) {
+        res = typecast_decimal_from_parts(decimalType, s, len);
     }
-    PyMem_Free(buffer);
 
+    if (res == NULL && !PyErr_Occurred()) {
+        if (!(str = PyString_FromStringAndSize(s, len))) goto exit;
+        res = PyObject_CallFunctionObjArgs(decimalType, str, NULL);
+        Py_DECREF(str);
+    }
+
+exit:
+    Py_DECREF(decimalType);
     return res;
 }
 
+/** NATIVENUMERIC - cast numeric into int, fixed point int or float **/
+
+/* the columns are decoded by the typecasters returned by
+   typecast_numeric_for_column(): without a typmod the values are floats */
+
+static PyObject *
+typecast_NATIVENUMERIC_cast(const char *s, Py_ssize_t len, PyObject *curs)
+{
+    return typecast_FLOAT_cast(s, len, curs);
+}
+
+/* the digits of a number with the decimal point removed, so a numeric(p,s)
+   value is returned multiplied by 10**s. Up to 18 digits fit a long long */
+
+static int
+typecast_NUMERICFIXED_parse(const char *s, Py_ssize_t len, typecast_value *v)
+{
+    const char *end = s + len;
+    PY_LONG_LONG acc = 0;
+    int neg = 0, ndigits = 0;
+
+    if (s < end && (*s == '-' || *s == '+')) {
+        neg = (*s++ == '-');
+    }
+    for (; s < end; s++) {
+        if (*s == '.') continue;
+        if (*s < '0' || *s > '9' || ++ndigits > 18) return -1;
+        acc = acc * 10 + (*s - '0');
+    }
+    if (ndigits == 0) return -1;
+
+    v->ll = neg ? -acc : acc;
+    return 0;
+}
+
+static PyObject *
+typecast_NUMERICFIXED_build(typecast_value *v, PyObject *curs)
+{
+    if (v->ll > LONG_MAX || v->ll < LONG_MIN)
+        return PyLong_FromLongLong(v->ll);
+    return PyInt_FromLong((long)v->ll);
+}
+
+static PyObject *
+typecast_NUMERICFIXED_cast(const char *s, Py_ssize_t len, PyObject *curs)
+{
+    typecast_value v;
+
+    if (s == NULL) {Py_INCREF(Py_None); return Py_None;}
+    if (typecast_NUMERICFIXED_parse(s, len, &v) < 0) {
+        PyErr_Format(DataError, "can't convert numeric '%.*s' to fixed point",
+            (int)(len > 40 ? 40 : len), s);
+        return NULL;
+    }
+    return typecast_NUMERICFIXED_build(&v, curs);
+}
+
+static PyObject *
+typecast_NUMERICINT_cast(const char *s, Py_ssize_t len, PyObject *curs)
+{
+    if (s == NULL) {Py_INCREF(Py_None); return Py_None;}
+    if (len == 3 && strncmp(s, "NaN", 3) == 0) {
+        PyErr_SetString(DataError, "can't convert numeric NaN to int");
+        return NULL;
+    }
+    if (s[len] != '\0') {
+        PyObject *str, *res;
+        if (!(str = PyString_FromStringAndSize(s, len))) return NULL;
+        res = PyNumber_Int(str);
+        Py_DECREF(str);
+        return res;
+    }
+    return PyInt_FromString((char *)s, NULL, 10);
+}
+
 /* some needed aliases */
 #define typecast_NUMBER_cast   typecast_FLOAT_cast
 #define typecast_ROWID_cast    typecast_INTEGER_cast
@@ -44,6 +44,8 @@ typedef struct {
 
     void *base;     /* Pointer to the memory chunk. */
     Py_ssize_t len;        /* Size in bytes of the memory chunk. */
+    PyObject *owner;       /* The object owning the memory, NULL if the
+                              chunk owns it. */
 
 } chunkObject;
 
@@ -0,0 +1,592 @@
+/* typecast_binformat.c - decode results received in binary format
+ *
+ * Copyright (C) 2001-2010 Federico Di Gregorio <fog@debian.org>
+ *
+ * This file is part of psycopg.
+ *
+ * psycopg2 is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link this program with the OpenSSL library (or with
+ * modified versions of OpenSSL that use the same license as OpenSSL),
+ * and distribute linked combinations including the two.
+ *
+ * You must obey the GNU Lesser General Public License in all respects for
+ * all of the code used other than OpenSSL.
+ *
+ * psycopg2 is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ */
+
+/* The binary representation of the values is the one of the PostgreSQL
+ * send/recv functions: integers are in network byte order, dates and
+ * timestamps are offsets from 2000-01-01 (assuming integer datetimes, the
+ * default since PostgreSQL 8.4). The decoders below are only registered in
+ * the binary types dictionary and are used when a cursor asks for binary
+ * results. */
+
+#ifdef _MSC_VER
+#define PY_LONG_LONG_CONST(x) x##i64
+#else
+#define PY_LONG_LONG_CONST(x) x##LL
+#endif
+
+#define POSTGRES_EPOCH_JDATE 2451545    /* julian day of 2000-01-01 */
+#define USECS_PER_DAY PY_LONG_LONG_CONST(86400000000)
+
+/* read unsigned big endian integers from the network buffer */
+
+static unsigned int
+typecast_binformat_uint16(const char *s)
+{
+    const unsigned char *u = (const unsigned char *)s;
+    return ((unsigned int)u[0] << 8) | u[1];
+}
+
+static unsigned long
+typecast_binformat_uint32(const char *s)
+{
+    const unsigned char *u = (const unsigned char *)s;
+    return ((unsigned long)u[0] << 24) | ((unsigned long)u[1] << 16)
+        | ((unsigned long)u[2] << 8) | u[3];
+}
+
+static unsigned PY_LONG_LONG
+typecast_binformat_uint64(const char *s)
+{
+    return ((unsigned PY_LONG_LONG)typecast_binformat_uint32(s) << 32)
+        | typecast_binformat_uint32(s + 4);
+}
+
+static int
+typecast_binformat_check(Py_ssize_t len, Py_ssize_t size, const char *type)
+{
+    if (len != size) {
+        PyErr_Format(DataError, "bad binary %s value: "
+            FORMAT_CODE_PY_SSIZE_T " bytes", type, len);
+        return -1;
+    }
+    return 0;
+}
+
+/* convert a julian day into a date (algorithm from PostgreSQL j2date()) */
+
+static void
+typecast_binformat_j2date(long jd, int *year, int *month, int *day)
+{
+    unsigned long julian, quad, extra;
+    long y;
+
+    julian = jd;
+    julian += 32044;
+    quad = julian / 146097;
+    extra = (julian - quad * 146097) * 4 + 3;
+    julian += 60 + quad * 3 + extra / 146097;
+    quad = julian / 1461;
+    julian -= quad * 1461;
+    y = julian * 4 / 1461;
+    julian = ((y != 0) ? ((julian + 305) % 365) : ((julian + 306) % 366))
+        + 123;
+    y += quad * 4;
+    *year = y - 4800;
+    quad = julian * 2141 / 65536;
+    *day = julian - 7834 * quad / 256;
+    *month = (quad + 10) % 12 + 1;
+}
+
+/** INT2, INT4, INT8, OID - cast network integers to python int or long **/
+
+static PyObject *
+typecast_BIN_INT2_cast(const char *s, Py_ssize_t len, PyObject *curs)
+{
+    if (s == NULL) {Py_INCREF(Py_None); return Py_None;}
+    if (typecast_binformat_check(len, 2, "int2")) return NULL;
+    return PyInt_FromLong((short)typecast_binformat_uint16(s));
+}
+
+static PyObject *
+typecast_BIN_INT4_cast(const char *s, Py_ssize_t len, PyObject *curs)
+{
+    if (s == NULL) {Py_INCREF(Py_None); return Py_None;}
+    if (typecast_binformat_check(len, 4, "int4")) return NULL;
+    return PyInt_FromLong((int)typecast_binformat_uint32(s));
+}
+
+static PyObject *
+typecast_BIN_INT8_cast(const char *s, Py_ssize_t len, PyObject *curs)
+{
+    if (s == NULL) {Py_INCREF(Py_None); return Py_None;}
+    if (typecast_binformat_check(len, 8, "int8")) return NULL;
+    return PyLong_FromLongLong((PY_LONG_LONG)typecast_binformat_uint64(s));
+}
+
+static PyObject *
+typecast_BIN_OID_cast(const char *s, Py_ssize_t len, PyObject *curs)
+{
+    unsigned long oid;
+
+    if (s == NULL) {Py_INCREF(Py_None); return Py_None;}
+    if (typecast_binformat_check(len, 4, "oid")) return NULL;
+    oid = typecast_binformat_uint32(s);
+    if (oid > (unsigned long)LONG_MAX)
+        return PyLong_FromUnsignedLong(oid);
+    return PyInt_FromLong((long)oid);
+}
+
+/** FLOAT4, FLOAT8 - cast IEEE floats to python float **/
+
+static PyObject *
+typecast_BIN_FLOAT4_cast(const char *s, Py_ssize_t len, PyObject *curs)
+{
+    union { unsigned int i; float f; } v;
+
+    if (s == NULL) {Py_INCREF(Py_None); return Py_None;}
+    if (typecast_binformat_check(len, 4, "float4")) return NULL;
+    v.i = (unsigned int)typecast_binformat_uint32(s);
+    return PyFloat_FromDouble(v.f);
+}
+
+static PyObject *
+typecast_BIN_FLOAT8_cast(const char *s, Py_ssize_t len, PyObject *curs)
+{
+    union { unsigned PY_LONG_LONG i; double d; } v;
+
+    if (s == NULL) {Py_INCREF(Py_None); return Py_None;}
+    if (typecast_binformat_check(len, 8, "float8")) return NULL;
+    v.i = typecast_binformat_uint64(s);
+    return PyFloat_FromDouble(v.d);
+}
+
+/** BOOLEAN - cast a single byte into a python bool **/
+
+static PyObject *
+typecast_BIN_BOOLEAN_cast(const char *s, Py_ssize_t len, PyObject *curs)
+{
+    PyObject *res;
+
+    if (s == NULL) {Py_INCREF(Py_None); return Py_None;}
+    if (typecast_binformat_check(len, 1, "boolean")) return NULL;
+
+    res = s[0] ? Py_True : Py_False;
+    Py_INCREF(res);
+    return res;
+}
+
+/** BYTEA - cast raw data into a python buffer, as the text caster does **/
+
+/* The raw data of large values are not copied: the buffer points into the
+   query result, kept alive by the chunk. This only happens if the caller
+   set the cursor cast_owner to the owner of the result: other values are
+   copied, as are the small ones, which would otherwise keep a whole result
+   alive for a few bytes. */
+
+#define BIN_BINARY_SHARE_MIN 1024
+
+static PyObject *
+typecast_BIN_BINARY_cast(const char *s, Py_ssize_t len, PyObject *curs)
+{
+    PyObject *str, *res;
+#ifdef PSYCOPG_EXTENSIONS
+    PyObject *owner = NULL;
+    chunkObject *chunk;
+#endif
+
+    if (s == NULL) {Py_INCREF(Py_None); return Py_None;}
+
+#ifdef PSYCOPG_EXTENSIONS
+    if (len >= BIN_BINARY_SHARE_MIN
+            && curs && PyObject_TypeCheck(curs, &cursorType)) {
+        owner = ((cursorObject *)curs)->cast_owner;
+    }
+    if (owner && owner != Py_None) {
+        if (!(chunk = PyObject_New(chunkObject, &chunkType))) return NULL;
+        chunk->base = (void *)s;
+        chunk->len = len;
+        Py_INCREF(owner);
+        chunk->owner = owner;
+        res = PyBuffer_FromObject((PyObject *)chunk, 0, len);
+        Py_DECREF((PyObject *)chunk);
+        return res;
+    }
+#endif
+
+    if (!(str = PyString_FromStringAndSize(s, len))) return NULL;
+    res = PyBuffer_FromObject(str, 0, len);
+    Py_DECREF(str);
+    return res;
+}
+
+/** DATE - cast days from 2000-01-01 into a python date **/
+
+static PyObject *
+typecast_BIN_DATE_cast(const char *s, Py_ssize_t len, PyObject *curs)
+{
+    long days;
+    int y, m, d;
+
+    if (s == NULL) {Py_INCREF(Py_None); return Py_None;}
+    if (typecast_binformat_check(len, 4, "date")) return NULL;
+
+    days = (int)typecast_binformat_uint32(s);
+
+    /* infinity is represented by the extreme values */
+    if (days == INT_MAX || days == INT_MIN) {
+        return PyObject_GetAttrString(
+            (PyObject*)PyDateTimeAPI->DateType,
+            days == INT_MIN ? "min" : "max");
+    }
+
+    typecast_binformat_j2date(days + POSTGRES_EPOCH_JDATE, &y, &m, &d);
+    if (y < 1) {
+        PyErr_SetString(DataError, "date out of range");
+        return NULL;
+    }
+    if (y > 9999) {
+        return PyObject_GetAttrString(
+            (PyObject*)PyDateTimeAPI->DateType, "max");
+    }
+    return PyObject_CallFunction(
+        (PyObject*)PyDateTimeAPI->DateType, "iii", y, m, d);
+}
+
+/** TIMESTAMP, TIMESTAMPTZ - cast usecs from 2000-01-01 into a datetime **/
+
+static PyObject *
+typecast_binformat_datetime(const char *s, Py_ssize_t len, PyObject *tzinfo)
+{
+    PY_LONG_LONG ts, days, usecs;
+    int y, m, d;
+
+    if (typecast_binformat_check(len, 8, "timestamp")) return NULL;
+
+    ts = (PY_LONG_LONG)typecast_binformat_uint64(s);
+
+    /* infinity is represented by the extreme values */
+    if (ts == PY_LLONG_MAX || ts == PY_LLONG_MIN) {
+        return PyObject_GetAttrString(
+            (PyObject*)PyDateTimeAPI->DateTimeType,
+            ts == PY_LLONG_MIN ? "min" : "max");
+    }
+
+    days = ts / USECS_PER_DAY;
+    usecs = ts % USECS_PER_DAY;
+    if (usecs < 0) {
+        usecs += USECS_PER_DAY;
+        days -= 1;
+    }
+
+    typecast_binformat_j2date((long)(days + POSTGRES_EPOCH_JDATE),
+                              &y, &m, &d);
+    if (y < 1) {
+        PyErr_SetString(DataError, "timestamp out of range");
+        return NULL;
+    }
+    if (y > 9999) {
+        return PyObject_GetAttrString(
+            (PyObject*)PyDateTimeAPI->DateTimeType, "max");
+    }
+
+    return PyObject_CallFunction(
+        (PyObject*)PyDateTimeAPI->DateTimeType, "iiiiiiiO",
+        y, m, d,
+        (int)(usecs / PY_LONG_LONG_CONST(3600000000)),
+        (int)(usecs / 60000000 % 60),
+        (int)(usecs / 1000000 % 60),
+        (int)(usecs % 1000000),
+        tzinfo);
+}
+
+static PyObject *
+typecast_BIN_TIMESTAMP_cast(const char *s, Py_ssize_t len, PyObject *curs)
+{
+    if (s == NULL) {Py_INCREF(Py_None); return Py_None;}
+    return typecast_binformat_datetime(s, len, Py_None);
+}
+
+/* timestamptz are always received in UTC */
+
+static PyObject *
+typecast_BIN_TIMESTAMPTZ_cast(const char *s, Py_ssize_t len, PyObject *curs)
+{
+    PyObject *tzinfo, *tzinfo_factory, *res;
+
+    if (s == NULL) {Py_INCREF(Py_None); return Py_None;}
+
+    tzinfo_factory = typecast_tzinfo_factory(curs);
+    if (tzinfo_factory != Py_None) {
+        if (!(tzinfo = curs_tzinfo((cursorObject *)curs, 0))) {
+            return NULL;
+        }
+    }
+    else {
+        Py_INCREF(Py_None);
+        tzinfo = Py_None;
+    }
+
+    res = typecast_binformat_datetime(s, len, tzinfo);
+    Py_DECREF(tzinfo);
+    return res;
+}
+
+/** UUID - cast 16 bytes into the usual string representation **/
+
+static PyObject *
+typecast_BIN_UUID_cast(const char *s, Py_ssize_t len, PyObject *curs)
+{
+    static const char hex[] = "0123456789abcdef";
+    const unsigned char *u = (const unsigned char *)s;
+    char buffer[36], *c = buffer;
+    int i;
+
+    if (s == NULL) {Py_INCREF(Py_None); return Py_None;}
+    if (typecast_binformat_check(len, 16, "uuid")) return NULL;
+
+    for (i = 0; i < 16; i++) {
+        if (i == 4 || i == 6 || i == 8 || i == 10) *c++ = '-';
+        *c++ = hex[u[i] >> 4];
+        *c++ = hex[u[i] & 0x0F];
+    }
+    return PyString_FromStringAndSize(buffer, 36);
+}
+
+/** DECIMAL - rebuild the text of a numeric and cast it as the text caster **/
+
+#define NUMERIC_POS     0x0000
+#define NUMERIC_NEG     0x4000
+#define NUMERIC_NAN     0xC000
+#define NUMERIC_PINF    0xD000
+#define NUMERIC_NINF    0xF000
+
+static PyObject *
+typecast_BIN_DECIMAL_cast(const char *s, Py_ssize_t len, PyObject *curs)
+{
+    int ndigits, weight, dscale, d, i, dig;
+    unsigned int sign;
+    char *buffer, *c, *end;
+    PyObject *res;
+
+    if (s == NULL) {Py_INCREF(Py_None); return Py_None;}
+    if (len < 8) {
+        return PyErr_Format(DataError, "bad binary numeric value");
+    }
+
+    ndigits = typecast_binformat_uint16(s);
+    weight = (short)typecast_binformat_uint16(s + 2);
+    sign = typecast_binformat_uint16(s + 4);
+    dscale = typecast_binformat_uint16(s + 6);
+
+    if (len != 8 + ndigits * 2) {
+        return PyErr_Format(DataError, "bad binary numeric value");
+    }
+
+    switch (sign) {
+    case NUMERIC_NAN:
+        return typecast_DECIMAL_cast("NaN", 3, curs);
+    case NUMERIC_PINF:
+        return typecast_DECIMAL_cast("Infinity", 8, curs);
+    case NUMERIC_NINF:
+        return typecast_DECIMAL_cast("-Infinity", 9, curs);
+    case NUMERIC_POS:
+    case NUMERIC_NEG:
+        break;
+    default:
+        return PyErr_Format(DataError, "bad binary numeric sign");
+    }
+
+    /* sign, integer digits, point and fractional digits (4 per group) */
+    if (!(buffer = PyMem_Malloc(
+            1 + (weight > 0 ? weight + 1 : 1) * 4 + 1 + dscale + 4))) {
+        return PyErr_NoMemory();
+    }
+    c = buffer;
+    if (sign == NUMERIC_NEG) *c++ = '-';
+
+    if (weight < 0) {
+        *c++ = '0';
+    }
+    else {
+        for (d = 0; d <= weight; d++) {
+            dig = d < ndigits ? typecast_binformat_uint16(s + 8 + d * 2) : 0;
+            /* no leading zeros in the first group */
+            for (i = 1000; i > 0; i /= 10) {
+                if (d > 0 || dig >= i || i == 1) {
+                    *c++ = '0' + (dig / i) % 10;
+                }
+            }
+        }
+    }
+
+    if (dscale > 0) {
+        *c++ = '.';
+        end = c + dscale;
+        for (d = weight + 1; c < end; d++) {
+            dig = (d >= 0 && d < ndigits) ?
+                typecast_binformat_uint16(s + 8 + d * 2) : 0;
+            for (i = 1000; i > 0; i /= 10) {
+                *c++ = '0' + (dig / i) % 10;
+            }
+        }
+        c = end;
+    }
+    *c = '\0';
+
+    res = typecast_DECIMAL_cast(buffer, c - buffer, curs);
+    PyMem_Free(buffer);
+    return res;
+}
+
+/** ARRAY - cast an array into nested python lists, as the text caster does **/
+
+#define BIN_ARRAY_MAXDIM 6      /* MAXDIM in PostgreSQL */
+
+/* parse the header of an array, moving s to the first item
+
+   return the number of dimensions, setting their size in dims, and the type
+   of the items; -1 with an exception set on error */
+
+static int
+typecast_binformat_array_header(const char **s, const char *end, int *dims,
+                                int *hasnull, Oid *elemtype)
+{
+    int ndim, i;
+
+    if (end - *s < 12) goto bad;
+    ndim = (int)typecast_binformat_uint32(*s);
+    *hasnull = (int)(typecast_binformat_uint32(*s + 4) & 1);
+    *elemtype = (Oid)typecast_binformat_uint32(*s + 8);
+    if (ndim < 0 || ndim > BIN_ARRAY_MAXDIM || end - *s < 12 + 8 * ndim) {
+        goto bad;
+    }
+
+    /* the lower bounds are ignored, as the [...]= prefix of the text */
+    for (i = 0; i < ndim; i++) {
+        dims[i] = (int)typecast_binformat_uint32(*s + 12 + 8 * i);
+        if (dims[i] < 0) goto bad;
+    }
+    *s += 12 + 8 * ndim;
+    return ndim;
+
+bad:
+    PyErr_SetString(DataError, "bad binary array value");
+    return -1;
+}
+
+/* return the list of the items of a dimension of the array */
+
+static PyObject *
+typecast_binformat_array_items(const char **s, const char *end,
+                               const int *dims, int ndim,
+                               PyObject *cast, PyObject *curs)
+{
+    PyObject *list, *item;
+    int i, len;
+
+    if (!(list = PyList_New(dims[0]))) return NULL;
+
+    for (i = 0; i < dims[0]; i++) {
+        if (ndim > 1) {
+            item = typecast_binformat_array_items(
+                s, end, dims + 1, ndim - 1, cast, curs);
+        }
+        else {
+            if (end - *s < 4) goto bad;
+            len = (int)typecast_binformat_uint32(*s);
+            *s += 4;
+            if (len == -1) {
+                item = typecast_cast(cast, NULL, 0, curs);
+            }
+            else {
+                if (len < 0 || end - *s < len) goto bad;
+                item = typecast_cast(cast, *s, len, curs);
+                *s += len;
+            }
+        }
+        if (item == NULL) {
+            Py_DECREF(list);
+            return NULL;
+        }
+        PyList_SET_ITEM(list, i, item);
+    }
+
+    return list;
+
+bad:
+    Py_DECREF(list);
+    PyErr_SetString(DataError, "bad binary array value");
+    return NULL;
+}
+
+/* the items are cast by the typecaster the cursor would use for a column
+   of their type, in binary format */
+
+static PyObject *
+typecast_BIN_ARRAY_cast(const char *s, Py_ssize_t len, PyObject *curs)
+{
+    const char *end = s + len;
+    int dims[BIN_ARRAY_MAXDIM], ndim, hasnull;
+    Oid elemtype;
+    PyObject *type, *cast;
+
+    if (s == NULL) {Py_INCREF(Py_None); return Py_None;}
+
+    if (!PyObject_TypeCheck(curs, &cursorType)) {
+        PyErr_SetString(InterfaceError,
+            "binary arrays can only be cast by a cursor");
+        return NULL;
+    }
+
+    ndim = typecast_binformat_array_header(&s, end, dims, &hasnull,
+                                           &elemtype);
+    if (ndim < 0) return NULL;
+    if (ndim == 0) return PyList_New(0);
+
+    if (!(type = PyInt_FromLong((long)elemtype))) return NULL;
+    cast = pq_lookup_cast((cursorObject *)curs, type, elemtype, 1);
+    Py_DECREF(type);
+    if (cast == NULL) cast = psyco_default_cast;
+
+    return typecast_binformat_array_items(&s, end, dims, ndim, cast, curs);
+}
+
+
+static long int typecast_BIN_INT2_types[] = {21, 0};
+static long int typecast_BIN_INT4_types[] = {23, 0};
+static long int typecast_BIN_INT8_types[] = {20, 0};
+static long int typecast_BIN_OID_types[] = {26, 0};
+static long int typecast_BIN_FLOAT4_types[] = {700, 0};
+static long int typecast_BIN_FLOAT8_types[] = {701, 0};
+static long int typecast_BIN_BOOLEAN_types[] = {16, 0};
+static long int typecast_BIN_BINARY_types[] = {17, 0};
+static long int typecast_BIN_DATE_types[] = {1082, 0};
+static long int typecast_BIN_TIMESTAMP_types[] = {1114, 0};
+static long int typecast_BIN_TIMESTAMPTZ_types[] = {1184, 0};
+static long int typecast_BIN_UUID_types[] = {2950, 0};
+static long int typecast_BIN_DECIMAL_types[] = {1700, 0};
+static long int typecast_BIN_ARRAY_types[] = {1000, 1001, 1002, 1003, 1005,
+    1007, 1009, 1014, 1015, 1016, 1021, 1022, 1028, 1115, 1182, 1185, 1231,
+    2951, 0};
+
+static typecastObject_initlist typecast_binformat[] = {
+    {"BINARY_INT2", typecast_BIN_INT2_types, typecast_BIN_INT2_cast},
+    {"BINARY_INT4", typecast_BIN_INT4_types, typecast_BIN_INT4_cast},
+    {"BINARY_INT8", typecast_BIN_INT8_types, typecast_BIN_INT8_cast},
+    {"BINARY_OID", typecast_BIN_OID_types, typecast_BIN_OID_cast},
+    {"BINARY_FLOAT4", typecast_BIN_FLOAT4_types, typecast_BIN_FLOAT4_cast},
+    {"BINARY_FLOAT8", typecast_BIN_FLOAT8_types, typecast_BIN_FLOAT8_cast},
+    {"BINARY_BOOLEAN", typecast_BIN_BOOLEAN_types, typecast_BIN_BOOLEAN_cast},
+    {"BINARY_BINARY", typecast_BIN_BINARY_types, typecast_BIN_BINARY_cast},
+    {"BINARY_DATE", typecast_BIN_DATE_types, typecast_BIN_DATE_cast},
+    {"BINARY_TIMESTAMP", typecast_BIN_TIMESTAMP_types,
+        typecast_BIN_TIMESTAMP_cast},
+    {"BINARY_TIMESTAMPTZ", typecast_BIN_TIMESTAMPTZ_types,
+        typecast_BIN_TIMESTAMPTZ_cast},
+    {"BINARY_UUID", typecast_BIN_UUID_types, typecast_BIN_UUID_cast},
+    {"BINARY_DECIMAL", typecast_BIN_DECIMAL_types, typecast_BIN_DECIMAL_cast},
+    {"BINARY_ARRAY", typecast_BIN_ARRAY_types, typecast_BIN_ARRAY_cast},
+    {NULL, NULL, NULL}
+};
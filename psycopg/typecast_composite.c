@@ -0,0 +1,171 @@
+/* typecast_composite.c - composite types typecaster
+ *
+ * Copyright (C) 2010 Federico Di Gregorio <fog@debian.org>
+ *
+ * This file is part of psycopg.
+ *
+ * psycopg2 is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link this program with the OpenSSL library (or with
+ * modified versions of OpenSSL that use the same license as OpenSSL),
+ * and distribute linked combinations including the two.
+ *
+ * You must obey the GNU Lesser General Public License in all respects for
+ * all of the code used other than OpenSSL.
+ *
+ * psycopg2 is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ */
+
+/* The attributes oids of the composite are read from the catalog once, by
+ * extras.register_composite(), and stored in the typecaster. The row
+ * literal returned by record_out(), such as:
+ *
+ *     (1,,"a ""b"" \\c")
+ *
+ * is split into its fields, which are cast by the typecasters the cursor
+ * would use for columns of the attributes types. An empty unquoted field is
+ * a NULL. */
+
+/* return the typecaster of an attribute type (borrowed reference) */
+
+static PyObject *
+typecast_composite_lookup(PyObject *curs, PyObject *type)
+{
+    PyObject *cast;
+
+    if (typecast_is_cursor(curs)) {
+        cast = pq_lookup_cast((cursorObject *)curs, type,
+                              (Oid)PyInt_AS_LONG(type), 0);
+    }
+    else {
+        cast = PyDict_GetItem(psyco_types, type);
+    }
+    return cast ? cast : psyco_default_cast;
+}
+
+/* copy the next field of the literal into buf, unquoting it
+
+   move *p after the field. Return 1 if the field is NULL, 0 if it is a
+   value, -1 if it is not well formed. */
+
+static int
+typecast_composite_field(const char **p, const char *end, char *buf,
+                         Py_ssize_t *length)
+{
+    const char *s = *p;
+    char *to = buf;
+    int inquotes = 0;
+
+    if (s == end || *s == ',') {
+        *length = 0;
+        return 1;
+    }
+
+    while (s < end && (inquotes || *s != ',')) {
+        if (*s == '"') {
+            /* a doubled quote in a quoted string is a quote */
+            if (inquotes && s + 1 < end && s[1] == '"') {
+                s++;
+            }
+            else {
+                inquotes = !inquotes;
+                s++;
+                continue;
+            }
+        }
+        else if (*s == '\\') {
+            if (++s == end) return -1;
+        }
+        *to++ = *s++;
+    }
+    if (inquotes) return -1;
+
+    *to = '\0';
+    *length = to - buf;
+    *p = s;
+    return 0;
+}
+
+static PyObject *
+typecast_COMPOSITE_cast(const char *str, Py_ssize_t len, PyObject *curs)
+{
+    typecastObject *self = (typecastObject *)typecast_current(curs);
+    const char *p, *end;
+    char *buf = NULL, *to;
+    PyObject *values = NULL, *item, *rv = NULL;
+    Py_ssize_t i, n, length;
+    int null;
+
+    if (str == NULL) {Py_INCREF(Py_None); return Py_None;}
+
+    if (!self->atttypes) {
+        PyErr_SetString(InterfaceError,
+            "the typecaster has no composite attributes");
+        return NULL;
+    }
+    if (len < 2 || str[0] != '(' || str[len - 1] != ')') {
+        PyErr_SetString(DataError, "bad composite value: "
+            "it must be enclosed in parenthesis");
+        return NULL;
+    }
+
+    /* the unquoted fields and their terminators fit in the literal */
+    if (!(buf = PyMem_Malloc(len))) {
+        PyErr_NoMemory();
+        return NULL;
+    }
+
+    n = PyTuple_GET_SIZE(self->atttypes);
+    if (!(values = PyTuple_New(n))) goto exit;
+
+    p = str + 1;
+    end = str + len - 1;
+    to = buf;
+    for (i = 0; i < n; i++) {
+        if (i > 0) {
+            if (p == end) goto bad_count;
+            p++; /* the comma */
+        }
+        if (0 > (null = typecast_composite_field(&p, end, to, &length))) {
+            PyErr_Format(DataError, "bad composite value: "
+                "error parsing the field " FORMAT_CODE_PY_SSIZE_T, i);
+            goto exit;
+        }
+
+        item = typecast_cast(
+            typecast_composite_lookup(curs,
+                PyTuple_GET_ITEM(self->atttypes, i)),
+            null ? NULL : to, length, curs);
+        if (!item) goto exit;
+        PyTuple_SET_ITEM(values, i, item);
+
+        to += length + 1;
+    }
+    if (p != end) goto bad_count;
+
+    if (self->factory) {
+        rv = PyObject_CallObject(self->factory, values);
+    }
+    else {
+        rv = values;
+        values = NULL;
+    }
+    goto exit;
+
+bad_count:
+    PyErr_Format(DataError, "bad composite value: expecting "
+        FORMAT_CODE_PY_SSIZE_T " fields for the type %s",
+        n, PyString_AsString(self->name));
+
+exit:
+    Py_XDECREF(values);
+    PyMem_Free(buf);
+    return rv;
+}
@@ -42,11 +42,40 @@ psyco_typecast_datetime_init(void)
 
 /** DATE - cast a date into a date python object **/
 
+/* parse a date, without the Python API: infinity is not handled */
+
+static int
+typecast_PYDATE_parse(const char *str, Py_ssize_t len, typecast_value *v)
+{
+    int n;
+
+    if (!strcmp(str, "infinity") || !strcmp(str, "-infinity")) return -1;
+    if (typecast_parse_iso(str, len, v) >= 0) return 0;
+
+    v->dt.y = v->dt.m = v->dt.d = 0;
+    n = typecast_parse_date(str, NULL, &len, &v->dt.y, &v->dt.m, &v->dt.d);
+    Dprintf("typecast_PYDATE_parse: "
+            "n = %d, len = " FORMAT_CODE_PY_SSIZE_T ", "
+            "y = %d, m = %d, d = %d",
+             n, len, v->dt.y, v->dt.m, v->dt.d);
+    return n == 3 ? 0 : -1;
+}
+
+static PyObject *
+typecast_PYDATE_build(typecast_value *v, PyObject *curs)
+{
+    int y = v->dt.y;
+
+    if (y > 9999) y = 9999;
+    return PyDateTimeAPI->Date_FromDate(y, v->dt.m, v->dt.d,
+        PyDateTimeAPI->DateType);
+}
+
 static PyObject *
 typecast_PYDATE_cast(const char *str, Py_ssize_t len, PyObject *curs)
 {
     PyObject* obj = NULL;
-    int n, y=0, m=0, d=0;
+    typecast_value v;
 
     if (str == NULL) {Py_INCREF(Py_None); return Py_None;}
 
@@ -62,35 +91,104 @@ typecast_PYDATE_cast(const char *str, Py_ssize_t len, PyObject *curs)
     }
 
     else {
-        n = typecast_parse_date(str, NULL, &len, &y, &m, &d);
-        Dprintf("typecast_PYDATE_cast: "
-                "n = %d, len = " FORMAT_CODE_PY_SSIZE_T ", "
-                "y = %d, m = %d, d = %d",
-                 n, len, y, m, d);
-        if (n != 3) {
+        if (typecast_PYDATE_parse(str, len, &v) < 0) {
             PyErr_SetString(DataError, "unable to parse date");
             return NULL;
         }
-        else {
-            if (y > 9999) y = 9999;
-            obj = PyObject_CallFunction(
-                (PyObject*)PyDateTimeAPI->DateType, "iii", y, m, d);
-        }
+        obj = typecast_PYDATE_build(&v, curs);
     }
     return obj;
 }
 
 /** DATETIME - cast a timestamp into a datetime python object **/
 
+/* parse a timestamp, without the Python API: infinity is not handled */
+
+static int
+typecast_PYDATETIME_parse(const char *str, Py_ssize_t len, typecast_value *v)
+{
+    int n;
+    const char *tp = NULL;
+
+    if (!strcmp(str, "infinity") || !strcmp(str, "-infinity")) return -1;
+    if ((n = typecast_parse_iso(str, len, v)) >= 0) {
+        v->dt.n = n ? n : 3;
+        return 0;
+    }
+
+    v->dt.y = v->dt.m = v->dt.d = 0;
+    v->dt.hh = v->dt.mm = v->dt.ss = v->dt.us = v->dt.tz = 0;
+
+    Dprintf("typecast_PYDATETIME_parse: s = %s", str);
+    n = typecast_parse_date(str, &tp, &len, &v->dt.y, &v->dt.m, &v->dt.d);
+    Dprintf("typecast_PYDATETIME_parse: tp = %p "
+            "n = %d, len = " FORMAT_CODE_PY_SSIZE_T ","
+            " y = %d, m = %d, d = %d",
+             tp, n, len, v->dt.y, v->dt.m, v->dt.d);
+    if (n != 3) return -1;
+
+    if (len > 0) {
+        n = typecast_parse_time(tp, NULL, &len, &v->dt.hh, &v->dt.mm,
+            &v->dt.ss, &v->dt.us, &v->dt.tz);
+        Dprintf("typecast_PYDATETIME_parse: n = %d,"
+            " len = " FORMAT_CODE_PY_SSIZE_T ","
+            " hh = %d, mm = %d, ss = %d, us = %d, tz = %d",
+            n, len, v->dt.hh, v->dt.mm, v->dt.ss, v->dt.us, v->dt.tz);
+        if (n < 3 || n > 6) return -2;
+    }
+
+    v->dt.n = n;
+    return 0;
+}
+
 static PyObject *
-typecast_PYDATETIME_cast(const char *str, Py_ssize_t len, PyObject *curs)
+typecast_PYDATETIME_build(typecast_value *v, PyObject *curs)
 {
     PyObject* obj = NULL;
     PyObject *tzinfo = NULL;
     PyObject *tzinfo_factory;
-    int n, y=0, m=0, d=0;
-    int hh=0, mm=0, ss=0, us=0, tz=0;
-    const char *tp = NULL;
+    int y = v->dt.y, mm = v->dt.mm, ss = v->dt.ss;
+
+    if (ss > 59) {
+        mm += 1;
+        ss -= 60;
+    }
+    if (y > 9999)
+        y = 9999;
+
+    tzinfo_factory = typecast_tzinfo_factory(curs);
+    if (v->dt.n >= 5 && tzinfo_factory != Py_None) {
+        /* we have a time zone, calculate minutes and create
+           appropriate tzinfo object calling the factory */
+        Dprintf("typecast_PYDATETIME_build: UTC offset = %ds", v->dt.tz);
+
+        /* The datetime module requires that time zone offsets be
+           a whole number of minutes, so truncate the seconds to the
+           closest minute. */
+        tzinfo = curs_tzinfo((cursorObject *)curs,
+            (int)round(v->dt.tz / 60.0));
+    } else {
+        Py_INCREF(Py_None);
+        tzinfo = Py_None;
+    }
+    if (tzinfo != NULL) {
+        obj = PyDateTimeAPI->DateTime_FromDateAndTime(
+            y, v->dt.m, v->dt.d, v->dt.hh, mm, ss, v->dt.us, tzinfo,
+            PyDateTimeAPI->DateTimeType);
+        Dprintf("typecast_PYDATETIME_build: tzinfo: %p, refcnt = "
+            FORMAT_CODE_PY_SSIZE_T,
+            tzinfo, tzinfo->ob_refcnt
+          );
+        Py_DECREF(tzinfo);
+    }
+    return obj;
+}
+
+static PyObject *
+typecast_PYDATETIME_cast(const char *str, Py_ssize_t len, PyObject *curs)
+{
+    PyObject* obj = NULL;
+    typecast_value v;
 
     if (str == NULL) {Py_INCREF(Py_None); return Py_None;}
 
@@ -107,62 +205,15 @@ typecast_PYDATETIME_cast(const char *str, Py_ssize_t len, PyObject *curs)
     }
 
     else {
-        Dprintf("typecast_PYDATETIME_cast: s = %s", str);
-        n = typecast_parse_date(str, &tp, &len, &y, &m, &d);
-        Dprintf("typecast_PYDATE_cast: tp = %p "
-                "n = %d, len = " FORMAT_CODE_PY_SSIZE_T ","
-                " y = %d, m = %d, d = %d",
-                 tp, n, len, y, m, d);
-        if (n != 3) {
+        switch (typecast_PYDATETIME_parse(str, len, &v)) {
+        case -1:
             PyErr_SetString(DataError, "unable to parse date");
             return NULL;
+        case -2:
+            PyErr_SetString(DataError, "unable to parse time");
+            return NULL;
         }
-
-        if (len > 0) {
-            n = typecast_parse_time(tp, NULL, &len, &hh, &mm, &ss, &us, &tz);
-            Dprintf("typecast_PYDATETIME_cast: n = %d,"
-                " len = " FORMAT_CODE_PY_SSIZE_T ","
-                " hh = %d, mm = %d, ss = %d, us = %d, tz = %d",
-                n, len, hh, mm, ss, us, tz);
-            if (n < 3 || n > 6) {
-                PyErr_SetString(DataError, "unable to parse time");
-                return NULL;
-            }
-        }
-
-        if (ss > 59) {
-            mm += 1;
-            ss -= 60;
-        }
-        if (y > 9999)
-            y = 9999;
-
-        tzinfo_factory = ((cursorObject *)curs)->tzinfo_factory;
-        if (n >= 5 && tzinfo_factory != Py_None) {
-            /* we have a time zone, calculate minutes and create
-               appropriate tzinfo object calling the factory */
-            Dprintf("typecast_PYDATETIME_cast: UTC offset = %ds", tz);
-
-            /* The datetime module requires that time zone offsets be
-               a whole number of minutes, so truncate the seconds to the
-               closest minute. */
-            // printf("%d %d %d\n", tz, tzmin, round(tz / 60.0));
-            tzinfo = PyObject_CallFunction(tzinfo_factory, "i",
-                (int)round(tz / 60.0));
-        } else {
-            Py_INCREF(Py_None);
-            tzinfo = Py_None;
-        }
-        if (tzinfo != NULL) {
-            obj = PyObject_CallFunction(
-                (PyObject*)PyDateTimeAPI->DateTimeType, "iiiiiiiO",
-                y, m, d, hh, mm, ss, us, tzinfo);
-            Dprintf("typecast_PYDATETIME_cast: tzinfo: %p, refcnt = "
-                FORMAT_CODE_PY_SSIZE_T,
-                tzinfo, tzinfo->ob_refcnt
-              );
-            Py_DECREF(tzinfo);
-        }
+        obj = typecast_PYDATETIME_build(&v, curs);
     }
     return obj;
 }
@@ -192,7 +243,7 @@ typecast_PYTIME_cast(const char *str, Py_ssize_t len, PyObject *curs)
         mm += 1;
         ss -= 60;
     }
-    tzinfo_factory = ((cursorObject *)curs)->tzinfo_factory;
+    tzinfo_factory = typecast_tzinfo_factory(curs);
     if (n >= 5 && tzinfo_factory != Py_None) {
         /* we have a time zone, calculate minutes and create
            appropriate tzinfo object calling the factory */
@@ -201,7 +252,7 @@ typecast_PYTIME_cast(const char *str, Py_ssize_t len, PyObject *curs)
         /* The datetime module requires that time zone offsets be
            a whole number of minutes, so truncate the seconds to the
            closest minute. */
-        tzinfo = PyObject_CallFunction(tzinfo_factory, "i",
+        tzinfo = curs_tzinfo((cursorObject *)curs,
             (int)round(tz / 60.0));
     } else {
         Py_INCREF(Py_None);
@@ -0,0 +1,229 @@
+/* typecast_hstore.c - hstore typecasters
+ *
+ * Copyright (C) 2010 Federico Di Gregorio <fog@debian.org>
+ *
+ * This file is part of psycopg.
+ *
+ * psycopg2 is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link this program with the OpenSSL library (or with
+ * modified versions of OpenSSL that use the same license as OpenSSL),
+ * and distribute linked combinations including the two.
+ *
+ * You must obey the GNU Lesser General Public License in all respects for
+ * all of the code used other than OpenSSL.
+ *
+ * psycopg2 is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ */
+
+/* The hstore oid is different in every database: the typecasters have no
+ * oid and are bound to the right one by extras.register_hstore(), passing
+ * them to new_type(). They decode both the text representation, such as:
+ *
+ *     "a"=>"1", "b"=>NULL
+ *
+ * and the binary one of hstore_send(): the number of pairs, then each key
+ * and value prefixed by its length (-1 for NULL values). */
+
+/* build a key or value of the dict, decoding it if unicode is set */
+
+static PyObject *
+typecast_hstore_item(const char *s, Py_ssize_t len, PyObject *curs,
+                     int unicode)
+{
+    if (!unicode) {
+        return PyString_FromStringAndSize(s, len);
+    }
+    if (typecast_is_cursor(curs)) {
+        return conn_decode(((cursorObject *)curs)->conn, s, len);
+    }
+    /* without a connection we don't know the encoding: assume utf8 */
+    return PyUnicode_DecodeUTF8(s, len, NULL);
+}
+
+/* parse a double-quoted, backslash-escaped string starting at *p
+
+   move *p after the closing quote. Return NULL without an exception set
+   if the string is not well formed. */
+
+static PyObject *
+typecast_hstore_string(const char **p, const char *end, PyObject *curs,
+                       int unicode)
+{
+    const char *s = *p + 1, *c;
+    char *buf, *to;
+    PyObject *rv;
+    int escaped = 0;
+
+    if (*p >= end || **p != '"') return NULL;
+
+    for (c = s; c < end && *c != '"'; c++) {
+        if (*c == '\\') {
+            if (++c == end) return NULL;
+            escaped = 1;
+        }
+    }
+    if (c == end) return NULL;
+    *p = c + 1;
+
+    if (!escaped) {
+        return typecast_hstore_item(s, c - s, curs, unicode);
+    }
+
+    if (!(buf = PyMem_Malloc(c - s))) {
+        PyErr_NoMemory();
+        return NULL;
+    }
+    for (to = buf; s < c; s++) {
+        if (*s == '\\') s++;
+        *to++ = *s;
+    }
+    rv = typecast_hstore_item(buf, to - buf, curs, unicode);
+    PyMem_Free(buf);
+    return rv;
+}
+
+#define HSTORE_SKIP_SPACES(p, end) \
+    while ((p) < (end) && isspace((unsigned char)*(p))) { (p)++; }
+
+static PyObject *
+typecast_hstore_text(const char *s, Py_ssize_t len, PyObject *curs,
+                     int unicode)
+{
+    const char *p = s, *end = s + len, *start = s;
+    PyObject *rv, *key = NULL, *val = NULL;
+
+    if (!(rv = PyDict_New())) return NULL;
+
+    HSTORE_SKIP_SPACES(p, end);
+    while (p < end) {
+        start = p;
+        if (!(key = typecast_hstore_string(&p, end, curs, unicode))) {
+            goto bad;
+        }
+
+        HSTORE_SKIP_SPACES(p, end);
+        if (end - p < 2 || p[0] != '=' || p[1] != '>') goto bad;
+        p += 2;
+        HSTORE_SKIP_SPACES(p, end);
+
+        if (end - p >= 4 && 0 == strncmp(p, "NULL", 4)) {
+            Py_INCREF(Py_None);
+            val = Py_None;
+            p += 4;
+        }
+        else if (!(val = typecast_hstore_string(&p, end, curs, unicode))) {
+            goto bad;
+        }
+
+        if (0 > PyDict_SetItem(rv, key, val)) goto error;
+        Py_CLEAR(key);
+        Py_CLEAR(val);
+
+        HSTORE_SKIP_SPACES(p, end);
+        if (p < end) {
+            if (*p != ',') goto bad;
+            p++;
+            HSTORE_SKIP_SPACES(p, end);
+        }
+    }
+
+    return rv;
+
+bad:
+    if (!PyErr_Occurred()) {
+        PyErr_Format(InterfaceError, "error parsing hstore pair at char "
+            FORMAT_CODE_PY_SSIZE_T, (Py_ssize_t)(start - s));
+    }
+error:
+    Py_XDECREF(key);
+    Py_XDECREF(val);
+    Py_DECREF(rv);
+    return NULL;
+}
+
+static PyObject *
+typecast_hstore_binary(const char *s, Py_ssize_t len, PyObject *curs,
+                       int unicode)
+{
+    const char *p = s + 4, *end = s + len;
+    PyObject *rv, *key = NULL, *val = NULL;
+    unsigned long i, n;
+    long size;
+
+    n = typecast_binformat_uint32(s);
+    if (!(rv = PyDict_New())) return NULL;
+
+    for (i = 0; i < n; i++) {
+        if (end - p < 4) goto bad;
+        size = (long)typecast_binformat_uint32(p);
+        p += 4;
+        if (size < 0 || end - p < size) goto bad;
+        if (!(key = typecast_hstore_item(p, size, curs, unicode))) {
+            goto error;
+        }
+        p += size;
+
+        if (end - p < 4) goto bad;
+        size = (long)(int)typecast_binformat_uint32(p);
+        p += 4;
+        if (size == -1) {
+            Py_INCREF(Py_None);
+            val = Py_None;
+        }
+        else {
+            if (size < 0 || end - p < size) goto bad;
+            if (!(val = typecast_hstore_item(p, size, curs, unicode))) {
+                goto error;
+            }
+            p += size;
+        }
+
+        if (0 > PyDict_SetItem(rv, key, val)) goto error;
+        Py_CLEAR(key);
+        Py_CLEAR(val);
+    }
+    if (p != end) goto bad;
+
+    return rv;
+
+bad:
+    PyErr_SetString(DataError, "bad binary hstore value");
+error:
+    Py_XDECREF(key);
+    Py_XDECREF(val);
+    Py_DECREF(rv);
+    return NULL;
+}
+
+static PyObject *
+typecast_hstore_cast(const char *s, Py_ssize_t len, PyObject *curs,
+                     int unicode)
+{
+    if (s == NULL) {Py_INCREF(Py_None); return Py_None;}
+
+    /* the text representation can't start with the NUL of a binary count */
+    if (len >= 4 && s[0] == '\0') {
+        return typecast_hstore_binary(s, len, curs, unicode);
+    }
+    return typecast_hstore_text(s, len, curs, unicode);
+}
+
+static PyObject *
+typecast_HSTORE_cast(const char *s, Py_ssize_t len, PyObject *curs)
+{
+    return typecast_hstore_cast(s, len, curs, 0);
+}
+
+static PyObject *
+typecast_UNICODEHSTORE_cast(const char *s, Py_ssize_t len, PyObject *curs)
+{
+    return typecast_hstore_cast(s, len, curs, 1);
+}
@@ -0,0 +1,44 @@
+/* typecast_inet.c - inet and cidr typecasters
+ *
+ * Copyright (C) 2010 Federico Di Gregorio <fog@debian.org>
+ *
+ * This file is part of psycopg.
+ *
+ * psycopg2 is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link this program with the OpenSSL library (or with
+ * modified versions of OpenSSL that use the same license as OpenSSL),
+ * and distribute linked combinations including the two.
+ *
+ * You must obey the GNU Lesser General Public License in all respects for
+ * all of the code used other than OpenSSL.
+ *
+ * psycopg2 is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ */
+
+/* The values are returned wrapped in Inet objects, which are adapted back
+ * as inet. The wrappers are built directly, without calling the type. */
+
+static PyObject *
+typecast_INET_cast(const char *s, Py_ssize_t len, PyObject *curs)
+{
+    inetObject *obj;
+
+    if (s == NULL) {Py_INCREF(Py_None); return Py_None;}
+
+    if (!(obj = (inetObject *)inetType.tp_alloc(&inetType, 0))) {
+        return NULL;
+    }
+    if (!(obj->addr = PyString_FromStringAndSize(s, len))) {
+        Py_DECREF(obj);
+        return NULL;
+    }
+    return (PyObject *)obj;
+}
@@ -0,0 +1,130 @@
+/* typecast_uuid.c - uuid typecasters
+ *
+ * Copyright (C) 2010 Federico Di Gregorio <fog@debian.org>
+ *
+ * This file is part of psycopg.
+ *
+ * psycopg2 is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link this program with the OpenSSL library (or with
+ * modified versions of OpenSSL that use the same license as OpenSSL),
+ * and distribute linked combinations including the two.
+ *
+ * You must obey the GNU Lesser General Public License in all respects for
+ * all of the code used other than OpenSSL.
+ *
+ * psycopg2 is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ */
+
+/* The typecaster returns uuid.UUID objects, decoding both the text
+ * representation and the 16 bytes of the binary one. The instances are
+ * built from the 128 bits integer, without going through the Python parsing
+ * of UUID.__init__(). */
+
+/* the uuid.UUID class, imported at the first cast */
+static PyObject *typecast_uuid_class = NULL;
+
+static PyObject *
+typecast_uuid_from_bytes(const unsigned char *b)
+{
+    PyObject *num, *args, *kwargs, *rv = NULL, **dict;
+
+    if (!typecast_uuid_class) {
+        PyObject *m;
+        if (!(m = PyImport_ImportModule("uuid"))) return NULL;
+        typecast_uuid_class = PyObject_GetAttrString(m, "UUID");
+        Py_DECREF(m);
+        if (!typecast_uuid_class) return NULL;
+    }
+
+    if (!(num = _PyLong_FromByteArray(b, 16, 0, 0))) return NULL;
+    if (!(args = PyTuple_New(0))) goto exit;
+
+    /* UUID keeps the number in the instance dict and forbids setattr:
+       fill the dict of a new instance as UUID.__init__() would do */
+    if (PyType_Check(typecast_uuid_class)) {
+        PyTypeObject *type = (PyTypeObject *)typecast_uuid_class;
+        if (!(rv = type->tp_new(type, args, NULL))) goto exit;
+        if ((dict = _PyObject_GetDictPtr(rv))) {
+            if (!*dict && !(*dict = PyDict_New())) goto error;
+            if (0 > PyDict_SetItemString(*dict, "int", num)) goto error;
+            goto exit;
+        }
+        Py_CLEAR(rv);
+    }
+
+    /* no dict to fill: go through the constructor */
+    if ((kwargs = Py_BuildValue("{s:O}", "int", num))) {
+        rv = PyObject_Call(typecast_uuid_class, args, kwargs);
+        Py_DECREF(kwargs);
+    }
+    goto exit;
+
+error:
+    Py_CLEAR(rv);
+exit:
+    Py_XDECREF(args);
+    Py_DECREF(num);
+    return rv;
+}
+
+static int
+typecast_uuid_hexdigit(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static PyObject *
+typecast_UUID_cast(const char *str, Py_ssize_t len, PyObject *curs)
+{
+    unsigned char b[16];
+    const char *s = str, *end = str + len;
+    int i, h, l;
+
+    if (str == NULL) {Py_INCREF(Py_None); return Py_None;}
+
+    /* no uuid text representation is 16 chars long */
+    if (len == 16) {
+        return typecast_uuid_from_bytes((const unsigned char *)str);
+    }
+
+    /* the output is the canonical 8-4-4-4-12 form, but accept the braces
+       and the hyphens between couples of digits as uuid_in() does */
+    if (len >= 2 && *s == '{' && *(end - 1) == '}') {
+        s++; end--;
+    }
+    for (i = 0; i < 16; i++) {
+        if (i > 0 && s < end && *s == '-') s++;
+        if (end - s < 2
+            || (h = typecast_uuid_hexdigit(s[0])) < 0
+            || (l = typecast_uuid_hexdigit(s[1])) < 0) {
+            goto bad;
+        }
+        b[i] = (unsigned char)((h << 4) | l);
+        s += 2;
+    }
+    if (s != end) goto bad;
+
+    return typecast_uuid_from_bytes(b);
+
+bad:
+    {
+        PyObject *value;
+        if ((value = PyString_FromStringAndSize(str, len))) {
+            PyErr_Format(DataError, "bad uuid value: '%s'",
+                PyString_AS_STRING(value));
+            Py_DECREF(value);
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,367 @@
+/* tz_type.c - the fixed offset tzinfo type
+ *
+ * Copyright (C) 2010 Federico Di Gregorio <fog@debian.org>
+ *
+ * This file is part of psycopg.
+ *
+ * psycopg2 is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link this program with the OpenSSL library (or with
+ * modified versions of OpenSSL that use the same license as OpenSSL),
+ * and distribute linked combinations including the two.
+ *
+ * You must obey the GNU Lesser General Public License in all respects for
+ * all of the code used other than OpenSSL.
+ *
+ * psycopg2 is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <datetime.h>
+
+#define PSYCOPG_MODULE
+#include "psycopg/config.h"
+#include "psycopg/python.h"
+#include "psycopg/psycopg.h"
+#include "psycopg/tz.h"
+
+
+/* the zero timedelta, the offset of the default timezone */
+static PyObject *tz_zero = NULL;
+
+HIDDEN int
+psyco_tz_init(void)
+{
+    Dprintf("psyco_tz_init: init tz module");
+
+    PyDateTime_IMPORT;
+    if (!PyDateTimeAPI) {
+        PyErr_SetString(PyExc_ImportError, "datetime initialization failed");
+        return -1;
+    }
+    if (!(tz_zero = PyDelta_FromDSU(0, 0, 0))) { return -1; }
+
+    tzType.tp_base = PyDateTimeAPI->TZInfoType;
+    return 0;
+}
+
+/* return the offset in minutes east from UTC */
+static int
+tz_minutes(tzObject *self, long *minutes)
+{
+    if (!PyDelta_Check(self->offset)) {
+        PyErr_SetString(PyExc_TypeError, "_offset must be a timedelta");
+        return -1;
+    }
+    *minutes = (((PyDateTime_Delta *)self->offset)->days * 86400L
+        + ((PyDateTime_Delta *)self->offset)->seconds) / 60;
+    return 0;
+}
+
+
+/** the tzinfo methods **/
+
+static PyObject *
+tz_utcoffset(tzObject *self, PyObject *dt)
+{
+    Py_INCREF(self->offset);
+    return self->offset;
+}
+
+static PyObject *
+tz_dst(tzObject *self, PyObject *dt)
+{
+    Py_INCREF(tz_zero);
+    return tz_zero;
+}
+
+static PyObject *
+tz_tzname(tzObject *self, PyObject *dt)
+{
+    long seconds, hours, minutes;
+    char buf[32];
+
+    if (self->name != Py_None) {
+        Py_INCREF(self->name);
+        return self->name;
+    }
+
+    if (!PyDelta_Check(self->offset)) {
+        PyErr_SetString(PyExc_TypeError, "_offset must be a timedelta");
+        return NULL;
+    }
+    seconds = ((PyDateTime_Delta *)self->offset)->days * 86400L
+        + ((PyDateTime_Delta *)self->offset)->seconds;
+
+    /* as Python divmod() would do */
+    hours = seconds / 3600;
+    if (seconds % 3600 < 0) { hours--; }
+    minutes = (seconds - hours * 3600) / 60;
+
+    if (minutes) {
+        PyOS_snprintf(buf, sizeof(buf), "%+03ld:%ld", hours, minutes);
+    }
+    else {
+        PyOS_snprintf(buf, sizeof(buf), "%+03ld", hours);
+    }
+    return PyString_FromString(buf);
+}
+
+/* pickle as the former Python class: no argument and the members in a dict */
+static PyObject *
+tz_getstate(tzObject *self, PyObject *args)
+{
+    PyObject *state, **dictptr;
+
+    dictptr = _PyObject_GetDictPtr((PyObject *)self);
+    if (dictptr && *dictptr) {
+        state = PyDict_Copy(*dictptr);
+    }
+    else {
+        state = PyDict_New();
+    }
+    if (!state) { return NULL; }
+
+    if (0 > PyDict_SetItemString(state, "_offset", self->offset)
+            || 0 > PyDict_SetItemString(state, "_name", self->name)) {
+        Py_DECREF(state);
+        return NULL;
+    }
+    return state;
+}
+
+static PyObject *
+tz_setstate(tzObject *self, PyObject *state)
+{
+    PyObject *key, *value;
+    Py_ssize_t pos = 0;
+
+    if (PyDict_Check(state)) {
+        while (PyDict_Next(state, &pos, &key, &value)) {
+            if (0 > PyObject_SetAttr((PyObject *)self, key, value)) {
+                return NULL;
+            }
+        }
+    }
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+static PyObject *
+tz_repr(tzObject *self)
+{
+    long minutes;
+    PyObject *name, *rv;
+
+    if (0 > tz_minutes(self, &minutes)) { return NULL; }
+    if (!(name = PyObject_Repr(self->name))) { return NULL; }
+    rv = PyString_FromFormat(
+        "psycopg2.tz.FixedOffsetTimezone(offset=%ld, name=%s)",
+        minutes, PyString_AS_STRING(name));
+    Py_DECREF(name);
+    return rv;
+}
+
+
+/** object methods and members **/
+
+static struct PyMethodDef tzObject_methods[] = {
+    {"utcoffset", (PyCFunction)tz_utcoffset, METH_O,
+        "Return the offset from UTC."},
+    {"dst", (PyCFunction)tz_dst, METH_O,
+        "Return the DST adjustment: always zero."},
+    {"tzname", (PyCFunction)tz_tzname, METH_O,
+        "Return the zone name, by default in the form ``sHH:MM``."},
+    {"__getstate__", (PyCFunction)tz_getstate, METH_NOARGS,
+        "Return the state of the object, for pickling."},
+    {"__setstate__", (PyCFunction)tz_setstate, METH_O,
+        "Restore the state of a pickled object."},
+    {NULL}
+};
+
+static PyObject *
+tz_get_member(tzObject *self, void *closure)
+{
+    PyObject *rv = closure ? self->name : self->offset;
+    Py_INCREF(rv);
+    return rv;
+}
+
+static int
+tz_set_member(tzObject *self, PyObject *value, void *closure)
+{
+    PyObject **member = closure ? &self->name : &self->offset;
+    PyObject *tmp;
+
+    if (value == NULL) {
+        PyErr_SetString(PyExc_AttributeError, "can't delete the attribute");
+        return -1;
+    }
+    Py_INCREF(value);
+    tmp = *member;
+    *member = value;
+    Py_DECREF(tmp);
+    return 0;
+}
+
+static struct PyGetSetDef tzObject_getsets[] = {
+    {"_offset", (getter)tz_get_member, (setter)tz_set_member,
+        "The offset from UTC, as a timedelta.", NULL},
+    {"_name", (getter)tz_get_member, (setter)tz_set_member,
+        "The name of the zone, or None.", (void *)1},
+    {NULL}
+};
+
+
+/* initialization and finalization methods */
+
+static int
+tz_init(PyObject *obj, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"offset", "name", NULL};
+    tzObject *self = (tzObject *)obj;
+    PyObject *offset = Py_None, *name = Py_None, *tmp;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|OO", kwlist,
+                                     &offset, &name)) {
+        return -1;
+    }
+
+    if (offset != Py_None) {
+        long n = PyInt_Check(offset) ? PyInt_AS_LONG(offset) : 0;
+        if (PyInt_Check(offset) && n > -1440000 && n < 1440000) {
+            tmp = PyDelta_FromDSU(0, (int)(n * 60), 0);
+        }
+        else {
+            /* let timedelta deal with floats and such */
+            PyObject *noargs, *kw;
+            if (!(kw = Py_BuildValue("{sO}", "minutes", offset))) {
+                return -1;
+            }
+            noargs = PyTuple_New(0);
+            tmp = noargs ? PyObject_Call(
+                (PyObject *)PyDateTimeAPI->DeltaType, noargs, kw) : NULL;
+            Py_XDECREF(noargs);
+            Py_DECREF(kw);
+        }
+        if (!tmp) { return -1; }
+        Py_DECREF(self->offset);
+        self->offset = tmp;
+    }
+
+    Py_INCREF(name);
+    tmp = self->name;
+    self->name = name;
+    Py_DECREF(tmp);
+
+    return 0;
+}
+
+static PyObject *
+tz_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
+{
+    tzObject *self;
+
+    if (!(self = (tzObject *)type->tp_alloc(type, 0))) { return NULL; }
+
+    /* the defaults of the Python class attributes */
+    Py_INCREF(tz_zero);
+    self->offset = tz_zero;
+    Py_INCREF(Py_None);
+    self->name = Py_None;
+
+    return (PyObject *)self;
+}
+
+static int
+tz_traverse(tzObject *self, visitproc visit, void *arg)
+{
+    Py_VISIT(self->offset);
+    Py_VISIT(self->name);
+    return 0;
+}
+
+static int
+tz_clear(tzObject *self)
+{
+    Py_CLEAR(self->offset);
+    Py_CLEAR(self->name);
+    return 0;
+}
+
+static void
+tz_dealloc(PyObject* obj)
+{
+    PyObject_GC_UnTrack(obj);
+    tz_clear((tzObject *)obj);
+    Py_TYPE(obj)->tp_free(obj);
+}
+
+
+/* object type */
+
+#define tzType_doc \
+"Fixed offset in minutes east from UTC.\n\n" \
+"A `!datetime.tzinfo` with an offset of *offset* minutes and the name\n" \
+"*name*, by default in the form ``sHH:MM`` (``s`` is the sign)."
+
+PyTypeObject tzType = {
+    PyObject_HEAD_INIT(NULL)
+    0,
+    "psycopg2.tz.FixedOffsetTimezone",
+    sizeof(tzObject),
+    0,
+    tz_dealloc, /*tp_dealloc*/
+    0,          /*tp_print*/
+    0,          /*tp_getattr*/
+    0,          /*tp_setattr*/
+    0,          /*tp_compare*/
+    (reprfunc)tz_repr, /*tp_repr*/
+    0,          /*tp_as_number*/
+    0,          /*tp_as_sequence*/
+    0,          /*tp_as_mapping*/
+    0,          /*tp_hash */
+
+    0,          /*tp_call*/
+    0,          /*tp_str*/
+    0,          /*tp_getattro*/
+    0,          /*tp_setattro*/
+    0,          /*tp_as_buffer*/
+
+    Py_TPFLAGS_DEFAULT|Py_TPFLAGS_BASETYPE|Py_TPFLAGS_HAVE_GC,
+                /*tp_flags*/
+    tzType_doc, /*tp_doc*/
+
+    (traverseproc)tz_traverse, /*tp_traverse*/
+    (inquiry)tz_clear, /*tp_clear*/
+
+    0,          /*tp_richcompare*/
+    0,          /*tp_weaklistoffset*/
+
+    0,          /*tp_iter*/
+    0,          /*tp_iternext*/
+
+    /* Attribute descriptor and subclassing stuff */
+
+    tzObject_methods, /*tp_methods*/
+    0,          /*tp_members*/
+    tzObject_getsets, /*tp_getset*/
+    0,          /*tp_base: datetime.tzinfo, set at module init*/
+    0,          /*tp_dict*/
+
+    0,          /*tp_descr_get*/
+    0,          /*tp_descr_set*/
+    0,          /*tp_dictoffset*/
+
+    tz_init,    /*tp_init*/
+    0,          /*tp_alloc*/
+    tz_new,     /*tp_new*/
+};
@@ -33,6 +33,10 @@
 #include "psycopg/pgtypes.h"
 #include "psycopg/pgversion.h"
 #include <stdlib.h>
+#ifndef _WIN32
+#include <sys/time.h>
+#include <time.h>
+#endif
 
 char *
 psycopg_escape_string(PyObject *obj, const char *from, Py_ssize_t len,
@@ -72,3 +76,25 @@ psycopg_escape_string(PyObject *obj, const char *from, Py_ssize_t len,
         
     return to;
 }
+
+/* seconds from an arbitrary point: the clock used for timeouts and stats
+
+   use a monotonic clock where available, so that intervals are not
+   affected by changes of the system time. */
+double
+psycopg_now(void)
+{
+#ifdef _WIN32
+    return GetTickCount() / 1000.0;
+#elif defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+#else
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+#endif
+}
@@ -0,0 +1,447 @@
+#!/usr/bin/env python
+"""Benchmark the psycopg2 hot paths against a database.
+
+Measure the fetch throughput for several data types, executemany(), COPY
+in both directions, the adaptation of the query arguments and the
+connection latency. The results can be saved in a JSON file to be compared
+with the ones of another build:
+
+    python scripts/bench.py [options] [benchmark ...]
+    python scripts/bench.py -o after.json --compare before.json
+
+The database is chosen by the same PSYCOPG2_TESTDB* environment variables
+used by the test suite, or by the --dsn option. A subset of the benchmarks
+can be run passing their names (or name prefixes) on the command line: use
+--list to see them.
+
+The "cast_" and "quote_" benchmarks call the C typecasters and adapters
+directly on synthetic input and don't need a database: run them alone with
+--offline. They report the time per call and, if the Python interpreter was
+built with COUNT_ALLOCS, the objects allocated per call.
+"""
+
+# Copyright (C) 2010 Daniele Varrazzo  <daniele.varrazzo@gmail.com>
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by the
+# Free Software Foundation; either version 2, or (at your option) any later
+# version.
+#
+# This program is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY
+# or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+# for more details.
+
+import os
+import sys
+import time
+import timeit
+import uuid
+import datetime
+from decimal import Decimal
+from optparse import OptionParser
+from cStringIO import StringIO
+
+try:
+    import json
+except ImportError:
+    json = None
+
+import psycopg2
+import psycopg2.extensions
+
+# the registered benchmarks: (name, function, unit, higher is better,
+# needs a database)
+BENCHMARKS = []
+
+def benchmark(name, unit, higher=True, online=True):
+    def benchmark_(f):
+        BENCHMARKS.append((name, f, unit, higher, online))
+        return f
+    return benchmark_
+
+def timed(f, *args):
+    """Return the seconds taken by f(*args)."""
+    t0 = time.time()
+    f(*args)
+    return time.time() - t0
+
+
+# Fetch throughput: rows of 10 columns of the same type
+
+FETCH_TYPES = [
+    ('int4', "i"),
+    ('int8', "i::int8 * 1000000000"),
+    ('float8', "i::float8 / 7"),
+    ('numeric', "(i::numeric / 7)::numeric(20,6)"),
+    ('bool', "i % 2 = 0"),
+    ('text', "repeat('x', 20) || i"),
+    ('bytea', "decode(repeat('ab', 32), 'hex')"),
+    ('date', "'2010-01-01'::date + i % 1000"),
+    ('timestamp', "'2010-01-01'::timestamp + i * '1 min'::interval"),
+    ('timestamptz', "'2010-01-01'::timestamptz + i * '1 min'::interval"),
+    ('interval', "i * '1 min'::interval"),
+    ('int4_array', "array[i, i + 1, i + 2, i + 3]"),
+]
+
+def make_fetch_benchmark(typname, expr):
+    def bench_fetch(conn, opts):
+        curs = conn.cursor()
+        query = "select %s from generate_series(1, %d) as i" % (
+            ", ".join([expr] * 10), opts.rows)
+        return opts.rows, timed(lambda: (curs.execute(query),
+                                         curs.fetchall()))
+
+    benchmark('fetch_' + typname, 'rows/s')(bench_fetch)
+
+for typname, expr in FETCH_TYPES:
+    make_fetch_benchmark(typname, expr)
+
+
+@benchmark('fetch_named', 'rows/s')
+def bench_fetch_named(conn, opts):
+    def fetch():
+        curs = conn.cursor('bench')
+        curs.itersize = 1000
+        curs.execute("select i, i::text from generate_series(1, %d) as i"
+            % opts.rows)
+        for row in curs:
+            pass
+        curs.close()
+
+    rv = opts.rows, timed(fetch)
+    conn.rollback()
+    return rv
+
+
+# Data writing
+
+def create_bench_table(conn):
+    curs = conn.cursor()
+    curs.execute("create temp table bench_data ("
+        "id int4, num numeric, data text, ts timestamp)")
+    conn.commit()
+
+def drop_bench_table(conn):
+    conn.rollback()
+    curs = conn.cursor()
+    curs.execute("drop table if exists bench_data")
+    conn.commit()
+
+def bench_records(n):
+    ts = datetime.datetime(2010, 1, 1)
+    return [(i, Decimal(i) / 8, 'row %d' % i, ts) for i in xrange(n)]
+
+@benchmark('executemany', 'rows/s')
+def bench_executemany(conn, opts):
+    n = opts.rows // 10
+    records = bench_records(n)
+    create_bench_table(conn)
+    try:
+        curs = conn.cursor()
+        return n, timed(curs.executemany,
+            "insert into bench_data values (%s, %s, %s, %s)", records)
+    finally:
+        drop_bench_table(conn)
+
+def copy_data(n):
+    f = StringIO()
+    for i in xrange(n):
+        f.write("%d\t%d.125\trow %d with some text\t2010-01-01 00:00:00\n"
+            % (i, i, i))
+    return f.getvalue()
+
+@benchmark('copy_from', 'MB/s')
+def bench_copy_from(conn, opts):
+    data = copy_data(opts.rows)
+    create_bench_table(conn)
+    try:
+        curs = conn.cursor()
+        return len(data) / 1e6, timed(curs.copy_from,
+            StringIO(data), 'bench_data')
+    finally:
+        drop_bench_table(conn)
+
+@benchmark('copy_to', 'MB/s')
+def bench_copy_to(conn, opts):
+    data = copy_data(opts.rows)
+    create_bench_table(conn)
+    try:
+        curs = conn.cursor()
+        curs.copy_from(StringIO(data), 'bench_data')
+        f = StringIO()
+        t = timed(curs.copy_to, f, 'bench_data')
+        return len(f.getvalue()) / 1e6, t
+    finally:
+        drop_bench_table(conn)
+
+
+# Adaptation: no backend roundtrip
+
+ADAPT_ARGS = [
+    ('int', 42),
+    ('float', 3.14159),
+    ('decimal', Decimal('123.456')),
+    ('str', "it's a string with a quote"),
+    ('unicode', u"unicode \u20ac string"),
+    ('binary', psycopg2.Binary('\x00\x01\x02' * 20)),
+    ('datetime', datetime.datetime(2010, 1, 2, 3, 4, 5, 678900)),
+    ('list', [1, 2, 3, 4, 5]),
+    ('none', None),
+]
+
+def make_adapt_benchmark(name, arg):
+    def bench_adapt(conn, opts):
+        curs = conn.cursor()
+        args = (arg,) * 10
+        query = "select " + ", ".join(["%s"] * 10)
+        n = opts.rows // 10
+
+        def adapt():
+            for i in xrange(n):
+                curs.mogrify(query, args)
+
+        return n * 10, timed(adapt)
+
+    benchmark('adapt_' + name, 'args/s')(bench_adapt)
+
+for name, arg in ADAPT_ARGS:
+    make_adapt_benchmark(name, arg)
+
+
+@benchmark('connect', 'ms', higher=False)
+def bench_connect(conn, opts):
+    n = 20
+    def connect():
+        for i in xrange(n):
+            psycopg2.connect(opts.dsn).close()
+
+    # the result is milliseconds per connection: n "ops" per ms
+    return n / 1000.0, timed(connect)
+
+
+# Offline benchmarks: the C functions called directly, no connection
+
+OFFLINE_SETUP = """
+import uuid
+import datetime
+from decimal import Decimal
+from psycopg2.extensions import adapt, new_composite_type
+from psycopg2._psycopg import INTEGER, LONGINTEGER, FLOAT, DECIMAL, \
+    BOOLEAN, UNICODE, BINARY, PYDATE, PYTIME, PYDATETIME, PYINTERVAL, \
+    INTEGERARRAY, STRINGARRAY, FLOATARRAYBUFFER, HSTORE, Hstore, \
+    UUID, UUIDARRAY, INET, Uuid
+from psycopg2.extras import HstoreAdapter
+
+bytea_hex = '\\\\x' + '00ff' * 32
+long_str = 'x' * 1000 + "'"
+buf = buffer('\\x00\\x01\\x02' * 20)
+dec = Decimal('123.456')
+dt = datetime.datetime(2010, 1, 2, 3, 4, 5, 678900)
+# int4, text, float8, date
+composite = new_composite_type((99999,), "BENCH", (23, 25, 701, 1082))
+uuid_str = '9c6d5a77-7256-457e-9461-347b4358e350'
+uuid_val = uuid.UUID(uuid_str)
+uuid_bytes = uuid_val.bytes
+hs = dict(('key%d' % i, 'value "%d"' % i) for i in range(10))
+hs_text = ', '.join(['"%s"=>"%s"' % (k, v.replace('"', '\\\\"'))
+    for k, v in hs.items()])
+"""
+
+def allocations():
+    """Return the number of objects allocated so far, None if unknown."""
+    if not hasattr(sys, 'getcounts'):
+        return None
+    return sum([c[1] for c in sys.getcounts()])
+
+def make_offline_benchmark(name, stmt):
+    def bench_offline(conn, opts):
+        n = opts.rows
+        timer = timeit.Timer(stmt, OFFLINE_SETUP)
+        a0 = allocations()
+        t = timer.timeit(n)
+        a1 = allocations()
+        allocs = None
+        if a0 is not None:
+            allocs = float(a1 - a0) / n
+
+        # the result is nanoseconds per call: n "ops" per ns
+        return n / 1e9, t, allocs
+
+    benchmark(name, 'ns/op', higher=False, online=False)(bench_offline)
+
+CAST_ARGS = [
+    ('int4', "INTEGER('123456', None)"),
+    ('int8', "LONGINTEGER('12345678901234', None)"),
+    ('float8', "FLOAT('3.14159265358979', None)"),
+    ('numeric', "DECIMAL('12345.678901', None)"),
+    ('bool', "BOOLEAN('t', None)"),
+    ('text', "UNICODE('some text: caf\\xc3\\xa8', None)"),
+    ('bytea', "BINARY(bytea_hex, None)"),
+    ('date', "PYDATE('2010-01-02', None)"),
+    ('time', "PYTIME('03:04:05.678901', None)"),
+    ('timestamp', "PYDATETIME('2010-01-02 03:04:05.678901', None)"),
+    ('timestamp_generic', "PYDATETIME('12010-01-02 03:04:05.678901', None)"),
+    ('timestamptz', "PYDATETIME('2010-01-02 03:04:05.678901+02', None)"),
+    ('interval', "PYINTERVAL('1 day 02:03:04.5', None)"),
+    ('int4_array', "INTEGERARRAY('{1,2,3,4,5,6,7,8,9,10}', None)"),
+    ('int4_array_2d', "INTEGERARRAY('{{1,2,3},{4,5,6},{7,8,9}}', None)"),
+    ('text_array',
+        "STRINGARRAY('{abc,\"d e f\",\"g\\\\\"h\",NULL}', None)"),
+    ('float8_array', "FLOATARRAYBUFFER('{1.5,2.5,3.5,4.5,5.5}', None)"),
+    ('uuid', "UUID(uuid_str, None)"),
+    ('uuid_binary', "UUID(uuid_bytes, None)"),
+    ('uuid_array', "UUIDARRAY('{%s,%s,NULL}' % (uuid_str, uuid_str), None)"),
+    ('inet', "INET('192.168.0.1/24', None)"),
+    ('composite', "composite('(42,\"some text\",3.14,2010-01-02)', None)"),
+    ('hstore', "HSTORE(hs_text, None)"),
+    ('hstore_py', "HstoreAdapter.parse(hs_text, None)"),
+]
+
+QUOTE_ARGS = [
+    ('str', "adapt(\"it's a string with a quote\").getquoted()"),
+    ('str_long', "adapt(long_str).getquoted()"),
+    ('binary', "adapt(buf).getquoted()"),
+    ('float', "adapt(3.14159).getquoted()"),
+    ('decimal', "adapt(dec).getquoted()"),
+    ('datetime', "adapt(dt).getquoted()"),
+    ('list', "adapt([1, 2, 3, 4, 5]).getquoted()"),
+    ('uuid', "Uuid(uuid_val).getquoted()"),
+    ('hstore', "Hstore(hs).getquoted()"),
+]
+
+for name, stmt in CAST_ARGS:
+    make_offline_benchmark('cast_' + name, stmt)
+
+for name, stmt in QUOTE_ARGS:
+    make_offline_benchmark('quote_' + name, stmt)
+
+
+# Results handling
+
+def run(conn, opts, names):
+    results = {}
+    for name, f, unit, higher, online in BENCHMARKS:
+        if names and not [n for n in names if name.startswith(n)]:
+            continue
+        if online and conn is None:
+            continue
+        best = None
+        for i in xrange(opts.repeat):
+            rv = f(conn, opts)
+            ops, t = rv[:2]
+            if higher:
+                value = ops / t
+            else:
+                value = t / ops
+            if best is None or (value > best) == higher:
+                best = value
+        results[name] = {'value': best, 'unit': unit, 'higher': higher}
+        line = "%-24s %12.2f %s" % (name, best, unit)
+        if len(rv) > 2 and rv[2] is not None:
+            results[name]['allocs'] = rv[2]
+            line += " %8.2f allocs/op" % rv[2]
+        print line
+        sys.stdout.flush()
+    return results
+
+def git_revision():
+    try:
+        from subprocess import Popen, PIPE
+        out = Popen(['git', 'describe', '--always', '--dirty'],
+            stdout=PIPE, stderr=PIPE,
+            cwd=os.path.dirname(os.path.abspath(__file__))).communicate()[0]
+        return out.strip() or None
+    except Exception:
+        return None
+
+def compare(results, base):
+    print
+    print "%-24s %12s %12s %8s" % ('benchmark', 'base', 'current', 'change')
+    for name in sorted(results):
+        if name not in base:
+            continue
+        cur = results[name]['value']
+        old = base[name]['value']
+        change = old and (cur - old) / old * 100 or 0.0
+        if not results[name]['higher']:
+            change = -change
+        print "%-24s %12.2f %12.2f %+7.1f%%" % (name, old, cur, change)
+
+def default_dsn():
+    dsn = 'dbname=%s' % os.environ.get('PSYCOPG2_TESTDB', 'psycopg2_test')
+    for var, param in [('PSYCOPG2_TESTDB_HOST', 'host'),
+            ('PSYCOPG2_TESTDB_PORT', 'port'),
+            ('PSYCOPG2_TESTDB_USER', 'user')]:
+        if os.environ.get(var):
+            dsn += ' %s=%s' % (param, os.environ[var])
+    return dsn
+
+def main():
+    parser = OptionParser(usage="%prog [options] [benchmark ...]",
+        description=__doc__.split('\n\n')[0])
+    parser.add_option('--dsn', default=default_dsn(),
+        help="the database to connect to [default: %default]")
+    parser.add_option('-n', '--rows', type='int', default=100000,
+        help="rows to fetch or write in each benchmark, calls in the "
+            "offline ones [default: %default]")
+    parser.add_option('-r', '--repeat', type='int', default=3,
+        help="times to repeat each benchmark, keeping the best "
+            "[default: %default]")
+    parser.add_option('-o', '--output', metavar="FILE",
+        help="write the results to FILE in JSON format")
+    parser.add_option('-c', '--compare', metavar="FILE",
+        help="compare the results with the ones saved in FILE")
+    parser.add_option('-l', '--list', action='store_true',
+        help="list the available benchmarks and exit")
+    parser.add_option('--offline', action='store_true',
+        help="only run the benchmarks not needing a database")
+    opts, names = parser.parse_args()
+
+    if opts.list:
+        for name, f, unit, higher, online in BENCHMARKS:
+            print "%-24s %s" % (name, unit)
+        return 0
+
+    if (opts.output or opts.compare) and json is None:
+        parser.error("the json module is required to save the results")
+
+    if opts.offline:
+        conn = None
+    else:
+        conn = psycopg2.connect(opts.dsn)
+    info = {
+        'psycopg2': psycopg2.__version__,
+        'python': sys.version.split()[0],
+        'server_version': conn and conn.server_version or None,
+        'revision': git_revision(),
+        'date': datetime.datetime.now().isoformat(),
+        'rows': opts.rows,
+    }
+    print "psycopg2 %(psycopg2)s, Python %(python)s, " \
+        "server %(server_version)s" % info
+
+    results = run(conn, opts, names)
+    if conn is not None:
+        conn.close()
+
+    if opts.output:
+        info['results'] = results
+        f = open(opts.output, 'w')
+        try:
+            json.dump(info, f, indent=2, sort_keys=True)
+        finally:
+            f.close()
+
+    if opts.compare:
+        f = open(opts.compare)
+        try:
+            base = json.load(f)['results']
+        finally:
+            f.close()
+        compare(results, base)
+
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main())
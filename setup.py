@@ -350,9 +350,12 @@ sources = [
     'connection_type.c', 'connection_int.c', 'cursor_type.c', 'cursor_int.c',
     'lobject_type.c', 'lobject_int.c', 'notify_type.c', 'xid_type.c',
     'adapter_qstring.c', 'adapter_pboolean.c', 'adapter_binary.c',
-    'adapter_asis.c', 'adapter_list.c', 'adapter_datetime.c',
+    'adapter_asis.c', 'adapter_list.c', 'adapter_hstore.c',
+    'adapter_uuid.c', 'adapter_inet.c', 'adapter_datetime.c',
     'adapter_pfloat.c', 'adapter_pdecimal.c',
-    'green.c', 'utils.c']
+    'copy_binary.c', 'copystream_type.c', 'column_type.c', 'lazyrow_type.c',
+    'dictrow_type.c', 'tz_type.c', 'pool_type.c', 'resultcache_type.c',
+    'registry_type.c', 'green.c', 'utils.c']
 
 parser = ConfigParser.ConfigParser()
 parser.read('setup.cfg')
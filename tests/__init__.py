@@ -59,6 +59,7 @@ import test_notify
 import test_async
 import test_green
 import test_cancel
+import test_pool
 
 def test_suite():
     suite = unittest.TestSuite()
@@ -78,6 +79,7 @@ def test_suite():
     suite.addTest(test_async.test_suite())
     suite.addTest(test_green.test_suite())
     suite.addTest(test_cancel.test_suite())
+    suite.addTest(test_pool.test_suite())
     return suite
 
 if __name__ == '__main__':
@@ -112,6 +112,75 @@ class ExtrasDictCursorTests(unittest.TestCase):
         self.failUnless(row['foo'] == 'qux')
         self.failUnless(row[0] == 'qux')
 
+    def testDictRowMethods(self):
+        curs = self.conn.cursor(cursor_factory=psycopg2.extras.DictCursor)
+        curs.execute("SELECT 1 AS a, 'x'::text AS b")
+        row = curs.fetchone()
+        self.assert_(isinstance(row, list))
+        self.assertEqual([1, 'x'], row)
+        self.assertEqual(['a', 'b'], sorted(row.keys()))
+        self.assertEqual((1, 'x'), row.values())
+        self.assertEqual([('a', 1), ('b', 'x')], sorted(row.items()))
+        self.assertEqual({'a': 1, 'b': 'x'}, row.copy())
+        self.assertEqual([1, 'x'], list(row.itervalues()))
+        self.assert_('a' in row)
+        self.assert_(row.has_key('b'))
+        self.assertEqual(None, row.get('c'))
+        self.assertEqual('x', row.get('b'))
+        self.assertEqual([1], row[:1])
+        self.assertRaises(KeyError, lambda: row['c'])
+        self.assertEqual({'a': 0, 'b': 1}, curs.index)
+        self.assert_(curs.index is curs.index)
+
+    def testDictRowShareIndex(self):
+        curs = self.conn.cursor(cursor_factory=psycopg2.extras.DictCursor)
+        curs.execute("SELECT x AS a FROM generate_series(1,2) x")
+        r1, r2 = curs.fetchall()
+        self.assert_(r1._index is r2._index)
+        curs.execute("SELECT 1 AS b")
+        r3 = curs.fetchone()
+        self.assertEqual(1, r3['b'])
+        self.assertEqual(2, r2['a'])
+        self.assertRaises(KeyError, lambda: r3['a'])
+
+    def testDictRowSubclass(self):
+        class MyRow(psycopg2.extras.DictRow):
+            def __init__(self, cursor):
+                psycopg2.extras.DictRow.__init__(self, cursor)
+                self.foo = 42
+
+        curs = self.conn.cursor()
+        curs.row_factory = MyRow
+        curs.execute("SELECT 'bar'::text AS foo")
+        row = curs.fetchone()
+        self.assertEqual(MyRow, type(row))
+        self.assertEqual('bar', row['foo'])
+        self.assertEqual(42, row.foo)
+
+    def testRealDictRow(self):
+        curs = self.conn.cursor(cursor_factory=psycopg2.extras.RealDictCursor)
+        curs.execute("SELECT 1 AS a, 'x'::text AS b")
+        row = curs.fetchone()
+        self.assert_(isinstance(row, dict))
+        self.assertEqual({'a': 1, 'b': 'x'}, row)
+        self.assertEqual(['a', 'b'], curs.column_mapping)
+        row[0] = 2
+        self.assertEqual(2, row['a'])
+        self.assertRaises(KeyError, lambda: row[0])
+
+    def testRealDictRowSubclass(self):
+        class MyRow(psycopg2.extras.RealDictRow):
+            pass
+
+        curs = self.conn.cursor()
+        curs.row_factory = MyRow
+        curs.execute("SELECT 'bar'::text AS foo")
+        row = curs.fetchone()
+        self.assertEqual(MyRow, type(row))
+        self.assertEqual({'foo': 'bar'}, row)
+        row['baz'] = 42
+        self.assertEqual(42, row['baz'])
+
 
 def if_has_namedtuple(f):
     def if_has_namedtuple_(self):
@@ -220,6 +289,25 @@ class NamedTupleCursorTest(unittest.TestCase):
             # skip the test
             pass
 
+    @if_has_namedtuple
+    def test_named_cursor(self):
+        curs = self.conn.cursor('ntcurs')
+        curs.execute("select * from nttest order by 1")
+        t = curs.fetchone()
+        self.assertEqual(t.s, 'foo')
+        ts = curs.fetchall()
+        self.assert_(ts[0].__class__ is t.__class__)
+        self.assertEqual(['bar', 'baz'], [t.s for t in ts])
+
+    @if_has_namedtuple
+    def test_record_methods(self):
+        curs = self.conn.cursor()
+        curs.execute("select * from nttest where i = 1")
+        t = curs.fetchone()
+        self.assertEqual(('i', 's'), t._fields)
+        self.assertEqual((1, 'foo'), t)
+        self.assertEqual(t._replace(s='bar'), (1, 'bar'))
+
     @if_has_namedtuple
     def test_record_updated(self):
         curs = self.conn.cursor()
@@ -241,6 +329,22 @@ class NamedTupleCursorTest(unittest.TestCase):
         curs.execute("update nttest set s = s")
         self.assertRaises(psycopg2.ProgrammingError, curs.fetchall)
 
+    @if_has_namedtuple
+    def test_record_subclass_new(self):
+        from collections import namedtuple
+        class Record(namedtuple('Record', 'i s')):
+            __slots__ = ()
+            def __new__(cls, i, s):
+                return super(Record, cls).__new__(cls, i * 10, s.upper())
+
+        curs = self.conn.cursor()
+        curs.row_factory = Record
+        curs.execute("select * from nttest order by 1")
+        self.assertEqual(Record(1, 'foo'), curs.fetchone())
+        rs = curs.fetchall()
+        self.assertEqual(Record, type(rs[0]))
+        self.assertEqual([20, 30], [r.i for r in rs])
+
     @if_has_namedtuple
     def test_minimal_generation(self):
         # Instrument the class to verify it gets called the minimum number of times.
@@ -275,6 +379,79 @@ class NamedTupleCursorTest(unittest.TestCase):
             NamedTupleCursor._make_nt = f_orig
 
 
+class LazyDictCursorTest(unittest.TestCase):
+    def setUp(self):
+        self.conn = psycopg2.connect(tests.dsn,
+            connection_factory=psycopg2.extras.LazyDictConnection)
+
+    def tearDown(self):
+        self.conn.close()
+
+    def test_access(self):
+        curs = self.conn.cursor()
+        curs.execute("select 1 as foo, 'bar'::text as baz, null::int as qux")
+        row = curs.fetchone()
+        self.assert_(isinstance(row, psycopg2.extensions.LazyRow))
+        self.assertEqual(3, len(row))
+        self.assertEqual(1, row[0])
+        self.assertEqual('bar', row[-2])
+        self.assertEqual(None, row['qux'])
+        self.assertEqual((1, 'bar'), row[:2])
+        self.assertRaises(IndexError, lambda: row[3])
+        self.assertRaises(KeyError, lambda: row['nope'])
+        self.assertEqual('bar', row.get('baz'))
+        self.assertEqual(42, row.get('nope', 42))
+
+    def test_mapping(self):
+        curs = self.conn.cursor()
+        curs.execute("select 1 as foo, 'bar'::text as baz")
+        row = curs.fetchone()
+        self.assertEqual(['foo', 'baz'], row.keys())
+        self.assertEqual((1, 'bar'), row.values())
+        self.assertEqual([('foo', 1), ('baz', 'bar')], row.items())
+        self.assertEqual({'foo': 1, 'baz': 'bar'}, row.copy())
+        self.assert_('foo' in row)
+        self.assert_(row.has_key('baz'))
+        self.assert_('nope' not in row)
+        self.assertEqual([1, 'bar'], list(row))
+
+    def test_compare(self):
+        curs = self.conn.cursor()
+        curs.execute("select x, x * 10 from generate_series(1,2) x")
+        rows = curs.fetchall()
+        self.assertEqual((1, 10), rows[0])
+        self.assertEqual(rows[1], (2, 20))
+        self.assert_(rows[0] < rows[1])
+        self.assertEqual("(1, 10)", repr(rows[0]))
+
+    def test_survive_cursor(self):
+        curs = self.conn.cursor()
+        curs.execute("select x from generate_series(1,3) x")
+        rows = curs.fetchall()
+        curs.execute("select 'foo'::text")
+        self.assertEqual('foo', curs.fetchone()[0])
+        curs.close()
+        del curs
+        self.assertEqual([1, 2, 3], [r[0] for r in rows])
+
+    def test_named(self):
+        curs = self.conn.cursor('lazy')
+        curs.itersize = 2
+        curs.execute("select x as n from generate_series(1,5) x")
+        rows = list(curs)
+        self.assertEqual([1, 2, 3, 4, 5], [r['n'] for r in rows])
+
+    def test_gc(self):
+        curs = self.conn.cursor()
+        curs.execute("select 1 as foo")
+        row = curs.fetchone()
+        del curs
+        import gc
+        gc.collect()
+        self.assertEqual(1, row['foo'])
+
+
+
 def test_suite():
     return unittest.TestLoader().loadTestsFromName(__name__)
 
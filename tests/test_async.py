@@ -131,6 +131,90 @@ class AsyncTests(unittest.TestCase):
 
         self.assertEquals(cur.fetchone(), None)
 
+    def test_async_queue(self):
+        curs = [self.conn.cursor() for i in range(5)]
+        for i, cur in enumerate(curs):
+            cur.execute("select %s", (i,))
+        self.assertTrue(self.conn.isexecuting())
+
+        # the queued cursors can't be used
+        self.assertRaises(psycopg2.ProgrammingError, curs[1].fetchone)
+        self.assertRaises(psycopg2.ProgrammingError,
+                          curs[1].execute, "select 1")
+
+        self.wait(self.conn)
+        self.assertFalse(self.conn.isexecuting())
+        self.assertEquals([cur.fetchone()[0] for cur in curs], range(5))
+
+    def test_async_queue_fetch_other(self):
+        cur1 = self.conn.cursor()
+        cur2 = self.conn.cursor()
+        cur1.execute("select 'a'")
+        self.wait(cur1)
+        cur2.execute("select 'b'")
+        # cur1 can fetch its result while cur2 runs
+        self.assertEquals(cur1.fetchone()[0], 'a')
+        self.wait(cur2)
+        self.assertEquals(cur2.fetchone()[0], 'b')
+
+    def test_async_queue_error(self):
+        cur1 = self.conn.cursor()
+        cur2 = self.conn.cursor()
+        cur1.execute("select * from no_such_table")
+        cur2.execute("select 42")
+        self.assertRaises(psycopg2.ProgrammingError, self.conn.poll)
+        self.wait(self.conn)
+        self.assertEquals(cur2.fetchone()[0], 42)
+
+    def test_async_queue_multi(self):
+        curs = [self.conn.cursor() for i in range(4)]
+        curs[0].execute("select 1")
+        curs[1].execute("select 2; select 3")
+        curs[2].execute("select ';' -- ;")
+        curs[3].execute("select 4")
+        self.wait(self.conn)
+        self.assertEquals([cur.fetchone()[0] for cur in curs],
+                          [1, 3, ';', 4])
+
+    def test_async_queue_params(self):
+        cur1 = self.conn.cursor()
+        cur2 = self.conn.cursor()
+        cur2.server_params = True
+        cur3 = self.conn.cursor()
+        cur3.binary = True
+        cur1.execute("select 1")
+        cur2.execute("select %s::int", (2,))
+        cur3.execute("select %s::text", ("a",))
+        self.wait(self.conn)
+        self.assertEquals(cur1.fetchone()[0], 1)
+        self.assertEquals(cur2.fetchone()[0], 2)
+        self.assertEquals(cur3.fetchone()[0], "a")
+
+    @skip_if_no_pg_sleep('conn')
+    def test_async_queue_cancel(self):
+        cur1 = self.conn.cursor()
+        cur2 = self.conn.cursor()
+        cur3 = self.conn.cursor()
+        cur1.execute("select pg_sleep(10)")
+        cur2.execute("select 42")
+        cur3.execute("select 43; select 44")
+        self.conn.cancel()
+        self.assertRaises(psycopg2.extensions.QueryCanceledError,
+                          self.wait, self.conn)
+
+        # the pipelined query was already sent: only the queued one is lost
+        self.wait(self.conn)
+        self.assertFalse(self.conn.isexecuting())
+        try:
+            self.assertEquals(cur2.fetchone()[0], 42)
+        except psycopg2.extensions.QueryCanceledError:
+            pass    # queued too without pipeline mode (libpq < 14)
+        self.assertRaises(psycopg2.extensions.QueryCanceledError,
+                          cur3.fetchone)
+        cur3.execute("select 45")
+        self.wait(cur3)
+        self.assertEquals(cur3.fetchone()[0], 45)
+
     def test_fetch_after_async(self):
         cur = self.conn.cursor()
         cur.execute("select 'a'")
@@ -142,6 +226,14 @@ class AsyncTests(unittest.TestCase):
         self.wait(cur)
         self.assertEquals(cur.fetchall()[0][0], "a")
 
+    def test_description_after_async(self):
+        cur = self.conn.cursor()
+        cur.execute("select 'a' as x")
+        self.wait(cur)
+        self.assertEquals(cur.fetchall()[0][0], "a")
+        # the result is freed after the last row, not the description
+        self.assertEquals("x", cur.description[0][0])
+
     def test_rollback_while_async(self):
         cur = self.conn.cursor()
 
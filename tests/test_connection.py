@@ -111,6 +111,201 @@ class ConnectionTests(unittest.TestCase):
         self.assert_(time.time() - t0 < 3,
             "something broken in concurrency")
 
+    def test_connect_fastest(self):
+        from psycopg2.extensions import connect_fastest
+        conn = connect_fastest(["dbname=nosuchdb_psycopg2_test", tests.dsn])
+        try:
+            self.assertEqual(conn.async, 0)
+            self.assertEqual(conn.dsn, tests.dsn)
+            curs = conn.cursor()
+            curs.execute("select 1")
+            self.assertEqual(curs.fetchone()[0], 1)
+        finally:
+            conn.close()
+
+    def test_connect_fastest_fails(self):
+        from psycopg2.extensions import connect_fastest
+        self.assertRaises(ValueError, connect_fastest, [])
+        self.assertRaises(psycopg2.OperationalError, connect_fastest,
+            ["dbname=nosuchdb_psycopg2_test", "dbname=nosuchdb_psycopg2_test"])
+
+    def test_connect_fastest_standby(self):
+        from psycopg2.extensions import connect_fastest
+        if self.conn.server_version < 90000:
+            return self.skipTest("pg_is_in_recovery() not available")
+        curs = self.conn.cursor()
+        curs.execute("select pg_is_in_recovery()")
+        recovery = curs.fetchone()[0]
+        conn = connect_fastest([tests.dsn], standby=recovery, timeout=10)
+        conn.close()
+        self.assertRaises(psycopg2.OperationalError,
+            connect_fastest, [tests.dsn], standby=not recovery)
+
+    def test_stats(self):
+        conn = self.conn
+        stats = conn.stats
+        self.assertEqual(0, stats['queries'])
+        self.assertEqual(0, stats['rows'])
+        self.assertEqual(0.0, stats['wait_time'])
+
+        # not collected by default
+        curs = conn.cursor()
+        curs.execute("select 1")
+        curs.fetchall()
+        self.assertEqual(stats, conn.stats)
+
+        conn.collect_stats = True
+        curs.execute("select %s from generate_series(1, 10)", ('x' * 100,))
+        curs.fetchone()
+        curs.fetchall()
+        stats = conn.stats
+        self.assert_(stats['queries'] >= 1)
+        self.assert_(stats['bytes_sent'] >= 100)
+        self.assert_(stats['bytes_received'] >= 10)
+        self.assertEqual(10, stats['rows'])
+        self.assertEqual(0, stats['copy_bytes'])
+        for k in ('wait_time', 'decode_time', 'adapt_time'):
+            self.assert_(stats[k] > 0, k)
+
+        conn.reset_stats()
+        self.assertEqual(0, conn.stats['queries'])
+        self.assertEqual(0, conn.stats['rows'])
+        self.assertEqual(0.0, conn.stats['decode_time'])
+
+
+class PreparedCacheTests(unittest.TestCase):
+
+    def setUp(self):
+        self.conn = psycopg2.connect(tests.dsn)
+
+    def tearDown(self):
+        self.conn.close()
+
+    def prepared_count(self):
+        # don't let the query itself pollute the cache
+        threshold = self.conn.prepare_threshold
+        self.conn.prepare_threshold = 0
+        try:
+            cur = self.conn.cursor()
+            cur.execute("select count(*) from pg_prepared_statements"
+                " where name like '_psyco_prep_%'")
+            return cur.fetchone()[0]
+        finally:
+            self.conn.prepare_threshold = threshold
+
+    def test_disabled_by_default(self):
+        self.assertEqual(0, self.conn.prepare_threshold)
+        cur = self.conn.cursor()
+        for i in range(3):
+            cur.execute("select 1")
+        self.assertEqual(0, self.conn.prepared_hits)
+        self.assertEqual(0, self.conn.prepared_misses)
+        self.assertEqual(0, self.prepared_count())
+
+    def test_prepare_after_threshold(self):
+        conn = self.conn
+        conn.prepare_threshold = 2
+        cur = conn.cursor()
+        cur.execute("select 1")
+        self.assertEqual((0, 1), (conn.prepared_hits, conn.prepared_misses))
+        self.assertEqual(0, self.prepared_count())
+        for i in range(3):
+            cur.execute("select 1")
+            self.assertEqual(1, cur.fetchone()[0])
+        self.assertEqual((3, 1), (conn.prepared_hits, conn.prepared_misses))
+        self.assertEqual(1, self.prepared_count())
+
+    def test_prepare_server_params(self):
+        conn = self.conn
+        conn.prepare_threshold = 1
+        conn.server_params = True
+        cur = conn.cursor()
+        for i in range(3):
+            cur.execute("select %s, %s", (i, 'foo'))
+            self.assertEqual((i, 'foo'), cur.fetchone())
+        self.assertEqual(3, conn.prepared_hits)
+
+        # different types, different statement
+        cur.execute("select %s, %s", (10 ** 12, 'foo'))
+        self.assertEqual((10 ** 12, 'foo'), cur.fetchone())
+        self.assertEqual(2, self.prepared_count())
+
+    def test_not_preparable(self):
+        conn = self.conn
+        conn.prepare_threshold = 1
+        cur = conn.cursor()
+        cur.execute("create temp table testprep (id int)")
+        cur.execute("insert into testprep values (1); select 1;")
+        cur.execute("select 1; ")
+        self.assertEqual(1, self.prepared_count())
+        self.assertEqual(1, conn.prepared_hits)
+        self.assertEqual(0, conn.prepared_misses)
+
+    def test_eviction(self):
+        conn = self.conn
+        conn.prepare_threshold = 1
+        conn.prepared_max = 2
+        cur = conn.cursor()
+        for i in range(5):
+            cur.execute("select %d" % i)
+        # the evicted statements are deallocated after the transaction
+        self.assertEqual(psycopg2.extensions.TRANSACTION_STATUS_INTRANS,
+            conn.get_transaction_status())
+        self.assertEqual(5, self.prepared_count())
+        conn.commit()
+        self.assertEqual(2, self.prepared_count())
+
+    def test_eviction_autocommit(self):
+        conn = self.conn
+        conn.set_isolation_level(
+            psycopg2.extensions.ISOLATION_LEVEL_AUTOCOMMIT)
+        conn.prepare_threshold = 1
+        conn.prepared_max = 2
+        cur = conn.cursor()
+        for i in range(5):
+            cur.execute("select %d" % i)
+        self.assertEqual(2, self.prepared_count())
+
+    def test_invalidate_on_schema_change(self):
+        conn = self.conn
+        conn.set_isolation_level(
+            psycopg2.extensions.ISOLATION_LEVEL_AUTOCOMMIT)
+        conn.prepare_threshold = 1
+        cur = conn.cursor()
+        cur.execute("create temp table testprep (id int)")
+        cur.execute("select * from testprep")
+        cur.execute("alter table testprep add data text")
+        try:
+            cur.execute("select * from testprep")
+        except psycopg2.NotSupportedError:
+            # the statement is prepared again at the next execution
+            cur.execute("select * from testprep")
+        self.assertEqual(2, len(cur.description))
+
+    def test_invalidate_on_discard(self):
+        conn = self.conn
+        conn.set_isolation_level(
+            psycopg2.extensions.ISOLATION_LEVEL_AUTOCOMMIT)
+        conn.prepare_threshold = 1
+        cur = conn.cursor()
+        cur.execute("select 1")
+        cur.execute("deallocate all")
+        self.assertRaises(psycopg2.OperationalError,
+            cur.execute, "select 1")
+        cur.execute("select 1")
+        self.assertEqual(1, cur.fetchone()[0])
+
+    def test_reset(self):
+        conn = self.conn
+        conn.prepare_threshold = 1
+        cur = conn.cursor()
+        cur.execute("select 1")
+        conn.reset()
+        self.assertEqual(0, self.prepared_count())
+        cur = conn.cursor()
+        cur.execute("select 1")
+        self.assertEqual(1, cur.fetchone()[0])
+
 
 class IsolationLevelsTestCase(unittest.TestCase):
 
@@ -143,6 +338,40 @@ class IsolationLevelsTestCase(unittest.TestCase):
             conn.isolation_level,
             psycopg2.extensions.ISOLATION_LEVEL_READ_COMMITTED)
 
+    def test_default_isolation_level(self):
+        # the level is not read on connection: the server default is used
+        conn = self.connect()
+        cur = conn.cursor()
+        cur.execute("show transaction_isolation")
+        level = cur.fetchone()[0]
+        cur.execute("show default_transaction_isolation")
+        self.assertEqual(level, cur.fetchone()[0])
+
+    def test_isolation_level_failed_transaction(self):
+        conn = self.connect()
+        cur = conn.cursor()
+        self.assertRaises(psycopg2.ProgrammingError,
+            cur.execute, "select * from nosuchtable")
+        self.assertRaises(psycopg2.InternalError,
+            getattr, conn, 'isolation_level')
+        conn.rollback()
+        level = conn.isolation_level
+
+        # once read the level is kept
+        self.assertRaises(psycopg2.ProgrammingError,
+            cur.execute, "select * from nosuchtable")
+        self.assertEqual(level, conn.isolation_level)
+        conn.rollback()
+
+    def test_set_default_isolation_level_no_abort(self):
+        conn = self.connect()
+        cur = conn.cursor()
+        cur.execute("select 1")
+        conn.set_isolation_level(
+            psycopg2.extensions.ISOLATION_LEVEL_READ_COMMITTED)
+        self.assertEqual(psycopg2.extensions.TRANSACTION_STATUS_INTRANS,
+            conn.get_transaction_status())
+
     def test_encoding(self):
         conn = self.connect()
         self.assert_(conn.encoding in psycopg2.extensions.encodings)
@@ -670,6 +899,81 @@ class ConnectionTwoPhaseTests(unittest.TestCase):
         cnn.tpc_prepare()
         self.assertRaises(psycopg2.ProgrammingError, cnn.cancel)
 
+    def _begin_all(self, n, name):
+        conns = []
+        for i in range(n):
+            cnn = self.connect()
+            cnn.tpc_begin(cnn.xid(1, "%s-%d" % (name, i), "bqual"))
+            cur = cnn.cursor()
+            cur.execute("insert into test_tpc values (%s);", (name,))
+            conns.append(cnn)
+        return conns
+
+    def test_tpc_commit_all(self):
+        from psycopg2.extensions import tpc_commit_all
+        conns = self._begin_all(3, 'test_tpc_commit_all')
+        conns[0].tpc_prepare()
+        tpc_commit_all(conns)
+        for cnn in conns:
+            self.assertEqual(cnn.status, psycopg2.extensions.STATUS_READY)
+        self.assertEqual(0, self.count_xacts())
+        self.assertEqual(3, self.count_test_records())
+
+        # the connections can start a new transaction
+        conns[0].tpc_begin("again")
+        conns[0].tpc_commit()
+
+    def test_tpc_prepare_all(self):
+        from psycopg2.extensions import tpc_prepare_all, tpc_commit_all
+        conns = self._begin_all(3, 'test_tpc_prepare_all')
+        tpc_prepare_all(conns)
+        for cnn in conns:
+            self.assertEqual(cnn.status, psycopg2.extensions.STATUS_PREPARED)
+        self.assertEqual(3, self.count_xacts())
+        self.assertEqual(0, self.count_test_records())
+
+        self.assertRaises(psycopg2.ProgrammingError, tpc_prepare_all, conns)
+        tpc_commit_all(conns)
+        self.assertEqual(0, self.count_xacts())
+        self.assertEqual(3, self.count_test_records())
+
+    def test_tpc_prepare_all_error(self):
+        from psycopg2.extensions import tpc_commit_all
+        conns = self._begin_all(3, 'test_tpc_prepare_all_error')
+        # the same xid can't be prepared twice
+        cnn = self.connect()
+        cnn.tpc_begin(conns[1].xid(1, "test_tpc_prepare_all_error-1", "bqual"))
+        cnn.cursor().execute("insert into test_tpc values ('dup');")
+        conns.append(cnn)
+
+        self.assertRaises(psycopg2.Error, tpc_commit_all, conns)
+        for cnn in conns:
+            self.assertEqual(cnn.status, psycopg2.extensions.STATUS_READY)
+        self.assertEqual(0, self.count_xacts())
+        self.assertEqual(0, self.count_test_records())
+
+    def test_tpc_rollback_all(self):
+        from psycopg2.extensions import tpc_rollback_all
+        conns = self._begin_all(3, 'test_tpc_rollback_all')
+        conns[1].tpc_prepare()
+        tpc_rollback_all(conns)
+        for cnn in conns:
+            self.assertEqual(cnn.status, psycopg2.extensions.STATUS_READY)
+        self.assertEqual(0, self.count_xacts())
+        self.assertEqual(0, self.count_test_records())
+
+    def test_tpc_all_bad_args(self):
+        from psycopg2.extensions import tpc_commit_all
+        cnn = self.connect()
+        self.assertRaises(psycopg2.ProgrammingError, tpc_commit_all, [cnn])
+        cnn.tpc_begin("test_tpc_all_bad_args")
+        self.assertRaises(psycopg2.ProgrammingError,
+            tpc_commit_all, [cnn, cnn])
+        self.assertRaises(TypeError, tpc_commit_all, [cnn, 1])
+        self.assertRaises(TypeError, tpc_commit_all, 1)
+        tpc_commit_all([])
+        cnn.tpc_rollback()
+
 decorate_all_tests(ConnectionTwoPhaseTests, skip_if_tpc_disabled)
 
 
@@ -4,6 +4,7 @@ import unittest
 import psycopg2
 import psycopg2.extensions
 import tests
+from decimal import Decimal
 
 class CursorTests(unittest.TestCase):
 
@@ -23,6 +24,85 @@ class CursorTests(unittest.TestCase):
             cur.executemany, "insert into test_exc values (%s)", buggygen())
         cur.close()
 
+    def test_executemany_paged(self):
+        cur = self.conn.cursor()
+        cur.execute("create temp table test_paged (id int, data text)")
+        cur.executemany("insert into test_paged values (%s, %s)",
+            [(i, str(i)) for i in range(25)], page_size=10)
+        self.assertEqual(25, cur.rowcount)
+        cur.execute("select count(*), sum(id) from test_paged")
+        self.assertEqual((25, sum(range(25))), cur.fetchone())
+
+    def test_executemany_paged_server_params(self):
+        cur = self.conn.cursor()
+        cur.server_params = True
+        cur.execute("create temp table test_paged (id int, data text)")
+        cur.executemany("insert into test_paged values (%(id)s, %(data)s)",
+            [{'id': i, 'data': str(i)} for i in range(25)], page_size=10)
+        self.assertEqual(25, cur.rowcount)
+        cur.execute("select count(*), sum(id) from test_paged")
+        self.assertEqual((25, sum(range(25))), cur.fetchone())
+
+    def test_executemany_paged_comment(self):
+        # a trailing comment doesn't swallow the following queries
+        cur = self.conn.cursor()
+        cur.execute("create temp table test_paged (id int, data text)")
+        cur.executemany("insert into test_paged values (%s, %s) -- load",
+            [(i, str(i)) for i in range(25)], page_size=10)
+        self.assertEqual(25, cur.rowcount)
+        cur.execute("select count(*) from test_paged")
+        self.assertEqual(25, cur.fetchone()[0])
+
+    def test_executemany_paged_large(self):
+        # a page bigger than the socket buffers must not deadlock
+        cur = self.conn.cursor()
+        cur.server_params = True
+        cur.execute("create temp table test_paged (id int, data text)")
+        cur.executemany("insert into test_paged values (%s, %s)",
+            [(i, 'x' * 2000) for i in range(5000)], page_size=5000)
+        self.assertEqual(5000, cur.rowcount)
+        cur.execute("select count(*) from test_paged")
+        self.assertEqual(5000, cur.fetchone()[0])
+
+    def test_executemany_paged_error(self):
+        cur = self.conn.cursor()
+        cur.execute("create temp table test_paged (id int primary key)")
+        self.assertRaises(psycopg2.IntegrityError,
+            cur.executemany, "insert into test_paged values (%s)",
+            [(1,), (2,), (1,), (3,)], page_size=10)
+        self.conn.rollback()
+
+        self.assertRaises(ValueError,
+            cur.executemany, "select %s", [(1,)], page_size=0)
+
+    def test_execute_values(self):
+        cur = self.conn.cursor()
+        cur.execute("create temp table test_values (id int, data text)")
+        cur.execute_values("insert into test_values values %s",
+            [(i, i % 2 and str(i) or None) for i in range(25)], page_size=10)
+        self.assertEqual(25, cur.rowcount)
+        cur.execute("select count(*), sum(id), count(data) from test_values")
+        self.assertEqual((25, sum(range(25)), 12), cur.fetchone())
+
+    def test_execute_values_returning(self):
+        cur = self.conn.cursor()
+        cur.execute("create temp table test_values (id int, data text)")
+        cur.execute_values(
+            "insert into test_values values %s returning id, '%%'",
+            [(1, 'a'), (2, 'b'), (3, 'c')], page_size=2)
+        self.assertEqual([(3, '%')], cur.fetchall())
+
+    def test_execute_values_bad_query(self):
+        cur = self.conn.cursor()
+        self.assertRaises(psycopg2.ProgrammingError,
+            cur.execute_values, "select 1", [(1,)])
+        self.assertRaises(psycopg2.ProgrammingError,
+            cur.execute_values, "values %s, %s", [(1,)])
+        self.assertRaises(psycopg2.ProgrammingError,
+            cur.execute_values, "values %(a)s", [(1,)])
+        self.assertRaises(TypeError,
+            cur.execute_values, "values %s", [1])
+
     def test_mogrify_unicode(self):
         conn = self.conn
         cur = conn.cursor()
@@ -67,6 +147,842 @@ class CursorTests(unittest.TestCase):
         self.assertEqual('SELECT 10.3;',
             cur.mogrify("SELECT %s;", (Decimal("10.3"),)))
 
+    def test_mogrify_placeholders(self):
+        cur = self.conn.cursor()
+        self.assertEqual("SELECT 1, 'a''b', NULL;",
+            cur.mogrify("SELECT %s, %s, %s;", (1, "a'b", None)))
+        self.assertEqual("SELECT 1, 2, 1;",
+            cur.mogrify("SELECT %(a)s, %(b)s, %(a)s;", {'a': 1, 'b': 2}))
+        self.assertEqual("SELECT 10% of 3;",
+            cur.mogrify("SELECT 10%% of %s;", (3,)))
+        self.assertEqual("SELECT 10%;", cur.mogrify("SELECT 10%%;", ()))
+
+    def test_mogrify_same_query(self):
+        cur = self.conn.cursor()
+        q = "SELECT %s, %s;"
+        self.assertEqual("SELECT 1, 2;", cur.mogrify(q, (1, 2)))
+        self.assertEqual("SELECT 'x', NULL;", cur.mogrify(q, ('x', None)))
+        self.assertEqual("SELECT 3, 4;", cur.mogrify("SELECT %s, %s;", [3, 4]))
+        self.assertEqual("SELECT 5;", cur.mogrify("SELECT %s;", (5,)))
+
+    def test_mogrify_errors(self):
+        cur = self.conn.cursor()
+        self.assertRaises(psycopg2.ProgrammingError,
+            cur.mogrify, "SELECT %s;", (1, 2))
+        self.assertRaises(IndexError, cur.mogrify, "SELECT %s, %s;", (1,))
+        self.assertRaises(KeyError, cur.mogrify, "SELECT %(a)s;", {})
+        self.assertRaises(psycopg2.ProgrammingError,
+            cur.mogrify, "SELECT %s, %(a)s;", (1,))
+
+    def test_server_params(self):
+        cur = self.conn.cursor()
+        cur.server_params = True
+        cur.execute("SELECT %s, %s, %s, %s, %s;",
+            (42, 'foo', 1.5, True, None))
+        self.assertEqual("SELECT $1, $2, $3, $4, NULL;", cur.query)
+        self.assertEqual((42, 'foo', Decimal('1.5'), True, None),
+            cur.fetchone())
+
+        bigint = 10 ** 12
+        cur.execute("SELECT %(a)s, %(b)s, %(a)s = 'x', 100 %% 7;",
+            {'a': 'x', 'b': bigint})
+        self.assertEqual("SELECT $1, $2, $1 = 'x', 100 % 7;", cur.query)
+        self.assertEqual(('x', bigint, True, 2), cur.fetchone())
+
+    def test_server_params_inline(self):
+        # values with no plain literal representation are quoted inline
+        import datetime
+        cur = self.conn.cursor()
+        cur.server_params = True
+        d = datetime.date(2010, 11, 24)
+        cur.execute("SELECT %s, %s;", (d, [1.5, 2.5]))
+        self.assertEqual("SELECT '2010-11-24'::date, ARRAY[1.5, 2.5];",
+            cur.query)
+        self.assertEqual((d, [Decimal('1.5'), Decimal('2.5')]),
+            cur.fetchone())
+
+    def test_server_params_array(self):
+        cur = self.conn.cursor()
+        cur.server_params = True
+        cur.execute("SELECT %s, %s, %s, %s;", ([1, None, 3], [1, 10 ** 12],
+            ['a', 'b"c', None, 'd\\e'], [10 ** 30]))
+        self.assertEqual("SELECT $1, $2, $3, ARRAY[%d];" % 10 ** 30,
+            cur.query)
+        self.assertEqual(([1, None, 3], [1, 10 ** 12],
+            ['a', 'b"c', None, 'd\\e'], [10 ** 30]), cur.fetchone())
+        cur.execute("SELECT 1 = ANY(%s);", ([1, 2],))
+        self.assertEqual(True, cur.fetchone()[0])
+
+    def test_server_params_binary(self):
+        cur = self.conn.cursor()
+        cur.server_params = True
+        data = ''.join(map(chr, range(256)))
+        cur.execute("SELECT %s, %s;", (psycopg2.Binary(data), buffer(data)))
+        self.assertEqual("SELECT $1, $2;", cur.query)
+        row = cur.fetchone()
+        self.assertEqual(data, str(row[0]))
+        self.assertEqual(data, str(row[1]))
+
+    def test_server_params_unicode(self):
+        self.conn.set_client_encoding('UTF8')
+        cur = self.conn.cursor()
+        cur.server_params = True
+        snowman = u"\u2603"
+        cur.execute("SELECT %s;", (snowman,))
+        self.assertEqual(snowman.encode("utf-8"), cur.fetchone()[0])
+
+    def test_server_params_errors(self):
+        cur = self.conn.cursor()
+        cur.server_params = True
+        self.assertRaises(psycopg2.ProgrammingError,
+            cur.execute, "SELECT %d;", (10,))
+        self.assertRaises(psycopg2.ProgrammingError,
+            cur.execute, "SELECT %s;", (10, 20))
+        self.assertRaises(psycopg2.ProgrammingError,
+            cur.execute, "SELECT %(a)s, %s;", {"a": 10})
+
+    def test_server_params_from_connection(self):
+        self.conn.server_params = True
+        cur = self.conn.cursor()
+        self.assert_(cur.server_params)
+        cur.execute("SELECT %s;", (10,))
+        self.assertEqual("SELECT $1;", cur.query)
+        self.assertEqual(10, cur.fetchone()[0])
+
+    def test_casts_cache(self):
+        curs = self.conn.cursor()
+        curs.execute("select 1 as a, 'x'::text as b")
+        d1 = curs.description
+        curs.execute("select 2 as a, 'y'::text as b")
+        self.assertEqual(d1, curs.description)
+        self.assertEqual((2, 'y'), curs.fetchone())
+        curs.execute("select 2 as a, 'y'::text as c")
+        self.assertEqual('c', curs.description[1][0])
+
+    def test_description_lazy(self):
+        curs = self.conn.cursor()
+        self.assertEqual(None, curs.description)
+        curs.execute("select 1 as a, 'x'::text as b")
+        d1 = curs.description
+        self.assert_(d1 is curs.description)
+        self.assertEqual(['a', 'b'], [d[0] for d in d1])
+        self.assertEqual((1, 'x'), curs.fetchone())
+        self.assert_(d1 is curs.description)
+        # the results of the same shape share the description
+        curs.execute("select 2 as a, 'y'::text as b")
+        self.assert_(d1 is curs.description)
+        curs.execute("set datestyle to iso")
+        self.assertEqual(None, curs.description)
+
+    def test_shared_cursor_threads(self):
+        # a fetch is not interrupted by the execute() of another thread,
+        # not even when a typecaster releases the GIL
+        import threading, time
+        curs = self.conn.cursor()
+        def slow(s, cur):
+            time.sleep(0.0001)
+            return s
+        SLOW = psycopg2.extensions.new_type((25,), "SLOW", slow)
+        psycopg2.extensions.register_type(SLOW, curs)
+
+        errors = []
+        def work(n):
+            for i in range(20):
+                curs.execute(
+                    "select %s::text from generate_series(1, 20)", (str(n),))
+                rows = curs.fetchall()
+                if len(set(rows)) > 1 or len(rows) not in (0, 20):
+                    errors.append(rows)
+
+        threads = [threading.Thread(target=work, args=(i,))
+            for i in range(4)]
+        for t in threads:
+            t.start()
+        for t in threads:
+            t.join()
+        self.assertEqual([], errors)
+
+    def test_casts_cache_register_type(self):
+        curs = self.conn.cursor()
+        curs.execute("select 'x'::text")
+        self.assertEqual('x', curs.fetchone()[0])
+        UPPER = psycopg2.extensions.new_type((25,), "UPPER",
+            lambda s, cur: s is not None and s.upper() or s)
+        psycopg2.extensions.register_type(UPPER, self.conn)
+        curs.execute("select 'x'::text")
+        self.assertEqual('X', curs.fetchone()[0])
+        # a new connection doesn't see the typecaster
+        conn = psycopg2.connect(tests.dsn)
+        curs = conn.cursor()
+        curs.execute("select 'x'::text")
+        self.assertEqual('x', curs.fetchone()[0])
+        conn.close()
+
+    def test_casts_cache_string_types_changed(self):
+        curs = self.conn.cursor()
+        curs.execute("select 'x'::text")
+        self.assertEqual('x', curs.fetchone()[0])
+        UPPER = psycopg2.extensions.new_type((25,), "UPPER",
+            lambda s, cur: s is not None and s.upper() or s)
+        self.conn.string_types[25] = UPPER
+        curs.execute("select 'x'::text")
+        self.assertEqual('X', curs.fetchone()[0])
+        del self.conn.string_types[25]
+        curs.execute("select 'x'::text")
+        self.assertEqual('x', curs.fetchone()[0])
+
+    def test_builtin_casts(self):
+        curs = self.conn.cursor()
+        curs.execute("""select 1, 'a'::text, ''::text, null::text,
+            array[1,2], 1.5::float8, null::int""")
+        self.assertEqual((1, 'a', '', None, [1, 2], 1.5, None),
+            curs.fetchone())
+
+    def test_python_cast_in_row(self):
+        BOOM = psycopg2.extensions.new_type((23,), "BOOM",
+            lambda s, cur: s is not None and 'boom' or s)
+        curs = self.conn.cursor()
+        psycopg2.extensions.register_type(BOOM, curs)
+        curs.execute("select 1, 'a'::text, null::int")
+        self.assertEqual(('boom', 'a', None), curs.fetchone())
+
+
+class StreamingTests(unittest.TestCase):
+    def setUp(self):
+        self.conn = psycopg2.connect(tests.dsn)
+
+    def tearDown(self):
+        self.conn.close()
+
+    def test_iter(self):
+        curs = self.conn.cursor()
+        curs.streaming = 10
+        curs.execute("select x, 'x' || x from generate_series(1, 95) x")
+        self.assertEqual(10, curs.rowcount)
+        rows = list(curs)
+        self.assertEqual(95, len(rows))
+        self.assertEqual((1, 'x1'), rows[0])
+        self.assertEqual((95, 'x95'), rows[-1])
+        self.assertEqual(95, curs.rowcount)
+        self.assertEqual(95, curs.rownumber)
+
+    def test_fetch(self):
+        curs = self.conn.cursor()
+        curs.streaming = 7
+        curs.execute("select x from generate_series(1, 50) x")
+        self.assertEqual((1,), curs.fetchone())
+        self.assertEqual([(i,) for i in range(2, 22)], curs.fetchmany(20))
+        self.assertEqual([(i,) for i in range(22, 51)], curs.fetchall())
+        self.assertEqual(None, curs.fetchone())
+        self.assertEqual([], curs.fetchall())
+
+    def test_empty_and_command(self):
+        curs = self.conn.cursor()
+        curs.streaming = 10
+        curs.execute("select 1 where false")
+        self.assertEqual([], curs.fetchall())
+        curs.execute("create temp table tstream (id int)")
+        self.assertRaises(psycopg2.ProgrammingError, curs.fetchone)
+        curs.execute("insert into tstream select generate_series(1, 5)")
+        self.assertEqual(5, curs.rowcount)
+
+    def test_discard(self):
+        curs = self.conn.cursor()
+        curs.streaming = 10
+        curs.execute("select x from generate_series(1, 1000) x")
+        curs.fetchone()
+        # a new query drops the rows pending
+        curs.execute("select 42")
+        self.assertEqual((42,), curs.fetchone())
+        curs.execute("select x from generate_series(1, 1000) x")
+        curs.close()
+        self.conn.commit()
+
+    def test_busy(self):
+        curs = self.conn.cursor()
+        curs.streaming = 10
+        curs.execute("select x from generate_series(1, 100) x")
+        # the connection is busy until the rows are finished
+        self.assertRaises(psycopg2.ProgrammingError, self.conn.commit)
+        self.assertRaises(psycopg2.ProgrammingError,
+            self.conn.cursor().execute, "select 1")
+        self.assertEqual(100, len(curs.fetchall()))
+        curs2 = self.conn.cursor()
+        curs2.execute("select 1")
+        self.assertEqual((1,), curs2.fetchone())
+        self.conn.commit()
+
+    def test_error(self):
+        curs = self.conn.cursor()
+        curs.streaming = 2
+        curs.execute("select 1 / (5 - x) from generate_series(1, 10) x")
+        self.assertRaises(psycopg2.DataError, curs.fetchall)
+        self.conn.rollback()
+        curs.execute("select 1")
+        self.assertEqual((1,), curs.fetchone())
+
+    def test_scroll(self):
+        curs = self.conn.cursor()
+        curs.streaming = 10
+        curs.execute("select x from generate_series(1, 30) x")
+        curs.fetchmany(15)
+        curs.scroll(-3)
+        self.assertEqual((13,), curs.fetchone())
+        self.assertRaises(psycopg2.ProgrammingError, curs.scroll, 0, 'absolute')
+
+
+class ResultLimitTests(unittest.TestCase):
+    def setUp(self):
+        self.conn = psycopg2.connect(tests.dsn)
+
+    def tearDown(self):
+        self.conn.close()
+
+    def test_result_memory(self):
+        curs = self.conn.cursor()
+        self.assertEqual(0, curs.result_memory)
+        curs.execute("select repeat('x', 100) from generate_series(1, 10)")
+        small = curs.result_memory
+        self.assert_(small > 1000, small)
+        curs.execute("select repeat('x', 100) from generate_series(1, 100)")
+        self.assert_(curs.result_memory > small * 5, curs.result_memory)
+
+    def test_default(self):
+        self.assertEqual(0, self.conn.result_limit)
+        self.conn.result_limit = 1000
+        curs = self.conn.cursor()
+        self.assertEqual(1000, curs.result_limit)
+        self.assertEqual(False, curs.result_limit_stream)
+
+    def test_within_limit(self):
+        curs = self.conn.cursor()
+        curs.result_limit = 100000
+        curs.execute("select x from generate_series(1, 100) x")
+        self.assertEqual(100, curs.rowcount)
+        self.assertEqual([(i,) for i in range(1, 101)], curs.fetchall())
+
+    def test_exceeded(self):
+        curs = self.conn.cursor()
+        curs.result_limit = 10000
+        self.assertRaises(psycopg2.OperationalError, curs.execute,
+            "select repeat('x', 100) from generate_series(1, 1000)")
+        # the connection is still usable
+        curs.execute("select 42")
+        self.assertEqual((42,), curs.fetchone())
+
+    def test_exceeded_named(self):
+        curs = self.conn.cursor('tmp')
+        curs.result_limit = 10000
+        curs.execute("select repeat('x', 100) from generate_series(1, 1000)")
+        self.assertEqual(50, len(curs.fetchmany(50)))
+        self.assertRaises(psycopg2.OperationalError, curs.fetchall)
+
+    def test_exceeded_stream(self):
+        curs = self.conn.cursor()
+        curs.result_limit = 10000
+        curs.result_limit_stream = True
+        curs.execute("select x, repeat('x', 100) from generate_series(1, 1000) x")
+        self.assert_(0 < curs.rowcount < 1000, curs.rowcount)
+        self.assert_(curs.result_memory < 20000, curs.result_memory)
+        n = 0
+        for i, record in enumerate(curs):
+            self.assertEqual(i + 1, record[0])
+            self.assert_(curs.result_memory < 20000, curs.result_memory)
+            n += 1
+        self.assertEqual(1000, n)
+        self.assertEqual(1000, curs.rowcount)
+
+
+class ItersizeTests(unittest.TestCase):
+    def setUp(self):
+        self.conn = psycopg2.connect(tests.dsn)
+
+    def tearDown(self):
+        self.conn.close()
+
+    def test_default(self):
+        curs = self.conn.cursor('tmp')
+        self.assertEqual(2000, curs.itersize)
+
+    def test_iter(self):
+        curs = self.conn.cursor('tmp')
+        curs.itersize = 10
+        curs.execute("select x from generate_series(1, 95) x")
+        rows = list(curs)
+        self.assertEqual([(i,) for i in range(1, 96)], rows)
+        # one fetch of 10 rows was enough for the last batch
+        self.assertEqual(5, curs.rowcount)
+
+    def test_fetch_after_iter(self):
+        curs = self.conn.cursor('tmp')
+        curs.itersize = 10
+        curs.execute("select x from generate_series(1, 50) x")
+        self.assertEqual((1,), curs.next())
+        self.assertEqual((2,), curs.fetchone())
+        self.assertEqual([(i,) for i in range(3, 6)], curs.fetchmany(3))
+        self.assertEqual([(i,) for i in range(6, 21)], curs.fetchmany(15))
+        self.assertEqual((21,), curs.next())
+        self.assertEqual([(i,) for i in range(22, 51)], curs.fetchall())
+        self.assertRaises(StopIteration, curs.next)
+
+    def test_scroll_after_iter(self):
+        curs = self.conn.cursor('tmp')
+        curs.itersize = 10
+        curs.execute("select x from generate_series(1, 50) x")
+        curs.next()
+        curs.next()
+        curs.scroll(3)
+        self.assertEqual((6,), curs.fetchone())
+
+
+class FetchColumnsTests(unittest.TestCase):
+    def setUp(self):
+        self.conn = psycopg2.connect(tests.dsn)
+
+    def tearDown(self):
+        self.conn.close()
+
+    def _values(self, col):
+        import struct
+        data = str(buffer(col))
+        fmt = {'int64': 'q', 'float64': 'd', 'bool': '?',
+            'datetime64[D]': 'q', 'datetime64[us]': 'q'}[col.dtype]
+        return list(struct.unpack('=%d%s' % (len(col), fmt), data))
+
+    def test_typed(self):
+        curs = self.conn.cursor()
+        curs.execute("""select x, x / 2.0::float8, x % 2 = 0,
+            nullif(x, 2), 'x' || x from generate_series(1, 4) x""")
+        cols = curs.fetch_columns()
+        self.assertEqual(5, len(cols))
+        self.assertEqual('int64', cols[0].dtype)
+        self.assertEqual([1, 2, 3, 4], self._values(cols[0]))
+        self.assertEqual('float64', cols[1].dtype)
+        self.assertEqual([0.5, 1.0, 1.5, 2.0], self._values(cols[1]))
+        self.assertEqual([False, True, False, True], self._values(cols[2]))
+        self.assertEqual([1, 0, 3, 4], self._values(cols[3]))
+        self.assertEqual('\x00\x01\x00\x00', cols[3].mask)
+        self.assertEqual(['x1', 'x2', 'x3', 'x4'], cols[4])
+        self.assertEqual([], curs.fetchall())
+
+    def test_dates(self):
+        curs = self.conn.cursor()
+        curs.execute("set timezone to 'UTC'")
+        curs.execute("""select '1970-01-02'::date,
+            '1970-01-01 00:00:01.5'::timestamp,
+            '1970-01-01 01:00:00+01'::timestamptz""")
+        cols = curs.fetch_columns()
+        self.assertEqual('datetime64[D]', cols[0].dtype)
+        self.assertEqual([1], self._values(cols[0]))
+        self.assertEqual('datetime64[us]', cols[1].dtype)
+        self.assertEqual([1500000], self._values(cols[1]))
+        self.assertEqual([0], self._values(cols[2]))
+
+    def test_infinity(self):
+        curs = self.conn.cursor()
+        curs.execute("select 'infinity'::date")
+        self.assertRaises(psycopg2.DataError, curs.fetch_columns)
+
+    def test_binary(self):
+        curs = self.conn.cursor()
+        curs.binary = True
+        curs.server_params = True
+        curs.execute("""select x::int2, x::int8, x / 4.0::float4,
+            '2000-01-01'::date + x from generate_series(1, 3) x""")
+        cols = curs.fetch_columns()
+        self.assertEqual([1, 2, 3], self._values(cols[0]))
+        self.assertEqual([1, 2, 3], self._values(cols[1]))
+        self.assertEqual([0.25, 0.5, 0.75], self._values(cols[2]))
+        self.assertEqual([10958, 10959, 10960], self._values(cols[3]))
+
+    def test_remaining_rows(self):
+        curs = self.conn.cursor()
+        curs.execute("select x from generate_series(1, 5) x")
+        curs.fetchmany(2)
+        self.assertEqual([3, 4, 5], self._values(curs.fetch_columns()[0]))
+
+    def test_named(self):
+        curs = self.conn.cursor('tmp')
+        curs.itersize = 3
+        curs.execute("select x from generate_series(1, 10) x")
+        curs.next()
+        col = curs.fetch_columns()[0]
+        self.assertEqual(range(2, 11), self._values(col))
+
+    def test_python_typecaster(self):
+        curs = self.conn.cursor()
+        BOOM = psycopg2.extensions.new_type((23,), "BOOM",
+            lambda s, cur: s is not None and 'boom' or s)
+        psycopg2.extensions.register_type(BOOM, curs)
+        curs.execute("select 1")
+        self.assertEqual(['boom'], curs.fetch_columns()[0])
+
+
+class NogilBatchTests(unittest.TestCase):
+    def setUp(self):
+        self.conn = psycopg2.connect(tests.dsn)
+
+    def tearDown(self):
+        self.conn.close()
+
+    QUERY = """select x, x::int8 * 10000000000, x / 4.0::float8, x % 2 = 0,
+        nullif(x, 3), '2010-01-01'::date + x,
+        '2010-01-01 12:34:56.789'::timestamp + x * '1 day'::interval,
+        '2010-01-01 12:34:56+02'::timestamptz + x * '1 day'::interval,
+        'x' || x, case when x = 5 then 'infinity'::date end,
+        1.5::numeric * x
+        from generate_series(1, 11) x"""
+
+    def _fetch(self, batch, fetch, curs=None):
+        if curs is None:
+            curs = self.conn.cursor()
+        curs.nogil_batch = batch
+        curs.execute(self.QUERY)
+        return fetch(curs)
+
+    def test_default(self):
+        self.assertEqual(0, self.conn.cursor().nogil_batch)
+
+    def test_fetchall(self):
+        fetch = lambda curs: curs.fetchall()
+        expected = self._fetch(0, fetch)
+        for batch in (1, 3, 11, 100):
+            self.assertEqual(expected, self._fetch(batch, fetch))
+
+    def test_fetchmany(self):
+        def fetch(curs):
+            rv = []
+            while 1:
+                rows = curs.fetchmany(4)
+                if not rows:
+                    return rv
+                rv.extend(rows)
+
+        expected = self._fetch(0, fetch)
+        self.assertEqual(expected, self._fetch(3, fetch))
+
+    def test_types(self):
+        rows = self._fetch(5, lambda curs: curs.fetchall())
+        self.assertEqual(int, type(rows[0][0]))
+        self.assertEqual(long, type(rows[0][1]))
+        self.assertEqual(float, type(rows[0][2]))
+        self.assertEqual(bool, type(rows[0][3]))
+        self.assertEqual(None, rows[2][4])
+        self.assert_(rows[0][7].tzinfo is not None)
+        self.assertEqual(rows[4][9].max, rows[4][9])
+
+    def test_dictrow(self):
+        import psycopg2.extras
+        fetch = lambda curs: [r.copy() for r in curs.fetchall()]
+        expected = self._fetch(0, fetch,
+            self.conn.cursor(cursor_factory=psycopg2.extras.DictCursor))
+        self.assertEqual(expected, self._fetch(4, fetch,
+            self.conn.cursor(cursor_factory=psycopg2.extras.DictCursor)))
+
+    def test_python_typecaster(self):
+        curs = self.conn.cursor()
+        BOOM = psycopg2.extensions.new_type((23,), "BOOM",
+            lambda s, cur: s is not None and 'boom' or s)
+        psycopg2.extensions.register_type(BOOM, curs)
+        curs.nogil_batch = 10
+        curs.execute("select x, x::float8 from generate_series(1, 3) x")
+        self.assertEqual([('boom', 1.0), ('boom', 2.0), ('boom', 3.0)],
+            curs.fetchall())
+
+
+class InternColumnsTests(unittest.TestCase):
+    def setUp(self):
+        self.conn = psycopg2.connect(tests.dsn)
+
+    def tearDown(self):
+        self.conn.close()
+
+    QUERY = """select 'x' || (i % 3) as s, 'y' || (i % 3) as t,
+        nullif(i % 3, 1)::text as n, i from generate_series(1, 9) i"""
+
+    def test_default(self):
+        curs = self.conn.cursor()
+        self.assertEqual(None, curs.intern_columns)
+        curs.execute(self.QUERY)
+        rows = curs.fetchall()
+        self.assert_(rows[0][0] is not rows[3][0])
+
+    def test_all(self):
+        curs = self.conn.cursor()
+        curs.intern_columns = True
+        curs.execute(self.QUERY)
+        rows = curs.fetchall()
+        self.assertEqual(['x1', 'x2', 'x0'] * 3, [r[0] for r in rows])
+        self.assert_(rows[0][0] is rows[3][0])
+        self.assert_(rows[1][1] is rows[7][1])
+        self.assertEqual(None, rows[0][2])
+        self.assertEqual(range(1, 10), [r[3] for r in rows])
+
+    def test_selected(self):
+        curs = self.conn.cursor()
+        curs.intern_columns = ('t', 2)
+        self.assertEqual(('t', 2), curs.intern_columns)
+        curs.execute(self.QUERY)
+        rows = [curs.fetchone() for i in range(9)]
+        self.assert_(rows[0][0] is not rows[3][0])
+        self.assert_(rows[0][1] is rows[3][1])
+        self.assert_(rows[1][2] is rows[4][2])
+
+    def test_unicode(self):
+        curs = self.conn.cursor()
+        psycopg2.extensions.register_type(psycopg2.extensions.UNICODE, curs)
+        curs.intern_columns = True
+        curs.execute(self.QUERY)
+        rows = list(curs)
+        self.assertEqual(unicode, type(rows[0][0]))
+        self.assert_(rows[0][0] is rows[3][0])
+
+    def test_bad_value(self):
+        curs = self.conn.cursor()
+        self.assertRaises(TypeError, setattr, curs, 'intern_columns', 3)
+        self.assertRaises(TypeError, setattr, curs, 'intern_columns', [1.5])
+        curs.intern_columns = False
+        self.assertEqual(None, curs.intern_columns)
+
+
+class ResultCacheTests(unittest.TestCase):
+    def setUp(self):
+        self.conn = psycopg2.connect(tests.dsn)
+        self.conn.set_isolation_level(
+            psycopg2.extensions.ISOLATION_LEVEL_AUTOCOMMIT)
+        self.cache = psycopg2.extensions.ResultCache()
+        self.conn.result_cache = self.cache
+
+    def tearDown(self):
+        self.conn.close()
+
+    def _cursor(self):
+        curs = self.conn.cursor()
+        curs.cache_results = True
+        return curs
+
+    def test_default(self):
+        curs = self.conn.cursor()
+        self.assert_(not curs.cache_results)
+        curs.execute("select random()")
+        curs.execute("select random()")
+        self.assertEqual(0, len(self.cache))
+        self.assertRaises(TypeError, setattr, self.conn, 'result_cache', {})
+
+    def test_hit(self):
+        curs = self._cursor()
+        curs.execute("select random(), %s as x", (10,))
+        r1 = curs.fetchall()
+        curs = self._cursor()
+        curs.execute("select random(), %s as x", (10,))
+        self.assertEqual(['random', 'x'], [d[0] for d in curs.description])
+        self.assertEqual(1, curs.rowcount)
+        self.assertEqual(r1, curs.fetchall())
+        curs.execute("select random(), %s as x", (20,))
+        self.assertNotEqual(r1[0][0], curs.fetchone()[0])
+        self.assertEqual(1, self.cache.hits)
+        self.assertEqual(2, self.cache.misses)
+        self.assertEqual(2, len(self.cache))
+        self.assert_(self.cache.memory > 0)
+
+    def test_values_not_shared(self):
+        curs = self._cursor()
+        curs.execute("select array[1, 2]")
+        a1 = curs.fetchone()[0]
+        a1.append(3)
+        curs.execute("select array[1, 2]")
+        self.assertEqual([1, 2], curs.fetchone()[0])
+        curs.row_factory = psycopg2.extensions.LazyRow
+        curs.execute("select array[1, 2]")
+        self.assertEqual([1, 2], curs.fetchone()[0])
+
+    def test_typecaster(self):
+        curs = self._cursor()
+        curs.execute("select 'x'::text")
+        UPPER = psycopg2.extensions.new_type((25,), "UPPER",
+            lambda s, cur: s is not None and s.upper() or s)
+        curs = self._cursor()
+        psycopg2.extensions.register_type(UPPER, curs)
+        curs.row_factory = psycopg2.extensions.LazyRow
+        curs.execute("select 'x'::text")
+        self.assertEqual(1, self.cache.hits)
+        self.assertEqual('X', curs.fetchone()[0])
+
+    def test_clear(self):
+        curs = self._cursor()
+        curs.execute("select random()")
+        r1 = curs.fetchone()
+        self.cache.discard(curs.query)
+        self.assertEqual(0, len(self.cache))
+        curs.execute("select random()")
+        self.assertNotEqual(r1, curs.fetchone())
+        self.cache.clear()
+        self.assertEqual(0, len(self.cache))
+        self.assertEqual(0, self.cache.memory)
+
+    def test_not_cached(self):
+        curs = self._cursor()
+        curs.execute("create temp table test_rc (id int)")
+        curs.execute("insert into test_rc values (1)")
+        self.assertEqual(0, len(self.cache))
+        curs.binary = True
+        curs.execute("select random()")
+        self.assertEqual(0, len(self.cache))
+
+    def test_not_cached_returning(self):
+        curs = self._cursor()
+        curs.execute("create temp table test_rc (id serial)")
+        curs.execute("insert into test_rc default values returning id")
+        self.assertEqual(1, curs.rowcount)
+        curs.execute("insert into test_rc default values returning id")
+        self.assertEqual(0, self.cache.hits)
+        self.assertEqual(0, len(self.cache))
+
+    def test_not_cached_locking(self):
+        curs = self._cursor()
+        curs.execute("select 1 for update")
+        curs.execute("select 1 FOR  share")
+        curs.execute("select 1 for no key update")
+        self.assertEqual(0, len(self.cache))
+        curs.execute("select 1 as format")
+        self.assertEqual(1, len(self.cache))
+
+    def test_maxsize(self):
+        self.cache.maxsize = 2
+        curs = self._cursor()
+        for i in range(3):
+            curs.execute("select %s", (i,))
+        self.assertEqual(2, len(self.cache))
+        curs.execute("select %s", (2,))
+        self.assertEqual(1, self.cache.hits)
+        curs.execute("select %s", (0,))
+        self.assertEqual(1, self.cache.hits)
+
+    def test_maxsize_discarded(self):
+        self.cache.maxsize = 2
+        curs = self._cursor()
+        for i in range(100):
+            curs.execute("select %s", (i % 5,))
+            self.cache.discard(curs.query)
+        self.assertEqual(0, len(self.cache))
+        for i in range(3):
+            curs.execute("select %s", (i,))
+        self.assertEqual(2, len(self.cache))
+        curs.execute("select %s", (2,))
+        curs.execute("select %s", (1,))
+        self.assertEqual(2, self.cache.hits)
+
+    def test_ttl(self):
+        import time
+        self.cache.ttl = 0.1
+        curs = self._cursor()
+        curs.execute("select random()")
+        r1 = curs.fetchone()
+        curs.execute("select random()")
+        self.assertEqual(r1, curs.fetchone())
+        time.sleep(0.2)
+        curs.execute("select random()")
+        self.assertNotEqual(r1, curs.fetchone())
+
+    def test_notify(self):
+        import time
+        cache = psycopg2.extensions.ResultCache(channels=['test_rc'])
+        self.assertEqual(('test_rc',), cache.channels)
+        self.conn.result_cache = cache
+        curs = self._cursor()
+        curs.execute("listen test_rc")
+        curs.execute("select random()")
+        r1 = curs.fetchone()
+        curs.execute("select random()")
+        self.assertEqual(r1, curs.fetchone())
+
+        conn = psycopg2.connect(tests.dsn)
+        conn.set_isolation_level(
+            psycopg2.extensions.ISOLATION_LEVEL_AUTOCOMMIT)
+        conn.cursor().execute("notify test_rc")
+        conn.close()
+        time.sleep(0.1)
+
+        curs.execute("select random()")
+        self.assertNotEqual(r1, curs.fetchone())
+        self.assertEqual(1, len(self.conn.notifies))
+
+
+class NextsetTests(unittest.TestCase):
+    def setUp(self):
+        self.conn = psycopg2.connect(tests.dsn)
+
+    def tearDown(self):
+        self.conn.close()
+
+    def _cursor(self):
+        curs = self.conn.cursor()
+        curs.multiple_results = True
+        return curs
+
+    def test_default(self):
+        curs = self.conn.cursor()
+        self.assert_(not curs.multiple_results)
+        curs.execute("select 1; select 2")
+        self.assertEqual([(2,)], curs.fetchall())
+        self.assertEqual(None, curs.nextset())
+        self.assertEqual([], curs.fetchall())
+
+    def test_nextset(self):
+        curs = self._cursor()
+        curs.execute("select 1 as a; select 'x' as b, 2 as c "
+            "union all select 'y', 3; create temp table nextset (id int)")
+        self.assertEqual('a', curs.description[0][0])
+        self.assertEqual(1, curs.rowcount)
+        self.assertEqual([(1,)], curs.fetchall())
+
+        self.assert_(curs.nextset())
+        self.assertEqual(['b', 'c'], [d[0] for d in curs.description])
+        self.assertEqual(2, curs.rowcount)
+        self.assertEqual([('x', 2), ('y', 3)], curs.fetchall())
+
+        self.assert_(curs.nextset())
+        self.assertEqual(None, curs.description)
+        self.assertEqual('CREATE TABLE', curs.statusmessage)
+        self.assertRaises(psycopg2.ProgrammingError, curs.fetchone)
+
+        self.assertEqual(None, curs.nextset())
+        self.assertEqual(None, curs.nextset())
+
+    def test_new_query(self):
+        curs = self._cursor()
+        curs.execute("select 1; select 2")
+        curs.execute("select 3")
+        self.assertEqual([(3,)], curs.fetchall())
+        self.assertEqual(None, curs.nextset())
+
+    def test_error(self):
+        curs = self._cursor()
+        self.assertRaises(psycopg2.ProgrammingError,
+            curs.execute, "select 1; select * from nosuchtable; select 3")
+        self.conn.rollback()
+        self.assertEqual(None, curs.nextset())
+
+    def test_executemany(self):
+        curs = self._cursor()
+        curs.executemany("select %s", [(1,), (2,), (3,)], page_size=3)
+        rv = [curs.fetchall()]
+        while curs.nextset():
+            rv.append(curs.fetchall())
+        self.assertEqual([[(1,)], [(2,)], [(3,)]], rv)
+
+    def test_executemany_pipeline(self):
+        curs = self._cursor()
+        curs.server_params = True
+        try:
+            curs.executemany("select %s::int", [(1,), (2,)], page_size=2)
+        except psycopg2.NotSupportedError:
+            return self.skipTest("pipeline mode not supported")
+        self.assertEqual([(1,)], curs.fetchall())
+        self.assert_(curs.nextset())
+        self.assertEqual([(2,)], curs.fetchall())
+        self.assertEqual(None, curs.nextset())
+
 
 def test_suite():
     return unittest.TestLoader().loadTestsFromName(__name__)
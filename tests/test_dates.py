@@ -171,6 +171,20 @@ class DatetimeTests(unittest.TestCase, CommonDatetimeTestsMixin):
         self.check_datetime_tz("-01:15:30", -60 * (60 + 16))
         self.check_datetime_tz("-01:15:59", -60 * (60 + 16))
 
+    def test_parse_datetime_tzinfo_cache(self):
+        from datetime import timedelta
+        value1 = self.DATETIME("2010-01-01 10:00:00+02", self.curs)
+        value2 = self.DATETIME("2010-06-01 10:00:00+02", self.curs)
+        self.assert_(value1.tzinfo is value2.tzinfo)
+        value3 = self.DATETIME("2010-06-01 10:00:00+03", self.curs)
+        self.assertEqual(timedelta(hours=3), value3.utcoffset())
+
+        # a new factory isn't bypassed by the cache
+        self.curs.tzinfo_factory = lambda offset: \
+            FixedOffsetTimezone(offset, "TZ")
+        value4 = self.DATETIME("2010-01-01 10:00:00+02", self.curs)
+        self.assertEqual("TZ", value4.tzname())
+
     def test_parse_time_no_timezone(self):
         self.assertEqual(self.TIME("13:30:29", self.curs).tzinfo, None)
         self.assertEqual(self.TIME("13:30:29.123456", self.curs).tzinfo, None)
@@ -231,6 +245,17 @@ class DatetimeTests(unittest.TestCase, CommonDatetimeTestsMixin):
         self.assertEqual(seconds, -3583504)
         self.assertEqual(int(round((value - seconds) * 1000000)), 123456)
 
+    def test_parse_datetime_formats(self):
+        from datetime import date, datetime
+        self.assertEqual(datetime(2007, 1, 1, 13, 30, 29, 500000),
+            self.DATETIME('2007-01-01 13:30:29.5', self.curs))
+        self.assertEqual(datetime(2007, 1, 1, 13, 30, 29, 120000),
+            self.DATETIME('2007-01-01T13:30:29.12', self.curs))
+        self.assertEqual(datetime(2007, 1, 1),
+            self.DATETIME('2007-01-01', self.curs))
+        self.assertEqual(date(9999, 1, 1),
+            self.DATE('10000-01-01', self.curs))
+
     def _test_type_roundtrip(self, o1):
         o2 = self.execute("select %s;", (o1,))
         self.assertEqual(type(o1), type(o2))
@@ -462,6 +487,45 @@ if not hasattr(psycopg2._psycopg, 'MXDATETIME'):
     del mxDateTimeTests
 
 
+class MyTz(FixedOffsetTimezone):
+    def __init__(self, offset=None):
+        FixedOffsetTimezone.__init__(self, offset)
+        self.foo = 'bar'
+
+class FixedOffsetTimezoneTests(unittest.TestCase):
+    def test_init(self):
+        from datetime import timedelta
+        tz = FixedOffsetTimezone()
+        self.assertEqual(timedelta(0), tz.utcoffset(None))
+        self.assertEqual(timedelta(0), tz.dst(None))
+        self.assertEqual("+00", tz.tzname(None))
+        tz = FixedOffsetTimezone(offset=-5 * 60 - 30)
+        self.assertEqual(timedelta(minutes=-330), tz.utcoffset(None))
+        self.assertEqual("psycopg2.tz.FixedOffsetTimezone("
+            "offset=-330, name=None)", repr(tz))
+        tz = FixedOffsetTimezone(60, "CET")
+        self.assertEqual("CET", tz.tzname(None))
+        self.assertEqual("+01", FixedOffsetTimezone(60).tzname(None))
+
+    def test_pickle(self):
+        import pickle
+        from datetime import datetime, timedelta
+        value = datetime(2010, 1, 1, 10, tzinfo=FixedOffsetTimezone(90, "X"))
+        for proto in range(3):
+            value1 = pickle.loads(pickle.dumps(value, proto))
+            self.assertEqual(value, value1)
+            self.assertEqual("X", value1.tzname())
+            self.assertEqual(timedelta(minutes=90), value1.utcoffset())
+
+    def test_subclass(self):
+        import pickle
+        from datetime import timedelta
+        tz = pickle.loads(pickle.dumps(MyTz(120), 2))
+        self.assert_(isinstance(tz, MyTz))
+        self.assertEqual('bar', tz.foo)
+        self.assertEqual(timedelta(hours=2), tz.utcoffset(None))
+
+
 class FromTicksTestCase(unittest.TestCase):
     # bug "TimestampFromTicks() throws ValueError (2-2.0.14)"
     # reported by Jozsef Szalay on 2010-05-06
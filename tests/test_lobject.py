@@ -17,15 +17,6 @@ def skip_if_no_lo(f):
 
     return skip_if_no_lo_
 
-def skip_if_green(f):
-    def skip_if_green_(self):
-        if tests.green:
-            return self.skipTest("libpq doesn't support LO in async mode")
-        else:
-            return f(self)
-
-    return skip_if_green_
-
 
 class LargeObjectMixin(object):
     # doesn't derive from TestCase to avoid repeating tests twice.
@@ -143,6 +134,108 @@ class LargeObjectTests(LargeObjectMixin, unittest.TestCase):
         self.assertEqual(lo.read(4), "some")
         self.assertEqual(lo.read(), data)
 
+    def test_buffered_write(self):
+        lo = self.conn.lobject()
+        lo.buffer_size = 1000
+        self.assertEqual(lo.buffer_size, 1000)
+        for i in range(1000):
+            self.assertEqual(lo.write("data"), 4)
+        self.assertEqual(lo.tell(), 4000)
+        lo.write("x" * 5000)
+        lo.close()
+
+        lo = self.conn.lobject(lo.oid)
+        self.assertEqual(lo.read(), "data" * 1000 + "x" * 5000)
+
+    def test_buffered_read(self):
+        lo = self.conn.lobject()
+        lo.write("".join([chr(i % 256) for i in range(10000)]))
+        lo.close()
+
+        lo = self.conn.lobject(lo.oid)
+        lo.buffer_size = 1000
+        data = []
+        while 1:
+            chunk = lo.read(7)
+            if not chunk:
+                break
+            data.append(chunk)
+            self.assertEqual(lo.tell(), len(data) * 7 - (7 - len(chunk)))
+        self.assertEqual("".join(data),
+            "".join([chr(i % 256) for i in range(10000)]))
+
+        # seek and large reads skip the buffer
+        lo.seek(10)
+        self.assertEqual(lo.read(3), "\x0a\x0b\x0c")
+        self.assertEqual(len(lo.read(5000)), 5000)
+        self.assertEqual(lo.tell(), 5013)
+
+    def test_buffered_read_write(self):
+        lo = self.conn.lobject()
+        lo.buffer_size = 100
+        lo.write("some data")
+        lo.seek(0)
+        self.assertEqual(lo.read(2), "so")
+        lo.write("XX")
+        self.assertEqual(lo.tell(), 4)
+        lo.seek(0)
+        self.assertEqual(lo.read(), "soXX data")
+
+    def test_buffered_commit(self):
+        lo = self.conn.lobject()
+        self.lo_oid = lo.oid
+        lo.buffer_size = 100
+        lo.write("some data")
+        self.conn.commit()
+
+        lo = self.conn.lobject(self.lo_oid)
+        self.assertEqual(lo.read(), "some data")
+
+    def test_buffered_flush(self):
+        lo = self.conn.lobject()
+        lo.buffer_size = 100
+        lo.write("some data")
+
+        lo2 = self.conn.lobject(lo.oid, "r")
+        self.assertEqual(lo2.read(), "")
+        lo.flush()
+        self.assertEqual(lo2.read(), "some data")
+
+    def test_buffer_size(self):
+        lo = self.conn.lobject()
+        self.assertEqual(lo.buffer_size, 0)
+        self.assertRaises(ValueError, setattr, lo, "buffer_size", -1)
+        lo.buffer_size = 10
+        lo.write("abc")
+        lo.buffer_size = None
+        self.assertEqual(lo.buffer_size, 0)
+        lo.seek(0)
+        self.assertEqual(lo.read(), "abc")
+
+    def test_readinto(self):
+        lo = self.conn.lobject()
+        lo.write("some data")
+        lo.seek(0)
+        b = bytearray(4)
+        self.assertEqual(lo.readinto(b), 4)
+        self.assertEqual(str(b), "some")
+        self.assertEqual(lo.readinto(b), 4)
+        self.assertEqual(str(b), " dat")
+        self.assertEqual(lo.readinto(b), 1)
+        self.assertEqual(str(b[:1]), "a")
+        self.assertEqual(lo.readinto(b), 0)
+        self.assertRaises(TypeError, lo.readinto, "string")
+
+    def test_iter(self):
+        lo = self.conn.lobject()
+        lo.write("x" * 100000)
+        lo.seek(0)
+        self.assertEqual([len(c) for c in lo], [65536, 100000 - 65536])
+
+        lo.seek(0)
+        lo.buffer_size = 30000
+        self.assertEqual([len(c) for c in lo], [30000] * 3 + [10000])
+
     def test_seek_tell(self):
         lo = self.conn.lobject()
         length = lo.write("some data")
@@ -193,6 +286,12 @@ class LargeObjectTests(LargeObjectMixin, unittest.TestCase):
         lo.close()
         self.assertRaises(psycopg2.InterfaceError, lo.write, "some data")
 
+    def test_readinto_after_close(self):
+        lo = self.conn.lobject()
+        lo.close()
+        self.assertRaises(psycopg2.InterfaceError,
+                          lo.readinto, bytearray(10))
+
     def test_read_after_close(self):
         lo = self.conn.lobject()
         lo.close()
@@ -281,7 +380,6 @@ class LargeObjectTests(LargeObjectMixin, unittest.TestCase):
         self.assertEqual(open(filename, "rb").read(), "some data")
 
 decorate_all_tests(LargeObjectTests, skip_if_no_lo)
-decorate_all_tests(LargeObjectTests, skip_if_green)
 
 
 def skip_if_no_truncate(f):
@@ -334,7 +432,6 @@ class LargeObjectTruncateTests(LargeObjectMixin, unittest.TestCase):
         self.assertRaises(psycopg2.ProgrammingError, lo.truncate)
 
 decorate_all_tests(LargeObjectTruncateTests, skip_if_no_lo)
-decorate_all_tests(LargeObjectTruncateTests, skip_if_green)
 decorate_all_tests(LargeObjectTruncateTests, skip_if_no_truncate)
 
 
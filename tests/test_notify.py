@@ -141,6 +141,70 @@ conn.close()
         self.assertEqual('foo', notify.channel)
         self.assertEqual('Hello, world!', notify.payload)
 
+    def test_notifies_wait(self):
+        self.autocommit(self.conn)
+        self.listen('foo')
+        proc = self.notify('foo', 0.5, payload="hello")
+
+        t0 = time.time()
+        notifies = self.conn.notifies_wait(5)
+        t1 = time.time()
+        self.assert_(0.4 < t1 - t0 < 4, t1 - t0)
+
+        pid = int(proc.communicate()[0])
+        self.assertEqual(1, len(notifies))
+        self.assert_(isinstance(notifies[0], psycopg2.extensions.Notify))
+        self.assertEqual(pid, notifies[0].pid)
+        self.assertEqual('foo', notifies[0].channel)
+        if self.conn.server_version >= 90000:
+            self.assertEqual('hello', notifies[0].payload)
+        self.assertEqual(0, len(self.conn.notifies))
+
+    def test_notifies_wait_timeout(self):
+        self.autocommit(self.conn)
+        self.listen('foo')
+        t0 = time.time()
+        self.assertEqual([], self.conn.notifies_wait(0.2))
+        t1 = time.time()
+        self.assert_(0.15 < t1 - t0 < 2, t1 - t0)
+        self.assertEqual([], self.conn.notifies_wait(0))
+        self.assertRaises(ValueError, self.conn.notifies_wait, -1)
+
+    def test_notifies_wait_batch(self):
+        self.autocommit(self.conn)
+        self.listen('foo')
+        self.listen('bar')
+
+        conn = psycopg2.connect(tests.dsn)
+        self.autocommit(conn)
+        curs = conn.cursor()
+        for i in range(10):
+            curs.execute("NOTIFY %s" % (i % 3 and 'foo' or 'bar'))
+        pid = conn.get_backend_pid()
+        conn.close()
+        time.sleep(0.1)
+
+        # the notifies already received are returned first
+        self.conn.cursor().execute("select 1")
+        self.assert_(self.conn.notifies)
+
+        notifies = []
+        while len(notifies) < 10:
+            batch = self.conn.notifies_wait(2, max_batch=4)
+            self.assert_(0 < len(batch) <= 4, len(batch))
+            notifies.extend(batch)
+
+        self.assertEqual(0, len(self.conn.notifies))
+        self.assertEqual([pid] * 10, [n.pid for n in notifies])
+        self.assertEqual([i % 3 and 'foo' or 'bar' for i in range(10)],
+            [n.channel for n in notifies])
+        self.assertRaises(ValueError, self.conn.notifies_wait, 1, 0)
+
+    def test_notifies_wait_closed(self):
+        conn = psycopg2.connect(tests.dsn)
+        conn.close()
+        self.assertRaises(psycopg2.InterfaceError, conn.notifies_wait, 0)
+
     def test_notify_init(self):
         n = psycopg2.extensions.Notify(10, 'foo')
         self.assertEqual(10, n.pid)
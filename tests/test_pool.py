@@ -0,0 +1,275 @@
+#!/usr/bin/env python
+
+import time
+import threading
+from testutils import unittest
+
+import psycopg2
+import psycopg2.pool
+from psycopg2.pool import NativeConnectionPool, PoolError
+from psycopg2.extensions import TRANSACTION_STATUS_IDLE
+
+import sys
+if sys.version_info < (3,):
+    import tests
+else:
+    import py3tests as tests
+
+
+class NativeConnectionPoolTests(unittest.TestCase):
+
+    def setUp(self):
+        self.pool = NativeConnectionPool(1, 2, tests.dsn)
+
+    def tearDown(self):
+        if not self.pool.closed:
+            self.pool.closeall()
+
+    def test_minconn(self):
+        self.assertEqual(self.pool.size, 1)
+        self.assertEqual(self.pool.idle, 1)
+        self.assertRaises(ValueError, NativeConnectionPool, 3, 2, tests.dsn)
+        self.assertRaises(ValueError, NativeConnectionPool, 0, 0, tests.dsn)
+
+    def test_reuse(self):
+        conn = self.pool.getconn()
+        self.assertEqual(self.pool.idle, 0)
+        self.pool.putconn(conn)
+        self.assertEqual(self.pool.idle, 1)
+        self.assert_(self.pool.getconn() is conn)
+
+    def test_rollback_on_return(self):
+        conn = self.pool.getconn()
+        conn.cursor().execute("select 1")
+        self.pool.putconn(conn)
+        self.assertEqual(conn.get_transaction_status(),
+            TRANSACTION_STATUS_IDLE)
+        self.assertEqual(self.pool.idle, 1)
+
+    def test_broken_discarded(self):
+        conn = self.pool.getconn()
+        conn.close()
+        self.pool.putconn(conn)
+        self.assertEqual(self.pool.size, 0)
+        self.assert_(not self.pool.getconn().closed)
+
+    def test_close(self):
+        conn = self.pool.getconn()
+        self.pool.putconn(conn, close=True)
+        self.assert_(conn.closed)
+        self.assertEqual(self.pool.size, 0)
+
+    def test_foreign_conn(self):
+        conn = psycopg2.connect(tests.dsn)
+        try:
+            self.assertRaises(PoolError, self.pool.putconn, conn)
+        finally:
+            conn.close()
+
+    def test_exhausted(self):
+        conns = [self.pool.getconn(), self.pool.getconn()]
+        self.assertRaises(PoolError, self.pool.getconn, timeout=0)
+        t0 = time.time()
+        self.assertRaises(PoolError, self.pool.getconn, timeout=0.2)
+        self.assert_(time.time() - t0 >= 0.15)
+
+    def test_wait(self):
+        conns = [self.pool.getconn(), self.pool.getconn()]
+        def putconn():
+            time.sleep(0.1)
+            self.pool.putconn(conns[0])
+        t = threading.Thread(target=putconn)
+        t.start()
+        self.assert_(self.pool.getconn(timeout=5) is conns[0])
+        t.join()
+
+    def test_closeall(self):
+        conn = self.pool.getconn()
+        self.pool.getconn()
+        errors = []
+        def getconn():
+            try:
+                self.pool.getconn()
+            except PoolError, e:
+                errors.append(e)
+        t = threading.Thread(target=getconn)
+        t.start()
+        time.sleep(0.1)
+        self.pool.closeall()
+        t.join()
+        self.assertEqual(len(errors), 1)
+        self.assert_(conn.closed)
+        self.assert_(self.pool.closed)
+        self.assertRaises(PoolError, self.pool.getconn)
+        self.assertRaises(PoolError, self.pool.closeall)
+
+    def test_threads(self):
+        errors = []
+        def worker():
+            try:
+                for i in range(20):
+                    conn = self.pool.getconn()
+                    conn.cursor().execute("select 1")
+                    self.pool.putconn(conn)
+            except Exception, e:
+                errors.append(e)
+        ts = [threading.Thread(target=worker) for i in range(8)]
+        for t in ts: t.start()
+        for t in ts: t.join()
+        self.assertEqual(errors, [])
+        self.assert_(self.pool.size <= 2)
+
+    def test_prewarm(self):
+        pool = NativeConnectionPool(3, 4, tests.dsn)
+        try:
+            self.assertEqual(pool.idle, 3)
+            conn = pool.getconn()
+            ref = psycopg2.connect(tests.dsn)
+            try:
+                self.assert_(not conn.async)
+                self.assertEqual(conn.isolation_level, ref.isolation_level)
+            finally:
+                ref.close()
+            curs = conn.cursor()
+            curs.execute("select 42")
+            self.assertEqual(curs.fetchone()[0], 42)
+            pool.putconn(conn)
+        finally:
+            pool.closeall()
+
+    def test_max_lifetime(self):
+        self.assertEqual(self.pool.max_lifetime, None)
+        conn = self.pool.getconn()
+        self.pool.max_lifetime = 0.1
+        time.sleep(0.15)
+        self.pool.putconn(conn)
+        self.assert_(conn.closed)
+        self.assertEqual(self.pool.size, 0)
+        self.assertRaises(ValueError, setattr, self.pool, 'max_lifetime', -1)
+
+    def test_max_idle(self):
+        conns = [self.pool.getconn(), self.pool.getconn()]
+        for conn in conns:
+            self.pool.putconn(conn)
+        self.pool.max_idle = 0.1
+        time.sleep(0.15)
+        self.pool.maintain()
+        self.assertEqual(self.pool.size, 1)
+        self.assertEqual(self.pool.idle, 1)
+
+    def test_maintain_reopens(self):
+        self.pool.putconn(self.pool.getconn(), close=True)
+        self.assertEqual(self.pool.size, 0)
+        self.pool.maintain()
+        self.assertEqual(self.pool.size, 1)
+        self.assertEqual(self.pool.idle, 1)
+
+    def test_maintenance_thread(self):
+        self.pool.putconn(self.pool.getconn(), close=True)
+        m = psycopg2.pool.PoolMaintenanceThread(self.pool, 0.05).start()
+        time.sleep(0.2)
+        m.stop()
+        self.assertEqual(self.pool.size, 1)
+
+    def test_result_cache(self):
+        from psycopg2.extensions import ResultCache
+        self.assertEqual(None, self.pool.result_cache)
+        self.assertRaises(TypeError, setattr, self.pool, 'result_cache', 1)
+        cache = self.pool.result_cache = ResultCache()
+        conns = [self.pool.getconn(), self.pool.getconn()]
+        for conn in conns:
+            self.assert_(conn.result_cache is cache)
+            curs = conn.cursor()
+            curs.cache_results = True
+            curs.execute("select random()")
+            self.pool.putconn(conn)
+        self.assertEqual(1, cache.hits)
+        self.pool.result_cache = None
+        self.assertEqual(None, self.pool.getconn().result_cache)
+
+    def test_result_cache_python_pool(self):
+        from psycopg2.extensions import ResultCache
+        pool = psycopg2.pool.SimpleConnectionPool(0, 1, tests.dsn)
+        pool.result_cache = ResultCache()
+        self.assert_(pool.getconn().result_cache is pool.result_cache)
+        pool.closeall()
+
+
+class ExecutePartitionedTests(unittest.TestCase):
+
+    def setUp(self):
+        self.pool = psycopg2.pool.ThreadedConnectionPool(0, 3, tests.dsn)
+
+    def tearDown(self):
+        self.pool.closeall()
+
+    def test_records_in_order(self):
+        rv = psycopg2.pool.execute_partitioned(self.pool,
+            "select generate_series(%s, %s)",
+            [(i * 10, i * 10 + 9) for i in range(6)])
+        self.assertEqual([(i,) for i in range(60)], list(rv))
+        self.assertEqual(0, len(self.pool._used))
+
+    def test_parallel(self):
+        t0 = time.time()
+        rv = psycopg2.pool.execute_partitioned(self.pool,
+            "select %s from pg_sleep(0.3)", [(i,) for i in range(3)])
+        self.assertEqual([(0,), (1,), (2,)], list(rv))
+        self.assert_(time.time() - t0 < 0.8)
+
+    def test_columns(self):
+        rv = psycopg2.pool.execute_partitioned(self.pool,
+            "select generate_series(%s, %s)::int8 as n",
+            [(1, 3), (4, 5)], columns=True)
+        import struct
+        self.assertEqual(2, len(rv))
+        self.assertEqual('int64', rv[0][0].dtype)
+        self.assertEqual((1, 2, 3),
+            struct.unpack('=3q', str(buffer(rv[0][0]))))
+        self.assertEqual((4, 5), struct.unpack('=2q', str(buffer(rv[1][0]))))
+
+    def test_error(self):
+        rv = psycopg2.pool.execute_partitioned(self.pool,
+            "select 1 / %s", [(1,), (0,), (2,)])
+        self.assertRaises(psycopg2.DataError, list, rv)
+        self.assertEqual(0, len(self.pool._used))
+
+    def test_not_consumed(self):
+        rv = psycopg2.pool.execute_partitioned(self.pool,
+            "select %s", [(i,) for i in range(4)])
+        for i in range(50):
+            if not self.pool._used: break
+            time.sleep(0.1)
+        self.assertEqual(0, len(self.pool._used))
+        self.assertEqual([(i,) for i in range(4)], list(rv))
+
+    def test_persistent_pool(self):
+        pool = psycopg2.pool.PersistentConnectionPool(0, 3, tests.dsn)
+        rv = psycopg2.pool.execute_partitioned(pool,
+            "select %s", [(i,) for i in range(4)])
+        self.assertEqual([(i,) for i in range(4)], list(rv))
+        self.assertEqual(0, len(pool._used))
+        pool.closeall()
+
+    def test_simple_pool(self):
+        pool = psycopg2.pool.SimpleConnectionPool(0, 3, tests.dsn)
+        self.assertRaises(PoolError, psycopg2.pool.execute_partitioned,
+            pool, "select %s", [(1,)])
+        self.assertEqual(0, len(pool._used))
+        pool.closeall()
+
+    def test_native_pool_busy(self):
+        pool = NativeConnectionPool(0, 2, tests.dsn)
+        conn = pool.getconn()
+        rv = psycopg2.pool.execute_partitioned(pool,
+            "select %s", [(i,) for i in range(4)])
+        self.assertEqual([(i,) for i in range(4)], list(rv))
+        self.assertEqual(1, pool.idle)
+        pool.closeall()
+
+
+def test_suite():
+    return unittest.TestLoader().loadTestsFromName(__name__)
+
+if __name__ == "__main__":
+    unittest.main()
@@ -19,7 +19,8 @@ class Psycopg2Tests(dbapi20.DatabaseAPI20Test):
         pass
 
     def test_nextset(self):
-        # psycopg2 does not implement nextset()
+        # the dbapi20 test needs a procedure returning several sets:
+        # psycopg2 tests nextset() with multi-statement queries instead
         pass
 
 
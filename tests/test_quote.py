@@ -42,6 +42,31 @@ class QuotingTestCase(unittest.TestCase):
         self.assertEqual(res, data)
         self.assert_(not self.conn.notices)
 
+    def test_string_alignment(self):
+        # the strings are scanned a word at time, check the tails too
+        curs = self.conn.cursor()
+        for i in range(20):
+            data = "a" * i + "'" + "b" * (19 - i)
+            q = curs.mogrify("%s", (data,))
+            self.assert_(q.endswith("'%s''%s'" % ("a" * i, "b" * (19 - i))),
+                q)
+            curs.execute("SELECT %s, %s;", (data, "'" + data + "\\"))
+            self.assertEqual((data, "'" + data + "\\"), curs.fetchone())
+
+    def test_standard_conforming_strings_changed(self):
+        # the setting is followed when changed by a query
+        curs = self.conn.cursor()
+        data = "a'b\\c"
+        for scs in ('off', 'on', 'off'):
+            curs.execute("SET standard_conforming_strings TO " + scs)
+            q = curs.mogrify("%s", (data,))
+            if scs == 'on':
+                self.assertEqual("'a''b\\c'", q)
+            else:
+                self.assertEqual("E'a''b\\\\c'", q)
+            curs.execute("SELECT %s", (data,))
+            self.assertEqual(data, curs.fetchone()[0])
+
     def test_binary(self):
         data = """some data with \000\013 binary
         stuff into, 'quotes' and \\ a backslash too.
@@ -78,6 +103,27 @@ class QuotingTestCase(unittest.TestCase):
         self.assertEqual(res, data)
         self.assert_(not self.conn.notices)
 
+    def test_builtin_as_adapter(self):
+        # str, unicode and buffer are quoted without creating the adapter:
+        # the result must be the same
+        curs = self.conn.cursor()
+        ext = psycopg2.extensions
+        for obj in ["x'\\y", u"\xe0'", buffer("a\x00'b"), buffer("")]:
+            a = ext.adapt(obj)
+            a.prepare(self.conn)
+            self.assertEqual(a.getquoted(), curs.mogrify("%s", (obj,)))
+
+    def test_builtin_adapter_override(self):
+        curs = self.conn.cursor()
+        ext = psycopg2.extensions
+        orig = ext.adapters[(buffer, ext.ISQLQuote)]
+        ext.register_adapter(buffer, lambda b: ext.AsIs("'buf'"))
+        try:
+            self.assertEqual("'buf'", curs.mogrify("%s", (buffer("x"),)))
+        finally:
+            ext.register_adapter(buffer, orig)
+        self.assertNotEqual("'buf'", curs.mogrify("%s", (buffer("x"),)))
+
 def test_suite():
     return unittest.TestLoader().loadTestsFromName(__name__)
 
@@ -4,7 +4,8 @@ from testutils import unittest, skip_if_no_pg_sleep
 
 import psycopg2
 from psycopg2.extensions import (
-    ISOLATION_LEVEL_SERIALIZABLE, STATUS_BEGIN, STATUS_READY)
+    ISOLATION_LEVEL_SERIALIZABLE, STATUS_BEGIN, STATUS_READY,
+    TRANSACTION_STATUS_IDLE, TRANSACTION_STATUS_INTRANS)
 import tests
 
 
@@ -70,6 +71,54 @@ class TransactionTests(unittest.TestCase):
         curs.execute('SELECT 1')
         self.assertEqual(curs.fetchone()[0], 1)
 
+    def test_begin_with_first_query(self):
+        # The BEGIN is sent together with the first query
+        curs = self.conn.cursor()
+        curs.execute("SHOW transaction_isolation; SELECT 42")
+        self.assertEqual(self.conn.status, STATUS_BEGIN)
+        self.assertEqual(curs.fetchone()[0], 42)
+        curs.execute("SHOW transaction_isolation")
+        self.assertEqual(curs.fetchone()[0], 'serializable')
+        self.conn.rollback()
+
+        curs.server_params = True
+        curs.execute("SELECT %s", (10,))
+        self.assertEqual(self.conn.status, STATUS_BEGIN)
+        self.assertEqual(curs.fetchone()[0], 10)
+        curs.execute("SHOW transaction_isolation")
+        self.assertEqual(curs.fetchone()[0], 'serializable')
+        self.conn.rollback()
+
+    def test_error_in_first_query(self):
+        # The error is the query's one and the transaction was started
+        curs = self.conn.cursor()
+        self.assertRaises(psycopg2.ProgrammingError,
+            curs.execute, "SELECT * FROM nosuchtable")
+        self.assertEqual(self.conn.status, STATUS_BEGIN)
+        self.assertRaises(psycopg2.InternalError, curs.execute, "SELECT 1")
+        self.conn.rollback()
+        self.assertEqual(self.conn.status, STATUS_READY)
+
+        self.assertRaises(psycopg2.ProgrammingError, curs.execute, "")
+        self.conn.rollback()
+        curs.execute("SELECT 1")
+        self.assertEqual(curs.fetchone()[0], 1)
+
+    def test_syntax_error_in_first_query(self):
+        # The whole string is parsed before running the BEGIN
+        curs = self.conn.cursor()
+        self.assertRaises(psycopg2.ProgrammingError,
+            curs.execute, "SELEC 1")
+        self.assertEqual(self.conn.status, STATUS_READY)
+        self.assertEqual(self.conn.get_transaction_status(),
+            TRANSACTION_STATUS_IDLE)
+        curs.execute("SELECT 1")
+        self.assertEqual(self.conn.status, STATUS_BEGIN)
+        self.assertEqual(self.conn.get_transaction_status(),
+            TRANSACTION_STATUS_INTRANS)
+        self.assertEqual(curs.fetchone()[0], 1)
+        self.conn.rollback()
+
 
 class DeadlockSerializationTests(unittest.TestCase):
     """Test deadlock and serialization failure errors."""
@@ -57,6 +57,19 @@ class TypesBasicTests(unittest.TestCase):
         self.failUnless(self.execute("SELECT %s AS foo", (s,)) == s,
                         "wrong unicode quoting: " + s)
 
+    def testUnicodeDecode(self):
+        UNICODE = psycopg2.extensions.UNICODE
+        curs = self.conn.cursor()
+        self.conn.set_client_encoding('UTF8')
+        self.assertEqual(u'abc', UNICODE('abc', curs))
+        self.assertEqual(u'x' * 20 + u'\xe0', UNICODE('x' * 20 + '\xc3\xa0',
+            curs))
+        self.assertRaises(UnicodeDecodeError, UNICODE, '\xff', curs)
+        self.conn.set_client_encoding('LATIN1')
+        self.assertEqual(u'\xe0', UNICODE('\xe0', curs))
+        self.conn.set_client_encoding('LATIN9')
+        self.assertEqual(u'\u20ac', UNICODE('\xa4', curs))
+
     def testNumber(self):
         s = self.execute("SELECT %s AS foo", (1971,))
         self.failUnless(s == 1971, "wrong integer quoting: " + str(s))
@@ -117,6 +130,22 @@ class TypesBasicTests(unittest.TestCase):
         b = psycopg2.Binary('')
         self.assertEqual(str(b), "''::bytea")
 
+    def testBinaryHex(self):
+        if self.conn.server_version < 90000:
+            return self.skipTest("hex format not supported")
+        curs = self.conn.cursor()
+        q = curs.mogrify("SELECT %s", (psycopg2.Binary('\x00\x01\xff'),))
+        self.assert_(q.endswith("\\x0001ff'::bytea"), q)
+        curs.execute(q)
+        self.assertEqual('\x00\x01\xff', str(curs.fetchone()[0]))
+
+    def testBinaryHexDecode(self):
+        from psycopg2._psycopg import BINARY
+        self.assertEqual('\x00\xffA', str(BINARY('\\x00ff41', None)))
+        self.assertEqual('\xab\xcd', str(BINARY('\\xABcd', None)))
+        self.assertEqual('', str(BINARY('\\x', None)))
+        self.assertEqual('a\\b', str(BINARY('a\\\\b', None)))
+
     def testBinaryRoundTrip(self):
         # test to make sure buffers returned by psycopg2 are
         # understood by execute:
@@ -132,6 +161,59 @@ class TypesBasicTests(unittest.TestCase):
         self.failUnless(s == ['one', 'two', 'three'],
                         "wrong array quoting " + str(s))
 
+    def testArrayQuoting(self):
+        curs = self.conn.cursor()
+        self.assertEqual("ARRAY[1, NULL, 2.5, 'a''b']",
+            curs.mogrify("%s", ([1, None, 2.5, "a'b"],)))
+        self.assertEqual("'{}'", curs.mogrify("%s", ([],)))
+        s = self.execute("SELECT %s AS foo", (range(10000),))
+        self.assertEqual(range(10000), s)
+
+    def testTupleIn(self):
+        curs = self.conn.cursor()
+        self.assertEqual("1 IN (1, 'a', NULL)",
+            curs.mogrify("%s IN %s", (1, (1, 'a', None))))
+        self.assertEqual("(1, ARRAY[2])", curs.mogrify("%s", ((1, [2]),)))
+        s = self.execute("SELECT 3 IN %s AS foo", (tuple(range(10000)),))
+        self.assertEqual(True, s)
+
+    def testArrayParse(self):
+        from psycopg2.extensions import STRINGARRAY, FLOATARRAY
+        curs = self.conn.cursor()
+        self.assertEqual(['a', 'b,c', 'NULL', None, '', 'x"y'],
+            STRINGARRAY(r'{a,"b,c","NULL",NULL,"","x\"y"}', curs))
+        self.assertEqual([[1.5, 2.0], [None, -3.0]],
+            FLOATARRAY('{{1.5,2},{NULL,-3}}', curs))
+
+    def testCastNoCursor(self):
+        import datetime
+        from psycopg2.extensions import INTEGERARRAY, STRINGARRAY, UNICODE
+        from psycopg2._psycopg import PYDATETIME, PYTIME
+        self.assertEqual([[1, 2], [None, 3]],
+            INTEGERARRAY('{{1,2},{NULL,3}}', None))
+        self.assertEqual(['a', 'b c'], STRINGARRAY('{a,"b c"}', None))
+        self.assertEqual(u'caf\xe8', UNICODE('caf\xc3\xa8', None))
+        # without a cursor there is no tzinfo_factory: values are naive
+        self.assertEqual(datetime.datetime(2010, 1, 2, 3, 4, 5, 678000),
+            PYDATETIME('2010-01-02 03:04:05.678+02', None))
+        self.assertEqual(datetime.time(3, 4, 5),
+            PYTIME('03:04:05+02', None))
+
+    def testArrayBuffer(self):
+        import array
+        curs = self.conn.cursor()
+        psycopg2.extensions.register_type(
+            psycopg2.extensions.INTEGERARRAYBUFFER, curs)
+        psycopg2.extensions.register_type(
+            psycopg2.extensions.FLOATARRAYBUFFER, curs)
+        curs.execute("SELECT '{1,-2,3}'::int4[], '{0.5,2}'::float8[], "
+            "'{1,NULL}'::int8[], '{}'::int2[]")
+        r = curs.fetchone()
+        self.assertEqual(array.array('l', [1, -2, 3]), r[0])
+        self.assertEqual(array.array('d', [0.5, 2.0]), r[1])
+        self.assertEqual([1, None], r[2])
+        self.assertEqual(array.array('l'), r[3])
+
     def testTypeRoundtripBinary(self):
         o1 = buffer("".join(map(chr, range(256))))
         o2 = self.execute("select %s;", (o1,))
@@ -177,6 +259,217 @@ class AdaptSubclassTest(unittest.TestCase):
         register_adapter(A, lambda a: AsIs("a"))
         self.assertRaises(psycopg2.ProgrammingError, adapt, B())
 
+    def test_adapt_registered_later(self):
+        from psycopg2.extensions import adapt, register_adapter, AsIs
+
+        class A(object): pass
+        class B(A): pass
+
+        self.assertRaises(psycopg2.ProgrammingError, adapt, B())
+        register_adapter(A, lambda a: AsIs("a"))
+        self.assertEqual('a', adapt(B()).getquoted())
+        register_adapter(B, lambda b: AsIs("b"))
+        self.assertEqual('b', adapt(B()).getquoted())
+
+    def test_adapters_changed(self):
+        from psycopg2.extensions import adapt, adapters, ISQLQuote, AsIs
+
+        class A(object): pass
+
+        self.assertRaises(psycopg2.ProgrammingError, adapt, A())
+        adapters[(A, ISQLQuote)] = lambda a: AsIs("a")
+        self.assertEqual('a', adapt(A()).getquoted())
+        adapters[(A, ISQLQuote)] = lambda a: AsIs("b")
+        self.assertEqual('b', adapt(A()).getquoted())
+        adapters.pop((A, ISQLQuote))
+        self.assertRaises(psycopg2.ProgrammingError, adapt, A())
+
+        orig = adapters[(int, ISQLQuote)]
+        adapters.update({(int, ISQLQuote): lambda i: AsIs("'%d'" % i)})
+        try:
+            self.assertEqual("ARRAY['1']", adapt([1]).getquoted())
+        finally:
+            adapters[(int, ISQLQuote)] = orig
+        self.assertEqual('ARRAY[1]', adapt([1]).getquoted())
+
+    def test_override_builtin(self):
+        from psycopg2.extensions import adapt, register_adapter, AsIs
+        from psycopg2.extensions import adapters, ISQLQuote
+
+        self.assertEqual('ARRAY[1, 2.5]', adapt([1, 2.5]).getquoted())
+        orig = adapters[(float, ISQLQuote)]
+        register_adapter(float, lambda f: AsIs("'%r'::float8" % f))
+        try:
+            self.assertEqual("ARRAY[1, '2.5'::float8]",
+                adapt([1, 2.5]).getquoted())
+        finally:
+            register_adapter(float, orig)
+        self.assertEqual('ARRAY[1, 2.5]', adapt([1, 2.5]).getquoted())
+
+class BinaryResultsTests(unittest.TestCase):
+    """Test the decoding of results in binary format."""
+
+    def setUp(self):
+        self.conn = psycopg2.connect(tests.dsn)
+
+    def tearDown(self):
+        self.conn.close()
+
+    def execute(self, query):
+        curs = self.conn.cursor()
+        curs.binary = True
+        curs.execute(query)
+        return curs.fetchone()
+
+    def test_numbers(self):
+        self.assertEqual((-2, 100000, -10000000000L, 3.5, 0.25),
+            self.execute("SELECT -2::int2, 100000::int4, "
+                "-10000000000::int8, 3.5::float8, 0.25::float4"))
+
+    def test_decimal(self):
+        r = self.execute("SELECT 12345.678::numeric, -0.0012::numeric, "
+            "10000::numeric, 0::numeric(10,2), 'NaN'::numeric")
+        self.assertEqual(decimal.Decimal('12345.678'), r[0])
+        self.assertEqual(decimal.Decimal('-0.0012'), r[1])
+        self.assertEqual(decimal.Decimal('10000'), r[2])
+        self.assertEqual('0.00', str(r[3]))
+        self.assert_(r[4].is_nan())
+
+    def test_bool_text_bytea(self):
+        r = self.execute("SELECT true, false, 'hello'::text, "
+            "E'\\\\000\\\\001'::bytea, NULL::int4")
+        self.assertEqual((True, False, 'hello'), r[:3])
+        self.assertEqual('\x00\x01', str(r[3]))
+        self.assertEqual(None, r[4])
+
+    def test_bytea_outlives_result(self):
+        curs = self.conn.cursor()
+        curs.binary = True
+        curs.execute("SELECT E'\\\\001\\\\002'::bytea")
+        buf = curs.fetchone()[0]
+        curs.execute("SELECT E'\\\\003'::bytea")
+        self.assertEqual('\x03', str(curs.fetchone()[0]))
+        curs.close()
+        self.assertEqual('\x01\x02', str(buf))
+
+    def test_large_bytea_outlives_result(self):
+        curs = self.conn.cursor()
+        curs.binary = True
+        curs.execute("SELECT repeat('ab', 2000)::bytea")
+        buf = curs.fetchone()[0]
+        curs.execute("SELECT repeat('c', 2000)::bytea")
+        self.assertEqual('c' * 2000, str(curs.fetchone()[0]))
+        curs.close()
+        self.assertEqual('ab' * 2000, str(buf))
+
+    def test_arrays(self):
+        r = self.execute("SELECT '{1,NULL,3}'::int4[], "
+            "'{{a,b},{\"c,d\",NULL}}'::text[], '{}'::int8[]")
+        self.assertEqual([1, None, 3], r[0])
+        self.assertEqual([['a', 'b'], ['c,d', None]], r[1])
+        self.assertEqual([], r[2])
+
+    def test_array_buffer(self):
+        import array
+        from psycopg2.extensions import INTEGERARRAYBUFFER
+        curs = self.conn.cursor()
+        curs.binary = True
+        curs.binary_types = {1007: INTEGERARRAYBUFFER}
+        curs.execute("SELECT '{1,-2,3}'::int4[], '{{1,2}}'::int4[]")
+        self.assertEqual((array.array('l', [1, -2, 3]), [[1, 2]]),
+            curs.fetchone())
+
+    def test_dates(self):
+        import datetime
+        r = self.execute("SELECT '1999-12-31'::date, "
+            "'2010-02-03 04:05:06.789'::timestamp, "
+            "'2010-02-03 04:05:06+02'::timestamptz, 'infinity'::date")
+        self.assertEqual(datetime.date(1999, 12, 31), r[0])
+        self.assertEqual(datetime.datetime(2010, 2, 3, 4, 5, 6, 789000), r[1])
+        self.assertEqual(datetime.datetime(2010, 2, 3, 2, 5, 6),
+            r[2].replace(tzinfo=None))
+        self.assertEqual(datetime.timedelta(0), r[2].utcoffset())
+        self.assertEqual(datetime.date.max, r[3])
+
+    def test_uuid(self):
+        self.assertEqual(('12345678-9abc-def0-0102-030405060708',),
+            self.execute(
+                "SELECT '12345678-9abc-def0-0102-030405060708'::uuid"))
+
+    def test_named_cursor(self):
+        curs = self.conn.cursor('binary')
+        curs.binary = True
+        curs.execute("SELECT generate_series(1, 3)::int8")
+        self.assertEqual([(1L,), (2L,), (3L,)], curs.fetchall())
+
+
+class NumericTests(unittest.TestCase):
+    """Test the decoding of the numeric values."""
+
+    def setUp(self):
+        self.conn = psycopg2.connect(tests.dsn)
+
+    def tearDown(self):
+        self.conn.close()
+
+    def test_decimal_digits(self):
+        curs = self.conn.cursor()
+        values = ['0', '-0.00', '0.05', '12345.678', '-1000',
+            '123456789012345678901234567890.123456789']
+        curs.execute("SELECT " + ", ".join(["%s::numeric"] * len(values)),
+            values)
+        for v, r in zip(values, curs.fetchone()):
+            self.assertEqual(decimal.Decimal, type(r))
+            self.assertEqual(v, str(r))
+            self.assertEqual(decimal.Decimal(v), r)
+
+    def test_native_numeric(self):
+        from psycopg2.extensions import register_type, NATIVENUMERIC
+        curs = self.conn.cursor()
+        register_type(NATIVENUMERIC, curs)
+        curs.execute("SELECT 7::numeric(5), 12.34::numeric(10,2), "
+            "-0.5::numeric(4,3), 1.5::numeric, 1.5::numeric(30,10), "
+            "12345678901234567890::numeric(30,0), NULL::numeric(10,2)")
+        self.assertEqual((7, 1234, -500, 1.5, 1.5,
+            12345678901234567890L, None), curs.fetchone())
+
+    def test_native_numeric_nan(self):
+        from psycopg2.extensions import register_type, NATIVENUMERIC
+        curs = self.conn.cursor()
+        register_type(NATIVENUMERIC, curs)
+        curs.execute("SELECT 'NaN'::numeric")
+        r = curs.fetchone()[0]
+        self.assertEqual(float, type(r))
+        self.assert_(r != r)
+        curs.execute("SELECT 'NaN'::numeric(10,2)")
+        self.assertRaises(psycopg2.DataError, curs.fetchone)
+
+    def test_decimal_other_implementation(self):
+        # a Decimal with the same slots of the Python one but a different
+        # meaning must be created from the string
+        from subprocess import Popen, PIPE
+        script = """\
+import sys, types
+class Decimal(object):
+    __slots__ = ('_sign', '_int', '_exp', '_is_special')
+    def __new__(cls, value='0'):
+        self = object.__new__(cls)
+        self._sign, self._int, self._exp, self._is_special = \\
+            0, value, 0, False
+        return self
+    def __str__(self):
+        return 'Decimal:' + self._int
+decimal = types.ModuleType('decimal')
+decimal.Decimal = Decimal
+sys.modules['decimal'] = decimal
+import psycopg2.extensions
+print psycopg2.extensions.DECIMAL('-12.50', None)
+"""
+        proc = Popen([sys.executable, '-c', script], stdout=PIPE)
+        self.assertEqual('Decimal:-12.50', proc.communicate()[0].strip())
+
+
+
 def test_suite():
     return unittest.TestLoader().loadTestsFromName(__name__)
 
@@ -97,6 +97,79 @@ class TypesExtrasTests(unittest.TestCase):
         s = self.execute("SELECT '{}'::uuid[] AS foo")
         self.failUnless(type(s) == list and len(s) == 0)
 
+    @skip_if_no_uuid
+    def testUUIDBinary(self):
+        import uuid
+        psycopg2.extras.register_uuid(conn_or_curs=self.conn)
+        curs = self.conn.cursor()
+        curs.binary = True
+        u = uuid.UUID('9c6d5a77-7256-457e-9461-347b4358e350')
+        curs.execute("SELECT %s, %s, NULL::uuid", (u, [u, None]))
+        self.assertEqual(curs.fetchone(), (u, [u, None], None))
+
+    def test_uuid_cast_c(self):
+        import uuid
+        from psycopg2._psycopg import UUID, UUIDARRAY
+        s = '9c6d5a77-7256-457e-9461-347b4358e350'
+        u = uuid.UUID(s)
+
+        self.assert_(UUID(None, None) is None)
+        for v in (s, s.upper(), '{%s}' % s, s.replace('-', ''), u.bytes):
+            r = UUID(v, None)
+            self.assert_(isinstance(r, uuid.UUID))
+            self.assertEqual(r, u)
+            self.assertEqual(str(r), s)
+
+        for v in ('', 'x', s[:-1], s + '0', s.replace('5', 'g')):
+            self.assertRaises(psycopg2.DataError, UUID, v, None)
+
+        self.assertEqual(UUIDARRAY('{%s,NULL}' % s, None), [u, None])
+        self.assertEqual(UUIDARRAY('{}', None), [])
+
+    def test_uuid_adapt_c(self):
+        import uuid
+        from psycopg2._psycopg import Uuid
+        s = '9c6d5a77-7256-457e-9461-347b4358e350'
+        self.assertEqual(Uuid(uuid.UUID(s)).getquoted(), "'%s'::uuid" % s)
+        self.assert_(Uuid(uuid.UUID(s)).adapted is not None)
+
+    def test_inet_cast_c(self):
+        from psycopg2._psycopg import INET, INETARRAY
+        from psycopg2.extras import Inet
+
+        self.assert_(INET(None, None) is None)
+        i = INET('192.168.1.0/24', None)
+        self.assert_(isinstance(i, Inet))
+        self.assertEqual(i.addr, '192.168.1.0/24')
+        self.assertEqual(str(i), '192.168.1.0/24')
+        self.assertEqual(repr(i), "Inet('192.168.1.0/24')")
+
+        a = INETARRAY('{10.0.0.1,NULL,::1/128}', None)
+        self.assertEqual([x and x.addr for x in a],
+            ['10.0.0.1', None, '::1/128'])
+
+    def test_inet_adapt_c(self):
+        from psycopg2.extras import Inet
+        i = Inet("192.168.1.0/24")
+        self.assertEqual(i.getquoted(), "'192.168.1.0/24'::inet")
+        i.addr = "10.0.0.1"
+        self.assertEqual(i.getquoted(), "'10.0.0.1'::inet")
+        self.assert_(psycopg2.extensions.adapt(i) is i)
+
+        class MyInet(Inet):
+            def __init__(self):
+                pass
+
+        self.assertRaises(psycopg2.InterfaceError, MyInet().getquoted)
+
+    def testCIDR(self):
+        psycopg2.extras.register_inet()
+        s = self.execute("SELECT '192.168.1.0/24'::cidr AS foo")
+        self.assertEqual(s.addr, '192.168.1.0/24')
+        s = self.execute("SELECT '{10.0.0.1,NULL}'::inet[] AS foo")
+        self.assertEqual(s[0].addr, '10.0.0.1')
+        self.assert_(s[1] is None)
+
     def testINET(self):
         psycopg2.extras.register_inet()
         i = "192.168.1.0/24";
@@ -237,6 +310,83 @@ class HstoreTestCase(unittest.TestCase):
         ko('"a=>"1"')
         ko('"a"=>"1", "b"=>NUL')
 
+    def test_parse_c(self):
+        from psycopg2._psycopg import HSTORE
+
+        def ok(s, d):
+            self.assertEqual(HSTORE(s, None), d)
+
+        ok(None, None)
+        ok('', {})
+        ok('"a"=>"1", "b"=>"2"', {'a': '1', 'b': '2'})
+        ok('"a"  => "1" ,"b"  =>  "2"', {'a': '1', 'b': '2'})
+        ok('"a"=>NULL, "b"=>"2"', {'a': None, 'b': '2'})
+        ok(r'"a"=>"\"", "\""=>"2"', {'a': '"', '"': '2'})
+        ok('"a"=>"\'", "\'"=>"2"', {'a': "'", "'": '2'})
+        ok('"a"=>"1", "b"=>NULL', {'a': '1', 'b': None})
+        ok(r'"a\\"=>"1"', {'a\\': '1'})
+        ok(r'"a\""=>"1"', {'a"': '1'})
+        ok(r'"a\\\""=>"1"', {r'a\"': '1'})
+        ok(r'"a\\\\\""=>"1"', {r'a\\"': '1'})
+
+        def ko(s):
+            self.assertRaises(psycopg2.InterfaceError, HSTORE, s, None)
+
+        ko('a')
+        ko('"a"')
+        ko(r'"a\\""=>"1"')
+        ko(r'"a\\\\""=>"1"')
+        ko('"a=>"1"')
+        ko('"a"=>"1", "b"=>NUL')
+
+    def test_parse_c_unicode(self):
+        from psycopg2._psycopg import UNICODEHSTORE
+        d = UNICODEHSTORE('"a"=>"\xe2\x82\xac", "b"=>NULL', None)
+        self.assertEqual(d, {u'a': u'\u20ac', u'b': None})
+        self.assert_(isinstance(d.keys()[0], unicode))
+
+    def test_parse_binary(self):
+        from psycopg2._psycopg import HSTORE
+        import struct
+
+        def pack(d):
+            rv = [struct.pack('!i', len(d))]
+            for k, v in sorted(d.items()):
+                rv.append(struct.pack('!i', len(k)) + k)
+                if v is None:
+                    rv.append(struct.pack('!i', -1))
+                else:
+                    rv.append(struct.pack('!i', len(v)) + v)
+            return ''.join(rv)
+
+        for d in ({}, {'a': '1', 'b': None}, {'': '', '"\\': '\x00=>'}):
+            self.assertEqual(HSTORE(pack(d), None), d)
+
+        self.assertRaises(psycopg2.DataError,
+            HSTORE, pack({'a': '1'})[:-1], None)
+        self.assertRaises(psycopg2.DataError,
+            HSTORE, pack({'a': '1'}) + 'x', None)
+
+    def test_adapt_c(self):
+        from psycopg2._psycopg import Hstore, HSTORE
+
+        self.assertEqual(Hstore({}).getquoted(), "''::hstore")
+
+        o = {'a': '1', 'b': "'", 'c': None, 'd': '"'}
+        q = Hstore(o).getquoted()
+        self.assert_(q.endswith("::hstore"), q)
+        # unquote the sql string to parse it back
+        s = q[:-len("::hstore")]
+        s = s[s.index("'") + 1:-1].replace("''", "'").replace('\\\\', '\\')
+        self.assertEqual(HSTORE(s, None), o)
+
+        self.assertRaises(psycopg2.ProgrammingError,
+            Hstore({'a': 1}).getquoted)
+        self.assertRaises(psycopg2.DataError,
+            Hstore({'a': 'x\x00y'}).getquoted)
+        self.assertRaises(psycopg2.DataError,
+            Hstore({'a\x00"': None}).getquoted)
+
     @skip_if_no_hstore
     def test_register_conn(self):
         from psycopg2.extras import register_hstore
@@ -292,6 +442,7 @@ class HstoreTestCase(unittest.TestCase):
                 conn2.close()
         finally:
             psycopg2.extensions.string_types.pop(oids[0])
+            psycopg2.extensions.binary_types.pop(oids[0])
 
         # verify the caster is not around anymore
         cur = self.conn.cursor()
@@ -348,6 +499,150 @@ class HstoreTestCase(unittest.TestCase):
         ok({u''.join(ab): u''.join(ab)})
         ok(dict(zip(ab, ab)))
 
+    @skip_if_no_hstore
+    def test_roundtrip_binary(self):
+        from psycopg2.extras import register_hstore
+        register_hstore(self.conn)
+        cur = self.conn.cursor()
+        cur.binary = True
+
+        for d in ({}, {'a': 'b', 'c': None}, {'"\\': "'=>,"}):
+            cur.execute("select %s", (d,))
+            self.assertEqual(cur.fetchone()[0], d)
+
+
+class CompositeTestCase(unittest.TestCase):
+    def setUp(self):
+        self.conn = psycopg2.connect(tests.dsn)
+
+    def tearDown(self):
+        self.conn.close()
+
+    def test_cast_c(self):
+        from psycopg2.extensions import new_composite_type
+        # int4, text, date, int4[]
+        c = new_composite_type((99999,), "TEST", (23, 25, 1082, 1007))
+
+        def ok(s, t):
+            self.assertEqual(c(s, None), t)
+
+        import datetime
+        ok(None, None)
+        ok('(1,abc,2010-01-02,"{1,2}")',
+            (1, 'abc', datetime.date(2010, 1, 2), [1, 2]))
+        ok('(,"",,)', (None, '', None, None))
+        ok(r'(1,"a ""b"" \\c, d",,)', (1, r'a "b" \c, d', None, None))
+        ok(r'(1,a\,b,,)', (1, 'a,b', None, None))
+
+        def ko(s):
+            self.assertRaises(psycopg2.DataError, c, s, None)
+
+        ko('')
+        ko('1,2,3,4')
+        ko('(1,2)')
+        ko('(1,a,,,)')
+        ko('(1,"a,,)')
+
+    def test_cast_c_factory(self):
+        from psycopg2.extensions import new_composite_type, new_array_type
+
+        class Point(object):
+            def __init__(self, x, y):
+                self.x = x
+                self.y = y
+
+        c = new_composite_type((99999,), "POINT", (23, 23), Point)
+        p = c('(10,20)', None)
+        self.assert_(isinstance(p, Point))
+        self.assertEqual((p.x, p.y), (10, 20))
+
+        a = new_array_type((99998,), "POINTARRAY", c)
+        ps = a(r'{"(1,2)",NULL,"(3,)"}', None)
+        self.assertEqual(len(ps), 3)
+        self.assertEqual((ps[0].x, ps[0].y), (1, 2))
+        self.assert_(ps[1] is None)
+        self.assertEqual((ps[2].x, ps[2].y), (3, None))
+
+        self.assertRaises(TypeError, new_composite_type,
+            (99999,), "BAD", ('int4',))
+        self.assertRaises(TypeError, new_composite_type,
+            (99999,), "BAD", (23,), 42)
+
+    def _create_type(self, name, fields):
+        curs = self.conn.cursor()
+        try:
+            curs.execute("drop type %s cascade;" % name)
+        except psycopg2.ProgrammingError:
+            self.conn.rollback()
+
+        curs.execute("create type %s as (%s);" % (name,
+            ", ".join(["%s %s" % p for p in fields])))
+        if '.' in name:
+            schema, name = name.split('.')
+        else:
+            schema = 'public'
+
+        curs.execute("""\
+            SELECT t.oid
+            FROM pg_type t JOIN pg_namespace ns ON typnamespace = ns.oid
+            WHERE typname = %s and nspname = %s;
+            """, (name, schema))
+        return curs.fetchone()[0]
+
+    def test_register_on_connection(self):
+        from psycopg2.extras import register_composite
+        oid = self._create_type("type_ii", [("a", "integer"), ("b", "integer")])
+
+        t = register_composite("type_ii", self.conn)
+        self.assertEqual(t.name, 'type_ii')
+        self.assertEqual(t.oid, oid)
+        self.assertEqual(t.attnames, ['a', 'b'])
+        self.assertEqual(t.atttypes, [23, 23])
+
+        curs = self.conn.cursor()
+        curs.execute("select (1,2)::type_ii, null::type_ii")
+        self.assertEqual(curs.fetchone(), ((1, 2), None))
+
+        # the array too
+        curs.execute("select array[(1,2),(3,4),null]::type_ii[]")
+        self.assertEqual(curs.fetchone()[0], [(1, 2), (3, 4), None])
+
+    def test_register_nested(self):
+        from psycopg2.extras import register_composite
+        self._create_type("type_is", [("anint", "integer"), ("astring", "text")])
+        self._create_type("type_r_ft",
+            [("afloat", "float8"), ("anotherpair", "type_is")])
+
+        register_composite("type_is", self.conn)
+        register_composite("type_r_ft", self.conn)
+
+        curs = self.conn.cursor()
+        r = (0.25, (42, 'hello "world"'))
+        curs.execute("select %s::type_r_ft;", (r,))
+        self.assertEqual(curs.fetchone()[0], r)
+
+    def test_register_factory(self):
+        from psycopg2.extras import register_composite
+        try:
+            from collections import namedtuple
+        except ImportError:
+            return self.skipTest("namedtuple not available")
+
+        self._create_type("type_ii", [("a", "integer"), ("b", "integer")])
+        Pair = namedtuple('Pair', 'a b')
+        register_composite("type_ii", self.conn, factory=Pair)
+
+        curs = self.conn.cursor()
+        curs.execute("select (1,2)::type_ii")
+        p = curs.fetchone()[0]
+        self.assert_(isinstance(p, Pair))
+        self.assertEqual((p.a, p.b), (1, 2))
+
+    def test_not_composite(self):
+        from psycopg2.extras import register_composite
+        self.assertRaises(psycopg2.ProgrammingError,
+            register_composite, 'int4', self.conn)
+
 
 def test_suite():
     return unittest.TestLoader().loadTestsFromName(__name__)